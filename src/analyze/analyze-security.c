@@ -1951,85 +1951,61 @@ static int property_read_device_allow(
         return sd_bus_message_exit_container(m);
 }
 
-static int acquire_security_info(sd_bus *bus, const char *name, struct security_info *info, AnalyzeSecurityFlags flags) {
-
-        static const struct bus_properties_map security_map[] = {
-                { "AmbientCapabilities",     "t",       NULL,                                    offsetof(struct security_info, ambient_capabilities)      },
-                { "CapabilityBoundingSet",   "t",       NULL,                                    offsetof(struct security_info, capability_bounding_set)   },
-                { "DefaultDependencies",     "b",       NULL,                                    offsetof(struct security_info, default_dependencies)      },
-                { "Delegate",                "b",       NULL,                                    offsetof(struct security_info, delegate)                  },
-                { "DeviceAllow",             "a(ss)",   property_read_device_allow,              0                                                         },
-                { "DevicePolicy",            "s",       NULL,                                    offsetof(struct security_info, device_policy)             },
-                { "DynamicUser",             "b",       NULL,                                    offsetof(struct security_info, dynamic_user)              },
-                { "FragmentPath",            "s",       NULL,                                    offsetof(struct security_info, fragment_path)             },
-                { "IPAddressAllow",          "a(iayu)", property_read_ip_address_allow,          0                                                         },
-                { "IPAddressDeny",           "a(iayu)", property_read_ip_address_allow,          0                                                         },
-                { "IPIngressFilterPath",     "as",      property_read_ip_filters,                0                                                         },
-                { "IPEgressFilterPath",      "as",      property_read_ip_filters,                0                                                         },
-                { "Id",                      "s",       NULL,                                    offsetof(struct security_info, id)                        },
-                { "KeyringMode",             "s",       NULL,                                    offsetof(struct security_info, keyring_mode)              },
-                { "ProtectProc",             "s",       NULL,                                    offsetof(struct security_info, protect_proc)              },
-                { "ProcSubset",              "s",       NULL,                                    offsetof(struct security_info, proc_subset)               },
-                { "LoadState",               "s",       NULL,                                    offsetof(struct security_info, load_state)                },
-                { "LockPersonality",         "b",       NULL,                                    offsetof(struct security_info, lock_personality)          },
-                { "MemoryDenyWriteExecute",  "b",       NULL,                                    offsetof(struct security_info, memory_deny_write_execute) },
-                { "NoNewPrivileges",         "b",       NULL,                                    offsetof(struct security_info, no_new_privileges)         },
-                { "NotifyAccess",            "s",       NULL,                                    offsetof(struct security_info, notify_access)             },
-                { "PrivateDevices",          "b",       NULL,                                    offsetof(struct security_info, private_devices)           },
-                { "PrivateMounts",           "b",       NULL,                                    offsetof(struct security_info, private_mounts)            },
-                { "PrivateNetwork",          "b",       NULL,                                    offsetof(struct security_info, private_network)           },
-                { "PrivateTmp",              "b",       NULL,                                    offsetof(struct security_info, private_tmp)               },
-                { "PrivateUsers",            "b",       NULL,                                    offsetof(struct security_info, private_users)             },
-                { "ProtectControlGroups",    "b",       NULL,                                    offsetof(struct security_info, protect_control_groups)    },
-                { "ProtectHome",             "s",       NULL,                                    offsetof(struct security_info, protect_home)              },
-                { "ProtectHostname",         "b",       NULL,                                    offsetof(struct security_info, protect_hostname)          },
-                { "ProtectKernelModules",    "b",       NULL,                                    offsetof(struct security_info, protect_kernel_modules)    },
-                { "ProtectKernelTunables",   "b",       NULL,                                    offsetof(struct security_info, protect_kernel_tunables)   },
-                { "ProtectKernelLogs",       "b",       NULL,                                    offsetof(struct security_info, protect_kernel_logs)       },
-                { "ProtectClock",            "b",       NULL,                                    offsetof(struct security_info, protect_clock)             },
-                { "ProtectSystem",           "s",       NULL,                                    offsetof(struct security_info, protect_system)            },
-                { "RemoveIPC",               "b",       NULL,                                    offsetof(struct security_info, remove_ipc)                },
-                { "RestrictAddressFamilies", "(bas)",   property_read_restrict_address_families, 0                                                         },
-                { "RestrictNamespaces",      "t",       NULL,                                    offsetof(struct security_info, restrict_namespaces)       },
-                { "RestrictRealtime",        "b",       NULL,                                    offsetof(struct security_info, restrict_realtime)         },
-                { "RestrictSUIDSGID",        "b",       NULL,                                    offsetof(struct security_info, restrict_suid_sgid)        },
-                { "RootDirectory",           "s",       NULL,                                    offsetof(struct security_info, root_directory)            },
-                { "RootImage",               "s",       NULL,                                    offsetof(struct security_info, root_image)                },
-                { "SupplementaryGroups",     "as",      NULL,                                    offsetof(struct security_info, supplementary_groups)      },
-                { "SystemCallArchitectures", "as",      NULL,                                    offsetof(struct security_info, system_call_architectures) },
-                { "SystemCallFilter",        "(as)",    property_read_system_call_filter,        0                                                         },
-                { "Type",                    "s",       NULL,                                    offsetof(struct security_info, type)                      },
-                { "UMask",                   "u",       NULL,                                    offsetof(struct security_info, _umask)                    },
-                { "User",                    "s",       NULL,                                    offsetof(struct security_info, user)                      },
-                {}
-        };
-
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
-        _cleanup_free_ char *path = NULL;
-        int r;
-
-        /* Note: this mangles *info on failure! */
+static const struct bus_properties_map security_map[] = {
+        { "AmbientCapabilities",     "t",       NULL,                                    offsetof(struct security_info, ambient_capabilities)      },
+        { "CapabilityBoundingSet",   "t",       NULL,                                    offsetof(struct security_info, capability_bounding_set)   },
+        { "DefaultDependencies",     "b",       NULL,                                    offsetof(struct security_info, default_dependencies)      },
+        { "Delegate",                "b",       NULL,                                    offsetof(struct security_info, delegate)                  },
+        { "DeviceAllow",             "a(ss)",   property_read_device_allow,              0                                                         },
+        { "DevicePolicy",            "s",       NULL,                                    offsetof(struct security_info, device_policy)             },
+        { "DynamicUser",             "b",       NULL,                                    offsetof(struct security_info, dynamic_user)              },
+        { "FragmentPath",            "s",       NULL,                                    offsetof(struct security_info, fragment_path)             },
+        { "IPAddressAllow",          "a(iayu)", property_read_ip_address_allow,          0                                                         },
+        { "IPAddressDeny",           "a(iayu)", property_read_ip_address_allow,          0                                                         },
+        { "IPIngressFilterPath",     "as",      property_read_ip_filters,                0                                                         },
+        { "IPEgressFilterPath",      "as",      property_read_ip_filters,                0                                                         },
+        { "Id",                      "s",       NULL,                                    offsetof(struct security_info, id)                        },
+        { "KeyringMode",             "s",       NULL,                                    offsetof(struct security_info, keyring_mode)              },
+        { "ProtectProc",             "s",       NULL,                                    offsetof(struct security_info, protect_proc)              },
+        { "ProcSubset",              "s",       NULL,                                    offsetof(struct security_info, proc_subset)               },
+        { "LoadState",               "s",       NULL,                                    offsetof(struct security_info, load_state)                },
+        { "LockPersonality",         "b",       NULL,                                    offsetof(struct security_info, lock_personality)          },
+        { "MemoryDenyWriteExecute",  "b",       NULL,                                    offsetof(struct security_info, memory_deny_write_execute) },
+        { "NoNewPrivileges",         "b",       NULL,                                    offsetof(struct security_info, no_new_privileges)         },
+        { "NotifyAccess",            "s",       NULL,                                    offsetof(struct security_info, notify_access)             },
+        { "PrivateDevices",          "b",       NULL,                                    offsetof(struct security_info, private_devices)           },
+        { "PrivateMounts",           "b",       NULL,                                    offsetof(struct security_info, private_mounts)            },
+        { "PrivateNetwork",          "b",       NULL,                                    offsetof(struct security_info, private_network)           },
+        { "PrivateTmp",              "b",       NULL,                                    offsetof(struct security_info, private_tmp)               },
+        { "PrivateUsers",            "b",       NULL,                                    offsetof(struct security_info, private_users)             },
+        { "ProtectControlGroups",    "b",       NULL,                                    offsetof(struct security_info, protect_control_groups)    },
+        { "ProtectHome",             "s",       NULL,                                    offsetof(struct security_info, protect_home)              },
+        { "ProtectHostname",         "b",       NULL,                                    offsetof(struct security_info, protect_hostname)          },
+        { "ProtectKernelModules",    "b",       NULL,                                    offsetof(struct security_info, protect_kernel_modules)    },
+        { "ProtectKernelTunables",   "b",       NULL,                                    offsetof(struct security_info, protect_kernel_tunables)   },
+        { "ProtectKernelLogs",       "b",       NULL,                                    offsetof(struct security_info, protect_kernel_logs)       },
+        { "ProtectClock",            "b",       NULL,                                    offsetof(struct security_info, protect_clock)             },
+        { "ProtectSystem",           "s",       NULL,                                    offsetof(struct security_info, protect_system)            },
+        { "RemoveIPC",               "b",       NULL,                                    offsetof(struct security_info, remove_ipc)                },
+        { "RestrictAddressFamilies", "(bas)",   property_read_restrict_address_families, 0                                                         },
+        { "RestrictNamespaces",      "t",       NULL,                                    offsetof(struct security_info, restrict_namespaces)       },
+        { "RestrictRealtime",        "b",       NULL,                                    offsetof(struct security_info, restrict_realtime)         },
+        { "RestrictSUIDSGID",        "b",       NULL,                                    offsetof(struct security_info, restrict_suid_sgid)        },
+        { "RootDirectory",           "s",       NULL,                                    offsetof(struct security_info, root_directory)            },
+        { "RootImage",               "s",       NULL,                                    offsetof(struct security_info, root_image)                },
+        { "SupplementaryGroups",     "as",      NULL,                                    offsetof(struct security_info, supplementary_groups)      },
+        { "SystemCallArchitectures", "as",      NULL,                                    offsetof(struct security_info, system_call_architectures) },
+        { "SystemCallFilter",        "(as)",    property_read_system_call_filter,        0                                                         },
+        { "Type",                    "s",       NULL,                                    offsetof(struct security_info, type)                      },
+        { "UMask",                   "u",       NULL,                                    offsetof(struct security_info, _umask)                    },
+        { "User",                    "s",       NULL,                                    offsetof(struct security_info, user)                      },
+        {}
+};
 
-        assert(bus);
+static int security_info_finalize(const char *name, struct security_info *info, AnalyzeSecurityFlags flags) {
         assert(name);
         assert(info);
 
-        path = unit_dbus_path_from_name(name);
-        if (!path)
-                return log_oom();
-
-        r = bus_map_all_properties(
-                        bus,
-                        "org.freedesktop.systemd1",
-                        path,
-                        security_map,
-                        BUS_MAP_STRDUP | BUS_MAP_BOOLEAN_AS_BOOL,
-                        &error,
-                        NULL,
-                        info);
-        if (r < 0)
-                return log_error_errno(r, "Failed to get unit properties: %s", bus_error_message(&error, r));
-
         if (!streq_ptr(info->load_state, "loaded")) {
 
                 if (FLAGS_SET(flags, ANALYZE_SECURITY_ONLY_LOADED))
@@ -2075,13 +2051,46 @@ static int acquire_security_info(sd_bus *bus, const char *name, struct security_
         return 0;
 }
 
+static int acquire_security_info(sd_bus *bus, const char *name, struct security_info *info, AnalyzeSecurityFlags flags) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ char *path = NULL;
+        int r;
+
+        /* Note: this mangles *info on failure! */
+
+        assert(bus);
+        assert(name);
+        assert(info);
+
+        path = unit_dbus_path_from_name(name);
+        if (!path)
+                return log_oom();
+
+        r = bus_map_all_properties(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        path,
+                        security_map,
+                        BUS_MAP_STRDUP | BUS_MAP_BOOLEAN_AS_BOOL,
+                        &error,
+                        NULL,
+                        info);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get unit properties: %s", bus_error_message(&error, r));
+
+        return security_info_finalize(name, info, flags);
+}
+
+#define SECURITY_INFO_INIT                                      \
+        (struct security_info) {                                \
+                .default_dependencies = true,                   \
+                .capability_bounding_set = UINT64_MAX,          \
+                .restrict_namespaces = UINT64_MAX,              \
+                ._umask = 0002,                                 \
+        }
+
 static int analyze_security_one(sd_bus *bus, const char *name, Table *overview_table, AnalyzeSecurityFlags flags) {
-        _cleanup_(security_info_free) struct security_info info = {
-                .default_dependencies = true,
-                .capability_bounding_set = UINT64_MAX,
-                .restrict_namespaces = UINT64_MAX,
-                ._umask = 0002,
-        };
+        _cleanup_(security_info_free) struct security_info info = SECURITY_INFO_INIT;
         int r;
 
         assert(bus);
@@ -2100,6 +2109,125 @@ static int analyze_security_one(sd_bus *bus, const char *name, Table *overview_t
         return 0;
 }
 
+/* How many property queries to keep in flight when analyzing all units */
+#define SECURITY_INFO_QUERIES_MAX 64U
+
+typedef struct SecurityInfoQuery {
+        struct security_info info;
+        int error;
+} SecurityInfoQuery;
+
+static int security_info_query_reply(sd_bus_message *reply, size_t idx, void *userdata) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        SecurityInfoQuery *queries = userdata;
+        int r;
+
+        assert(reply);
+        assert(queries);
+
+        r = sd_bus_message_get_errno(reply);
+        if (r > 0) {
+                queries[idx].error = -r;
+                log_error_errno(-r, "Failed to get unit properties: %s", bus_error_message(sd_bus_message_get_error(reply), -r));
+                return 0;
+        }
+
+        r = bus_message_map_all_properties(reply, security_map, BUS_MAP_STRDUP | BUS_MAP_BOOLEAN_AS_BOOL, &error, &queries[idx].info);
+        if (r < 0) {
+                queries[idx].error = r;
+                log_error_errno(r, "Failed to get unit properties: %s", bus_error_message(&error, r));
+        }
+
+        return 0;
+}
+
+static int analyze_security_many(sd_bus *bus, char **names, Table *overview_table, AnalyzeSecurityFlags flags) {
+        _cleanup_free_ SecurityInfoQuery *queries = NULL;
+        sd_bus_message **calls = NULL;
+        int ret = 0, r;
+        size_t n;
+
+        assert(bus);
+
+        /* Queries the properties of all units in a pipelined fashion, rather than waiting for a full
+         * roundtrip to PID 1 for each of them, and then assesses them in order. */
+
+        n = strv_length(names);
+        if (n == 0)
+                return 0;
+
+        queries = new(SecurityInfoQuery, n);
+        if (!queries)
+                return log_oom();
+
+        calls = new0(sd_bus_message*, n);
+        if (!calls)
+                return log_oom();
+
+        for (size_t i = 0; i < n; i++)
+                queries[i] = (SecurityInfoQuery) {
+                        .info = SECURITY_INFO_INIT,
+                };
+
+        for (size_t i = 0; i < n; i++) {
+                _cleanup_free_ char *path = NULL;
+
+                path = unit_dbus_path_from_name(names[i]);
+                if (!path) {
+                        r = log_oom();
+                        goto finish;
+                }
+
+                r = sd_bus_message_new_method_call(
+                                bus,
+                                calls + i,
+                                "org.freedesktop.systemd1",
+                                path,
+                                "org.freedesktop.DBus.Properties",
+                                "GetAll");
+                if (r < 0) {
+                        bus_log_create_error(r);
+                        goto finish;
+                }
+
+                r = sd_bus_message_append(calls[i], "s", "");
+                if (r < 0) {
+                        bus_log_create_error(r);
+                        goto finish;
+                }
+        }
+
+        r = bus_call_batch(bus, calls, n, SECURITY_INFO_QUERIES_MAX, security_info_query_reply, queries);
+        if (r < 0) {
+                log_error_errno(r, "Failed to query unit properties: %m");
+                goto finish;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+                r = queries[i].error;
+                if (r >= 0)
+                        r = security_info_finalize(names[i], &queries[i].info, flags);
+                if (r == -EMEDIUMTYPE) /* Ignore this one because not loaded or Type is oneshot */
+                        continue;
+                if (r >= 0)
+                        r = assess(&queries[i].info, overview_table, flags);
+                if (r < 0 && ret >= 0)
+                        ret = r;
+        }
+
+        r = ret;
+
+finish:
+        for (size_t i = 0; i < n; i++)
+                sd_bus_message_unref(calls[i]);
+        free(calls);
+
+        for (size_t i = 0; i < n; i++)
+                security_info_free(&queries[i].info);
+
+        return r;
+}
+
 int analyze_security(sd_bus *bus, char **units, AnalyzeSecurityFlags flags) {
         _cleanup_(table_unrefp) Table *overview_table = NULL;
         int ret = 0, r;
@@ -2117,7 +2245,6 @@ int analyze_security(sd_bus *bus, char **units, AnalyzeSecurityFlags flags) {
                 _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
                 _cleanup_strv_free_ char **list = NULL;
                 size_t n = 0;
-                char **i;
 
                 r = sd_bus_call_method(
                                 bus,
@@ -2163,11 +2290,7 @@ int analyze_security(sd_bus *bus, char **units, AnalyzeSecurityFlags flags) {
 
                 flags |= ANALYZE_SECURITY_SHORT|ANALYZE_SECURITY_ONLY_LOADED|ANALYZE_SECURITY_ONLY_LONG_RUNNING;
 
-                STRV_FOREACH(i, list) {
-                        r = analyze_security_one(bus, *i, overview_table, flags);
-                        if (r < 0 && ret >= 0)
-                                ret = r;
-                }
+                ret = analyze_security_many(bus, list, overview_table, flags);
 
         } else {
                 char **i;
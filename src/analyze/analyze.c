@@ -29,6 +29,7 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "format-table.h"
+#include "format-util.h"
 #include "glob-util.h"
 #include "hashmap.h"
 #include "locale-util.h"
@@ -45,6 +46,7 @@
 #endif
 #include "sort-util.h"
 #include "special.h"
+#include "stdio-util.h"
 #include "strv.h"
 #include "strxcpyx.h"
 #include "terminal-util.h"
@@ -1356,6 +1358,129 @@ static int dump(int argc, char *argv[], void *userdata) {
         return copy_bytes(fd, STDOUT_FILENO, UINT64_MAX, 0);
 }
 
+static int hashmap_stats(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(table_unrefp) Table *table = NULL;
+        uint64_t total = 0;
+        int r;
+
+        r = acquire_bus(&bus, NULL);
+        if (r < 0)
+                return bus_log_connect_error(r);
+
+        r = bus_call_method(bus, bus_systemd_mgr, "GetHashmapStats", &error, &reply, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to issue method call GetHashmapStats: %s", bus_error_message(&error, r));
+
+        table = table_new("name", "maps", "entries", "buckets", "max dib", "avg dib", "memory");
+        if (!table)
+                return log_oom();
+
+        r = table_set_sort(table, (size_t) 6);
+        if (r < 0)
+                return r;
+
+        r = table_set_reverse(table, 6, true);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_enter_container(reply, 'a', "(suuuutt)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        for (;;) {
+                uint32_t n_maps, n_entries, n_buckets, max_dib;
+                uint64_t sum_dib, n_bytes;
+                char avg[DECIMAL_STR_MAX(unsigned) + 3];
+                const char *name;
+
+                r = sd_bus_message_read(reply, "(suuuutt)",
+                                        &name, &n_maps, &n_entries, &n_buckets, &max_dib, &sum_dib, &n_bytes);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r == 0)
+                        break;
+
+                if (n_entries > 0)
+                        xsprintf(avg, "%u.%02u",
+                                 (unsigned) (sum_dib / n_entries),
+                                 (unsigned) (sum_dib % n_entries * 100 / n_entries));
+                else
+                        strcpy(avg, "-");
+
+                r = table_add_many(table,
+                                   TABLE_STRING, name,
+                                   TABLE_UINT32, n_maps,
+                                   TABLE_UINT32, n_entries,
+                                   TABLE_UINT32, n_buckets,
+                                   TABLE_UINT32, max_dib,
+                                   TABLE_STRING, avg,
+                                   TABLE_SIZE, n_bytes);
+                if (r < 0)
+                        return table_log_add_error(r);
+
+                total += n_bytes;
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        (void) pager_open(arg_pager_flags);
+
+        r = table_print(table, NULL);
+        if (r < 0)
+                return r;
+
+        printf("\n%s in hashmaps and sets.\n", FORMAT_BYTES(total));
+
+        return 0;
+}
+
+static int unit_phases(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        int r;
+
+        r = acquire_bus(&bus, NULL);
+        if (r < 0)
+                return bus_log_connect_error(r);
+
+        r = bus_call_method(bus, bus_systemd_mgr, "GetUnitPhases", &error, &reply, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to issue method call GetUnitPhases: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, 'a', "(sstt)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        (void) pager_open(arg_pager_flags);
+
+        /* Print one line per phase in the "folded" format flame graph tools take as input, i.e. the
+         * semicolon separated stack followed by the time spent in it, here in µs */
+        for (;;) {
+                const char *unit, *phase;
+                uint64_t begin, end;
+
+                r = sd_bus_message_read(reply, "(sstt)", &unit, &phase, &begin, &end);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r == 0)
+                        break;
+
+                printf("%s;%s %" PRIu64 "\n", unit, phase, usec_sub_unsigned(end, begin));
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        return 0;
+}
+
 static int cat_config(int argc, char *argv[], void *userdata) {
         char **arg, **list;
         int r;
@@ -1496,7 +1621,7 @@ static int do_unit_files(int argc, char *argv[], void *userdata) {
         if (r < 0)
                 return log_error_errno(r, "lookup_paths_init() failed: %m");
 
-        r = unit_file_build_name_map(&lp, NULL, &unit_ids, &unit_names, NULL);
+        r = unit_file_build_name_map(&lp, NULL, &unit_ids, &unit_names, NULL, NULL);
         if (r < 0)
                 return log_error_errno(r, "unit_file_build_name_map() failed: %m");
 
@@ -2181,6 +2306,9 @@ static int help(int argc, char *argv[], void *userdata) {
                "  plot                     Output SVG graphic showing service initialization\n"
                "  dot [UNIT...]            Output dependency graph in %s format\n"
                "  dump                     Output state serialization of service manager\n"
+               "  hashmap-stats            Show memory and probing statistics of manager hashmaps\n"
+               "  unit-phases              Print time units spent in load and start up phases\n"
+               "                           in flame graph input format\n"
                "  cat-config               Show configuration file and drop-ins\n"
                "  unit-files               List files and symlinks for units\n"
                "  unit-paths               List load directories for units\n"
@@ -2403,6 +2531,8 @@ static int run(int argc, char *argv[]) {
                 { "get-log-target",    VERB_ANY, 1,        0,            get_log_target         },
                 { "service-watchdogs", VERB_ANY, 2,        0,            service_watchdogs      },
                 { "dump",              VERB_ANY, 1,        0,            dump                   },
+                { "hashmap-stats",     VERB_ANY, 1,        0,            hashmap_stats          },
+                { "unit-phases",       VERB_ANY, 1,        0,            unit_phases            },
                 { "cat-config",        2,        VERB_ANY, 0,            cat_config             },
                 { "unit-files",        VERB_ANY, VERB_ANY, 0,            do_unit_files          },
                 { "unit-paths",        1,        1,        0,            dump_unit_paths        },
@@ -1022,13 +1022,25 @@ int cg_shift_path(const char *cgroup, const char *root, const char **shifted) {
         assert(shifted);
 
         if (!root) {
-                /* If the root was specified let's use that, otherwise
-                 * let's determine it from PID 1 */
+                static thread_local bool root_is_top = false;
+
+                /* If the root was specified let's use that, otherwise let's determine it from PID 1. Usually
+                 * PID 1 sits right below the top-level cgroup (i.e. in "/init.scope") and stays there, in
+                 * which case there's nothing to shift. Remember that, so that we don't have to read
+                 * /proc/1/cgroup again for every lookup. */
+
+                if (root_is_top) {
+                        *shifted = cgroup;
+                        return 0;
+                }
 
                 r = cg_get_root_path(&rt);
                 if (r < 0)
                         return r;
 
+                if (empty_or_root(rt))
+                        root_is_top = true;
+
                 root = rt;
         }
 
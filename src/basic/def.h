@@ -65,3 +65,4 @@
         }
 
 #define VARLINK_ADDR_PATH_MANAGED_OOM "/run/systemd/io.system.ManagedOOM"
+#define VARLINK_ADDR_PATH_MANAGER "/run/systemd/io.systemd.Manager"
@@ -4,6 +4,7 @@
 
 #include "hash-funcs.h"
 #include "path-util.h"
+#include "wyhash.h"
 
 void string_hash_func(const char *p, struct siphash *state) {
         siphash24_compress(p, strlen(p) + 1, state);
@@ -62,6 +63,70 @@ DEFINE_HASH_OPS_FULL(path_hash_ops_free_free,
                      char, path_hash_func, path_compare, free,
                      void, free);
 
+uint64_t string_fast_hash_func(const char *p, uint64_t seed) {
+        return wyhash_string(p, seed);
+}
+
+const struct hash_ops string_hash_ops_fast = {
+        .hash = (hash_func_t) string_hash_func,
+        .fast_hash = (fast_hash_func_t) string_fast_hash_func,
+        .compare = (compare_func_t) string_compare_func,
+};
+
+const struct hash_ops string_hash_ops_fast_free = {
+        .hash = (hash_func_t) string_hash_func,
+        .fast_hash = (fast_hash_func_t) string_fast_hash_func,
+        .compare = (compare_func_t) string_compare_func,
+        .free_key = free,
+};
+
+const struct hash_ops string_hash_ops_fast_free_free = {
+        .hash = (hash_func_t) string_hash_func,
+        .fast_hash = (fast_hash_func_t) string_fast_hash_func,
+        .compare = (compare_func_t) string_compare_func,
+        .free_key = free,
+        .free_value = free,
+};
+
+uint64_t path_fast_hash_func(const char *q, uint64_t seed) {
+        uint64_t h = seed;
+
+        assert(q);
+
+        /* Same as path_hash_func(), i.e. equivalent paths as per path_compare() hash the same. Each
+         * component is chained into the hash on its own, which also encodes where components start. */
+
+        if (path_is_absolute(q))
+                h = wyhash("/", 1, h);
+
+        for (;;) {
+                const char *e;
+                int r;
+
+                r = path_find_first_component(&q, true, &e);
+                if (r == 0)
+                        return h;
+                if (r < 0)
+                        /* if a component is invalid, then add remaining part as a string. */
+                        return wyhash_string(q, h);
+
+                h = wyhash(e, r, h);
+        }
+}
+
+const struct hash_ops path_hash_ops_fast = {
+        .hash = (hash_func_t) path_hash_func,
+        .fast_hash = (fast_hash_func_t) path_fast_hash_func,
+        .compare = (compare_func_t) path_compare,
+};
+
+const struct hash_ops path_hash_ops_fast_free = {
+        .hash = (hash_func_t) path_hash_func,
+        .fast_hash = (fast_hash_func_t) path_fast_hash_func,
+        .compare = (compare_func_t) path_compare,
+        .free_key = free,
+};
+
 void trivial_hash_func(const void *p, struct siphash *state) {
         siphash24_compress(&p, sizeof(p), state);
 }
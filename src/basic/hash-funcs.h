@@ -6,6 +6,7 @@
 #include "siphash24.h"
 
 typedef void (*hash_func_t)(const void *p, struct siphash *state);
+typedef uint64_t (*fast_hash_func_t)(const void *p, uint64_t seed);
 typedef int (*compare_func_t)(const void *a, const void *b);
 
 struct hash_ops {
@@ -13,6 +14,11 @@ struct hash_ops {
         compare_func_t compare;
         free_func_t free_key;
         free_func_t free_value;
+
+        /* If set, hashmaps use this instead of 'hash', with a randomly seeded wyhash() rather than SipHash.
+         * This is considerably faster for short keys, but not safe against hash flooding. Hence, only set
+         * it for tables whose keys are not under control of unprivileged parties. */
+        fast_hash_func_t fast_hash;
 };
 
 #define _DEFINE_HASH_OPS(uq, name, type, hash_func, compare_func, free_key_func, free_value_func, scope) \
@@ -84,6 +90,16 @@ extern const struct hash_ops path_hash_ops;
 extern const struct hash_ops path_hash_ops_free;
 extern const struct hash_ops path_hash_ops_free_free;
 
+/* Same as above, but with fast hashing for trusted keys, see 'fast_hash' above */
+uint64_t string_fast_hash_func(const char *p, uint64_t seed) _pure_;
+extern const struct hash_ops string_hash_ops_fast;
+extern const struct hash_ops string_hash_ops_fast_free;
+extern const struct hash_ops string_hash_ops_fast_free_free;
+
+uint64_t path_fast_hash_func(const char *p, uint64_t seed);
+extern const struct hash_ops path_hash_ops_fast;
+extern const struct hash_ops path_hash_ops_fast_free;
+
 /* This will compare the passed pointers directly, and will not dereference them. This is hence not useful for strings
  * or suchlike. */
 void trivial_hash_func(const void *p, struct siphash *state);
@@ -18,6 +18,7 @@
 #include "siphash24.h"
 #include "string-util.h"
 #include "strv.h"
+#include "unaligned.h"
 
 #if ENABLE_DEBUG_HASHMAP
 #include "list.h"
@@ -111,10 +112,17 @@ struct set_entry {
 assert_cc(IDX_FIRST == _IDX_SWAP_END);
 assert_cc(IDX_FIRST == _IDX_ITERATOR_FIRST);
 
+/* Hash tags, one per bucket: the topmost bits of the hash value of the entry in the bucket. They are
+ * compared before calling the compare function, so that lookups only touch the entries (and keys) which
+ * are likely to match. This is similar to the control bytes of "Swiss tables". Only buckets in indirect
+ * storage have tags, direct storage is so small that it doesn't matter. */
+typedef uint8_t hash_tag_t;
+
 /* Storage space for the "swap" buckets.
  * All entry types can fit into an ordered_hashmap_entry. */
 struct swap_entries {
         struct ordered_hashmap_entry e[_IDX_SWAP_END - _IDX_SWAP_BEGIN];
+        hash_tag_t tags[_IDX_SWAP_END - _IDX_SWAP_BEGIN];
 };
 
 /* Distance from Initial Bucket */
@@ -155,7 +163,7 @@ enum HashmapType {
 };
 
 struct _packed_ indirect_storage {
-        void *storage;                     /* where buckets and DIBs are stored */
+        void *storage;                     /* where buckets, DIBs and hash tags are stored */
         uint8_t  hash_key[HASH_KEY_SIZE];  /* hash key; changes during resize */
 
         unsigned n_entries;                /* number of stored entries */
@@ -178,6 +186,9 @@ struct direct_storage {
 #define DIRECT_BUCKETS(entry_t) \
         (sizeof(struct direct_storage) / (sizeof(entry_t) + sizeof(dib_raw_t)))
 
+/* Size of a bucket in indirect storage, i.e. the entry, its DIB and its hash tag */
+#define INDIRECT_BUCKET_SIZE(hi) ((hi)->entry_size + sizeof(dib_raw_t) + sizeof(hash_tag_t))
+
 /* We should be able to store at least one entry directly. */
 assert_cc(DIRECT_BUCKETS(struct ordered_hashmap_entry) >= 1);
 
@@ -279,9 +290,8 @@ _destructor_ static void cleanup_pools(void) {
 
         /* Be nice to valgrind */
 
-        /* The pool is only allocated by the main thread, but the memory can
-         * be passed to other threads. Let's clean up if we are the main thread
-         * and no other threads are live. */
+        /* The pool is shared by all threads. Let's clean up if we are the
+         * main thread and no other threads are live. */
         /* We build our own is_main_thread() here, which doesn't use C11
          * TLS based caching of the result. That's because valgrind apparently
          * doesn't like malloc() (which C11 TLS internally uses) to be called
@@ -293,8 +303,7 @@ _destructor_ static void cleanup_pools(void) {
         if (r < 0 || !streq(t, "1"))
                 return;
 
-        mempool_drop(&hashmap_pool);
-        mempool_drop(&ordered_hashmap_pool);
+        mempool_drop();
 }
 #endif
 
@@ -332,19 +341,34 @@ static uint8_t* hash_key(HashmapBase *h) {
                                : shared_hash_key;
 }
 
-static unsigned base_bucket_hash(HashmapBase *h, const void *p) {
+static uint64_t base_bucket_hash(HashmapBase *h, const void *p) {
         struct siphash state;
-        uint64_t hash;
+
+        if (h->hash_ops->fast_hash) {
+                const uint8_t *k = hash_key(h);
+
+                return h->hash_ops->fast_hash(p, unaligned_read_ne64(k) ^ unaligned_read_ne64(k + 8));
+        }
 
         siphash24_init(&state, hash_key(h));
 
         h->hash_ops->hash(p, &state);
 
-        hash = siphash24_finalize(&state);
+        return siphash24_finalize(&state);
+}
+#define bucket_hash(h, p) base_bucket_hash(HASHMAP_BASE(h), p)
 
+/* The initial bucket of an entry with the given hash value */
+static unsigned base_bucket_hash_idx(HashmapBase *h, uint64_t hash) {
         return (unsigned) (hash % n_buckets(h));
 }
-#define bucket_hash(h, p) base_bucket_hash(HASHMAP_BASE(h), p)
+#define bucket_hash_idx(h, hash) base_bucket_hash_idx(HASHMAP_BASE(h), hash)
+
+/* The hash tag for the given hash value. The topmost bits are used, so that the tag stays meaningful for
+ * entries sharing their initial bucket. */
+static hash_tag_t bucket_hash_tag(uint64_t hash) {
+        return (hash_tag_t) (hash >> (64 - 8 * sizeof(hash_tag_t)));
+}
 
 static void base_set_dirty(HashmapBase *h) {
         h->dirty = true;
@@ -409,6 +433,29 @@ static dib_raw_t* dib_raw_ptr(HashmapBase *h) {
                 ((uint8_t*) storage_ptr(h) + hashmap_type_info[h->type].entry_size * n_buckets(h));
 }
 
+static hash_tag_t* tag_ptr(HashmapBase *h) {
+        if (!h->has_indirect)
+                return NULL;
+
+        return (hash_tag_t*) (dib_raw_ptr(h) + n_buckets(h));
+}
+
+/* Returns a pointer to the hash tag of the bucket at index idx, or NULL if it has none.
+ * Understands real indexes and swap indexes. */
+static hash_tag_t* bucket_tag_at_virtual(HashmapBase *h, struct swap_entries *swap, unsigned idx) {
+        hash_tag_t *tags;
+
+        if (idx < _IDX_SWAP_BEGIN) {
+                tags = tag_ptr(h);
+                return tags ? tags + idx : NULL;
+        }
+
+        if (idx < _IDX_SWAP_END)
+                return &swap->tags[idx - _IDX_SWAP_BEGIN];
+
+        assert_not_reached();
+}
+
 static unsigned bucket_distance(HashmapBase *h, unsigned idx, unsigned from) {
         return idx >= from ? idx - from
                            : n_buckets(h) + idx - from;
@@ -433,7 +480,7 @@ static unsigned bucket_calculate_dib(HashmapBase *h, unsigned idx, dib_raw_t raw
          * This returns the correct DIB value by recomputing the hash value in
          * the unlikely case. XXX Hitting this case could be a hint to rehash.
          */
-        initial_bucket = bucket_hash(h, bucket_at(h, idx)->key);
+        initial_bucket = bucket_hash_idx(h, bucket_hash(h, bucket_at(h, idx)->key));
         return bucket_distance(h, idx, initial_bucket);
 }
 
@@ -461,6 +508,7 @@ static void bucket_mark_free(HashmapBase *h, unsigned idx) {
 static void bucket_move_entry(HashmapBase *h, struct swap_entries *swap,
                               unsigned from, unsigned to) {
         struct hashmap_base_entry *e_from, *e_to;
+        hash_tag_t *t_from, *t_to;
 
         assert(from != to);
 
@@ -469,6 +517,11 @@ static void bucket_move_entry(HashmapBase *h, struct swap_entries *swap,
 
         memcpy(e_to, e_from, hashmap_type_info[h->type].entry_size);
 
+        t_from = bucket_tag_at_virtual(h, swap, from);
+        t_to   = bucket_tag_at_virtual(h, swap, to);
+        if (t_to)
+                *t_to = t_from ? *t_from : 0;
+
         if (h->type == HASHMAP_TYPE_ORDERED) {
                 OrderedHashmap *lh = (OrderedHashmap*) h;
                 struct ordered_hashmap_entry *le, *le_to;
@@ -875,11 +928,9 @@ static void hashmap_free_no_clear(HashmapBase *h) {
         assert_se(pthread_mutex_unlock(&hashmap_debug_list_mutex) == 0);
 #endif
 
-        if (h->from_pool) {
-                /* Ensure that the object didn't get migrated between threads. */
-                assert_se(is_main_thread());
+        if (h->from_pool)
                 mempool_free_tile(hashmap_type_info[h->type].mempool, h);
-        } else
+        else
                 free(h);
 }
 
@@ -998,20 +1049,18 @@ static bool hashmap_put_robin_hood(HashmapBase *h, unsigned idx,
 /*
  * Puts an entry into a hashmap, boldly - no check whether key already exists.
  * The caller must place the entry (only its key and value, not link indexes)
- * in swap slot IDX_PUT.
+ * in swap slot IDX_PUT, and pass the hash value of its key.
  * Caller must ensure: the key does not exist yet in the hashmap.
  *                     that resize is not needed if !may_resize.
  * Returns: 1 if entry was put successfully.
  *          -ENOMEM if may_resize==true and resize failed with -ENOMEM.
  *          Cannot return -ENOMEM if !may_resize.
  */
-static int hashmap_base_put_boldly(HashmapBase *h, unsigned idx,
+static int hashmap_base_put_boldly(HashmapBase *h, uint64_t hash,
                                    struct swap_entries *swap, bool may_resize) {
         struct ordered_hashmap_entry *new_entry;
         int r;
 
-        assert(idx < n_buckets(h));
-
         new_entry = bucket_at_swap(swap, IDX_PUT);
 
         if (may_resize) {
@@ -1019,10 +1068,12 @@ static int hashmap_base_put_boldly(HashmapBase *h, unsigned idx,
                 if (r < 0)
                         return r;
                 if (r > 0)
-                        idx = bucket_hash(h, new_entry->p.b.key);
+                        hash = bucket_hash(h, new_entry->p.b.key);
         }
         assert(n_entries(h) < n_buckets(h));
 
+        *bucket_tag_at_virtual(h, swap, IDX_PUT) = bucket_hash_tag(hash);
+
         if (h->type == HASHMAP_TYPE_ORDERED) {
                 OrderedHashmap *lh = (OrderedHashmap*) h;
 
@@ -1042,7 +1093,7 @@ static int hashmap_base_put_boldly(HashmapBase *h, unsigned idx,
                         lh->iterate_list_head = IDX_PUT;
         }
 
-        assert_se(hashmap_put_robin_hood(h, idx, swap) == false);
+        assert_se(hashmap_put_robin_hood(h, bucket_hash_idx(h, hash), swap) == false);
 
         n_entries_inc(h);
 #if ENABLE_DEBUG_HASHMAP
@@ -1053,8 +1104,8 @@ static int hashmap_base_put_boldly(HashmapBase *h, unsigned idx,
 
         return 1;
 }
-#define hashmap_put_boldly(h, idx, swap, may_resize) \
-        hashmap_base_put_boldly(HASHMAP_BASE(h), idx, swap, may_resize)
+#define hashmap_put_boldly(h, hash, swap, may_resize) \
+        hashmap_base_put_boldly(HASHMAP_BASE(h), hash, swap, may_resize)
 
 /*
  * Returns 0 if resize is not needed.
@@ -1065,8 +1116,10 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
         struct swap_entries swap;
         void *new_storage;
         dib_raw_t *old_dibs, *new_dibs;
+        hash_tag_t *new_tags;
         const struct hashmap_type_info *hi;
         unsigned idx, optimal_idx;
+        uint64_t hash;
         unsigned old_n_buckets, new_n_buckets, n_rehashed, new_n_entries;
         uint8_t new_shift;
         bool rehash_next;
@@ -1093,7 +1146,7 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
         if (_unlikely_(new_n_buckets < new_n_entries))
                 return -ENOMEM;
 
-        if (_unlikely_(new_n_buckets > UINT_MAX / (hi->entry_size + sizeof(dib_raw_t))))
+        if (_unlikely_(new_n_buckets > UINT_MAX / INDIRECT_BUCKET_SIZE(hi)))
                 return -ENOMEM;
 
         old_n_buckets = n_buckets(h);
@@ -1102,10 +1155,10 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
                 return 0;
 
         new_shift = log2u_round_up(MAX(
-                        new_n_buckets * (hi->entry_size + sizeof(dib_raw_t)),
+                        new_n_buckets * INDIRECT_BUCKET_SIZE(hi),
                         2 * sizeof(struct direct_storage)));
 
-        /* Realloc storage (buckets and DIB array). */
+        /* Realloc storage (buckets, DIB and hash tag arrays). */
         new_storage = realloc(h->has_indirect ? h->indirect.storage : NULL,
                               1U << new_shift);
         if (!new_storage)
@@ -1127,17 +1180,19 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
 
         h->has_indirect = true;
         h->indirect.storage = new_storage;
-        h->indirect.n_buckets = (1U << new_shift) /
-                                (hi->entry_size + sizeof(dib_raw_t));
+        h->indirect.n_buckets = (1U << new_shift) / INDIRECT_BUCKET_SIZE(hi);
 
         old_dibs = (dib_raw_t*)((uint8_t*) new_storage + hi->entry_size * old_n_buckets);
         new_dibs = dib_raw_ptr(h);
+        new_tags = tag_ptr(h);
 
         /*
          * Move the DIB array to the new place, replacing valid DIB values with
          * DIB_RAW_REHASH to indicate all of the used buckets need rehashing.
          * Note: Overlap is not possible, because we have at least doubled the
          * number of buckets and dib_raw_t is smaller than any entry type.
+         * The old hash tags are simply dropped, all entries get new ones when
+         * they are rehashed.
          */
         for (idx = 0; idx < old_n_buckets; idx++) {
                 assert(old_dibs[idx] != DIB_RAW_REHASH);
@@ -1159,14 +1214,16 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
                 if (new_dibs[idx] != DIB_RAW_REHASH)
                         continue;
 
-                optimal_idx = bucket_hash(h, bucket_at(h, idx)->key);
+                hash = bucket_hash(h, bucket_at(h, idx)->key);
+                optimal_idx = bucket_hash_idx(h, hash);
 
                 /*
                  * Not much to do if by luck the entry hashes to its current
-                 * location. Just set its DIB.
+                 * location. Just set its DIB and hash tag.
                  */
                 if (optimal_idx == idx) {
                         new_dibs[idx] = 0;
+                        new_tags[idx] = bucket_hash_tag(hash);
                         n_rehashed++;
                         continue;
                 }
@@ -1175,6 +1232,7 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
                 bucket_move_entry(h, &swap, idx, IDX_PUT);
                 /* bucket_move_entry does not clear the source */
                 memzero(bucket_at(h, idx), hi->entry_size);
+                swap.tags[IDX_PUT - _IDX_SWAP_BEGIN] = bucket_hash_tag(hash);
 
                 do {
                         /*
@@ -1185,8 +1243,11 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
                         n_rehashed++;
 
                         /* Did the current entry displace another one? */
-                        if (rehash_next)
-                                optimal_idx = bucket_hash(h, bucket_at_swap(&swap, IDX_PUT)->p.b.key);
+                        if (rehash_next) {
+                                hash = bucket_hash(h, bucket_at_swap(&swap, IDX_PUT)->p.b.key);
+                                optimal_idx = bucket_hash_idx(h, hash);
+                                swap.tags[IDX_PUT - _IDX_SWAP_BEGIN] = bucket_hash_tag(hash);
+                        }
                 } while (rehash_next);
         }
 
@@ -1196,15 +1257,16 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
 }
 
 /*
- * Finds an entry with a matching key
+ * Finds an entry with a matching key, given the hash value of the key
  * Returns: index of the found entry, or IDX_NIL if not found.
  */
-static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key) {
+static unsigned base_bucket_scan(HashmapBase *h, uint64_t hash, const void *key) {
         struct hashmap_base_entry *e;
-        unsigned dib, distance;
+        unsigned idx, dib, distance;
         dib_raw_t *dibs = dib_raw_ptr(h);
+        hash_tag_t *tags = tag_ptr(h), tag = bucket_hash_tag(hash);
 
-        assert(idx < n_buckets(h));
+        idx = bucket_hash_idx(h, hash);
 
         for (distance = 0; ; distance++) {
                 if (dibs[idx] == DIB_RAW_FREE)
@@ -1214,7 +1276,7 @@ static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key)
 
                 if (dib < distance)
                         return IDX_NIL;
-                if (dib == distance) {
+                if (dib == distance && (!tags || tags[idx] == tag)) {
                         e = bucket_at(h, idx);
                         if (h->hash_ops->compare(e->key, key) == 0)
                                 return idx;
@@ -1223,12 +1285,13 @@ static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key)
                 idx = next_idx(h, idx);
         }
 }
-#define bucket_scan(h, idx, key) base_bucket_scan(HASHMAP_BASE(h), idx, key)
+#define bucket_scan(h, hash, key) base_bucket_scan(HASHMAP_BASE(h), hash, key)
 
 int hashmap_put(Hashmap *h, const void *key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(h);
 
@@ -1250,7 +1313,8 @@ int hashmap_put(Hashmap *h, const void *key, void *value) {
 int set_put(Set *s, const void *key) {
         struct swap_entries swap;
         struct hashmap_base_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(s);
 
@@ -1291,7 +1355,8 @@ int _set_ensure_consume(Set **s, const struct hash_ops *hash_ops, void *key  HAS
 int hashmap_replace(Hashmap *h, const void *key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(h);
 
@@ -1324,7 +1389,8 @@ int hashmap_replace(Hashmap *h, const void *key, void *value) {
 
 int hashmap_update(Hashmap *h, const void *key, void *value) {
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         assert(h);
 
@@ -1342,7 +1408,8 @@ int hashmap_update(Hashmap *h, const void *key, void *value) {
 
 void* _hashmap_get(HashmapBase *h, const void *key) {
         struct hashmap_base_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
@@ -1358,7 +1425,8 @@ void* _hashmap_get(HashmapBase *h, const void *key) {
 
 void* hashmap_get2(Hashmap *h, const void *key, void **key2) {
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
@@ -1376,7 +1444,7 @@ void* hashmap_get2(Hashmap *h, const void *key, void **key2) {
 }
 
 bool _hashmap_contains(HashmapBase *h, const void *key) {
-        unsigned hash;
+        uint64_t hash;
 
         if (!h)
                 return false;
@@ -1387,7 +1455,8 @@ bool _hashmap_contains(HashmapBase *h, const void *key) {
 
 void* _hashmap_remove(HashmapBase *h, const void *key) {
         struct hashmap_base_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
         void *data;
 
         if (!h)
@@ -1407,7 +1476,8 @@ void* _hashmap_remove(HashmapBase *h, const void *key) {
 
 void* hashmap_remove2(Hashmap *h, const void *key, void **rkey) {
         struct plain_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
         void *data;
 
         if (!h) {
@@ -1437,7 +1507,8 @@ void* hashmap_remove2(Hashmap *h, const void *key, void **rkey) {
 int hashmap_remove_and_put(Hashmap *h, const void *old_key, const void *new_key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned old_hash, new_hash, idx;
+        uint64_t old_hash, new_hash;
+        unsigned idx;
 
         if (!h)
                 return -ENOENT;
@@ -1464,7 +1535,8 @@ int hashmap_remove_and_put(Hashmap *h, const void *old_key, const void *new_key,
 int set_remove_and_put(Set *s, const void *old_key, const void *new_key) {
         struct swap_entries swap;
         struct hashmap_base_entry *e;
-        unsigned old_hash, new_hash, idx;
+        uint64_t old_hash, new_hash;
+        unsigned idx;
 
         if (!s)
                 return -ENOENT;
@@ -1490,7 +1562,8 @@ int set_remove_and_put(Set *s, const void *old_key, const void *new_key) {
 int hashmap_remove_and_replace(Hashmap *h, const void *old_key, const void *new_key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
-        unsigned old_hash, new_hash, idx_old, idx_new;
+        uint64_t old_hash, new_hash;
+        unsigned idx_old, idx_new;
 
         if (!h)
                 return -ENOENT;
@@ -1525,7 +1598,8 @@ int hashmap_remove_and_replace(Hashmap *h, const void *old_key, const void *new_
 
 void* _hashmap_remove_value(HashmapBase *h, const void *key, void *value) {
         struct hashmap_base_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
@@ -1592,6 +1666,37 @@ unsigned _hashmap_buckets(HashmapBase *h) {
         return n_buckets(h);
 }
 
+void _hashmap_add_stats(HashmapBase *h, HashmapStats *stats) {
+        const struct hashmap_type_info *hi;
+        dib_raw_t *dibs;
+
+        assert(stats);
+
+        if (!h)
+                return;
+
+        hi = &hashmap_type_info[h->type];
+
+        stats->n_maps++;
+        stats->n_entries += n_entries(h);
+        stats->n_buckets += n_buckets(h);
+        stats->n_bytes += hi->head_size;
+        if (h->has_indirect)
+                stats->n_bytes += n_buckets(h) * INDIRECT_BUCKET_SIZE(hi);
+
+        dibs = dib_raw_ptr(h);
+        for (unsigned idx = 0; idx < n_buckets(h); idx++) {
+                unsigned dib;
+
+                if (dibs[idx] == DIB_RAW_FREE)
+                        continue;
+
+                dib = bucket_calculate_dib(h, idx, dibs[idx]);
+                stats->max_dib = MAX(stats->max_dib, dib);
+                stats->sum_dib += dib;
+        }
+}
+
 int _hashmap_merge(Hashmap *h, Hashmap *other) {
         Iterator i;
         unsigned idx;
@@ -1671,7 +1776,7 @@ int _hashmap_move(HashmapBase *h, HashmapBase *other) {
                 return r;
 
         HASHMAP_FOREACH_IDX(idx, other, i) {
-                unsigned h_hash;
+                uint64_t h_hash;
 
                 e = bucket_at(other, idx);
                 h_hash = bucket_hash(h, e->key);
@@ -1693,7 +1798,8 @@ int _hashmap_move(HashmapBase *h, HashmapBase *other) {
 
 int _hashmap_move_one(HashmapBase *h, HashmapBase *other, const void *key) {
         struct swap_entries swap;
-        unsigned h_hash, other_hash, idx;
+        uint64_t h_hash, other_hash;
+        unsigned idx;
         struct hashmap_base_entry *e, *n;
         int r;
 
@@ -1778,7 +1884,8 @@ char** _hashmap_get_strv(HashmapBase *h) {
 
 void* ordered_hashmap_next(OrderedHashmap *h, const void *key) {
         struct ordered_hashmap_entry *e;
-        unsigned hash, idx;
+        uint64_t hash;
+        unsigned idx;
 
         if (!h)
                 return NULL;
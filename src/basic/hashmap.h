@@ -278,6 +278,25 @@ static inline unsigned ordered_hashmap_buckets(OrderedHashmap *h) {
         return _hashmap_buckets(HASHMAP_BASE(h));
 }
 
+/* Memory and probing statistics, cheap enough to collect from production code. Accumulates into *stats,
+ * so that statistics of many maps with the same purpose can be summed up. */
+typedef struct HashmapStats {
+        unsigned n_maps;        /* number of (non-NULL) maps accounted for */
+        unsigned n_entries;     /* number of stored entries */
+        unsigned n_buckets;     /* number of buckets */
+        unsigned max_dib;       /* longest distance of an entry from its initial bucket */
+        uint64_t sum_dib;       /* sum of all entries' distances, for calculating the average */
+        size_t n_bytes;         /* memory used by the map objects and their bucket storage */
+} HashmapStats;
+
+void _hashmap_add_stats(HashmapBase *h, HashmapStats *stats);
+static inline void hashmap_add_stats(Hashmap *h, HashmapStats *stats) {
+        _hashmap_add_stats(HASHMAP_BASE(h), stats);
+}
+static inline void ordered_hashmap_add_stats(OrderedHashmap *h, HashmapStats *stats) {
+        _hashmap_add_stats(HASHMAP_BASE(h), stats);
+}
+
 bool _hashmap_iterate(HashmapBase *h, Iterator *i, void **value, const void **key);
 static inline bool hashmap_iterate(Hashmap *h, Iterator *i, void **value, const void **key) {
         return _hashmap_iterate(HASHMAP_BASE(h), i, value, key);
@@ -1,5 +1,6 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -7,56 +8,197 @@
 #include "macro.h"
 #include "memory-util.h"
 #include "mempool.h"
-#include "process-util.h"
+#include "pthread-util.h"
 #include "util.h"
 
+/* Tiles are carved from large chunks ("pools") allocated with malloc(). Each thread keeps, for every size
+ * class, its own list of free tiles and its own pool it carves new tiles from. When a thread exits, its free
+ * tiles are moved to a global depot, from which other threads refill their caches once their own pool is
+ * used up. Only that, and allocating a new pool, takes a lock. */
+
 struct pool {
         struct pool *next;
         size_t n_tiles;
         size_t n_used;
+        size_t tile_size;
 };
 
-void* mempool_alloc_tile(struct mempool *mp) {
-        size_t i;
+/* Tiles are aligned like malloc() memory, as long as their size is a multiple of 16 */
+#define TILE_ALIGN 16U
+#define POOL_HEADER_SIZE ALIGN_TO(sizeof(struct pool), TILE_ALIGN)
+#define POOL_TILES_MIN 16U
 
-        /* When a tile is released we add it to the list and simply
-         * place the next pointer at its offset 0. */
+static const size_t size_classes[] = {
+        16, 32, 48, 64, 80, 96, 112, 128,
+        160, 192, 224, 256,
+        320, 384, 448, 512,
+        640, 768, 896, MEMPOOL_TILE_MAX,
+};
 
-        assert(mp->tile_size >= sizeof(void*));
-        assert(mp->at_least > 0);
+#define N_SIZE_CLASSES ELEMENTSOF(size_classes)
+
+struct cache {
+        bool initialized;
+        void *freelist[N_SIZE_CLASSES];
+        struct pool *pool[N_SIZE_CLASSES];
+};
+
+static thread_local struct cache cache = {};
+
+static struct {
+        pthread_mutex_t mutex;
+        void *freelist[N_SIZE_CLASSES];
+        struct pool *pools; /* all pools ever allocated */
+} depot = {
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static pthread_once_t depot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+
+static unsigned size_to_class(size_t size) {
+        for (unsigned i = 0; i < N_SIZE_CLASSES; i++)
+                if (size <= size_classes[i])
+                        return i;
+
+        assert_not_reached();
+}
+
+static void cache_release(void *p) {
+        struct cache *c = p;
+
+        /* Called when a thread exits. Everything it holds is moved to the depot, so that other threads may
+         * reuse it. Not-yet-used tiles of its pools are added to its freelists first. */
+
+        assert(c);
+
+        for (unsigned i = 0; i < N_SIZE_CLASSES; i++) {
+                struct pool *pool = c->pool[i];
+                void **tail;
+
+                if (pool)
+                        for (; pool->n_used < pool->n_tiles; pool->n_used++) {
+                                void *t = (uint8_t*) pool + POOL_HEADER_SIZE + pool->n_used * pool->tile_size;
+
+                                *(void**) t = c->freelist[i];
+                                c->freelist[i] = t;
+                        }
+
+                c->pool[i] = NULL;
+
+                if (!c->freelist[i])
+                        continue;
+
+                for (tail = c->freelist + i; *tail; tail = *tail)
+                        ;
+
+                _unused_ _cleanup_(pthread_mutex_unlock_assertp) pthread_mutex_t *m =
+                        pthread_mutex_lock_assert(&depot.mutex);
+
+                *tail = depot.freelist[i];
+                depot.freelist[i] = TAKE_PTR(c->freelist[i]);
+        }
+
+        c->initialized = false;
+}
+
+static void depot_lock(void) {
+        assert_se(pthread_mutex_lock(&depot.mutex) == 0);
+}
+
+static void depot_unlock(void) {
+        assert_se(pthread_mutex_unlock(&depot.mutex) == 0);
+}
+
+static void depot_init(void) {
+        /* Make sure the depot lock is not held by some other thread in a forked off child */
+        assert_se(pthread_atfork(depot_lock, depot_unlock, depot_unlock) == 0);
+        assert_se(pthread_key_create(&cache_key, cache_release) == 0);
+}
+
+static void cache_init(void) {
+        if (_likely_(cache.initialized))
+                return;
 
-        if (mp->freelist) {
-                void *r;
+        /* The key only exists so that cache_release() is called when the thread exits */
+        assert_se(pthread_once(&depot_once, depot_init) == 0);
+        assert_se(pthread_setspecific(cache_key, &cache) == 0);
+        cache.initialized = true;
+}
+
+static void* alloc_class(unsigned i, unsigned at_least) {
+        struct pool *pool;
+        void *r;
+
+        assert(i < N_SIZE_CLASSES);
 
-                r = mp->freelist;
-                mp->freelist = * (void**) mp->freelist;
+        /* When a tile is released we add it to the list and simply place the next pointer at its
+         * offset 0. */
+
+        if (cache.freelist[i]) {
+                r = cache.freelist[i];
+                cache.freelist[i] = *(void**) r;
                 return r;
         }
 
-        if (_unlikely_(!mp->first_pool) ||
-            _unlikely_(mp->first_pool->n_used >= mp->first_pool->n_tiles)) {
+        cache_init();
+
+        pool = cache.pool[i];
+        if (_unlikely_(!pool || pool->n_used >= pool->n_tiles)) {
                 size_t size, n;
-                struct pool *p;
 
-                n = mp->first_pool ? mp->first_pool->n_tiles : 0;
-                n = MAX(mp->at_least, n * 2);
-                size = PAGE_ALIGN(ALIGN(sizeof(struct pool)) + n*mp->tile_size);
-                n = (size - ALIGN(sizeof(struct pool))) / mp->tile_size;
+                _unused_ _cleanup_(pthread_mutex_unlock_assertp) pthread_mutex_t *m =
+                        pthread_mutex_lock_assert(&depot.mutex);
 
-                p = malloc(size);
-                if (!p)
+                /* Take over whatever exited threads left behind, before allocating more memory */
+                if (depot.freelist[i]) {
+                        r = depot.freelist[i];
+                        cache.freelist[i] = *(void**) r;
+                        depot.freelist[i] = NULL;
+                        return r;
+                }
+
+                n = pool ? pool->n_tiles : 0;
+                n = MAX3((size_t) at_least, (size_t) POOL_TILES_MIN, n * 2);
+                size = PAGE_ALIGN(POOL_HEADER_SIZE + n * size_classes[i]);
+                n = (size - POOL_HEADER_SIZE) / size_classes[i];
+
+                pool = malloc(size);
+                if (!pool)
                         return NULL;
 
-                p->next = mp->first_pool;
-                p->n_tiles = n;
-                p->n_used = 0;
+                *pool = (struct pool) {
+                        .next = depot.pools,
+                        .n_tiles = n,
+                        .tile_size = size_classes[i],
+                };
 
-                mp->first_pool = p;
+                depot.pools = cache.pool[i] = pool;
         }
 
-        i = mp->first_pool->n_used++;
+        return (uint8_t*) pool + POOL_HEADER_SIZE + pool->n_used++ * pool->tile_size;
+}
+
+static void free_class(unsigned i, void *p) {
+        assert(i < N_SIZE_CLASSES);
 
-        return ((uint8_t*) mp->first_pool) + ALIGN(sizeof(struct pool)) + i*mp->tile_size;
+        if (!p)
+                return;
+
+        *(void**) p = cache.freelist[i];
+        cache.freelist[i] = p;
+
+        /* Tiles freed by a thread that never allocated must reach the depot on exit, too */
+        cache_init();
+}
+
+void* mempool_alloc_tile(struct mempool *mp) {
+        assert(mp);
+        assert(mp->tile_size >= sizeof(void*));
+        assert(mp->tile_size <= MEMPOOL_TILE_MAX);
+        assert(mp->at_least > 0);
+
+        return alloc_class(size_to_class(mp->tile_size), mp->at_least);
 }
 
 void* mempool_alloc0_tile(struct mempool *mp) {
@@ -69,32 +211,66 @@ void* mempool_alloc0_tile(struct mempool *mp) {
 }
 
 void mempool_free_tile(struct mempool *mp, void *p) {
-        * (void**) p = mp->freelist;
-        mp->freelist = p;
+        assert(mp);
+
+        free_class(size_to_class(mp->tile_size), p);
+}
+
+void* mempool_alloc(size_t size) {
+        if (size > MEMPOOL_TILE_MAX || !mempool_enabled())
+                return malloc(MAX(size, 1U));
+
+        return alloc_class(size_to_class(MAX(size, sizeof(void*))), 0);
+}
+
+void* mempool_alloc0(size_t size) {
+        void *p;
+
+        p = mempool_alloc(size);
+        if (p)
+                memzero(p, size);
+        return p;
+}
+
+void mempool_free(void *p, size_t size) {
+        if (size > MEMPOOL_TILE_MAX || !mempool_enabled())
+                free(p);
+        else
+                free_class(size_to_class(MAX(size, sizeof(void*))), p);
 }
 
 bool mempool_enabled(void) {
         static int b = -1;
 
-        if (!is_main_thread())
-                return false;
+        /* The answer must never change during the lifetime of the process, since mempool_free() relies on
+         * it. Threads racing to initialize it all come to the same conclusion. */
+
+        if (_unlikely_(b < 0)) {
+                int r;
 
-        if (!mempool_use_allowed)
-                b = false;
-        if (b < 0)
-                b = getenv_bool("SYSTEMD_MEMPOOL") != 0;
+                r = getenv_bool("SYSTEMD_MEMPOOL");
+                b = r >= 0 ? r : mempool_use_allowed;
+        }
 
         return b;
 }
 
 #if VALGRIND
-void mempool_drop(struct mempool *mp) {
-        struct pool *p = mp->first_pool;
+void mempool_drop(void) {
+        struct pool *p;
+
+        /* Only safe to call when no other threads are live */
+
+        p = TAKE_PTR(depot.pools);
         while (p) {
                 struct pool *n;
                 n = p->next;
                 free(p);
                 p = n;
         }
+
+        zero(depot.freelist);
+        zero(cache.freelist);
+        zero(cache.pool);
 }
 #endif
@@ -4,11 +4,14 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-struct pool;
+/* A slab allocator for small objects. Tiles are served from a number of size classes, each with a per-thread
+ * cache, so allocation and release need no locking in the common case and tiles may be freed from a
+ * different thread than they were allocated in. Memory is never returned to the system. */
+
+/* Objects larger than this are not served from the pool */
+#define MEMPOOL_TILE_MAX 1024U
 
 struct mempool {
-        struct pool *first_pool;
-        void *freelist;
         size_t tile_size;
         unsigned at_least;
 };
@@ -23,9 +26,19 @@ static struct mempool pool_name = { \
         .at_least = alloc_at_least, \
 }
 
+/* Allocate from the pool if it is enabled and the size fits a size class, and from the heap otherwise. The
+ * same size must be passed when freeing. */
+void* mempool_alloc(size_t size);
+void* mempool_alloc0(size_t size);
+void mempool_free(void *p, size_t size);
+
+#define mempool_new(t) ((t*) mempool_alloc(sizeof(t)))
+#define mempool_new0(t) ((t*) mempool_alloc0(sizeof(t)))
+
+/* Whether the pool is used if $SYSTEMD_MEMPOOL is not set */
 extern const bool mempool_use_allowed;
 bool mempool_enabled(void);
 
 #if VALGRIND
-void mempool_drop(struct mempool *mp);
+void mempool_drop(void);
 #endif
@@ -428,6 +428,43 @@ static inline int missing_epoll_pwait2(
 
 /* ======================================================================= */
 
+#if !HAVE_IO_URING_SETUP
+struct io_uring_params;
+
+static inline int missing_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+#  ifdef __NR_io_uring_setup
+        return syscall(__NR_io_uring_setup, entries, p);
+#  else
+        errno = ENOSYS;
+        return -1;
+#  endif
+}
+
+#  define io_uring_setup missing_io_uring_setup
+#endif
+
+#if !HAVE_IO_URING_ENTER
+static inline int missing_io_uring_enter(
+                int fd,
+                unsigned to_submit,
+                unsigned min_complete,
+                unsigned flags,
+                const void *arg,
+                size_t argsz) {
+
+#  ifdef __NR_io_uring_enter
+        return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+#  else
+        errno = ENOSYS;
+        return -1;
+#  endif
+}
+
+#  define io_uring_enter missing_io_uring_enter
+#endif
+
+/* ======================================================================= */
+
 #if !HAVE_MOUNT_SETATTR
 
 #if !HAVE_STRUCT_MOUNT_ATTR
@@ -441,6 +478,22 @@ struct mount_attr {
 struct mount_attr;
 #endif
 
+#ifndef MOUNT_ATTR_RDONLY
+#define MOUNT_ATTR_RDONLY 0x00000001
+#endif
+
+#ifndef MOUNT_ATTR_NOSUID
+#define MOUNT_ATTR_NOSUID 0x00000002
+#endif
+
+#ifndef MOUNT_ATTR_NODEV
+#define MOUNT_ATTR_NODEV 0x00000004
+#endif
+
+#ifndef MOUNT_ATTR_NOEXEC
+#define MOUNT_ATTR_NOEXEC 0x00000008
+#endif
+
 #ifndef MOUNT_ATTR_IDMAP
 #define MOUNT_ATTR_IDMAP 0x00100000
 #endif
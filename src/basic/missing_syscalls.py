@@ -11,6 +11,8 @@ SYSCALLS = [
     'copy_file_range',
     'epoll_pwait2',
     'getrandom',
+    'io_uring_enter',
+    'io_uring_setup',
     'memfd_create',
     'mount_setattr',
     'move_mount',
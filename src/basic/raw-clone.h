@@ -7,10 +7,13 @@
 
 #include <errno.h>
 #include <sched.h>
+#include <signal.h>
+#include <stdint.h>
 #include <sys/syscall.h>
 
 #include "log.h"
 #include "macro.h"
+#include "missing_sched.h"
 
 /**
  * raw_clone() - uses clone to create a new process with clone flags
@@ -77,3 +80,54 @@ static inline pid_t raw_clone(unsigned long flags) {
 
         return ret;
 }
+
+/* The layout of struct clone_args of clone3(), up to and including the cgroup field, i.e. what the kernel
+ * calls CLONE_ARGS_SIZE_VER2. Defined at include/uapi/linux/sched.h */
+struct raw_clone_args {
+        uint64_t flags;
+        uint64_t pidfd;
+        uint64_t child_tid;
+        uint64_t parent_tid;
+        uint64_t exit_signal;
+        uint64_t stack;
+        uint64_t stack_size;
+        uint64_t tls;
+        uint64_t set_tid;
+        uint64_t set_tid_size;
+        uint64_t cgroup;
+};
+
+/**
+ * raw_clone_into_cgroup() - creates a new process directly in the specified cgroup
+ * @cgroup_fd: An fd opened for reading on the directory of a cgroup on the unified hierarchy
+ *
+ * Like raw_clone(SIGCHLD), i.e. like fork(), but uses clone3() with CLONE_INTO_CGROUP to create the child
+ * in the specified cgroup right away, so that it never runs outside of it and doesn't have to be migrated
+ * later. The same restrictions as for raw_clone() apply.
+ *
+ * Returns: 0 in the child process and the child process id in the parent, -1 with errno set on failure.
+ * errno is ENOSYS or E2BIG if the kernel doesn't support clone3() or CLONE_INTO_CGROUP.
+ */
+static inline pid_t raw_clone_into_cgroup(int cgroup_fd) {
+        pid_t ret;
+
+        assert(cgroup_fd >= 0);
+
+#if defined(__NR_clone3) && !defined(__sparc__)
+        struct raw_clone_args args = {
+                .flags = CLONE_INTO_CGROUP,
+                .exit_signal = SIGCHLD,
+                .cgroup = (uint64_t) cgroup_fd,
+        };
+
+        ret = (pid_t) syscall(__NR_clone3, &args, sizeof(args));
+#else
+        errno = ENOSYS;
+        ret = -1;
+#endif
+
+        if (ret == 0)
+                reset_cached_pid();
+
+        return ret;
+}
@@ -77,6 +77,10 @@ static inline unsigned set_buckets(const Set *s) {
         return _hashmap_buckets(HASHMAP_BASE((Set *) s));
 }
 
+static inline void set_add_stats(const Set *s, HashmapStats *stats) {
+        _hashmap_add_stats(HASHMAP_BASE((Set *) s), stats);
+}
+
 static inline bool set_iterate(const Set *s, Iterator *i, void **value) {
         return _hashmap_iterate(HASHMAP_BASE((Set*) s), i, value, NULL);
 }
@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <pthread.h>
+
+#include "alloc-util.h"
+#include "pthread-util.h"
+#include "set.h"
+#include "string-intern.h"
+#include "string-util.h"
+#include "strv.h"
+
+typedef struct InternedString {
+        unsigned n_ref;
+        char s[];
+} InternedString;
+
+static pthread_mutex_t interned_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Set *interned = NULL; /* contains the 's' members of InternedString objects */
+
+static InternedString* interned_string_from_string(const char *s) {
+        return (InternedString*) (s - offsetof(InternedString, s));
+}
+
+const char* string_intern(const char *s) {
+        InternedString *i;
+        const char *found;
+        size_t l;
+
+        if (!s)
+                return NULL;
+
+        _unused_ _cleanup_(pthread_mutex_unlock_assertp) pthread_mutex_t *m =
+                pthread_mutex_lock_assert(&interned_mutex);
+
+        found = set_get(interned, s);
+        if (found) {
+                interned_string_from_string(found)->n_ref++;
+                return found;
+        }
+
+        l = strlen(s);
+        i = malloc(offsetof(InternedString, s) + l + 1);
+        if (!i)
+                return NULL;
+
+        i->n_ref = 1;
+        memcpy(i->s, s, l + 1);
+
+        if (set_ensure_put(&interned, &string_hash_ops, i->s) < 0) {
+                free(i);
+                return NULL;
+        }
+
+        return i->s;
+}
+
+const char* string_intern_ref(const char *s) {
+        if (!s)
+                return NULL;
+
+        _unused_ _cleanup_(pthread_mutex_unlock_assertp) pthread_mutex_t *m =
+                pthread_mutex_lock_assert(&interned_mutex);
+
+        assert(set_get(interned, s) == s);
+
+        interned_string_from_string(s)->n_ref++;
+        return s;
+}
+
+const char* string_intern_unref(const char *s) {
+        InternedString *i;
+
+        if (!s)
+                return NULL;
+
+        _unused_ _cleanup_(pthread_mutex_unlock_assertp) pthread_mutex_t *m =
+                pthread_mutex_lock_assert(&interned_mutex);
+
+        assert(set_get(interned, s) == s);
+
+        i = interned_string_from_string(s);
+        assert(i->n_ref > 0);
+
+        if (--i->n_ref > 0)
+                return NULL;
+
+        assert_se(set_remove(interned, s) == s);
+        if (set_isempty(interned))
+                interned = set_free(interned);
+
+        free(i);
+        return NULL;
+}
+
+int string_intern_replace(const char **p, const char *s) {
+        const char *t = NULL;
+
+        assert(p);
+
+        if (s) {
+                t = string_intern(s);
+                if (!t)
+                        return -ENOMEM;
+        }
+
+        if (string_intern_equal(*p, t)) {
+                string_intern_unref(t);
+                return 0;
+        }
+
+        string_intern_unref(*p);
+        *p = t;
+        return 1;
+}
+
+int strv_extend_interned(char ***a, char * const *b) {
+        size_t n, k = 0;
+        char * const *i;
+
+        assert(a);
+
+        if (strv_isempty((char**) b))
+                return 0;
+
+        n = strv_length(*a);
+
+        if (!GREEDY_REALLOC(*a, n + strv_length((char**) b) + 1))
+                return -ENOMEM;
+        (*a)[n] = NULL;
+
+        STRV_FOREACH(i, b) {
+                const char *t;
+
+                if (strv_contains(*a, *i))
+                        continue;
+
+                t = string_intern(*i);
+                if (!t)
+                        return -ENOMEM;
+
+                (*a)[n++] = (char*) t;
+                (*a)[n] = NULL;
+                k++;
+        }
+
+        return (int) k;
+}
+
+char** strv_free_interned(char **l) {
+        char **i;
+
+        STRV_FOREACH(i, l)
+                string_intern_unref(*i);
+
+        return mfree(l);
+}
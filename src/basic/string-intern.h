@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdbool.h>
+
+#include "macro.h"
+
+/* Interned strings are read-only, reference counted, and stored only once per process: interning equal
+ * strings returns the same pointer, hence two interned strings may be compared with string_intern_equal().
+ * This is useful for strings that many objects share, such as the unit file paths of template instances.
+ * Interned strings must only be released with string_intern_unref(), never with free(). Thread-safe. */
+
+const char* string_intern(const char *s);
+const char* string_intern_ref(const char *s);
+const char* string_intern_unref(const char *s);
+DEFINE_TRIVIAL_CLEANUP_FUNC(const char*, string_intern_unref);
+
+static inline bool string_intern_equal(const char *a, const char *b) {
+        return a == b;
+}
+
+/* Like free_and_strdup(), but for fields holding an interned string */
+int string_intern_replace(const char **p, const char *s);
+
+/* For string arrays whose elements are interned. Appends the elements of b not contained in *a yet. */
+int strv_extend_interned(char ***a, char * const *b);
+char** strv_free_interned(char **l);
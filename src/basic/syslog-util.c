@@ -7,8 +7,10 @@
 #include "glob-util.h"
 #include "hexdecoct.h"
 #include "macro.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "string-table.h"
+#include "string-util.h"
 #include "syslog-util.h"
 #include "unit-name.h"
 
@@ -129,3 +131,55 @@ bool log_namespace_name_valid(const char *s) {
 
         return true;
 }
+
+int log_namespace_shard_from_string(const char *s, char **ret_namespace, unsigned *ret_index) {
+        const char *e;
+        unsigned i;
+        int r;
+
+        assert(s);
+
+        /* Splits a shard name of the form "<namespace>:<index>" into its parts. Returns -EINVAL if the
+         * specified namespace is not a shard name. */
+
+        e = strrchr(s, ':');
+        if (!e || e == s || isempty(e + 1) || !in_charset(e + 1, DIGITS))
+                return -EINVAL;
+
+        r = safe_atou(e + 1, &i);
+        if (r < 0)
+                return r;
+
+        if (ret_namespace) {
+                char *n;
+
+                n = strndup(s, e - s);
+                if (!n)
+                        return -ENOMEM;
+
+                *ret_namespace = n;
+        }
+
+        if (ret_index)
+                *ret_index = i;
+
+        return 0;
+}
+
+int log_namespace_shard_name(const char *namespace, unsigned index, char **ret) {
+        char *s;
+
+        assert(namespace);
+        assert(ret);
+
+        if (asprintf(&s, "%s:%u", namespace, index) < 0)
+                return -ENOMEM;
+
+        if (!log_namespace_name_valid(s)) {
+                free(s);
+                return -EINVAL;
+        }
+
+        *ret = s;
+        return 0;
+}
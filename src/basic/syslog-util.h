@@ -14,3 +14,8 @@ bool log_level_is_valid(int level);
 int syslog_parse_priority(const char **p, int *priority, bool with_facility);
 
 bool log_namespace_name_valid(const char *s);
+
+/* A log namespace may be split into shards, via LogNamespaceShards= in the units using it. Each shard is a
+ * namespace of its own, named after the namespace with a ":" and the shard index appended. */
+int log_namespace_shard_from_string(const char *s, char **ret_namespace, unsigned *ret_index);
+int log_namespace_shard_name(const char *namespace, unsigned index, char **ret);
@@ -10,6 +10,7 @@
 #include "set.h"
 #include "special.h"
 #include "stat-util.h"
+#include "string-intern.h"
 #include "string-util.h"
 #include "strv.h"
 #include "unit-file.h"
@@ -235,12 +236,306 @@ bool lookup_paths_timestamp_hash_same(const LookupPaths *lp, uint64_t timestamp_
         return updated == timestamp_hash;
 }
 
+/* The paths in the map are interned, so that the units instantiated from one template, which all have
+ * the template's path as fragment path, don't need a copy of it each. */
+DEFINE_PRIVATE_HASH_OPS_FULL(unit_ids_hash_ops, char, string_hash_func, string_compare_func, free,
+                             char, string_intern_unref);
+
+static int unit_ids_map_put(Hashmap **ids, const char *name, const char *path) {
+        _cleanup_(string_intern_unrefp) const char *v = NULL;
+        _cleanup_free_ char *k = NULL;
+        int r;
+
+        assert(ids);
+        assert(name);
+        assert(path);
+
+        k = strdup(name);
+        if (!k)
+                return -ENOMEM;
+
+        v = string_intern(path);
+        if (!v)
+                return -ENOMEM;
+
+        r = hashmap_ensure_put(ids, &unit_ids_hash_ops, k, (char*) v);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(k);
+        TAKE_PTR(v);
+        return 0;
+}
+
+typedef struct UnitDirEntry {
+        char *name;             /* the file name in the directory */
+        char *path;             /* the full path of the file */
+        char *dst;              /* what the name maps to, a path or a unit name, NULL if not a usable unit */
+        int null_or_empty;      /* cached null_or_empty_path(dst), if dst is a path */
+        bool null_or_empty_set;
+} UnitDirEntry;
+
+typedef struct UnitDir {
+        bool valid;             /* false if the entries must not be reused */
+        uint64_t lookup_paths_hash;
+        dev_t dev;
+        ino_t ino;
+        usec_t mtime;
+
+        UnitDirEntry *entries;
+        size_t n_entries;
+} UnitDir;
+
+static UnitDir* unit_dir_free(UnitDir *d) {
+        if (!d)
+                return NULL;
+
+        for (size_t i = 0; i < d->n_entries; i++) {
+                free(d->entries[i].name);
+                free(d->entries[i].path);
+                free(d->entries[i].dst);
+        }
+        free(d->entries);
+
+        return mfree(d);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(UnitDir*, unit_dir_free);
+
+DEFINE_PRIVATE_HASH_OPS_FULL(unit_dir_hash_ops, char, path_hash_func, path_compare, free,
+                             UnitDir, unit_dir_free);
+
+static uint64_t lookup_paths_hash(const LookupPaths *lp) {
+        struct siphash state;
+        char **dir;
+
+        assert(lp);
+
+        /* How symlinks are resolved depends on the full search path and the root directory, hence cached
+         * directory contents are only valid as long as these stay the same. */
+
+        siphash24_init(&state, HASH_KEY.bytes);
+
+        STRV_FOREACH(dir, (char**) lp->search_path)
+                siphash24_compress_string(*dir, &state);
+        siphash24_compress_string(strempty(lp->root_dir), &state);
+
+        return siphash24_finalize(&state);
+}
+
+static int unit_dir_entry_resolve(
+                const LookupPaths *lp,
+                const char *dir,
+                int dir_fd,
+                const struct dirent *de,
+                UnitDirEntry *e) {
+
+        _cleanup_free_ char *target = NULL, *simplified = NULL;
+        const char *dst;
+        int r;
+
+        assert(lp);
+        assert(dir);
+        assert(de);
+        assert(e);
+
+        /* Determines what a unit file maps to, and stores it in e->dst. Returns 0 if the entry is to be
+         * ignored, 1 if it was resolved, and negative errno on OOM only. */
+
+        if (de->d_type != DT_LNK) {
+                log_debug("%s: normal unit file: %s", __func__, e->path);
+                return free_and_strdup(&e->dst, e->path);
+        }
+
+        /* We don't explicitly check for alias loops here. unit_ids_map_get() which
+         * limits the number of hops should be used to access the map. */
+
+        r = readlinkat_malloc(dir_fd, de->d_name, &target);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to read symlink %s/%s, ignoring: %m", dir, de->d_name);
+                return 0;
+        }
+
+        const bool is_abs = path_is_absolute(target);
+        if (lp->root_dir || !is_abs) {
+                char *target_abs = path_join(is_abs ? lp->root_dir : dir, target);
+                if (!target_abs)
+                        return -ENOMEM;
+
+                free_and_replace(target, target_abs);
+        }
+
+        /* Get rid of "." and ".." components in target path */
+        r = chase_symlinks(target, lp->root_dir, CHASE_NOFOLLOW | CHASE_NONEXISTENT, &simplified, NULL);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to resolve symlink %s pointing to %s, ignoring: %m",
+                                  e->path, target);
+                return 0;
+        }
+
+        /* Check if the symlink goes outside of our search path.
+         * If yes, it's a linked unit file or mask, and we don't care about the target name.
+         * Let's just store the link source directly.
+         * If not, let's verify that it's a good symlink. */
+        char *tail = path_startswith_strv(simplified, lp->search_path);
+        if (!tail) {
+                log_debug("%s: linked unit file: %s → %s", __func__, e->path, simplified);
+
+                dst = e->path;
+        } else {
+                bool self_alias;
+
+                dst = basename(simplified);
+                self_alias = streq(dst, de->d_name);
+
+                if (is_path(tail))
+                        log_full(self_alias ? LOG_DEBUG : LOG_WARNING,
+                                 "Suspicious symlink %s→%s, treating as alias.",
+                                 e->path, simplified);
+
+                r = unit_validate_alias_symlink_and_warn(e->path, simplified);
+                if (r < 0)
+                        return 0;
+
+                if (self_alias) {
+                        /* A self-alias that has no effect */
+                        log_debug("%s: self-alias: %s/%s → %s, ignoring.", __func__, dir, de->d_name, dst);
+                        return 0;
+                }
+
+                log_debug("%s: alias: %s/%s → %s", __func__, dir, de->d_name, dst);
+        }
+
+        return free_and_strdup(&e->dst, dst);
+}
+
+static void unit_dir_forget(Hashmap *dirs, const char *path) {
+        _cleanup_free_ char *key = NULL;
+        UnitDir *d;
+
+        d = hashmap_remove2(dirs, path, (void**) &key);
+        unit_dir_free(d);
+}
+
+static int unit_dir_get(
+                const LookupPaths *lp,
+                const char *path,
+                uint64_t lp_hash,
+                Hashmap **dirs,
+                UnitDir **ret) {
+
+        _cleanup_(unit_dir_freep) UnitDir *d = NULL;
+        _cleanup_closedir_ DIR *dir = NULL;
+        _cleanup_free_ char *key = NULL;
+        struct dirent *de;
+        struct stat st;
+        UnitDir *cached;
+        int r;
+
+        assert(lp);
+        assert(path);
+        assert(dirs);
+        assert(ret);
+
+        /* Returns the unit files in the specified directory, from the cache if the directory didn't change
+         * since we last read it, or NULL if the directory can't be read. Generated units are not covered,
+         * since we don't watch the modification times of the generator directories, see
+         * lookup_paths_mtime_exclude(). */
+
+        cached = hashmap_get(*dirs, path);
+        if (cached &&
+            cached->valid &&
+            cached->lookup_paths_hash == lp_hash &&
+            stat(path, &st) >= 0 &&
+            cached->dev == st.st_dev &&
+            cached->ino == st.st_ino &&
+            cached->mtime == timespec_load(&st.st_mtim)) {
+                *ret = cached;
+                return 0;
+        }
+
+        unit_dir_forget(*dirs, path);
+
+        dir = opendir(path);
+        if (!dir) {
+                if (errno != ENOENT)
+                        log_warning_errno(errno, "Failed to open \"%s\", ignoring: %m", path);
+                *ret = NULL;
+                return 0;
+        }
+
+        /* Take the modification time before reading the directory. If anything is modified concurrently,
+         * the cached contents are considered outdated next time. */
+        if (fstat(dirfd(dir), &st) < 0) {
+                log_warning_errno(errno, "Failed to stat \"%s\", ignoring: %m", path);
+                *ret = NULL;
+                return 0;
+        }
+
+        d = new(UnitDir, 1);
+        if (!d)
+                return -ENOMEM;
+
+        *d = (UnitDir) {
+                .valid = !lookup_paths_mtime_exclude(lp, path),
+                .lookup_paths_hash = lp_hash,
+                .dev = st.st_dev,
+                .ino = st.st_ino,
+                .mtime = timespec_load(&st.st_mtim),
+        };
+
+        FOREACH_DIRENT(de, dir, log_warning_errno(errno, "Failed to read \"%s\", ignoring: %m", path);
+                                d->valid = false) {
+                UnitDirEntry *e;
+                bool valid_unit_name;
+
+                valid_unit_name = unit_name_is_valid(de->d_name, UNIT_NAME_ANY);
+
+                /* We only care about valid units and dirs with certain suffixes, let's ignore the
+                 * rest. */
+                if (!valid_unit_name &&
+                    !ENDSWITH_SET(de->d_name, ".wants", ".requires", ".d"))
+                        continue;
+
+                if (!GREEDY_REALLOC(d->entries, d->n_entries + 1))
+                        return -ENOMEM;
+
+                e = d->entries + d->n_entries++;
+                *e = (UnitDirEntry) {
+                        .name = strdup(de->d_name),
+                        .path = path_join(path, de->d_name),
+                };
+                if (!e->name || !e->path)
+                        return -ENOMEM;
+
+                if (!valid_unit_name)
+                        continue;
+
+                r = unit_dir_entry_resolve(lp, path, dirfd(dir), de, e);
+                if (r < 0)
+                        return r;
+        }
+
+        key = strdup(path);
+        if (!key)
+                return -ENOMEM;
+
+        r = hashmap_ensure_put(dirs, &unit_dir_hash_ops, key, d);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(key);
+        *ret = TAKE_PTR(d);
+        return 0;
+}
+
 int unit_file_build_name_map(
                 const LookupPaths *lp,
                 uint64_t *cache_timestamp_hash,
                 Hashmap **unit_ids_map,
                 Hashmap **unit_names_map,
-                Set **path_cache) {
+                Set **path_cache,
+                Hashmap **dir_cache) {
 
         /* Build two mappings: any name → main unit (i.e. the end result of symlink resolution), unit name →
          * all aliases (i.e. the entry for a given key is a list of all names which point to this key). The
@@ -250,11 +545,14 @@ int unit_file_build_name_map(
          *
          * At the same, build a cache of paths where to find units. The non-const parameters are for input
          * and output. Existing contents will be freed before the new contents are stored.
+         *
+         * If dir_cache is specified, the contents of the search path directories are kept there, and only
+         * the directories which were modified since are read again next time.
          */
 
-        _cleanup_hashmap_free_ Hashmap *ids = NULL, *names = NULL;
+        _cleanup_hashmap_free_ Hashmap *ids = NULL, *names = NULL, *dirs = NULL, *fragments = NULL;
         _cleanup_set_free_free_ Set *paths = NULL;
-        uint64_t timestamp_hash;
+        uint64_t timestamp_hash, lp_hash;
         char **dir;
         int r;
 
@@ -273,129 +571,48 @@ int unit_file_build_name_map(
                         return log_oom();
         }
 
-        STRV_FOREACH(dir, (char**) lp->search_path) {
-                struct dirent *de;
-                _cleanup_closedir_ DIR *d = NULL;
-
-                d = opendir(*dir);
-                if (!d) {
-                        if (errno != ENOENT)
-                                log_warning_errno(errno, "Failed to open \"%s\", ignoring: %m", *dir);
-                        continue;
-                }
+        if (!dir_cache)
+                dir_cache = &dirs; /* Only keep the directory contents until we are done */
 
-                FOREACH_DIRENT(de, d, log_warning_errno(errno, "Failed to read \"%s\", ignoring: %m", *dir)) {
-                        char *filename;
-                        _cleanup_free_ char *_filename_free = NULL, *simplified = NULL;
-                        const char *suffix, *dst = NULL;
-                        bool valid_unit_name;
+        lp_hash = lookup_paths_hash(lp);
 
-                        valid_unit_name = unit_name_is_valid(de->d_name, UNIT_NAME_ANY);
+        STRV_FOREACH(dir, (char**) lp->search_path) {
+                UnitDir *d;
 
-                        /* We only care about valid units and dirs with certain suffixes, let's ignore the
-                         * rest. */
-                        if (!valid_unit_name &&
-                            !ENDSWITH_SET(de->d_name, ".wants", ".requires", ".d"))
-                                continue;
+                r = unit_dir_get(lp, *dir, lp_hash, dir_cache, &d);
+                if (r < 0)
+                        return log_oom();
+                if (!d)
+                        continue;
 
-                        filename = path_join(*dir, de->d_name);
-                        if (!filename)
-                                return log_oom();
+                for (size_t i = 0; i < d->n_entries; i++) {
+                        UnitDirEntry *e = d->entries + i;
 
                         if (paths) {
-                                r = set_put(paths, filename);
+                                r = set_put_strdup_full(&paths, &path_hash_ops_free, e->path);
                                 if (r < 0)
                                         return log_oom();
-                                if (r == 0)
-                                        _filename_free = filename; /* Make sure we free the filename. */
-                        } else
-                                _filename_free = filename; /* Make sure we free the filename. */
+                        }
 
-                        if (!valid_unit_name)
+                        if (!e->dst)
                                 continue;
-                        assert_se(suffix = strrchr(de->d_name, '.'));
 
                         /* search_path is ordered by priority (highest first). If the name is already mapped
                          * to something (incl. itself), it means that we have already seen it, and we should
                          * ignore it here. */
-                        if (hashmap_contains(ids, de->d_name))
+                        if (hashmap_contains(ids, e->name))
                                 continue;
 
-                        if (de->d_type == DT_LNK) {
-                                /* We don't explicitly check for alias loops here. unit_ids_map_get() which
-                                 * limits the number of hops should be used to access the map. */
-
-                                _cleanup_free_ char *target = NULL;
-
-                                r = readlinkat_malloc(dirfd(d), de->d_name, &target);
-                                if (r < 0) {
-                                        log_warning_errno(r, "Failed to read symlink %s/%s, ignoring: %m",
-                                                          *dir, de->d_name);
-                                        continue;
-                                }
-
-                                const bool is_abs = path_is_absolute(target);
-                                if (lp->root_dir || !is_abs) {
-                                        char *target_abs = path_join(is_abs ? lp->root_dir : *dir, target);
-                                        if (!target_abs)
-                                                return log_oom();
-
-                                        free_and_replace(target, target_abs);
-                                }
-
-                                /* Get rid of "." and ".." components in target path */
-                                r = chase_symlinks(target, lp->root_dir, CHASE_NOFOLLOW | CHASE_NONEXISTENT, &simplified, NULL);
-                                if (r < 0) {
-                                        log_warning_errno(r, "Failed to resolve symlink %s pointing to %s, ignoring: %m",
-                                                          filename, target);
-                                        continue;
-                                }
-
-                                /* Check if the symlink goes outside of our search path.
-                                 * If yes, it's a linked unit file or mask, and we don't care about the target name.
-                                 * Let's just store the link source directly.
-                                 * If not, let's verify that it's a good symlink. */
-                                char *tail = path_startswith_strv(simplified, lp->search_path);
-                                if (!tail) {
-                                        log_debug("%s: linked unit file: %s → %s",
-                                                  __func__, filename, simplified);
-
-                                        dst = filename;
-                                } else {
-
-                                        bool self_alias;
-
-                                        dst = basename(simplified);
-                                        self_alias = streq(dst, de->d_name);
-
-                                        if (is_path(tail))
-                                                log_full(self_alias ? LOG_DEBUG : LOG_WARNING,
-                                                         "Suspicious symlink %s→%s, treating as alias.",
-                                                         filename, simplified);
-
-                                        r = unit_validate_alias_symlink_and_warn(filename, simplified);
-                                        if (r < 0)
-                                                continue;
-
-                                        if (self_alias) {
-                                                /* A self-alias that has no effect */
-                                                log_debug("%s: self-alias: %s/%s → %s, ignoring.",
-                                                          __func__, *dir, de->d_name, dst);
-                                                continue;
-                                        }
-
-                                        log_debug("%s: alias: %s/%s → %s", __func__, *dir, de->d_name, dst);
-                                }
-
-                        } else {
-                                dst = filename;
-                                log_debug("%s: normal unit file: %s", __func__, dst);
-                        }
-
-                        r = hashmap_put_strdup(&ids, de->d_name, dst);
+                        r = unit_ids_map_put(&ids, e->name, e->dst);
                         if (r < 0)
                                 return log_warning_errno(r, "Failed to add entry to hashmap (%s→%s): %m",
-                                                         de->d_name, dst);
+                                                         e->name, e->dst);
+
+                        if (is_path(e->dst)) {
+                                r = hashmap_ensure_put(&fragments, &path_hash_ops, e->dst, e);
+                                if (r < 0)
+                                        return log_oom();
+                        }
                 }
         }
 
@@ -409,7 +626,13 @@ int unit_file_build_name_map(
                 if (r < 0)
                         continue;
 
-                if (null_or_empty_path(dst) != 0)
+                UnitDirEntry *e = hashmap_get(fragments, dst);
+                if (e && !e->null_or_empty_set) {
+                        e->null_or_empty = null_or_empty_path(dst);
+                        e->null_or_empty_set = true;
+                }
+
+                if ((e ? e->null_or_empty : null_or_empty_path(dst)) != 0)
                         continue;
 
                 dst = basename(dst);
@@ -49,7 +49,8 @@ int unit_file_build_name_map(
                 uint64_t *cache_timestamp_hash,
                 Hashmap **unit_ids_map,
                 Hashmap **unit_names_map,
-                Set **path_cache);
+                Set **path_cache,
+                Hashmap **dir_cache);
 
 int unit_file_find_fragment(
                 Hashmap *unit_ids_map,
@@ -123,6 +123,43 @@ int utf8_encoded_to_unichar(const char *str, char32_t *ret_unichar) {
         return 0;
 }
 
+/* Helpers for processing a machine word of bytes at a time, see
+ * https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord */
+#define WORD_ONES (SIZE_MAX / 0xFF)
+#define WORD_HIGHS (WORD_ONES * 0x80)
+#define WORD_HAS_LESS(w, n) ((((w) - WORD_ONES * (n)) & ~(w) & WORD_HIGHS) != 0)
+#define WORD_HAS_VALUE(w, n) WORD_HAS_LESS((w) ^ (WORD_ONES * (n)), 1)
+
+static size_t ascii_prefix_len(const char *str, size_t length, bool printable) {
+        size_t i = 0;
+
+        /* Returns the length of the initial run of ASCII characters other than NUL, or — if 'printable' is
+         * true — of printable ASCII characters, i.e. ' '…'~'. Everything else is left to the caller. Most
+         * strings we deal with are (mostly) ASCII, hence looking at a word at a time pays off. */
+
+        for (; i + sizeof(size_t) <= length; i += sizeof(size_t)) {
+                size_t w;
+
+                memcpy(&w, str + i, sizeof(w));
+
+                if (w & WORD_HIGHS)
+                        break;
+                if (printable ? WORD_HAS_LESS(w, ' ') || WORD_HAS_VALUE(w, 0x7F) : WORD_HAS_LESS(w, 1))
+                        break;
+        }
+
+        for (; i < length; i++) {
+                uint8_t c = str[i];
+
+                if (c >= 0x80 || c == 0)
+                        break;
+                if (printable && (c < ' ' || c == 0x7F))
+                        break;
+        }
+
+        return i;
+}
+
 bool utf8_is_printable_newline(const char* str, size_t length, bool allow_newline) {
         const char *p;
 
@@ -131,6 +168,13 @@ bool utf8_is_printable_newline(const char* str, size_t length, bool allow_newlin
         for (p = str; length > 0;) {
                 int encoded_len, r;
                 char32_t val;
+                size_t k;
+
+                k = ascii_prefix_len(p, length, /* printable= */ true);
+                p += k;
+                length -= k;
+                if (length == 0)
+                        break;
 
                 encoded_len = utf8_encoded_valid_unichar(p, length);
                 if (encoded_len < 0)
@@ -156,18 +200,26 @@ char *utf8_is_valid_n(const char *str, size_t len_bytes) {
 
         assert(str);
 
-        for (const char *p = str; len_bytes != SIZE_MAX ? (size_t) (p - str) < len_bytes : *p != '\0'; ) {
+        /* libc is quick at finding the end of the string, and knowing it allows us to look at whole words
+         * below */
+        if (len_bytes == SIZE_MAX)
+                len_bytes = strlen(str);
+
+        for (size_t i = 0; i < len_bytes; ) {
                 int len;
 
-                if (_unlikely_(*p == '\0') && len_bytes != SIZE_MAX)
+                i += ascii_prefix_len(str + i, len_bytes - i, /* printable= */ false);
+                if (i >= len_bytes)
+                        break;
+
+                if (_unlikely_(str[i] == '\0'))
                         return NULL; /* embedded NUL */
 
-                len = utf8_encoded_valid_unichar(p,
-                                                 len_bytes != SIZE_MAX ? len_bytes - (p - str) : SIZE_MAX);
+                len = utf8_encoded_valid_unichar(str + i, len_bytes - i);
                 if (_unlikely_(len < 0))
                         return NULL; /* invalid character */
 
-                p += len;
+                i += len;
         }
 
         return (char*) str;
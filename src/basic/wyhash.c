@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "macro.h"
+#include "unaligned.h"
+#include "wyhash.h"
+
+/* The default secret of wyhash */
+static const uint64_t secret[4] = {
+        UINT64_C(0xa0761d6478bd642f),
+        UINT64_C(0xe7037ed1a0b428db),
+        UINT64_C(0x8ebc6af09c88c6e3),
+        UINT64_C(0x589965cc75374cc3),
+};
+
+static void mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+        __uint128_t r = (__uint128_t) *a * *b;
+
+        *a = (uint64_t) r;
+        *b = (uint64_t) (r >> 64);
+#else
+        /* 64×64→128 bit multiplication for archs without native support */
+        uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b, hi, lo;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+
+        lo = t + (rm1 << 32);
+        c += lo < t;
+        hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+
+        *a = lo;
+        *b = hi;
+#endif
+}
+
+static uint64_t mix(uint64_t a, uint64_t b) {
+        mum(&a, &b);
+        return a ^ b;
+}
+
+static uint64_t read3(const uint8_t *p, size_t n) {
+        return ((uint64_t) p[0] << 16) | ((uint64_t) p[n >> 1] << 8) | p[n - 1];
+}
+
+uint64_t wyhash(const void *_p, size_t n, uint64_t seed) {
+        const uint8_t *p = _p;
+        uint64_t a, b;
+
+        assert(p || n == 0);
+
+        seed ^= mix(seed ^ secret[0], secret[1]);
+
+        if (_likely_(n <= 16)) {
+                if (_likely_(n >= 4)) {
+                        /* Two overlapping pairs of 32bit words cover all of the input */
+                        a = ((uint64_t) unaligned_read_le32(p) << 32) | unaligned_read_le32(p + ((n >> 3) << 2));
+                        b = ((uint64_t) unaligned_read_le32(p + n - 4) << 32) | unaligned_read_le32(p + n - 4 - ((n >> 3) << 2));
+                } else if (_likely_(n > 0)) {
+                        a = read3(p, n);
+                        b = 0;
+                } else
+                        a = b = 0;
+        } else {
+                size_t i = n;
+
+                if (_unlikely_(i > 48)) {
+                        uint64_t see1 = seed, see2 = seed;
+
+                        do {
+                                seed = mix(unaligned_read_le64(p) ^ secret[1], unaligned_read_le64(p + 8) ^ seed);
+                                see1 = mix(unaligned_read_le64(p + 16) ^ secret[2], unaligned_read_le64(p + 24) ^ see1);
+                                see2 = mix(unaligned_read_le64(p + 32) ^ secret[3], unaligned_read_le64(p + 40) ^ see2);
+                                p += 48;
+                                i -= 48;
+                        } while (_likely_(i > 48));
+
+                        seed ^= see1 ^ see2;
+                }
+
+                while (_unlikely_(i > 16)) {
+                        seed = mix(unaligned_read_le64(p) ^ secret[1], unaligned_read_le64(p + 8) ^ seed);
+                        p += 16;
+                        i -= 16;
+                }
+
+                /* The last 16 bytes, possibly overlapping with what was already consumed */
+                a = unaligned_read_le64(p + i - 16);
+                b = unaligned_read_le64(p + i - 8);
+        }
+
+        a ^= secret[1];
+        b ^= seed;
+        mum(&a, &b);
+
+        return mix(a ^ secret[0] ^ n, b ^ secret[1]);
+}
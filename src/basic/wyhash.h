@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "macro.h"
+
+/* A fast keyed hash function, following the construction of wyhash (final version 4). It's several times
+ * faster than SipHash on short inputs, but it is not a PRF: it makes no claims about resisting collisions
+ * chosen by somebody who doesn't know the seed. Hence, only use it for data that is not under control of
+ * unprivileged parties. */
+uint64_t wyhash(const void *p, size_t n, uint64_t seed) _pure_;
+
+static inline uint64_t wyhash_string(const char *s, uint64_t seed) {
+        return wyhash(s, strlen(s), seed);
+}
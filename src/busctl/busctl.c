@@ -1315,9 +1315,9 @@ static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f
 
                 if (m) {
                         dump(m, stdout);
-                        fflush(stdout);
 
                         if (sd_bus_message_is_signal(m, "org.freedesktop.DBus.Local", "Disconnected") > 0) {
+                                fflush(stdout);
                                 log_info("Connection terminated, exiting.");
                                 return 0;
                         }
@@ -1328,6 +1328,10 @@ static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f
                 if (r > 0)
                         continue;
 
+                /* Only flush the output once all queued messages are processed, so that we don't do a
+                 * write() for each message when the bus is busy, and fall behind. */
+                fflush(stdout);
+
                 r = sd_bus_wait(bus, UINT64_MAX);
                 if (r < 0)
                         return log_error_errno(r, "Failed to wait for bus: %m");
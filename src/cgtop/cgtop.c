@@ -460,6 +460,10 @@ static int refresh_one(
         if (r < 0)
                 return r;
 
+        /* Children would be beyond the maximum depth, and hence ignored anyway, don't bother enumerating them */
+        if (depth >= arg_depth)
+                goto finish;
+
         r = cg_enumerate_subgroups(controller, path, &d);
         if (r == -ENOENT)
                 return 0;
@@ -503,6 +507,7 @@ static int refresh_one(
                 }
         }
 
+finish:
         if (ret)
                 *ret = ours;
 
@@ -511,9 +516,21 @@ static int refresh_one(
 
 static int refresh(const char *root, Hashmap *a, Hashmap *b, unsigned iteration) {
         const char *c;
-        int r;
+        int r, all_unified;
+
+        all_unified = cg_all_unified();
+        if (all_unified < 0)
+                return all_unified;
 
         FOREACH_STRING(c, SYSTEMD_CGROUP_CONTROLLER, "cpu", "cpuacct", "memory", "io", "blkio", "pids") {
+
+                /* On the unified hierarchy all controllers share the same tree, hence skip walking it for
+                 * controllers process() has nothing to read for. */
+                if (all_unified &&
+                    (STR_IN_SET(c, "cpuacct", "blkio") ||
+                     (streq(c, "pids") && arg_count != COUNT_PIDS)))
+                        continue;
+
                 r = refresh_one(c, root, a, b, iteration, 0, NULL);
                 if (r < 0)
                         return r;
@@ -360,47 +360,65 @@ static int bpf_firewall_count_access_items(IPAddressAccessItem *list, size_t *n_
         return 0;
 }
 
-static int bpf_firewall_add_access_items(
+#define KEY_SIZE_IPV4 (offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t))
+#define KEY_SIZE_IPV6 (offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t) * 4)
+
+static void bpf_firewall_add_access_items(
                 IPAddressAccessItem *list,
-                int ipv4_map_fd,
-                int ipv6_map_fd,
-                int verdict) {
+                uint8_t *keys_ipv4,
+                size_t *n_ipv4,
+                uint8_t *keys_ipv6,
+                size_t *n_ipv6) {
 
-        struct bpf_lpm_trie_key *key_ipv4, *key_ipv6;
-        uint64_t value = verdict;
+        struct bpf_lpm_trie_key *key;
         IPAddressAccessItem *a;
-        int r;
 
-        key_ipv4 = alloca0(offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t));
-        key_ipv6 = alloca0(offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t) * 4);
+        assert(n_ipv4);
+        assert(n_ipv6);
+
+        /* Serializes the items into the key arrays, which have been sized with
+         * bpf_firewall_count_access_items() before, hence all addresses are of a known family. */
 
         LIST_FOREACH(items, a, list) {
                 switch (a->family) {
 
                 case AF_INET:
-                        key_ipv4->prefixlen = a->prefixlen;
-                        memcpy(key_ipv4->data, &a->address, sizeof(uint32_t));
-
-                        r = bpf_map_update_element(ipv4_map_fd, key_ipv4, &value);
-                        if (r < 0)
-                                return r;
-
+                        key = (struct bpf_lpm_trie_key*) (keys_ipv4 + (*n_ipv4)++ * KEY_SIZE_IPV4);
+                        key->prefixlen = a->prefixlen;
+                        memcpy(key->data, &a->address, sizeof(uint32_t));
                         break;
 
                 case AF_INET6:
-                        key_ipv6->prefixlen = a->prefixlen;
-                        memcpy(key_ipv6->data, &a->address, 4 * sizeof(uint32_t));
-
-                        r = bpf_map_update_element(ipv6_map_fd, key_ipv6, &value);
-                        if (r < 0)
-                                return r;
-
+                        key = (struct bpf_lpm_trie_key*) (keys_ipv6 + (*n_ipv6)++ * KEY_SIZE_IPV6);
+                        key->prefixlen = a->prefixlen;
+                        memcpy(key->data, &a->address, 4 * sizeof(uint32_t));
                         break;
 
                 default:
-                        return -EAFNOSUPPORT;
+                        assert_not_reached();
                 }
         }
+}
+
+static int bpf_firewall_update_elements(int map_fd, const uint8_t *keys, size_t key_size, const uint64_t *values, size_t n) {
+        int r;
+
+        assert(map_fd >= 0);
+
+        if (n == 0)
+                return 0;
+
+        /* Try to do it with a single syscall first, but that's not supported by all kernels and map types,
+         * hence fall back to one update per element, which will also tell us which element is the problem
+         * in case the batch update failed for other reasons. */
+        if (bpf_map_update_batch(map_fd, keys, values, n) >= 0)
+                return 0;
+
+        for (size_t i = 0; i < n; i++) {
+                r = bpf_map_update_element(map_fd, keys + i * key_size, (uint64_t*) values + i);
+                if (r < 0)
+                        return r;
+        }
 
         return 0;
 }
@@ -413,7 +431,9 @@ static int bpf_firewall_prepare_access_maps(
                 bool *ret_has_any) {
 
         _cleanup_close_ int ipv4_map_fd = -1, ipv6_map_fd = -1;
-        size_t n_ipv4 = 0, n_ipv6 = 0;
+        _cleanup_free_ uint8_t *keys_ipv4 = NULL, *keys_ipv6 = NULL;
+        _cleanup_free_ uint64_t *values = NULL;
+        size_t n_ipv4 = 0, n_ipv6 = 0, k_ipv4 = 0, k_ipv6 = 0;
         IPAddressAccessItem *list;
         Unit *p;
         int r;
@@ -431,7 +451,9 @@ static int bpf_firewall_prepare_access_maps(
 
                 list = verdict == ACCESS_ALLOWED ? cc->ip_address_allow : cc->ip_address_deny;
 
-                bpf_firewall_count_access_items(list, &n_ipv4, &n_ipv6);
+                r = bpf_firewall_count_access_items(list, &n_ipv4, &n_ipv6);
+                if (r < 0)
+                        return r;
 
                 /* Skip making the LPM trie map in cases where we are using "any" in order to hack around
                  * needing CAP_SYS_ADMIN for allocating LPM trie map. */
@@ -444,7 +466,7 @@ static int bpf_firewall_prepare_access_maps(
         if (n_ipv4 > 0) {
                 ipv4_map_fd = bpf_map_new(
                                 BPF_MAP_TYPE_LPM_TRIE,
-                                offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t),
+                                KEY_SIZE_IPV4,
                                 sizeof(uint64_t),
                                 n_ipv4,
                                 BPF_F_NO_PREALLOC);
@@ -455,7 +477,7 @@ static int bpf_firewall_prepare_access_maps(
         if (n_ipv6 > 0) {
                 ipv6_map_fd = bpf_map_new(
                                 BPF_MAP_TYPE_LPM_TRIE,
-                                offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t)*4,
+                                KEY_SIZE_IPV6,
                                 sizeof(uint64_t),
                                 n_ipv6,
                                 BPF_F_NO_PREALLOC);
@@ -463,6 +485,16 @@ static int bpf_firewall_prepare_access_maps(
                         return ipv6_map_fd;
         }
 
+        /* Collect the keys of the unit and all its slices, so that each map can be filled in one go */
+        keys_ipv4 = new(uint8_t, n_ipv4 * KEY_SIZE_IPV4);
+        keys_ipv6 = new(uint8_t, n_ipv6 * KEY_SIZE_IPV6);
+        values = new(uint64_t, MAX(n_ipv4, n_ipv6));
+        if (!keys_ipv4 || !keys_ipv6 || !values)
+                return -ENOMEM;
+
+        for (size_t i = 0; i < MAX(n_ipv4, n_ipv6); i++)
+                values[i] = verdict;
+
         for (p = u; p; p = UNIT_GET_SLICE(p)) {
                 CGroupContext *cc;
 
@@ -470,8 +502,21 @@ static int bpf_firewall_prepare_access_maps(
                 if (!cc)
                         continue;
 
-                r = bpf_firewall_add_access_items(verdict == ACCESS_ALLOWED ? cc->ip_address_allow : cc->ip_address_deny,
-                                                  ipv4_map_fd, ipv6_map_fd, verdict);
+                bpf_firewall_add_access_items(verdict == ACCESS_ALLOWED ? cc->ip_address_allow : cc->ip_address_deny,
+                                              keys_ipv4, &k_ipv4, keys_ipv6, &k_ipv6);
+        }
+
+        assert(k_ipv4 == n_ipv4);
+        assert(k_ipv6 == n_ipv6);
+
+        if (ipv4_map_fd >= 0) {
+                r = bpf_firewall_update_elements(ipv4_map_fd, keys_ipv4, KEY_SIZE_IPV4, values, n_ipv4);
+                if (r < 0)
+                        return r;
+        }
+
+        if (ipv6_map_fd >= 0) {
+                r = bpf_firewall_update_elements(ipv6_map_fd, keys_ipv6, KEY_SIZE_IPV6, values, n_ipv6);
                 if (r < 0)
                         return r;
         }
@@ -775,19 +820,13 @@ int bpf_firewall_read_accounting(int map_fd, uint64_t *ret_bytes, uint64_t *ret_
 }
 
 int bpf_firewall_reset_accounting(int map_fd) {
-        uint64_t key, value = 0;
-        int r;
+        const int keys[] = { MAP_KEY_PACKETS, MAP_KEY_BYTES };
+        const uint64_t values[] = { 0, 0 };
 
         if (map_fd < 0)
                 return -EBADF;
 
-        key = MAP_KEY_PACKETS;
-        r = bpf_map_update_element(map_fd, &key, &value);
-        if (r < 0)
-                return r;
-
-        key = MAP_KEY_BYTES;
-        return bpf_map_update_element(map_fd, &key, &value);
+        return bpf_firewall_update_elements(map_fd, (const uint8_t*) keys, sizeof(int), values, ELEMENTSOF(keys));
 }
 
 static int bpf_firewall_unsupported_reason = 0;
@@ -78,14 +78,51 @@ bool unit_has_host_root_cgroup(Unit *u) {
         return unit_has_name(u, SPECIAL_ROOT_SLICE);
 }
 
+static void unit_cgroup_attribute_cache_update(Unit *u, const char *attribute, const char *value) {
+        _cleanup_free_ char *k = NULL, *v = NULL;
+        char *old_key, *old_value;
+
+        assert(u);
+        assert(attribute);
+
+        old_value = hashmap_remove2(u->cgroup_attribute_cache, attribute, (void**) &old_key);
+        free(old_key);
+        free(old_value);
+
+        if (!value)
+                return;
+
+        /* If we can't remember the value, we'll just write it again next time */
+        k = strdup(attribute);
+        v = strdup(value);
+        if (!k || !v)
+                return;
+
+        if (hashmap_ensure_put(&u->cgroup_attribute_cache, &string_hash_ops_free_free, k, v) < 0)
+                return;
+
+        TAKE_PTR(k);
+        TAKE_PTR(v);
+}
+
 static int set_attribute_and_warn(Unit *u, const char *controller, const char *attribute, const char *value) {
         int r;
 
+        /* Realizing a unit's cgroup rewrites all its attributes, even if only one of them changed or the
+         * unit's cgroup is realized again merely because a sibling changed. Skip the writes that wouldn't
+         * change anything. Note that for files with one line per device, this only remembers the last line
+         * written, which is still correct, just less effective. */
+        if (streq_ptr(hashmap_get(u->cgroup_attribute_cache, attribute), value))
+                return 0;
+
         r = cg_set_attribute(controller, u->cgroup_path, attribute, value);
-        if (r < 0)
+        if (r < 0) {
                 log_unit_full_errno(u, LOG_LEVEL_CGROUP_WRITE(r), r, "Failed to set '%s' attribute on '%s' to '%.*s': %m",
                                     strna(attribute), empty_to_root(u->cgroup_path), (int) strcspn(value, NEWLINE), value);
+                value = NULL;
+        }
 
+        unit_cgroup_attribute_cache_update(u, attribute, value);
         return r;
 }
 
@@ -2058,6 +2095,11 @@ static int unit_update_cgroup(
                 migrate_mask = u->cgroup_realized_mask ^ target_mask;
         }
 
+        /* A new cgroup and newly enabled controllers start out with the default attribute values, hence
+         * forget what we wrote before */
+        if (created || u->cgroup_realized_mask != target_mask)
+                u->cgroup_attribute_cache = hashmap_free(u->cgroup_attribute_cache);
+
         /* Keep track that this is now realized */
         u->cgroup_realized = true;
         u->cgroup_realized_mask = target_mask;
@@ -2586,6 +2628,8 @@ void unit_release_cgroup(Unit *u) {
                 u->cgroup_path = mfree(u->cgroup_path);
         }
 
+        u->cgroup_attribute_cache = hashmap_free(u->cgroup_attribute_cache);
+
         if (u->cgroup_control_inotify_wd >= 0) {
                 if (inotify_rm_watch(u->manager->cgroup_inotify_fd, u->cgroup_control_inotify_wd) < 0)
                         log_unit_debug_errno(u, errno, "Failed to remove cgroup control inotify watch %i for %s, ignoring: %m", u->cgroup_control_inotify_wd, u->id);
@@ -3062,6 +3106,8 @@ static int unit_check_cgroup_events(Unit *u) {
 
 static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         Manager *m = userdata;
+        Unit *u;
+        int r = 0;
 
         assert(s);
         assert(fd >= 0);
@@ -3074,10 +3120,10 @@ static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents,
 
                 l = read(fd, &buffer, sizeof(buffer));
                 if (l < 0) {
-                        if (IN_SET(errno, EINTR, EAGAIN))
-                                return 0;
+                        if (!IN_SET(errno, EINTR, EAGAIN))
+                                r = log_error_errno(errno, "Failed to read control group inotify events: %m");
 
-                        return log_error_errno(errno, "Failed to read control group inotify events: %m");
+                        break;
                 }
 
                 FOREACH_INOTIFY_EVENT(e, buffer, l) {
@@ -3095,14 +3141,32 @@ static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents,
                          * because it was queued before the removal. Let's ignore this here safely. */
 
                         u = hashmap_get(m->cgroup_control_inotify_wd_unit, INT_TO_PTR(e->wd));
-                        if (u)
-                                unit_check_cgroup_events(u);
+                        if (u && !u->in_cgroup_events_queue) {
+                                LIST_PREPEND(cgroup_events_queue, m->cgroup_events_queue, u);
+                                u->in_cgroup_events_queue = true;
+                        }
 
                         u = hashmap_get(m->cgroup_memory_inotify_wd_unit, INT_TO_PTR(e->wd));
                         if (u)
                                 unit_add_to_cgroup_oom_queue(u);
                 }
         }
+
+        /* A busy cgroup generates a lot of events, in particular when processes come and go or the unit is
+         * frozen and thawed, and the same cgroup usually shows up many times in one batch. Reading
+         * cgroup.events once per cgroup after draining the inotify queue is enough, since we only look at
+         * the current state anyway. */
+        while ((u = m->cgroup_events_queue)) {
+                assert(u->in_cgroup_events_queue);
+
+                LIST_REMOVE(cgroup_events_queue, m->cgroup_events_queue, u);
+                u->in_cgroup_events_queue = false;
+
+                if (u->cgroup_path)
+                        (void) unit_check_cgroup_events(u);
+        }
+
+        return r;
 }
 
 static int cg_bpf_mask_supported(CGroupMask *ret) {
@@ -3757,12 +3821,61 @@ done:
         return 0;
 }
 
+void unit_get_accounting(Unit *u, UnitAccounting *ret) {
+        UnitAccounting a;
+        usec_t n;
+        int r;
+
+        assert(u);
+        assert(ret);
+
+        /* Returns the CPU, memory, tasks and IO accounting data of the unit. Values not older than
+         * UNIT_ACCOUNTING_CACHE_USEC are returned from the cache. Metrics that are not available are set to
+         * NSEC_INFINITY/UINT64_MAX. */
+
+        n = now(CLOCK_MONOTONIC);
+        if (u->accounting_cache.timestamp > 0 &&
+            n < usec_add(u->accounting_cache.timestamp, UNIT_ACCOUNTING_CACHE_USEC)) {
+                *ret = u->accounting_cache;
+                return;
+        }
+
+        a = (UnitAccounting) {
+                .timestamp = n,
+                .cpu_usage = NSEC_INFINITY,
+                .memory_current = UINT64_MAX,
+                .tasks_current = UINT64_MAX,
+        };
+
+        r = unit_get_cpu_usage(u, &a.cpu_usage);
+        if (r < 0 && r != -ENODATA)
+                log_unit_warning_errno(u, r, "Failed to get cpuacct.usage attribute: %m");
+
+        r = unit_get_memory_current(u, &a.memory_current);
+        if (r < 0 && r != -ENODATA)
+                log_unit_warning_errno(u, r, "Failed to get memory.usage_in_bytes attribute: %m");
+
+        r = unit_get_tasks_current(u, &a.tasks_current);
+        if (r < 0 && r != -ENODATA)
+                log_unit_warning_errno(u, r, "Failed to get pids.current attribute: %m");
+
+        for (CGroupIOAccountingMetric i = 0; i < _CGROUP_IO_ACCOUNTING_METRIC_MAX; i++) {
+                a.io[i] = UINT64_MAX;
+
+                /* io.stat carries all metrics, read it only once */
+                (void) unit_get_io_accounting(u, i, i > 0, a.io + i);
+        }
+
+        *ret = u->accounting_cache = a;
+}
+
 int unit_reset_cpu_accounting(Unit *u) {
         int r;
 
         assert(u);
 
         u->cpu_usage_last = NSEC_INFINITY;
+        u->accounting_cache.timestamp = 0;
 
         r = unit_get_cpu_usage_raw(u, &u->cpu_usage_base);
         if (r < 0) {
@@ -3796,6 +3909,7 @@ int unit_reset_io_accounting(Unit *u) {
 
         for (CGroupIOAccountingMetric i = 0; i < _CGROUP_IO_ACCOUNTING_METRIC_MAX; i++)
                 u->io_accounting_last[i] = UINT64_MAX;
+        u->accounting_cache.timestamp = 0;
 
         r = unit_get_io_accounting_raw(u, u->io_accounting_base);
         if (r < 0) {
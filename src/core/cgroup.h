@@ -207,6 +207,18 @@ typedef enum CGroupIOAccountingMetric {
         _CGROUP_IO_ACCOUNTING_METRIC_INVALID = -EINVAL,
 } CGroupIOAccountingMetric;
 
+/* Bus clients usually read all accounting properties of a unit at once, and monitoring tools poll them for
+ * all units. Hence we read them in one go, and answer from memory for a short while afterwards. */
+#define UNIT_ACCOUNTING_CACHE_USEC (100 * USEC_PER_MSEC)
+
+typedef struct UnitAccounting {
+        usec_t timestamp;       /* CLOCK_MONOTONIC, when the values were read, 0 if never */
+        nsec_t cpu_usage;       /* NSEC_INFINITY if not available */
+        uint64_t memory_current;/* UINT64_MAX if not available, ditto below */
+        uint64_t tasks_current;
+        uint64_t io[_CGROUP_IO_ACCOUNTING_METRIC_MAX];
+} UnitAccounting;
+
 typedef struct Unit Unit;
 typedef struct Manager Manager;
 
@@ -288,6 +300,7 @@ int unit_get_tasks_current(Unit *u, uint64_t *ret);
 int unit_get_cpu_usage(Unit *u, nsec_t *ret);
 int unit_get_io_accounting(Unit *u, CGroupIOAccountingMetric metric, bool allow_cache, uint64_t *ret);
 int unit_get_ip_accounting(Unit *u, CGroupIPAccountingMetric metric, uint64_t *ret);
+void unit_get_accounting(Unit *u, UnitAccounting *ret);
 
 int unit_reset_cpu_accounting(Unit *u);
 int unit_reset_ip_accounting(Unit *u);
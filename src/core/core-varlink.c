@@ -1,7 +1,9 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include "core-varlink.h"
+#include "metrics.h"
 #include "mkdir.h"
+#include "set.h"
 #include "strv.h"
 #include "user-util.h"
 #include "varlink.h"
@@ -16,6 +18,22 @@ typedef struct LookupParameters {
         const char *service;
 } LookupParameters;
 
+typedef struct ListUnitsParameters {
+        char **states;
+        char **patterns;
+        char **fields;
+        const char *continuation;
+        uint32_t max;
+} ListUnitsParameters;
+
+static void list_units_parameters_done(ListUnitsParameters *p) {
+        assert(p);
+
+        strv_free(p->states);
+        strv_free(p->patterns);
+        strv_free(p->fields);
+}
+
 static const char* const managed_oom_mode_properties[] = {
         "ManagedOOMSwap",
         "ManagedOOMMemoryPressure",
@@ -193,6 +211,99 @@ static int vl_method_subscribe_managed_oom_cgroups(
         return varlink_notify(m->managed_oom_varlink_request, v);
 }
 
+static int build_unit_change_json(Unit *u, JsonVariant **ret) {
+        assert(u);
+        assert(ret);
+
+        return json_build(ret, JSON_BUILD_OBJECT(
+                                   JSON_BUILD_PAIR("id", JSON_BUILD_STRING(u->id)),
+                                   JSON_BUILD_PAIR("loadState", JSON_BUILD_STRING(unit_load_state_to_string(u->load_state))),
+                                   JSON_BUILD_PAIR("activeState", JSON_BUILD_STRING(unit_active_state_to_string(unit_active_state(u)))),
+                                   JSON_BUILD_PAIR("subState", JSON_BUILD_STRING(unit_sub_state_to_string(u)))));
+}
+
+int manager_varlink_send_unit_change(Unit *u) {
+        _cleanup_(json_variant_unrefp) JsonVariant *e = NULL, *v = NULL;
+        Varlink *link;
+        int r;
+
+        assert(u);
+
+        if (!u->manager || set_isempty(u->manager->unit_change_varlink_subscribers))
+                return 0;
+
+        r = build_unit_change_json(u, &e);
+        if (r < 0)
+                return r;
+
+        r = json_build(&v, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("units", JSON_BUILD_ARRAY(JSON_BUILD_VARIANT(e)))));
+        if (r < 0)
+                return r;
+
+        SET_FOREACH(link, u->manager->unit_change_varlink_subscribers) {
+                r = varlink_notify(link, v);
+                if (r < 0)
+                        log_unit_debug_errno(u, r, "Failed to send unit change notification, ignoring: %m");
+        }
+
+        return 0;
+}
+
+static int vl_method_subscribe_unit_changes(
+                Varlink *link,
+                JsonVariant *parameters,
+                VarlinkMethodFlags flags,
+                void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *arr = NULL;
+        Manager *m = userdata;
+        const char *k;
+        Unit *u;
+        int r;
+
+        assert(link);
+        assert(m);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        /* The first reply carries the state of all loaded units, every further one only the unit whose
+         * state changed, so that subscribers can maintain their own copy without going through the bus. */
+
+        r = json_build(&arr, JSON_BUILD_EMPTY_ARRAY);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(u, k, m->units) {
+                _cleanup_(json_variant_unrefp) JsonVariant *e = NULL;
+
+                /* Skip aliases */
+                if (k != u->id)
+                        continue;
+
+                r = build_unit_change_json(u, &e);
+                if (r < 0)
+                        return r;
+
+                r = json_variant_append_array(&arr, e);
+                if (r < 0)
+                        return r;
+        }
+
+        r = json_build(&v, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("units", JSON_BUILD_VARIANT(arr))));
+        if (r < 0)
+                return r;
+
+        if (!FLAGS_SET(flags, VARLINK_METHOD_MORE))
+                return varlink_reply(link, v);
+
+        r = set_ensure_put(&m->unit_change_varlink_subscribers, NULL, link);
+        if (r < 0)
+                return r;
+        varlink_ref(link);
+
+        return varlink_notify(link, v);
+}
+
 static int vl_method_get_user_record(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
 
         static const JsonDispatch dispatch_table[] = {
@@ -410,6 +521,185 @@ static int vl_method_get_memberships(Varlink *link, JsonVariant *parameters, Var
         return varlink_error(link, "io.systemd.UserDatabase.NoRecordFound", NULL);
 }
 
+static int build_unit_fields_json(Unit *u, const UnitListField *fields, size_t n_fields, JsonVariant **ret) {
+        _cleanup_free_ JsonVariant **pairs = NULL;
+        size_t n_pairs = 0;
+        int r;
+
+        assert(u);
+        assert(fields);
+        assert(ret);
+
+        pairs = new(JsonVariant*, n_fields * 2);
+        if (!pairs)
+                return -ENOMEM;
+
+        for (size_t i = 0; i < n_fields; i++) {
+                char buf[DECIMAL_STR_MAX(uint32_t)];
+
+                r = json_variant_new_string(pairs + n_pairs, unit_list_field_to_string(fields[i]));
+                if (r < 0)
+                        goto finish;
+                n_pairs++;
+
+                if (fields[i] == UNIT_LIST_FIELD_JOB_ID)
+                        r = json_variant_new_unsigned(pairs + n_pairs, u->job ? u->job->id : 0);
+                else
+                        r = json_variant_new_string(pairs + n_pairs, unit_get_list_field(u, fields[i], buf));
+                if (r < 0)
+                        goto finish;
+                n_pairs++;
+        }
+
+        r = json_variant_new_object(ret, pairs, n_pairs);
+
+finish:
+        json_variant_unref_many(pairs, n_pairs);
+        return r;
+}
+
+static int vl_method_list_units(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+
+        static const JsonDispatch dispatch_table[] = {
+                { "states",       JSON_VARIANT_ARRAY,    json_dispatch_strv,         offsetof(ListUnitsParameters, states),       0              },
+                { "patterns",     JSON_VARIANT_ARRAY,    json_dispatch_strv,         offsetof(ListUnitsParameters, patterns),     0              },
+                { "fields",       JSON_VARIANT_ARRAY,    json_dispatch_strv,         offsetof(ListUnitsParameters, fields),       JSON_MANDATORY },
+                { "continuation", JSON_VARIANT_STRING,   json_dispatch_const_string, offsetof(ListUnitsParameters, continuation), 0              },
+                { "max",          JSON_VARIANT_UNSIGNED, json_dispatch_uint32,       offsetof(ListUnitsParameters, max),          JSON_MANDATORY },
+                {}
+        };
+
+        _cleanup_(json_variant_unrefp) JsonVariant *arr = NULL;
+        _cleanup_(list_units_parameters_done) ListUnitsParameters p = {};
+        _cleanup_free_ UnitListField *fields = NULL;
+        _cleanup_free_ Unit **units = NULL;
+        Manager *m = userdata;
+        size_t n_fields = 0, n_units;
+        char **i;
+        int r;
+
+        assert(link);
+        assert(parameters);
+        assert(m);
+
+        /* Mirrors ListUnitsWithFields() on the bus: returns a page of units with only the requested
+         * fields. */
+
+        r = json_dispatch(parameters, dispatch_table, NULL, 0, &p);
+        if (r < 0)
+                return r;
+
+        if (strv_isempty(p.fields))
+                return varlink_error_invalid_parameter(link, JSON_VARIANT_STRING_CONST("fields"));
+        if (p.max == 0)
+                return varlink_error_invalid_parameter(link, JSON_VARIANT_STRING_CONST("max"));
+
+        fields = new(UnitListField, strv_length(p.fields));
+        if (!fields)
+                return -ENOMEM;
+
+        STRV_FOREACH(i, p.fields) {
+                UnitListField f;
+
+                f = unit_list_field_from_string(*i);
+                if (f < 0)
+                        return varlink_error_invalid_parameter(link, JSON_VARIANT_STRING_CONST("fields"));
+
+                fields[n_fields++] = f;
+        }
+
+        r = manager_get_units_page(m, p.states, p.patterns, p.continuation, p.max, &units, &n_units);
+        if (r < 0)
+                return r;
+
+        r = json_build(&arr, JSON_BUILD_EMPTY_ARRAY);
+        if (r < 0)
+                return r;
+
+        for (size_t j = 0; j < n_units; j++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *e = NULL;
+
+                r = build_unit_fields_json(units[j], fields, n_fields, &e);
+                if (r < 0)
+                        return r;
+
+                r = json_variant_append_array(&arr, e);
+                if (r < 0)
+                        return r;
+        }
+
+        return varlink_replyb(link,
+                              JSON_BUILD_OBJECT(
+                                      JSON_BUILD_PAIR("units", JSON_BUILD_VARIANT(arr)),
+                                      JSON_BUILD_PAIR("continuation", JSON_BUILD_STRING(n_units == p.max ? units[n_units - 1]->id : ""))));
+}
+
+static uint64_t metric_units(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return hashmap_size(m->units);
+}
+
+static uint64_t metric_failed_units(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return set_size(m->failed_units);
+}
+
+static uint64_t metric_jobs(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return hashmap_size(m->jobs);
+}
+
+static uint64_t metric_running_jobs(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->n_running_jobs;
+}
+
+static uint64_t metric_installed_jobs_total(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->n_installed_jobs;
+}
+
+static uint64_t metric_failed_jobs_total(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->n_failed_jobs;
+}
+
+static const Metric manager_metrics[] = {
+        { "manager_units",                "Loaded units",                 METRIC_GAUGE,   .get_value = metric_units                },
+        { "manager_failed_units",         "Units in failed state",        METRIC_GAUGE,   .get_value = metric_failed_units         },
+        { "manager_jobs",                 "Queued jobs",                  METRIC_GAUGE,   .get_value = metric_jobs                 },
+        { "manager_running_jobs",         "Jobs currently being run",     METRIC_GAUGE,   .get_value = metric_running_jobs         },
+        { "manager_installed_jobs_total", "Jobs enqueued since boot",     METRIC_COUNTER, .get_value = metric_installed_jobs_total },
+        { "manager_failed_jobs_total",    "Jobs that failed since boot",  METRIC_COUNTER, .get_value = metric_failed_jobs_total    },
+};
+
+static int vl_method_list_metrics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        Manager *m = userdata;
+
+        assert(link);
+        assert(m);
+
+        return metrics_method_list(link, parameters, manager_metrics, ELEMENTSOF(manager_metrics), m);
+}
+
 static void vl_disconnect(VarlinkServer *s, Varlink *link, void *userdata) {
         Manager *m = userdata;
 
@@ -419,6 +709,9 @@ static void vl_disconnect(VarlinkServer *s, Varlink *link, void *userdata) {
 
         if (link == m->managed_oom_varlink_request)
                 m->managed_oom_varlink_request = varlink_unref(link);
+
+        if (set_remove(m->unit_change_varlink_subscribers, link))
+                varlink_unref(link);
 }
 
 int manager_varlink_init(Manager *m) {
@@ -444,7 +737,10 @@ int manager_varlink_init(Manager *m) {
                         "io.systemd.UserDatabase.GetUserRecord",  vl_method_get_user_record,
                         "io.systemd.UserDatabase.GetGroupRecord", vl_method_get_group_record,
                         "io.systemd.UserDatabase.GetMemberships", vl_method_get_memberships,
-                        "io.systemd.ManagedOOM.SubscribeManagedOOMCGroups",  vl_method_subscribe_managed_oom_cgroups);
+                        "io.systemd.ManagedOOM.SubscribeManagedOOMCGroups",  vl_method_subscribe_managed_oom_cgroups,
+                        "io.systemd.Manager.ListUnits",  vl_method_list_units,
+                        "io.systemd.Manager.SubscribeUnitChanges",  vl_method_subscribe_unit_changes,
+                        "io.systemd.Metrics.List",  vl_method_list_metrics);
         if (r < 0)
                 return log_error_errno(r, "Failed to register varlink methods: %m");
 
@@ -462,6 +758,10 @@ int manager_varlink_init(Manager *m) {
                 r = varlink_server_listen_address(s, VARLINK_ADDR_PATH_MANAGED_OOM, 0666);
                 if (r < 0)
                         return log_error_errno(r, "Failed to bind to varlink socket: %m");
+
+                r = varlink_server_listen_address(s, VARLINK_ADDR_PATH_MANAGER, 0666);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to bind to varlink socket: %m");
         }
 
         r = varlink_server_attach_event(s, m->event, SD_EVENT_PRIORITY_NORMAL);
@@ -481,5 +781,10 @@ void manager_varlink_done(Manager *m) {
          * installed (vl_disconnect() above) to be called, where we will unref it too. */
         varlink_close_unref(TAKE_PTR(m->managed_oom_varlink_request));
 
+        /* Same for the unit change subscribers */
+        for (Varlink *link; (link = set_steal_first(m->unit_change_varlink_subscribers)); )
+                varlink_close_unref(link);
+        m->unit_change_varlink_subscribers = set_free(m->unit_change_varlink_subscribers);
+
         m->varlink_server = varlink_server_unref(m->varlink_server);
 }
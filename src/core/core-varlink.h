@@ -10,3 +10,6 @@ void manager_varlink_done(Manager *m);
  * - The value of ManagedOOM*= properties change
  * - A unit with ManagedOOM*= properties changes unit active state */
 int manager_varlink_send_managed_oom_update(Unit *u);
+
+/* Sends the new state of the unit to all subscribers of io.systemd.Manager.SubscribeUnitChanges */
+int manager_varlink_send_unit_change(Unit *u);
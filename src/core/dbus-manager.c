@@ -11,6 +11,7 @@
 #include "bus-common-errors.h"
 #include "bus-get-properties.h"
 #include "bus-log-control-api.h"
+#include "bus-message.h"
 #include "data-fd-util.h"
 #include "dbus-cgroup.h"
 #include "dbus-execute.h"
@@ -754,7 +755,7 @@ static int method_unref_unit(sd_bus_message *message, void *userdata, sd_bus_err
         return method_generic_unit_operation(message, userdata, error, bus_unit_method_unref, 0);
 }
 
-static int reply_unit_info(sd_bus_message *reply, Unit *u) {
+static int reply_unit_info(sd_bus_message *reply, const BusCompiledSignature *signature, Unit *u) {
         _cleanup_free_ char *unit_path = NULL, *job_path = NULL;
         Unit *following;
 
@@ -770,8 +771,8 @@ static int reply_unit_info(sd_bus_message *reply, Unit *u) {
                         return -ENOMEM;
         }
 
-        return sd_bus_message_append(
-                        reply, "(ssssssouso)",
+        return bus_message_append_compiled(
+                        reply, signature,
                         u->id,
                         unit_description(u),
                         unit_load_state_to_string(u->load_state),
@@ -785,6 +786,7 @@ static int reply_unit_info(sd_bus_message *reply, Unit *u) {
 }
 
 static int method_list_units_by_names(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(bus_compiled_signature_freep) BusCompiledSignature *signature = NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         Manager *m = userdata;
         int r;
@@ -806,6 +808,11 @@ static int method_list_units_by_names(sd_bus_message *message, void *userdata, s
         if (r < 0)
                 return r;
 
+        /* Parse the element signature once, rather than for every unit */
+        r = bus_compiled_signature_new("(ssssssouso)", &signature);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(unit, units) {
                 Unit *u;
 
@@ -816,7 +823,7 @@ static int method_list_units_by_names(sd_bus_message *message, void *userdata, s
                 if (r < 0)
                         return r;
 
-                r = reply_unit_info(reply, u);
+                r = reply_unit_info(reply, signature, u);
                 if (r < 0)
                         return r;
         }
@@ -828,6 +835,92 @@ static int method_list_units_by_names(sd_bus_message *message, void *userdata, s
         return sd_bus_send(NULL, reply, NULL);
 }
 
+static int reply_unit_accounting(sd_bus_message *reply, Unit *u) {
+        UnitAccounting a;
+
+        assert(reply);
+        assert(u);
+
+        unit_get_accounting(u, &a);
+
+        return sd_bus_message_append(
+                        reply, "(sttttttt)",
+                        u->id,
+                        a.cpu_usage,
+                        a.memory_current,
+                        a.tasks_current,
+                        a.io[CGROUP_IO_READ_BYTES],
+                        a.io[CGROUP_IO_WRITE_BYTES],
+                        a.io[CGROUP_IO_READ_OPERATIONS],
+                        a.io[CGROUP_IO_WRITE_OPERATIONS]);
+}
+
+static int method_list_units_accounting(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **names = NULL;
+        Manager *m = userdata;
+        char **name;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method, the values are readable as unit properties anyway. This saves
+         * monitoring tools one round trip per unit. */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &names);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sttttttt)");
+        if (r < 0)
+                return r;
+
+        if (strv_isempty(names)) {
+                const char *k;
+                Unit *u;
+
+                /* All units with a cgroup, skipping aliases */
+                HASHMAP_FOREACH_KEY(u, k, m->units) {
+                        if (k != u->id)
+                                continue;
+
+                        if (!u->cgroup_path)
+                                continue;
+
+                        r = reply_unit_accounting(reply, u);
+                        if (r < 0)
+                                return r;
+                }
+        } else
+                STRV_FOREACH(name, names) {
+                        Unit *u;
+
+                        /* Don't load units for this, units that aren't loaded have no accounting data */
+                        u = manager_get_unit(m, *name);
+                        if (!u)
+                                continue;
+
+                        r = reply_unit_accounting(reply, u);
+                        if (r < 0)
+                                return r;
+                }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
 static int method_get_unit_processes(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         /* Don't load a unit (since it won't have any processes if it's not loaded), but don't insist on the
          * unit being loaded (because even improperly loaded units might still have processes around */
@@ -1077,6 +1170,7 @@ static int method_reset_failed(sd_bus_message *message, void *userdata, sd_bus_e
 }
 
 static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_error *error, char **states, char **patterns) {
+        _cleanup_(bus_compiled_signature_freep) BusCompiledSignature *signature = NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         Manager *m = userdata;
         const char *k;
@@ -1100,6 +1194,11 @@ static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_e
         if (r < 0)
                 return r;
 
+        /* Parse the element signature once, rather than for every unit */
+        r = bus_compiled_signature_new("(ssssssouso)", &signature);
+        if (r < 0)
+                return r;
+
         HASHMAP_FOREACH_KEY(u, k, m->units) {
                 if (k != u->id)
                         continue;
@@ -1114,7 +1213,7 @@ static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_e
                     !strv_fnmatch_or_empty(patterns, u->id, FNM_NOESCAPE))
                         continue;
 
-                r = reply_unit_info(reply, u);
+                r = reply_unit_info(reply, signature, u);
                 if (r < 0)
                         return r;
         }
@@ -1157,6 +1256,161 @@ static int method_list_units_by_patterns(sd_bus_message *message, void *userdata
         return list_units_filtered(message, userdata, error, states, patterns);
 }
 
+static int method_list_units_paged(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(bus_compiled_signature_freep) BusCompiledSignature *signature = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_free_ Unit **units = NULL;
+        Manager *m = userdata;
+        size_t n_units;
+        const char *after;
+        uint32_t max;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read(message, "su", &after, &max);
+        if (r < 0)
+                return r;
+
+        if (max == 0)
+                return sd_bus_error_set(error, SD_BUS_ERROR_INVALID_ARGS, "Page size must be positive.");
+
+        r = manager_get_units_page(m, NULL, NULL, after, max, &units, &n_units);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(ssssssouso)");
+        if (r < 0)
+                return r;
+
+        r = bus_compiled_signature_new("(ssssssouso)", &signature);
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; i < n_units; i++) {
+                r = reply_unit_info(reply, signature, units[i]);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static int method_list_units_with_fields(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_strv_free_ char **states = NULL, **patterns = NULL, **field_names = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_free_ UnitListField *fields = NULL;
+        _cleanup_free_ Unit **units = NULL;
+        Manager *m = userdata;
+        size_t n_fields = 0, n_units;
+        const char *after;
+        uint32_t max;
+        char **i;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &states);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &field_names);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read(message, "su", &after, &max);
+        if (r < 0)
+                return r;
+
+        if (strv_isempty(field_names))
+                return sd_bus_error_set(error, SD_BUS_ERROR_INVALID_ARGS, "No fields specified.");
+
+        if (max == 0)
+                return sd_bus_error_set(error, SD_BUS_ERROR_INVALID_ARGS, "Page size must be positive.");
+
+        fields = new(UnitListField, strv_length(field_names));
+        if (!fields)
+                return -ENOMEM;
+
+        STRV_FOREACH(i, field_names) {
+                UnitListField f;
+
+                f = unit_list_field_from_string(*i);
+                if (f < 0)
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Unknown field: %s", *i);
+
+                fields[n_fields++] = f;
+        }
+
+        r = manager_get_units_page(m, states, patterns, after, max, &units, &n_units);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "as");
+        if (r < 0)
+                return r;
+
+        for (size_t j = 0; j < n_units; j++) {
+                r = sd_bus_message_open_container(reply, 'a', "s");
+                if (r < 0)
+                        return r;
+
+                for (size_t k = 0; k < n_fields; k++) {
+                        char buf[DECIMAL_STR_MAX(uint32_t)];
+
+                        r = sd_bus_message_append_basic(reply, 's', unit_get_list_field(units[j], fields[k], buf));
+                        if (r < 0)
+                                return r;
+                }
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        /* A full page might be followed by another one, in which case the client continues after the
+         * last unit of this one. */
+        r = sd_bus_message_append(reply, "s", n_units == max ? units[n_units - 1]->id : "");
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
 static int method_list_jobs(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         Manager *m = userdata;
@@ -1311,6 +1565,163 @@ static int method_dump_by_fd(sd_bus_message *message, void *userdata, sd_bus_err
         return dump_impl(message, userdata, error, reply_dump_by_fd);
 }
 
+static int append_hashmap_stats(sd_bus_message *reply, const char *name, const HashmapStats *s) {
+        assert(reply);
+        assert(name);
+        assert(s);
+
+        return sd_bus_message_append(reply, "(suuuutt)",
+                                     name,
+                                     s->n_maps,
+                                     s->n_entries,
+                                     s->n_buckets,
+                                     s->max_dib,
+                                     s->sum_dib,
+                                     (uint64_t) s->n_bytes);
+}
+
+static int method_get_hashmap_stats(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        HashmapStats deps = {}, deps_per_type = {}, aliases = {}, mounts_for = {}, pids = {};
+        Manager *m = userdata;
+        const char *k;
+        Unit *u;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(suuuutt)");
+        if (r < 0)
+                return r;
+
+#define APPEND_MAP(field, add)                                          \
+        do {                                                            \
+                HashmapStats _s = {};                                   \
+                add(m->field, &_s);                                     \
+                r = append_hashmap_stats(reply, "Manager." #field, &_s); \
+                if (r < 0)                                              \
+                        return r;                                       \
+        } while (false)
+
+        APPEND_MAP(units, hashmap_add_stats);
+        APPEND_MAP(units_by_invocation_id, hashmap_add_stats);
+        APPEND_MAP(jobs, hashmap_add_stats);
+        APPEND_MAP(watch_pids, hashmap_add_stats);
+        APPEND_MAP(startup_units, set_add_stats);
+        APPEND_MAP(failed_units, set_add_stats);
+        APPEND_MAP(unit_id_map, hashmap_add_stats);
+        APPEND_MAP(unit_name_map, hashmap_add_stats);
+        APPEND_MAP(unit_path_cache, set_add_stats);
+        APPEND_MAP(unit_dir_cache, hashmap_add_stats);
+        APPEND_MAP(devices_by_sysfs, hashmap_add_stats);
+        APPEND_MAP(swaps_by_devnode, hashmap_add_stats);
+        APPEND_MAP(watch_bus, hashmap_add_stats);
+        APPEND_MAP(cgroup_unit, hashmap_add_stats);
+        APPEND_MAP(cgroup_control_inotify_wd_unit, hashmap_add_stats);
+        APPEND_MAP(cgroup_memory_inotify_wd_unit, hashmap_add_stats);
+        APPEND_MAP(units_requiring_mounts_for, hashmap_add_stats);
+        APPEND_MAP(dynamic_users, hashmap_add_stats);
+        APPEND_MAP(uid_refs, hashmap_add_stats);
+        APPEND_MAP(gid_refs, hashmap_add_stats);
+        APPEND_MAP(exec_runtime_by_id, hashmap_add_stats);
+
+#undef APPEND_MAP
+
+        /* Per-unit maps are summed up over all units, since individually they are small, but there are
+         * many of them. Aliases are skipped, so that each unit is only accounted for once. */
+        HASHMAP_FOREACH_KEY(u, k, m->units) {
+                Hashmap *per_type;
+
+                if (u->id != k)
+                        continue;
+
+                hashmap_add_stats(u->dependencies, &deps);
+                HASHMAP_FOREACH(per_type, u->dependencies)
+                        hashmap_add_stats(per_type, &deps_per_type);
+                set_add_stats(u->aliases, &aliases);
+                hashmap_add_stats(u->requires_mounts_for, &mounts_for);
+                set_add_stats(u->pids, &pids);
+        }
+
+        r = append_hashmap_stats(reply, "Unit.dependencies", &deps);
+        if (r < 0)
+                return r;
+        r = append_hashmap_stats(reply, "Unit.dependencies[]", &deps_per_type);
+        if (r < 0)
+                return r;
+        r = append_hashmap_stats(reply, "Unit.aliases", &aliases);
+        if (r < 0)
+                return r;
+        r = append_hashmap_stats(reply, "Unit.requires_mounts_for", &mounts_for);
+        if (r < 0)
+                return r;
+        r = append_hashmap_stats(reply, "Unit.pids", &pids);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static int method_get_unit_phases(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_free_ UnitPhaseRecord *records = NULL;
+        Manager *m = userdata;
+        size_t n;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = unit_phases_get(m->unit_phases, &records, &n);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sstt)");
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; i < n; i++) {
+                r = sd_bus_message_append(reply, "(sstt)",
+                                          records[i].unit,
+                                          unit_phase_to_string(records[i].phase),
+                                          records[i].begin,
+                                          records[i].end);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
 static int method_refuse_snapshot(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         return sd_bus_error_set(error, SD_BUS_ERROR_NOT_SUPPORTED, "Support for snapshots has been removed.");
 }
@@ -2723,6 +3134,8 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_PROPERTY("TimerSlackNSec", "t", property_get_timer_slack_nsec, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultOOMPolicy", "s", bus_property_get_oom_policy, offsetof(Manager, default_oom_policy), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("CtrlAltDelBurstAction", "s", bus_property_get_emergency_action, offsetof(Manager, cad_burst_action), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("StartJobsMax", "u", bus_property_get_unsigned, offsetof(Manager, start_jobs_max), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("StartJobsIOPressureMax", "i", bus_property_get_int, offsetof(Manager, start_jobs_io_pressure_max), SD_BUS_VTABLE_PROPERTY_CONST),
 
         SD_BUS_METHOD_WITH_NAMES("GetUnit",
                                  "s",
@@ -3014,6 +3427,33 @@ const sd_bus_vtable bus_manager_vtable[] = {
                                  SD_BUS_PARAM(units),
                                  method_list_units_by_names,
                                  SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_NAMES("ListUnitsAccounting",
+                                 "as",
+                                 SD_BUS_PARAM(names),
+                                 "a(sttttttt)",
+                                 SD_BUS_PARAM(units),
+                                 method_list_units_accounting,
+                                 SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_NAMES("ListUnitsPaged",
+                                 "su",
+                                 SD_BUS_PARAM(after)
+                                 SD_BUS_PARAM(max),
+                                 "a(ssssssouso)",
+                                 SD_BUS_PARAM(units),
+                                 method_list_units_paged,
+                                 SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_NAMES("ListUnitsWithFields",
+                                 "asasassu",
+                                 SD_BUS_PARAM(states)
+                                 SD_BUS_PARAM(patterns)
+                                 SD_BUS_PARAM(fields)
+                                 SD_BUS_PARAM(continuation)
+                                 SD_BUS_PARAM(max),
+                                 "aass",
+                                 SD_BUS_PARAM(units)
+                                 SD_BUS_PARAM(continuation),
+                                 method_list_units_with_fields,
+                                 SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD_WITH_NAMES("ListJobs",
                                  NULL,,
                                  "a(usssoo)",
@@ -3042,6 +3482,18 @@ const sd_bus_vtable bus_manager_vtable[] = {
                                  SD_BUS_PARAM(fd),
                                  method_dump_by_fd,
                                  SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_NAMES("GetHashmapStats",
+                                 NULL,,
+                                 "a(suuuutt)",
+                                 SD_BUS_PARAM(stats),
+                                 method_get_hashmap_stats,
+                                 SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD_WITH_NAMES("GetUnitPhases",
+                                 NULL,,
+                                 "a(sstt)",
+                                 SD_BUS_PARAM(phases),
+                                 method_get_unit_phases,
+                                 SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD_WITH_NAMES("CreateSnapshot",
                                  "sb",
                                  SD_BUS_PARAM(name)
@@ -48,7 +48,10 @@ const sd_bus_vtable bus_path_vtable[] = {
         SD_BUS_PROPERTY("Paths", "a(ss)", property_get_paths, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("MakeDirectory", "b", bus_property_get_bool, offsetof(Path, make_directory), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DirectoryMode", "u", bus_property_get_mode, offsetof(Path, directory_mode), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("TriggerDelayUSec", "t", bus_property_get_usec, offsetof(Path, trigger_delay_usec), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("Result", "s", property_get_result, offsetof(Path, result), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("NMergedEvents", "u", bus_property_get_unsigned, offsetof(Path, n_merged_events), 0),
+        SD_BUS_PROPERTY("NDroppedEvents", "u", bus_property_get_unsigned, offsetof(Path, n_dropped_events), 0),
         SD_BUS_VTABLE_END
 };
 
@@ -74,6 +77,9 @@ static int bus_path_set_transient_property(
         if (streq(name, "DirectoryMode"))
                 return bus_set_transient_mode_t(u, name, &p->directory_mode, message, flags, error);
 
+        if (streq(name, "TriggerDelayUSec"))
+                return bus_set_transient_usec(u, name, &p->trigger_delay_usec, message, flags, error);
+
         if (streq(name, "Paths")) {
                 const char *type_name, *path;
                 bool empty = true;
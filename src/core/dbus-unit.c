@@ -1082,19 +1082,15 @@ static int property_get_current_memory(
                 void *userdata,
                 sd_bus_error *error) {
 
-        uint64_t sz = UINT64_MAX;
+        UnitAccounting a;
         Unit *u = userdata;
-        int r;
 
         assert(bus);
         assert(reply);
         assert(u);
 
-        r = unit_get_memory_current(u, &sz);
-        if (r < 0 && r != -ENODATA)
-                log_unit_warning_errno(u, r, "Failed to get memory.usage_in_bytes attribute: %m");
-
-        return sd_bus_message_append(reply, "t", sz);
+        unit_get_accounting(u, &a);
+        return sd_bus_message_append(reply, "t", a.memory_current);
 }
 
 static int property_get_available_memory(
@@ -1130,19 +1126,15 @@ static int property_get_current_tasks(
                 void *userdata,
                 sd_bus_error *error) {
 
-        uint64_t cn = UINT64_MAX;
+        UnitAccounting a;
         Unit *u = userdata;
-        int r;
 
         assert(bus);
         assert(reply);
         assert(u);
 
-        r = unit_get_tasks_current(u, &cn);
-        if (r < 0 && r != -ENODATA)
-                log_unit_warning_errno(u, r, "Failed to get pids.current attribute: %m");
-
-        return sd_bus_message_append(reply, "t", cn);
+        unit_get_accounting(u, &a);
+        return sd_bus_message_append(reply, "t", a.tasks_current);
 }
 
 static int property_get_cpu_usage(
@@ -1154,19 +1146,15 @@ static int property_get_cpu_usage(
                 void *userdata,
                 sd_bus_error *error) {
 
-        nsec_t ns = NSEC_INFINITY;
+        UnitAccounting a;
         Unit *u = userdata;
-        int r;
 
         assert(bus);
         assert(reply);
         assert(u);
 
-        r = unit_get_cpu_usage(u, &ns);
-        if (r < 0 && r != -ENODATA)
-                log_unit_warning_errno(u, r, "Failed to get cpuacct.usage attribute: %m");
-
-        return sd_bus_message_append(reply, "t", ns);
+        unit_get_accounting(u, &a);
+        return sd_bus_message_append(reply, "t", a.cpu_usage);
 }
 
 static int property_get_cpuset_cpus(
@@ -1434,7 +1422,7 @@ static int property_get_io_counter(
                 [CGROUP_IO_WRITE_OPERATIONS] = "IOWriteOperations",
         };
 
-        uint64_t value = UINT64_MAX;
+        UnitAccounting a;
         Unit *u = userdata;
         ssize_t metric;
 
@@ -1444,8 +1432,8 @@ static int property_get_io_counter(
         assert(u);
 
         assert_se((metric = string_table_lookup(table, ELEMENTSOF(table), property)) >= 0);
-        (void) unit_get_io_accounting(u, metric, false, &value);
-        return sd_bus_message_append(reply, "t", value);
+        unit_get_accounting(u, &a);
+        return sd_bus_message_append(reply, "t", a.io[metric]);
 }
 
 int bus_unit_method_attach_processes(sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -274,6 +274,28 @@ static int mac_selinux_filter(sd_bus_message *message, void *userdata, sd_bus_er
 }
 #endif
 
+static void index_unit_dbus_path(Manager *m, Unit *u, const char *path) {
+        _cleanup_free_ char *p = NULL;
+
+        assert(m);
+        assert(u);
+        assert(path);
+
+        if (u->dbus_path_indexed)
+                return;
+
+        /* Only index the path derived from the unit's primary name. Units may also be addressed by their
+         * invocation ID, but that changes with every activation. */
+        p = unit_dbus_path(u);
+        if (!streq_ptr(p, path))
+                return;
+
+        if (hashmap_ensure_put(&m->units_by_dbus_path, &string_hash_ops, p, u) < 0)
+                return;
+
+        u->dbus_path_indexed = TAKE_PTR(p);
+}
+
 static int find_unit(Manager *m, sd_bus *bus, const char *path, Unit **unit, sd_bus_error *error) {
         Unit *u = NULL;  /* just to appease gcc, initialization is not really necessary */
         int r;
@@ -303,10 +325,17 @@ static int find_unit(Manager *m, sd_bus *bus, const char *path, Unit **unit, sd_
                 if (!u)
                         return 0;
         } else {
-                r = manager_load_unit_from_dbus_path(m, path, error, &u);
-                if (r < 0)
-                        return 0;
-                assert(u);
+                /* Every call on a unit object asks each of the fallback vtables registered for units for
+                 * the object, hence look the path up directly first, instead of decoding it each time. */
+                u = hashmap_get(m->units_by_dbus_path, path);
+                if (!u) {
+                        r = manager_load_unit_from_dbus_path(m, path, error, &u);
+                        if (r < 0)
+                                return 0;
+                        assert(u);
+
+                        index_unit_dbus_path(m, u, path);
+                }
         }
 
         *unit = u;
@@ -78,16 +78,20 @@
 #include "path-util.h"
 #include "process-util.h"
 #include "random-util.h"
+#include "raw-clone.h"
 #include "rlimit-util.h"
 #include "rm-rf.h"
 #if HAVE_SECCOMP
 #include "seccomp-util.h"
+#else
+typedef struct SeccompPrograms SeccompPrograms;
 #endif
 #include "securebits-util.h"
 #include "selinux-util.h"
 #include "signal-util.h"
 #include "smack-util.h"
 #include "socket-util.h"
+#include "sort-util.h"
 #include "special.h"
 #include "stat-util.h"
 #include "string-table.h"
@@ -106,6 +110,12 @@
 
 #define SNDBUF_SIZE (8*1024*1024)
 
+/* The seccomp filters compiled in the manager, see exec_seccomp_programs_get() */
+typedef struct ExecSeccompPrograms {
+        const SeccompPrograms *base;           /* everything but SystemCallFilter= */
+        const SeccompPrograms *syscall_filter; /* SystemCallFilter=, NULL if not set */
+} ExecSeccompPrograms;
+
 static int shift_fds(int fds[], size_t n_fds) {
         if (n_fds <= 0)
                 return 0;
@@ -1471,6 +1481,7 @@ static bool skip_seccomp_unavailable(const Unit* u, const char* msg) {
 }
 
 static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_ambient_hack) {
+        _cleanup_hashmap_free_ Hashmap *filter = NULL;
         uint32_t negative_action, default_action, action;
         int r;
 
@@ -1493,13 +1504,18 @@ static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_
                 action = negative_action;
         }
 
+        /* Don't modify the context itself, the filters might be compiled in the manager */
         if (needs_ambient_hack) {
-                r = seccomp_filter_set_add(c->syscall_filter, c->syscall_allow_list, syscall_filter_sets + SYSCALL_FILTER_SET_SETUID);
+                filter = hashmap_copy(c->syscall_filter);
+                if (!filter)
+                        return -ENOMEM;
+
+                r = seccomp_filter_set_add(filter, c->syscall_allow_list, syscall_filter_sets + SYSCALL_FILTER_SET_SETUID);
                 if (r < 0)
                         return r;
         }
 
-        return seccomp_load_syscall_filter_set_raw(default_action, c->syscall_filter, action, false);
+        return seccomp_load_syscall_filter_set_raw(default_action, filter ?: c->syscall_filter, action, false);
 }
 
 static int apply_syscall_log(const Unit* u, const ExecContext *c) {
@@ -1711,6 +1727,375 @@ static int apply_lock_personality(const Unit* u, const ExecContext *c) {
         return seccomp_lock_personality(personality);
 }
 
+static int apply_seccomp_filters_base(
+                const Unit *u,
+                const ExecContext *c,
+                int *ret_exit_status,
+                const char **ret_error) {
+
+        static const struct {
+                int (*apply)(const Unit *u, const ExecContext *c);
+                int exit_status;
+                const char *error;
+        } table[] = {
+                { apply_address_families,          EXIT_ADDRESS_FAMILIES, "Failed to restrict address families"                   },
+                { apply_memory_deny_write_execute, EXIT_SECCOMP,          "Failed to disable writing to executable memory"        },
+                { apply_restrict_realtime,         EXIT_SECCOMP,          "Failed to apply realtime restrictions"                 },
+                { apply_restrict_suid_sgid,        EXIT_SECCOMP,          "Failed to apply SUID/SGID restrictions"                },
+                { apply_restrict_namespaces,       EXIT_SECCOMP,          "Failed to apply namespace restrictions"                },
+                { apply_protect_sysctl,            EXIT_SECCOMP,          "Failed to apply sysctl restrictions"                   },
+                { apply_protect_kernel_modules,    EXIT_SECCOMP,          "Failed to apply module loading restrictions"           },
+                { apply_protect_kernel_logs,       EXIT_SECCOMP,          "Failed to apply kernel log restrictions"               },
+                { apply_protect_clock,             EXIT_SECCOMP,          "Failed to apply clock restrictions"                    },
+                { apply_private_devices,           EXIT_SECCOMP,          "Failed to set up private devices"                      },
+                { apply_syscall_archs,             EXIT_SECCOMP,          "Failed to apply syscall architecture restrictions"     },
+                { apply_lock_personality,          EXIT_SECCOMP,          "Failed to lock personalities"                          },
+                { apply_syscall_log,               EXIT_SECCOMP,          "Failed to apply system call log filters"               },
+        };
+        int r;
+
+        assert(u);
+        assert(c);
+        assert(ret_exit_status);
+        assert(ret_error);
+
+        /* Everything but SystemCallFilter= */
+
+        for (size_t i = 0; i < ELEMENTSOF(table); i++) {
+                r = table[i].apply(u, c);
+                if (r < 0) {
+                        *ret_exit_status = table[i].exit_status;
+                        *ret_error = table[i].error;
+                        return r;
+                }
+        }
+
+        return 0;
+}
+
+static int apply_seccomp_filters(
+                const Unit *u,
+                const ExecContext *c,
+                bool needs_ambient_hack,
+                int *ret_exit_status,
+                const char **ret_error) {
+
+        int r;
+
+        r = apply_seccomp_filters_base(u, c, ret_exit_status, ret_error);
+        if (r < 0)
+                return r;
+
+        /* This really should remain the last step before the execve(), to make sure our own code is unaffected
+         * by the filter as little as possible. */
+        r = apply_syscall_filter(u, c, needs_ambient_hack);
+        if (r < 0) {
+                *ret_exit_status = EXIT_SECCOMP;
+                *ret_error = "Failed to apply system call filters";
+                return r;
+        }
+
+        return 0;
+}
+
+typedef struct SeccompKeyItem {
+        uintptr_t key;
+        uintptr_t value;
+} SeccompKeyItem;
+
+static int seccomp_key_item_compare(const SeccompKeyItem *a, const SeccompKeyItem *b) {
+        return CMP(a->key, b->key);
+}
+
+static void seccomp_key_put_items(FILE *f, const char *field, SeccompKeyItem *items, size_t n_items) {
+        assert(f);
+        assert(field);
+
+        /* Sort, so that equal sets result in equal keys regardless of the order they were filled in */
+        typesafe_qsort(items, n_items, seccomp_key_item_compare);
+
+        fputs(field, f);
+        for (size_t i = 0; i < n_items; i++)
+                fprintf(f, " %" PRIuPTR ":%" PRIuPTR, items[i].key, items[i].value);
+        fputc('\n', f);
+}
+
+static int seccomp_key_put_hashmap(FILE *f, const char *field, Hashmap *h) {
+        _cleanup_free_ SeccompKeyItem *items = NULL;
+        size_t n_items = 0;
+        void *key, *value;
+
+        items = new(SeccompKeyItem, hashmap_size(h) + 1);
+        if (!items)
+                return -ENOMEM;
+
+        HASHMAP_FOREACH_KEY(value, key, h)
+                items[n_items++] = (SeccompKeyItem) { PTR_TO_UINT64(key), PTR_TO_UINT64(value) };
+
+        seccomp_key_put_items(f, field, items, n_items);
+        return 0;
+}
+
+static int seccomp_key_put_set(FILE *f, const char *field, Set *s) {
+        _cleanup_free_ SeccompKeyItem *items = NULL;
+        size_t n_items = 0;
+        void *key;
+
+        items = new(SeccompKeyItem, set_size(s) + 1);
+        if (!items)
+                return -ENOMEM;
+
+        SET_FOREACH(key, s)
+                items[n_items++] = (SeccompKeyItem) { PTR_TO_UINT64(key), 0 };
+
+        seccomp_key_put_items(f, field, items, n_items);
+        return 0;
+}
+
+static int exec_context_seccomp_keys(
+                const ExecContext *c,
+                bool needs_ambient_hack,
+                char **ret_base_key,
+                char **ret_syscall_filter_key) {
+
+        _cleanup_free_ char *base_key = NULL, *syscall_filter_key = NULL;
+        _cleanup_fclose_ FILE *f = NULL, *g = NULL;
+        size_t size;
+        int r;
+
+        assert(c);
+        assert(ret_base_key);
+        assert(ret_syscall_filter_key);
+
+        /* Serializes the settings apply_seccomp_filters_base() and apply_syscall_filter() look at, so that
+         * equal keys result in equal filters. The system call filter is cached on its own, since it's the
+         * expensive part to compile, and many units share the same one while differing in other settings. */
+
+        f = open_memstream_unlocked(&base_key, &size);
+        if (!f)
+                return -ENOMEM;
+
+        fprintf(f,
+                "base\n"
+                "address-families-allow-list=%s\n"
+                "memory-deny-write-execute=%s\n"
+                "restrict-realtime=%s\n"
+                "restrict-suid-sgid=%s\n"
+                "restrict-namespaces=%lu\n"
+                "protect-kernel-tunables=%s\n"
+                "protect-kernel-modules=%s\n"
+                "protect-kernel-logs=%s\n"
+                "protect-clock=%s\n"
+                "private-devices=%s\n"
+                "lock-personality=%s\n"
+                "personality=%lu\n"
+                "syscall-log-allow-list=%s\n",
+                yes_no(c->address_families_allow_list),
+                yes_no(c->memory_deny_write_execute),
+                yes_no(c->restrict_realtime),
+                yes_no(c->restrict_suid_sgid),
+                c->restrict_namespaces,
+                yes_no(c->protect_kernel_tunables),
+                yes_no(c->protect_kernel_modules),
+                yes_no(c->protect_kernel_logs),
+                yes_no(c->protect_clock),
+                yes_no(c->private_devices),
+                yes_no(c->lock_personality),
+                c->personality,
+                yes_no(c->syscall_log_allow_list));
+
+        r = seccomp_key_put_set(f, "address-families=", c->address_families);
+        if (r < 0)
+                return r;
+
+        r = seccomp_key_put_set(f, "syscall-archs=", c->syscall_archs);
+        if (r < 0)
+                return r;
+
+        r = seccomp_key_put_hashmap(f, "syscall-log=", c->syscall_log);
+        if (r < 0)
+                return r;
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        f = safe_fclose(f);
+
+        /* SystemCallArchitectures= determines which architectures the system call filter is compiled for,
+         * hence it is part of both keys. */
+
+        g = open_memstream_unlocked(&syscall_filter_key, &size);
+        if (!g)
+                return -ENOMEM;
+
+        fprintf(g,
+                "syscall-filter\n"
+                "ambient-hack=%s\n"
+                "syscall-allow-list=%s\n"
+                "syscall-errno=%i\n",
+                yes_no(needs_ambient_hack),
+                yes_no(c->syscall_allow_list),
+                c->syscall_errno);
+
+        r = seccomp_key_put_set(g, "syscall-archs=", c->syscall_archs);
+        if (r < 0)
+                return r;
+
+        r = seccomp_key_put_hashmap(g, "syscall-filter=", c->syscall_filter);
+        if (r < 0)
+                return r;
+
+        r = fflush_and_check(g);
+        if (r < 0)
+                return r;
+
+        g = safe_fclose(g);
+
+        *ret_base_key = TAKE_PTR(base_key);
+        *ret_syscall_filter_key = TAKE_PTR(syscall_filter_key);
+        return 0;
+}
+
+DEFINE_PRIVATE_HASH_OPS_FULL(seccomp_programs_hash_ops,
+                             char, string_hash_func, string_compare_func, free,
+                             SeccompPrograms, seccomp_programs_free);
+
+/* Don't let the cache grow without bounds if the settings keep changing */
+#define EXEC_SECCOMP_PROGRAMS_MAX 256U
+
+static int exec_seccomp_programs_put(Manager *m, char **key, SeccompPrograms **programs) {
+        int r;
+
+        assert(m);
+        assert(key);
+        assert(programs);
+
+        r = hashmap_ensure_put(&m->exec_seccomp_programs, &seccomp_programs_hash_ops, *key, *programs);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(*key);
+        TAKE_PTR(*programs);
+        return 0;
+}
+
+static int exec_seccomp_programs_get(
+                Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                ExecSeccompPrograms *ret) {
+
+        _cleanup_(seccomp_programs_freep) SeccompPrograms *base = NULL, *syscall_filter = NULL, *scratch = NULL;
+        _cleanup_free_ char *base_key = NULL, *syscall_filter_key = NULL;
+        const SeccompPrograms *cached_base, *cached_syscall_filter = NULL;
+        bool needs_ambient_hack, has_syscall_filter;
+        const char *error = NULL;
+        int r, k, exit_status;
+
+        assert(unit);
+        assert(command);
+        assert(context);
+        assert(params);
+        assert(ret);
+
+        /* Compiling the seccomp filters in each forked off child is comparatively expensive and mostly
+         * redundant, since many units (instances of the same template in particular) use the very same
+         * settings. Hence compile them once in the manager, and let the child just install the result. If
+         * anything goes wrong here, we return 0 and the child compiles the filters on its own, as before. */
+
+        if (!(params->flags & EXEC_APPLY_SANDBOXING) || (command->flags & EXEC_COMMAND_FULLY_PRIVILEGED))
+                return 0;
+
+        has_syscall_filter = context_has_syscall_filters(context);
+
+        if (!context_has_address_families(context) &&
+            !context->memory_deny_write_execute &&
+            !context->restrict_realtime &&
+            !context->restrict_suid_sgid &&
+            !exec_context_restrict_namespaces_set(context) &&
+            !context->protect_kernel_tunables &&
+            !context->protect_kernel_modules &&
+            !context->protect_kernel_logs &&
+            !context->protect_clock &&
+            !context->private_devices &&
+            set_isempty(context->syscall_archs) &&
+            !context->lock_personality &&
+            !context_has_syscall_logs(context) &&
+            !has_syscall_filter)
+                return 0;
+
+        /* Let the child log about this */
+        if (!is_seccomp_available())
+                return 0;
+
+        needs_ambient_hack = (command->flags & EXEC_COMMAND_AMBIENT_MAGIC) && !ambient_capabilities_supported();
+
+        r = exec_context_seccomp_keys(context, needs_ambient_hack, &base_key, &syscall_filter_key);
+        if (r < 0)
+                return log_unit_debug_errno(unit, r, "Failed to serialize seccomp settings, not precompiling seccomp filters: %m");
+
+        /* Make room before looking anything up, so that we don't flush what we are about to return */
+        if (hashmap_size(unit->manager->exec_seccomp_programs) + 2 > EXEC_SECCOMP_PROGRAMS_MAX)
+                hashmap_clear(unit->manager->exec_seccomp_programs);
+
+        cached_base = hashmap_get(unit->manager->exec_seccomp_programs, base_key);
+        if (has_syscall_filter)
+                cached_syscall_filter = hashmap_get(unit->manager->exec_seccomp_programs, syscall_filter_key);
+
+        if (!cached_base || (has_syscall_filter && !cached_syscall_filter)) {
+                base = new0(SeccompPrograms, 1);
+                syscall_filter = new0(SeccompPrograms, 1);
+                scratch = new0(SeccompPrograms, 1);
+                if (!base || !syscall_filter || !scratch)
+                        return log_oom_debug();
+
+                /* The system call filter is compiled for the architectures that are left after
+                 * SystemCallArchitectures=, hence even if we have the rest already, we need to go through
+                 * that to get there. */
+                seccomp_record_begin(cached_base ? scratch : base);
+                if (cached_base) {
+                        r = apply_syscall_archs(unit, context);
+                        if (r < 0)
+                                error = "Failed to apply syscall architecture restrictions";
+                } else
+                        r = apply_seccomp_filters_base(unit, context, &exit_status, &error);
+                if (r >= 0 && has_syscall_filter && !cached_syscall_filter) {
+                        seccomp_record_switch(syscall_filter);
+                        r = apply_syscall_filter(unit, context, needs_ambient_hack);
+                        if (r < 0)
+                                error = "Failed to apply system call filters";
+                }
+                k = seccomp_record_end();
+                if (r >= 0)
+                        r = k;
+                if (r < 0)
+                        return log_unit_debug_errno(unit, r, "%s, compiling seccomp filters in the child: %m",
+                                                    error ?: "Failed to precompile seccomp filters");
+
+                if (!cached_base) {
+                        cached_base = base;
+                        r = exec_seccomp_programs_put(unit->manager, &base_key, &base);
+                        if (r < 0)
+                                return log_unit_debug_errno(unit, r, "Failed to cache seccomp filters, compiling them in the child: %m");
+                }
+
+                if (has_syscall_filter && !cached_syscall_filter) {
+                        cached_syscall_filter = syscall_filter;
+                        r = exec_seccomp_programs_put(unit->manager, &syscall_filter_key, &syscall_filter);
+                        if (r < 0)
+                                return log_unit_debug_errno(unit, r, "Failed to cache seccomp filters, compiling them in the child: %m");
+                }
+        }
+
+        *ret = (ExecSeccompPrograms) {
+                .base = cached_base,
+                .syscall_filter = cached_syscall_filter,
+        };
+        return 1;
+}
+
 #endif
 
 static int apply_protect_hostname(const Unit *u, const ExecContext *c, int *ret_exit_status) {
@@ -3740,6 +4125,7 @@ static int exec_child(
                 size_t n_storage_fds,
                 char **files_env,
                 int user_lookup_fd,
+                const ExecSeccompPrograms *seccomp_programs,
                 int *exit_status) {
 
         _cleanup_strv_free_ char **our_env = NULL, **pass_env = NULL, **accum_env = NULL, **replaced_argv = NULL;
@@ -3775,6 +4161,7 @@ static int exec_child(
         int secure_bits;
         _cleanup_free_ gid_t *gids_after_pam = NULL;
         int ngids_after_pam = 0;
+        usec_t exec_child_begin;
 
         assert(unit);
         assert(command);
@@ -3782,6 +4169,8 @@ static int exec_child(
         assert(params);
         assert(exit_status);
 
+        exec_child_begin = now(CLOCK_MONOTONIC);
+
         rename_process_from_path(command->path);
 
         /* We reset exactly these signals, since they are the only ones we set to SIG_IGN in the main
@@ -4292,7 +4681,11 @@ static int exec_child(
         if (needs_mount_namespace) {
                 _cleanup_free_ char *error_path = NULL;
 
+                usec_t begin = now(CLOCK_MONOTONIC);
+
                 r = apply_mount_namespace(unit, command->flags, context, params, runtime, &error_path);
+                unit_phases_record(unit->manager->unit_phases, unit->id, UNIT_PHASE_NAMESPACE,
+                                   begin, now(CLOCK_MONOTONIC));
                 if (r < 0) {
                         *exit_status = EXIT_NAMESPACE;
                         return log_unit_error_errno(unit, r, "Failed to set up mount namespacing%s%s: %m",
@@ -4574,90 +4967,27 @@ static int exec_child(
                         }
 
 #if HAVE_SECCOMP
-                r = apply_address_families(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_ADDRESS_FAMILIES;
-                        return log_unit_error_errno(unit, r, "Failed to restrict address families: %m");
-                }
-
-                r = apply_memory_deny_write_execute(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to disable writing to executable memory: %m");
-                }
-
-                r = apply_restrict_realtime(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply realtime restrictions: %m");
-                }
-
-                r = apply_restrict_suid_sgid(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply SUID/SGID restrictions: %m");
-                }
-
-                r = apply_restrict_namespaces(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply namespace restrictions: %m");
-                }
-
-                r = apply_protect_sysctl(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply sysctl restrictions: %m");
-                }
-
-                r = apply_protect_kernel_modules(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply module loading restrictions: %m");
-                }
-
-                r = apply_protect_kernel_logs(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply kernel log restrictions: %m");
-                }
-
-                r = apply_protect_clock(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply clock restrictions: %m");
-                }
-
-                r = apply_private_devices(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to set up private devices: %m");
-                }
-
-                r = apply_syscall_archs(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply syscall architecture restrictions: %m");
-                }
-
-                r = apply_lock_personality(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to lock personalities: %m");
-                }
+                if (seccomp_programs) {
+                        r = seccomp_programs_load(seccomp_programs->base);
+                        if (r < 0) {
+                                *exit_status = EXIT_SECCOMP;
+                                return log_unit_error_errno(unit, r, "Failed to install seccomp filters: %m");
+                        }
 
-                r = apply_syscall_log(unit, context);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply system call log filters: %m");
-                }
+                        /* This really should remain the last step before the execve(), see above. */
+                        if (seccomp_programs->syscall_filter) {
+                                r = seccomp_programs_load(seccomp_programs->syscall_filter);
+                                if (r < 0) {
+                                        *exit_status = EXIT_SECCOMP;
+                                        return log_unit_error_errno(unit, r, "Failed to apply system call filters: %m");
+                                }
+                        }
+                } else {
+                        const char *error = NULL;
 
-                /* This really should remain the last step before the execve(), to make sure our own code is unaffected
-                 * by the filter as little as possible. */
-                r = apply_syscall_filter(unit, context, needs_ambient_hack);
-                if (r < 0) {
-                        *exit_status = EXIT_SECCOMP;
-                        return log_unit_error_errno(unit, r, "Failed to apply system call filters: %m");
+                        r = apply_seccomp_filters(unit, context, needs_ambient_hack, exit_status, &error);
+                        if (r < 0)
+                                return log_unit_error_errno(unit, r, "%s: %m", error);
                 }
 #endif
         }
@@ -4710,6 +5040,9 @@ static int exec_child(
                 }
         }
 
+        unit_phases_record(unit->manager->unit_phases, unit->id, UNIT_PHASE_EXEC_SETUP,
+                           exec_child_begin, now(CLOCK_MONOTONIC));
+
         r = fexecve_or_execve(executable_fd, executable, final_argv, accum_env);
 
         if (exec_fd >= 0) {
@@ -4731,6 +5064,50 @@ static int exec_child(
 static int exec_context_load_environment(const Unit *unit, const ExecContext *c, char ***l);
 static int exec_context_named_iofds(const ExecContext *c, const ExecParameters *p, int named_iofds[static 3]);
 
+static pid_t exec_fork(const Unit *unit, const char *cgroup_path, bool *ret_in_cgroup) {
+        static bool clone_into_cgroup_unsupported = false;
+        _cleanup_close_ int cgroup_fd = -1;
+        pid_t pid;
+
+        assert(unit);
+        assert(ret_in_cgroup);
+
+        /* On the unified hierarchy, let the kernel create the child right in its cgroup. This saves the
+         * migration of the new process afterwards, which is not cheap when many processes are started at
+         * once, since it means taking the global cgroup lock for each of them. If that's not available,
+         * fall back to fork() and attaching the process to the cgroup later. */
+        if (cgroup_path && !clone_into_cgroup_unsupported && cg_all_unified() > 0) {
+                _cleanup_free_ char *p = NULL;
+                int r;
+
+                r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, cgroup_path, NULL, &p);
+                if (r >= 0) {
+                        cgroup_fd = open(p, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+                        if (cgroup_fd < 0)
+                                r = -errno;
+                }
+                if (r < 0)
+                        log_unit_debug_errno(unit, r, "Failed to open control group '%s', not creating process in it directly: %m", cgroup_path);
+        }
+
+        if (cgroup_fd >= 0) {
+                pid = raw_clone_into_cgroup(cgroup_fd);
+                if (pid >= 0) {
+                        *ret_in_cgroup = true;
+                        return pid;
+                }
+
+                if (IN_SET(errno, ENOSYS, E2BIG, EINVAL)) {
+                        log_unit_debug_errno(unit, errno, "clone3() with CLONE_INTO_CGROUP not supported, falling back to fork(): %m");
+                        clone_into_cgroup_unsupported = true;
+                } else
+                        log_unit_debug_errno(unit, errno, "Failed to create process in control group '%s', falling back to fork(): %m", cgroup_path);
+        }
+
+        *ret_in_cgroup = false;
+        return fork();
+}
+
 int exec_spawn(Unit *unit,
                ExecCommand *command,
                const ExecContext *context,
@@ -4743,7 +5120,11 @@ int exec_spawn(Unit *unit,
         _cleanup_free_ char *subcgroup_path = NULL;
         _cleanup_strv_free_ char **files_env = NULL;
         size_t n_storage_fds = 0, n_socket_fds = 0;
+        ExecSeccompPrograms seccomp_programs = {};
         _cleanup_free_ char *line = NULL;
+        bool have_seccomp_programs = false;
+        usec_t fork_begin;
+        bool in_cgroup;
         pid_t pid;
 
         assert(unit);
@@ -4810,7 +5191,13 @@ int exec_spawn(Unit *unit,
                 }
         }
 
-        pid = fork();
+#if HAVE_SECCOMP
+        have_seccomp_programs = exec_seccomp_programs_get(unit, command, context, params, &seccomp_programs) > 0;
+#endif
+
+        fork_begin = now(CLOCK_MONOTONIC);
+
+        pid = exec_fork(unit, subcgroup_path, &in_cgroup);
         if (pid < 0)
                 return log_unit_error_errno(unit, errno, "Failed to fork: %m");
 
@@ -4830,6 +5217,7 @@ int exec_spawn(Unit *unit,
                                n_storage_fds,
                                files_env,
                                unit->manager->user_lookup_fds[1],
+                               have_seccomp_programs ? &seccomp_programs : NULL,
                                &exit_status);
 
                 if (r < 0) {
@@ -4848,12 +5236,14 @@ int exec_spawn(Unit *unit,
                 _exit(exit_status);
         }
 
+        unit_phases_record(unit->manager->unit_phases, unit->id, UNIT_PHASE_FORK, fork_begin, now(CLOCK_MONOTONIC));
+
         log_unit_debug(unit, "Forked %s as "PID_FMT, command->path, pid);
 
         /* We add the new process to the cgroup both in the child (so that we can be sure that no user code is ever
          * executed outside of the cgroup) and in the parent (so that we can be sure that when we kill the cgroup the
-         * process will be killed too). */
-        if (subcgroup_path)
+         * process will be killed too). The latter is not needed if the process was created in the cgroup. */
+        if (subcgroup_path && !in_cgroup)
                 (void) cg_attach(SYSTEMD_CGROUP_CONTROLLER, subcgroup_path, pid);
 
         exec_status_start(&command->exec_status, pid);
@@ -4965,6 +5355,7 @@ void exec_context_done(ExecContext *c) {
         c->ipc_namespace_path = mfree(c->ipc_namespace_path);
 
         c->log_namespace = mfree(c->log_namespace);
+        c->log_namespace_shards = 0;
 
         c->load_credentials = hashmap_free(c->load_credentials);
         c->set_credentials = hashmap_free(c->set_credentials);
@@ -5557,6 +5948,9 @@ void exec_context_dump(const ExecContext *c, FILE* f, const char *prefix) {
         if (c->log_namespace)
                 fprintf(f, "%sLogNamespace: %s\n", prefix, c->log_namespace);
 
+        if (c->log_namespace_shards > 0)
+                fprintf(f, "%sLogNamespaceShards: %u\n", prefix, c->log_namespace_shards);
+
         if (c->secure_bits) {
                 _cleanup_free_ char *str = NULL;
 
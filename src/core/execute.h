@@ -281,6 +281,7 @@ struct ExecContext {
         int log_level_max;
 
         char *log_namespace;
+        unsigned log_namespace_shards;
 
         ProtectProc protect_proc;  /* hidepid= */
         ProcSubset proc_subset;    /* subset= */
@@ -6,6 +6,7 @@
 #include "macro.h"
 #include "mkdir.h"
 #include "rm-rf.h"
+#include "string-util.h"
 
 int lookup_paths_mkdir_generator(LookupPaths *p) {
         int r, q;
@@ -53,6 +54,10 @@ void lookup_paths_flush_generator(LookupPaths *p) {
         if (p->generator_late)
                 (void) rm_rf(p->generator_late, REMOVE_ROOT|REMOVE_PHYSICAL);
 
+        /* The inputs the generators declared, see manager_run_generators() */
+        if (p->generator)
+                (void) rm_rf(strjoina(p->generator, ".inputs"), REMOVE_ROOT|REMOVE_PHYSICAL);
+
         if (p->temporary_dir)
                 (void) rm_rf(p->temporary_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
 }
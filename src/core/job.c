@@ -16,8 +16,10 @@
 #include "log.h"
 #include "macro.h"
 #include "parse-util.h"
+#include "psi-util.h"
 #include "serialize.h"
 #include "set.h"
+#include "slice.h"
 #include "sort-util.h"
 #include "special.h"
 #include "stdio-util.h"
@@ -107,6 +109,18 @@ Job* job_free(Job *j) {
         return mfree(j);
 }
 
+static void job_count_start_job(Job *j) {
+        assert(j);
+
+        /* Only start jobs of units that fork off processes count towards StartJobsMax=, all others are
+         * quick and don't put any load on the system. */
+        if (j->type != JOB_START || !unit_get_exec_context(j->unit))
+                return;
+
+        j->unit->manager->n_running_start_jobs++;
+        j->start_jobs_counted = true;
+}
+
 static void job_set_state(Job *j, JobState state) {
         assert(j);
         assert(state >= 0);
@@ -120,9 +134,10 @@ static void job_set_state(Job *j, JobState state) {
         if (!j->installed)
                 return;
 
-        if (j->state == JOB_RUNNING)
+        if (j->state == JOB_RUNNING) {
                 j->unit->manager->n_running_jobs++;
-        else {
+                job_count_start_job(j);
+        } else {
                 assert(j->state == JOB_WAITING);
                 assert(j->unit->manager->n_running_jobs > 0);
 
@@ -130,6 +145,16 @@ static void job_set_state(Job *j, JobState state) {
 
                 if (j->unit->manager->n_running_jobs <= 0)
                         j->unit->manager->jobs_in_progress_event_source = sd_event_source_disable_unref(j->unit->manager->jobs_in_progress_event_source);
+
+                if (j->start_jobs_counted) {
+                        assert(j->unit->manager->n_running_start_jobs > 0);
+
+                        j->unit->manager->n_running_start_jobs--;
+                        j->start_jobs_counted = false;
+
+                        /* A slot became available, let the jobs we held back try again */
+                        manager_release_throttled_jobs(j->unit->manager);
+                }
         }
 }
 
@@ -156,6 +181,7 @@ void job_uninstall(Job *j) {
         unit_add_to_dbus_queue(j->unit); /* The Job property of the unit has changed now */
 
         hashmap_remove_value(j->manager->jobs, UINT32_TO_PTR(j->id), j);
+        set_remove(j->manager->throttled_jobs, j);
         j->installed = false;
 }
 
@@ -272,8 +298,10 @@ int job_install_deserialized(Job *j) {
         *pj = j;
         j->installed = true;
 
-        if (j->state == JOB_RUNNING)
+        if (j->state == JOB_RUNNING) {
                 j->unit->manager->n_running_jobs++;
+                job_count_start_job(j);
+        }
 
         log_unit_debug(j->unit,
                        "Reinstalled deserialized job %s/%s as %u",
@@ -1024,6 +1052,9 @@ int job_start_timer(Job *j, bool job_running) {
         if (job_running) {
                 j->begin_running_usec = now(CLOCK_MONOTONIC);
 
+                unit_phases_record(j->manager->unit_phases, j->unit->id, UNIT_PHASE_JOB_WAIT,
+                                   j->begin_usec, j->begin_running_usec);
+
                 if (j->unit->job_running_timeout == USEC_INFINITY)
                         return 0;
 
@@ -1075,6 +1106,8 @@ void job_add_to_run_queue(Job *j) {
         if (j->in_run_queue)
                 return;
 
+        set_remove(j->manager->throttled_jobs, j);
+
         if (prioq_isempty(j->manager->run_queue)) {
                 r = sd_event_source_set_enabled(j->manager->run_queue_event_source, SD_EVENT_ONESHOT);
                 if (r < 0)
@@ -1088,6 +1121,108 @@ void job_add_to_run_queue(Job *j) {
                 j->in_run_queue = true;
 }
 
+static unsigned slice_n_running_start_jobs(Unit *slice) {
+        unsigned n = 0;
+        Job *j;
+
+        assert(slice);
+
+        HASHMAP_FOREACH(j, slice->manager->jobs) {
+                if (!j->start_jobs_counted)
+                        continue;
+
+                for (Unit *s = UNIT_GET_SLICE(j->unit); s; s = UNIT_GET_SLICE(s))
+                        if (s == slice) {
+                                n++;
+                                break;
+                        }
+        }
+
+        return n;
+}
+
+static bool io_pressure_exceeded(Manager *m) {
+        ResourcePressure rp;
+        loadavg_t limit;
+        int r;
+
+        assert(m);
+
+        r = read_resource_pressure("/proc/pressure/io", PRESSURE_TYPE_SOME, &rp);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to read IO pressure, ignoring StartJobsIOPressureMax=: %m");
+                return false;
+        }
+
+        assert_se(store_loadavg_fixed_point(m->start_jobs_io_pressure_max, 0, &limit) >= 0);
+
+        return rp.avg10 > limit;
+}
+
+bool job_is_throttled(Job *j, int *io_pressure_cache) {
+        Manager *m;
+
+        assert(j);
+        assert(j->installed);
+        assert(io_pressure_cache);
+
+        m = j->manager;
+
+        /* Checks whether starting the job shall wait until some of the start jobs currently running
+         * finished. *io_pressure_cache is negative if the IO pressure hasn't been read yet, so that it is
+         * read at most once per run queue dispatch. */
+
+        if (j->type != JOB_START || j->state != JOB_WAITING || !unit_get_exec_context(j->unit))
+                return false;
+
+        if (m->start_jobs_max > 0 && m->n_running_start_jobs >= m->start_jobs_max) {
+                log_unit_debug(j->unit, "Starting held back, %u start jobs running already.", m->n_running_start_jobs);
+                return true;
+        }
+
+        for (Unit *s = UNIT_GET_SLICE(j->unit); s; s = UNIT_GET_SLICE(s)) {
+                unsigned n;
+
+                if (SLICE(s)->start_jobs_max == 0)
+                        continue;
+
+                n = slice_n_running_start_jobs(s);
+                if (n >= SLICE(s)->start_jobs_max) {
+                        log_unit_debug(j->unit, "Starting held back, %u start jobs running in %s already.", n, s->id);
+                        return true;
+                }
+        }
+
+        /* Always let at least one job run, so that we make progress even under constant IO pressure */
+        if (m->start_jobs_io_pressure_max > 0 && m->n_running_start_jobs > 0) {
+                if (*io_pressure_cache < 0)
+                        *io_pressure_cache = io_pressure_exceeded(m);
+
+                if (*io_pressure_cache > 0) {
+                        log_unit_debug(j->unit, "Starting held back, IO pressure exceeds %i%%.", m->start_jobs_io_pressure_max);
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+int job_throttle(Job *j) {
+        int r;
+
+        assert(j);
+        assert(j->in_run_queue);
+
+        r = set_ensure_put(&j->manager->throttled_jobs, NULL, j);
+        if (r < 0)
+                return r;
+
+        prioq_remove(j->manager->run_queue, j, &j->run_queue_idx);
+        j->in_run_queue = false;
+
+        return 0;
+}
+
 void job_add_to_dbus_queue(Job *j) {
         assert(j);
         assert(j->installed);
@@ -1148,7 +1283,7 @@ int job_deserialize(Job *j, FILE *f) {
                 char *l, *v;
                 size_t k;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
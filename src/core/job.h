@@ -153,6 +153,7 @@ struct Job {
 
         bool installed:1;
         bool in_run_queue:1;
+        bool start_jobs_counted:1; /* counted in Manager.n_running_start_jobs */
         bool matters_to_anchor:1;
         bool in_dbus_queue:1;
         bool sent_dbus_new_signal:1;
@@ -207,6 +208,8 @@ JobType job_type_collapse(JobType t, Unit *u);
 int job_type_merge_and_collapse(JobType *a, JobType b, Unit *u);
 
 void job_add_to_run_queue(Job *j);
+bool job_is_throttled(Job *j, int *io_pressure_exceeded);
+int job_throttle(Job *j);
 void job_add_to_dbus_queue(Job *j);
 
 int job_start_timer(Job *j, bool job_running);
@@ -1,11 +1,14 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include "conf-parser.h"
+#include "fd-util.h"
 #include "fs-util.h"
 #include "load-dropin.h"
 #include "load-fragment.h"
+#include "load-prefetch.h"
 #include "log.h"
 #include "stat-util.h"
+#include "string-intern.h"
 #include "string-util.h"
 #include "strv.h"
 #include "unit-name.h"
@@ -104,23 +107,31 @@ int unit_load_dropin(Unit *u) {
         if (r <= 0)
                 return 0;
 
-        if (!u->dropin_paths)
-                u->dropin_paths = TAKE_PTR(l);
-        else {
-                r = strv_extend_strv(&u->dropin_paths, l, true);
-                if (r < 0)
-                        return log_oom();
-        }
+        r = strv_extend_interned(&u->dropin_paths, l);
+        if (r < 0)
+                return log_oom();
 
         u->dropin_mtime = 0;
-        STRV_FOREACH(f, u->dropin_paths)
+        STRV_FOREACH(f, u->dropin_paths) {
+                _cleanup_fclose_ FILE *file = NULL;
+                struct stat st;
+
+                r = load_prefetch_fopen(u->manager->load_prefetch, *f, &file, &st);
+                if (r < 0) {
+                        log_unit_debug_errno(u, r, "Failed to open configuration file '%s', ignoring: %m", *f);
+                        continue;
+                }
+
+                u->dropin_mtime = MAX(u->dropin_mtime, timespec_load(&st.st_mtim));
+
                 (void) config_parse(
-                                u->id, *f, NULL,
+                                u->id, *f, file,
                                 UNIT_VTABLE(u)->sections,
                                 config_item_perf_lookup, load_fragment_gperf_lookup,
                                 0,
                                 u,
-                                &u->dropin_mtime);
+                                NULL);
+        }
 
         return 0;
 }
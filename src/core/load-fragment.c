@@ -44,6 +44,7 @@
 #include "journal-file.h"
 #include "limits-util.h"
 #include "load-fragment.h"
+#include "load-prefetch.h"
 #include "log.h"
 #include "mountpoint-util.h"
 #include "nulstr-util.h"
@@ -60,6 +61,7 @@
 #include "socket-netlink.h"
 #include "specifier.h"
 #include "stat-util.h"
+#include "string-intern.h"
 #include "string-util.h"
 #include "strv.h"
 #include "syslog-util.h"
@@ -5768,7 +5770,8 @@ int unit_load_fragment(Unit *u) {
                                      &u->manager->unit_cache_timestamp_hash,
                                      &u->manager->unit_id_map,
                                      &u->manager->unit_name_map,
-                                     &u->manager->unit_path_cache);
+                                     &u->manager->unit_path_cache,
+                                     &u->manager->unit_dir_cache);
         if (r < 0)
                 return log_error_errno(r, "Failed to rebuild name map: %m");
 
@@ -5788,14 +5791,11 @@ int unit_load_fragment(Unit *u) {
                 /* Try to open the file name. A symlink is OK, for example for linked files or masks. We
                  * expect that all symlinks within the lookup paths have been already resolved, but we don't
                  * verify this here. */
-                f = fopen(fragment, "re");
-                if (!f)
-                        return log_unit_notice_errno(u, errno, "Failed to open %s: %m", fragment);
-
-                if (fstat(fileno(f), &st) < 0)
-                        return -errno;
+                r = load_prefetch_fopen(u->manager->load_prefetch, fragment, &f, &st);
+                if (r < 0)
+                        return log_unit_notice_errno(u, r, "Failed to open %s: %m", fragment);
 
-                r = free_and_strdup(&u->fragment_path, fragment);
+                r = string_intern_replace(&u->fragment_path, fragment);
                 if (r < 0)
                         return r;
 
@@ -0,0 +1,297 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "hashmap.h"
+#include "load-dropin.h"
+#include "load-prefetch.h"
+#include "log.h"
+#include "manager.h"
+#include "path-util.h"
+#include "set.h"
+#include "stat-util.h"
+#include "unit-file.h"
+
+/* Starting threads is not worth it for a handful of units */
+#define LOAD_PREFETCH_UNITS_MIN 32U
+#define LOAD_PREFETCH_FILES_PER_THREAD 64U
+#define LOAD_PREFETCH_THREADS_MAX 16U
+
+typedef struct PrefetchedFile {
+        char *path;
+        int error;              /* negative errno if reading the file failed */
+        struct stat st;
+        char *contents;
+        size_t size;
+} PrefetchedFile;
+
+struct LoadPrefetch {
+        PrefetchedFile *files;
+        size_t n_files;
+        size_t next_file;       /* the next file to read, shared between the threads */
+
+        Hashmap *by_path;       /* path → PrefetchedFile */
+        Set *units;             /* the units we prefetched files for that have not been loaded yet */
+};
+
+LoadPrefetch* load_prefetch_free(LoadPrefetch *p) {
+        if (!p)
+                return NULL;
+
+        for (size_t i = 0; i < p->n_files; i++) {
+                free(p->files[i].path);
+                free(p->files[i].contents);
+        }
+        free(p->files);
+
+        hashmap_free(p->by_path);
+        set_free(p->units);
+
+        return mfree(p);
+}
+
+static int collect_unit_paths(Manager *m, Unit *u, Set **paths) {
+        _cleanup_set_free_free_ Set *names = NULL;
+        _cleanup_strv_free_ char **dropins = NULL;
+        const char *fragment;
+        int r;
+
+        assert(m);
+        assert(u);
+        assert(paths);
+
+        r = unit_file_find_fragment(m->unit_id_map, m->unit_name_map, u->id, &fragment, &names);
+        if (r < 0 && r != -ENOENT)
+                return r;
+
+        if (fragment) {
+                r = set_put_strdup_full(paths, &path_hash_ops_free, fragment);
+                if (r < 0)
+                        return r;
+        }
+
+        /* The aliases of the unit are only known once the fragment has been loaded, but the names from
+         * the name map are a good guess. If we miss a drop-in, it's read when the unit is loaded. */
+        r = unit_file_find_dropin_paths(NULL,
+                                        m->lookup_paths.search_path,
+                                        m->unit_path_cache,
+                                        ".d", ".conf",
+                                        u->id, names,
+                                        &dropins);
+        if (r < 0)
+                return r;
+
+        return set_put_strdupv_full(paths, &path_hash_ops_free, dropins);
+}
+
+static void prefetch_file(PrefetchedFile *f) {
+        _cleanup_fclose_ FILE *file = NULL;
+        int r;
+
+        assert(f);
+
+        /* Runs in the worker threads, hence don't touch anything but f here. */
+
+        r = fopen_unlocked(f->path, "re", &file);
+        if (r < 0) {
+                f->error = r;
+                return;
+        }
+
+        if (fstat(fileno(file), &f->st) < 0) {
+                f->error = -errno;
+                return;
+        }
+
+        /* Masked, there's nothing to read */
+        if (null_or_empty(&f->st))
+                return;
+
+        r = read_full_stream(file, &f->contents, &f->size);
+        if (r < 0)
+                f->error = r;
+}
+
+static void* prefetch_thread(void *userdata) {
+        LoadPrefetch *p = userdata;
+
+        assert(p);
+
+        for (;;) {
+                size_t i;
+
+                i = __sync_fetch_and_add(&p->next_file, 1);
+                if (i >= p->n_files)
+                        break;
+
+                prefetch_file(p->files + i);
+        }
+
+        return NULL;
+}
+
+static void prefetch_files(LoadPrefetch *p) {
+        pthread_t threads[LOAD_PREFETCH_THREADS_MAX];
+        sigset_t ss, saved_ss;
+        size_t n, n_threads = 0;
+        bool blocked = false;
+        long cpus;
+        int r;
+
+        assert(p);
+
+        n = MIN(p->n_files / LOAD_PREFETCH_FILES_PER_THREAD, LOAD_PREFETCH_THREADS_MAX);
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus > 0)
+                n = MIN(n, (size_t) cpus - 1); /* The main thread takes a share of the work, too */
+
+        /* Block all signals while starting the threads, so that they are started with all signals blocked,
+         * and don't affect signal handling of the main thread. */
+        if (n > 0) {
+                assert_se(sigfillset(&ss) >= 0);
+                r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+                if (r > 0) {
+                        log_debug_errno(r, "Failed to block signals, not starting threads for reading unit files: %m");
+                        n = 0;
+                } else
+                        blocked = true;
+        }
+
+        for (; n_threads < n; n_threads++) {
+                r = pthread_create(threads + n_threads, NULL, prefetch_thread, p);
+                if (r > 0) {
+                        log_debug_errno(r, "Failed to start thread for reading unit files, continuing with %zu threads: %m",
+                                        n_threads);
+                        break;
+                }
+        }
+
+        if (blocked)
+                assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+
+        (void) prefetch_thread(p);
+
+        for (size_t i = 0; i < n_threads; i++)
+                assert_se(pthread_join(threads[i], NULL) == 0);
+
+        log_debug("Read %zu unit files with %zu additional threads.", p->n_files, n_threads);
+}
+
+int load_prefetch_new(Manager *m, LoadPrefetch **ret) {
+        _cleanup_(load_prefetch_freep) LoadPrefetch *p = NULL;
+        _cleanup_set_free_free_ Set *paths = NULL;
+        size_t n_units = 0;
+        char *path;
+        Unit *u;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        LIST_FOREACH(load_queue, u, m->load_queue)
+                n_units++;
+
+        if (n_units < LOAD_PREFETCH_UNITS_MIN) {
+                *ret = NULL;
+                return 0;
+        }
+
+        /* unit_load_fragment() does this for each unit, but we need the map to find the files upfront */
+        r = unit_file_build_name_map(&m->lookup_paths,
+                                     &m->unit_cache_timestamp_hash,
+                                     &m->unit_id_map,
+                                     &m->unit_name_map,
+                                     &m->unit_path_cache,
+                                     &m->unit_dir_cache);
+        if (r < 0)
+                return log_error_errno(r, "Failed to rebuild name map: %m");
+
+        p = new0(LoadPrefetch, 1);
+        if (!p)
+                return -ENOMEM;
+
+        LIST_FOREACH(load_queue, u, m->load_queue) {
+                if (u->transient)
+                        continue;
+
+                r = collect_unit_paths(m, u, &paths);
+                if (r < 0)
+                        return r;
+
+                r = set_ensure_put(&p->units, NULL, u);
+                if (r < 0)
+                        return r;
+        }
+
+        if (set_isempty(paths)) {
+                *ret = NULL;
+                return 0;
+        }
+
+        p->files = new0(PrefetchedFile, set_size(paths));
+        if (!p->files)
+                return -ENOMEM;
+
+        while ((path = set_steal_first(paths))) {
+                PrefetchedFile *f = p->files + p->n_files++;
+
+                f->path = path;
+
+                r = hashmap_ensure_put(&p->by_path, &path_hash_ops, f->path, f);
+                if (r < 0)
+                        return r;
+        }
+
+        prefetch_files(p);
+
+        *ret = TAKE_PTR(p);
+        return 1;
+}
+
+bool load_prefetch_unit_loaded(LoadPrefetch *p, Unit *u) {
+        assert(p);
+        assert(u);
+
+        (void) set_remove(p->units, u);
+        return set_isempty(p->units);
+}
+
+int load_prefetch_fopen(LoadPrefetch *p, const char *path, FILE **ret, struct stat *ret_st) {
+        _cleanup_fclose_ FILE *f = NULL;
+        PrefetchedFile *pf;
+
+        assert(path);
+        assert(ret);
+        assert(ret_st);
+
+        pf = p ? hashmap_get(p->by_path, path) : NULL;
+        if (pf && pf->error >= 0) {
+                f = fmemopen_unlocked(pf->contents ?: (char*) "", pf->size, "re");
+                if (!f)
+                        return -errno;
+
+                /* config_parse() does this for streams backed by a file descriptor */
+                (void) stat_warn_permissions(path, &pf->st);
+
+                *ret_st = pf->st;
+                *ret = TAKE_PTR(f);
+                return 0;
+        }
+
+        /* If reading the file failed before, let's try again, so that errors are reported in context */
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        if (fstat(fileno(f), ret_st) < 0)
+                return -errno;
+
+        *ret = TAKE_PTR(f);
+        return 0;
+}
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "unit.h"
+
+/* Reading unit files and their drop-ins from disk is the part of loading units that doesn't touch any
+ * manager state. Hence, when many units are queued for loading, we read their files on a couple of threads
+ * first. Parsing them and applying the settings happens on the main thread as before, just from memory. */
+
+typedef struct LoadPrefetch LoadPrefetch;
+
+int load_prefetch_new(Manager *m, LoadPrefetch **ret);
+LoadPrefetch* load_prefetch_free(LoadPrefetch *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(LoadPrefetch*, load_prefetch_free);
+
+/* Returns true once all units the files were prefetched for have been loaded */
+bool load_prefetch_unit_loaded(LoadPrefetch *p, Unit *u);
+
+/* Returns a stream for the specified file from the prefetched contents if there are any, and opens the
+ * file otherwise. p may be NULL. */
+int load_prefetch_fopen(LoadPrefetch *p, const char *path, FILE **ret, struct stat *ret_st);
@@ -155,6 +155,8 @@ static TasksMax arg_default_tasks_max;
 static sd_id128_t arg_machine_id;
 static EmergencyAction arg_cad_burst_action;
 static OOMPolicy arg_default_oom_policy;
+static unsigned arg_start_jobs_max;
+static int arg_start_jobs_io_pressure_max;
 static CPUSet arg_cpu_affinity;
 static NUMAPolicy arg_numa_policy;
 static usec_t arg_clock_usec;
@@ -699,6 +701,8 @@ static int parse_config_file(void) {
                 { "Manager", "DefaultTasksMax",              config_parse_tasks_max,             0, &arg_default_tasks_max                 },
                 { "Manager", "CtrlAltDelBurstAction",        config_parse_emergency_action,      0, &arg_cad_burst_action                  },
                 { "Manager", "DefaultOOMPolicy",             config_parse_oom_policy,            0, &arg_default_oom_policy                },
+                { "Manager", "StartJobsMax",                 config_parse_unsigned,              0, &arg_start_jobs_max                    },
+                { "Manager", "StartJobsIOPressureMax",       config_parse_percent,               0, &arg_start_jobs_io_pressure_max        },
                 {}
         };
 
@@ -787,6 +791,11 @@ static void set_manager_settings(Manager *m) {
         m->confirm_spawn = arg_confirm_spawn;
         m->service_watchdogs = arg_service_watchdogs;
         m->cad_burst_action = arg_cad_burst_action;
+        m->start_jobs_max = arg_start_jobs_max;
+        m->start_jobs_io_pressure_max = arg_start_jobs_io_pressure_max;
+
+        /* The limits might have been raised */
+        manager_release_throttled_jobs(m);
 
         manager_set_watchdog(m, WATCHDOG_RUNTIME, arg_runtime_watchdog);
         manager_set_watchdog(m, WATCHDOG_REBOOT, arg_reboot_watchdog);
@@ -2426,6 +2435,8 @@ static void reset_arguments(void) {
         arg_machine_id = (sd_id128_t) {};
         arg_cad_burst_action = EMERGENCY_ACTION_REBOOT_FORCE;
         arg_default_oom_policy = OOM_STOP;
+        arg_start_jobs_max = 0;
+        arg_start_jobs_io_pressure_max = 0;
 
         cpu_set_reset(&arg_cpu_affinity);
         numa_policy_reset(&arg_numa_policy);
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include "build.h"
+#include "event-util.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "hashmap.h"
@@ -49,6 +50,9 @@ void manager_dump(Manager *m, FILE *f, const char *prefix) {
 
         manager_dump_units(m, f, prefix);
         manager_dump_jobs(m, f, prefix);
+
+        /* Only shows anything if $SD_EVENT_PROFILE_SOURCES is set */
+        (void) event_dump_source_statistics(m->event, f, prefix);
 }
 
 int manager_get_dump_string(Manager *m, char **ret) {
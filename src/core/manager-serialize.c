@@ -198,35 +198,32 @@ int manager_serialize(
         return 0;
 }
 
-static int manager_deserialize_one_unit(Manager *m, const char *name, FILE *f, FDSet *fds) {
-        Unit *u;
-        int r;
-
-        r = manager_load_unit(m, name, NULL, NULL, &u);
-        if (r < 0) {
-                if (r == -ENOMEM)
-                        return r;
-                return log_notice_errno(r, "Failed to load unit \"%s\", skipping deserialization: %m", name);
-        }
-
-        r = unit_deserialize(u, f, fds);
-        if (r < 0) {
-                if (r == -ENOMEM)
-                        return r;
-                return log_notice_errno(r, "Failed to deserialize unit \"%s\", skipping: %m", name);
-        }
-
-        return 0;
-}
+typedef struct SerializedUnit {
+        Unit *unit;
+        off_t offset;
+} SerializedUnit;
 
 static int manager_deserialize_units(Manager *m, FILE *f, FDSet *fds) {
-        const char *unit_name;
+        _cleanup_free_ SerializedUnit *units = NULL;
+        size_t n_units = 0;
+        off_t end;
         int r;
 
+        assert(m);
+        assert(f);
+
+        /* We go through the unit section twice: first we only collect the unit names, so that we can load
+         * all units in one go. That way the unit files are read in parallel, see load-prefetch.c, instead of
+         * one unit at a time. Then we go back and deserialize the state of each unit. */
+
         for (;;) {
                 _cleanup_free_ char *line = NULL;
+                const char *unit_name;
+                off_t offset;
+                Unit *u;
+
                 /* Start marker */
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
@@ -234,16 +231,53 @@ static int manager_deserialize_units(Manager *m, FILE *f, FDSet *fds) {
 
                 unit_name = strstrip(line);
 
-                r = manager_deserialize_one_unit(m, unit_name, f, fds);
+                offset = ftello(f);
+                if (offset < 0)
+                        return log_error_errno(errno, "Failed to determine serialization offset: %m");
+
+                r = unit_deserialize_skip(f);
+                if (r < 0)
+                        return r;
+
+                r = manager_load_unit_prepare(m, unit_name, NULL, NULL, &u);
                 if (r == -ENOMEM)
                         return r;
                 if (r < 0) {
-                        r = unit_deserialize_skip(f);
-                        if (r < 0)
-                                return r;
+                        log_notice_errno(r, "Failed to load unit \"%s\", skipping deserialization: %m", unit_name);
+                        continue;
                 }
+
+                if (!GREEDY_REALLOC(units, n_units + 1))
+                        return -ENOMEM;
+
+                units[n_units++] = (SerializedUnit) {
+                        .unit = u,
+                        .offset = offset,
+                };
         }
 
+        end = ftello(f);
+        if (end < 0)
+                return log_error_errno(errno, "Failed to determine serialization offset: %m");
+
+        manager_dispatch_load_queue(m);
+
+        for (size_t i = 0; i < n_units; i++) {
+                Unit *u = unit_follow_merge(units[i].unit);
+
+                if (fseeko(f, units[i].offset, SEEK_SET) < 0)
+                        return log_error_errno(errno, "Failed to seek in serialization: %m");
+
+                r = unit_deserialize(u, f, fds);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0)
+                        log_unit_notice_errno(u, r, "Failed to deserialize unit \"%s\", skipping: %m", u->id);
+        }
+
+        if (fseeko(f, end, SEEK_SET) < 0)
+                return log_error_errno(errno, "Failed to seek in serialization: %m");
+
         return 0;
 }
 
@@ -325,7 +359,7 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
                 _cleanup_free_ char *line = NULL;
                 const char *val, *l;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
@@ -28,6 +28,7 @@
 #include "bus-kernel.h"
 #include "bus-util.h"
 #include "clean-ipc.h"
+#include "conf-files.h"
 #include "clock-util.h"
 #include "core-varlink.h"
 #include "creds-util.h"
@@ -51,6 +52,7 @@
 #include "io-util.h"
 #include "label.h"
 #include "load-fragment.h"
+#include "load-prefetch.h"
 #include "locale-setup.h"
 #include "log.h"
 #include "macro.h"
@@ -62,15 +64,18 @@
 #include "parse-util.h"
 #include "path-lookup.h"
 #include "path-util.h"
+#include "proc-cmdline.h"
 #include "process-util.h"
 #include "ratelimit.h"
 #include "rlimit-util.h"
 #include "rm-rf.h"
 #include "selinux-util.h"
 #include "signal-util.h"
+#include "siphash24.h"
 #include "socket-util.h"
 #include "special.h"
 #include "stat-util.h"
+#include "string-intern.h"
 #include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
@@ -102,6 +107,9 @@
 /* How many units and jobs to process of the bus queue before returning to the event loop. */
 #define MANAGER_BUS_MESSAGE_BUDGET 100U
 
+/* How often to check the IO pressure again while jobs are held back by StartJobsIOPressureMax= */
+#define THROTTLED_JOBS_RECHECK_USEC (USEC_PER_SEC)
+
 static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_cgroups_agent_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_signal_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
@@ -114,6 +122,7 @@ static int manager_dispatch_sigchld(sd_event_source *source, void *userdata);
 static int manager_dispatch_timezone_change(sd_event_source *source, const struct inotify_event *event, void *userdata);
 static int manager_run_environment_generators(Manager *m);
 static int manager_run_generators(Manager *m);
+static bool manager_generators_unchanged(Manager *m);
 static void manager_vacuum(Manager *m);
 
 static usec_t manager_watch_jobs_next_time(Manager *m) {
@@ -873,7 +882,7 @@ int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager
         if (r < 0)
                 return r;
 
-        r = hashmap_ensure_allocated(&m->cgroup_unit, &path_hash_ops);
+        r = hashmap_ensure_allocated(&m->cgroup_unit, &path_hash_ops_fast);
         if (r < 0)
                 return r;
 
@@ -889,6 +898,10 @@ int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager
         if (r < 0)
                 return r;
 
+        r = unit_phases_new(&m->unit_phases);
+        if (r < 0)
+                log_debug_errno(r, "Failed to allocate unit phase ring buffer, not recording unit phases: %m");
+
         r = get_credentials_dir(&e);
         if (r >= 0) {
                 m->received_credentials = strdup(e);
@@ -1470,12 +1483,16 @@ Manager* manager_free(Manager *m) {
 
         exec_runtime_vacuum(m);
         hashmap_free(m->exec_runtime_by_id);
+        hashmap_free(m->exec_seccomp_programs);
+        hashmap_free(m->timer_calendar_cache);
+        unit_phases_free(m->unit_phases);
 
         dynamic_user_vacuum(m, false);
         hashmap_free(m->dynamic_users);
 
         hashmap_free(m->units);
         hashmap_free(m->units_by_invocation_id);
+        hashmap_free(m->units_by_dbus_path);
         hashmap_free(m->jobs);
         hashmap_free(m->watch_pids);
         hashmap_free(m->watch_bus);
@@ -1484,6 +1501,7 @@ Manager* manager_free(Manager *m) {
 
         set_free(m->startup_units);
         set_free(m->failed_units);
+        set_free(m->throttled_jobs);
 
         sd_event_source_unref(m->signal_event_source);
         sd_event_source_unref(m->sigchld_event_source);
@@ -1493,6 +1511,7 @@ Manager* manager_free(Manager *m) {
         sd_event_source_unref(m->timezone_change_event_source);
         sd_event_source_unref(m->jobs_in_progress_event_source);
         sd_event_source_unref(m->run_queue_event_source);
+        sd_event_source_unref(m->throttled_jobs_event_source);
         sd_event_source_unref(m->user_lookup_event_source);
 
         safe_close(m->signal_fd);
@@ -1515,6 +1534,7 @@ Manager* manager_free(Manager *m) {
 
         hashmap_free(m->cgroup_unit);
         manager_free_unit_name_maps(m);
+        hashmap_free(m->unit_dir_cache);
 
         free(m->switch_root);
         free(m->switch_root_init);
@@ -1977,6 +1997,81 @@ Unit *manager_get_unit(Manager *m, const char *name) {
         return hashmap_get(m->units, name);
 }
 
+static bool unit_matches_states_and_patterns(Unit *u, char **states, char **patterns) {
+        assert(u);
+
+        if (!strv_isempty(states) &&
+            !strv_contains(states, unit_load_state_to_string(u->load_state)) &&
+            !strv_contains(states, unit_active_state_to_string(unit_active_state(u))) &&
+            !strv_contains(states, unit_sub_state_to_string(u)))
+                return false;
+
+        return strv_isempty(patterns) || strv_fnmatch_or_empty(patterns, u->id, FNM_NOESCAPE);
+}
+
+int manager_get_units_page(
+                Manager *m,
+                char **states,
+                char **patterns,
+                const char *after,
+                size_t max,
+                Unit ***ret,
+                size_t *ret_n) {
+
+        _cleanup_free_ Unit **units = NULL;
+        size_t n_units = 0;
+        const char *k;
+        Unit *u;
+
+        assert(m);
+        assert(max > 0);
+        assert(ret);
+        assert(ret_n);
+
+        /* Returns up to max units matching the states and patterns, ordered by name, starting after the
+         * specified name, so that clients can iterate over many units in pages. Aliases are skipped. Keeps
+         * the page sorted while collecting it, instead of sorting all units for each page. */
+
+        units = new(Unit*, MIN(max, hashmap_size(m->units)) + 1);
+        if (!units)
+                return -ENOMEM;
+
+        HASHMAP_FOREACH_KEY(u, k, m->units) {
+                size_t lo = 0, hi = n_units;
+
+                if (k != u->id)
+                        continue;
+
+                if (!isempty(after) && strcmp(u->id, after) <= 0)
+                        continue;
+
+                if (n_units >= max && strcmp(u->id, units[n_units - 1]->id) >= 0)
+                        continue;
+
+                if (!unit_matches_states_and_patterns(u, states, patterns))
+                        continue;
+
+                while (lo < hi) {
+                        size_t mid = (lo + hi) / 2;
+
+                        if (strcmp(units[mid]->id, u->id) < 0)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+
+                if (n_units < max)
+                        n_units++;
+
+                memmove(units + lo + 1, units + lo, (n_units - 1 - lo) * sizeof(Unit*));
+                units[lo] = u;
+        }
+
+        *ret = TAKE_PTR(units);
+        *ret_n = n_units;
+        return 0;
+}
+
 static int manager_dispatch_target_deps_queue(Manager *m) {
         Unit *u;
         int r = 0;
@@ -2010,8 +2105,10 @@ static int manager_dispatch_target_deps_queue(Manager *m) {
 }
 
 unsigned manager_dispatch_load_queue(Manager *m) {
+        bool prefetch = true;
         Unit *u;
         unsigned n = 0;
+        int r;
 
         assert(m);
 
@@ -2027,10 +2124,24 @@ unsigned manager_dispatch_load_queue(Manager *m) {
         while ((u = m->load_queue)) {
                 assert(u->in_load_queue);
 
+                /* When many units are queued, read their files in parallel first. Loading them may queue
+                 * more units, in which case we do it again once the ones we read the files for are done. */
+                if (prefetch && !m->load_prefetch) {
+                        r = load_prefetch_new(m, &m->load_prefetch);
+                        if (r < 0) {
+                                log_warning_errno(r, "Failed to read unit files ahead of loading, ignoring: %m");
+                                prefetch = false;
+                        }
+                }
+
                 unit_load(u);
                 n++;
+
+                if (m->load_prefetch && load_prefetch_unit_loaded(m->load_prefetch, u))
+                        m->load_prefetch = load_prefetch_free(m->load_prefetch);
         }
 
+        m->load_prefetch = load_prefetch_free(m->load_prefetch);
         m->dispatching_load_queue = false;
 
         /* Dispatch the units waiting for their target dependencies to be added now, as all targets that we know about
@@ -2119,7 +2230,7 @@ int manager_load_unit_prepare(
         }
 
         if (path) {
-                r = free_and_strdup(&ret->fragment_path, path);
+                r = string_intern_replace(&ret->fragment_path, path);
                 if (r < 0)
                         return r;
         }
@@ -2209,8 +2320,56 @@ void manager_unwatch_pid(Manager *m, pid_t pid) {
         free(hashmap_remove(m->watch_pids, PID_TO_PTR(-pid)));
 }
 
+void manager_release_throttled_jobs(Manager *m) {
+        Job *j;
+
+        assert(m);
+
+        /* Puts all jobs held back by StartJobsMax= and friends back into the run queue, where they are
+         * checked again in order of their priority. */
+        while ((j = set_steal_first(m->throttled_jobs)))
+                job_add_to_run_queue(j);
+}
+
+static int manager_dispatch_throttled_jobs(sd_event_source *source, usec_t usec, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        manager_release_throttled_jobs(m);
+        return 0;
+}
+
+static void manager_watch_throttled_jobs(Manager *m) {
+        int r;
+
+        assert(m);
+
+        /* The IO pressure doesn't tell us when it went down again, hence check again in a while */
+
+        if (m->throttled_jobs_event_source) {
+                r = sd_event_source_set_time_relative(m->throttled_jobs_event_source, THROTTLED_JOBS_RECHECK_USEC);
+                if (r >= 0)
+                        r = sd_event_source_set_enabled(m->throttled_jobs_event_source, SD_EVENT_ONESHOT);
+        } else {
+                r = sd_event_add_time_relative(
+                                m->event,
+                                &m->throttled_jobs_event_source,
+                                CLOCK_MONOTONIC,
+                                THROTTLED_JOBS_RECHECK_USEC, 0,
+                                manager_dispatch_throttled_jobs, m);
+                if (r >= 0)
+                        (void) sd_event_source_set_description(m->throttled_jobs_event_source, "manager-throttled-jobs");
+        }
+        if (r < 0) {
+                log_warning_errno(r, "Failed to arm timer for throttled jobs, releasing them: %m");
+                manager_release_throttled_jobs(m);
+        }
+}
+
 static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         Manager *m = userdata;
+        int io_pressure = -1;
         Job *j;
 
         assert(source);
@@ -2220,9 +2379,15 @@ static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
                 assert(j->installed);
                 assert(j->in_run_queue);
 
+                if (job_is_throttled(j, &io_pressure) && job_throttle(j) >= 0)
+                        continue;
+
                 (void) job_run_and_invalidate(j);
         }
 
+        if (io_pressure > 0 && !set_isempty(m->throttled_jobs))
+                manager_watch_throttled_jobs(m);
+
         if (m->n_running_jobs > 0)
                 manager_watch_jobs_in_progress(m);
 
@@ -2380,10 +2545,9 @@ static void manager_invoke_notify_message(
         }
 }
 
-static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+static int manager_receive_notify_message(Manager *m) {
 
         _cleanup_fdset_free_ FDSet *fds = NULL;
-        Manager *m = userdata;
         char buf[NOTIFY_BUFFER_MAX+1];
         struct iovec iovec = {
                 .iov_base = buf,
@@ -2401,7 +2565,8 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         struct cmsghdr *cmsg;
         struct ucred *ucred = NULL;
         _cleanup_free_ Unit **array_copy = NULL;
-        _cleanup_strv_free_ char **tags = NULL;
+        _cleanup_strv_free_ char **tags_allocated = NULL;
+        char **tags, **watchdog_tags = STRV_MAKE("WATCHDOG=1");
         Unit *u1, *u2, **array;
         int r, *fd_array = NULL;
         size_t n_fds = 0;
@@ -2409,19 +2574,16 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         ssize_t n;
 
         assert(m);
-        assert(m->notify_fd == fd);
 
-        if (revents != EPOLLIN) {
-                log_warning("Got unexpected poll event for notify fd.");
-                return 0;
-        }
+        /* Returns 0 if there was nothing to read, and > 0 if a message was consumed, regardless whether it
+         * was valid or not. */
 
         n = recvmsg_safe(m->notify_fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC);
         if (IN_SET(n, -EAGAIN, -EINTR))
                 return 0; /* Spurious wakeup, try again */
         if (n == -EXFULL) {
                 log_warning("Got message with truncated control data (too many fds sent?), ignoring.");
-                return 0;
+                return 1;
         }
         if (n < 0)
                 /* If this is any other, real error, then let's stop processing this socket. This of course
@@ -2453,38 +2615,43 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
                 if (r < 0) {
                         close_many(fd_array, n_fds);
                         log_oom();
-                        return 0;
+                        return 1;
                 }
         }
 
         if (!ucred || !pid_is_valid(ucred->pid)) {
                 log_warning("Received notify message without valid credentials. Ignoring.");
-                return 0;
+                return 1;
         }
 
         if ((size_t) n >= sizeof(buf) || (msghdr.msg_flags & MSG_TRUNC)) {
                 log_warning("Received notify message exceeded maximum size. Ignoring.");
-                return 0;
+                return 1;
         }
 
         /* As extra safety check, let's make sure the string we get doesn't contain embedded NUL bytes. We permit one
          * trailing NUL byte in the message, but don't expect it. */
         if (n > 1 && memchr(buf, 0, n-1)) {
                 log_warning("Received notify message with embedded NUL bytes. Ignoring.");
-                return 0;
+                return 1;
         }
 
-        /* Make sure it's NUL-terminated, then parse it to obtain the tags list */
+        /* Make sure it's NUL-terminated, then parse it to obtain the tags list. Watchdog keep-alive pings are
+         * by far the most frequent messages, hence don't bother allocating anything for them. */
         buf[n] = 0;
-        tags = strv_split_newlines(buf);
-        if (!tags) {
-                log_oom();
-                return 0;
+        if (STR_IN_SET(buf, "WATCHDOG=1", "WATCHDOG=1\n"))
+                tags = watchdog_tags;
+        else {
+                tags = tags_allocated = strv_split_newlines(buf);
+                if (!tags) {
+                        log_oom();
+                        return 1;
+                }
         }
 
         /* possibly a barrier fd, let's see */
         if (manager_process_barrier_fd(tags, fds))
-                return 0;
+                return 1;
 
         /* Increase the generation counter used for filtering out duplicate unit invocations. */
         m->notifygen++;
@@ -2525,6 +2692,32 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         if (fdset_size(fds) > 0)
                 log_warning("Got extra auxiliary fds with notification message, closing them.");
 
+        return 1;
+}
+
+/* How many notification messages to process before giving other event sources a chance to run */
+#define NOTIFY_MESSAGES_PER_WAKEUP_MAX 64U
+
+static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        Manager *m = userdata;
+        int r;
+
+        assert(m);
+        assert(m->notify_fd == fd);
+
+        if (revents != EPOLLIN) {
+                log_warning("Got unexpected poll event for notify fd.");
+                return 0;
+        }
+
+        /* Services with a watchdog or frequent status updates might send lots of messages, hence process
+         * a batch of them per wakeup rather than going back to the event loop for each one of them. */
+        for (unsigned i = 0; i < NOTIFY_MESSAGES_PER_WAKEUP_MAX; i++) {
+                r = manager_receive_notify_message(m);
+                if (r <= 0)
+                        return r;
+        }
+
         return 0;
 }
 
@@ -2916,6 +3109,9 @@ static int manager_dispatch_timezone_change(
 
         log_debug("Timezone has been changed (now: %s).", tzname[daylight]);
 
+        /* The cached elapse times of calendar timers were calculated for the old timezone */
+        m->timer_calendar_cache = hashmap_free(m->timer_calendar_cache);
+
         HASHMAP_FOREACH(u, m->units)
                 if (UNIT_VTABLE(u)->timezone_change)
                         UNIT_VTABLE(u)->timezone_change(u);
@@ -3274,6 +3470,7 @@ int manager_reload(Manager *m) {
         _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
         _cleanup_fdset_free_ FDSet *fds = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        bool generators_unchanged;
         int r;
 
         assert(m);
@@ -3305,8 +3502,11 @@ int manager_reload(Manager *m) {
          * and everything else that is worth flushing out. We'll get it all back from the serialization — if we need
          * it. */
 
+        generators_unchanged = manager_generators_unchanged(m);
+
         manager_clear_jobs_and_units(m);
-        lookup_paths_flush_generator(&m->lookup_paths);
+        if (!generators_unchanged)
+                lookup_paths_flush_generator(&m->lookup_paths);
         lookup_paths_free(&m->lookup_paths);
         exec_runtime_vacuum(m);
         dynamic_user_vacuum(m, false);
@@ -3318,11 +3518,23 @@ int manager_reload(Manager *m) {
                 log_warning_errno(r, "Failed to initialize path lookup table, ignoring: %m");
 
         (void) manager_run_environment_generators(m);
-        (void) manager_run_generators(m);
+
+        /* The environment generators might have changed the environment of the generators */
+        if (generators_unchanged && !manager_generators_unchanged(m)) {
+                lookup_paths_flush_generator(&m->lookup_paths);
+                generators_unchanged = false;
+        }
+
+        if (generators_unchanged)
+                log_debug("Generators and their inputs are unchanged, not running generators again.");
+        else
+                (void) manager_run_generators(m);
 
         lookup_paths_log(&m->lookup_paths);
 
-        /* We flushed out generated files, for which we don't watch mtime, so we should flush the old map. */
+        /* We flushed out generated files, for which we don't watch mtime, so we should flush the old map. The
+         * contents of the other search path directories are kept in unit_dir_cache, and are only read
+         * again if the directories were modified. */
         manager_free_unit_name_maps(m);
 
         /* First, enumerate what we can from kernel and suchlike */
@@ -3623,13 +3835,125 @@ static int manager_run_environment_generators(Manager *m) {
         return r;
 }
 
+static void generator_input_hash(const char *path, struct siphash *state) {
+        struct stat st;
+
+        assert(path);
+        assert(state);
+
+        siphash24_compress_string(path, state);
+
+        if (stat(path, &st) < 0) {
+                int error = errno;
+
+                siphash24_compress(&error, sizeof(error), state);
+                return;
+        }
+
+        siphash24_compress(&st.st_dev, sizeof(st.st_dev), state);
+        siphash24_compress(&st.st_ino, sizeof(st.st_ino), state);
+        siphash24_compress(&st.st_mode, sizeof(st.st_mode), state);
+        siphash24_compress(&st.st_size, sizeof(st.st_size), state);
+        siphash24_compress(&st.st_mtim, sizeof(st.st_mtim), state);
+        siphash24_compress(&st.st_ctim, sizeof(st.st_ctim), state);
+}
+
+static int manager_generators_fingerprint(Manager *m, uint64_t *ret) {
+        /* The fingerprint is only ever compared with the previous one, hence a fixed key is fine */
+        static const sd_id128_t key = SD_ID128_MAKE(5d,2c,65,0e,a4,7b,41,93,b6,1f,0c,d8,97,e3,2a,c4);
+        _cleanup_strv_free_ char **paths = NULL, **generators = NULL;
+        _cleanup_free_ char *cmdline = NULL;
+        struct siphash state;
+        const char *inputs_dir;
+        char **i;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        /* Generators may declare which files their output depends on, see generator_declare_inputs().
+         * Combines the binaries of all generators, the files they declared, the kernel command line and
+         * the environment they are invoked with into a fingerprint. Returns 0 if any generator declared nothing, in which case
+         * we can't tell whether its output would change. */
+
+        paths = generator_binary_paths(m->unit_file_scope);
+        if (!paths)
+                return -ENOMEM;
+
+        r = conf_files_list_strv(&generators, NULL, NULL,
+                                 CONF_FILES_EXECUTABLE|CONF_FILES_REGULAR|CONF_FILES_FILTER_MASKED,
+                                 (const char* const*) paths);
+        if (r < 0)
+                return r;
+
+        r = proc_cmdline(&cmdline);
+        if (r < 0)
+                return r;
+
+        inputs_dir = strjoina(m->lookup_paths.generator, ".inputs");
+
+        siphash24_init(&state, key.bytes);
+
+        siphash24_compress_string(cmdline, &state);
+
+        STRV_FOREACH(i, m->transient_environment)
+                siphash24_compress_string(*i, &state);
+
+        STRV_FOREACH(i, generators) {
+                _cleanup_strv_free_ char **inputs = NULL;
+                _cleanup_free_ char *p = NULL, *contents = NULL;
+                char **j;
+
+                generator_input_hash(*i, &state);
+
+                p = path_join(inputs_dir, basename(*i));
+                if (!p)
+                        return -ENOMEM;
+
+                r = read_full_file(p, &contents, NULL);
+                if (r == -ENOENT)
+                        return 0;
+                if (r < 0)
+                        return r;
+
+                inputs = strv_split_newlines(contents);
+                if (!inputs)
+                        return -ENOMEM;
+
+                STRV_FOREACH(j, inputs)
+                        generator_input_hash(*j, &state);
+        }
+
+        *ret = siphash24_finalize(&state);
+        return 1;
+}
+
+static bool manager_generators_unchanged(Manager *m) {
+        uint64_t fingerprint;
+        int r;
+
+        assert(m);
+
+        /* Generated files in temporary directories are gone after every reload anyway */
+        if (m->generators_fingerprint == 0 || m->lookup_paths.temporary_dir)
+                return false;
+
+        r = manager_generators_fingerprint(m, &fingerprint);
+        if (r < 0)
+                log_debug_errno(r, "Failed to determine generator fingerprint, running generators again: %m");
+
+        return r > 0 && fingerprint == m->generators_fingerprint;
+}
+
 static int manager_run_generators(Manager *m) {
-        _cleanup_strv_free_ char **paths = NULL;
-        const char *argv[5];
+        _cleanup_strv_free_ char **paths = NULL, **env = NULL;
+        const char *argv[5], *inputs_dir;
         int r;
 
         assert(m);
 
+        m->generators_fingerprint = 0;
+
         if (MANAGER_IS_TEST_RUN(m) && !(m->test_run_flags & MANAGER_TEST_RUN_GENERATORS))
                 return 0;
 
@@ -3646,6 +3970,26 @@ static int manager_run_generators(Manager *m) {
                 goto finish;
         }
 
+        /* Generators tell us which files they read into this directory, so that we can skip running them
+         * again on reload if none of them changed */
+        inputs_dir = strjoina(m->lookup_paths.generator, ".inputs");
+        (void) rm_rf(inputs_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+        r = mkdir_label(inputs_dir, 0755);
+        if (r < 0)
+                log_debug_errno(r, "Failed to create %s, ignoring: %m", inputs_dir);
+
+        env = strv_copy(m->transient_environment);
+        if (!env) {
+                r = log_oom();
+                goto finish;
+        }
+
+        r = strv_env_assign(&env, "SYSTEMD_GENERATOR_INPUTS_DIR", inputs_dir);
+        if (r < 0) {
+                log_oom();
+                goto finish;
+        }
+
         argv[0] = NULL; /* Leave this empty, execute_directory() will fill something in */
         argv[1] = m->lookup_paths.generator;
         argv[2] = m->lookup_paths.generator_early;
@@ -3654,9 +3998,17 @@ static int manager_run_generators(Manager *m) {
 
         RUN_WITH_UMASK(0022)
                 (void) execute_directories((const char* const*) paths, DEFAULT_TIMEOUT_USEC, NULL, NULL,
-                                           (char**) argv, m->transient_environment,
+                                           (char**) argv, env,
                                            EXEC_DIR_PARALLEL | EXEC_DIR_IGNORE_ERRORS | EXEC_DIR_SET_SYSTEMD_EXEC_PID);
 
+        if (!m->lookup_paths.temporary_dir) {
+                r = manager_generators_fingerprint(m, &m->generators_fingerprint);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to determine generator fingerprint, ignoring: %m");
+                if (r <= 0)
+                        m->generators_fingerprint = 0;
+        }
+
         r = 0;
 
 finish:
@@ -126,6 +126,7 @@ typedef enum WatchdogType {
 #include "path-lookup.h"
 #include "show-status.h"
 #include "unit-name.h"
+#include "unit-phases.h"
 
 typedef enum ManagerTestRunFlags {
         MANAGER_TEST_NORMAL             = 0,       /* run normally */
@@ -146,12 +147,16 @@ struct Manager {
         /* Active jobs and units */
         Hashmap *units;  /* name string => Unit object n:1 */
         Hashmap *units_by_invocation_id;
+        Hashmap *units_by_dbus_path; /* D-Bus object path string => Unit object, filled in lazily by find_unit() */
         Hashmap *jobs;   /* job id => Job object 1:1 */
 
         /* To make it easy to iterate through the units of a specific
          * type we maintain a per type linked list */
         LIST_HEAD(Unit, units_by_type[_UNIT_TYPE_MAX]);
 
+        /* Bumped whenever the dependencies of any unit change, see Unit.dependency_arrays */
+        uint64_t dependency_generation;
+
         /* Units that need to be loaded */
         LIST_HEAD(Unit, load_queue); /* this is actually more a stack than a queue, but uh. */
 
@@ -181,6 +186,9 @@ struct Manager {
         /* Units whose memory.event fired */
         LIST_HEAD(Unit, cgroup_oom_queue);
 
+        /* Units whose cgroup.events fired, only used while processing a batch of inotify events */
+        LIST_HEAD(Unit, cgroup_events_queue);
+
         /* Target units whose default target dependencies haven't been set yet */
         LIST_HEAD(Unit, target_deps_queue);
 
@@ -212,6 +220,11 @@ struct Manager {
 
         sd_event_source *run_queue_event_source;
 
+        /* Start jobs held back by StartJobsMax=, the per-slice StartJobsMax=, or StartJobsIOPressureMax=,
+         * and the timer to check the IO pressure again */
+        Set *throttled_jobs;
+        sd_event_source *throttled_jobs_event_source;
+
         char *notify_socket;
         int notify_fd;
         sd_event_source *notify_event_source;
@@ -239,7 +252,9 @@ struct Manager {
         Hashmap *unit_id_map;
         Hashmap *unit_name_map;
         Set *unit_path_cache;
+        Hashmap *unit_dir_cache; /* contents of the unit search path directories, survives reloads */
         uint64_t unit_cache_timestamp_hash;
+        struct LoadPrefetch *load_prefetch; /* only set while dispatching the load queue */
 
         char **transient_environment;  /* The environment, as determined from config files, kernel cmdline and environment generators */
         char **client_environment;     /* Environment variables created by clients through the bus API */
@@ -258,6 +273,7 @@ struct Manager {
         /* Data specific to the mount subsystem */
         struct libmnt_monitor *mount_monitor;
         sd_event_source *mount_event_source;
+        struct libmnt_table *mount_table; /* /proc/self/mountinfo as last processed, for incremental updates */
 
         /* Data specific to the swap filesystem */
         FILE *proc_swaps;
@@ -388,6 +404,7 @@ struct Manager {
 
         /* Jobs in progress watching */
         unsigned n_running_jobs;
+        unsigned n_running_start_jobs; /* the subset of the above that StartJobsMax= applies to */
         unsigned n_on_console;
         unsigned jobs_in_progress_iteration;
 
@@ -421,10 +438,30 @@ struct Manager {
         /* ExecRuntime, indexed by their owner unit id */
         Hashmap *exec_runtime_by_id;
 
+        /* Compiled seccomp filters, indexed by the settings of the ExecContext they were compiled from */
+        Hashmap *exec_seccomp_programs;
+
+        /* Last computed elapse time of calendar timers, indexed by the calendar spec string. Shared by
+         * all timers with the same spec, flushed when the timezone changes. */
+        Hashmap *timer_calendar_cache;
+
+        /* Recent load and start up phases of units, for systemd-analyze unit-phases. NULL if allocating
+         * the ring buffer failed. */
+        UnitPhases *unit_phases;
+
+        /* Fingerprint of the generators and the inputs they declared when they last ran, 0 if any of
+         * them didn't declare its inputs. If it's unchanged on reload, the generators aren't run again. */
+        uint64_t generators_fingerprint;
+
         /* When the user hits C-A-D more than 7 times per 2s, do something immediately... */
         RateLimit ctrl_alt_del_ratelimit;
         EmergencyAction cad_burst_action;
 
+        /* How many start jobs may run at the same time, and up to which IO pressure (in percent) further
+         * ones are started. 0 means no limit. */
+        unsigned start_jobs_max;
+        int start_jobs_io_pressure_max;
+
         const char *unit_log_field;
         const char *unit_log_format_string;
 
@@ -447,6 +484,8 @@ struct Manager {
         VarlinkServer *varlink_server;
         /* Only systemd-oomd should be using this to subscribe to changes in ManagedOOM settings */
         Varlink *managed_oom_varlink_request;
+        /* Clients subscribed to unit state changes via io.systemd.Manager.SubscribeUnitChanges */
+        Set *unit_change_varlink_subscribers;
 };
 
 static inline usec_t manager_default_timeout_abort_usec(Manager *m) {
@@ -474,6 +513,7 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds);
 
 Job *manager_get_job(Manager *m, uint32_t id);
 Unit *manager_get_unit(Manager *m, const char *name);
+int manager_get_units_page(Manager *m, char **states, char **patterns, const char *after, size_t max, Unit ***ret, size_t *ret_n);
 
 int manager_get_job_from_dbus_path(Manager *m, const char *s, Job **_j);
 
@@ -493,6 +533,7 @@ void manager_clear_jobs(Manager *m);
 void manager_unwatch_pid(Manager *m, pid_t pid);
 
 unsigned manager_dispatch_load_queue(Manager *m);
+void manager_release_throttled_jobs(Manager *m);
 
 int manager_default_environment(Manager *m);
 int manager_transient_environment_add(Manager *m, char **plus);
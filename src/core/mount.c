@@ -1669,7 +1669,8 @@ static int mount_setup_unit(
                 const char *where,
                 const char *options,
                 const char *fstype,
-                bool set_flags) {
+                bool set_flags,
+                Unit **ret) {
 
         _cleanup_free_ char *e = NULL;
         MountProcFlags flags;
@@ -1743,10 +1744,32 @@ static int mount_setup_unit(
         if (set_flags)
                 MOUNT(u)->proc_flags = flags;
 
+        if (ret)
+                *ret = u;
+
         return 0;
 }
 
-static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags) {
+static void mount_setup_unit_from_fs(Manager *m, struct libmnt_fs *fs, bool set_flags, Unit **ret) {
+        const char *device, *path, *options, *fstype;
+
+        assert(m);
+        assert(fs);
+
+        device = mnt_fs_get_source(fs);
+        path = mnt_fs_get_target(fs);
+        options = mnt_fs_get_options(fs);
+        fstype = mnt_fs_get_fstype(fs);
+
+        if (!device || !path)
+                return;
+
+        device_found_node(m, device, DEVICE_FOUND_MOUNT, DEVICE_FOUND_MOUNT);
+
+        (void) mount_setup_unit(m, device, path, options, fstype, set_flags, ret);
+}
+
+static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags, struct libmnt_table **ret_table) {
         _cleanup_(mnt_free_tablep) struct libmnt_table *table = NULL;
         _cleanup_(mnt_free_iterp) struct libmnt_iter *iter = NULL;
         int r;
@@ -1759,7 +1782,6 @@ static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags) {
 
         for (;;) {
                 struct libmnt_fs *fs;
-                const char *device, *path, *options, *fstype;
 
                 r = mnt_table_next_fs(table, iter, &fs);
                 if (r == 1)
@@ -1767,19 +1789,83 @@ static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags) {
                 if (r < 0)
                         return log_error_errno(r, "Failed to get next entry from /proc/self/mountinfo: %m");
 
-                device = mnt_fs_get_source(fs);
-                path = mnt_fs_get_target(fs);
-                options = mnt_fs_get_options(fs);
-                fstype = mnt_fs_get_fstype(fs);
+                mount_setup_unit_from_fs(m, fs, set_flags, NULL);
+        }
 
-                if (!device || !path)
-                        continue;
+        if (ret_table)
+                *ret_table = TAKE_PTR(table);
+
+        return 0;
+}
+
+static int mount_load_proc_self_mountinfo_changes(Manager *m, struct libmnt_table **ret_table, Set **ret_changed) {
+        _cleanup_(mnt_free_tablep) struct libmnt_table *table = NULL;
+        _cleanup_(mnt_free_iterp) struct libmnt_iter *iter = NULL;
+        _cleanup_(mnt_free_tabdiffp) struct libmnt_tabdiff *diff = NULL;
+        _cleanup_set_free_ Set *changed = NULL;
+        struct libmnt_fs *old_fs, *new_fs;
+        int oper, r;
+
+        assert(m);
+        assert(m->mount_table);
+        assert(ret_table);
+        assert(ret_changed);
+
+        /* Like mount_load_proc_self_mountinfo(), but only sets up the units whose mount points changed
+         * since we parsed m->mount_table. Units not touched keep their state from back then. Returns the
+         * units that need to be reconsidered, which have their proc_flags set. */
+
+        r = libmount_parse(NULL, NULL, &table, &iter);
+        if (r < 0)
+                return log_error_errno(r, "Failed to parse /proc/self/mountinfo: %m");
+
+        diff = mnt_new_tabdiff();
+        if (!diff)
+                return log_oom();
+
+        r = mnt_diff_tables(diff, m->mount_table, table);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to compare /proc/self/mountinfo with its previous contents: %m");
+
+        while (mnt_tabdiff_next_change(diff, iter, &old_fs, &new_fs, &oper) == 0) {
+                const char *targets[] = {
+                        old_fs ? mnt_fs_get_target(old_fs) : NULL,
+                        new_fs ? mnt_fs_get_target(new_fs) : NULL,
+                };
+
+                if (new_fs && mnt_fs_get_source(new_fs))
+                        device_found_node(m, mnt_fs_get_source(new_fs), DEVICE_FOUND_MOUNT, DEVICE_FOUND_MOUNT);
+
+                for (size_t i = 0; i < ELEMENTSOF(targets); i++) {
+                        struct libmnt_fs *top;
+                        Unit *u = NULL;
+
+                        if (!targets[i])
+                                continue;
+
+                        /* Multiple file systems may be mounted on top of each other, the last one wins. If
+                         * there's none left, the unit is left without flags, i.e. it is considered
+                         * unmounted. */
+                        top = mnt_table_find_target(table, targets[i], MNT_ITER_BACKWARD);
+                        if (top)
+                                mount_setup_unit_from_fs(m, top, true, &u);
+                        else {
+                                _cleanup_free_ char *e = NULL;
 
-                device_found_node(m, device, DEVICE_FOUND_MOUNT, DEVICE_FOUND_MOUNT);
+                                if (unit_name_from_path(targets[i], ".mount", &e) >= 0)
+                                        u = manager_get_unit(m, e);
+                        }
+                        if (!u)
+                                continue;
 
-                (void) mount_setup_unit(m, device, path, options, fstype, set_flags);
+                        r = set_ensure_put(&changed, NULL, u);
+                        if (r < 0)
+                                return log_oom();
+                }
         }
 
+        *ret_table = TAKE_PTR(table);
+        *ret_changed = TAKE_PTR(changed);
         return 0;
 }
 
@@ -1790,6 +1876,9 @@ static void mount_shutdown(Manager *m) {
 
         mnt_unref_monitor(m->mount_monitor);
         m->mount_monitor = NULL;
+
+        mnt_free_table(m->mount_table);
+        m->mount_table = NULL;
 }
 
 static int mount_get_timeout(Unit *u, usec_t *timeout) {
@@ -1897,7 +1986,11 @@ static void mount_enumerate(Manager *m) {
                 (void) sd_event_source_set_description(m->mount_event_source, "mount-monitor-dispatch");
         }
 
-        r = mount_load_proc_self_mountinfo(m, false);
+        /* The units' state is not updated here, hence the next change needs a full pass */
+        mnt_free_table(m->mount_table);
+        m->mount_table = NULL;
+
+        r = mount_load_proc_self_mountinfo(m, false, NULL);
         if (r < 0)
                 goto fail;
 
@@ -1907,11 +2000,12 @@ fail:
         mount_shutdown(m);
 }
 
-static int drain_libmount(Manager *m) {
-        bool rescan = false;
+static int drain_libmount(Manager *m, bool *ret_userspace) {
+        bool rescan = false, userspace = false;
         int r;
 
         assert(m);
+        assert(ret_userspace);
 
         /* Drain all events and verify that the event is valid.
          *
@@ -1920,133 +2014,203 @@ static int drain_libmount(Manager *m) {
          *
          * error: r < 0; valid: r == 0, false positive: r == 1 */
         do {
-                r = mnt_monitor_next_change(m->mount_monitor, NULL, NULL);
+                int type;
+
+                r = mnt_monitor_next_change(m->mount_monitor, NULL, &type);
                 if (r < 0)
                         return log_error_errno(r, "Failed to drain libmount events: %m");
-                if (r == 0)
+                if (r == 0) {
                         rescan = true;
+                        if (type == MNT_MONITOR_TYPE_USERSPACE)
+                                userspace = true;
+                }
         } while (r == 0);
 
+        *ret_userspace = userspace;
         return rescan;
 }
 
-static int mount_process_proc_self_mountinfo(Manager *m) {
-        _cleanup_set_free_free_ Set *around = NULL, *gone = NULL;
-        const char *what;
-        Unit *u;
-        int r;
+static void mount_process_proc_flags(Mount *mount, Set **gone, Set **around) {
+        assert(mount);
+        assert(gone);
+        assert(around);
 
-        assert(m);
+        if (!mount_is_mounted(mount)) {
 
-        r = drain_libmount(m);
-        if (r <= 0)
-                return r;
+                /* A mount point is not around right now. It
+                 * might be gone, or might never have
+                 * existed. */
 
-        r = mount_load_proc_self_mountinfo(m, true);
-        if (r < 0) {
-                /* Reset flags, just in case, for later calls */
-                LIST_FOREACH(units_by_type, u, m->units_by_type[UNIT_MOUNT])
-                        MOUNT(u)->proc_flags = 0;
+                if (mount->from_proc_self_mountinfo &&
+                    mount->parameters_proc_self_mountinfo.what) {
 
-                return 0;
-        }
+                        /* Remember that this device might just have disappeared */
+                        if (set_ensure_allocated(gone, &path_hash_ops) < 0 ||
+                            set_put_strdup(gone, mount->parameters_proc_self_mountinfo.what) < 0)
+                                log_oom(); /* we don't care too much about OOM here... */
+                }
 
-        manager_dispatch_load_queue(m);
+                mount->from_proc_self_mountinfo = false;
+                assert_se(update_parameters_proc_self_mountinfo(mount, NULL, NULL, NULL) >= 0);
 
-        LIST_FOREACH(units_by_type, u, m->units_by_type[UNIT_MOUNT]) {
-                Mount *mount = MOUNT(u);
+                switch (mount->state) {
 
-                if (!mount_is_mounted(mount)) {
+                case MOUNT_MOUNTED:
+                        /* This has just been unmounted by somebody else, follow the state change. */
+                        mount_enter_dead(mount, MOUNT_SUCCESS);
+                        break;
 
-                        /* A mount point is not around right now. It
-                         * might be gone, or might never have
-                         * existed. */
+                case MOUNT_MOUNTING_DONE:
+                        /* The mount command may add the corresponding proc mountinfo entry and
+                         * then remove it because of an internal error. E.g., fuse.sshfs seems
+                         * to do that when the connection fails. See #17617. To handle such the
+                         * case, let's once set the state back to mounting. Then, the unit can
+                         * correctly enter the failed state later in mount_sigchld(). */
+                        mount_set_state(mount, MOUNT_MOUNTING);
+                        break;
 
-                        if (mount->from_proc_self_mountinfo &&
-                            mount->parameters_proc_self_mountinfo.what) {
+                default:
+                        break;
+                }
 
-                                /* Remember that this device might just have disappeared */
-                                if (set_ensure_allocated(&gone, &path_hash_ops) < 0 ||
-                                    set_put_strdup(&gone, mount->parameters_proc_self_mountinfo.what) < 0)
-                                        log_oom(); /* we don't care too much about OOM here... */
-                        }
+        } else if (mount->proc_flags & (MOUNT_PROC_JUST_MOUNTED|MOUNT_PROC_JUST_CHANGED)) {
+
+                /* A mount point was added or changed */
 
-                        mount->from_proc_self_mountinfo = false;
-                        assert_se(update_parameters_proc_self_mountinfo(mount, NULL, NULL, NULL) >= 0);
+                switch (mount->state) {
 
-                        switch (mount->state) {
+                case MOUNT_DEAD:
+                case MOUNT_FAILED:
 
-                        case MOUNT_MOUNTED:
-                                /* This has just been unmounted by somebody else, follow the state change. */
-                                mount_enter_dead(mount, MOUNT_SUCCESS);
-                                break;
+                        /* This has just been mounted by somebody else, follow the state change, but let's
+                         * generate a new invocation ID for this implicitly and automatically. */
+                        (void) unit_acquire_invocation_id(UNIT(mount));
+                        mount_cycle_clear(mount);
+                        mount_enter_mounted(mount, MOUNT_SUCCESS);
+                        break;
 
-                        case MOUNT_MOUNTING_DONE:
-                                /* The mount command may add the corresponding proc mountinfo entry and
-                                 * then remove it because of an internal error. E.g., fuse.sshfs seems
-                                 * to do that when the connection fails. See #17617. To handle such the
-                                 * case, let's once set the state back to mounting. Then, the unit can
-                                 * correctly enter the failed state later in mount_sigchld(). */
-                                mount_set_state(mount, MOUNT_MOUNTING);
-                                break;
+                case MOUNT_MOUNTING:
+                        mount_set_state(mount, MOUNT_MOUNTING_DONE);
+                        break;
 
-                        default:
-                                break;
-                        }
+                default:
+                        /* Nothing really changed, but let's
+                         * issue an notification call
+                         * nonetheless, in case somebody is
+                         * waiting for this. (e.g. file system
+                         * ro/rw remounts.) */
+                        mount_set_state(mount, mount->state);
+                        break;
+                }
+        }
+
+        if (mount_is_mounted(mount) &&
+            mount->from_proc_self_mountinfo &&
+            mount->parameters_proc_self_mountinfo.what) {
+                /* Track devices currently used */
 
-                } else if (mount->proc_flags & (MOUNT_PROC_JUST_MOUNTED|MOUNT_PROC_JUST_CHANGED)) {
+                if (set_ensure_allocated(around, &path_hash_ops) < 0 ||
+                    set_put_strdup(around, mount->parameters_proc_self_mountinfo.what) < 0)
+                        log_oom();
+        }
 
-                        /* A mount point was added or changed */
+        /* Reset the flags for later calls */
+        mount->proc_flags = 0;
+}
 
-                        switch (mount->state) {
+static void mount_reset_proc_flags(Manager *m) {
+        Unit *u;
 
-                        case MOUNT_DEAD:
-                        case MOUNT_FAILED:
+        assert(m);
+
+        LIST_FOREACH(units_by_type, u, m->units_by_type[UNIT_MOUNT])
+                MOUNT(u)->proc_flags = 0;
+}
 
-                                /* This has just been mounted by somebody else, follow the state change, but let's
-                                 * generate a new invocation ID for this implicitly and automatically. */
-                                (void) unit_acquire_invocation_id(u);
-                                mount_cycle_clear(mount);
-                                mount_enter_mounted(mount, MOUNT_SUCCESS);
-                                break;
+static bool mount_table_has_source(struct libmnt_table *table, const char *what) {
+        _cleanup_(mnt_free_iterp) struct libmnt_iter *iter = NULL;
+        struct libmnt_fs *fs;
 
-                        case MOUNT_MOUNTING:
-                                mount_set_state(mount, MOUNT_MOUNTING_DONE);
-                                break;
+        assert(table);
+        assert(what);
 
-                        default:
-                                /* Nothing really changed, but let's
-                                 * issue an notification call
-                                 * nonetheless, in case somebody is
-                                 * waiting for this. (e.g. file system
-                                 * ro/rw remounts.) */
-                                mount_set_state(mount, mount->state);
-                                break;
-                        }
-                }
+        iter = mnt_new_iter(MNT_ITER_FORWARD);
+        if (!iter)
+                return true; /* Rather not claim the device is gone if we don't know */
 
-                if (mount_is_mounted(mount) &&
-                    mount->from_proc_self_mountinfo &&
-                    mount->parameters_proc_self_mountinfo.what) {
-                        /* Track devices currently used */
+        while (mnt_table_next_fs(table, iter, &fs) == 0) {
+                const char *source;
 
-                        if (set_ensure_allocated(&around, &path_hash_ops) < 0 ||
-                            set_put_strdup(&around, mount->parameters_proc_self_mountinfo.what) < 0)
-                                log_oom();
-                }
+                source = mnt_fs_get_source(fs);
+                if (source && path_equal(source, what))
+                        return true;
+        }
 
-                /* Reset the flags for later calls */
-                mount->proc_flags = 0;
+        return false;
+}
+
+static int mount_process_proc_self_mountinfo(Manager *m) {
+        _cleanup_(mnt_free_tablep) struct libmnt_table *table = NULL;
+        _cleanup_set_free_free_ Set *around = NULL, *gone = NULL;
+        _cleanup_set_free_ Set *changed = NULL;
+        bool userspace, full = true;
+        const char *what;
+        Unit *u;
+        int r;
+
+        assert(m);
+
+        r = drain_libmount(m, &userspace);
+        if (r <= 0)
+                return r;
+
+        /* With thousands of mounts, going through all of them on every change is expensive. Hence, if we
+         * still have the table we processed last time, only look at the entries that changed since. Changes
+         * to utab are not visible in the diff, since it only compares the kernel's view, hence always do a
+         * full pass for them. */
+        if (m->mount_table && !userspace) {
+                r = mount_load_proc_self_mountinfo_changes(m, &table, &changed);
+                if (r >= 0)
+                        full = false;
+                else
+                        mount_reset_proc_flags(m);
         }
 
+        if (full) {
+                r = mount_load_proc_self_mountinfo(m, true, &table);
+                if (r < 0) {
+                        /* Reset flags, just in case, for later calls */
+                        mount_reset_proc_flags(m);
+                        mnt_free_table(m->mount_table);
+                        m->mount_table = NULL;
+                        return 0;
+                }
+        }
+
+        manager_dispatch_load_queue(m);
+
+        if (full)
+                LIST_FOREACH(units_by_type, u, m->units_by_type[UNIT_MOUNT])
+                        mount_process_proc_flags(MOUNT(u), &gone, &around);
+        else
+                SET_FOREACH(u, changed)
+                        mount_process_proc_flags(MOUNT(u), &gone, &around);
+
         SET_FOREACH(what, gone) {
                 if (set_contains(around, what))
                         continue;
 
+                /* After an incremental pass 'around' only knows about the changed units */
+                if (!full && mount_table_has_source(table, what))
+                        continue;
+
                 /* Let the device units know that the device is no longer mounted */
                 device_found_node(m, what, 0, DEVICE_FOUND_MOUNT);
         }
 
+        mnt_free_table(m->mount_table);
+        m->mount_table = TAKE_PTR(table);
+
         return 0;
 }
 
@@ -15,6 +15,7 @@
 #include "glob-util.h"
 #include "macro.h"
 #include "mkdir.h"
+#include "parse-util.h"
 #include "path.h"
 #include "path-util.h"
 #include "serialize.h"
@@ -33,6 +34,7 @@ static const UnitActiveState state_translation_table[_PATH_STATE_MAX] = {
 };
 
 static int path_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata);
+static int path_dispatch_trigger_timer(sd_event_source *source, usec_t usec, void *userdata);
 
 int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler) {
         static const int flags_table[_PATH_TYPE_MAX] = {
@@ -285,6 +287,8 @@ static void path_done(Unit *u) {
 
         assert(p);
 
+        p->trigger_event_source = sd_event_source_disable_unref(p->trigger_event_source);
+
         path_free_specs(p);
 }
 
@@ -400,12 +404,18 @@ static void path_dump(Unit *u, FILE *f, const char *prefix) {
                 "%sResult: %s\n"
                 "%sUnit: %s\n"
                 "%sMakeDirectory: %s\n"
-                "%sDirectoryMode: %04o\n",
+                "%sDirectoryMode: %04o\n"
+                "%sTriggerDelaySec: %s\n"
+                "%sMerged Events: %u\n"
+                "%sDropped Events: %u\n",
                 prefix, path_state_to_string(p->state),
                 prefix, path_result_to_string(p->result),
                 prefix, trigger ? trigger->id : "n/a",
                 prefix, yes_no(p->make_directory),
-                prefix, p->directory_mode);
+                prefix, p->directory_mode,
+                prefix, FORMAT_TIMESPAN(p->trigger_delay_usec, USEC_PER_SEC),
+                prefix, p->n_merged_events,
+                prefix, p->n_dropped_events);
 
         LIST_FOREACH(spec, s, p->specs)
                 path_spec_dump(s, f, prefix);
@@ -435,6 +445,48 @@ static int path_watch(Path *p) {
         return 0;
 }
 
+static void path_cancel_trigger(Path *p) {
+        assert(p);
+
+        if (!p->trigger_pending)
+                return;
+
+        /* The change we were about to act on is lost */
+        p->trigger_pending = false;
+        p->n_dropped_events++;
+        (void) sd_event_source_set_enabled(p->trigger_event_source, SD_EVENT_OFF);
+}
+
+static int path_arm_trigger_timer(Path *p) {
+        int r;
+
+        assert(p);
+
+        if (p->trigger_event_source) {
+                r = sd_event_source_set_time_relative(p->trigger_event_source, p->trigger_delay_usec);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_enabled(p->trigger_event_source, SD_EVENT_ONESHOT);
+        } else {
+                r = sd_event_add_time_relative(
+                                UNIT(p)->manager->event,
+                                &p->trigger_event_source,
+                                CLOCK_MONOTONIC,
+                                p->trigger_delay_usec, 0,
+                                path_dispatch_trigger_timer, p);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(p->trigger_event_source, "path-trigger-delay");
+        }
+        if (r < 0)
+                return r;
+
+        p->trigger_pending = true;
+        return 0;
+}
+
 static void path_set_state(Path *p, PathState state) {
         PathState old_state;
         assert(p);
@@ -445,8 +497,10 @@ static void path_set_state(Path *p, PathState state) {
         old_state = p->state;
         p->state = state;
 
-        if (!IN_SET(state, PATH_WAITING, PATH_RUNNING))
+        if (!IN_SET(state, PATH_WAITING, PATH_RUNNING)) {
                 path_unwatch(p);
+                path_cancel_trigger(p);
+        }
 
         if (state != old_state)
                 log_unit_debug(UNIT(p), "Changed %s -> %s", path_state_to_string(old_state), path_state_to_string(state));
@@ -455,6 +509,7 @@ static void path_set_state(Path *p, PathState state) {
 }
 
 static void path_enter_waiting(Path *p, bool initial, bool from_trigger_notify);
+static void path_enter_running(Path *p);
 
 static int path_coldplug(Unit *u) {
         Path *p = PATH(u);
@@ -464,9 +519,13 @@ static int path_coldplug(Unit *u) {
 
         if (p->deserialized_state != p->state) {
 
-                if (IN_SET(p->deserialized_state, PATH_WAITING, PATH_RUNNING))
-                        path_enter_waiting(p, true, false);
-                else
+                if (IN_SET(p->deserialized_state, PATH_WAITING, PATH_RUNNING)) {
+                        /* The trigger delay was running when we serialized, don't lose the change */
+                        if (p->deserialized_trigger_pending)
+                                path_enter_running(p);
+                        else
+                                path_enter_waiting(p, true, false);
+                } else
                         path_set_state(p, p->deserialized_state);
         }
 
@@ -491,8 +550,10 @@ static void path_enter_running(Path *p) {
         assert(p);
 
         /* Don't start job if we are supposed to go down */
-        if (unit_stop_pending(UNIT(p)))
+        if (unit_stop_pending(UNIT(p))) {
+                p->n_dropped_events++;
                 return;
+        }
 
         trigger = UNIT_TRIGGER(UNIT(p));
         if (!trigger) {
@@ -628,6 +689,9 @@ static int path_serialize(Unit *u, FILE *f, FDSet *fds) {
 
         (void) serialize_item(f, "state", path_state_to_string(p->state));
         (void) serialize_item(f, "result", path_result_to_string(p->result));
+        (void) serialize_item_format(f, "n-merged-events", "%u", p->n_merged_events);
+        (void) serialize_item_format(f, "n-dropped-events", "%u", p->n_dropped_events);
+        (void) serialize_bool(f, "trigger-pending", p->trigger_pending);
 
         LIST_FOREACH(spec, s, p->specs) {
                 const char *type;
@@ -673,6 +737,31 @@ static int path_deserialize_item(Unit *u, const char *key, const char *value, FD
                 else if (f != PATH_SUCCESS)
                         p->result = f;
 
+        } else if (streq(key, "n-merged-events")) {
+                unsigned k;
+
+                if (safe_atou(value, &k) < 0)
+                        log_unit_debug(u, "Failed to parse n-merged-events value: %s", value);
+                else
+                        p->n_merged_events += k;
+
+        } else if (streq(key, "n-dropped-events")) {
+                unsigned k;
+
+                if (safe_atou(value, &k) < 0)
+                        log_unit_debug(u, "Failed to parse n-dropped-events value: %s", value);
+                else
+                        p->n_dropped_events += k;
+
+        } else if (streq(key, "trigger-pending")) {
+                int b;
+
+                b = parse_boolean(value);
+                if (b < 0)
+                        log_unit_debug(u, "Failed to parse trigger-pending value: %s", value);
+                else
+                        p->deserialized_trigger_pending = b;
+
         } else if (streq(key, "path-spec")) {
                 int previous_exists, skip = 0;
                 _cleanup_free_ char *type_str = NULL;
@@ -727,7 +816,7 @@ _pure_ static const char *path_sub_state_to_string(Unit *u) {
 static int path_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
         PathSpec *s = userdata;
         Path *p;
-        int changed;
+        int changed, r;
 
         assert(s);
         assert(s->unit);
@@ -753,10 +842,27 @@ static int path_dispatch_io(sd_event_source *source, int fd, uint32_t revents, v
         if (changed < 0)
                 goto fail;
 
-        if (changed)
-                path_enter_running(p);
-        else
+        if (!changed) {
                 path_enter_waiting(p, false, false);
+                return 0;
+        }
+
+        if (p->trigger_delay_usec <= 0) {
+                path_enter_running(p);
+                return 0;
+        }
+
+        /* Coalesce all changes that happen within the delay into a single activation */
+        if (p->trigger_pending) {
+                p->n_merged_events++;
+                return 0;
+        }
+
+        r = path_arm_trigger_timer(p);
+        if (r < 0) {
+                log_unit_warning_errno(UNIT(p), r, "Failed to arm trigger delay timer: %m");
+                goto fail;
+        }
 
         return 0;
 
@@ -765,6 +871,21 @@ fail:
         return 0;
 }
 
+static int path_dispatch_trigger_timer(sd_event_source *source, usec_t usec, void *userdata) {
+        Path *p = PATH(userdata);
+
+        assert(p);
+
+        p->trigger_pending = false;
+
+        if (!IN_SET(p->state, PATH_WAITING, PATH_RUNNING))
+                return 0;
+
+        log_unit_debug(UNIT(p), "Trigger delay elapsed, %u change events merged so far.", p->n_merged_events);
+        path_enter_running(p);
+        return 0;
+}
+
 static void path_trigger_notify(Unit *u, Unit *other) {
         Path *p = PATH(u);
 
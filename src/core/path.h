@@ -60,6 +60,14 @@ struct Path {
         bool make_directory;
         mode_t directory_mode;
 
+        /* Change events are coalesced for this long before the unit is triggered */
+        usec_t trigger_delay_usec;
+        sd_event_source *trigger_event_source;
+        bool trigger_pending, deserialized_trigger_pending;
+
+        unsigned n_merged_events;  /* change events folded into an already pending activation */
+        unsigned n_dropped_events; /* change events that did not result in an activation */
+
         PathResult result;
 };
 
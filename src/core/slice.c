@@ -213,6 +213,11 @@ static void slice_dump(Unit *u, FILE *f, const char *prefix) {
                 "%sSlice State: %s\n",
                 prefix, slice_state_to_string(t->state));
 
+        if (t->start_jobs_max > 0)
+                fprintf(f,
+                        "%sStartJobsMax: %u\n",
+                        prefix, t->start_jobs_max);
+
         cgroup_context_dump(UNIT(t), f, prefix);
 }
 
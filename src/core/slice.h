@@ -11,6 +11,8 @@ struct Slice {
         SliceState state, deserialized_state;
 
         CGroupContext cgroup_context;
+
+        unsigned start_jobs_max; /* 0 means no limit */
 };
 
 extern const UnitVTable slice_vtable;
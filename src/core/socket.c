@@ -5,6 +5,7 @@
 #include <fcntl.h>
 #include <mqueue.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/epoll.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -46,6 +47,9 @@
 #include "unit.h"
 #include "user-util.h"
 
+/* How many connections to accept for Accept=yes sockets per event loop iteration at most */
+#define SOCKET_ACCEPT_BATCH_MAX 16U
+
 struct SocketPeer {
         unsigned n_ref;
 
@@ -2931,14 +2935,56 @@ static int socket_accept_do(Socket *s, int fd) {
         return cfd;
 }
 
-static int socket_accept_in_cgroup(Socket *s, SocketPort *p, int fd) {
+static int socket_accept_many(Socket *s, int fd, int *cfds, size_t n_max) {
+        size_t n;
+        int r;
+
+        assert(s);
+        assert(fd >= 0);
+        assert(cfds);
+        assert(n_max > 0);
+
+        /* Accepts up to n_max connections at once, so that a burst of incoming connections doesn't take one
+         * event loop iteration per connection. The listening socket might be in blocking mode (for example
+         * if it was passed in from outside), hence check if there's another connection pending before
+         * accepting it. Returns the number of accepted connections, or -EAGAIN if there were none. */
+
+        for (n = 0; n < n_max; n++) {
+                int cfd;
+
+                if (n > 0) {
+                        r = fd_wait_for_event(fd, POLLIN, 0);
+                        if (r <= 0)
+                                break;
+                }
+
+                cfd = socket_accept_do(s, fd);
+                if (cfd == -EAGAIN)
+                        break;
+                if (cfd < 0) {
+                        if (n > 0) /* Deal with what we got first, the error will show up again next time */
+                                break;
+
+                        return cfd;
+                }
+
+                cfds[n] = cfd;
+        }
+
+        return n > 0 ? (int) n : -EAGAIN;
+}
+
+static int socket_accept_in_cgroup(Socket *s, SocketPort *p, int fd, int *cfds, size_t n_max) {
         _cleanup_close_pair_ int pair[2] = { -1, -1 };
-        int cfd, r;
+        size_t n = 0;
+        int cfd = 0, r;
         pid_t pid;
 
         assert(s);
         assert(p);
         assert(fd >= 0);
+        assert(cfds);
+        assert(n_max > 0);
 
         /* Similar to socket_address_listen_in_cgroup(), but for accept() rather than socket(): make sure that any
          * connection socket is also properly associated with the cgroup. */
@@ -2959,37 +3005,52 @@ static int socket_accept_in_cgroup(Socket *s, SocketPort *p, int fd) {
         if (r < 0)
                 return log_unit_error_errno(UNIT(s), r, "Failed to fork off accept stub process: %m");
         if (r == 0) {
+                int k;
+
                 /* Child */
 
                 pair[0] = safe_close(pair[0]);
 
-                cfd = socket_accept_do(s, fd);
-                if (cfd == -EAGAIN) /* spurious accept() */
+                k = socket_accept_many(s, fd, cfds, n_max);
+                if (k == -EAGAIN) /* spurious accept() */
                         _exit(EXIT_SUCCESS);
-                if (cfd < 0) {
-                        log_unit_error_errno(UNIT(s), cfd, "Failed to accept connection socket: %m");
+                if (k < 0) {
+                        log_unit_error_errno(UNIT(s), k, "Failed to accept connection socket: %m");
                         _exit(EXIT_FAILURE);
                 }
 
-                r = send_one_fd(pair[1], cfd, 0);
-                if (r < 0) {
-                        log_unit_error_errno(UNIT(s), r, "Failed to send connection socket to parent: %m");
-                        _exit(EXIT_FAILURE);
+                for (int i = 0; i < k; i++) {
+                        r = send_one_fd(pair[1], cfds[i], 0);
+                        if (r < 0) {
+                                log_unit_error_errno(UNIT(s), r, "Failed to send connection socket to parent: %m");
+                                _exit(EXIT_FAILURE);
+                        }
                 }
 
                 _exit(EXIT_SUCCESS);
         }
 
         pair[1] = safe_close(pair[1]);
-        cfd = receive_one_fd(pair[0], 0);
+
+        /* The helper closes its end of the channel when it exits, after which we get EIO here */
+        while (n < n_max) {
+                cfd = receive_one_fd(pair[0], 0);
+                if (cfd < 0)
+                        break;
+
+                cfds[n++] = cfd;
+        }
 
         /* We synchronously wait for the helper, as it shouldn't be slow */
         r = wait_for_terminate_and_check("(sd-accept)", pid, WAIT_LOG_ABNORMAL);
         if (r < 0) {
-                safe_close(cfd);
+                close_many(cfds, n);
                 return r;
         }
 
+        if (n > 0)
+                return (int) n;
+
         /* If we received no fd, we got EIO here. If this happens with a process exit code of EXIT_SUCCESS
          * this is a spurious accept(), let's convert that back to EAGAIN here. */
         if (cfd == -EIO)
@@ -2997,56 +3058,74 @@ static int socket_accept_in_cgroup(Socket *s, SocketPort *p, int fd) {
         if (cfd < 0)
                 return log_unit_error_errno(UNIT(s), cfd, "Failed to receive connection socket: %m");
 
-        return cfd;
+        return -EAGAIN;
 
 shortcut:
-        cfd = socket_accept_do(s, fd);
-        if (cfd == -EAGAIN) /* spurious accept(), skip it silently */
+        r = socket_accept_many(s, fd, cfds, n_max);
+        if (r == -EAGAIN) /* spurious accept(), skip it silently */
                 return -EAGAIN;
-        if (cfd < 0)
-                return log_unit_error_errno(UNIT(s), cfd, "Failed to accept connection socket: %m");
+        if (r < 0)
+                return log_unit_error_errno(UNIT(s), r, "Failed to accept connection socket: %m");
 
-        return cfd;
+        return r;
 }
 
 static int socket_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
         SocketPort *p = userdata;
-        int cfd = -1;
+        int cfds[SOCKET_ACCEPT_BATCH_MAX];
+        Socket *s;
+        int n;
 
         assert(p);
         assert(fd >= 0);
 
-        if (p->socket->state != SOCKET_LISTENING)
+        s = p->socket;
+
+        if (s->state != SOCKET_LISTENING)
                 return 0;
 
-        log_unit_debug(UNIT(p->socket), "Incoming traffic");
+        log_unit_debug(UNIT(s), "Incoming traffic");
 
         if (revents != EPOLLIN) {
                 if (revents & EPOLLHUP)
-                        log_unit_error(UNIT(p->socket), "Got POLLHUP on a listening socket. The service probably invoked shutdown() on it, and should better not do that.");
+                        log_unit_error(UNIT(s), "Got POLLHUP on a listening socket. The service probably invoked shutdown() on it, and should better not do that.");
                 else
-                        log_unit_error(UNIT(p->socket), "Got unexpected poll event (0x%x) on socket.", revents);
+                        log_unit_error(UNIT(s), "Got unexpected poll event (0x%x) on socket.", revents);
                 goto fail;
         }
 
-        if (p->socket->accept &&
-            p->type == SOCKET_SOCKET &&
-            socket_address_can_accept(&p->address)) {
+        if (!s->accept ||
+            p->type != SOCKET_SOCKET ||
+            !socket_address_can_accept(&p->address)) {
+                socket_enter_running(s, -1);
+                return 0;
+        }
 
-                cfd = socket_accept_in_cgroup(p->socket, p, fd);
-                if (cfd == -EAGAIN) /* Spurious accept() */
-                        return 0;
-                if (cfd < 0)
-                        goto fail;
+        /* Don't accept more connections than we'd take anyway. If we are at the limit already, accept one
+         * nonetheless, so that it is refused and counted as before. */
+        n = socket_accept_in_cgroup(s, p, fd, cfds,
+                                    s->n_connections < s->max_connections ?
+                                    MIN(s->max_connections - s->n_connections, SOCKET_ACCEPT_BATCH_MAX) : 1);
+        if (n == -EAGAIN) /* Spurious accept() */
+                return 0;
+        if (n < 0)
+                goto fail;
+
+        for (int i = 0; i < n; i++) {
+                /* If activation failed, the socket is on its way out, don't bother with the rest */
+                if (s->state != SOCKET_LISTENING) {
+                        close_many(cfds + i, n - i);
+                        break;
+                }
 
-                socket_apply_socket_options(p->socket, p, cfd);
+                socket_apply_socket_options(s, p, cfds[i]);
+                socket_enter_running(s, cfds[i]);
         }
 
-        socket_enter_running(p->socket, cfd);
         return 0;
 
 fail:
-        socket_enter_stop_pre(p->socket, SOCKET_FAILURE_RESOURCES);
+        socket_enter_stop_pre(s, SOCKET_FAILURE_RESOURCES);
         return 0;
 }
 
@@ -371,6 +371,74 @@ static void add_random(Timer *t, usec_t *v) {
         log_unit_debug(UNIT(t), "Adding %s random time.", FORMAT_TIMESPAN(add, 0));
 }
 
+typedef struct TimerCalendarCacheEntry {
+        char *spec;
+        usec_t base;
+        usec_t next;
+} TimerCalendarCacheEntry;
+
+static TimerCalendarCacheEntry* timer_calendar_cache_entry_free(TimerCalendarCacheEntry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->spec);
+        return mfree(e);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(timer_calendar_cache_hash_ops, char, string_hash_func, string_compare_func,
+                                              TimerCalendarCacheEntry, timer_calendar_cache_entry_free);
+
+static int timer_calendar_next_usec(Timer *t, const CalendarSpec *spec, usec_t base, usec_t *ret) {
+        _cleanup_free_ char *s = NULL;
+        TimerCalendarCacheEntry *e;
+        usec_t next;
+        int r;
+
+        assert(t);
+        assert(spec);
+        assert(ret);
+
+        /* Calculating the next elapse time is not cheap, in particular for calendar specs with a timezone,
+         * which require forking off a child. With many timers with the same spec (think "daily") we'd do
+         * the same calculation over and over again, in particular when they are all recalculated after the
+         * clock or timezone changed. Hence remember the last result per spec: if the next elapse after
+         * 'b' is 'n', then the next elapse after any time in the range [b, n) is 'n' too. */
+
+        r = calendar_spec_to_string(spec, &s);
+        if (r < 0) /* Not fatal, just calculate it without the cache */
+                return calendar_spec_next_usec(spec, base, ret);
+
+        e = hashmap_get(UNIT(t)->manager->timer_calendar_cache, s);
+        if (e && e->base <= base && base < e->next) {
+                *ret = e->next;
+                return 0;
+        }
+
+        r = calendar_spec_next_usec(spec, base, &next);
+        if (r < 0)
+                return r;
+
+        if (e) {
+                e->base = base;
+                e->next = next;
+        } else {
+                e = new(TimerCalendarCacheEntry, 1);
+                if (e) {
+                        *e = (TimerCalendarCacheEntry) {
+                                .spec = TAKE_PTR(s),
+                                .base = base,
+                                .next = next,
+                        };
+
+                        if (hashmap_ensure_put(&UNIT(t)->manager->timer_calendar_cache, &timer_calendar_cache_hash_ops, e->spec, e) < 0)
+                                timer_calendar_cache_entry_free(e);
+                }
+        }
+
+        *ret = next;
+        return 0;
+}
+
 static void timer_enter_waiting(Timer *t, bool time_change) {
         bool found_monotonic = false, found_realtime = false;
         bool leave_around = false;
@@ -412,7 +480,7 @@ static void timer_enter_waiting(Timer *t, bool time_change) {
                                         b = ts.realtime;
                         }
 
-                        r = calendar_spec_next_usec(v->calendar_spec, b, &v->next_elapse);
+                        r = timer_calendar_next_usec(t, v->calendar_spec, b, &v->next_elapse);
                         if (r < 0)
                                 continue;
 
@@ -46,27 +46,41 @@ void transaction_abort(Transaction *tr) {
 }
 
 static void transaction_find_jobs_that_matter_to_anchor(Job *j, unsigned generation) {
-        JobDependency *l;
+        Job *stack;
 
-        /* A recursive sweep through the graph that marks all units
-         * that matter to the anchor job, i.e. are directly or
-         * indirectly a dependency of the anchor job via paths that
-         * are fully marked as mattering. */
+        /* A sweep through the graph that marks all units that matter to the anchor job, i.e. are directly
+         * or indirectly a dependency of the anchor job via paths that are fully marked as mattering.
+         *
+         * Dependency chains may be very long, hence we don't recurse, but keep the jobs still to look at on
+         * a stack linked through the marker field, which is otherwise unused at this point. Every job is
+         * marked when it is pushed, hence ends up on the stack at most once. */
 
         j->matters_to_anchor = true;
         j->generation = generation;
+        j->marker = NULL;
+        stack = j;
 
-        LIST_FOREACH(subject, l, j->subject_list) {
+        while ((j = stack)) {
+                JobDependency *l;
 
-                /* This link does not matter */
-                if (!l->matters)
-                        continue;
+                stack = j->marker;
+                j->marker = NULL;
 
-                /* This unit has already been marked */
-                if (l->object->generation == generation)
-                        continue;
+                LIST_FOREACH(subject, l, j->subject_list) {
+
+                        /* This link does not matter */
+                        if (!l->matters)
+                                continue;
+
+                        /* This unit has already been marked */
+                        if (l->object->generation == generation)
+                                continue;
 
-                transaction_find_jobs_that_matter_to_anchor(l->object, generation);
+                        l->object->matters_to_anchor = true;
+                        l->object->generation = generation;
+                        l->object->marker = stack;
+                        stack = l->object;
+                }
         }
 }
 
@@ -279,39 +293,41 @@ static int transaction_merge_jobs(Transaction *tr, sd_bus_error *e) {
 }
 
 static void transaction_drop_redundant(Transaction *tr) {
-        bool again;
+        Job *j;
 
         /* Goes through the transaction and removes all jobs of the units whose jobs are all noops. If not
-         * all of a unit's jobs are redundant, they are kept. */
+         * all of a unit's jobs are redundant, they are kept.
+         *
+         * Whether a job is redundant only depends on its own unit, and dropping the jobs of a unit only
+         * touches the hashmap entry of that unit, hence a single pass suffices. */
 
         assert(tr);
 
-        do {
-                Job *j;
+        HASHMAP_FOREACH(j, tr->jobs) {
+                bool keep = false;
+                Job *k;
 
-                again = false;
+                LIST_FOREACH(transaction, k, j)
+                        if (tr->anchor_job == k ||
+                            !job_type_is_redundant(k->type, unit_active_state(k->unit)) ||
+                            (k->unit->job && job_type_is_conflicting(k->type, k->unit->job->type))) {
+                                keep = true;
+                                break;
+                        }
 
-                HASHMAP_FOREACH(j, tr->jobs) {
-                        bool keep = false;
-                        Job *k;
+                if (keep)
+                        continue;
 
-                        LIST_FOREACH(transaction, k, j)
-                                if (tr->anchor_job == k ||
-                                    !job_type_is_redundant(k->type, unit_active_state(k->unit)) ||
-                                    (k->unit->job && job_type_is_conflicting(k->type, k->unit->job->type))) {
-                                        keep = true;
-                                        break;
-                                }
+                while (j) {
+                        k = j->transaction_next;
 
-                        if (!keep) {
-                                log_trace("Found redundant job %s/%s, dropping from transaction.",
-                                          j->unit->id, job_type_to_string(j->type));
-                                transaction_delete_job(tr, j, false);
-                                again = true;
-                                break;
-                        }
+                        log_trace("Found redundant job %s/%s, dropping from transaction.",
+                                  j->unit->id, job_type_to_string(j->type));
+                        transaction_delete_job(tr, j, false);
+
+                        j = k;
                 }
-        } while (again);
+        }
 }
 
 _pure_ static bool unit_matters_to_anchor(Unit *u, Job *j) {
@@ -346,105 +362,133 @@ static char* merge_unit_ids(const char* unit_log_field, char **pairs) {
         return ans;
 }
 
-static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsigned generation, sd_bus_error *e) {
+static int transaction_break_order_cycle(Transaction *tr, Job *j, Job *from, unsigned generation, sd_bus_error *e) {
+        Job *k, *delete = NULL;
+        _cleanup_free_ char **array = NULL, *unit_ids = NULL;
+        char **unit_id, **job_type;
+
+        assert(tr);
+        assert(j);
+
+        /* We reached j again while it is still on our path. We have a cycle. Let's try to break it. We go
+         * backwards in our path and try to find a suitable job to remove. We use the marker to find our way
+         * back, since smart how we are we stored our way back in there. */
+        for (k = from; k; k = ((k->generation == generation && k->marker != k) ? k->marker : NULL)) {
+
+                /* For logging below */
+                if (strv_push_pair(&array, k->unit->id, (char*) job_type_to_string(k->type)) < 0)
+                        log_oom();
+
+                if (!delete && hashmap_get(tr->jobs, k->unit) && !unit_matters_to_anchor(k->unit, k))
+                        /* Ok, we can drop this one, so let's do so. */
+                        delete = k;
+
+                /* Check if this in fact was the beginning of the cycle */
+                if (k == j)
+                        break;
+        }
+
+        unit_ids = merge_unit_ids(j->manager->unit_log_field, array); /* ignore error */
+
+        STRV_FOREACH_PAIR(unit_id, job_type, array)
+                /* logging for j not k here to provide a consistent narrative */
+                log_struct(LOG_WARNING,
+                           "MESSAGE=%s: Found %s on %s/%s",
+                           j->unit->id,
+                           unit_id == array ? "ordering cycle" : "dependency",
+                           *unit_id, *job_type,
+                           "%s", unit_ids);
+
+        if (delete) {
+                const char *status;
+                /* logging for j not k here to provide a consistent narrative */
+                log_struct(LOG_ERR,
+                           "MESSAGE=%s: Job %s/%s deleted to break ordering cycle starting with %s/%s",
+                           j->unit->id, delete->unit->id, job_type_to_string(delete->type),
+                           j->unit->id, job_type_to_string(j->type),
+                           "%s", unit_ids);
+
+                if (log_get_show_color())
+                        status = ANSI_HIGHLIGHT_RED " SKIP " ANSI_NORMAL;
+                else
+                        status = " SKIP ";
+
+                unit_status_printf(delete->unit,
+                                   STATUS_TYPE_NOTICE,
+                                   status,
+                                   "Ordering cycle found, skipping %s",
+                                   unit_status_string(delete->unit, NULL));
+                transaction_delete_unit(tr, delete->unit);
+                return -EAGAIN;
+        }
+
+        log_struct(LOG_ERR,
+                   "MESSAGE=%s: Unable to break cycle starting with %s/%s",
+                   j->unit->id, j->unit->id, job_type_to_string(j->type),
+                   "%s", unit_ids);
+
+        return sd_bus_error_setf(e, BUS_ERROR_TRANSACTION_ORDER_IS_CYCLIC,
+                                 "Transaction order is cyclic. See system logs for details.");
+}
+
+typedef struct OrderFrame {
+        Job *job;
+        size_t first;   /* index of the first job ordered after this one in the successor array */
+        size_t next;    /* index of the next one of those to look at */
+} OrderFrame;
+
+typedef struct OrderWalk {
+        OrderFrame *frames;
+        size_t n_frames;
+
+        /* The jobs ordered after the jobs on the path, the ones of the last frame at the end */
+        Job **successors;
+        size_t n_successors;
+} OrderWalk;
+
+static int transaction_verify_order_enter(
+                Transaction *tr,
+                OrderWalk *w,
+                Job *j,
+                Job *from,
+                unsigned generation,
+                sd_bus_error *e) {
 
         static const UnitDependencyAtom directions[] = {
                 UNIT_ATOM_BEFORE,
                 UNIT_ATOM_AFTER,
         };
 
-        int r;
+        size_t first;
 
         assert(tr);
+        assert(w);
         assert(j);
         assert(!j->transaction_prev);
 
-        /* Does a recursive sweep through the ordering graph, looking for a cycle. If we find a cycle we try
-         * to break it. */
-
         /* Have we seen this before? */
         if (j->generation == generation) {
-                Job *k, *delete = NULL;
-                _cleanup_free_ char **array = NULL, *unit_ids = NULL;
-                char **unit_id, **job_type;
-
                 /* If the marker is NULL we have been here already and decided the job was loop-free from
                  * here. Hence shortcut things and return right-away. */
                 if (!j->marker)
                         return 0;
 
-                /* So, the marker is not NULL and we already have been here. We have a cycle. Let's try to
-                 * break it. We go backwards in our path and try to find a suitable job to remove. We use the
-                 * marker to find our way back, since smart how we are we stored our way back in there. */
-                for (k = from; k; k = ((k->generation == generation && k->marker != k) ? k->marker : NULL)) {
-
-                        /* For logging below */
-                        if (strv_push_pair(&array, k->unit->id, (char*) job_type_to_string(k->type)) < 0)
-                                log_oom();
-
-                        if (!delete && hashmap_get(tr->jobs, k->unit) && !unit_matters_to_anchor(k->unit, k))
-                                /* Ok, we can drop this one, so let's do so. */
-                                delete = k;
-
-                        /* Check if this in fact was the beginning of the cycle */
-                        if (k == j)
-                                break;
-                }
-
-                unit_ids = merge_unit_ids(j->manager->unit_log_field, array); /* ignore error */
-
-                STRV_FOREACH_PAIR(unit_id, job_type, array)
-                        /* logging for j not k here to provide a consistent narrative */
-                        log_struct(LOG_WARNING,
-                                   "MESSAGE=%s: Found %s on %s/%s",
-                                   j->unit->id,
-                                   unit_id == array ? "ordering cycle" : "dependency",
-                                   *unit_id, *job_type,
-                                   "%s", unit_ids);
-
-                if (delete) {
-                        const char *status;
-                        /* logging for j not k here to provide a consistent narrative */
-                        log_struct(LOG_ERR,
-                                   "MESSAGE=%s: Job %s/%s deleted to break ordering cycle starting with %s/%s",
-                                   j->unit->id, delete->unit->id, job_type_to_string(delete->type),
-                                   j->unit->id, job_type_to_string(j->type),
-                                   "%s", unit_ids);
-
-                        if (log_get_show_color())
-                                status = ANSI_HIGHLIGHT_RED " SKIP " ANSI_NORMAL;
-                        else
-                                status = " SKIP ";
-
-                        unit_status_printf(delete->unit,
-                                           STATUS_TYPE_NOTICE,
-                                           status,
-                                           "Ordering cycle found, skipping %s",
-                                           unit_status_string(delete->unit, NULL));
-                        transaction_delete_unit(tr, delete->unit);
-                        return -EAGAIN;
-                }
-
-                log_struct(LOG_ERR,
-                           "MESSAGE=%s: Unable to break cycle starting with %s/%s",
-                           j->unit->id, j->unit->id, job_type_to_string(j->type),
-                           "%s", unit_ids);
-
-                return sd_bus_error_setf(e, BUS_ERROR_TRANSACTION_ORDER_IS_CYCLIC,
-                                         "Transaction order is cyclic. See system logs for details.");
+                /* The marker is not NULL, hence j is on our path. */
+                return transaction_break_order_cycle(tr, j, from, generation, e);
         }
 
         /* Make the marker point to where we come from, so that we can
          * find our way backwards if we want to break a cycle. We use
          * a special marker for the beginning: we point to
          * ourselves. */
-        j->marker = from ? from : j;
+        j->marker = from ?: j;
         j->generation = generation;
 
         /* Actual ordering of jobs depends on the unit ordering dependency and job types. We need to traverse
          * the graph over 'before' edges in the actual job execution order. We traverse over both unit
          * ordering dependencies and we test with job_compare() whether it is the 'before' edge in the job
          * execution ordering. */
+        first = w->n_successors;
         for (size_t d = 0; d < ELEMENTSOF(directions); d++) {
                 Unit *u;
 
@@ -465,20 +509,69 @@ static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsi
                         if (job_compare(j, o, directions[d]) >= 0)
                                 continue;
 
-                        r = transaction_verify_order_one(tr, o, j, generation, e);
+                        if (!GREEDY_REALLOC(w->successors, w->n_successors + 1))
+                                return -ENOMEM;
+
+                        w->successors[w->n_successors++] = o;
+                }
+        }
+
+        if (!GREEDY_REALLOC(w->frames, w->n_frames + 1))
+                return -ENOMEM;
+
+        w->frames[w->n_frames++] = (OrderFrame) {
+                .job = j,
+                .first = first,
+                .next = first,
+        };
+
+        return 0;
+}
+
+static int transaction_verify_order_one(Transaction *tr, OrderWalk *w, Job *j, unsigned generation, sd_bus_error *e) {
+        int r;
+
+        assert(tr);
+        assert(w);
+        assert(j);
+
+        /* Does a depth-first sweep through the ordering graph, looking for a cycle. If we find a cycle we
+         * try to break it. Ordering chains may be very long, hence instead of recursing we keep the path
+         * in w. */
+
+        r = transaction_verify_order_enter(tr, w, j, NULL, generation, e);
+        if (r < 0)
+                return r;
+
+        while (w->n_frames > 0) {
+                OrderFrame *f = w->frames + w->n_frames - 1;
+
+                if (f->next < w->n_successors) {
+                        r = transaction_verify_order_enter(tr, w, w->successors[f->next++], f->job, generation, e);
                         if (r < 0)
                                 return r;
+                        continue;
                 }
-        }
 
-        /* Ok, let's backtrack, and remember that this entry is not on
-         * our path anymore. */
-        j->marker = NULL;
+                /* Ok, let's backtrack, and remember that this entry is not on
+                 * our path anymore. */
+                f->job->marker = NULL;
+                w->n_successors = f->first;
+                w->n_frames--;
+        }
 
         return 0;
 }
 
+static void order_walk_done(OrderWalk *w) {
+        assert(w);
+
+        w->frames = mfree(w->frames);
+        w->successors = mfree(w->successors);
+}
+
 static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bus_error *e) {
+        _cleanup_(order_walk_done) OrderWalk w = {};
         Job *j;
         int r;
         unsigned g;
@@ -492,7 +585,7 @@ static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bu
         g = (*generation)++;
 
         HASHMAP_FOREACH(j, tr->jobs) {
-                r = transaction_verify_order_one(tr, j, NULL, g, e);
+                r = transaction_verify_order_one(tr, &w, j, g, e);
                 if (r < 0)
                         return r;
         }
@@ -500,36 +593,60 @@ static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bu
         return 0;
 }
 
+static void garbage_stack_push(Job **stack, Job *j) {
+        assert(stack);
+
+        if (!j || j->marker)
+                return;
+
+        /* A job pointing to itself is the bottom of the stack */
+        j->marker = *stack ?: j;
+        *stack = j;
+}
+
 static void transaction_collect_garbage(Transaction *tr) {
-        bool again;
+        Job *j, *k, *stack = NULL;
 
         assert(tr);
 
-        /* Drop jobs that are not required by any other job */
+        /* Drop jobs that are not required by any other job.
+         *
+         * Dropping a job may turn the jobs it required into garbage too. Instead of rescanning the whole
+         * transaction after each dropped job, we keep the jobs worth another look on a stack linked through
+         * the marker field. Jobs that are not on the stack have no marker. */
+
+        HASHMAP_FOREACH(j, tr->jobs)
+                LIST_FOREACH(transaction, k, j)
+                        k->marker = NULL;
 
-        do {
-                Job *j;
+        HASHMAP_FOREACH(j, tr->jobs)
+                garbage_stack_push(&stack, j);
 
-                again = false;
+        while ((j = stack)) {
+                JobDependency *l;
 
-                HASHMAP_FOREACH(j, tr->jobs) {
-                        if (tr->anchor_job == j)
-                                continue;
+                stack = j->marker != j ? j->marker : NULL;
+                j->marker = NULL;
 
-                        if (!j->object_list) {
-                                log_trace("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type));
-                                transaction_delete_job(tr, j, true);
-                                again = true;
-                                break;
-                        }
+                /* Only the first job of each unit is looked at, the next one once this one is gone */
+                if (j->transaction_prev || tr->anchor_job == j)
+                        continue;
 
+                if (j->object_list) {
                         log_trace("Keeping job %s/%s because of %s/%s",
                                   j->unit->id, job_type_to_string(j->type),
                                   j->object_list->subject ? j->object_list->subject->unit->id : "root",
                                   j->object_list->subject ? job_type_to_string(j->object_list->subject->type) : "root");
+                        continue;
                 }
 
-        } while (again);
+                LIST_FOREACH(subject, l, j->subject_list)
+                        garbage_stack_push(&stack, l->object);
+                garbage_stack_push(&stack, j->transaction_next);
+
+                log_trace("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type));
+                transaction_delete_job(tr, j, true);
+        }
 }
 
 static int transaction_is_destructive(Transaction *tr, JobMode mode, sd_bus_error *e) {
@@ -694,15 +811,19 @@ int transaction_activate(
                 Set *affected_jobs,
                 sd_bus_error *e) {
 
+        unsigned generation = 1, n_units;
+        usec_t start;
         Job *j;
         int r;
-        unsigned generation = 1;
 
         assert(tr);
 
         /* This applies the changes recorded in tr->jobs to
          * the actual list of jobs, if possible. */
 
+        start = now(CLOCK_MONOTONIC);
+        n_units = hashmap_size(tr->jobs);
+
         /* Reset the generation counter of all installed jobs. The detection of cycles
          * looks at installed jobs. If they had a non-zero generation from some previous
          * walk of the graph, the algorithm would break. */
@@ -732,6 +853,8 @@ int transaction_activate(
                 r = transaction_verify_order(tr, &generation, e);
                 if (r >= 0)
                         break;
+                if (r == -ENOMEM)
+                        return log_oom();
 
                 if (r != -EAGAIN)
                         return log_warning_errno(r, "Requested transaction contains an unfixable cyclic ordering dependency: %s", bus_error_message(e, r));
@@ -775,6 +898,10 @@ int transaction_activate(
 
         assert(hashmap_isempty(tr->jobs));
 
+        log_debug("Activated transaction for %s/%s covering %u units in %s.",
+                  tr->anchor_job->unit->id, job_type_to_string(tr->anchor_job->type), n_units,
+                  FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), start), USEC_PER_MSEC));
+
         if (!hashmap_isempty(m->jobs)) {
                 /* Are there any jobs now? Then make sure we have the
                  * idle pipe around. We don't really care too much
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/mman.h>
+
+#include "alloc-util.h"
+#include "string-table.h"
+#include "unit-phases.h"
+
+/* Enough for the phases of a few hundred units. Pages we don't write to are never allocated. */
+#define UNIT_PHASES_MAX 4096U
+
+struct UnitPhases {
+        uint64_t next;  /* the position of the next record, never wraps */
+        UnitPhaseRecord records[UNIT_PHASES_MAX];
+};
+
+int unit_phases_new(UnitPhases **ret) {
+        UnitPhases *p;
+
+        assert(ret);
+
+        p = mmap(NULL, sizeof(UnitPhases), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        *ret = p;
+        return 0;
+}
+
+UnitPhases* unit_phases_free(UnitPhases *p) {
+        if (p)
+                (void) munmap(p, sizeof(UnitPhases));
+
+        return NULL;
+}
+
+void unit_phases_record(UnitPhases *p, const char *unit, UnitPhase phase, usec_t begin, usec_t end) {
+        UnitPhaseRecord *r;
+        uint64_t i;
+
+        assert(unit);
+        assert(phase >= 0 && phase < _UNIT_PHASE_MAX);
+
+        if (!p || begin == 0 || end < begin)
+                return;
+
+        /* The manager and any number of children might write concurrently, hence claim a slot first, and
+         * mark the record complete only once everything is written. */
+        i = __sync_fetch_and_add(&p->next, 1);
+        r = p->records + i % UNIT_PHASES_MAX;
+
+        r->seq = 0;
+        __sync_synchronize();
+
+        r->phase = phase;
+        r->begin = begin;
+        r->end = end;
+        strncpy(r->unit, unit, sizeof(r->unit) - 1);
+        r->unit[sizeof(r->unit) - 1] = 0;
+
+        __sync_synchronize();
+        r->seq = i + 1;
+}
+
+int unit_phases_get(UnitPhases *p, UnitPhaseRecord **ret, size_t *ret_n) {
+        _cleanup_free_ UnitPhaseRecord *records = NULL;
+        uint64_t first, last;
+        size_t n = 0;
+
+        assert(ret);
+        assert(ret_n);
+
+        if (!p) {
+                *ret = NULL;
+                *ret_n = 0;
+                return 0;
+        }
+
+        last = __sync_fetch_and_add(&p->next, 0);
+        first = last > UNIT_PHASES_MAX ? last - UNIT_PHASES_MAX : 0;
+        if (first == last) {
+                *ret = NULL;
+                *ret_n = 0;
+                return 0;
+        }
+
+        records = new(UnitPhaseRecord, last - first);
+        if (!records)
+                return -ENOMEM;
+
+        for (uint64_t i = first; i < last; i++) {
+                UnitPhaseRecord *r = p->records + i % UNIT_PHASES_MAX;
+
+                /* Skip records that are still being written, or were overwritten since we started */
+                if (r->seq != i + 1)
+                        continue;
+                __sync_synchronize();
+
+                records[n] = *r;
+
+                __sync_synchronize();
+                if (r->seq != i + 1)
+                        continue;
+
+                n++;
+        }
+
+        *ret = TAKE_PTR(records);
+        *ret_n = n;
+        return 0;
+}
+
+static const char* const unit_phase_table[_UNIT_PHASE_MAX] = {
+        [UNIT_PHASE_LOAD]       = "load",
+        [UNIT_PHASE_JOB_WAIT]   = "job-wait",
+        [UNIT_PHASE_FORK]       = "fork",
+        [UNIT_PHASE_EXEC_SETUP] = "exec-setup",
+        [UNIT_PHASE_NAMESPACE]  = "namespace",
+        [UNIT_PHASE_ACTIVATION] = "activation",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(unit_phase, UnitPhase);
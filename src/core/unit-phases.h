@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <inttypes.h>
+
+#include "time-util.h"
+#include "unit-name.h"
+
+/* A ring buffer of the most recent phases units went through while being loaded and started, with their
+ * begin and end times. The buffer is a shared anonymous mapping, so that the processes we fork off can
+ * record the phases they go through before execve(), too. */
+
+typedef enum UnitPhase {
+        UNIT_PHASE_LOAD,        /* loading the unit file and drop-ins */
+        UNIT_PHASE_JOB_WAIT,    /* from job installation until the job starts running */
+        UNIT_PHASE_FORK,        /* forking off a process, in the manager */
+        UNIT_PHASE_EXEC_SETUP,  /* from the fork until execve(), in the child */
+        UNIT_PHASE_NAMESPACE,   /* setting up the mount namespace, in the child */
+        UNIT_PHASE_ACTIVATION,  /* from leaving the inactive state until the unit is active, e.g. READY=1 */
+        _UNIT_PHASE_MAX,
+        _UNIT_PHASE_INVALID = -EINVAL,
+} UnitPhase;
+
+typedef struct UnitPhaseRecord {
+        uint64_t seq;           /* position in the ring plus one once the record is complete, zero before */
+        UnitPhase phase;
+        usec_t begin;
+        usec_t end;
+        char unit[UNIT_NAME_MAX + 1];
+} UnitPhaseRecord;
+
+typedef struct UnitPhases UnitPhases;
+
+int unit_phases_new(UnitPhases **ret);
+UnitPhases* unit_phases_free(UnitPhases *p);
+
+/* Safe to call in forked off children, as this neither allocates memory nor takes locks. p may be NULL. */
+void unit_phases_record(UnitPhases *p, const char *unit, UnitPhase phase, usec_t begin, usec_t end);
+
+/* Returns a copy of the complete records still in the ring buffer, oldest first */
+int unit_phases_get(UnitPhases *p, UnitPhaseRecord **ret, size_t *ret_n);
+
+const char* unit_phase_to_string(UnitPhase i) _const_;
+UnitPhase unit_phase_from_string(const char *s) _pure_;
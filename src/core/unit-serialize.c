@@ -273,7 +273,7 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                 ssize_t m;
                 size_t k;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0) /* eof */
@@ -535,16 +535,18 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
 }
 
 int unit_deserialize_skip(FILE *f) {
+        bool in_job = false;
         int r;
         assert(f);
 
-        /* Skip serialized data for this unit. We don't know what it is. */
+        /* Skip serialized data for this unit. We don't know what it is. Jobs are serialized as a nested
+         * section with an end marker of their own, which we need to skip as a whole. */
 
         for (;;) {
                 _cleanup_free_ char *line = NULL;
                 char *l;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
@@ -553,8 +555,13 @@ int unit_deserialize_skip(FILE *f) {
                 l = strstrip(line);
 
                 /* End marker */
-                if (isempty(l))
-                        return 1;
+                if (isempty(l)) {
+                        if (!in_job)
+                                return 1;
+
+                        in_job = false;
+                } else if (!in_job && STR_IN_SET(l, "job", "job="))
+                        in_job = true;
         }
 }
 
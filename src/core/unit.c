@@ -42,14 +42,17 @@
 #include "rm-rf.h"
 #include "set.h"
 #include "signal-util.h"
+#include "siphash24.h"
 #include "sparse-endian.h"
 #include "special.h"
 #include "specifier.h"
 #include "stat-util.h"
 #include "stdio-util.h"
+#include "string-intern.h"
 #include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
+#include "syslog-util.h"
 #include "terminal-util.h"
 #include "tmpfile-util.h"
 #include "umask-util.h"
@@ -71,6 +74,10 @@
 #define NOTICEWORTHY_IO_BYTES (10 * 1024 * 1024ULL)  /* 10 MB */
 #define NOTICEWORTHY_IP_BYTES (128 * 1024 * 1024ULL) /* 128 MB */
 
+/* Key for hashing unit names onto log namespace shards. This must stay the same, so that units keep logging
+ * to the same shard across reboots. */
+#define LOG_NAMESPACE_SHARD_HASH_KEY SD_ID128_MAKE(5c,0b,29,1f,8e,ba,46,43,a0,6d,3f,94,7c,d2,11,78)
+
 const UnitVTable * const unit_vtable[_UNIT_TYPE_MAX] = {
         [UNIT_SERVICE] = &service_vtable,
         [UNIT_SOCKET] = &socket_vtable,
@@ -539,11 +546,21 @@ void unit_submit_to_stop_when_bound_queue(Unit *u) {
         u->in_stop_when_bound_queue = true;
 }
 
+static void unit_dependencies_changed(Unit *u) {
+        assert(u);
+
+        /* Invalidates the flattened dependency arrays of all units, since changing the dependencies of one
+         * unit usually changes the reverse dependencies of another. */
+        u->manager->dependency_generation++;
+}
+
 static void unit_clear_dependencies(Unit *u) {
         assert(u);
 
         /* Removes all dependencies configured on u and their reverse dependencies. */
 
+        unit_dependencies_changed(u);
+
         for (Hashmap *deps; (deps = hashmap_steal_first(u->dependencies));) {
 
                 for (Unit *other; (other = hashmap_steal_first_key(deps));) {
@@ -559,6 +576,7 @@ static void unit_clear_dependencies(Unit *u) {
         }
 
         u->dependencies = hashmap_free(u->dependencies);
+        u->dependency_arrays = hashmap_free(u->dependency_arrays);
 }
 
 static void unit_remove_transient(Unit *u) {
@@ -680,6 +698,11 @@ Unit* unit_free(Unit *u) {
         if (!sd_id128_is_null(u->invocation_id))
                 hashmap_remove_value(u->manager->units_by_invocation_id, &u->invocation_id, u);
 
+        if (u->dbus_path_indexed) {
+                hashmap_remove_value(u->manager->units_by_dbus_path, u->dbus_path_indexed, u);
+                u->dbus_path_indexed = mfree(u->dbus_path_indexed);
+        }
+
         if (u->job) {
                 Job *j = u->job;
                 job_uninstall(j);
@@ -742,6 +765,9 @@ Unit* unit_free(Unit *u) {
         if (u->in_cgroup_empty_queue)
                 LIST_REMOVE(cgroup_empty_queue, u->manager->cgroup_empty_queue, u);
 
+        if (u->in_cgroup_events_queue)
+                LIST_REMOVE(cgroup_events_queue, u->manager->cgroup_events_queue, u);
+
         if (u->in_cleanup_queue)
                 LIST_REMOVE(cleanup_queue, u->manager->cleanup_queue, u);
 
@@ -768,9 +794,9 @@ Unit* unit_free(Unit *u) {
 
         free(u->description);
         strv_free(u->documentation);
-        free(u->fragment_path);
+        string_intern_unref(u->fragment_path);
         free(u->source_path);
-        strv_free(u->dropin_paths);
+        strv_free_interned(u->dropin_paths);
         free(u->instance);
 
         free(u->job_timeout_reboot_arg);
@@ -1013,6 +1039,115 @@ static int unit_add_dependency_hashmap(
         return unit_per_dependency_type_hashmap_update(per_type, other, origin_mask, destination_mask);
 }
 
+UnitDependencyArray* unit_dependency_array_unref(UnitDependencyArray *a) {
+        if (!a)
+                return NULL;
+
+        assert(a->n_ref > 0);
+        if (--a->n_ref > 0)
+                return NULL;
+
+        return mfree(a);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(
+                dependency_array_hash_ops,
+                uint64_t, uint64_hash_func, uint64_compare_func,
+                UnitDependencyArray, unit_dependency_array_unref);
+
+static UnitDependencyArray* unit_acquire_dependency_array(Unit *u, UnitDependencyAtom match_atom) {
+        UnitDependencyArray *a;
+        uint64_t key = match_atom;
+        Hashmap *deps;
+        size_t n = 0;
+        void *dt;
+
+        assert(u);
+
+        /* Returns a new reference to the array of all dependencies of u that have any of the atoms in
+         * match_atom set, in the order UNIT_FOREACH_DEPENDENCY() used to iterate through them. Returns NULL
+         * on OOM. */
+
+        if (u->dependency_arrays_generation != u->manager->dependency_generation) {
+                hashmap_clear(u->dependency_arrays);
+                u->dependency_arrays_generation = u->manager->dependency_generation;
+        }
+
+        a = hashmap_get(u->dependency_arrays, &key);
+        if (a) {
+                a->n_ref++;
+                return a;
+        }
+
+        HASHMAP_FOREACH_KEY(deps, dt, u->dependencies)
+                if ((unit_dependency_to_atom(UNIT_DEPENDENCY_FROM_PTR(dt)) & match_atom) != 0)
+                        n += hashmap_size(deps);
+
+        a = malloc(offsetof(UnitDependencyArray, units) + n * sizeof(Unit*));
+        if (!a)
+                return NULL;
+
+        *a = (UnitDependencyArray) {
+                .n_ref = 1,
+                .match_atom = match_atom,
+        };
+
+        HASHMAP_FOREACH_KEY(deps, dt, u->dependencies) {
+                Unit *other;
+                void *v;
+
+                if ((unit_dependency_to_atom(UNIT_DEPENDENCY_FROM_PTR(dt)) & match_atom) == 0)
+                        continue;
+
+                HASHMAP_FOREACH_KEY(v, other, deps)
+                        a->units[a->n_units++] = other;
+        }
+
+        assert(a->n_units == n);
+
+        if (hashmap_ensure_put(&u->dependency_arrays, &dependency_array_hash_ops, &a->match_atom, a) < 0)
+                return mfree(a);
+
+        a->n_ref++;
+        return a;
+}
+
+bool unit_for_each_dependency_next_slow(UnitForEachDependencyData *data, Unit **ret) {
+        void *dt;
+
+        assert(data);
+        assert(ret);
+
+        if (!data->started) {
+                data->started = true;
+
+                /* Don't bother with an array if there's nothing to iterate through */
+                if (hashmap_isempty(data->unit->dependencies))
+                        return false;
+
+                data->array = unit_acquire_dependency_array(data->unit, data->match_atom);
+                if (data->array)
+                        return unit_for_each_dependency_next(data, ret);
+
+                /* We are out of memory, but let's not lose any dependencies over it */
+                data->by_type = data->unit->dependencies;
+                data->by_type_iterator = ITERATOR_FIRST;
+        }
+
+        for (;;) {
+                if (data->by_unit &&
+                    hashmap_iterate(data->by_unit, &data->by_unit_iterator, NULL, (const void**) ret))
+                        return true;
+
+                do
+                        if (!hashmap_iterate(data->by_type, &data->by_type_iterator, (void**) &data->by_unit, (const void**) &dt))
+                                return false;
+                while ((unit_dependency_to_atom(UNIT_DEPENDENCY_FROM_PTR(dt)) & data->match_atom) == 0);
+
+                data->by_unit_iterator = ITERATOR_FIRST;
+        }
+}
+
 static void unit_merge_dependencies(
                 Unit *u,
                 Unit *other) {
@@ -1025,6 +1160,8 @@ static void unit_merge_dependencies(
         if (u == other)
                 return;
 
+        unit_dependencies_changed(u);
+
         for (;;) {
                 _cleanup_(hashmap_freep) Hashmap *other_deps = NULL;
                 UnitDependencyInfo di_back;
@@ -1588,6 +1725,7 @@ static int unit_validate_on_failure_job_mode(
 }
 
 int unit_load(Unit *u) {
+        usec_t begin;
         int r;
 
         assert(u);
@@ -1615,7 +1753,9 @@ int unit_load(Unit *u) {
                 u->fragment_mtime = now(CLOCK_REALTIME);
         }
 
+        begin = now(CLOCK_MONOTONIC);
         r = UNIT_VTABLE(u)->load(u);
+        unit_phases_record(u->manager->unit_phases, u->id, UNIT_PHASE_LOAD, begin, now(CLOCK_MONOTONIC));
         if (r < 0)
                 goto fail;
 
@@ -2627,6 +2767,9 @@ void unit_notify(Unit *u, UnitActiveState os, UnitActiveState ns, UnitNotifyFlag
                         (void) manager_varlink_send_managed_oom_update(u);
         }
 
+        /* Low-level state changes may change the sub state only, hence always tell varlink subscribers */
+        (void) manager_varlink_send_unit_change(u);
+
         /* Update timestamps for state changes */
         if (!MANAGER_IS_RELOADING(m)) {
                 dual_timestamp_get(&u->state_change_timestamp);
@@ -2636,9 +2779,13 @@ void unit_notify(Unit *u, UnitActiveState os, UnitActiveState ns, UnitNotifyFlag
                 else if (!UNIT_IS_INACTIVE_OR_FAILED(os) && UNIT_IS_INACTIVE_OR_FAILED(ns))
                         u->inactive_enter_timestamp = u->state_change_timestamp;
 
-                if (!UNIT_IS_ACTIVE_OR_RELOADING(os) && UNIT_IS_ACTIVE_OR_RELOADING(ns))
+                if (!UNIT_IS_ACTIVE_OR_RELOADING(os) && UNIT_IS_ACTIVE_OR_RELOADING(ns)) {
                         u->active_enter_timestamp = u->state_change_timestamp;
-                else if (UNIT_IS_ACTIVE_OR_RELOADING(os) && !UNIT_IS_ACTIVE_OR_RELOADING(ns))
+
+                        unit_phases_record(m->unit_phases, u->id, UNIT_PHASE_ACTIVATION,
+                                           u->inactive_exit_timestamp.monotonic,
+                                           u->active_enter_timestamp.monotonic);
+                } else if (UNIT_IS_ACTIVE_OR_RELOADING(os) && !UNIT_IS_ACTIVE_OR_RELOADING(ns))
                         u->active_exit_timestamp = u->state_change_timestamp;
         }
 
@@ -3084,6 +3231,8 @@ int unit_add_dependency(
                 return log_unit_error_errno(u, SYNTHETIC_ERRNO(EINVAL),
                                             "Requested dependency SliceOf=%s refused (%s is not a cgroup unit).", other->id, other->id);
 
+        unit_dependencies_changed(u);
+
         r = unit_add_dependency_hashmap(&u->dependencies, d, other, mask, 0);
         if (r < 0)
                 return r;
@@ -4026,6 +4175,23 @@ int unit_patch_contexts(Unit *u) {
                         ec->working_directory_missing_ok = true;
                 }
 
+                if (ec->log_namespace && ec->log_namespace_shards > 1 &&
+                    log_namespace_shard_from_string(ec->log_namespace, NULL, NULL) < 0) {
+                        char *shard;
+
+                        /* Spread the units using a sharded namespace over its shards, each served by a
+                         * journald instance of its own. The unit name determines the cgroup, hence this
+                         * keeps each cgroup's log stream on a single shard. */
+                        r = log_namespace_shard_name(
+                                        ec->log_namespace,
+                                        siphash24_string(u->id, LOG_NAMESPACE_SHARD_HASH_KEY.bytes) % ec->log_namespace_shards,
+                                        &shard);
+                        if (r < 0)
+                                return log_unit_error_errno(u, r, "Failed to determine log namespace shard: %m");
+
+                        free_and_replace(ec->log_namespace, shard);
+                }
+
                 if (ec->private_devices)
                         ec->capability_bounding_set &= ~((UINT64_C(1) << CAP_MKNOD) | (UINT64_C(1) << CAP_SYS_RAWIO));
 
@@ -4337,12 +4503,9 @@ int unit_write_setting(Unit *u, UnitWriteFlags flags, const char *name, const ch
         if (r < 0)
                 return r;
 
-        r = strv_push(&u->dropin_paths, q);
+        r = strv_extend_interned(&u->dropin_paths, STRV_MAKE(q));
         if (r < 0)
                 return r;
-        q = NULL;
-
-        strv_uniq(u->dropin_paths);
 
         u->dropin_mtime = now(CLOCK_REALTIME);
 
@@ -4374,6 +4537,7 @@ int unit_write_settingf(Unit *u, UnitWriteFlags flags, const char *name, const c
 int unit_make_transient(Unit *u) {
         _cleanup_free_ char *path = NULL;
         FILE *f;
+        int r;
 
         assert(u);
 
@@ -4398,10 +4562,12 @@ int unit_make_transient(Unit *u) {
         safe_fclose(u->transient_file);
         u->transient_file = f;
 
-        free_and_replace(u->fragment_path, path);
+        r = string_intern_replace(&u->fragment_path, path);
+        if (r < 0)
+                return r;
 
         u->source_path = mfree(u->source_path);
-        u->dropin_paths = strv_free(u->dropin_paths);
+        u->dropin_paths = strv_free_interned(u->dropin_paths);
         u->fragment_mtime = u->source_mtime = u->dropin_mtime = 0;
 
         u->load_state = UNIT_STUB;
@@ -5068,6 +5234,8 @@ void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
         if (mask == 0)
                 return;
 
+        unit_dependencies_changed(u);
+
         HASHMAP_FOREACH(deps, u->dependencies) {
                 bool done;
 
@@ -5813,6 +5981,58 @@ static const char* const collect_mode_table[_COLLECT_MODE_MAX] = {
 
 DEFINE_STRING_TABLE_LOOKUP(collect_mode, CollectMode);
 
+static const char* const unit_list_field_table[_UNIT_LIST_FIELD_MAX] = {
+        [UNIT_LIST_FIELD_ID]           = "Id",
+        [UNIT_LIST_FIELD_DESCRIPTION]  = "Description",
+        [UNIT_LIST_FIELD_LOAD_STATE]   = "LoadState",
+        [UNIT_LIST_FIELD_ACTIVE_STATE] = "ActiveState",
+        [UNIT_LIST_FIELD_SUB_STATE]    = "SubState",
+        [UNIT_LIST_FIELD_FOLLOWING]    = "Following",
+        [UNIT_LIST_FIELD_JOB_ID]       = "JobId",
+        [UNIT_LIST_FIELD_JOB_TYPE]     = "JobType",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(unit_list_field, UnitListField);
+
+const char* unit_get_list_field(Unit *u, UnitListField f, char buf[static DECIMAL_STR_MAX(uint32_t)]) {
+        Unit *following;
+
+        assert(u);
+        assert(buf);
+
+        switch (f) {
+
+        case UNIT_LIST_FIELD_ID:
+                return u->id;
+
+        case UNIT_LIST_FIELD_DESCRIPTION:
+                return unit_description(u);
+
+        case UNIT_LIST_FIELD_LOAD_STATE:
+                return unit_load_state_to_string(u->load_state);
+
+        case UNIT_LIST_FIELD_ACTIVE_STATE:
+                return unit_active_state_to_string(unit_active_state(u));
+
+        case UNIT_LIST_FIELD_SUB_STATE:
+                return unit_sub_state_to_string(u);
+
+        case UNIT_LIST_FIELD_FOLLOWING:
+                following = unit_following(u);
+                return following ? following->id : "";
+
+        case UNIT_LIST_FIELD_JOB_ID:
+                (void) snprintf(buf, DECIMAL_STR_MAX(uint32_t), "%" PRIu32, u->job ? u->job->id : 0);
+                return buf;
+
+        case UNIT_LIST_FIELD_JOB_TYPE:
+                return u->job ? job_type_to_string(u->job->type) : "";
+
+        default:
+                assert_not_reached();
+        }
+}
+
 Unit* unit_has_dependency(const Unit *u, UnitDependencyAtom atom, Unit *other) {
         Unit *i;
 
@@ -35,6 +35,20 @@ typedef enum CollectMode {
         _COLLECT_MODE_INVALID = -EINVAL,
 } CollectMode;
 
+/* The per-unit columns clients of the unit listing calls may select */
+typedef enum UnitListField {
+        UNIT_LIST_FIELD_ID,
+        UNIT_LIST_FIELD_DESCRIPTION,
+        UNIT_LIST_FIELD_LOAD_STATE,
+        UNIT_LIST_FIELD_ACTIVE_STATE,
+        UNIT_LIST_FIELD_SUB_STATE,
+        UNIT_LIST_FIELD_FOLLOWING,
+        UNIT_LIST_FIELD_JOB_ID,
+        UNIT_LIST_FIELD_JOB_TYPE,
+        _UNIT_LIST_FIELD_MAX,
+        _UNIT_LIST_FIELD_INVALID = -EINVAL,
+} UnitListField;
+
 static inline bool UNIT_IS_ACTIVE_OR_RELOADING(UnitActiveState t) {
         return IN_SET(t, UNIT_ACTIVE, UNIT_RELOADING);
 }
@@ -140,6 +154,12 @@ typedef struct Unit {
          * Hashmap(UnitDependency → Hashmap(Unit* → UnitDependencyInfo)) */
         Hashmap *dependencies;
 
+        /* The dependencies matching a set of dependency atoms, as iterated by UNIT_FOREACH_DEPENDENCY(),
+         * flattened into arrays. Built lazily, and dropped when Manager.dependency_generation moved on.
+         * i.e. a Hashmap(UnitDependencyAtom → UnitDependencyArray) */
+        Hashmap *dependency_arrays;
+        uint64_t dependency_arrays_generation;
+
         /* Similar, for RequiresMountsFor= path dependencies. The key is the path, the value the
          * UnitDependencyInfo type */
         Hashmap *requires_mounts_for;
@@ -147,9 +167,9 @@ typedef struct Unit {
         char *description;
         char **documentation;
 
-        char *fragment_path; /* if loaded from a config file this is the primary path to it */
+        const char *fragment_path; /* if loaded from a config file this is the primary path to it (interned) */
         char *source_path; /* if converted, the source file */
-        char **dropin_paths;
+        char **dropin_paths; /* interned */
 
         usec_t fragment_not_found_timestamp_hash;
         usec_t fragment_mtime;
@@ -226,6 +246,9 @@ typedef struct Unit {
         /* cgroup OOM queue */
         LIST_FIELDS(Unit, cgroup_oom_queue);
 
+        /* cgroup.events queue */
+        LIST_FIELDS(Unit, cgroup_events_queue);
+
         /* Target dependencies queue */
         LIST_FIELDS(Unit, target_deps_queue);
 
@@ -291,12 +314,16 @@ typedef struct Unit {
         uint64_t io_accounting_base[_CGROUP_IO_ACCOUNTING_METRIC_MAX];
         uint64_t io_accounting_last[_CGROUP_IO_ACCOUNTING_METRIC_MAX]; /* the most recently read value */
 
+        /* What we most recently told bus clients, see unit_get_accounting() */
+        UnitAccounting accounting_cache;
+
         /* Counterparts in the cgroup filesystem */
         char *cgroup_path;
         CGroupMask cgroup_realized_mask;           /* In which hierarchies does this unit's cgroup exist? (only relevant on cgroup v1) */
         CGroupMask cgroup_enabled_mask;            /* Which controllers are enabled (or more correctly: enabled for the children) for this unit's cgroup? (only relevant on cgroup v2) */
         CGroupMask cgroup_invalidated_mask;        /* A mask specifying controllers which shall be considered invalidated, and require re-realization */
         CGroupMask cgroup_members_mask;            /* A cache for the controllers required by all children of this cgroup (only relevant for slice units) */
+        Hashmap *cgroup_attribute_cache;           /* attribute name → value we last wrote to it successfully */
 
         /* Inotify watch descriptors for watching cgroup.events and memory.events on cgroupv2 */
         int cgroup_control_inotify_wd;
@@ -350,6 +377,9 @@ typedef struct Unit {
         sd_id128_t invocation_id;
         char invocation_id_string[SD_ID128_STRING_MAX]; /* useful when logging */
 
+        /* The key of this unit in Manager.units_by_dbus_path, if it has been looked up via the bus */
+        char *dbus_path_indexed;
+
         /* Garbage collect us we nobody wants or requires us anymore */
         bool stop_when_unneeded;
 
@@ -386,6 +416,7 @@ typedef struct Unit {
         bool in_cgroup_realize_queue:1;
         bool in_cgroup_empty_queue:1;
         bool in_cgroup_oom_queue:1;
+        bool in_cgroup_events_queue:1;
         bool in_target_deps_queue:1;
         bool in_stop_when_unneeded_queue:1;
         bool in_start_when_upheld_queue:1;
@@ -1034,52 +1065,64 @@ int unit_thaw_vtable_common(Unit *u);
 const char* collect_mode_to_string(CollectMode m) _const_;
 CollectMode collect_mode_from_string(const char *s) _pure_;
 
+const char* unit_list_field_to_string(UnitListField f) _const_;
+UnitListField unit_list_field_from_string(const char *s) _pure_;
+
+/* Returns the value of the field as string. buf is used for the numeric fields. */
+const char* unit_get_list_field(Unit *u, UnitListField f, char buf[static DECIMAL_STR_MAX(uint32_t)]);
+
+typedef struct UnitDependencyArray {
+        unsigned n_ref;
+        uint64_t match_atom;    /* UnitDependencyAtom, as uint64_t so that it can be used as hashmap key */
+        size_t n_units;
+        Unit *units[];
+} UnitDependencyArray;
+
+UnitDependencyArray* unit_dependency_array_unref(UnitDependencyArray *a);
+
 typedef struct UnitForEachDependencyData {
         /* Stores state for the FOREACH macro below for iterating through all deps that have any of the
          * specified dependency atom bits set */
+        Unit *unit;
         UnitDependencyAtom match_atom;
+        bool started;
+
+        /* The flattened dependencies we iterate through, with a reference held, so that changing the
+         * dependencies while iterating doesn't pull the array from under our feet */
+        UnitDependencyArray *array;
+        size_t index;
+
+        /* If the array can't be allocated, we iterate through the dependency hashmaps directly */
         Hashmap *by_type, *by_unit;
-        void *current_type;
         Iterator by_type_iterator, by_unit_iterator;
-        Unit **current_unit;
 } UnitForEachDependencyData;
 
-/* Iterates through all dependencies that have a specific atom in the dependency type set. This tries to be
- * smart: if the atom is unique, we'll directly go to right entry. Otherwise we'll iterate through the
- * per-dependency type hashmap and match all dep that have the right atom set. */
+bool unit_for_each_dependency_next_slow(UnitForEachDependencyData *data, Unit **ret);
+
+static inline bool unit_for_each_dependency_next(UnitForEachDependencyData *data, Unit **ret) {
+        if (!data->array)
+                return unit_for_each_dependency_next_slow(data, ret);
+
+        if (data->index >= data->array->n_units)
+                return false;
+
+        *ret = data->array->units[data->index++];
+        return true;
+}
+
+static inline void unit_for_each_dependency_done(UnitForEachDependencyData *data) {
+        unit_dependency_array_unref(data->array);
+}
+
+/* Iterates through all dependencies that have a specific atom in the dependency type set. The matching
+ * dependencies are looked up once and cached per unit and atom set as a flat array, which we then just
+ * walk. The cache is invalidated whenever any dependency changes. */
 #define _UNIT_FOREACH_DEPENDENCY(other, u, ma, data)                    \
-        for (UnitForEachDependencyData data = {                         \
+        for (_cleanup_(unit_for_each_dependency_done) UnitForEachDependencyData data = { \
+                        .unit = (Unit*) (u),                            \
                         .match_atom = (ma),                             \
-                        .by_type = (u)->dependencies,                   \
-                        .by_type_iterator = ITERATOR_FIRST,             \
-                        .current_unit = &(other),                       \
                 };                                                      \
-             ({                                                         \
-                     UnitDependency _dt = _UNIT_DEPENDENCY_INVALID;     \
-                     bool _found;                                       \
-                                                                        \
-                     if (data.by_type && ITERATOR_IS_FIRST(data.by_type_iterator)) { \
-                             _dt = unit_dependency_from_unique_atom(data.match_atom); \
-                             if (_dt >= 0) {                            \
-                                     data.by_unit = hashmap_get(data.by_type, UNIT_DEPENDENCY_TO_PTR(_dt)); \
-                                     data.current_type = UNIT_DEPENDENCY_TO_PTR(_dt); \
-                                     data.by_type = NULL;               \
-                                     _found = !!data.by_unit;           \
-                             }                                          \
-                     }                                                  \
-                     if (_dt < 0)                                       \
-                             _found = hashmap_iterate(data.by_type,     \
-                                                      &data.by_type_iterator, \
-                                                      (void**)&(data.by_unit), \
-                                                      (const void**) &(data.current_type)); \
-                     _found;                                            \
-             }); )                                                      \
-                if ((unit_dependency_to_atom(UNIT_DEPENDENCY_FROM_PTR(data.current_type)) & data.match_atom) != 0) \
-                        for (data.by_unit_iterator = ITERATOR_FIRST;    \
-                                hashmap_iterate(data.by_unit,           \
-                                                &data.by_unit_iterator, \
-                                                NULL,                   \
-                                                (const void**) data.current_unit); )
+             unit_for_each_dependency_next(&data, &(other)); )
 
 /* Note: this matches deps that have *any* of the atoms specified in match_atom set */
 #define UNIT_FOREACH_DEPENDENCY(other, u, match_atom) \
@@ -41,10 +41,12 @@
 #include "parse-util.h"
 #include "process-util.h"
 #include "signal-util.h"
+#include "siphash24.h"
 #include "socket-util.h"
 #include "special.h"
 #include "stacktrace.h"
 #include "stat-util.h"
+#include "stdio-util.h"
 #include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
@@ -70,6 +72,10 @@
  * go below 4MB for writing core files to storage. */
 #define PROCESS_SIZE_MIN (4U*1024U*1024U)
 
+/* If the same executable dumps core again within this time, we don't generate a stack trace for it again, so
+ * that crash loops of large binaries don't pile up coredump instances busy analyzing the same crash. */
+#define STACKTRACE_INTERVAL_USEC (30 * USEC_PER_SEC)
+
 /* Make sure to not make this larger than the maximum journal entry
  * size. See DATA_SIZE_MAX in journal-importer.h. */
 assert_cc(JOURNAL_SIZE_MAX <= DATA_SIZE_MAX);
@@ -762,6 +768,36 @@ static int change_uid_gid(const Context *context) {
         return drop_privileges(uid, gid, 0);
 }
 
+#if HAVE_ELFUTILS
+static bool stacktrace_ratelimit(const Context *context) {
+        /* Key for hashing the executable path into a stamp file name */
+        static const sd_id128_t key = SD_ID128_MAKE(dc,28,e9,93,0a,67,44,42,88,4a,d9,c3,f7,d1,94,1f);
+        char path[STRLEN("/run/systemd/coredump/stacktrace-") + 16 + 1];
+        struct stat st;
+        usec_t n;
+
+        assert(context);
+
+        /* Returns true if we recently generated a stack trace for the same executable. Each core dump is
+         * processed by a separate instance, hence the time of the last stack trace is kept in a stamp file
+         * per executable. This needs to be called before dropping privileges. */
+
+        if (!context->meta[META_EXE])
+                return false;
+
+        xsprintf(path, "/run/systemd/coredump/stacktrace-%016" PRIx64,
+                 siphash24_string(context->meta[META_EXE], key.bytes));
+
+        n = now(CLOCK_REALTIME);
+        if (stat(path, &st) >= 0 &&
+            usec_sub_unsigned(n, timespec_load(&st.st_mtim)) < STACKTRACE_INTERVAL_USEC)
+                return true;
+
+        (void) touch_file(path, /* parents= */ true, n, UID_INVALID, GID_INVALID, 0644);
+        return false;
+}
+#endif
+
 static int submit_coredump(
                 Context *context,
                 struct iovec_wrapper *iovw,
@@ -808,6 +844,10 @@ static int submit_coredump(
         /* Vacuum again, but exclude the coredump we just created */
         (void) coredump_vacuum(coredump_node_fd >= 0 ? coredump_node_fd : coredump_fd, arg_keep_free, arg_max_use);
 
+#if HAVE_ELFUTILS
+        bool ratelimited = stacktrace_ratelimit(context);
+#endif
+
         /* Now, let's drop privileges to become the user who owns the segfaulted process
          * and allocate the coredump memory under the user's uid. This also ensures that
          * the credentials journald will see are the ones of the coredumping user, thus
@@ -823,7 +863,10 @@ static int submit_coredump(
                 log_debug("Not generating stack trace: core size %"PRIu64" is greater "
                           "than %"PRIu64" (the configured maximum)",
                           coredump_size, arg_process_size_max);
-        } else if (coredump_fd >= 0)
+        } else if (ratelimited)
+                log_info("Not generating stack trace: %s dumped core less than %s ago already.",
+                         context->meta[META_EXE], FORMAT_TIMESPAN(STACKTRACE_INTERVAL_USEC, USEC_PER_SEC));
+        else if (coredump_fd >= 0)
                 coredump_parse_core(coredump_fd, context->meta[META_EXE], &stacktrace, &json_metadata);
 #endif
 
@@ -185,8 +185,13 @@ static int run(const char *dest, const char *dest_early, const char *dest_late)
 
         r = generate_mask_symlinks();
         q = generate_wants_symlinks();
+        if (r < 0)
+                return r;
+        if (q < 0)
+                return q;
 
-        return r < 0 ? r : q;
+        /* We only look at the kernel command line */
+        return generator_declare_inputs(NULL);
 }
 
 DEFINE_MAIN_GENERATOR_FUNCTION(run);
@@ -1048,7 +1048,13 @@ static int run(const char *dest, const char *dest_early, const char *dest_late)
                         r3 = generator_enable_remount_fs_service(arg_dest);
         }
 
-        return r < 0 ? r : r2 < 0 ? r2 : r3;
+        r = r < 0 ? r : r2 < 0 ? r2 : r3;
+        if (r >= 0)
+                (void) generator_declare_inputs(in_initrd() ?
+                                                STRV_MAKE(fstab_path(), "/sysroot/etc/fstab") :
+                                                STRV_MAKE(fstab_path()));
+
+        return r;
 }
 
 DEFINE_MAIN_GENERATOR_FUNCTION(run);
@@ -182,6 +182,9 @@ Home *home_free(Home *h) {
                 if (h->worker_pid > 0)
                         (void) hashmap_remove_value(h->manager->homes_by_worker_pid, PID_TO_PTR(h->worker_pid), h);
 
+                if (h->worker_queued)
+                        LIST_REMOVE(worker_queue, h->manager->worker_queue, h);
+
                 if (h->manager->gc_focus == h)
                         h->manager->gc_focus = NULL;
         }
@@ -189,6 +192,10 @@ Home *home_free(Home *h) {
         user_record_unref(h->record);
         user_record_unref(h->secret);
 
+        free(h->queued_verb);
+        user_record_unref(h->queued_record);
+        user_record_unref(h->queued_secret);
+
         h->worker_event_source = sd_event_source_disable_unref(h->worker_event_source);
         safe_close(h->worker_stdout_fd);
         free(h->user_name);
@@ -875,38 +882,9 @@ finish:
         home_set_state(h, _HOME_STATE_INVALID);
 }
 
-static int home_on_worker_process(sd_event_source *s, const siginfo_t *si, void *userdata) {
-        _cleanup_(user_record_unrefp) UserRecord *hr = NULL;
-        Home *h = userdata;
-        int ret;
-
-        assert(s);
-        assert(si);
+static void home_worker_finish(Home *h, int ret, UserRecord *hr) {
         assert(h);
 
-        assert(h->worker_pid == si->si_pid);
-        assert(h->worker_event_source);
-        assert(h->worker_stdout_fd >= 0);
-
-        (void) hashmap_remove_value(h->manager->homes_by_worker_pid, PID_TO_PTR(h->worker_pid), h);
-
-        h->worker_pid = 0;
-        h->worker_event_source = sd_event_source_disable_unref(h->worker_event_source);
-
-        if (si->si_code != CLD_EXITED) {
-                assert(IN_SET(si->si_code, CLD_KILLED, CLD_DUMPED));
-                ret = log_debug_errno(SYNTHETIC_ERRNO(EPROTO), "Worker process died abnormally with signal %s.", signal_to_string(si->si_status));
-        } else if (si->si_status != EXIT_SUCCESS) {
-                /* If we received an error code via sd_notify(), use it */
-                if (h->worker_error_code != 0)
-                        ret = log_debug_errno(h->worker_error_code, "Worker reported error code %s.", errno_to_name(h->worker_error_code));
-                else
-                        ret = log_debug_errno(SYNTHETIC_ERRNO(EPROTO), "Worker exited with exit code %i.", si->si_status);
-        } else
-                ret = home_parse_worker_stdout(TAKE_FD(h->worker_stdout_fd), &hr);
-
-        h->worker_stdout_fd = safe_close(h->worker_stdout_fd);
-
         switch (h->state) {
 
         case HOME_FIXATING:
@@ -959,11 +937,49 @@ static int home_on_worker_process(sd_event_source *s, const siginfo_t *si, void
         default:
                 assert_not_reached();
         }
+}
+
+static int home_on_worker_process(sd_event_source *s, const siginfo_t *si, void *userdata) {
+        _cleanup_(user_record_unrefp) UserRecord *hr = NULL;
+        Home *h = userdata;
+        int ret;
+
+        assert(s);
+        assert(si);
+        assert(h);
+
+        assert(h->worker_pid == si->si_pid);
+        assert(h->worker_event_source);
+        assert(h->worker_stdout_fd >= 0);
+
+        (void) hashmap_remove_value(h->manager->homes_by_worker_pid, PID_TO_PTR(h->worker_pid), h);
+
+        h->worker_pid = 0;
+        h->worker_event_source = sd_event_source_disable_unref(h->worker_event_source);
+
+        /* A worker slot became free, let the next home waiting for one have it */
+        manager_dispatch_worker_queue(h->manager);
+
+        if (si->si_code != CLD_EXITED) {
+                assert(IN_SET(si->si_code, CLD_KILLED, CLD_DUMPED));
+                ret = log_debug_errno(SYNTHETIC_ERRNO(EPROTO), "Worker process died abnormally with signal %s.", signal_to_string(si->si_status));
+        } else if (si->si_status != EXIT_SUCCESS) {
+                /* If we received an error code via sd_notify(), use it */
+                if (h->worker_error_code != 0)
+                        ret = log_debug_errno(h->worker_error_code, "Worker reported error code %s.", errno_to_name(h->worker_error_code));
+                else
+                        ret = log_debug_errno(SYNTHETIC_ERRNO(EPROTO), "Worker exited with exit code %i.", si->si_status);
+        } else
+                ret = home_parse_worker_stdout(TAKE_FD(h->worker_stdout_fd), &hr);
+
+        h->worker_stdout_fd = safe_close(h->worker_stdout_fd);
+
+        home_worker_finish(h, ret, hr);
 
         return 0;
 }
 
-static int home_start_work(Home *h, const char *verb, UserRecord *hr, UserRecord *secret) {
+static int home_fork_work(Home *h, const char *verb, UserRecord *hr, UserRecord *secret) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
         _cleanup_(erase_and_freep) char *formatted = NULL;
         _cleanup_close_ int stdin_fd = -1, stdout_fd = -1;
@@ -974,9 +990,6 @@ static int home_start_work(Home *h, const char *verb, UserRecord *hr, UserRecord
         assert(verb);
         assert(hr);
 
-        if (h->worker_pid != 0)
-                return -EBUSY;
-
         assert(h->worker_stdout_fd < 0);
         assert(!h->worker_event_source);
 
@@ -1081,6 +1094,59 @@ static int home_start_work(Home *h, const char *verb, UserRecord *hr, UserRecord
         return 0;
 }
 
+static int home_start_work(Home *h, const char *verb, UserRecord *hr, UserRecord *secret) {
+        assert(h);
+        assert(verb);
+        assert(hr);
+
+        if (h->worker_pid != 0 || h->worker_queued)
+                return -EBUSY;
+
+        if (h->manager->max_workers == 0 ||
+            hashmap_size(h->manager->homes_by_worker_pid) < h->manager->max_workers)
+                return home_fork_work(h, verb, hr, secret);
+
+        /* Too many workers running already. Remember what to do and return as if we had started the
+         * worker: the caller's state transition applies all the same, only the worker will run later. */
+        h->queued_verb = strdup(verb);
+        if (!h->queued_verb)
+                return -ENOMEM;
+
+        h->queued_record = user_record_ref(hr);
+        h->queued_secret = user_record_ref(secret);
+        h->worker_queued = true;
+
+        LIST_APPEND(worker_queue, h->manager->worker_queue, h);
+
+        log_debug("Too many workers running already, queueing %s of %s.", verb, h->user_name);
+        return 0;
+}
+
+int home_start_queued_work(Home *h) {
+        _cleanup_(user_record_unrefp) UserRecord *hr = NULL, *secret = NULL;
+        _cleanup_free_ char *verb = NULL;
+        int r;
+
+        assert(h);
+        assert(h->worker_queued);
+
+        LIST_REMOVE(worker_queue, h->manager->worker_queue, h);
+        h->worker_queued = false;
+
+        verb = TAKE_PTR(h->queued_verb);
+        hr = TAKE_PTR(h->queued_record);
+        secret = TAKE_PTR(h->queued_secret);
+
+        r = home_fork_work(h, verb, hr, secret);
+        if (r < 0) {
+                /* We told the caller the worker was started, hence fail the same way as if it had died */
+                log_error_errno(r, "Failed to start queued %s worker for %s: %m", verb, h->user_name);
+                home_worker_finish(h, r, NULL);
+        }
+
+        return r;
+}
+
 static int home_ratelimit(Home *h, sd_bus_error *error) {
         int r, ret;
 
@@ -95,6 +95,14 @@ struct Home {
         sd_event_source *worker_event_source;
         int worker_error_code;
 
+        /* If the worker couldn't be started right-away, because too many are running already, what to
+         * start it with once it's our turn */
+        bool worker_queued;
+        char *queued_verb;
+        UserRecord *queued_record;
+        UserRecord *queued_secret;
+        LIST_FIELDS(Home, worker_queue);
+
         /* The message we are currently processing, and thus need to reply to on completion */
         Operation *current_operation;
 
@@ -166,6 +174,7 @@ int home_auto_login(Home *h, char ***ret_seats);
 int home_set_current_message(Home *h, sd_bus_message *m);
 
 int home_wait_for_worker(Home *h);
+int home_start_queued_work(Home *h);
 
 const char *home_state_to_string(HomeState state);
 HomeState home_state_from_string(const char *s);
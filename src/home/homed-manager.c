@@ -233,6 +233,14 @@ int manager_new(Manager **ret) {
         return 0;
 }
 
+void manager_dispatch_worker_queue(Manager *m) {
+        assert(m);
+
+        while (m->worker_queue &&
+               (m->max_workers == 0 || hashmap_size(m->homes_by_worker_pid) < m->max_workers))
+                (void) home_start_queued_work(m->worker_queue);
+}
+
 Manager* manager_free(Manager *m) {
         Home *h;
 
@@ -273,6 +281,7 @@ Manager* manager_free(Manager *m) {
 }
 
 int manager_verify_user_record(Manager *m, UserRecord *hr) {
+        _cleanup_free_ char *signable = NULL;
         EVP_PKEY *pkey;
         int r;
 
@@ -289,7 +298,7 @@ int manager_verify_user_record(Manager *m, UserRecord *hr) {
 
         /* Is it our own? */
         if (m->private_key) {
-                r = user_record_verify(hr, m->private_key);
+                r = user_record_verify_full(hr, m->private_key, &signable);
                 switch (r) {
 
                 case USER_RECORD_FOREIGN:
@@ -305,7 +314,7 @@ int manager_verify_user_record(Manager *m, UserRecord *hr) {
         }
 
         HASHMAP_FOREACH(pkey, m->public_keys) {
-                r = user_record_verify(hr, pkey);
+                r = user_record_verify_full(hr, pkey, &signable);
                 switch (r) {
 
                 case USER_RECORD_FOREIGN:
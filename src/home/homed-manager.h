@@ -11,6 +11,7 @@ typedef struct Manager Manager;
 
 #include "hashmap.h"
 #include "homed-home.h"
+#include "list.h"
 #include "varlink.h"
 
 #define HOME_UID_MIN 60001
@@ -27,6 +28,10 @@ struct Manager {
         Hashmap *homes_by_worker_pid;
         Hashmap *homes_by_sysfs;
 
+        /* Homes waiting for a worker to be started for them, because max_workers are running already */
+        LIST_HEAD(Home, worker_queue);
+        unsigned max_workers; /* 0 → unlimited */
+
         bool scan_slash_home;
         UserStorage default_storage;
         char *default_file_system_type;
@@ -60,6 +65,7 @@ int manager_startup(Manager *m);
 int manager_augment_record_with_uid(Manager *m, UserRecord *hr);
 
 int manager_enqueue_rescan(Manager *m);
+void manager_dispatch_worker_queue(Manager *m);
 int manager_enqueue_gc(Manager *m, Home *focus);
 
 int manager_verify_user_record(Manager *m, UserRecord *hr);
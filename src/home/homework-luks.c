@@ -981,6 +981,27 @@ int run_fitrim_by_path(const char *root_path) {
         return run_fitrim(root_fd);
 }
 
+static void run_fitrim_async(const char *root_path) {
+        int r;
+
+        assert(root_path);
+
+        /* Trimming a large file system may take a while, and there's no need to delay the login for that,
+         * hence do it in a detached child, after the home directory is in place. */
+
+        r = safe_fork("(sd-fitrim)", FORK_RESET_SIGNALS|FORK_CLOSE_ALL_FDS|FORK_STDOUT_TO_STDERR|FORK_DETACH|FORK_LOG, NULL);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to fork off trimming process, trimming synchronously: %m");
+                (void) run_fitrim_by_path(root_path);
+                return;
+        }
+        if (r == 0) {
+                /* Child */
+                (void) run_fitrim_by_path(root_path);
+                _exit(EXIT_SUCCESS);
+        }
+}
+
 int run_fallocate(int backing_fd, const struct stat *st) {
         struct stat stbuf;
 
@@ -1218,9 +1239,16 @@ int home_prepare_luks(
                 if (r < 0)
                         goto fail;
 
-                r = run_fsck(setup->dm_node, fstype);
-                if (r < 0)
-                        goto fail;
+                /* If the image was marked dirty by us above, it has been deactivated cleanly the last time,
+                 * hence there's no point in checking the file system, which is costly on big images. If we
+                 * couldn't mark it (e.g. because it's a block device) we don't know, hence check. */
+                if (marked_dirty)
+                        log_debug("Image has been deactivated cleanly, skipping file system check.");
+                else {
+                        r = run_fsck(setup->dm_node, fstype);
+                        if (r < 0)
+                                goto fail;
+                }
 
                 r = home_unshare_and_mount(setup->dm_node, fstype, user_record_luks_discard(h), user_record_mount_flags(h));
                 if (r < 0)
@@ -1234,7 +1262,7 @@ int home_prepare_luks(
                         goto fail;
                 }
 
-                if (user_record_luks_discard(h))
+                if (user_record_luks_discard(h) && !setup->defer_online_fitrim)
                         (void) run_fitrim(root_fd);
 
                 setup->image_fd = TAKE_FD(image_fd);
@@ -1318,6 +1346,9 @@ int home_activate_luks(
         } else
                 return log_error_errno(SYNTHETIC_ERRNO(EEXIST), "Device mapper device %s already exists, refusing.", setup.dm_node);
 
+        /* We trim once the home directory is in place, see below */
+        setup.defer_online_fitrim = true;
+
         r = home_prepare_luks(
                         h,
                         false,
@@ -1369,6 +1400,9 @@ int home_activate_luks(
         setup.do_offline_fallocate = false;
         setup.do_mark_clean = false;
 
+        if (user_record_luks_discard(h))
+                run_fitrim_async(hd);
+
         log_info("Everything completed.");
 
         print_size_summary(host_size, encrypted_size, &sfs);
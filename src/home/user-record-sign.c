@@ -103,14 +103,17 @@ int user_record_sign(UserRecord *ur, EVP_PKEY *private_key, UserRecord **ret) {
         return 0;
 }
 
-int user_record_verify(UserRecord *ur, EVP_PKEY *public_key) {
-        _cleanup_free_ char *text = NULL;
+int user_record_verify_full(UserRecord *ur, EVP_PKEY *public_key, char **signable) {
         unsigned n_good = 0, n_bad = 0;
         JsonVariant *array, *e;
         int r;
 
         assert(ur);
         assert(public_key);
+        assert(signable);
+
+        /* The signable JSON text is generated on first use and stored in *signable, so that it can be
+         * reused when the same record is checked against multiple keys. */
 
         array = json_variant_by_key(ur->json, "signature");
         if (!array)
@@ -122,9 +125,11 @@ int user_record_verify(UserRecord *ur, EVP_PKEY *public_key) {
         if (json_variant_elements(array) == 0)
                 return USER_RECORD_UNSIGNED;
 
-        r = user_record_signable_json(ur, &text);
-        if (r < 0)
-                return r;
+        if (!*signable) {
+                r = user_record_signable_json(ur, signable);
+                if (r < 0)
+                        return r;
+        }
 
         JSON_VARIANT_ARRAY_FOREACH(e, array) {
                 _cleanup_(EVP_MD_CTX_freep) EVP_MD_CTX *md_ctx = NULL;
@@ -150,7 +155,7 @@ int user_record_verify(UserRecord *ur, EVP_PKEY *public_key) {
                 if (EVP_DigestVerifyInit(md_ctx, NULL, NULL, NULL, public_key) <= 0)
                         return -EIO;
 
-                if (EVP_DigestVerify(md_ctx, signature, signature_size, (uint8_t*) text, strlen(text)) <= 0) {
+                if (EVP_DigestVerify(md_ctx, signature, signature_size, (uint8_t*) *signable, strlen(*signable)) <= 0) {
                         n_bad ++;
                         continue;
                 }
@@ -162,6 +167,12 @@ int user_record_verify(UserRecord *ur, EVP_PKEY *public_key) {
                 (n_bad == 0 ? USER_RECORD_UNSIGNED : USER_RECORD_FOREIGN);
 }
 
+int user_record_verify(UserRecord *ur, EVP_PKEY *public_key) {
+        _cleanup_free_ char *signable = NULL;
+
+        return user_record_verify_full(ur, public_key, &signable);
+}
+
 int user_record_has_signature(UserRecord *ur) {
         JsonVariant *array;
 
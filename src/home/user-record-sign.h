@@ -14,6 +14,7 @@ enum {
         USER_RECORD_FOREIGN,            /* user record is not signed by us, but by others */
 };
 
+int user_record_verify_full(UserRecord *ur, EVP_PKEY *public_key, char **signable);
 int user_record_verify(UserRecord *ur, EVP_PKEY *public_key);
 
 int user_record_has_signature(UserRecord *ur);
@@ -26,6 +26,30 @@ void import_compress_free(ImportCompress *c) {
         c->type = IMPORT_COMPRESS_UNKNOWN;
 }
 
+static lzma_ret xz_stream_decoder(lzma_stream *xz) {
+        assert(xz);
+
+#if LZMA_VERSION >= UINT32_C(50040002)
+        /* liblzma ≥ 5.4 can decode the blocks of an xz file in parallel, if the file was compressed with
+         * multiple blocks (as "xz -T" does). Use that, but stay within a quarter of the physical memory for
+         * the threads' buffers; beyond that liblzma falls back to decoding in a single thread. */
+        uint32_t threads = lzma_cputhreads();
+        if (threads > 1) {
+                lzma_mt mt = {
+                        .flags = LZMA_TELL_UNSUPPORTED_CHECK | LZMA_CONCATENATED,
+                        .threads = threads,
+                        .memlimit_threading = lzma_physmem() / 4,
+                        .memlimit_stop = UINT64_MAX,
+                };
+
+                if (lzma_stream_decoder_mt(xz, &mt) == LZMA_OK)
+                        return LZMA_OK;
+        }
+#endif
+
+        return lzma_stream_decoder(xz, UINT64_MAX, LZMA_TELL_UNSUPPORTED_CHECK | LZMA_CONCATENATED);
+}
+
 int import_uncompress_detect(ImportCompress *c, const void *data, size_t size) {
         static const uint8_t xz_signature[] = {
                 0xfd, '7', 'z', 'X', 'Z', 0x00
@@ -54,7 +78,7 @@ int import_uncompress_detect(ImportCompress *c, const void *data, size_t size) {
         if (memcmp(data, xz_signature, sizeof(xz_signature)) == 0) {
                 lzma_ret xzr;
 
-                xzr = lzma_stream_decoder(&c->xz, UINT64_MAX, LZMA_TELL_UNSUPPORTED_CHECK | LZMA_CONCATENATED);
+                xzr = xz_stream_decoder(&c->xz);
                 if (xzr != LZMA_OK)
                         return -EIO;
 
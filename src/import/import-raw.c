@@ -6,7 +6,6 @@
 #include "sd-event.h"
 
 #include "alloc-util.h"
-#include "btrfs-util.h"
 #include "copy.h"
 #include "fd-util.h"
 #include "fs-util.h"
@@ -272,15 +271,22 @@ static int raw_import_try_reflink(RawImport *i) {
         if (p == (off_t) -1)
                 return log_error_errno(errno, "Failed to read file offset of input file: %m");
 
-        /* Let's only try a btrfs reflink, if we are reading from the beginning of the file */
+        /* Let's only try a direct copy, if we are reading from the beginning of the file */
         if ((uint64_t) p != (uint64_t) i->buffer_size)
                 return 0;
 
-        r = btrfs_reflink(i->input_fd, i->output_fd);
-        if (r >= 0)
-                return 1;
+        /* The file is uncompressed, hence copy it in the kernel: reflink it if we can, otherwise use
+         * copy_file_range(), and in both cases keep holes in the image as holes. */
+        if (lseek(i->input_fd, 0, SEEK_SET) < 0)
+                return log_error_errno(errno, "Failed to seek to beginning of input file: %m");
 
-        return 0;
+        r = copy_bytes(i->input_fd, i->output_fd, UINT64_MAX, COPY_REFLINK|COPY_HOLES);
+        if (r < 0)
+                return log_error_errno(r, "Failed to copy input file: %m");
+
+        i->written_compressed = i->written_uncompressed = i->st.st_size;
+
+        return 1;
 }
 
 static int raw_import_write(const void *p, size_t sz, void *userdata) {
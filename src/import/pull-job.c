@@ -19,6 +19,9 @@
 #include "strv.h"
 #include "xattr-util.h"
 
+/* How often to continue an interrupted transfer where it broke off, before giving up */
+#define PULL_JOB_RESUMES_MAX 5U
+
 PullJob* pull_job_unref(PullJob *j) {
         if (!j)
                 return NULL;
@@ -78,6 +81,8 @@ static int pull_job_restart(PullJob *j, const char *new_url) {
         j->written_compressed = 0;
         j->written_uncompressed = 0;
         j->content_length = UINT64_MAX;
+        j->resume_offset = 0;
+        j->n_resumes = 0;
         j->etag = mfree(j->etag);
         j->etag_exists = false;
         j->mtime = 0;
@@ -103,6 +108,49 @@ static int pull_job_restart(PullJob *j, const char *new_url) {
         return 0;
 }
 
+static int pull_job_add_curl(PullJob *j);
+
+static bool pull_job_may_resume(PullJob *j, CURLcode result) {
+        assert(j);
+
+        /* We can only continue a transfer once we are past the compression detection, i.e. are writing the
+         * data out, and only if the connection broke, not if the server told us something we didn't like. */
+
+        if (j->state != PULL_JOB_RUNNING)
+                return false;
+
+        if (j->written_compressed <= 0)
+                return false;
+
+        if (j->n_resumes >= PULL_JOB_RESUMES_MAX)
+                return false;
+
+        return IN_SET(result,
+                      CURLE_PARTIAL_FILE,
+                      CURLE_RECV_ERROR,
+                      CURLE_SEND_ERROR,
+                      CURLE_GOT_NOTHING,
+                      CURLE_OPERATION_TIMEDOUT);
+}
+
+static int pull_job_resume(PullJob *j) {
+        assert(j);
+
+        /* Continue an interrupted transfer with a Range request where it broke off. The decompressor and
+         * checksum state are kept, the data we get is simply appended to what we already processed. */
+
+        j->n_resumes++;
+        j->resume_offset = j->written_compressed;
+
+        log_info("Transfer of %s interrupted, resuming at %s (attempt %u of %u).",
+                 j->url, FORMAT_BYTES(j->resume_offset), j->n_resumes, PULL_JOB_RESUMES_MAX);
+
+        curl_glue_remove_and_free(j->glue, j->curl);
+        j->curl = NULL;
+
+        return pull_job_add_curl(j);
+}
+
 void pull_job_curl_on_finished(CurlGlue *g, CURL *curl, CURLcode result) {
         PullJob *j = NULL;
         CURLcode code;
@@ -116,6 +164,17 @@ void pull_job_curl_on_finished(CurlGlue *g, CURL *curl, CURLcode result) {
                 return;
 
         if (result != CURLE_OK) {
+                if (pull_job_may_resume(j, result)) {
+                        log_debug("Transfer failed: %s", curl_easy_strerror(result));
+
+                        r = pull_job_resume(j);
+                        if (r >= 0)
+                                return;
+
+                        log_error_errno(r, "Failed to resume transfer: %m");
+                        goto finish;
+                }
+
                 log_error("Transfer failed: %s", curl_easy_strerror(result));
                 r = -EIO;
                 goto finish;
@@ -457,7 +516,7 @@ static size_t pull_job_header_callback(void *contents, size_t size, size_t nmemb
                 goto fail;
         }
 
-        assert(j->state == PULL_JOB_ANALYZING);
+        assert(j->state == PULL_JOB_ANALYZING || (j->state == PULL_JOB_RUNNING && j->resume_offset > 0));
 
         code = curl_easy_getinfo(j->curl, CURLINFO_RESPONSE_CODE, &status);
         if (code != CURLE_OK) {
@@ -466,6 +525,12 @@ static size_t pull_job_header_callback(void *contents, size_t size, size_t nmemb
                 goto fail;
         }
 
+        if (j->resume_offset > 0 && status == 200) {
+                /* The server ignored our Range request and sends everything again */
+                r = log_error_errno(SYNTHETIC_ERRNO(EIO), "Server does not support resuming downloads of %s.", j->url);
+                goto fail;
+        }
+
         if (http_status_ok(status) || http_status_etag_exists(status)) {
                 /* Check Etag on OK and etag exists responses. */
 
@@ -475,6 +540,11 @@ static size_t pull_job_header_callback(void *contents, size_t size, size_t nmemb
                         goto fail;
                 }
                 if (r > 0) {
+                        if (j->resume_offset > 0 && j->etag && !streq(j->etag, etag)) {
+                                r = log_error_errno(SYNTHETIC_ERRNO(ESTALE), "%s changed while resuming download, refusing.", j->url);
+                                goto fail;
+                        }
+
                         free_and_replace(j->etag, etag);
 
                         if (strv_contains(j->old_etags, j->etag)) {
@@ -501,12 +571,16 @@ static size_t pull_job_header_callback(void *contents, size_t size, size_t nmemb
                 (void) safe_atou64(length, &j->content_length);
 
                 if (j->content_length != UINT64_MAX) {
-                        if (j->content_length > j->compressed_max) {
+                        /* When resuming, the length is the one of the remaining part */
+                        if (j->content_length > j->compressed_max - j->resume_offset) {
                                 r = log_error_errno(SYNTHETIC_ERRNO(EFBIG), "Content too large.");
                                 goto fail;
                         }
 
-                        log_info("Downloading %s for %s.", FORMAT_BYTES(j->content_length), j->url);
+                        j->content_length += j->resume_offset;
+
+                        if (j->resume_offset == 0)
+                                log_info("Downloading %s for %s.", FORMAT_BYTES(j->content_length), j->url);
                 }
 
                 return sz;
@@ -545,6 +619,10 @@ static int pull_job_progress_callback(void *userdata, curl_off_t dltotal, curl_o
         if (dltotal <= 0)
                 return 0;
 
+        /* When resuming, curl only counts the remaining part */
+        dltotal += j->resume_offset;
+        dlnow += j->resume_offset;
+
         percent = ((100 * dlnow) / dltotal);
         n = now(CLOCK_MONOTONIC);
 
@@ -609,49 +687,26 @@ int pull_job_new(PullJob **ret, const char *url, CurlGlue *glue, void *userdata)
         return 0;
 }
 
-int pull_job_begin(PullJob *j) {
+static int pull_job_add_curl(PullJob *j) {
         int r;
 
         assert(j);
-
-        if (j->state != PULL_JOB_INIT)
-                return -EBUSY;
+        assert(!j->curl);
 
         r = curl_glue_make(&j->curl, j->url, j);
         if (r < 0)
                 return r;
 
-        if (!strv_isempty(j->old_etags)) {
-                _cleanup_free_ char *cc = NULL, *hdr = NULL;
-
-                cc = strv_join(j->old_etags, ", ");
-                if (!cc)
-                        return -ENOMEM;
-
-                hdr = strjoin("If-None-Match: ", cc);
-                if (!hdr)
-                        return -ENOMEM;
-
-                if (!j->request_header) {
-                        j->request_header = curl_slist_new(hdr, NULL);
-                        if (!j->request_header)
-                                return -ENOMEM;
-                } else {
-                        struct curl_slist *l;
-
-                        l = curl_slist_append(j->request_header, hdr);
-                        if (!l)
-                                return -ENOMEM;
-
-                        j->request_header = l;
-                }
-        }
-
         if (j->request_header) {
                 if (curl_easy_setopt(j->curl, CURLOPT_HTTPHEADER, j->request_header) != CURLE_OK)
                         return -EIO;
         }
 
+        if (j->resume_offset > 0) {
+                if (curl_easy_setopt(j->curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t) j->resume_offset) != CURLE_OK)
+                        return -EIO;
+        }
+
         if (curl_easy_setopt(j->curl, CURLOPT_WRITEFUNCTION, pull_job_write_callback) != CURLE_OK)
                 return -EIO;
 
@@ -673,7 +728,44 @@ int pull_job_begin(PullJob *j) {
         if (curl_easy_setopt(j->curl, CURLOPT_NOPROGRESS, 0) != CURLE_OK)
                 return -EIO;
 
-        r = curl_glue_add(j->glue, j->curl);
+        return curl_glue_add(j->glue, j->curl);
+}
+
+int pull_job_begin(PullJob *j) {
+        int r;
+
+        assert(j);
+
+        if (j->state != PULL_JOB_INIT)
+                return -EBUSY;
+
+        if (!strv_isempty(j->old_etags)) {
+                _cleanup_free_ char *cc = NULL, *hdr = NULL;
+
+                cc = strv_join(j->old_etags, ", ");
+                if (!cc)
+                        return -ENOMEM;
+
+                hdr = strjoin("If-None-Match: ", cc);
+                if (!hdr)
+                        return -ENOMEM;
+
+                if (!j->request_header) {
+                        j->request_header = curl_slist_new(hdr, NULL);
+                        if (!j->request_header)
+                                return -ENOMEM;
+                } else {
+                        struct curl_slist *l;
+
+                        l = curl_slist_append(j->request_header, hdr);
+                        if (!l)
+                                return -ENOMEM;
+
+                        j->request_header = l;
+                }
+        }
+
+        r = pull_job_add_curl(j);
         if (r < 0)
                 return r;
 
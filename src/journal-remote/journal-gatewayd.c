@@ -29,11 +29,15 @@
 #include "parse-util.h"
 #include "pretty-print.h"
 #include "sigbus.h"
+#include "strv.h"
 #include "tmpfile-util.h"
 #include "util.h"
 
 #define JOURNAL_WAIT_TIMEOUT (10*USEC_PER_SEC)
 
+/* The maximum amount of data libmicrohttpd asks us for at once */
+#define RESPONSE_BLOCK_SIZE (64U*1024U)
+
 static char *arg_key_pem = NULL;
 static char *arg_cert_pem = NULL;
 static char *arg_trust_pem = NULL;
@@ -56,6 +60,8 @@ typedef struct RequestMeta {
         uint64_t n_entries;
         bool n_entries_set;
 
+        char **output_fields;
+
         FILE *tmp;
         uint64_t delta, size;
 
@@ -104,6 +110,7 @@ static void request_meta_free(
         safe_fclose(m->tmp);
 
         free(m->cursor);
+        strv_free(m->output_fields);
         free(m);
 }
 
@@ -223,12 +230,46 @@ static ssize_t request_reader_entries(
                 }
 
                 r = show_journal_entry(m->tmp, m->journal, m->mode, 0, OUTPUT_FULL_WIDTH,
-                                   NULL, NULL, NULL);
+                                   m->output_fields, NULL, NULL);
                 if (r < 0) {
                         log_error_errno(r, "Failed to serialize item: %m");
                         return MHD_CONTENT_READER_END_WITH_ERROR;
                 }
 
+                /* Serializing entries one by one means one round trip through libmicrohttpd and the
+                 * temporary file for each, which is slow when many entries are requested. Hence serialize
+                 * the entries following right away too, as long as they are available already and we
+                 * don't have a block full. Not in discrete mode, where there's only one entry anyway. */
+                while (!m->discrete &&
+                       !(m->n_entries_set && m->n_entries <= 0)) {
+
+                        sz = ftello(m->tmp);
+                        if (sz == (off_t) -1) {
+                                log_error_errno(errno, "Failed to retrieve file position: %m");
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+                        }
+                        if ((uint64_t) sz >= RESPONSE_BLOCK_SIZE)
+                                break;
+
+                        r = sd_journal_next(m->journal);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to advance journal pointer: %m");
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+                        }
+                        if (r == 0)
+                                break;
+
+                        if (m->n_entries_set)
+                                m->n_entries -= 1;
+
+                        r = show_journal_entry(m->tmp, m->journal, m->mode, 0, OUTPUT_FULL_WIDTH,
+                                               m->output_fields, NULL, NULL);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to serialize item: %m");
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+                        }
+                }
+
                 sz = ftello(m->tmp);
                 if (sz == (off_t) -1) {
                         log_error_errno(errno, "Failed to retrieve file position: %m");
@@ -402,6 +443,24 @@ static mhd_result request_parse_arguments_iterator(
                 return MHD_YES;
         }
 
+        if (streq(key, "fields")) {
+                _cleanup_strv_free_ char **v = NULL;
+
+                v = strv_split(strempty(value), ",");
+                if (!v) {
+                        m->argument_parse_error = log_oom();
+                        return MHD_NO;
+                }
+
+                r = strv_extend_strv(&m->output_fields, v, true);
+                if (r < 0) {
+                        m->argument_parse_error = log_oom();
+                        return MHD_NO;
+                }
+
+                return MHD_YES;
+        }
+
         if (streq(key, "boot")) {
                 if (isempty(value))
                         r = true;
@@ -503,7 +562,7 @@ static int request_handler_entries(
         if (r < 0)
                 return mhd_respond(connection, MHD_HTTP_BAD_REQUEST, "Failed to seek in journal.");
 
-        response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4*1024, request_reader_entries, m, NULL);
+        response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, RESPONSE_BLOCK_SIZE, request_reader_entries, m, NULL);
         if (!response)
                 return respond_oom(connection);
 
@@ -633,7 +692,7 @@ static int request_handler_fields(
         if (r < 0)
                 return mhd_respond(connection, MHD_HTTP_BAD_REQUEST, "Failed to query unique fields.");
 
-        response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4*1024, request_reader_fields, m, NULL);
+        response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, RESPONSE_BLOCK_SIZE, request_reader_fields, m, NULL);
         if (!response)
                 return respond_oom(connection);
 
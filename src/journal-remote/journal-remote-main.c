@@ -37,6 +37,7 @@ static const char* arg_listen_https = NULL;
 static char** arg_files = NULL; /* Do not free this. */
 static bool arg_compress = true;
 static bool arg_seal = false;
+static unsigned arg_writer_threads = 0;
 static int http_socket = -1, https_socket = -1;
 static char** arg_gnutls_log = NULL;
 
@@ -268,7 +269,7 @@ static mhd_result request_handler(
         const char *header;
         int r, code, fd;
         _cleanup_free_ char *hostname = NULL;
-        bool chunked = false;
+        bool chunked = false, batch;
 
         assert(connection);
         assert(connection_cls);
@@ -289,9 +290,14 @@ static mhd_result request_handler(
                 return mhd_respond(connection, MHD_HTTP_NOT_FOUND, "Not found.");
 
         header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Content-Type");
-        if (!header || !streq(header, "application/vnd.fdo.journal"))
+        if (header && streq(header, JOURNAL_BATCH_CONTENT_TYPE))
+                batch = true;
+        else if (header && streq(header, "application/vnd.fdo.journal"))
+                batch = false;
+        else
                 return mhd_respond(connection, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE,
-                                   "Content-Type: application/vnd.fdo.journal is required.");
+                                   "Content-Type: application/vnd.fdo.journal or "
+                                   JOURNAL_BATCH_CONTENT_TYPE " is required.");
 
         header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Transfer-Encoding");
         if (header) {
@@ -357,6 +363,8 @@ static mhd_result request_handler(
         else if (r < 0)
                 return mhd_respondf(connection, r, MHD_HTTP_INTERNAL_SERVER_ERROR, "%m");
 
+        ((RemoteSource*) *connection_cls)->importer.batch = batch;
+
         hostname = NULL;
         return MHD_YES;
 }
@@ -596,7 +604,7 @@ static int create_remoteserver(
         int r, n, fd;
         char **file;
 
-        r = journal_remote_server_init(s, arg_output, arg_split_mode, arg_compress, arg_seal);
+        r = journal_remote_server_init(s, arg_output, arg_split_mode, arg_compress, arg_seal, arg_writer_threads);
         if (r < 0)
                 return r;
 
@@ -756,6 +764,7 @@ static int parse_config(void) {
         const ConfigTableItem items[] = {
                 { "Remote",  "Seal",                   config_parse_bool,             0, &arg_seal       },
                 { "Remote",  "SplitMode",              config_parse_write_split_mode, 0, &arg_split_mode },
+                { "Remote",  "WriterThreads",          config_parse_unsigned,         0, &arg_writer_threads },
                 { "Remote",  "ServerKeyFile",          config_parse_path,             0, &arg_key        },
                 { "Remote",  "ServerCertificateFile",  config_parse_path,             0, &arg_cert       },
                 { "Remote",  "TrustedCertificateFile", config_parse_path,             0, &arg_trust      },
@@ -801,6 +810,7 @@ static int help(void) {
                "     --gnutls-log=CATEGORY...\n"
                "                            Specify a list of gnutls logging categories\n"
                "     --split-mode=none|host How many output files to create\n"
+               "     --writer-threads=N     Write output files from N threads (default: 0)\n"
                "\nNote: file descriptors from sd_listen_fds() will be consumed, too.\n"
                "\nSee the %s for details.\n",
                program_invocation_short_name,
@@ -824,6 +834,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_CERT,
                 ARG_TRUST,
                 ARG_GNUTLS_LOG,
+                ARG_WRITER_THREADS,
         };
 
         static const struct option options[] = {
@@ -842,6 +853,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "cert",         required_argument, NULL, ARG_CERT         },
                 { "trust",        required_argument, NULL, ARG_TRUST        },
                 { "gnutls-log",   required_argument, NULL, ARG_GNUTLS_LOG   },
+                { "writer-threads", required_argument, NULL, ARG_WRITER_THREADS },
                 {}
         };
 
@@ -977,6 +989,12 @@ static int parse_argv(int argc, char *argv[]) {
                                 return r;
                         break;
 
+                case ARG_WRITER_THREADS:
+                        r = safe_atou(optarg, &arg_writer_threads);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --writer-threads= argument: %s", optarg);
+                        break;
+
                 case ARG_GNUTLS_LOG:
 #if HAVE_GNUTLS
                         for (const char* p = optarg;;) {
@@ -1,10 +1,29 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <signal.h>
+
 #include "alloc-util.h"
 #include "journal-remote.h"
 
+/* Let's not let the parser get too far ahead of a worker thread. When either limit is hit the main thread
+ * waits for the worker to pick up the queued entries. */
+#define WRITER_WORKER_QUEUE_MAX 1024U
+#define WRITER_WORKER_QUEUE_BYTES_MAX (64U*1024U*1024U)
+
+struct WriterRequest {
+        Writer *writer;
+        dual_timestamp ts;
+        sd_id128_t boot_id;
+        size_t size;
+
+        LIST_FIELDS(WriterRequest, queue);
+
+        size_t n_iovec;
+        struct iovec iovec[];
+};
+
 static int do_rotate(JournalFile **f, bool compress, bool seal) {
-        int r = journal_file_rotate(f, compress, UINT64_MAX, seal, NULL);
+        int r = journal_file_rotate(f, compress, UINT64_MAX, false, seal, NULL);
         if (r < 0) {
                 if (*f)
                         log_error_errno(r, "Failed to rotate %s: %m", (*f)->path);
@@ -34,10 +53,35 @@ Writer* writer_new(RemoteServer *server) {
         return w;
 }
 
+void writer_set_worker(Writer *w, WriterWorker *worker) {
+        assert(w);
+        assert(!w->worker);
+
+        w->worker = worker;
+        if (worker)
+                worker->n_writers++;
+}
+
+static void writer_drain(Writer *w) {
+        assert(w);
+
+        if (!w->worker)
+                return;
+
+        /* Wait until the worker thread has written everything queued for this writer, so that we can
+         * safely close the journal file. */
+        assert_se(pthread_mutex_lock(&w->worker->mutex) == 0);
+        while (w->n_pending > 0)
+                assert_se(pthread_cond_wait(&w->worker->done_cond, &w->worker->mutex) == 0);
+        assert_se(pthread_mutex_unlock(&w->worker->mutex) == 0);
+}
+
 static Writer* writer_free(Writer *w) {
         if (!w)
                 return NULL;
 
+        writer_drain(w);
+
         if (w->journal) {
                 log_debug("Closing journal file %s.", w->journal->path);
                 journal_file_close(w->journal);
@@ -51,22 +95,27 @@ static Writer* writer_free(Writer *w) {
         if (w->mmap)
                 mmap_cache_unref(w->mmap);
 
+        if (w->worker)
+                w->worker->n_writers--;
+
         return mfree(w);
 }
 
 DEFINE_TRIVIAL_REF_UNREF_FUNC(Writer, writer, writer_free);
 
-int writer_write(Writer *w,
-                 struct iovec_wrapper *iovw,
-                 dual_timestamp *ts,
-                 sd_id128_t *boot_id,
-                 bool compress,
-                 bool seal) {
+static int writer_write_now(
+                Writer *w,
+                const struct iovec *iovec,
+                size_t n_iovec,
+                const dual_timestamp *ts,
+                const sd_id128_t *boot_id,
+                bool compress,
+                bool seal) {
         int r;
 
         assert(w);
-        assert(iovw);
-        assert(iovw->count > 0);
+        assert(iovec);
+        assert(n_iovec > 0);
 
         if (journal_file_rotate_suggested(w->journal, 0)) {
                 log_info("%s: Journal header limits reached or header out-of-date, rotating",
@@ -77,11 +126,11 @@ int writer_write(Writer *w,
         }
 
         r = journal_file_append_entry(w->journal, ts, boot_id,
-                                      iovw->iovec, iovw->count,
+                                      iovec, n_iovec,
                                       &w->seqnum, NULL, NULL);
         if (r >= 0) {
                 if (w->server)
-                        w->server->event_count += 1;
+                        __sync_fetch_and_add(&w->server->event_count, 1);
                 return 0;
         } else if (r == -EBADMSG)
                 return r;
@@ -95,12 +144,223 @@ int writer_write(Writer *w,
 
         log_debug("Retrying write.");
         r = journal_file_append_entry(w->journal, ts, boot_id,
-                                      iovw->iovec, iovw->count,
+                                      iovec, n_iovec,
                                       &w->seqnum, NULL, NULL);
         if (r < 0)
                 return r;
 
         if (w->server)
-                w->server->event_count += 1;
+                __sync_fetch_and_add(&w->server->event_count, 1);
         return 0;
 }
+
+static int writer_queue(
+                Writer *w,
+                struct iovec_wrapper *iovw,
+                const dual_timestamp *ts,
+                const sd_id128_t *boot_id) {
+
+        WriterWorker *worker;
+        WriterRequest *req;
+        size_t size;
+        uint8_t *p;
+
+        assert(w);
+        assert(w->worker);
+        assert(iovw);
+
+        worker = w->worker;
+
+        /* The importer reuses its buffer for the next entry, hence copy the fields to a single allocation
+         * that is owned by the request from now on. */
+        size = iovw_size(iovw);
+        req = malloc(offsetof(WriterRequest, iovec) + iovw->count * sizeof(struct iovec) + size);
+        if (!req)
+                return -ENOMEM;
+
+        *req = (WriterRequest) {
+                .writer = w,
+                .ts = *ts,
+                .boot_id = *boot_id,
+                .size = size,
+                .n_iovec = iovw->count,
+        };
+
+        p = (uint8_t*) (req->iovec + req->n_iovec);
+        for (size_t i = 0; i < iovw->count; i++) {
+                req->iovec[i] = IOVEC_MAKE(p, iovw->iovec[i].iov_len);
+                p = mempcpy(p, iovw->iovec[i].iov_base, iovw->iovec[i].iov_len);
+        }
+
+        assert_se(pthread_mutex_lock(&worker->mutex) == 0);
+
+        while (worker->n_queued >= WRITER_WORKER_QUEUE_MAX ||
+               (worker->n_queued > 0 && worker->n_queued_bytes + size > WRITER_WORKER_QUEUE_BYTES_MAX))
+                assert_se(pthread_cond_wait(&worker->done_cond, &worker->mutex) == 0);
+
+        LIST_INSERT_AFTER(queue, worker->queue, worker->queue_tail, req);
+        worker->queue_tail = req;
+        worker->n_queued++;
+        worker->n_queued_bytes += size;
+        w->n_pending++;
+
+        assert_se(pthread_cond_signal(&worker->queue_cond) == 0);
+        assert_se(pthread_mutex_unlock(&worker->mutex) == 0);
+
+        return 0;
+}
+
+int writer_write(Writer *w,
+                 struct iovec_wrapper *iovw,
+                 dual_timestamp *ts,
+                 sd_id128_t *boot_id,
+                 bool compress,
+                 bool seal) {
+
+        assert(w);
+        assert(iovw);
+        assert(iovw->count > 0);
+
+        /* If the writer is owned by a worker thread, the entry is written asynchronously, and write errors
+         * are logged by the worker. */
+        if (w->worker)
+                return writer_queue(w, iovw, ts, boot_id);
+
+        return writer_write_now(w, iovw->iovec, iovw->count, ts, boot_id, compress, seal);
+}
+
+static void writer_worker_process(WriterWorker *worker, WriterRequest *req) {
+        int r;
+
+        r = writer_write_now(req->writer, req->iovec, req->n_iovec, &req->ts, &req->boot_id,
+                             worker->compress, worker->seal);
+        if (r == -EBADMSG)
+                log_warning_errno(r, "Entry is invalid, ignoring.");
+        else if (r < 0)
+                log_error_errno(r, "Failed to write entry of %zu bytes: %m", req->size);
+}
+
+static void* writer_worker_thread(void *arg) {
+        WriterWorker *worker = arg;
+
+        (void) pthread_setname_np(pthread_self(), "journal-writer");
+
+        assert_se(pthread_mutex_lock(&worker->mutex) == 0);
+
+        for (;;) {
+                WriterRequest *batch, *req;
+
+                while (!worker->queue && !worker->stop)
+                        assert_se(pthread_cond_wait(&worker->queue_cond, &worker->mutex) == 0);
+
+                if (!worker->queue)
+                        break;
+
+                /* Take the whole queue at once, so that the main thread can continue queueing while we
+                 * write. */
+                batch = TAKE_PTR(worker->queue);
+                worker->queue_tail = NULL;
+                worker->n_queued = 0;
+                worker->n_queued_bytes = 0;
+                assert_se(pthread_cond_broadcast(&worker->done_cond) == 0);
+
+                assert_se(pthread_mutex_unlock(&worker->mutex) == 0);
+
+                LIST_FOREACH(queue, req, batch)
+                        writer_worker_process(worker, req);
+
+                assert_se(pthread_mutex_lock(&worker->mutex) == 0);
+
+                while ((req = batch)) {
+                        LIST_REMOVE(queue, batch, req);
+
+                        assert(req->writer->n_pending > 0);
+                        req->writer->n_pending--;
+                        free(req);
+                }
+
+                assert_se(pthread_cond_broadcast(&worker->done_cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&worker->mutex) == 0);
+
+        return NULL;
+}
+
+int writer_worker_new(bool compress, bool seal, WriterWorker **ret) {
+        _cleanup_free_ WriterWorker *worker = NULL;
+        sigset_t ss, saved_ss;
+        int r;
+
+        assert(ret);
+
+        worker = new(WriterWorker, 1);
+        if (!worker)
+                return -ENOMEM;
+
+        *worker = (WriterWorker) {
+                .compress = compress,
+                .seal = seal,
+        };
+
+        r = pthread_mutex_init(&worker->mutex, NULL);
+        if (r > 0)
+                return -r;
+
+        r = pthread_cond_init(&worker->queue_cond, NULL);
+        if (r > 0)
+                goto fail_mutex;
+
+        r = pthread_cond_init(&worker->done_cond, NULL);
+        if (r > 0)
+                goto fail_queue_cond;
+
+        /* Signals are handled by the event loop of the main thread. Don't block SIGBUS though, since the
+         * worker accesses memory mapped files. */
+        assert_se(sigfillset(&ss) >= 0);
+        assert_se(sigdelset(&ss, SIGBUS) >= 0);
+
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                goto fail_done_cond;
+
+        r = pthread_create(&worker->thread, NULL, writer_worker_thread, worker);
+
+        assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+        if (r > 0)
+                goto fail_done_cond;
+
+        *ret = TAKE_PTR(worker);
+        return 0;
+
+fail_done_cond:
+        pthread_cond_destroy(&worker->done_cond);
+fail_queue_cond:
+        pthread_cond_destroy(&worker->queue_cond);
+fail_mutex:
+        pthread_mutex_destroy(&worker->mutex);
+        return -r;
+}
+
+WriterWorker* writer_worker_free(WriterWorker *worker) {
+        if (!worker)
+                return NULL;
+
+        assert(worker->n_writers == 0);
+
+        /* The thread writes out whatever is still queued before it exits */
+        assert_se(pthread_mutex_lock(&worker->mutex) == 0);
+        worker->stop = true;
+        assert_se(pthread_cond_signal(&worker->queue_cond) == 0);
+        assert_se(pthread_mutex_unlock(&worker->mutex) == 0);
+
+        assert_se(pthread_join(worker->thread, NULL) == 0);
+
+        assert(!worker->queue);
+
+        pthread_cond_destroy(&worker->done_cond);
+        pthread_cond_destroy(&worker->queue_cond);
+        pthread_mutex_destroy(&worker->mutex);
+
+        return mfree(worker);
+}
@@ -1,10 +1,39 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 #pragma once
 
+#include <pthread.h>
+
 #include "journal-file.h"
 #include "journal-importer.h"
+#include "list.h"
 
 typedef struct RemoteServer RemoteServer;
+typedef struct WriterRequest WriterRequest;
+
+/* A thread that writes the entries of the writers assigned to it, in the order they are queued. Parsing
+ * happens in the main thread, and each writer (i.e. output file) is only ever written by one thread. */
+typedef struct WriterWorker {
+        pthread_t thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t queue_cond;   /* signalled when requests are queued, or when the thread shall stop */
+        pthread_cond_t done_cond;    /* signalled when queued requests have been picked up or written */
+
+        LIST_HEAD(WriterRequest, queue);
+        WriterRequest *queue_tail;
+        size_t n_queued;
+        uint64_t n_queued_bytes;
+        bool stop;
+
+        bool compress;
+        bool seal;
+
+        unsigned n_writers;          /* only accessed from the main thread */
+} WriterWorker;
+
+int writer_worker_new(bool compress, bool seal, WriterWorker **ret);
+WriterWorker* writer_worker_free(WriterWorker *worker);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(WriterWorker*, writer_worker_free);
 
 typedef struct Writer {
         JournalFile *journal;
@@ -17,9 +46,13 @@ typedef struct Writer {
         uint64_t seqnum;
 
         unsigned n_ref;
+
+        WriterWorker *worker;
+        unsigned n_pending;          /* protected by worker->mutex */
 } Writer;
 
 Writer* writer_new(RemoteServer* server);
+void writer_set_worker(Writer *w, WriterWorker *worker);
 Writer* writer_ref(Writer *w);
 Writer* writer_unref(Writer *w);
 
@@ -127,6 +127,17 @@ int journal_remote_get_writer(RemoteServer *s, const char *host, Writer **writer
                                 return log_oom();
                 }
 
+                if (s->n_workers > 0) {
+                        WriterWorker *worker = s->workers[0];
+
+                        /* Hand the new output file to the worker thread owning the fewest ones */
+                        for (size_t i = 1; i < s->n_workers; i++)
+                                if (s->workers[i]->n_writers < worker->n_writers)
+                                        worker = s->workers[i];
+
+                        writer_set_worker(w, worker);
+                }
+
                 r = open_output(s, w, host);
                 if (r < 0)
                         return r;
@@ -303,7 +314,8 @@ int journal_remote_server_init(
                 const char *output,
                 JournalWriteSplitMode split_mode,
                 bool compress,
-                bool seal) {
+                bool seal,
+                unsigned n_workers) {
 
         int r;
 
@@ -333,6 +345,20 @@ int journal_remote_server_init(
         if (r < 0)
                 return r;
 
+        if (n_workers > 0) {
+                s->workers = new0(WriterWorker*, n_workers);
+                if (!s->workers)
+                        return log_oom();
+
+                for (; s->n_workers < n_workers; s->n_workers++) {
+                        r = writer_worker_new(compress, seal, s->workers + s->n_workers);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to start writer thread: %m");
+                }
+
+                log_debug("Started %zu writer threads.", s->n_workers);
+        }
+
         return 0;
 }
 
@@ -359,6 +385,11 @@ void journal_remote_server_destroy(RemoteServer *s) {
         writer_unref(s->_single_writer);
         hashmap_free(s->writers);
 
+        /* All writers are gone by now, hence the worker threads are idle */
+        for (i = 0; i < s->n_workers; i++)
+                writer_worker_free(s->workers[i]);
+        free(s->workers);
+
         sd_event_source_unref(s->sigterm_event);
         sd_event_source_unref(s->sigint_event);
         sd_event_source_unref(s->listen_event);
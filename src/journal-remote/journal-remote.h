@@ -32,6 +32,9 @@ struct RemoteServer {
         Writer *_single_writer;
         uint64_t event_count;
 
+        WriterWorker **workers;
+        size_t n_workers;
+
 #if HAVE_MICROHTTPD
         Hashmap *daemons;
 #endif
@@ -49,7 +52,8 @@ int journal_remote_server_init(
                 const char *output,
                 JournalWriteSplitMode split_mode,
                 bool compress,
-                bool seal);
+                bool seal,
+                unsigned n_workers);
 
 int journal_remote_get_writer(RemoteServer *s, const char *host, Writer **writer);
 
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include <curl/curl.h>
+#include <malloc.h>
 #include <stdbool.h>
 
 #include "sd-daemon.h"
@@ -12,6 +13,8 @@
 #include "utf8.h"
 #include "util.h"
 
+#define UPLOAD_REQUEST_CHUNK (64U*1024U)
+
 /**
  * Write up to size bytes to buf. Return negative on error, and number of
  * bytes written otherwise. The last case is a kind of an error too.
@@ -225,6 +228,7 @@ static ssize_t write_entry(char *buf, size_t size, Uploader *u) {
                         buf[pos++] = '\n';
                         u->entry_state++;
                         u->entries_sent++;
+                        u->request_entries++;
 
                         return pos;
 
@@ -235,6 +239,12 @@ static ssize_t write_entry(char *buf, size_t size, Uploader *u) {
         assert_not_reached();
 }
 
+static bool request_full(Uploader *u) {
+        assert(u);
+
+        return u->request_entries >= UPLOAD_REQUEST_ENTRIES_MAX || u->request_size >= UPLOAD_REQUEST_SIZE_MAX;
+}
+
 static void check_update_watchdog(Uploader *u) {
         usec_t after;
         usec_t elapsed_time;
@@ -267,6 +277,13 @@ static size_t journal_input_callback(void *buf, size_t size, size_t nmemb, void
 
         while (j && filled < size * nmemb) {
                 if (u->entry_state == ENTRY_DONE) {
+                        if (request_full(u)) {
+                                /* End this request, the remaining entries go into the next one */
+                                u->more_pending = true;
+                                u->uploading = false;
+                                break;
+                        }
+
                         r = sd_journal_next(j);
                         if (r < 0) {
                                 log_error_errno(r, "Failed to move to next entry in journal: %m");
@@ -303,6 +320,158 @@ static size_t journal_input_callback(void *buf, size_t size, size_t nmemb, void
                           u->entries_sent, u->current_cursor);
         }
 
+        u->request_size += filled;
+        return filled;
+}
+
+static int encode_entry(Uploader *u) {
+        const void *data;
+        usec_t realtime, monotonic;
+        sd_id128_t boot_id;
+        size_t length;
+        int r;
+
+        assert(u);
+        assert(u->entry_state == ENTRY_CURSOR);
+
+        u->current_cursor = mfree(u->current_cursor);
+
+        r = sd_journal_get_cursor(u->journal, &u->current_cursor);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cursor: %m");
+
+        r = sd_journal_get_realtime_usec(u->journal, &realtime);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+
+        r = sd_journal_get_monotonic_usec(u->journal, &monotonic, &boot_id);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+
+        r = journal_batch_encoder_begin_entry(&u->batch_encoder, realtime, monotonic, boot_id);
+        if (r < 0)
+                return log_oom();
+
+        SD_JOURNAL_FOREACH_DATA(u->journal, data, length) {
+                /* The boot ID is part of the entry header */
+                if (memory_startswith(data, length, "_BOOT_ID="))
+                        continue;
+
+                r = journal_batch_encoder_add_field(&u->batch_encoder, data, length);
+                if (r == -EINVAL)
+                        return log_error_errno(r, "Invalid field.");
+                if (r < 0)
+                        return log_oom();
+        }
+
+        r = journal_batch_encoder_end_entry(&u->batch_encoder);
+        if (r < 0)
+                return log_oom();
+
+        u->entry_state = ENTRY_DONE;
+        u->entries_sent++;
+        u->request_entries++;
+
+        return 0;
+}
+
+static int finish_frame(Uploader *u) {
+        int r;
+
+        assert(u);
+        assert(!u->batch_frame);
+
+        r = journal_batch_encoder_finish(&u->batch_encoder, (void**) &u->batch_frame, &u->batch_frame_size);
+        if (r < 0)
+                return log_oom();
+
+        u->batch_frame_pos = 0;
+        return 0;
+}
+
+static size_t journal_batch_input_callback(void *buf, size_t size, size_t nmemb, void *userp) {
+        Uploader *u = userp;
+        sd_journal *j;
+        size_t filled = 0;
+        int r;
+
+        assert(u);
+        assert(nmemb <= SSIZE_MAX / size);
+
+        check_update_watchdog(u);
+
+        j = u->journal;
+
+        while (filled < size * nmemb) {
+                size_t n;
+
+                if (u->batch_frame) {
+                        n = MIN(u->batch_frame_size - u->batch_frame_pos, size * nmemb - filled);
+                        memcpy((uint8_t*) buf + filled, u->batch_frame + u->batch_frame_pos, n);
+                        filled += n;
+
+                        u->batch_frame_pos += n;
+                        if (u->batch_frame_pos == u->batch_frame_size)
+                                u->batch_frame = mfree(u->batch_frame);
+
+                        continue;
+                }
+
+                if (!j)
+                        break;
+
+                /* Collect entries until the frame is full or we run out of entries, then send the frame */
+                if (u->entry_state == ENTRY_DONE) {
+                        if (request_full(u)) {
+                                if (u->batch_encoder.n_entries > 0) {
+                                        if (finish_frame(u) < 0)
+                                                return CURL_READFUNC_ABORT;
+                                        continue;
+                                }
+
+                                u->more_pending = true;
+                                u->uploading = false;
+                                break;
+                        }
+
+                        r = sd_journal_next(j);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to move to next entry in journal: %m");
+                                return CURL_READFUNC_ABORT;
+                        } else if (r == 0) {
+                                if (u->batch_encoder.n_entries > 0) {
+                                        if (finish_frame(u) < 0)
+                                                return CURL_READFUNC_ABORT;
+                                        continue;
+                                }
+
+                                if (u->input_event)
+                                        log_debug("No more entries, waiting for journal.");
+                                else {
+                                        log_info("No more entries, closing journal.");
+                                        close_journal_input(u);
+                                }
+
+                                u->uploading = false;
+
+                                break;
+                        }
+
+                        u->entry_state = ENTRY_CURSOR;
+                }
+
+                if (encode_entry(u) < 0)
+                        return CURL_READFUNC_ABORT;
+
+                log_debug("Entry %zu (%s) has been queued for upload.",
+                          u->entries_sent, u->current_cursor);
+
+                if (journal_batch_encoder_full(&u->batch_encoder) &&
+                    finish_frame(u) < 0)
+                        return CURL_READFUNC_ABORT;
+        }
+
+        u->request_size += filled;
         return filled;
 }
 
@@ -318,12 +487,68 @@ void close_journal_input(Uploader *u) {
         u->timeout = 0;
 }
 
+static void start_request(Uploader *u) {
+        assert(u);
+
+        u->request_entries = u->request_size = 0;
+        u->more_pending = false;
+
+        if (u->batch) {
+                /* Every request is a new stream for the receiver */
+                journal_batch_encoder_reset(&u->batch_encoder);
+                u->batch_frame = mfree(u->batch_frame);
+        }
+}
+
+static int queue_journal_request(Uploader *u) {
+        size_t (*input_callback)(void *buf, size_t size, size_t nmemb, void *userp);
+        _cleanup_free_ char *body = NULL, *cursor = NULL;
+        size_t size = 0;
+
+        assert(u);
+
+        /* Serialize the next entries into a request body up front, so that several requests can be in
+         * flight at the same time */
+
+        start_request(u);
+
+        input_callback = u->batch ? journal_batch_input_callback : journal_input_callback;
+
+        for (;;) {
+                size_t n;
+
+                if (!GREEDY_REALLOC(body, size + UPLOAD_REQUEST_CHUNK))
+                        return log_oom();
+
+                n = input_callback(body + size, 1, MALLOC_SIZEOF_SAFE(body) - size, u);
+                if (n == CURL_READFUNC_ABORT)
+                        return -EIO;
+                if (n == 0)
+                        break;
+
+                size += n;
+        }
+
+        if (size == 0)
+                return 0;
+
+        if (u->current_cursor) {
+                cursor = strdup(u->current_cursor);
+                if (!cursor)
+                        return log_oom();
+        }
+
+        return start_upload_request(u, TAKE_PTR(body), size, TAKE_PTR(cursor));
+}
+
 static int process_journal_input(Uploader *u, int skip) {
         int r;
 
-        if (u->uploading)
+        if (upload_pipelined(u) ? u->n_requests >= u->max_requests : u->uploading)
                 return 0;
 
+        u->more_pending = false;
+
         r = sd_journal_next_skip(u->journal, skip);
         if (r < 0)
                 return log_error_errno(r, "Failed to skip to next entry: %m");
@@ -332,6 +557,23 @@ static int process_journal_input(Uploader *u, int skip) {
 
         /* have data */
         u->entry_state = ENTRY_CURSOR;
+
+        if (upload_pipelined(u)) {
+                do {
+                        r = queue_journal_request(u);
+                        if (r < 0)
+                                return r;
+                } while (u->journal && u->more_pending && u->n_requests < u->max_requests);
+
+                u->uploading = u->n_requests > 0;
+                return 0;
+        }
+
+        start_request(u);
+
+        if (u->batch)
+                return start_upload(u, journal_batch_input_callback, u);
+
         return start_upload(u, journal_input_callback, u);
 }
 
@@ -346,7 +588,7 @@ int check_journal_input(Uploader *u) {
                         return r;
                 }
 
-                if (r == SD_JOURNAL_NOP)
+                if (r == SD_JOURNAL_NOP && !u->more_pending)
                         return 0;
         }
 
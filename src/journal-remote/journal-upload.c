@@ -54,6 +54,8 @@ static bool arg_merge = false;
 static int arg_follow = -1;
 static const char *arg_save_state = NULL;
 static usec_t arg_network_timeout_usec = USEC_INFINITY;
+static bool arg_batch = false;
+static unsigned arg_requests_in_flight = 1;
 
 static void close_fd_input(Uploader *u);
 
@@ -79,16 +81,16 @@ static size_t output_callback(char *buf,
                               size_t size,
                               size_t nmemb,
                               void *userp) {
-        Uploader *u = userp;
+        char **answer = userp;
 
-        assert(u);
+        assert(answer);
 
         log_debug("The server answers (%zu bytes): %.*s",
                   size*nmemb, (int)(size*nmemb), buf);
 
-        if (nmemb && !u->answer) {
-                u->answer = strndup(buf, size*nmemb);
-                if (!u->answer)
+        if (nmemb && !*answer) {
+                *answer = strndup(buf, size*nmemb);
+                if (!*answer)
                         log_warning("Failed to store server answer (%zu bytes): out of memory", size*nmemb);
         }
 
@@ -134,7 +136,8 @@ static int update_cursor_state(Uploader *u) {
                 "LAST_CURSOR=%s\n",
                 u->last_cursor);
 
-        r = fflush_and_check(f);
+        /* Make sure the new state is on disk before it replaces the old one */
+        r = fflush_sync_and_check(f);
         if (r < 0)
                 goto fail;
 
@@ -172,104 +175,144 @@ static int load_cursor_state(Uploader *u) {
         return 0;
 }
 
-int start_upload(Uploader *u,
-                 size_t (*input_callback)(void *ptr,
-                                          size_t size,
-                                          size_t nmemb,
-                                          void *userdata),
-                 void *data) {
+static int setup_header(Uploader *u) {
+        _cleanup_(curl_slist_free_allp) struct curl_slist *h = NULL;
+        struct curl_slist *l;
+
+        assert(u);
+
+        if (u->header)
+                return 0;
+
+        h = curl_slist_append(NULL, u->batch ? "Content-Type: " JOURNAL_BATCH_CONTENT_TYPE
+                                             : "Content-Type: application/vnd.fdo.journal");
+        if (!h)
+                return log_oom();
+
+        l = curl_slist_append(h, "Transfer-Encoding: chunked");
+        if (!l)
+                return log_oom();
+        h = l;
+
+        l = curl_slist_append(h, "Accept: text/plain");
+        if (!l)
+                return log_oom();
+        h = l;
+
+        u->header = TAKE_PTR(h);
+        return 0;
+}
+
+static int setup_easy(
+                Uploader *u,
+                size_t (*input_callback)(void *ptr,
+                                         size_t size,
+                                         size_t nmemb,
+                                         void *userdata),
+                void *data,
+                char **answer,
+                char *error,
+                CURL **ret) {
+
+        _cleanup_(curl_easy_cleanupp) CURL *curl = NULL;
         CURLcode code;
+        int r;
 
         assert(u);
         assert(input_callback);
+        assert(answer);
+        assert(error);
+        assert(ret);
 
-        if (!u->header) {
-                _cleanup_(curl_slist_free_allp) struct curl_slist *h = NULL;
-                struct curl_slist *l;
+        r = setup_header(u);
+        if (r < 0)
+                return r;
 
-                h = curl_slist_append(NULL, "Content-Type: application/vnd.fdo.journal");
-                if (!h)
-                        return log_oom();
+        curl = curl_easy_init();
+        if (!curl)
+                return log_error_errno(SYNTHETIC_ERRNO(ENOSR),
+                                       "Call to curl_easy_init failed.");
 
-                l = curl_slist_append(h, "Transfer-Encoding: chunked");
-                if (!l)
-                        return log_oom();
-                h = l;
+        /* If configured, set a timeout for the curl operation. */
+        if (arg_network_timeout_usec != USEC_INFINITY)
+                easy_setopt(curl, CURLOPT_TIMEOUT,
+                            (long) DIV_ROUND_UP(arg_network_timeout_usec, USEC_PER_SEC),
+                            LOG_ERR, return -EXFULL);
 
-                l = curl_slist_append(h, "Accept: text/plain");
-                if (!l)
-                        return log_oom();
-                h = l;
+        /* tell it to POST to the URL */
+        easy_setopt(curl, CURLOPT_POST, 1L,
+                    LOG_ERR, return -EXFULL);
 
-                u->header = TAKE_PTR(h);
-        }
+        easy_setopt(curl, CURLOPT_ERRORBUFFER, error,
+                    LOG_ERR, return -EXFULL);
 
-        if (!u->easy) {
-                _cleanup_(curl_easy_cleanupp) CURL *curl = NULL;
+        /* set where to write to */
+        easy_setopt(curl, CURLOPT_WRITEFUNCTION, output_callback,
+                    LOG_ERR, return -EXFULL);
 
-                curl = curl_easy_init();
-                if (!curl)
-                        return log_error_errno(SYNTHETIC_ERRNO(ENOSR),
-                                               "Call to curl_easy_init failed.");
+        easy_setopt(curl, CURLOPT_WRITEDATA, answer,
+                    LOG_ERR, return -EXFULL);
 
-                /* If configured, set a timeout for the curl operation. */
-                if (arg_network_timeout_usec != USEC_INFINITY)
-                        easy_setopt(curl, CURLOPT_TIMEOUT,
-                                    (long) DIV_ROUND_UP(arg_network_timeout_usec, USEC_PER_SEC),
-                                    LOG_ERR, return -EXFULL);
+        /* set where to read from */
+        easy_setopt(curl, CURLOPT_READFUNCTION, input_callback,
+                    LOG_ERR, return -EXFULL);
 
-                /* tell it to POST to the URL */
-                easy_setopt(curl, CURLOPT_POST, 1L,
-                            LOG_ERR, return -EXFULL);
+        easy_setopt(curl, CURLOPT_READDATA, data,
+                    LOG_ERR, return -EXFULL);
 
-                easy_setopt(curl, CURLOPT_ERRORBUFFER, u->error,
-                            LOG_ERR, return -EXFULL);
+        /* use our special own mime type and chunked transfer */
+        easy_setopt(curl, CURLOPT_HTTPHEADER, u->header,
+                    LOG_ERR, return -EXFULL);
 
-                /* set where to write to */
-                easy_setopt(curl, CURLOPT_WRITEFUNCTION, output_callback,
-                            LOG_ERR, return -EXFULL);
+        if (DEBUG_LOGGING)
+                /* enable verbose for easier tracing */
+                easy_setopt(curl, CURLOPT_VERBOSE, 1L, LOG_WARNING, );
 
-                easy_setopt(curl, CURLOPT_WRITEDATA, data,
-                            LOG_ERR, return -EXFULL);
+        easy_setopt(curl, CURLOPT_USERAGENT,
+                    "systemd-journal-upload " GIT_VERSION,
+                    LOG_WARNING, );
 
-                /* set where to read from */
-                easy_setopt(curl, CURLOPT_READFUNCTION, input_callback,
+        if (!streq_ptr(arg_key, "-") && (arg_key || startswith(u->url, "https://"))) {
+                easy_setopt(curl, CURLOPT_SSLKEY, arg_key ?: PRIV_KEY_FILE,
                             LOG_ERR, return -EXFULL);
-
-                easy_setopt(curl, CURLOPT_READDATA, data,
+                easy_setopt(curl, CURLOPT_SSLCERT, arg_cert ?: CERT_FILE,
                             LOG_ERR, return -EXFULL);
+        }
 
-                /* use our special own mime type and chunked transfer */
-                easy_setopt(curl, CURLOPT_HTTPHEADER, u->header,
+        if (STRPTR_IN_SET(arg_trust, "-", "all"))
+                easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0,
+                            LOG_ERR, return -EUCLEAN);
+        else if (arg_trust || startswith(u->url, "https://"))
+                easy_setopt(curl, CURLOPT_CAINFO, arg_trust ?: TRUST_FILE,
                             LOG_ERR, return -EXFULL);
 
-                if (DEBUG_LOGGING)
-                        /* enable verbose for easier tracing */
-                        easy_setopt(curl, CURLOPT_VERBOSE, 1L, LOG_WARNING, );
-
-                easy_setopt(curl, CURLOPT_USERAGENT,
-                            "systemd-journal-upload " GIT_VERSION,
+        if (arg_key || arg_trust)
+                easy_setopt(curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1,
                             LOG_WARNING, );
 
-                if (!streq_ptr(arg_key, "-") && (arg_key || startswith(u->url, "https://"))) {
-                        easy_setopt(curl, CURLOPT_SSLKEY, arg_key ?: PRIV_KEY_FILE,
-                                    LOG_ERR, return -EXFULL);
-                        easy_setopt(curl, CURLOPT_SSLCERT, arg_cert ?: CERT_FILE,
-                                    LOG_ERR, return -EXFULL);
-                }
+        /* upload to this place */
+        easy_setopt(curl, CURLOPT_URL, u->url,
+                    LOG_ERR, return -EXFULL);
 
-                if (STRPTR_IN_SET(arg_trust, "-", "all"))
-                        easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0,
-                                    LOG_ERR, return -EUCLEAN);
-                else if (arg_trust || startswith(u->url, "https://"))
-                        easy_setopt(curl, CURLOPT_CAINFO, arg_trust ?: TRUST_FILE,
-                                    LOG_ERR, return -EXFULL);
+        *ret = TAKE_PTR(curl);
+        return 0;
+}
+
+int start_upload(Uploader *u,
+                 size_t (*input_callback)(void *ptr,
+                                          size_t size,
+                                          size_t nmemb,
+                                          void *userdata),
+                 void *data) {
+        int r;
 
-                if (arg_key || arg_trust)
-                        easy_setopt(curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1,
-                                    LOG_WARNING, );
+        assert(u);
+        assert(input_callback);
 
-                u->easy = TAKE_PTR(curl);
+        if (!u->easy) {
+                r = setup_easy(u, input_callback, data, &u->answer, u->error, &u->easy);
+                if (r < 0)
+                        return r;
         } else {
                 /* truncate the potential old error message */
                 u->error[0] = '\0';
@@ -278,15 +321,98 @@ int start_upload(Uploader *u,
                 u->answer = 0;
         }
 
-        /* upload to this place */
-        code = curl_easy_setopt(u->easy, CURLOPT_URL, u->url);
-        if (code)
+        u->uploading = true;
+
+        return 0;
+}
+
+static UploadRequest* upload_request_free(UploadRequest *req) {
+        if (!req)
+                return NULL;
+
+        if (req->uploader) {
+                if (req->easy && req->uploader->multi)
+                        (void) curl_multi_remove_handle(req->uploader->multi, req->easy);
+
+                LIST_REMOVE(requests, req->uploader->requests, req);
+                if (req->uploader->requests_tail == req)
+                        req->uploader->requests_tail = req->requests_prev;
+                req->uploader->n_requests--;
+        }
+
+        curl_easy_cleanup(req->easy);
+        free(req->answer);
+        free(req->body);
+        free(req->cursor);
+
+        return mfree(req);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(UploadRequest*, upload_request_free);
+
+static size_t request_input_callback(void *buf, size_t size, size_t nmemb, void *userp) {
+        UploadRequest *req = userp;
+        size_t n;
+
+        assert(req);
+
+        n = MIN(size * nmemb, req->body_size - req->body_pos);
+        memcpy(buf, req->body + req->body_pos, n);
+        req->body_pos += n;
+
+        return n;
+}
+
+int start_upload_request(Uploader *u, char *body, size_t body_size, char *cursor) {
+        _cleanup_(upload_request_freep) UploadRequest *req = NULL;
+        CURLMcode mc;
+        int r;
+
+        assert(u);
+
+        /* Takes ownership of body and cursor in any case */
+
+        req = new(UploadRequest, 1);
+        if (!req) {
+                free(body);
+                free(cursor);
+                return log_oom();
+        }
+
+        *req = (UploadRequest) {
+                .body = body,
+                .body_size = body_size,
+                .cursor = cursor,
+        };
+
+        r = setup_easy(u, request_input_callback, req, &req->answer, req->error, &req->easy);
+        if (r < 0)
+                return r;
+
+        if (curl_easy_setopt(req->easy, CURLOPT_PRIVATE, req) != CURLE_OK)
+                return log_error_errno(SYNTHETIC_ERRNO(EXFULL), "curl_easy_setopt CURLOPT_PRIVATE failed.");
+
+        if (!u->multi) {
+                u->multi = curl_multi_init();
+                if (!u->multi)
+                        return log_error_errno(SYNTHETIC_ERRNO(ENOSR),
+                                               "Call to curl_multi_init failed.");
+        }
+
+        mc = curl_multi_add_handle(u->multi, req->easy);
+        if (mc != CURLM_OK)
                 return log_error_errno(SYNTHETIC_ERRNO(EXFULL),
-                                       "curl_easy_setopt CURLOPT_URL failed: %s",
-                                       curl_easy_strerror(code));
+                                       "Failed to add request: %s", curl_multi_strerror(mc));
 
-        u->uploading = true;
+        req->uploader = u;
+        LIST_INSERT_AFTER(requests, u->requests, u->requests_tail, req);
+        u->requests_tail = req;
+        u->n_requests++;
+
+        log_debug("Queued request of %zu bytes up to cursor %s, %u requests in flight.",
+                  body_size, strna(req->cursor), u->n_requests);
 
+        TAKE_PTR(req);
         return 0;
 }
 
@@ -424,6 +550,7 @@ static int setup_uploader(Uploader *u, const char *url, const char *state_file)
 
         *u = (Uploader) {
                 .input = -1,
+                .batch_encoder = JOURNAL_BATCH_ENCODER_INIT(true),
         };
 
         host = STARTSWITH_SET(url, "http://", "https://");
@@ -473,6 +600,13 @@ static void destroy_uploader(Uploader *u) {
         free(u->last_cursor);
         free(u->current_cursor);
 
+        while (u->requests)
+                upload_request_free(u->requests);
+        curl_multi_cleanup(u->multi);
+
+        journal_batch_encoder_done(&u->batch_encoder);
+        free(u->batch_frame);
+
         free(u->url);
 
         u->input_event = sd_event_source_unref(u->input_event);
@@ -485,25 +619,24 @@ static void destroy_uploader(Uploader *u) {
         sd_event_unref(u->events);
 }
 
-static int perform_upload(Uploader *u) {
-        CURLcode code;
+static int check_upload_result(Uploader *u, CURL *easy, CURLcode code, const char *error, const char *answer) {
         long status;
 
         assert(u);
+        assert(easy);
+        assert(error);
 
-        u->watchdog_timestamp = now(CLOCK_MONOTONIC);
-        code = curl_easy_perform(u->easy);
         if (code) {
-                if (u->error[0])
+                if (error[0])
                         log_error("Upload to %s failed: %.*s",
-                                  u->url, (int) sizeof(u->error), u->error);
+                                  u->url, (int) CURL_ERROR_SIZE, error);
                 else
                         log_error("Upload to %s failed: %s",
                                   u->url, curl_easy_strerror(code));
                 return -EIO;
         }
 
-        code = curl_easy_getinfo(u->easy, CURLINFO_RESPONSE_CODE, &status);
+        code = curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
         if (code)
                 return log_error_errno(SYNTHETIC_ERRNO(EUCLEAN),
                                        "Failed to retrieve response code: %s",
@@ -512,14 +645,97 @@ static int perform_upload(Uploader *u) {
         if (status >= 300)
                 return log_error_errno(SYNTHETIC_ERRNO(EIO),
                                        "Upload to %s failed with code %ld: %s",
-                                       u->url, status, strna(u->answer));
+                                       u->url, status, strna(answer));
         else if (status < 200)
                 return log_error_errno(SYNTHETIC_ERRNO(EIO),
                                        "Upload to %s finished with unexpected code %ld: %s",
-                                       u->url, status, strna(u->answer));
+                                       u->url, status, strna(answer));
         else
                 log_debug("Upload finished successfully with code %ld: %s",
-                          status, strna(u->answer));
+                          status, strna(answer));
+
+        return 0;
+}
+
+static int perform_requests(Uploader *u) {
+        bool finished = false, advanced = false;
+        int r;
+
+        assert(u);
+        assert(u->multi);
+
+        /* Run the transfers until at least one of them is done, so that the caller can queue more */
+        while (!finished) {
+                CURLMcode mc;
+                CURLMsg *msg;
+                int running, n;
+
+                mc = curl_multi_perform(u->multi, &running);
+                if (mc != CURLM_OK)
+                        return log_error_errno(SYNTHETIC_ERRNO(EIO),
+                                               "Failed to run transfers: %s", curl_multi_strerror(mc));
+
+                while ((msg = curl_multi_info_read(u->multi, &n))) {
+                        UploadRequest *req;
+
+                        if (msg->msg != CURLMSG_DONE)
+                                continue;
+
+                        assert_se(curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**) &req) == CURLE_OK);
+
+                        r = check_upload_result(u, req->easy, msg->data.result, req->error, req->answer);
+                        if (r < 0)
+                                return r;
+
+                        req->done = true;
+                        finished = true;
+                }
+
+                if (finished || running == 0)
+                        break;
+
+                mc = curl_multi_wait(u->multi, NULL, 0, 1000, NULL);
+                if (mc != CURLM_OK)
+                        return log_error_errno(SYNTHETIC_ERRNO(EIO),
+                                               "Failed to wait for transfers: %s", curl_multi_strerror(mc));
+        }
+
+        /* The server acknowledges requests in any order, but the saved cursor must not move past entries
+         * that are still in flight. */
+        while (u->requests && u->requests->done) {
+                UploadRequest *req = u->requests;
+
+                if (req->cursor)
+                        free_and_replace(u->last_cursor, req->cursor);
+                advanced = true;
+
+                upload_request_free(req);
+        }
+
+        u->uploading = u->n_requests > 0;
+
+        if (!advanced)
+                return 0;
+
+        return update_cursor_state(u);
+}
+
+static int perform_upload(Uploader *u) {
+        CURLcode code;
+        int r;
+
+        assert(u);
+
+        u->watchdog_timestamp = now(CLOCK_MONOTONIC);
+
+        if (upload_pipelined(u))
+                return perform_requests(u);
+
+        code = curl_easy_perform(u->easy);
+
+        r = check_upload_result(u, u->easy, code, u->error, u->answer);
+        if (r < 0)
+                return r;
 
         free_and_replace(u->last_cursor, u->current_cursor);
 
@@ -573,6 +789,8 @@ static int parse_config(void) {
                 { "Upload",  "ServerCertificateFile",  config_parse_path_or_ignore, 0, &arg_cert                 },
                 { "Upload",  "TrustedCertificateFile", config_parse_path_or_ignore, 0, &arg_trust                },
                 { "Upload",  "NetworkTimeoutSec",      config_parse_sec,            0, &arg_network_timeout_usec },
+                { "Upload",  "Batch",                  config_parse_bool,           0, &arg_batch                },
+                { "Upload",  "RequestsInFlight",       config_parse_unsigned,       0, &arg_requests_in_flight   },
                 {}
         };
 
@@ -617,6 +835,8 @@ static int help(void) {
                "     --follow[=BOOL]        Do [not] wait for input\n"
                "     --save-state[=FILE]    Save uploaded cursors (default \n"
                "                            " STATE_FILE ")\n"
+               "     --batch[=BOOL]         Upload journal entries in the binary batch format\n"
+               "     --requests-in-flight=N Keep up to N requests with journal entries in flight\n"
                "\nSee the %s for details.\n",
                program_invocation_short_name,
                link);
@@ -637,6 +857,8 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_AFTER_CURSOR,
                 ARG_FOLLOW,
                 ARG_SAVE_STATE,
+                ARG_BATCH,
+                ARG_REQUESTS_IN_FLIGHT,
         };
 
         static const struct option options[] = {
@@ -656,6 +878,8 @@ static int parse_argv(int argc, char *argv[]) {
                 { "after-cursor", required_argument, NULL, ARG_AFTER_CURSOR   },
                 { "follow",       optional_argument, NULL, ARG_FOLLOW         },
                 { "save-state",   optional_argument, NULL, ARG_SAVE_STATE     },
+                { "batch",        optional_argument, NULL, ARG_BATCH          },
+                { "requests-in-flight", required_argument, NULL, ARG_REQUESTS_IN_FLIGHT },
                 {}
         };
 
@@ -768,6 +992,18 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_save_state = optarg ?: STATE_FILE;
                         break;
 
+                case ARG_BATCH:
+                        r = parse_boolean_argument("--batch", optarg, &arg_batch);
+                        if (r < 0)
+                                return r;
+                        break;
+
+                case ARG_REQUESTS_IN_FLIGHT:
+                        r = safe_atou(optarg, &arg_requests_in_flight);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --requests-in-flight= value: %s", optarg);
+                        break;
+
                 case '?':
                         return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                "Unknown option %s.",
@@ -790,6 +1026,10 @@ static int parse_argv(int argc, char *argv[]) {
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Options --key and --cert must be used together.");
 
+        if (arg_requests_in_flight == 0)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "At least one request must be allowed in flight.");
+
         if (optind < argc && (arg_directory || arg_file || arg_machine || arg_journal_type))
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Input arguments make no sense with journal input.");
@@ -859,6 +1099,11 @@ static int run(int argc, char **argv) {
                 r = open_journal(&j);
                 if (r < 0)
                         return r;
+
+                /* The batch format and pipelining are only used with journal input, other input is
+                 * streamed as is */
+                u.batch = arg_batch;
+                u.max_requests = arg_requests_in_flight;
                 r = open_journal_for_upload(&u, j,
                                             arg_cursor ?: u.last_cursor,
                                             arg_cursor ? arg_after_cursor : true,
@@ -879,10 +1124,10 @@ static int run(int argc, char **argv) {
                         return 0;
 
                 if (use_journal) {
-                        if (!u.journal)
+                        if (!u.journal && u.n_requests == 0)
                                 return 0;
 
-                        r = check_journal_input(&u);
+                        r = u.journal ? check_journal_input(&u) : 0;
                 } else if (u.input < 0 && !use_journal) {
                         if (optind >= argc)
                                 return 0;
@@ -899,7 +1144,8 @@ static int run(int argc, char **argv) {
                                 return r;
                 }
 
-                r = sd_event_run(u.events, u.timeout);
+                /* Don't wait for journal changes if requests are in flight or entries are left over */
+                r = sd_event_run(u.events, u.n_requests > 0 || u.more_pending ? 0 : u.timeout);
                 if (r < 0)
                         return log_error_errno(r, "Failed to run event loop: %m");
         }
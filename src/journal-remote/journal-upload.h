@@ -7,6 +7,8 @@
 #include "sd-event.h"
 #include "sd-journal.h"
 
+#include "journal-batch.h"
+#include "list.h"
 #include "time-util.h"
 
 typedef enum {
@@ -23,7 +25,32 @@ typedef enum {
         ENTRY_DONE,                 /* Need to move to a new field. */
 } entry_state;
 
-typedef struct Uploader {
+/* Cut requests with journal input at entry boundaries after this many entries or bytes, so that the
+ * cursor is checkpointed regularly while uploading a backlog */
+#define UPLOAD_REQUEST_ENTRIES_MAX 4096U
+#define UPLOAD_REQUEST_SIZE_MAX (8U*1024U*1024U)
+
+typedef struct Uploader Uploader;
+typedef struct UploadRequest UploadRequest;
+
+/* A request with a prepared body, for keeping several requests in flight */
+struct UploadRequest {
+        Uploader *uploader;
+
+        CURL *easy;
+        char error[CURL_ERROR_SIZE];
+        char *answer;
+
+        char *body;
+        size_t body_size, body_pos;
+
+        char *cursor;              /* The cursor of the last entry in the body */
+        bool done;
+
+        LIST_FIELDS(UploadRequest, requests);
+};
+
+struct Uploader {
         sd_event *events;
         sd_event_source *sigint_event, *sigterm_event;
 
@@ -47,6 +74,12 @@ typedef struct Uploader {
         const void *field_data;
         size_t field_pos, field_length;
 
+        /* batch format stuff */
+        bool batch;
+        JournalBatchEncoder batch_encoder;
+        uint8_t *batch_frame;
+        size_t batch_frame_size, batch_frame_pos;
+
         /* general metrics */
         const char *state_file;
 
@@ -54,7 +87,18 @@ typedef struct Uploader {
         char *last_cursor, *current_cursor;
         usec_t watchdog_timestamp;
         usec_t watchdog_usec;
-} Uploader;
+
+        /* request limits */
+        size_t request_entries, request_size;
+        bool more_pending;         /* The last request was cut by the limits, don't wait for the journal */
+
+        /* pipelining, only with journal input */
+        unsigned max_requests;
+        CURLM *multi;
+        LIST_HEAD(UploadRequest, requests);
+        UploadRequest *requests_tail;
+        unsigned n_requests;
+};
 
 #define JOURNAL_UPLOAD_POLL_TIMEOUT (10 * USEC_PER_SEC)
 
@@ -65,6 +109,12 @@ int start_upload(Uploader *u,
                                           void *userdata),
                  void *data);
 
+int start_upload_request(Uploader *u, char *body, size_t body_size, char *cursor);
+
+static inline bool upload_pipelined(const Uploader *u) {
+        return u->max_requests > 1;
+}
+
 int open_journal_for_upload(Uploader *u,
                             sd_journal *j,
                             const char *cursor,
@@ -28,8 +28,10 @@
 #include "bus-util.h"
 #include "catalog.h"
 #include "chattr-util.h"
+#include "cpu-set-util.h"
 #include "def.h"
 #include "dissect-image.h"
+#include "exit-status.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "format-util.h"
@@ -58,6 +60,7 @@
 #include "path-util.h"
 #include "pcre2-dlopen.h"
 #include "pretty-print.h"
+#include "process-util.h"
 #include "qrcode-util.h"
 #include "random-util.h"
 #include "rlimit-util.h"
@@ -129,6 +132,7 @@ static uint64_t arg_vacuum_size = 0;
 static uint64_t arg_vacuum_n_files = 0;
 static usec_t arg_vacuum_time = 0;
 static char **arg_output_fields = NULL;
+static unsigned arg_threads = 0;
 #if HAVE_PCRE2
 static const char *arg_pattern = NULL;
 static pcre2_code *arg_compiled_pattern = NULL;
@@ -152,6 +156,7 @@ static enum {
         ACTION_ROTATE,
         ACTION_VACUUM,
         ACTION_ROTATE_AND_VACUUM,
+        ACTION_COMPACT,
         ACTION_LIST_FIELDS,
         ACTION_LIST_FIELD_NAMES,
 } arg_action = ACTION_SHOW;
@@ -365,6 +370,7 @@ static int help(void) {
                "                               json, json-pretty, json-sse, json-seq, cat,\n"
                "                               with-unit)\n"
                "     --output-fields=LIST    Select fields to print in verbose/export/json modes\n"
+               "     --threads=N             Format json output on N threads\n"
                "     --utc                   Express time in Coordinated Universal Time (UTC)\n"
                "  -x --catalog               Add message explanations where available\n"
                "     --no-full               Ellipsize fields\n"
@@ -390,6 +396,8 @@ static int help(void) {
                "     --vacuum-size=BYTES     Reduce disk usage below specified size\n"
                "     --vacuum-files=INT      Leave only the specified number of journal files\n"
                "     --vacuum-time=TIME      Remove journal files older than specified time\n"
+               "     --compact               Rewrite archived journal files with only the\n"
+               "                             matching entries\n"
                "     --verify                Verify journal file consistency\n"
                "     --sync                  Synchronize unwritten journal messages to disk\n"
                "     --relinquish-var        Stop logging to disk, log to temporary file system\n"
@@ -452,8 +460,10 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_VACUUM_SIZE,
                 ARG_VACUUM_FILES,
                 ARG_VACUUM_TIME,
+                ARG_COMPACT,
                 ARG_NO_HOSTNAME,
                 ARG_OUTPUT_FIELDS,
+                ARG_THREADS,
                 ARG_NAMESPACE,
         };
 
@@ -519,8 +529,10 @@ static int parse_argv(int argc, char *argv[]) {
                 { "vacuum-size",          required_argument, NULL, ARG_VACUUM_SIZE          },
                 { "vacuum-files",         required_argument, NULL, ARG_VACUUM_FILES         },
                 { "vacuum-time",          required_argument, NULL, ARG_VACUUM_TIME          },
+                { "compact",              no_argument,       NULL, ARG_COMPACT              },
                 { "no-hostname",          no_argument,       NULL, ARG_NO_HOSTNAME          },
                 { "output-fields",        required_argument, NULL, ARG_OUTPUT_FIELDS        },
+                { "threads",              required_argument, NULL, ARG_THREADS              },
                 { "namespace",            required_argument, NULL, ARG_NAMESPACE            },
                 {}
         };
@@ -781,6 +793,10 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = arg_action == ACTION_ROTATE ? ACTION_ROTATE_AND_VACUUM : ACTION_VACUUM;
                         break;
 
+                case ARG_COMPACT:
+                        arg_action = ACTION_COMPACT;
+                        break;
+
 #if HAVE_GCRYPT
                 case ARG_FORCE:
                         arg_force = true;
@@ -1042,6 +1058,12 @@ static int parse_argv(int argc, char *argv[]) {
                         break;
                 }
 
+                case ARG_THREADS:
+                        r = safe_atou(optarg, &arg_threads);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse number of threads: %s", optarg);
+                        break;
+
                 case '?':
                         return -EINVAL;
 
@@ -1068,11 +1090,24 @@ static int parse_argv(int argc, char *argv[]) {
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Please specify either --reverse= or --follow=, not both.");
 
-        if (!IN_SET(arg_action, ACTION_SHOW, ACTION_DUMP_CATALOG, ACTION_LIST_CATALOG) && optind < argc)
+        if (!IN_SET(arg_action, ACTION_SHOW, ACTION_COMPACT, ACTION_DUMP_CATALOG, ACTION_LIST_CATALOG) && optind < argc)
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Extraneous arguments starting with '%s'",
                                        argv[optind]);
 
+        if (arg_action == ACTION_COMPACT && (arg_file_stdin || arg_machine))
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "--compact cannot be combined with --file=- or --machine=.");
+
+        if (arg_action == ACTION_COMPACT &&
+            (arg_since_set || arg_until_set || arg_cursor || arg_after_cursor
+#if HAVE_PCRE2
+             || arg_pattern
+#endif
+            ))
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "--compact only supports field matches, --boot=, --unit=, --identifier=, --priority=, --facility= and --dmesg.");
+
         if ((arg_boot || arg_action == ACTION_LIST_BOOTS) && arg_merge)
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Using --boot or --list-boots with --merge is not supported.");
@@ -1989,48 +2024,232 @@ static int setup_keys(void) {
 #endif
 }
 
-static int verify(sd_journal *j) {
+static int add_filters(sd_journal *j, char **matches) {
+        int r;
+
+        assert(j);
+
+        /* add_boot() must be called first!
+         * It may need to seek the journal to find parent boot IDs. */
+        r = add_boot(j);
+        if (r < 0)
+                return r;
+
+        r = add_dmesg(j);
+        if (r < 0)
+                return r;
+
+        r = add_units(j);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add filter for units: %m");
+
+        r = add_syslog_identifier(j);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add filter for syslog identifiers: %m");
+
+        r = add_priorities(j);
+        if (r < 0)
+                return r;
+
+        r = add_facilities(j);
+        if (r < 0)
+                return r;
+
+        return add_matches(j, matches);
+}
+
+static int compact(sd_journal *j, char **matches) {
+        _cleanup_strv_free_ char **paths = NULL;
+        JournalFile *f;
+        char **p;
         int r = 0;
+
+        assert(j);
+
+        /* Each file is compacted through its own sd_journal instance carrying the same filter as we'd
+         * use for showing the entries, hence exactly what would be shown is kept. */
+        ORDERED_HASHMAP_FOREACH(f, j->files) {
+                if (f->header->state != STATE_ARCHIVED) {
+                        log_debug("Not compacting %s, it is not archived.", f->path);
+                        continue;
+                }
+
+                if (JOURNAL_HEADER_SEALED(f->header)) {
+                        log_notice("Not compacting %s, it is sealed.", f->path);
+                        continue;
+                }
+
+                if (strv_extend(&paths, f->path) < 0)
+                        return log_oom();
+        }
+
+        STRV_FOREACH(p, paths) {
+                _cleanup_(sd_journal_closep) sd_journal *k = NULL;
+                int q;
+
+                q = sd_journal_open_files(&k, (const char**) STRV_MAKE(*p), 0);
+                if (q < 0) {
+                        r = log_error_errno(q, "Failed to open %s: %m", *p);
+                        continue;
+                }
+
+                q = add_filters(k, matches);
+                if (q < 0)
+                        return q;
+
+                q = journal_compact_file(k, !arg_quiet);
+                if (q < 0 && r >= 0)
+                        r = log_error_errno(q, "Failed to compact %s: %m", *p);
+        }
+
+        return r;
+}
+
+static int verify_one(JournalFile *f, bool show_progress) {
+        usec_t first = 0, validated = 0, last = 0;
+        int r;
+
+        assert(f);
+
+#if HAVE_GCRYPT
+        if (!arg_verify_key && JOURNAL_HEADER_SEALED(f->header))
+                log_notice("Journal file %s has sealing enabled but verification key has not been passed using --verify-key=.", f->path);
+#endif
+
+        r = journal_file_verify(f, arg_verify_key, &first, &validated, &last, show_progress);
+        if (r == -EINVAL)
+                /* If the key was invalid give up right-away. */
+                return r;
+        if (r < 0)
+                return log_warning_errno(r, "FAIL: %s (%m)", f->path);
+
+        log_info("PASS: %s", f->path);
+
+        if (arg_verify_key && JOURNAL_HEADER_SEALED(f->header)) {
+                char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX];
+
+                if (validated > 0) {
+                        log_info("=> Validated from %s to %s, final %s entries not sealed.",
+                                 format_timestamp_maybe_utc(a, sizeof(a), first),
+                                 format_timestamp_maybe_utc(b, sizeof(b), validated),
+                                 FORMAT_TIMESPAN(last > validated ? last - validated : 0, 0));
+                } else if (last > 0)
+                        log_info("=> No sealing yet, %s of entries not sealed.",
+                                 FORMAT_TIMESPAN(last - first, 0));
+                else
+                        log_info("=> No sealing yet, no entries in file.");
+        }
+
+        return 0;
+}
+
+static int verify_wait(pid_t pid, const char *path) {
+        int r;
+
+        assert(pid > 0);
+        assert(path);
+
+        r = wait_for_terminate_and_check(path, pid, 0);
+        if (r < 0)
+                return log_warning_errno(r, "FAIL: %s (%m)", path);
+        if (r == EXIT_INVALIDARGUMENT)
+                return -EINVAL;
+        if (r == EXIT_FAILURE)
+                return -EBADMSG; /* The worker already logged about it */
+        if (r != EXIT_SUCCESS)
+                return log_warning_errno(SYNTHETIC_ERRNO(EPROTO), "FAIL: %s (verification worker failed)", path);
+
+        return 0;
+}
+
+static int verify(sd_journal *j) {
+        _cleanup_free_ pid_t *pids = NULL;
+        _cleanup_free_ const char **paths = NULL;
+        size_t n_files, n_workers, n_running = 0, n_verified = 0;
+        uint64_t size = 0;
+        usec_t begin_usec, elapsed_usec;
         JournalFile *f;
+        int r = 0, k;
 
         assert(j);
 
         log_show_color(true);
 
+        /* The files are independent of each other, hence if there are multiple of them verify them in
+         * parallel, one worker process per CPU. The progress bar is only drawn when a single file is verified
+         * at a time, since the workers would only garble each other's output. */
+        n_files = ordered_hashmap_size(j->files);
+        k = cpus_in_affinity_mask();
+        n_workers = k > 0 ? MIN((size_t) k, n_files) : 1;
+
+        if (n_workers > 1) {
+                pids = new(pid_t, n_workers);
+                paths = new(const char*, n_workers);
+                if (!pids || !paths)
+                        return log_oom();
+        }
+
+        begin_usec = now(CLOCK_MONOTONIC);
+
         ORDERED_HASHMAP_FOREACH(f, j->files) {
-                int k;
-                usec_t first = 0, validated = 0, last = 0;
+                size += f->last_stat.st_size;
+                n_verified++;
+
+                if (n_workers <= 1) {
+                        k = verify_one(f, true);
+                        if (k == -EINVAL)
+                                return k;
+                        if (k < 0)
+                                r = k;
+                        continue;
+                }
 
-#if HAVE_GCRYPT
-                if (!arg_verify_key && JOURNAL_HEADER_SEALED(f->header))
-                        log_notice("Journal file %s has sealing enabled but verification key has not been passed using --verify-key=.", f->path);
-#endif
+                if (n_running >= n_workers) {
+                        /* Wait for the oldest worker to make room for the next one */
+                        k = verify_wait(pids[0], paths[0]);
+                        memmove(pids, pids + 1, (n_running - 1) * sizeof(pid_t));
+                        memmove(paths, paths + 1, (n_running - 1) * sizeof(const char*));
+                        n_running--;
 
-                k = journal_file_verify(f, arg_verify_key, &first, &validated, &last, true);
-                if (k == -EINVAL)
-                        /* If the key was invalid give up right-away. */
-                        return k;
-                else if (k < 0)
-                        r = log_warning_errno(k, "FAIL: %s (%m)", f->path);
-                else {
-                        char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX];
-                        log_info("PASS: %s", f->path);
-
-                        if (arg_verify_key && JOURNAL_HEADER_SEALED(f->header)) {
-                                if (validated > 0) {
-                                        log_info("=> Validated from %s to %s, final %s entries not sealed.",
-                                                 format_timestamp_maybe_utc(a, sizeof(a), first),
-                                                 format_timestamp_maybe_utc(b, sizeof(b), validated),
-                                                 FORMAT_TIMESPAN(last > validated ? last - validated : 0, 0));
-                                } else if (last > 0)
-                                        log_info("=> No sealing yet, %s of entries not sealed.",
-                                                 FORMAT_TIMESPAN(last - first, 0));
-                                else
-                                        log_info("=> No sealing yet, no entries in file.");
+                        if (k == -EINVAL) {
+                                r = k;
+                                break;
                         }
+                        if (k < 0)
+                                r = k;
                 }
+
+                k = safe_fork("(journal-verify)", FORK_RESET_SIGNALS|FORK_DEATHSIG|FORK_LOG, pids + n_running);
+                if (k < 0) {
+                        r = k;
+                        break;
+                }
+                if (k == 0) {
+                        /* Child */
+                        k = verify_one(f, false);
+                        _exit(k == -EINVAL ? EXIT_INVALIDARGUMENT : k < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+                }
+
+                paths[n_running++] = f->path;
         }
 
+        for (size_t i = 0; i < n_running; i++) {
+                k = verify_wait(pids[i], paths[i]);
+                if (k < 0 && r != -EINVAL)
+                        r = k;
+        }
+
+        if (r == -EINVAL)
+                return r;
+
+        elapsed_usec = usec_sub_unsigned(now(CLOCK_MONOTONIC), begin_usec);
+
+        log_info("Verified %zu journal files (%s) in %s, %s/s.",
+                 n_verified,
+                 FORMAT_BYTES(size),
+                 FORMAT_TIMESPAN(elapsed_usec, USEC_PER_MSEC),
+                 FORMAT_BYTES((uint64_t) ((double) size * USEC_PER_SEC / MAX(elapsed_usec, (usec_t) 1))));
+
         return r;
 }
 
@@ -2121,6 +2340,7 @@ int main(int argc, char *argv[]) {
         bool previous_boot_id_valid = false, first_line = true, ellipsized = false, need_seek = false;
         bool use_cursor = false, after_cursor = false;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_(output_pipeline_freep) OutputPipeline *pipeline = NULL;
         sd_id128_t previous_boot_id;
         int n_shown = 0, r, poll_fd = -1;
 
@@ -2223,6 +2443,7 @@ int main(int argc, char *argv[]) {
         case ACTION_LIST_BOOTS:
         case ACTION_VACUUM:
         case ACTION_ROTATE_AND_VACUUM:
+        case ACTION_COMPACT:
         case ACTION_LIST_FIELDS:
         case ACTION_LIST_FIELD_NAMES:
                 /* These ones require access to the journal files, continue below. */
@@ -2363,6 +2584,10 @@ int main(int argc, char *argv[]) {
                 goto finish;
         }
 
+        case ACTION_COMPACT:
+                r = compact(j, argv + optind);
+                goto finish;
+
         case ACTION_LIST_FIELD_NAMES: {
                 const char *field;
 
@@ -2390,37 +2615,7 @@ int main(int argc, char *argv[]) {
                 r = 0;
                 goto finish;
         }
-        /* add_boot() must be called first!
-         * It may need to seek the journal to find parent boot IDs. */
-        r = add_boot(j);
-        if (r < 0)
-                goto finish;
-
-        r = add_dmesg(j);
-        if (r < 0)
-                goto finish;
-
-        r = add_units(j);
-        if (r < 0) {
-                log_error_errno(r, "Failed to add filter for units: %m");
-                goto finish;
-        }
-
-        r = add_syslog_identifier(j);
-        if (r < 0) {
-                log_error_errno(r, "Failed to add filter for syslog identifiers: %m");
-                goto finish;
-        }
-
-        r = add_priorities(j);
-        if (r < 0)
-                goto finish;
-
-        r = add_facilities(j);
-        if (r < 0)
-                goto finish;
-
-        r = add_matches(j, argv + optind);
+        r = add_filters(j, argv + optind);
         if (r < 0)
                 goto finish;
 
@@ -2582,6 +2777,21 @@ int main(int argc, char *argv[]) {
         if (!arg_follow)
                 (void) pager_open(arg_pager_flags);
 
+        if (arg_threads > 1) {
+                r = output_pipeline_new(stdout, arg_output,
+                                        arg_all * OUTPUT_SHOW_ALL |
+                                        colors_enabled() * OUTPUT_COLOR |
+                                        arg_utc * OUTPUT_UTC,
+                                        arg_output_fields, arg_threads, &pipeline);
+                if (r == -EOPNOTSUPP)
+                        log_debug("Output mode %s cannot be formatted in parallel, ignoring --threads=.",
+                                  output_mode_to_string(arg_output));
+                else if (r < 0) {
+                        log_error_errno(r, "Failed to set up output threads: %m");
+                        goto finish;
+                }
+        }
+
         if (!arg_quiet && (arg_lines != 0 || arg_follow)) {
                 usec_t start, end;
                 char start_buf[FORMAT_TIMESTAMP_MAX], end_buf[FORMAT_TIMESTAMP_MAX];
@@ -2651,9 +2861,17 @@ int main(int argc, char *argv[]) {
                                 r = sd_journal_get_monotonic_usec(j, NULL, &boot_id);
                                 if (r >= 0) {
                                         if (previous_boot_id_valid &&
-                                            !sd_id128_equal(boot_id, previous_boot_id))
+                                            !sd_id128_equal(boot_id, previous_boot_id)) {
+                                                /* Everything queued so far belongs before the marker */
+                                                if (pipeline) {
+                                                        r = output_pipeline_flush(pipeline);
+                                                        if (r < 0)
+                                                                goto finish;
+                                                }
+
                                                 printf("%s-- Boot "SD_ID128_FORMAT_STR" --%s\n",
                                                        ansi_highlight(), SD_ID128_FORMAT_VAL(boot_id), ansi_normal());
+                                        }
 
                                         previous_boot_id = boot_id;
                                         previous_boot_id_valid = true;
@@ -2720,8 +2938,11 @@ int main(int argc, char *argv[]) {
                                 arg_utc * OUTPUT_UTC |
                                 arg_no_hostname * OUTPUT_NO_HOSTNAME;
 
-                        r = show_journal_entry(stdout, j, arg_output, 0, flags,
-                                               arg_output_fields, highlight, &ellipsized);
+                        if (pipeline)
+                                r = output_pipeline_submit(pipeline, j);
+                        else
+                                r = show_journal_entry(stdout, j, arg_output, 0, flags,
+                                                       arg_output_fields, highlight, &ellipsized);
                         need_seek = true;
                         if (r == -EADDRNOTAVAIL)
                                 break;
@@ -2745,6 +2966,12 @@ int main(int argc, char *argv[]) {
                         }
                 }
 
+                if (pipeline) {
+                        r = output_pipeline_flush(pipeline);
+                        if (r < 0)
+                                goto finish;
+                }
+
                 if (!arg_follow) {
                         if (n_shown == 0 && !arg_quiet)
                                 printf("-- No entries --\n");
@@ -32,7 +32,9 @@
  * until they are unpinned. Unpinned entries are kept around until cache pressure is seen. Cache entries older than 5s
  * are never used (a sad attempt to deal with the UNIX weakness of PIDs reuse), cache entries older than 1s are
  * refreshed in an incremental way (meaning: data is reread from /proc, but any old data we can't refresh is not
- * flushed out). Data newer than 1s is used immediately without refresh.
+ * flushed out). Data newer than 1s is used immediately without refresh. The incremental refresh is not done
+ * synchronously when a log message comes in, but queued and done from an idle-priority event source. Until then
+ * the cached data is used as is, so that a flood of log messages does not translate into a flood of /proc reads.
  *
  * Log stream clients (i.e. all clients using the AF_UNIX/SOCK_STREAM stdout/stderr transport) will pin a cache entry
  * as long as their socket is connected. Note that cache entries are shared between different transports. That means a
@@ -59,6 +61,9 @@
 /* Data older than 5s we flush out */
 #define MAX_USEC (5*USEC_PER_SEC)
 
+/* How many queued entries to refresh per iteration of the event loop */
+#define REFRESH_BATCH_MAX 64U
+
 /* Keep at most 16K entries in the cache. (Note though that this limit may be violated if enough streams pin entries in
  * the cache, in which case we *do* permit this limit to be breached. That's safe however, as the number of stream
  * clients itself is limited.) */
@@ -192,6 +197,9 @@ static ClientContext* client_context_free(Server *s, ClientContext *c) {
         if (c->in_lru)
                 assert_se(prioq_remove(s->client_contexts_lru, c, &c->lru_index) >= 0);
 
+        if (c->in_refresh_queue)
+                assert_se(set_remove(s->client_contexts_refresh, c) == c);
+
         client_context_reset(s, c);
 
         return mfree(c);
@@ -515,6 +523,11 @@ static void client_context_really_refresh(
         if (timestamp == USEC_INFINITY)
                 timestamp = now(CLOCK_MONOTONIC);
 
+        if (c->in_refresh_queue) {
+                assert_se(set_remove(s->client_contexts_refresh, c) == c);
+                c->in_refresh_queue = false;
+        }
+
         client_context_read_uid_gid(c, ucred);
         client_context_read_basic(c);
         (void) client_context_read_label(c, label, label_size);
@@ -537,6 +550,77 @@ static void client_context_really_refresh(
         }
 }
 
+static int on_refresh(sd_event_source *es, void *userdata) {
+        Server *s = userdata;
+        ClientContext *c;
+        usec_t t;
+
+        assert(s);
+
+        t = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < REFRESH_BATCH_MAX; i++) {
+                c = set_first(s->client_contexts_refresh);
+                if (!c)
+                        break;
+
+                /* An unpinned entry that got this old while waiting would be flushed out on its next use
+                 * anyway, since the PID might have been reused by now. Drop it right-away instead of
+                 * merging data of a different process into it. */
+                if (c->n_ref == 0 && c->timestamp + MAX_USEC < t) {
+                        client_context_free(s, c);
+                        continue;
+                }
+
+                client_context_really_refresh(s, c, NULL, NULL, 0, NULL, t);
+        }
+
+        if (set_isempty(s->client_contexts_refresh))
+                return sd_event_source_set_enabled(es, SD_EVENT_OFF);
+
+        return 0;
+}
+
+static int client_context_queue_refresh(Server *s, ClientContext *c) {
+        int r;
+
+        assert(s);
+        assert(c);
+
+        if (c->in_refresh_queue)
+                return 0;
+
+        if (!s->event)
+                return -ESTALE;
+
+        if (!s->client_contexts_refresh_event_source) {
+                _cleanup_(sd_event_source_unrefp) sd_event_source *source = NULL;
+
+                r = sd_event_add_defer(s->event, &source, on_refresh, s);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_priority(source, SD_EVENT_PRIORITY_IDLE);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(source, "client-context-refresh");
+
+                s->client_contexts_refresh_event_source = TAKE_PTR(source);
+        } else {
+                r = sd_event_source_set_enabled(s->client_contexts_refresh_event_source, SD_EVENT_ON);
+                if (r < 0)
+                        return r;
+        }
+
+        r = set_ensure_put(&s->client_contexts_refresh, NULL, c);
+        if (r < 0)
+                return r;
+
+        c->in_refresh_queue = true;
+        return 1;
+}
+
 void client_context_maybe_refresh(
                 Server *s,
                 ClientContext *c,
@@ -562,10 +646,6 @@ void client_context_maybe_refresh(
                 goto refresh;
         }
 
-        /* If the data is older than the lower limit, we refresh, but keep the old data for all we can't update */
-        if (c->timestamp + REFRESH_USEC < timestamp)
-                goto refresh;
-
         /* If the data passed along doesn't match the cached data we also do a refresh */
         if (ucred && uid_is_valid(ucred->uid) && c->uid != ucred->uid)
                 goto refresh;
@@ -576,6 +656,17 @@ void client_context_maybe_refresh(
         if (label_size > 0 && (label_size != c->label_size || memcmp(label, c->label, label_size) != 0))
                 goto refresh;
 
+        /* If a pinned entry has not been refreshed for so long that it would have been flushed out if it
+         * wasn't pinned, the event loop is very busy. Don't let it become arbitrarily stale. */
+        if (c->timestamp + MAX_USEC < timestamp)
+                goto refresh;
+
+        /* If the data is older than the lower limit, we refresh, but keep the old data for all we can't
+         * update. We do that later from the event loop when we are idle, and use what we have for now. */
+        if (c->timestamp + REFRESH_USEC < timestamp &&
+            client_context_queue_refresh(s, c) < 0)
+                goto refresh;
+
         return;
 
 refresh:
@@ -641,9 +732,12 @@ void client_context_flush_all(Server *s) {
 
         assert(prioq_size(s->client_contexts_lru) == 0);
         assert(hashmap_size(s->client_contexts) == 0);
+        assert(set_isempty(s->client_contexts_refresh));
 
         s->client_contexts_lru = prioq_free(s->client_contexts_lru);
         s->client_contexts = hashmap_free(s->client_contexts);
+        s->client_contexts_refresh = set_free(s->client_contexts_refresh);
+        s->client_contexts_refresh_event_source = sd_event_source_disable_unref(s->client_contexts_refresh_event_source);
 }
 
 static int client_context_get_internal(
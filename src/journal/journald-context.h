@@ -18,6 +18,7 @@ struct ClientContext {
         unsigned lru_index;
         usec_t timestamp;
         bool in_lru;
+        bool in_refresh_queue;
 
         pid_t pid;
         uid_t uid;
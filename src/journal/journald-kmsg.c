@@ -24,6 +24,9 @@
 #include "stdio-util.h"
 #include "string-util.h"
 
+/* How many records to read from /dev/kmsg at most before returning to the event loop */
+#define DEV_KMSG_READ_BATCH_MAX 64U
+
 void server_forward_kmsg(
                 Server *s,
                 int priority,
@@ -95,6 +98,42 @@ static bool is_us(const char *identifier, const char *pid) {
                streq(identifier, program_invocation_short_name);
 }
 
+static sd_device* dev_kmsg_get_device(Server *s, const char *id) {
+        _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+        _cleanup_free_ char *copy = NULL;
+
+        assert(s);
+        assert(id);
+
+        /* During a burst of kernel messages they are typically all about the same device. Hence remember
+         * the last device we looked up, so that we don't have to read it from sysfs and the udev database
+         * again for every single message. The cache is dropped whenever we return to the event loop, so that
+         * we pick up changes to the device eventually. */
+
+        if (s->dev_kmsg_device && streq_ptr(s->dev_kmsg_device_id, id))
+                return s->dev_kmsg_device;
+
+        if (sd_device_new_from_device_id(&d, id) < 0)
+                return NULL;
+
+        copy = strdup(id);
+        if (!copy)
+                return NULL;
+
+        free_and_replace(s->dev_kmsg_device_id, copy);
+        sd_device_unref(s->dev_kmsg_device);
+        s->dev_kmsg_device = TAKE_PTR(d);
+
+        return s->dev_kmsg_device;
+}
+
+static void dev_kmsg_flush_device_cache(Server *s) {
+        assert(s);
+
+        s->dev_kmsg_device_id = mfree(s->dev_kmsg_device_id);
+        s->dev_kmsg_device = sd_device_unref(s->dev_kmsg_device);
+}
+
 void dev_kmsg_record(Server *s, char *p, size_t l) {
 
         _cleanup_free_ char *message = NULL, *syslog_priority = NULL, *syslog_pid = NULL, *syslog_facility = NULL, *syslog_identifier = NULL, *source_time = NULL, *identifier = NULL, *pid = NULL;
@@ -211,9 +250,10 @@ void dev_kmsg_record(Server *s, char *p, size_t l) {
         }
 
         if (kernel_device) {
-                _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+                sd_device *d;
 
-                if (sd_device_new_from_device_id(&d, kernel_device) >= 0) {
+                d = dev_kmsg_get_device(s, kernel_device);
+                if (d) {
                         const char *g;
                         char *b;
 
@@ -339,17 +379,19 @@ int server_flush_dev_kmsg(Server *s) {
         for (;;) {
                 r = server_read_dev_kmsg(s);
                 if (r < 0)
-                        return r;
+                        break;
 
                 if (r == 0)
                         break;
         }
 
-        return 0;
+        dev_kmsg_flush_device_cache(s);
+        return r < 0 ? r : 0;
 }
 
 static int dispatch_dev_kmsg(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         Server *s = userdata;
+        int r = 0;
 
         assert(es);
         assert(fd == s->dev_kmsg_fd);
@@ -361,7 +403,17 @@ static int dispatch_dev_kmsg(sd_event_source *es, int fd, uint32_t revents, void
         if (!(revents & EPOLLIN))
                 log_error("Got invalid event from epoll for /dev/kmsg: %"PRIx32, revents);
 
-        return server_read_dev_kmsg(s);
+        /* Each read() returns a single record, hence read a bunch of them in one go, instead of going back
+         * to the event loop for each one. Don't read everything there is though, so that a kernel log storm
+         * doesn't starve the other log sources. */
+        for (unsigned i = 0; i < DEV_KMSG_READ_BATCH_MAX; i++) {
+                r = server_read_dev_kmsg(s);
+                if (r <= 0)
+                        break;
+        }
+
+        dev_kmsg_flush_device_cache(s);
+        return r;
 }
 
 int server_open_dev_kmsg(Server *s) {
@@ -5,6 +5,7 @@
 #include "alloc-util.h"
 #include "hashmap.h"
 #include "journald-rate-limit.h"
+#include "json.h"
 #include "list.h"
 #include "random-util.h"
 #include "string-util.h"
@@ -45,6 +46,9 @@ struct JournalRateLimitGroup {
         JournalRateLimitPool pools[POOLS_MAX];
         uint64_t hash;
 
+        /* Total number of messages suppressed from this group, for the statistics */
+        uint64_t n_suppressed;
+
         LIST_FIELDS(JournalRateLimitGroup, bucket);
         LIST_FIELDS(JournalRateLimitGroup, lru);
 };
@@ -56,6 +60,8 @@ struct JournalRateLimit {
 
         unsigned n_groups;
 
+        uint64_t n_suppressed;
+
         uint8_t hash_key[16];
 };
 
@@ -156,6 +162,31 @@ fail:
         return NULL;
 }
 
+static void journal_ratelimit_group_touch(JournalRateLimitGroup *g) {
+        JournalRateLimit *r;
+
+        assert(g);
+        assert(g->parent);
+
+        /* Moves the group to the front of both its hash bucket and the LRU list, so that groups which
+         * are logging are found first and are the last ones to be vacuumed. */
+
+        r = g->parent;
+
+        if (r->lru != g) {
+                if (r->lru_tail == g)
+                        r->lru_tail = g->lru_prev;
+
+                LIST_REMOVE(lru, r->lru, g);
+                LIST_PREPEND(lru, r->lru, g);
+        }
+
+        if (r->buckets[g->hash % BUCKETS_MAX] != g) {
+                LIST_REMOVE(bucket, r->buckets[g->hash % BUCKETS_MAX], g);
+                LIST_PREPEND(bucket, r->buckets[g->hash % BUCKETS_MAX], g);
+        }
+}
+
 static unsigned burst_modulate(unsigned burst, uint64_t available) {
         unsigned k;
 
@@ -216,8 +247,10 @@ int journal_ratelimit_test(JournalRateLimit *r, const char *id, usec_t rl_interv
                 g = journal_ratelimit_group_new(r, id, rl_interval, ts);
                 if (!g)
                         return -ENOMEM;
-        } else
+        } else {
                 g->interval = rl_interval;
+                journal_ratelimit_group_touch(g);
+        }
 
         if (rl_interval == 0 || rl_burst == 0)
                 return 1;
@@ -250,5 +283,41 @@ int journal_ratelimit_test(JournalRateLimit *r, const char *id, usec_t rl_interv
         }
 
         p->suppressed++;
+        g->n_suppressed++;
+        r->n_suppressed++;
         return 0;
 }
+
+int journal_ratelimit_build_json(JournalRateLimit *r, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *groups = NULL;
+        JournalRateLimitGroup *g;
+        int k;
+
+        assert(ret);
+
+        k = json_variant_new_array(&groups, NULL, 0);
+        if (k < 0)
+                return k;
+
+        if (r)
+                LIST_FOREACH(lru, g, r->lru) {
+                        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                        if (g->n_suppressed == 0)
+                                continue;
+
+                        k = json_build(&v, JSON_BUILD_OBJECT(
+                                                       JSON_BUILD_PAIR("unit", JSON_BUILD_STRING(g->id)),
+                                                       JSON_BUILD_PAIR("suppressed", JSON_BUILD_UNSIGNED(g->n_suppressed))));
+                        if (k < 0)
+                                return k;
+
+                        k = json_variant_append_array(&groups, v);
+                        if (k < 0)
+                                return k;
+                }
+
+        return json_build(ret, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("suppressed", JSON_BUILD_UNSIGNED(r ? r->n_suppressed : 0)),
+                                       JSON_BUILD_PAIR("units", JSON_BUILD_VARIANT(groups))));
+}
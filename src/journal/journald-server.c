@@ -41,6 +41,7 @@
 #include "journald-stream.h"
 #include "journald-syslog.h"
 #include "log.h"
+#include "metrics.h"
 #include "missing_audit.h"
 #include "mkdir.h"
 #include "parse-util.h"
@@ -49,6 +50,7 @@
 #include "process-util.h"
 #include "rm-rf.h"
 #include "selinux-util.h"
+#include "set.h"
 #include "signal-util.h"
 #include "socket-util.h"
 #include "stdio-util.h"
@@ -76,10 +78,15 @@
  * for a bit of additional metadata. */
 #define DEFAULT_LINE_MAX (48*1024)
 
+#define DEFAULT_STDOUT_STREAMS_MAX 4096U
+
 #define DEFERRED_CLOSES_MAX (4096)
 
 #define IDLE_TIMEOUT_USEC (30*USEC_PER_SEC)
 
+/* How many datagrams to read from the native, syslog or audit socket for each wakeup */
+#define DATAGRAM_BATCH_MAX 64U
+
 static int determine_path_usage(
                 Server *s,
                 const char *path,
@@ -453,7 +460,7 @@ static int do_rotate(
         if (!*f)
                 return -EINVAL;
 
-        r = journal_file_rotate(f, s->compress.enabled, s->compress.threshold_bytes, seal, s->deferred_closes);
+        r = journal_file_rotate(f, s->compress.enabled, s->compress.threshold_bytes, s->compress.dictionary, seal, s->deferred_closes);
         if (r < 0) {
                 if (*f)
                         return log_error_errno(r, "Failed to rotate %s: %m", (*f)->path);
@@ -633,6 +640,18 @@ void server_sync(Server *s) {
         JournalFile *f;
         int r;
 
+        assert(s);
+
+        if (s->sync_pending_since > 0) {
+                usec_t n;
+
+                assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &n) >= 0);
+                s->sync_stats.max_latency_usec = MAX(s->sync_stats.max_latency_usec, usec_sub_unsigned(n, s->sync_pending_since));
+                s->sync_pending_since = 0;
+        }
+
+        s->sync_stats.n_syncs++;
+
         if (s->system_journal) {
                 r = journal_file_set_offline(s->system_journal, false);
                 if (r < 0)
@@ -651,7 +670,14 @@ void server_sync(Server *s) {
                         log_error_errno(r, "Failed to disable sync timer source: %m");
         }
 
+        if (s->sync_urgent_event_source) {
+                r = sd_event_source_set_enabled(s->sync_urgent_event_source, SD_EVENT_OFF);
+                if (r < 0)
+                        log_error_errno(r, "Failed to disable urgent sync timer source: %m");
+        }
+
         s->sync_scheduled = false;
+        s->sync_urgent_scheduled = false;
 }
 
 static void do_vacuum(Server *s, JournalStorage *storage, bool verbose) {
@@ -782,23 +808,16 @@ static bool shall_try_append_again(JournalFile *f, int r) {
         }
 }
 
-static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n, int priority) {
+static void write_entries_to_journal(Server *s, uid_t uid, const JournalAppendEntry *entries, size_t n, int priority) {
         bool vacuumed = false, rotate = false;
-        struct dual_timestamp ts;
         JournalFile *f;
         int r;
 
         assert(s);
-        assert(iovec);
+        assert(entries);
         assert(n > 0);
 
-        /* Get the closest, linearized time we have for this log event from the event loop. (Note that we do not use
-         * the source time, and not even the time the event was originally seen, but instead simply the time we started
-         * processing it, as we want strictly linear ordering in what we write out.) */
-        assert_se(sd_event_now(s->event, CLOCK_REALTIME, &ts.realtime) >= 0);
-        assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &ts.monotonic) >= 0);
-
-        if (ts.realtime < s->last_realtime_clock) {
+        if (entries[0].ts.realtime < s->last_realtime_clock) {
                 /* When the time jumps backwards, let's immediately rotate. Of course, this should not happen during
                  * regular operation. However, when it does happen, then we should make sure that we start fresh files
                  * to ensure that the entries in the journal files are strictly ordered by time, in order to ensure
@@ -828,32 +847,148 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n
                         return;
         }
 
-        s->last_realtime_clock = ts.realtime;
+        s->last_realtime_clock = entries[n-1].ts.realtime;
 
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
-        if (r >= 0) {
-                server_schedule_sync(s, priority);
-                return;
+        while (n > 0) {
+                size_t k;
+
+                r = journal_file_append_entries(f, entries, n, &s->seqnum, &k);
+                if (r >= 0)
+                        break;
+
+                assert(k < n);
+                entries += k;
+                n -= k;
+
+                if (vacuumed || !shall_try_append_again(f, r)) {
+                        log_error_errno(r, "Failed to write entry (%zu items, %zu bytes)%s, ignoring: %m",
+                                        entries->n_iovec, IOVEC_TOTAL_SIZE(entries->iovec, entries->n_iovec),
+                                        vacuumed ? " despite vacuuming" : "");
+
+                        /* Skip over the entry we failed to write, and try the next one (if there is any) */
+                        entries++;
+                        n--;
+                        continue;
+                }
+
+                server_rotate(s);
+                server_vacuum(s, false);
+                vacuumed = true;
+
+                f = find_journal(s, uid);
+                if (!f)
+                        return;
+
+                log_debug("Retrying write.");
         }
 
-        if (vacuumed || !shall_try_append_again(f, r)) {
-                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes), ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
+        server_schedule_sync(s, priority);
+}
+
+static void server_batch_free_entries(Server *s) {
+        assert(s);
+
+        for (size_t i = 0; i < s->n_batch; i++)
+                free((struct iovec*) s->batch[i].iovec);
+
+        s->n_batch = 0;
+}
+
+static void server_batch_flush(Server *s) {
+        assert(s);
+
+        if (s->n_batch == 0)
                 return;
+
+        write_entries_to_journal(s, s->batch_uid, s->batch, s->n_batch, s->batch_priority);
+        server_batch_free_entries(s);
+}
+
+static int server_batch_add(Server *s, uid_t uid, const dual_timestamp *ts, const struct iovec *iovec, size_t n, int priority) {
+        struct iovec *copy;
+        size_t sz;
+        uint8_t *p;
+
+        assert(s);
+        assert(ts);
+        assert(iovec);
+
+        if (s->n_batch > 0 && (s->batch_uid != uid || s->n_batch >= BATCH_ENTRIES_MAX))
+                server_batch_flush(s);
+
+        if (!GREEDY_REALLOC(s->batch, s->n_batch + 1))
+                return -ENOMEM;
+
+        /* The iovecs usually point to the stack of the caller, hence copy the array along with the data
+         * it points to, in a single allocation */
+        sz = IOVEC_TOTAL_SIZE(iovec, n);
+        copy = malloc(n * sizeof(struct iovec) + sz);
+        if (!copy)
+                return -ENOMEM;
+
+        p = (uint8_t*) (copy + n);
+        for (size_t i = 0; i < n; i++) {
+                copy[i] = IOVEC_MAKE(p, iovec[i].iov_len);
+                memcpy_safe(p, iovec[i].iov_base, iovec[i].iov_len);
+                p += iovec[i].iov_len;
         }
 
-        server_rotate(s);
-        server_vacuum(s, false);
+        if (s->n_batch == 0) {
+                s->batch_uid = uid;
+                s->batch_priority = priority;
+        } else
+                s->batch_priority = MIN(s->batch_priority, priority);
 
-        f = find_journal(s, uid);
-        if (!f)
+        s->batch[s->n_batch++] = (JournalAppendEntry) {
+                .ts = *ts,
+                .iovec = copy,
+                .n_iovec = n,
+        };
+
+        return 0;
+}
+
+void server_batch_begin(Server *s) {
+        assert(s);
+
+        s->batch_depth++;
+}
+
+void server_batch_end(Server *s) {
+        assert(s);
+        assert(s->batch_depth > 0);
+
+        if (--s->batch_depth > 0)
                 return;
 
-        log_debug("Retrying write.");
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
-        if (r < 0)
-                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes) despite vacuuming, ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
-        else
-                server_schedule_sync(s, priority);
+        server_batch_flush(s);
+}
+
+static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n, int priority) {
+        struct dual_timestamp ts;
+        int r;
+
+        assert(s);
+        assert(iovec);
+        assert(n > 0);
+
+        /* Get the closest, linearized time we have for this log event from the event loop. (Note that we do not use
+         * the source time, and not even the time the event was originally seen, but instead simply the time we started
+         * processing it, as we want strictly linear ordering in what we write out.) */
+        assert_se(sd_event_now(s->event, CLOCK_REALTIME, &ts.realtime) >= 0);
+        assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &ts.monotonic) >= 0);
+
+        if (s->batch_depth > 0) {
+                r = server_batch_add(s, uid, &ts, iovec, n, priority);
+                if (r >= 0)
+                        return;
+
+                /* If we can't queue the entry, write out what we have so far, and then this one directly */
+                log_oom_debug();
+                server_batch_flush(s);
+        }
+
+        write_entries_to_journal(s, uid, &(JournalAppendEntry) { .ts = ts, .iovec = iovec, .n_iovec = n }, 1, priority);
 }
 
 #define IOVEC_ADD_NUMERIC_FIELD(iovec, n, value, type, isset, format, field)  \
@@ -1106,6 +1241,7 @@ void server_dispatch_message(
 }
 
 int server_flush_to_var(Server *s, bool require_flag_file) {
+        _cleanup_set_free_ Set *copied_data = NULL;
         sd_journal *j = NULL;
         const char *fn;
         unsigned n = 0;
@@ -1156,7 +1292,10 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
                         goto finish;
                 }
 
-                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset);
+                /* Most entries in the runtime journal share their fields with many others, hence remember
+                 * where each DATA object ended up, so that we don't decompress, hash and look it up again for
+                 * every single entry referencing it. */
+                r = journal_file_copy_entry_full(f, s->system_journal, o, f->current_offset, NULL, &copied_data);
                 if (r >= 0)
                         continue;
 
@@ -1165,6 +1304,9 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
                         goto finish;
                 }
 
+                /* The system journal is replaced, hence whatever we remember about it is stale now */
+                set_clear(copied_data);
+
                 server_rotate(s);
                 server_vacuum(s, false);
 
@@ -1175,7 +1317,7 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
                 }
 
                 log_debug("Retrying write.");
-                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset);
+                r = journal_file_copy_entry_full(f, s->system_journal, o, f->current_offset, NULL, &copied_data);
                 if (r < 0) {
                         log_error_errno(r, "Can't write entry: %m");
                         goto finish;
@@ -1240,14 +1382,8 @@ static int server_relinquish_var(Server *s) {
         return 0;
 }
 
-int server_process_datagram(
-                sd_event_source *es,
-                int fd,
-                uint32_t revents,
-                void *userdata) {
-
+static int server_receive_datagram(Server *s, int fd) {
         size_t label_len = 0, m;
-        Server *s = userdata;
         struct ucred *ucred = NULL;
         struct timeval *tv = NULL;
         struct cmsghdr *cmsg;
@@ -1280,11 +1416,6 @@ int server_process_datagram(
         assert(s);
         assert(fd == s->native_fd || fd == s->syslog_fd || fd == s->audit_fd);
 
-        if (revents != EPOLLIN)
-                return log_error_errno(SYNTHETIC_ERRNO(EIO),
-                                       "Got invalid event from epoll for datagram fd: %" PRIx32,
-                                       revents);
-
         /* Try to get the right size, if we can. (Not all sockets support SIOCINQ, hence we just try, but don't rely on
          * it.) */
         (void) ioctl(fd, SIOCINQ, &v);
@@ -1304,7 +1435,7 @@ int server_process_datagram(
                 return 0;
         if (n == -EXFULL) {
                 log_warning("Got message with truncated control data (too many fds sent?), ignoring.");
-                return 0;
+                return 1;
         }
         if (n < 0)
                 return log_error_errno(n, "recvmsg() failed: %m");
@@ -1360,8 +1491,36 @@ int server_process_datagram(
 
         close_many(fds, n_fds);
 
+        return 1;
+}
+
+int server_process_datagram(
+                sd_event_source *es,
+                int fd,
+                uint32_t revents,
+                void *userdata) {
+
+        Server *s = userdata;
+        int r = 0;
+
+        assert(s);
+
+        if (revents != EPOLLIN)
+                return log_error_errno(SYNTHETIC_ERRNO(EIO),
+                                       "Got invalid event from epoll for datagram fd: %" PRIx32,
+                                       revents);
+
+        /* Drain a number of datagrams per wakeup, so that bursts don't overflow the socket buffer while we
+         * wait for the event loop to come around again. The limit makes sure the other sockets and the
+         * stream connections still get their turn, the next iteration picks up what remains. */
+        for (unsigned i = 0; i < DATAGRAM_BATCH_MAX; i++) {
+                r = server_receive_datagram(s, fd);
+                if (r <= 0)
+                        break;
+        }
+
         server_refresh_idle_timer(s);
-        return 0;
+        return r < 0 ? r : 0;
 }
 
 static void server_full_flush(Server *s) {
@@ -1441,7 +1600,7 @@ static void server_full_sync(Server *s) {
 
         assert(s);
 
-        server_sync(s);
+        (void) server_request_sync(s, SYNC_LEVEL_IMMEDIATE);
 
         /* Let clients know when the most recent sync happened. */
         fn = strjoina(s->runtime_directory, "/synced");
@@ -1617,11 +1776,18 @@ static int server_parse_config_file(Server *s) {
         assert(s);
 
         if (s->namespace) {
-                const char *namespaced, *dropin_dirname;
+                _cleanup_free_ char *base = NULL;
+                const char *namespaced, *dropin_dirname, *n;
+
+                /* Shards of a namespace share the configuration of the namespace they belong to */
+                r = log_namespace_shard_from_string(s->namespace, &base, NULL);
+                if (r == -ENOMEM)
+                        return log_oom();
+                n = base ?: s->namespace;
 
                 /* If we are running in namespace mode, load the namespace specific configuration file, and nothing else */
-                namespaced = strjoina(PKGSYSCONFDIR "/journald@", s->namespace, ".conf");
-                dropin_dirname = strjoina("journald@", s->namespace, ".conf.d");
+                namespaced = strjoina(PKGSYSCONFDIR "/journald@", n, ".conf");
+                dropin_dirname = strjoina("journald@", n, ".conf.d");
 
                 r = config_parse_many(
                                 STRV_MAKE_CONST(namespaced),
@@ -1653,47 +1819,100 @@ static int server_dispatch_sync(sd_event_source *es, usec_t t, void *userdata) {
         return 0;
 }
 
-int server_schedule_sync(Server *s, int priority) {
+static int server_schedule_sync_timer(
+                Server *s,
+                sd_event_source **source,
+                usec_t usec,
+                const char *description) {
         int r;
 
         assert(s);
+        assert(source);
 
-        if (priority <= LOG_CRIT) {
-                /* Immediately sync to disk when this is of priority CRIT, ALERT, EMERG */
-                server_sync(s);
-                return 0;
+        if (!*source) {
+                r = sd_event_add_time_relative(
+                                s->event,
+                                source,
+                                CLOCK_MONOTONIC,
+                                usec, 0,
+                                server_dispatch_sync, s);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_priority(*source, SD_EVENT_PRIORITY_IMPORTANT);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(*source, description);
+        } else {
+                r = sd_event_source_set_time_relative(*source, usec);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_enabled(*source, SD_EVENT_ONESHOT);
+                if (r < 0)
+                        return r;
         }
 
-        if (s->sync_scheduled)
-                return 0;
+        return 0;
+}
 
-        if (s->sync_interval_usec > 0) {
+int server_request_sync(Server *s, SyncLevel level) {
+        int r;
 
-                if (!s->sync_event_source) {
-                        r = sd_event_add_time_relative(
-                                        s->event,
-                                        &s->sync_event_source,
-                                        CLOCK_MONOTONIC,
-                                        s->sync_interval_usec, 0,
-                                        server_dispatch_sync, s);
-                        if (r < 0)
-                                return r;
+        assert(s);
+        assert(level >= 0 && level < _SYNC_LEVEL_MAX);
 
-                        r = sd_event_source_set_priority(s->sync_event_source, SD_EVENT_PRIORITY_IMPORTANT);
-                } else {
-                        r = sd_event_source_set_time_relative(s->sync_event_source, s->sync_interval_usec);
+        s->sync_stats.n_requests[level]++;
+
+        if (s->sync_pending_since == 0)
+                assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &s->sync_pending_since) >= 0);
+
+        switch (level) {
+
+        case SYNC_LEVEL_URGENT:
+                /* Group commit: rather than syncing for every single urgent request, sync once for all
+                 * requests that come in within the configured window */
+                if (s->sync_urgent_window_usec > 0) {
+                        if (s->sync_urgent_scheduled)
+                                return 0;
+
+                        r = server_schedule_sync_timer(s, &s->sync_urgent_event_source, s->sync_urgent_window_usec, "sync-urgent-timer");
                         if (r < 0)
                                 return r;
 
-                        r = sd_event_source_set_enabled(s->sync_event_source, SD_EVENT_ONESHOT);
+                        s->sync_urgent_scheduled = true;
+                        return 0;
                 }
+
+                _fallthrough_;
+
+        case SYNC_LEVEL_IMMEDIATE:
+                server_sync(s);
+                return 0;
+
+        case SYNC_LEVEL_LAZY:
+                if (s->sync_scheduled || s->sync_interval_usec <= 0)
+                        return 0;
+
+                r = server_schedule_sync_timer(s, &s->sync_event_source, s->sync_interval_usec, "sync-timer");
                 if (r < 0)
                         return r;
 
                 s->sync_scheduled = true;
+                return 0;
+
+        default:
+                assert_not_reached();
         }
+}
 
-        return 0;
+int server_schedule_sync(Server *s, int priority) {
+        assert(s);
+
+        /* Sync to disk right away (or at least within the urgent sync window) when this is of priority CRIT,
+         * ALERT, EMERG */
+        return server_request_sync(s, priority <= LOG_CRIT ? SYNC_LEVEL_URGENT : SYNC_LEVEL_LAZY);
 }
 
 static int dispatch_hostname_change(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
@@ -2000,6 +2219,99 @@ static int vl_method_relinquish_var(Varlink *link, JsonVariant *parameters, Varl
         return varlink_reply(link, NULL);
 }
 
+static int vl_method_get_sync_statistics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        Server *s = userdata;
+        int r;
+
+        assert(link);
+        assert(s);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("lazyRequests", JSON_BUILD_UNSIGNED(s->sync_stats.n_requests[SYNC_LEVEL_LAZY])),
+                                       JSON_BUILD_PAIR("urgentRequests", JSON_BUILD_UNSIGNED(s->sync_stats.n_requests[SYNC_LEVEL_URGENT])),
+                                       JSON_BUILD_PAIR("immediateRequests", JSON_BUILD_UNSIGNED(s->sync_stats.n_requests[SYNC_LEVEL_IMMEDIATE])),
+                                       JSON_BUILD_PAIR("syncs", JSON_BUILD_UNSIGNED(s->sync_stats.n_syncs)),
+                                       JSON_BUILD_PAIR("maxLatencyUSec", JSON_BUILD_UNSIGNED(s->sync_stats.max_latency_usec))));
+        if (r < 0)
+                return r;
+
+        return varlink_reply(link, v);
+}
+
+static int vl_method_get_rate_limit_statistics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        Server *s = userdata;
+        int r;
+
+        assert(link);
+        assert(s);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        r = journal_ratelimit_build_json(s->ratelimit, &v);
+        if (r < 0)
+                return r;
+
+        return varlink_reply(link, v);
+}
+
+static uint64_t metric_sync_requests_total(void *userdata) {
+        Server *s = userdata;
+        uint64_t n = 0;
+
+        assert(s);
+
+        for (SyncLevel level = 0; level < _SYNC_LEVEL_MAX; level++)
+                n += s->sync_stats.n_requests[level];
+
+        return n;
+}
+
+static uint64_t metric_syncs_total(void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+
+        return s->sync_stats.n_syncs;
+}
+
+static uint64_t metric_stdout_streams(void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+
+        return s->n_stdout_streams;
+}
+
+static uint64_t metric_client_contexts(void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+
+        return hashmap_size(s->client_contexts);
+}
+
+static const Metric server_metrics[] = {
+        { "journald_sync_requests_total", "Requests to sync the journal files to disk",   METRIC_COUNTER, .get_value = metric_sync_requests_total },
+        { "journald_syncs_total",         "Syncs of the journal files to disk",           METRIC_COUNTER, .get_value = metric_syncs_total         },
+        { "journald_stdout_streams",      "Connected stdout streams",                     METRIC_GAUGE,   .get_value = metric_stdout_streams      },
+        { "journald_client_contexts",     "Cached metadata of processes that logged",     METRIC_GAUGE,   .get_value = metric_client_contexts     },
+};
+
+static int vl_method_list_metrics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        Server *s = userdata;
+
+        assert(link);
+        assert(s);
+
+        return metrics_method_list(link, parameters, server_metrics, ELEMENTSOF(server_metrics), s);
+}
+
 static int vl_connect(VarlinkServer *server, Varlink *link, void *userdata) {
         Server *s = userdata;
 
@@ -2035,10 +2347,13 @@ static int server_open_varlink(Server *s, const char *socket, int fd) {
 
         r = varlink_server_bind_method_many(
                         s->varlink_server,
-                        "io.systemd.Journal.Synchronize",   vl_method_synchronize,
-                        "io.systemd.Journal.Rotate",        vl_method_rotate,
-                        "io.systemd.Journal.FlushToVar",    vl_method_flush_to_var,
-                        "io.systemd.Journal.RelinquishVar", vl_method_relinquish_var);
+                        "io.systemd.Journal.Synchronize",            vl_method_synchronize,
+                        "io.systemd.Journal.Rotate",                 vl_method_rotate,
+                        "io.systemd.Journal.FlushToVar",             vl_method_flush_to_var,
+                        "io.systemd.Journal.RelinquishVar",          vl_method_relinquish_var,
+                        "io.systemd.Journal.GetSyncStatistics",      vl_method_get_sync_statistics,
+                        "io.systemd.Journal.GetRateLimitStatistics", vl_method_get_rate_limit_statistics,
+                        "io.systemd.Metrics.List",                   vl_method_list_metrics);
         if (r < 0)
                 return r;
 
@@ -2203,6 +2518,7 @@ int server_init(Server *s, const char *namespace) {
                 .max_level_wall = LOG_EMERG,
 
                 .line_max = DEFAULT_LINE_MAX,
+                .stdout_streams_max = DEFAULT_STDOUT_STREAMS_MAX,
 
                 .runtime_storage.name = "Runtime Journal",
                 .system_storage.name = "System Journal",
@@ -2445,6 +2761,9 @@ void server_done(Server *s) {
 
         set_free_with_destructor(s->deferred_closes, journal_file_close);
 
+        server_batch_free_entries(s);
+        free(s->batch);
+
         while (s->stdout_streams)
                 stdout_stream_free(s->stdout_streams);
 
@@ -2463,6 +2782,7 @@ void server_done(Server *s) {
         sd_event_source_unref(s->dev_kmsg_event_source);
         sd_event_source_unref(s->audit_event_source);
         sd_event_source_unref(s->sync_event_source);
+        sd_event_source_unref(s->sync_urgent_event_source);
         sd_event_source_unref(s->sigusr1_event_source);
         sd_event_source_unref(s->sigusr2_event_source);
         sd_event_source_unref(s->sigterm_event_source);
@@ -2488,7 +2808,11 @@ void server_done(Server *s) {
         if (s->kernel_seqnum)
                 munmap(s->kernel_seqnum, sizeof(uint64_t));
 
+        free(s->dev_kmsg_device_id);
+        sd_device_unref(s->dev_kmsg_device);
+
         free(s->buffer);
+        free(s->stream_buffer);
         free(s->tty_path);
         free(s->cgroup_root);
         free(s->hostname_field);
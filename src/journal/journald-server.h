@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
+#include "sd-device.h"
 #include "sd-event.h"
 
 typedef struct Server Server;
@@ -39,6 +40,7 @@ typedef enum SplitMode {
 typedef struct JournalCompressOptions {
         bool enabled;
         uint64_t threshold_bytes;
+        bool dictionary;
 } JournalCompressOptions;
 
 typedef struct JournalStorageSpace {
@@ -59,6 +61,20 @@ typedef struct JournalStorage {
         JournalStorageSpace space;
 } JournalStorage;
 
+typedef enum SyncLevel {
+        SYNC_LEVEL_LAZY,      /* within SyncIntervalSec= */
+        SYNC_LEVEL_URGENT,    /* within SyncCriticalDelaySec=, i.e. right away by default */
+        SYNC_LEVEL_IMMEDIATE, /* right away */
+        _SYNC_LEVEL_MAX,
+        _SYNC_LEVEL_INVALID = -EINVAL,
+} SyncLevel;
+
+typedef struct SyncStatistics {
+        uint64_t n_requests[_SYNC_LEVEL_MAX];
+        uint64_t n_syncs;
+        usec_t max_latency_usec; /* the longest a request had to wait for the sync */
+} SyncStatistics;
+
 struct Server {
         char *namespace;
 
@@ -78,6 +94,7 @@ struct Server {
         sd_event_source *dev_kmsg_event_source;
         sd_event_source *audit_event_source;
         sd_event_source *sync_event_source;
+        sd_event_source *sync_urgent_event_source;
         sd_event_source *sigusr1_event_source;
         sd_event_source *sigusr2_event_source;
         sd_event_source *sigterm_event_source;
@@ -98,6 +115,7 @@ struct Server {
 
         JournalRateLimit *ratelimit;
         usec_t sync_interval_usec;
+        usec_t sync_urgent_window_usec;
         usec_t ratelimit_interval;
         unsigned ratelimit_burst;
 
@@ -124,6 +142,8 @@ struct Server {
         LIST_HEAD(StdoutStream, stdout_streams);
         LIST_HEAD(StdoutStream, stdout_streams_notify_queue);
         unsigned n_stdout_streams;
+        unsigned stdout_streams_max;
+        char *stream_buffer; /* shared among all stdout streams */
 
         char *tty_path;
 
@@ -143,9 +163,14 @@ struct Server {
         uint64_t *kernel_seqnum;
         bool dev_kmsg_readable:1;
 
+        /* The device the last kernel message was about, while we are processing a batch of them */
+        char *dev_kmsg_device_id;
+        sd_device *dev_kmsg_device;
+
         bool send_watchdog:1;
         bool sent_notify_ready:1;
         bool sync_scheduled:1;
+        bool sync_urgent_scheduled:1;
 
         char machine_id_field[sizeof("_MACHINE_ID=") + 32];
         char boot_id_field[sizeof("_BOOT_ID=") + 32];
@@ -160,11 +185,16 @@ struct Server {
 
         usec_t last_realtime_clock;
 
+        usec_t sync_pending_since; /* when the oldest request not covered by a sync yet came in */
+        SyncStatistics sync_stats;
+
         size_t line_max;
 
         /* Caching of client metadata */
         Hashmap *client_contexts;
         Prioq *client_contexts_lru;
+        Set *client_contexts_refresh;
+        sd_event_source *client_contexts_refresh_event_source;
 
         usec_t last_cache_pid_flush;
 
@@ -172,6 +202,13 @@ struct Server {
         ClientContext *pid1_context; /* the context of PID 1 */
 
         VarlinkServer *varlink_server;
+
+        /* Entries queued up between server_batch_begin() and server_batch_end(), written in one go */
+        JournalAppendEntry *batch;
+        size_t n_batch;
+        uid_t batch_uid;
+        int batch_priority;
+        unsigned batch_depth;
 };
 
 #define SERVER_MACHINE_ID(s) ((s)->machine_id_field + STRLEN("_MACHINE_ID="))
@@ -191,6 +228,9 @@ struct Server {
 /* kmsg: Maximum number of extra fields we'll import from udev's devices */
 #define N_IOVEC_UDEV_FIELDS 32
 
+/* Maximum number of entries we queue up before writing them out */
+#define BATCH_ENTRIES_MAX 64U
+
 void server_dispatch_message(Server *s, struct iovec *iovec, size_t n, size_t m, ClientContext *c, const struct timeval *tv, int priority, pid_t object_pid);
 void server_driver_message(Server *s, pid_t object_pid, const char *message_id, const char *format, ...) _sentinel_ _printf_(4,0);
 
@@ -214,7 +254,10 @@ void server_done(Server *s);
 void server_sync(Server *s);
 int server_vacuum(Server *s, bool verbose);
 void server_rotate(Server *s);
+int server_request_sync(Server *s, SyncLevel level);
 int server_schedule_sync(Server *s, int priority);
+void server_batch_begin(Server *s);
+void server_batch_end(Server *s);
 int server_flush_to_var(Server *s, bool require_flag_file);
 void server_maybe_append_tags(Server *s);
 int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata);
@@ -37,14 +37,19 @@
 #include "tmpfile-util.h"
 #include "unit-name.h"
 
-#define STDOUT_STREAMS_MAX 4096
-
 /* During the "setup" protocol phase of the stream logic let's define a different maximum line length than
  * during the actual operational phase. We want to allow users to specify very short line lengths after all,
  * but the unit name we embed in the setup protocol might be longer than that. Hence, during the setup phase
  * let's enforce a line length matching the maximum unit name length (255) */
 #define STDOUT_STREAM_SETUP_PROTOCOL_LINE_MAX (UNIT_NAME_MAX-1U)
 
+/* We keep room for the field name in front of the data in the shared stream buffer, so that the MESSAGE= field
+ * can be put together in place, right in front of the line we read, without copying the line */
+#define STDOUT_STREAM_HEADROOM STRLEN("MESSAGE=")
+
+/* How much to read from a stream at once */
+#define STDOUT_STREAM_READ_MAX (64U*1024U)
+
 typedef enum StdoutStreamState {
         STDOUT_STREAM_IDENTIFIER,
         STDOUT_STREAM_UNIT_ID,
@@ -78,6 +83,7 @@ struct StdoutStream {
         struct ucred ucred;
         char *label;
         char *identifier;
+        char *identifier_field;
         char *unit_id;
         int priority;
         bool level_prefix:1;
@@ -130,6 +136,7 @@ StdoutStream* stdout_stream_free(StdoutStream *s) {
         safe_close(s->fd);
         free(s->label);
         free(s->identifier);
+        free(s->identifier_field);
         free(s->unit_id);
         free(s->state_file);
         free(s->buffer);
@@ -248,19 +255,20 @@ fail:
 
 static int stdout_stream_log(
                 StdoutStream *s,
-                const char *p,
+                char *p,
                 LineBreak line_break) {
 
         struct iovec *iovec;
         int priority;
         char syslog_priority[] = "PRIORITY=\0";
         char syslog_facility[STRLEN("SYSLOG_FACILITY=") + DECIMAL_STR_MAX(int) + 1];
-        _cleanup_free_ char *message = NULL, *syslog_identifier = NULL;
+        char saved[STDOUT_STREAM_HEADROOM], *message;
         size_t n = 0, m;
         int r;
 
         assert(s);
         assert(p);
+        assert(p >= s->server->stream_buffer + STDOUT_STREAM_HEADROOM);
 
         assert(line_break >= 0);
         assert(line_break < _LINE_BREAK_MAX);
@@ -276,7 +284,7 @@ static int stdout_stream_log(
         priority = s->priority;
 
         if (s->level_prefix)
-                syslog_parse_priority(&p, &priority, false);
+                syslog_parse_priority((const char**) &p, &priority, false);
 
         if (!client_context_test_priority(s->context, priority))
                 return 0;
@@ -311,9 +319,11 @@ static int stdout_stream_log(
         }
 
         if (s->identifier) {
-                syslog_identifier = strjoin("SYSLOG_IDENTIFIER=", s->identifier);
-                if (syslog_identifier)
-                        iovec[n++] = IOVEC_MAKE_STRING(syslog_identifier);
+                /* The identifier doesn't change anymore once we are in the running state */
+                if (!s->identifier_field)
+                        s->identifier_field = strjoin("SYSLOG_IDENTIFIER=", s->identifier);
+                if (s->identifier_field)
+                        iovec[n++] = IOVEC_MAKE_STRING(s->identifier_field);
         }
 
         static const char * const line_break_field_table[_LINE_BREAK_MAX] = {
@@ -331,11 +341,17 @@ static int stdout_stream_log(
         if (c)
                 iovec[n++] = IOVEC_MAKE_STRING(c);
 
-        message = strjoin("MESSAGE=", p);
-        if (message)
-                iovec[n++] = IOVEC_MAKE_STRING(message);
+        /* Whatever precedes the line in the buffer (the headroom, the previous line or the level prefix) is
+         * not needed anymore, but let's restore it anyway once the entry is dispatched (which copies the
+         * data if it is batched), as our caller might look at the buffer again. */
+        message = p - STDOUT_STREAM_HEADROOM;
+        memcpy(saved, message, STDOUT_STREAM_HEADROOM);
+        memcpy(message, "MESSAGE=", STDOUT_STREAM_HEADROOM);
+        iovec[n++] = IOVEC_MAKE_STRING(message);
 
         server_dispatch_message(s->server, iovec, n, m, s->context, NULL, priority, 0);
+
+        memcpy(message, saved, STDOUT_STREAM_HEADROOM);
         return 0;
 }
 
@@ -500,25 +516,22 @@ static int stdout_stream_scan(
 
         line_max = stdout_stream_line_max(s);
 
+        /* Our caller always leaves room for a trailing NUL in the buffer. Put one there, so that we can look
+         * for both kinds of terminators in a single pass with strchrnul(). */
+        p[remaining] = 0;
+
         for (;;) {
                 LineBreak line_break;
                 size_t skip, found;
-                char *end1, *end2;
-                size_t tmp_remaining = MIN(remaining, line_max);
+                char *end;
 
-                end1 = memchr(p, '\n', tmp_remaining);
-                end2 = memchr(p, 0, end1 ? (size_t) (end1 - p) : tmp_remaining);
+                end = strchrnul(p, '\n');
+                found = end - p;
 
-                if (end2) {
-                        /* We found a NUL terminator */
-                        found = end2 - p;
+                if (found < MIN(remaining, line_max)) {
+                        /* We found a \n or NUL terminator within the line length limit */
                         skip = found + 1;
-                        line_break = LINE_BREAK_NUL;
-                } else if (end1) {
-                        /* We found a \n terminator */
-                        found = end1 - p;
-                        skip = found + 1;
-                        line_break = LINE_BREAK_NEWLINE;
+                        line_break = *end == '\n' ? LINE_BREAK_NEWLINE : LINE_BREAK_NUL;
                 } else if (remaining >= line_max) {
                         /* Force a line break after the maximum line length */
                         found = skip = line_max;
@@ -551,12 +564,12 @@ static int stdout_stream_scan(
 
 static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         CMSG_BUFFER_TYPE(CMSG_SPACE(sizeof(struct ucred))) control;
-        size_t limit, consumed, allocated;
+        size_t limit, consumed;
         StdoutStream *s = userdata;
         struct ucred *ucred;
         struct iovec iovec;
         ssize_t l;
-        char *p;
+        char *p, *data;
         int r;
 
         struct msghdr msghdr = {
@@ -573,22 +586,23 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
                 goto terminate;
         }
 
-        /* If the buffer is almost full, add room for another 1K */
-        allocated = MALLOC_ELEMENTSOF(s->buffer);
-        if (s->length + 512 >= allocated) {
-                if (!GREEDY_REALLOC(s->buffer, s->length + 1 + 1024)) {
-                        log_oom();
-                        goto terminate;
-                }
+        /* All streams read into a buffer shared among them, and only the incomplete line that might remain
+         * at the end is kept in the stream's own buffer. This way idle streams don't tie up any buffer
+         * memory, no matter how many of them there are. Never read more than the configured line size
+         * (counting what's still pending), and always leave room for a terminating NUL we might need to
+         * add. */
+        limit = MAX(s->server->line_max, STDOUT_STREAM_SETUP_PROTOCOL_LINE_MAX);
+        assert(s->length < limit);
+        limit = MIN(limit, s->length + STDOUT_STREAM_READ_MAX);
 
-                allocated = MALLOC_ELEMENTSOF(s->buffer);
+        if (!GREEDY_REALLOC(s->server->stream_buffer, STDOUT_STREAM_HEADROOM + limit + 1)) {
+                log_oom();
+                goto terminate;
         }
 
-        /* Try to make use of the allocated buffer in full, but never read more than the configured line size. Also,
-         * always leave room for a terminating NUL we might need to add. */
-        limit = MIN(allocated - 1, MAX(s->server->line_max, STDOUT_STREAM_SETUP_PROTOCOL_LINE_MAX));
-        assert(s->length <= limit);
-        iovec = IOVEC_MAKE(s->buffer + s->length, limit - s->length);
+        data = s->server->stream_buffer + STDOUT_STREAM_HEADROOM;
+        memcpy_safe(data, s->buffer, s->length);
+        iovec = IOVEC_MAKE(data + s->length, limit - s->length);
 
         l = recvmsg(s->fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
         if (l < 0) {
@@ -601,7 +615,7 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
         cmsg_close_all(&msghdr);
 
         if (l == 0) {
-                (void) stdout_stream_scan(s, s->buffer, s->length, /* force_flush = */ LINE_BREAK_EOF, NULL);
+                (void) stdout_stream_scan(s, data, s->length, /* force_flush = */ LINE_BREAK_EOF, NULL);
                 goto terminate;
         }
 
@@ -612,15 +626,15 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
         if (ucred && ucred->pid != s->ucred.pid) {
                 /* Force out any previously half-written lines from a different process, before we switch to
                  * the new ucred structure for everything we just added */
-                r = stdout_stream_scan(s, s->buffer, s->length, /* force_flush = */ LINE_BREAK_PID_CHANGE, NULL);
+                r = stdout_stream_scan(s, data, s->length, /* force_flush = */ LINE_BREAK_PID_CHANGE, NULL);
                 if (r < 0)
                         goto terminate;
 
                 s->context = client_context_release(s->server, s->context);
 
-                p = s->buffer + s->length;
+                p = data + s->length;
         } else {
-                p = s->buffer;
+                p = data;
                 l += s->length;
         }
 
@@ -628,14 +642,27 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
         if (ucred)
                 s->ucred = *ucred;
 
+        /* A single read usually yields a bunch of lines, write them out together */
+        server_batch_begin(s->server);
         r = stdout_stream_scan(s, p, l, _LINE_BREAK_INVALID, &consumed);
+        server_batch_end(s->server);
         if (r < 0)
                 goto terminate;
 
-        /* Move what wasn't consumed to the front of the buffer */
+        /* Keep what wasn't consumed for the next time around, and release the stream's buffer if there's
+         * nothing left */
         assert(consumed <= (size_t) l);
         s->length = l - consumed;
-        memmove(s->buffer, p + consumed, s->length);
+        if (s->length == 0)
+                s->buffer = mfree(s->buffer);
+        else {
+                if (!GREEDY_REALLOC(s->buffer, s->length)) {
+                        log_oom();
+                        goto terminate;
+                }
+
+                memcpy(s->buffer, p + consumed, s->length);
+        }
 
         return 1;
 
@@ -726,7 +753,7 @@ static int stdout_stream_new(sd_event_source *es, int listen_fd, uint32_t revent
                 return log_error_errno(errno, "Failed to accept stdout connection: %m");
         }
 
-        if (s->n_stdout_streams >= STDOUT_STREAMS_MAX) {
+        if (s->n_stdout_streams >= s->stdout_streams_max) {
                 struct ucred u;
 
                 r = getpeercred(fd, &u);
@@ -831,7 +858,7 @@ static int stdout_stream_restore(Server *s, const char *fname, int fd) {
         assert(fname);
         assert(fd >= 0);
 
-        if (s->n_stdout_streams >= STDOUT_STREAMS_MAX) {
+        if (s->n_stdout_streams >= s->stdout_streams_max) {
                 log_warning("Too many stdout streams, refusing restoring of stream.");
                 return -ENOBUFS;
         }
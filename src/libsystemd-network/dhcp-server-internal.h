@@ -11,6 +11,7 @@
 #include "dhcp-internal.h"
 #include "ordered-set.h"
 #include "log-link.h"
+#include "prioq.h"
 #include "time-util.h"
 
 typedef enum DHCPRawOption {
@@ -30,12 +31,15 @@ typedef struct DHCPClientId {
 } DHCPClientId;
 
 typedef struct DHCPLease {
+        sd_dhcp_server *server; /* unset for static leases */
+
         DHCPClientId client_id;
 
         be32_t address;
         be32_t gateway;
         uint8_t chaddr[16];
         usec_t expiration;
+        unsigned expiration_prioq_idx;
 } DHCPLease;
 
 struct sd_dhcp_server {
@@ -69,9 +73,14 @@ struct sd_dhcp_server {
 
         Hashmap *leases_by_client_id;
         Hashmap *static_leases_by_client_id;
+        Hashmap *static_leases_by_address;
         DHCPLease **bound_leases;
+        uint64_t *bound_bitmap; /* one bit per pool address, set if bound_leases[] has an entry */
         DHCPLease invalid_lease;
 
+        Prioq *leases_by_expiration;
+        sd_event_source *lease_expiration_event_source;
+
         uint32_t max_lease_time, default_lease_time;
 
         sd_dhcp_server_callback_t callback;
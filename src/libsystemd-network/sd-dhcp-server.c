@@ -12,6 +12,7 @@
 #include "alloc-util.h"
 #include "dhcp-internal.h"
 #include "dhcp-server-internal.h"
+#include "event-util.h"
 #include "fd-util.h"
 #include "in-addr-util.h"
 #include "io-util.h"
@@ -24,10 +25,52 @@
 #define DHCP_DEFAULT_LEASE_TIME_USEC USEC_PER_HOUR
 #define DHCP_MAX_LEASE_TIME_USEC (USEC_PER_HOUR*12)
 
+static int get_pool_offset(sd_dhcp_server *server, be32_t requested_ip) {
+        assert(server);
+
+        if (!server->pool_size)
+                return -EINVAL;
+
+        if (be32toh(requested_ip) < (be32toh(server->subnet) | server->pool_offset) ||
+            be32toh(requested_ip) >= (be32toh(server->subnet) | (server->pool_offset + server->pool_size)))
+                return -ERANGE;
+
+        return be32toh(requested_ip & ~server->netmask) - server->pool_offset;
+}
+
+static void dhcp_server_bind(sd_dhcp_server *server, uint32_t offset, DHCPLease *lease) {
+        assert(server);
+        assert(offset < server->pool_size);
+        assert(lease);
+
+        server->bound_leases[offset] = lease;
+        server->bound_bitmap[offset / 64] |= UINT64_C(1) << (offset % 64);
+}
+
+static void dhcp_server_unbind(sd_dhcp_server *server, uint32_t offset) {
+        assert(server);
+        assert(offset < server->pool_size);
+
+        server->bound_leases[offset] = NULL;
+        server->bound_bitmap[offset / 64] &= ~(UINT64_C(1) << (offset % 64));
+}
+
 static DHCPLease *dhcp_lease_free(DHCPLease *lease) {
         if (!lease)
                 return NULL;
 
+        if (lease->server) {
+                int offset;
+
+                /* Release the address and forget about the expiration, so that nothing refers to the
+                 * lease anymore. */
+                offset = get_pool_offset(lease->server, lease->address);
+                if (offset >= 0 && lease->server->bound_leases[offset] == lease)
+                        dhcp_server_unbind(lease->server, offset);
+
+                prioq_remove(lease->server->leases_by_expiration, lease, &lease->expiration_prioq_idx);
+        }
+
         free(lease->client_id.data);
         return mfree(lease);
 }
@@ -84,12 +127,23 @@ int sd_dhcp_server_configure_pool(
                 size = size_max;
 
         if (server->address != address->s_addr || server->netmask != netmask || server->pool_size != size || server->pool_offset != offset) {
+                _cleanup_free_ DHCPLease **bound_leases = NULL;
+                _cleanup_free_ uint64_t *bound_bitmap = NULL;
 
-                free(server->bound_leases);
-                server->bound_leases = new0(DHCPLease*, size);
-                if (!server->bound_leases)
+                bound_leases = new0(DHCPLease*, size);
+                if (!bound_leases)
                         return -ENOMEM;
 
+                bound_bitmap = new0(uint64_t, DIV_ROUND_UP(size, 64));
+                if (!bound_bitmap)
+                        return -ENOMEM;
+
+                /* Drop any leases associated with the old address range, while they still refer to it */
+                hashmap_clear(server->leases_by_client_id);
+
+                free_and_replace(server->bound_leases, bound_leases);
+                free_and_replace(server->bound_bitmap, bound_bitmap);
+
                 server->pool_offset = offset;
                 server->pool_size = size;
 
@@ -97,11 +151,12 @@ int sd_dhcp_server_configure_pool(
                 server->netmask = netmask;
                 server->subnet = address->s_addr & netmask;
 
-                if (server_off >= offset && server_off - offset < size)
-                        server->bound_leases[server_off - offset] = &server->invalid_lease;
+                /* Mark the bits beyond the end of the pool as used, so that they are never picked */
+                if (size % 64 != 0)
+                        server->bound_bitmap[size / 64] = ~((UINT64_C(1) << (size % 64)) - 1);
 
-                /* Drop any leases associated with the old address range */
-                hashmap_clear(server->leases_by_client_id);
+                if (server_off >= offset && server_off - offset < size)
+                        dhcp_server_bind(server, server_off - offset, &server->invalid_lease);
 
                 if (server->callback)
                         server->callback(server, SD_DHCP_SERVER_EVENT_LEASE_CHANGED, server->callback_userdata);
@@ -154,6 +209,7 @@ static sd_dhcp_server *dhcp_server_free(sd_dhcp_server *server) {
 
         sd_dhcp_server_stop(server);
 
+        sd_event_source_disable_unref(server->lease_expiration_event_source);
         sd_event_unref(server->event);
 
         free(server->timezone);
@@ -163,6 +219,8 @@ static sd_dhcp_server *dhcp_server_free(sd_dhcp_server *server) {
 
         hashmap_free(server->leases_by_client_id);
         hashmap_free(server->static_leases_by_client_id);
+        hashmap_free(server->static_leases_by_address);
+        prioq_free(server->leases_by_expiration);
 
         ordered_set_free(server->extra_options);
         ordered_set_free(server->vendor_options);
@@ -171,6 +229,7 @@ static sd_dhcp_server *dhcp_server_free(sd_dhcp_server *server) {
         free(server->agent_remote_id);
 
         free(server->bound_leases);
+        free(server->bound_bitmap);
 
         free(server->ifname);
         return mfree(server);
@@ -722,19 +781,6 @@ static int ensure_sane_request(sd_dhcp_server *server, DHCPRequest *req, DHCPMes
         return 0;
 }
 
-static int get_pool_offset(sd_dhcp_server *server, be32_t requested_ip) {
-        assert(server);
-
-        if (!server->pool_size)
-                return -EINVAL;
-
-        if (be32toh(requested_ip) < (be32toh(server->subnet) | server->pool_offset) ||
-            be32toh(requested_ip) >= (be32toh(server->subnet) | (server->pool_offset + server->pool_size)))
-                return -ERANGE;
-
-        return be32toh(requested_ip & ~server->netmask) - server->pool_offset;
-}
-
 static int append_agent_information_option(sd_dhcp_server *server, DHCPMessage *message, size_t opt_length, size_t size) {
         int r;
         size_t offset;
@@ -809,6 +855,7 @@ static int dhcp_server_relay_message(sd_dhcp_server *server, DHCPMessage *messag
 }
 
 static int prepare_new_lease(
+                sd_dhcp_server *server,
                 DHCPLease **ret_lease,
                 be32_t address,
                 const DHCPClientId *client_id,
@@ -823,10 +870,12 @@ static int prepare_new_lease(
                 return -ENOMEM;
 
         *lease = (DHCPLease) {
+                .server = server,
                 .address = address,
                 .client_id.length = client_id->length,
                 .gateway = gateway,
                 .expiration = expiration,
+                .expiration_prioq_idx = PRIOQ_IDX_NULL,
         };
         lease->client_id.data = memdup(client_id->data, client_id->length);
         if (!lease->client_id.data)
@@ -840,15 +889,122 @@ static int prepare_new_lease(
 }
 
 static bool static_leases_have_address(sd_dhcp_server *server, be32_t address) {
-        DHCPLease *s;
+        assert(server);
+
+        return hashmap_contains(server->static_leases_by_address, UINT32_TO_PTR(address));
+}
+
+static int dhcp_server_find_free_offset(sd_dhcp_server *server, uint32_t start) {
+        uint64_t first_mask, mask;
+        size_t n_words, w;
+
+        assert(server);
+        assert(start < server->pool_size);
+
+        /* Returns the first free offset in the pool at or after start, wrapping around at the end of the
+         * pool. The bitmap lets us skip 64 bound addresses at a time, which matters for large pools. */
+
+        n_words = DIV_ROUND_UP(server->pool_size, 64);
+        w = start / 64;
+        first_mask = mask = ~((UINT64_C(1) << (start % 64)) - 1); /* only the bits at or after start first */
+
+        for (size_t i = 0; i <= n_words; i++) {
+                uint64_t free_bits = ~server->bound_bitmap[w] & mask;
+
+                while (free_bits != 0) {
+                        uint32_t offset = w * 64 + __builtin_ctzll(free_bits);
+
+                        if (!static_leases_have_address(server, server->subnet | htobe32(server->pool_offset + offset)))
+                                return offset;
+
+                        free_bits &= free_bits - 1;
+                }
+
+                w = (w + 1) % n_words;
+                /* When we are back at the word we started with, only the bits before start are left. */
+                mask = i + 1 == n_words ? ~first_mask : UINT64_MAX;
+        }
+
+        return -ENOSPC;
+}
+
+static int lease_expiration_compare(const void *a, const void *b) {
+        const DHCPLease *x = a, *y = b;
+
+        return CMP(x->expiration, y->expiration);
+}
+
+static int on_lease_expiration(sd_event_source *s, uint64_t usec, void *userdata);
+
+static int dhcp_server_arm_lease_expiration(sd_dhcp_server *server) {
+        DHCPLease *lease;
+
+        assert(server);
+
+        if (!server->event)
+                return 0;
+
+        lease = prioq_peek(server->leases_by_expiration);
+        if (!lease) {
+                if (server->lease_expiration_event_source)
+                        return sd_event_source_set_enabled(server->lease_expiration_event_source, SD_EVENT_OFF);
+                return 0;
+        }
+
+        return event_reset_time(server->event, &server->lease_expiration_event_source,
+                                clock_boottime_or_monotonic(),
+                                lease->expiration, 0,
+                                on_lease_expiration, server,
+                                server->event_priority, "dhcp4-server-lease-expiration", true);
+}
+
+static int on_lease_expiration(sd_event_source *s, uint64_t usec, void *userdata) {
+        sd_dhcp_server *server = userdata;
+        DHCPLease *lease;
+        bool changed = false;
+        int r;
+
+        assert(server);
+
+        while ((lease = prioq_peek(server->leases_by_expiration)) && lease->expiration <= usec) {
+                log_dhcp_server(server, "Lease of "IPV4_ADDRESS_FMT_STR" expired.",
+                                IPV4_ADDRESS_FMT_VAL((struct in_addr) { .s_addr = lease->address }));
+
+                assert_se(hashmap_remove(server->leases_by_client_id, &lease->client_id) == lease);
+                dhcp_lease_free(lease);
+                changed = true;
+        }
+
+        r = dhcp_server_arm_lease_expiration(server);
+        if (r < 0)
+                log_dhcp_server_errno(server, r, "Failed to schedule lease expiration, ignoring: %m");
+
+        if (changed && server->callback)
+                server->callback(server, SD_DHCP_SERVER_EVENT_LEASE_CHANGED, server->callback_userdata);
+
+        return 0;
+}
+
+static int dhcp_server_update_lease_expiration(sd_dhcp_server *server, DHCPLease *lease) {
+        int r;
 
         assert(server);
+        assert(lease);
+
+        /* Call this after a lease was saved or its expiration changed. */
+
+        if (lease->expiration_prioq_idx == PRIOQ_IDX_NULL) {
+                r = prioq_ensure_allocated(&server->leases_by_expiration, lease_expiration_compare);
+                if (r < 0)
+                        return r;
 
-        HASHMAP_FOREACH(s, server->static_leases_by_client_id)
-                if (s->address == address)
-                        return true;
+                r = prioq_put(server->leases_by_expiration, lease, &lease->expiration_prioq_idx);
+                if (r < 0)
+                        return r;
+        } else
+                (void) prioq_reshuffle(server->leases_by_expiration, lease, &lease->expiration_prioq_idx);
 
-        return false;
+        return dhcp_server_arm_lease_expiration(server);
 }
 
 #define HASH_KEY SD_ID128_MAKE(0d,1d,fe,bd,f1,24,bd,b3,47,f1,dd,6e,73,21,93,30)
@@ -887,7 +1043,6 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
 
         case DHCP_DISCOVER: {
                 be32_t address = INADDR_ANY;
-                unsigned i;
 
                 log_dhcp_server(server, "DISCOVER (0x%x)", be32toh(req->message->xid));
 
@@ -903,7 +1058,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
                 else {
                         struct siphash state;
                         uint64_t hash;
-                        uint32_t next_offer;
+                        int offset;
 
                         /* even with no persistence of leases, we try to offer the same client
                            the same IP address. we do this by using the hash of the client id
@@ -912,19 +1067,10 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
                         siphash24_init(&state, HASH_KEY.bytes);
                         client_id_hash_func(&req->client_id, &state);
                         hash = htole64(siphash24_finalize(&state));
-                        next_offer = hash % server->pool_size;
-
-                        for (i = 0; i < server->pool_size; i++) {
-                                if (!server->bound_leases[next_offer]) {
-                                        be32_t tmp = server->subnet | htobe32(server->pool_offset + next_offer);
-                                        if (!static_leases_have_address(server, tmp)) {
-                                                address = tmp;
-                                                break;
-                                        }
-                                }
-
-                                next_offer = (next_offer + 1) % server->pool_size;
-                        }
+
+                        offset = dhcp_server_find_free_offset(server, hash % server->pool_size);
+                        if (offset >= 0)
+                                address = server->subnet | htobe32(server->pool_offset + offset);
                 }
 
                 if (address == INADDR_ANY)
@@ -1010,7 +1156,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
 
                         expiration = usec_add(req->lifetime * USEC_PER_SEC, time_now);
 
-                        r = prepare_new_lease(&lease, static_lease->address, &req->client_id,
+                        r = prepare_new_lease(server, &lease, static_lease->address, &req->client_id,
                                               req->message->chaddr, req->message->giaddr, expiration);
                         if (r < 0)
                                 return r;
@@ -1022,13 +1168,16 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
 
                         log_dhcp_server(server, "ACK (0x%x)", be32toh(req->message->xid));
 
-                        server->bound_leases[pool_offset] = lease;
+                        dhcp_server_bind(server, pool_offset, lease);
 
                         old_lease = hashmap_remove(server->leases_by_client_id, &lease->client_id);
                         r = hashmap_put(server->leases_by_client_id, &lease->client_id, lease);
                         if (r < 0)
                                 return log_dhcp_server_errno(server, r, "Could not save lease: %m");
-                        TAKE_PTR(lease);
+
+                        r = dhcp_server_update_lease_expiration(server, TAKE_PTR(lease));
+                        if (r < 0)
+                                log_dhcp_server_errno(server, r, "Could not schedule lease expiration, ignoring: %m");
 
                         if (server->callback)
                                 server->callback(server, SD_DHCP_SERVER_EVENT_LEASE_CHANGED, server->callback_userdata);
@@ -1047,7 +1196,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
                         expiration = usec_add(req->lifetime * USEC_PER_SEC, time_now);
 
                         if (!existing_lease) {
-                                r = prepare_new_lease(&new_lease, address, &req->client_id,
+                                r = prepare_new_lease(server, &new_lease, address, &req->client_id,
                                                       req->message->chaddr, req->message->giaddr, expiration);
                                 if (r < 0)
                                         return r;
@@ -1065,12 +1214,16 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
 
                         log_dhcp_server(server, "ACK (0x%x)", be32toh(req->message->xid));
 
-                        server->bound_leases[pool_offset] = lease;
+                        dhcp_server_bind(server, pool_offset, lease);
                         r = hashmap_put(server->leases_by_client_id, &lease->client_id, lease);
                         if (r < 0)
                                 return log_dhcp_server_errno(server, r, "Could not save lease: %m");
                         TAKE_PTR(new_lease);
 
+                        r = dhcp_server_update_lease_expiration(server, lease);
+                        if (r < 0)
+                                log_dhcp_server_errno(server, r, "Could not schedule lease expiration, ignoring: %m");
+
                         if (server->callback)
                                 server->callback(server, SD_DHCP_SERVER_EVENT_LEASE_CHANGED, server->callback_userdata);
 
@@ -1106,9 +1259,9 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message, siz
                         return 0;
 
                 if (server->bound_leases[pool_offset] == existing_lease) {
-                        server->bound_leases[pool_offset] = NULL;
-                        hashmap_remove(server->leases_by_client_id, existing_lease);
+                        hashmap_remove(server->leases_by_client_id, &existing_lease->client_id);
                         dhcp_lease_free(existing_lease);
+                        (void) dhcp_server_arm_lease_expiration(server);
 
                         if (server->callback)
                                 server->callback(server, SD_DHCP_SERVER_EVENT_LEASE_CHANGED, server->callback_userdata);
@@ -1503,6 +1656,8 @@ int sd_dhcp_server_set_static_lease(
                 };
 
                 old = hashmap_remove(server->static_leases_by_client_id, &c);
+                if (old)
+                        hashmap_remove(server->static_leases_by_address, UINT32_TO_PTR(old->address));
                 return 0;
         }
 
@@ -1523,10 +1678,16 @@ int sd_dhcp_server_set_static_lease(
         if (!lease->client_id.data)
                 return -ENOMEM;
 
-        r = hashmap_ensure_put(&server->static_leases_by_client_id, &dhcp_lease_hash_ops, &lease->client_id, lease);
+        r = hashmap_ensure_put(&server->static_leases_by_address, NULL, UINT32_TO_PTR(lease->address), lease);
         if (r < 0)
                 return r;
 
+        r = hashmap_ensure_put(&server->static_leases_by_client_id, &dhcp_lease_hash_ops, &lease->client_id, lease);
+        if (r < 0) {
+                hashmap_remove(server->static_leases_by_address, UINT32_TO_PTR(lease->address));
+                return r;
+        }
+
         TAKE_PTR(lease);
         return 0;
 }
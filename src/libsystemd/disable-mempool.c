@@ -2,4 +2,6 @@
 
 #include "mempool.h"
 
+/* Memory taken by the pool is never returned, which is not something a library should do to the programs
+ * using it behind their back. Hence, this is opt-in via $SYSTEMD_MEMPOOL=1 here. */
 const bool mempool_use_allowed = false;
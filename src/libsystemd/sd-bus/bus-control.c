@@ -421,6 +421,123 @@ _public_ int sd_bus_list_names(sd_bus *bus, char ***acquired, char ***activatabl
         return 0;
 }
 
+/* The credentials the broker reports for a unique name are those of the peer at the time it connected, and
+ * unique names are never reused, hence they may be remembered for as long as the bus is around. Peers asking
+ * for polkit authorization or logind operations tend to call us many times in a row, and this saves a
+ * synchronous roundtrip to the broker for each of these calls. */
+#define NAME_CREDS_CACHE_MAX 1024U
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(name_creds_hash_ops, char, string_hash_func, string_compare_func,
+                                              sd_bus_creds, sd_bus_creds_unref);
+
+static int name_creds_cache_get(
+                sd_bus *bus,
+                const char *unique,
+                uint64_t mask,
+                bool need_pid,
+                bool need_uid,
+                bool need_selinux,
+                sd_bus_creds *c,
+                pid_t *pid) {
+
+        sd_bus_creds *cached;
+
+        assert(bus);
+        assert(c);
+        assert(pid);
+
+        if (!unique)
+                return 0;
+
+        cached = hashmap_get(bus->name_creds_cache, unique);
+        if (!cached)
+                return 0;
+
+        if ((need_pid && !(cached->mask & SD_BUS_CREDS_PID)) ||
+            (need_uid && !(cached->mask & SD_BUS_CREDS_EUID)) ||
+            (need_selinux && !(cached->mask & SD_BUS_CREDS_SELINUX_CONTEXT)))
+                return 0;
+
+        if (need_pid) {
+                *pid = cached->pid;
+                if (mask & SD_BUS_CREDS_PID) {
+                        c->pid = cached->pid;
+                        c->mask |= SD_BUS_CREDS_PID;
+                }
+        }
+
+        if (need_uid) {
+                c->euid = cached->euid;
+                c->mask |= SD_BUS_CREDS_EUID;
+        }
+
+        if (need_selinux) {
+                if (free_and_strdup(&c->label, cached->label) < 0)
+                        return -ENOMEM;
+
+                c->mask |= SD_BUS_CREDS_SELINUX_CONTEXT;
+        }
+
+        return 1;
+}
+
+static void name_creds_cache_put(sd_bus *bus, const char *unique, const sd_bus_creds *c, pid_t pid) {
+        _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *n = NULL;
+        sd_bus_creds *old;
+
+        assert(bus);
+        assert(unique);
+        assert(c);
+
+        /* This is merely an optimization, hence failures are silently ignored */
+
+        n = bus_creds_new();
+        if (!n)
+                return;
+
+        n->unique_name = strdup(unique);
+        if (!n->unique_name)
+                return;
+
+        /* Merge with whatever we learnt about this peer before */
+        old = hashmap_get(bus->name_creds_cache, unique);
+        if (old) {
+                n->mask = old->mask & (SD_BUS_CREDS_PID|SD_BUS_CREDS_EUID|SD_BUS_CREDS_SELINUX_CONTEXT);
+                n->pid = old->pid;
+                n->euid = old->euid;
+                if (old->label && !(n->label = strdup(old->label)))
+                        return;
+        }
+
+        if (pid > 0) {
+                n->pid = pid;
+                n->mask |= SD_BUS_CREDS_PID;
+        }
+
+        if (c->mask & SD_BUS_CREDS_EUID) {
+                n->euid = c->euid;
+                n->mask |= SD_BUS_CREDS_EUID;
+        }
+
+        if (c->mask & SD_BUS_CREDS_SELINUX_CONTEXT) {
+                if (free_and_strdup(&n->label, c->label) < 0)
+                        return;
+
+                n->mask |= SD_BUS_CREDS_SELINUX_CONTEXT;
+        }
+
+        if (n->mask == 0)
+                return;
+
+        if (old)
+                sd_bus_creds_unref(hashmap_remove(bus->name_creds_cache, unique));
+        else if (hashmap_size(bus->name_creds_cache) >= NAME_CREDS_CACHE_MAX)
+                hashmap_clear(bus->name_creds_cache);
+
+        if (hashmap_ensure_put(&bus->name_creds_cache, &name_creds_hash_ops, n->unique_name, n) >= 0)
+                TAKE_PTR(n);
+}
+
 _public_ int sd_bus_get_name_creds(
                 sd_bus *bus,
                 const char *name,
@@ -484,7 +601,7 @@ _public_ int sd_bus_get_name_creds(
 
         if (mask != 0) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
-                bool need_pid, need_uid, need_selinux, need_separate_calls;
+                bool need_pid, need_uid, need_selinux, need_separate_calls, need_cache_update = false;
 
                 c = bus_creds_new();
                 if (!c)
@@ -511,6 +628,14 @@ _public_ int sd_bus_get_name_creds(
                 need_uid = mask & SD_BUS_CREDS_EUID;
                 need_selinux = mask & SD_BUS_CREDS_SELINUX_CONTEXT;
 
+                r = name_creds_cache_get(bus, unique, mask, need_pid, need_uid, need_selinux, c, &pid);
+                if (r < 0)
+                        return r;
+                if (r > 0) /* Everything we need is known already, skip the calls below */
+                        need_pid = need_uid = need_selinux = false;
+                else
+                        need_cache_update = unique && (need_pid || need_uid || need_selinux);
+
                 if (need_pid + need_uid + need_selinux > 1) {
 
                         /* If we need more than one of the credentials, then use GetConnectionCredentials() */
@@ -711,6 +836,9 @@ _public_ int sd_bus_get_name_creds(
                         }
                 }
 
+                if (need_cache_update)
+                        name_creds_cache_put(bus, unique, c, pid);
+
                 r = bus_creds_add_more(c, mask, pid, 0);
                 if (r < 0 && r != -ESRCH) /* Return the error, but ignore ESRCH which just means the process is already gone */
                         return r;
@@ -9,6 +9,7 @@
 #include "bus-type.h"
 #include "cap-list.h"
 #include "capability-util.h"
+#include "errno-util.h"
 #include "fileio.h"
 #include "format-util.h"
 #include "locale-util.h"
@@ -591,5 +592,10 @@ int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
                 snaplen -= w;
         }
 
-        return fflush_and_check(f);
+        /* Don't flush here, frames are usually written in quick succession, and the caller flushes when
+         * there's nothing more to write for now. */
+        if (ferror(f))
+                return errno_or_else(EIO);
+
+        return 0;
 }
@@ -11,6 +11,7 @@
 #include "def.h"
 #include "hashmap.h"
 #include "list.h"
+#include "ordered-set.h"
 #include "prioq.h"
 #include "socket-util.h"
 #include "time-util.h"
@@ -43,6 +44,9 @@ struct match_callback {
 
         unsigned last_iteration;
 
+        /* How often the callback was invoked, so that the users can see how often a match hits */
+        uint64_t n_hits;
+
         /* Don't dispatch this slot with messages that arrived in any iteration before or at the this
          * one. We use this to ensure that matches don't apply "retroactively" and confuse the caller:
          * only messages received after the match was installed will be considered. */
@@ -190,6 +194,7 @@ struct sd_bus {
         int message_endian;
 
         bool can_fds:1;
+        bool can_memfd:1;
         bool bus_client:1;
         bool ucred_valid:1;
         bool is_server:1;
@@ -214,11 +219,13 @@ struct sd_bus {
         bool attach_timestamp:1;
         bool connected_signal:1;
         bool close_on_exit:1;
+        bool coalesce_properties_changed:1;
 
         signed int use_memfd:2;
 
         void *rbuffer;
         size_t rbuffer_size;
+        size_t rbuffer_fds_offset; /* Where in rbuffer the read that got us 'fds' started */
 
         sd_bus_message **rqueue;
         size_t rqueue_size;
@@ -242,6 +249,12 @@ struct sd_bus {
         Hashmap *vtable_methods;
         Hashmap *vtable_properties;
 
+        /* PropertiesChanged signals held back for coalescing, see sd_bus_set_coalesce_properties_changed() */
+        OrderedSet *pending_properties_changed;
+
+        /* Credentials the broker reported for unique names, see sd_bus_get_name_creds() */
+        Hashmap *name_creds_cache;
+
         union sockaddr_union sockaddr;
         socklen_t sockaddr_size;
 
@@ -257,7 +270,7 @@ struct sd_bus {
 
         enum bus_auth auth;
         unsigned auth_index;
-        struct iovec auth_iovec[3];
+        struct iovec auth_iovec[4];
         size_t auth_rbegin;
         char *auth_buffer;
         usec_t auth_timeout;
@@ -294,6 +307,7 @@ struct sd_bus {
         sd_event_source *output_io_event_source;
         sd_event_source *time_event_source;
         sd_event_source *quit_event_source;
+        sd_event_source *properties_changed_event_source;
         sd_event_source *inotify_event_source;
         sd_event *event;
         int event_priority;
@@ -333,6 +347,9 @@ struct sd_bus {
 #define BUS_RQUEUE_MAX (384*1024)
 
 #define BUS_MESSAGE_SIZE_MAX (128*1024*1024)
+/* How much to read from the socket at once, if we can. Chosen so that a burst of signals is picked up in
+ * a single read, instead of two reads per message. */
+#define BUS_RBUFFER_SIZE (16*1024)
 #define BUS_AUTH_SIZE_MAX (64*1024)
 /* Note that the D-Bus specification states that bus paths shall have no size limit. We enforce here one
  * anyway, since truly unbounded strings are a security problem. The limit we pick is relatively large however,
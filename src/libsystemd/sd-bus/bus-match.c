@@ -51,9 +51,17 @@ static bool BUS_MATCH_IS_COMPARE(enum bus_match_node_type t) {
         return t >= BUS_MATCH_SENDER && t <= BUS_MATCH_ARG_HAS_LAST;
 }
 
+static bool BUS_MATCH_IS_NAMESPACE(enum bus_match_node_type t) {
+        return t == BUS_MATCH_PATH_NAMESPACE ||
+                (t >= BUS_MATCH_ARG_NAMESPACE && t <= BUS_MATCH_ARG_NAMESPACE_LAST);
+}
+
 static bool BUS_MATCH_CAN_HASH(enum bus_match_node_type t) {
-        return (t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_PATH) ||
+        /* Namespace matches are hashed too, and looked up by all prefixes of the tested value that they
+         * could match, see bus_match_run_namespace(). */
+        return (t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_PATH_NAMESPACE) ||
                 (t >= BUS_MATCH_ARG && t <= BUS_MATCH_ARG_LAST) ||
+                (t >= BUS_MATCH_ARG_NAMESPACE && t <= BUS_MATCH_ARG_NAMESPACE_LAST) ||
                 (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST);
 }
 
@@ -183,15 +191,6 @@ static bool value_node_test(
                 return false;
         }
 
-        case BUS_MATCH_ARG_NAMESPACE ... BUS_MATCH_ARG_NAMESPACE_LAST:
-                if (value_str)
-                        return namespace_simple_pattern(node->value.str, value_str);
-
-                return false;
-
-        case BUS_MATCH_PATH_NAMESPACE:
-                return path_simple_pattern(node->value.str, value_str);
-
         case BUS_MATCH_ARG_PATH ... BUS_MATCH_ARG_PATH_LAST:
                 if (value_str)
                         return path_complex_pattern(node->value.str, value_str);
@@ -238,6 +237,58 @@ static bool value_node_same(
         }
 }
 
+static int bus_match_run_namespace(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *test_str,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *prefix = NULL;
+        size_t n;
+        char c;
+        int r;
+
+        assert(node);
+        assert(BUS_MATCH_IS_NAMESPACE(node->type));
+        assert(test_str);
+
+        /* A namespace pattern matches if it is the tested value itself, or a prefix of it that ends right
+         * before or right after a separator, see simple_pattern_check(). Hence, instead of testing every
+         * pattern, look up exactly these prefixes, which are few, regardless of the number of patterns. */
+
+        c = node->type == BUS_MATCH_PATH_NAMESPACE ? '/' : '.';
+
+        prefix = strdup(test_str);
+        if (!prefix)
+                return -ENOMEM;
+
+        n = strlen(prefix);
+        for (size_t i = 1; i <= n; i++) {
+                struct bus_match_node *found;
+                char saved;
+
+                if (i < n && test_str[i] != c && test_str[i-1] != c)
+                        continue;
+
+                saved = prefix[i];
+                prefix[i] = 0;
+                found = hashmap_get(node->compare.children, prefix);
+                prefix[i] = saved;
+
+                if (!found)
+                        continue;
+
+                r = bus_match_run(bus, found, m);
+                if (r != 0)
+                        return r;
+
+                if (bus && bus->match_callbacks_modified)
+                        return 0;
+        }
+
+        return 0;
+}
+
 int bus_match_run(
                 sd_bus *bus,
                 struct bus_match_node *node,
@@ -300,6 +351,8 @@ int bus_match_run(
                         node->leaf.callback->last_iteration = bus->iteration_counter;
                 }
 
+                node->leaf.callback->n_hits++;
+
                 r = sd_bus_message_rewind(m, true);
                 if (r < 0)
                         return r;
@@ -383,7 +436,13 @@ int bus_match_run(
 
                 /* Lookup via hash table, nice! So let's jump directly. */
 
-                if (test_str)
+                if (test_str && BUS_MATCH_IS_NAMESPACE(node->type)) {
+                        r = bus_match_run_namespace(bus, node, test_str, m);
+                        if (r != 0)
+                                return r;
+
+                        found = NULL;
+                } else if (test_str)
                         found = hashmap_get(node->compare.children, test_str);
                 else if (test_strv) {
                         char **i;
@@ -1033,8 +1092,9 @@ void bus_match_dump(FILE *out, struct bus_match_node *node, unsigned level) {
         } else if (node->type == BUS_MATCH_ROOT)
                 fputs(" root\n", out);
         else if (node->type == BUS_MATCH_LEAF)
-                fprintf(out, " %p/%p\n", node->leaf.callback->callback,
-                        container_of(node->leaf.callback, sd_bus_slot, match_callback)->userdata);
+                fprintf(out, " %p/%p hits=%" PRIu64 "\n", node->leaf.callback->callback,
+                        container_of(node->leaf.callback, sd_bus_slot, match_callback)->userdata,
+                        node->leaf.callback->n_hits);
         else
                 putc('\n', out);
 
@@ -577,6 +577,92 @@ int bus_message_from_malloc(
         return 0;
 }
 
+int bus_message_from_memfd(
+                sd_bus *bus,
+                void *buffer,
+                size_t length,
+                int memfd,
+                int *fds,
+                size_t n_fds,
+                const char *label,
+                sd_bus_message **ret) {
+
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_close_ int fd = memfd;
+        struct bus_header *h = buffer;
+        uint64_t size;
+        uint32_t body_size;
+        int r;
+
+        assert(bus);
+        assert(memfd >= 0);
+        assert(ret);
+
+        /* Like bus_message_from_malloc(), but the buffer only contains the header and the fields, and the
+         * body is in a sealed memfd, which we map. Takes possession of the memfd in any case. */
+
+        if (length < sizeof(struct bus_header))
+                return -EBADMSG;
+
+        if (h->version != 1)
+                return -EBADMSG;
+
+        if (h->endian == BUS_LITTLE_ENDIAN)
+                body_size = le32toh(h->dbus1.body_size);
+        else if (h->endian == BUS_BIG_ENDIAN)
+                body_size = be32toh(h->dbus1.body_size);
+        else
+                return -EBADMSG;
+
+        if (body_size == 0 || (uint64_t) length + body_size >= BUS_MESSAGE_SIZE_MAX)
+                return -EBADMSG;
+
+        /* Only accept memfds that can neither be modified nor truncated anymore by the sender */
+        if (memfd_get_sealed(fd) <= 0)
+                return -EBADMSG;
+
+        r = memfd_get_size(fd, &size);
+        if (r < 0)
+                return -EBADMSG;
+        if (size < body_size)
+                return -EBADMSG;
+
+        r = bus_message_from_header(
+                        bus,
+                        buffer, length,
+                        buffer, length,
+                        length + body_size,
+                        fds, n_fds,
+                        label,
+                        0, &m);
+        if (r < 0)
+                return r;
+
+        /* This flag only describes how the message was transferred, drop it, so that the message looks
+         * like any other if it is forwarded. */
+        h->flags &= ~BUS_MESSAGE_MEMFD_BODY;
+
+        m->n_body_parts = 1;
+        m->body.memfd = TAKE_FD(fd);
+        m->body.size = body_size;
+        m->body.sealed = true;
+
+        r = bus_body_part_map(&m->body);
+        if (r < 0)
+                return r;
+
+        r = bus_message_parse_fields(m);
+        if (r < 0)
+                return r;
+
+        /* We take possession of the memory and fds now */
+        m->free_header = true;
+        m->free_fds = true;
+
+        *ret = TAKE_PTR(m);
+        return 0;
+}
+
 _public_ int sd_bus_message_new(
                 sd_bus *bus,
                 sd_bus_message **m,
@@ -1881,10 +1967,19 @@ static int bus_message_open_variant(
         return 0;
 }
 
+/* Properties of a struct or dict entry that only depend on its contents, and may hence be determined
+ * once in advance, see bus_compiled_signature_new(). */
+typedef struct BusContainerInfo {
+        size_t contents_length;
+        int alignment;  /* GVariant only */
+        int fixed_size; /* GVariant only */
+} BusContainerInfo;
+
 static int bus_message_open_struct(
                 sd_bus_message *m,
                 struct bus_container *c,
                 const char *contents,
+                const BusContainerInfo *info,
                 size_t *begin,
                 bool *need_offsets) {
 
@@ -1897,13 +1992,14 @@ static int bus_message_open_struct(
         assert(begin);
         assert(need_offsets);
 
-        if (!signature_is_valid(contents, false))
+        /* If the container info is known, the contents were validated already */
+        if (!info && !signature_is_valid(contents, false))
                 return -EINVAL;
 
         if (c->signature && c->signature[c->index]) {
                 size_t l;
 
-                l = strlen(contents);
+                l = info ? info->contents_length : strlen(contents);
 
                 if (c->signature[c->index] != SD_BUS_TYPE_STRUCT_BEGIN ||
                     !startswith(c->signature + c->index + 1, contents) ||
@@ -1929,14 +2025,14 @@ static int bus_message_open_struct(
         if (BUS_MESSAGE_IS_GVARIANT(m)) {
                 int alignment;
 
-                alignment = bus_gvariant_get_alignment(contents);
+                alignment = info ? info->alignment : bus_gvariant_get_alignment(contents);
                 if (alignment < 0)
                         return alignment;
 
                 if (!message_extend_body(m, alignment, 0, false, false))
                         return -ENOMEM;
 
-                r = bus_gvariant_is_fixed_size(contents);
+                r = info ? info->fixed_size : bus_gvariant_is_fixed_size(contents);
                 if (r < 0)
                         return r;
 
@@ -1958,6 +2054,7 @@ static int bus_message_open_dict_entry(
                 sd_bus_message *m,
                 struct bus_container *c,
                 const char *contents,
+                const BusContainerInfo *info,
                 size_t *begin,
                 bool *need_offsets) {
 
@@ -1969,7 +2066,7 @@ static int bus_message_open_dict_entry(
         assert(begin);
         assert(need_offsets);
 
-        if (!signature_is_pair(contents))
+        if (!info && !signature_is_pair(contents))
                 return -EINVAL;
 
         if (c->enclosing != SD_BUS_TYPE_ARRAY)
@@ -1978,7 +2075,7 @@ static int bus_message_open_dict_entry(
         if (c->signature && c->signature[c->index]) {
                 size_t l;
 
-                l = strlen(contents);
+                l = info ? info->contents_length : strlen(contents);
 
                 if (c->signature[c->index] != SD_BUS_TYPE_DICT_ENTRY_BEGIN ||
                     !startswith(c->signature + c->index + 1, contents) ||
@@ -1990,14 +2087,14 @@ static int bus_message_open_dict_entry(
         if (BUS_MESSAGE_IS_GVARIANT(m)) {
                 int alignment;
 
-                alignment = bus_gvariant_get_alignment(contents);
+                alignment = info ? info->alignment : bus_gvariant_get_alignment(contents);
                 if (alignment < 0)
                         return alignment;
 
                 if (!message_extend_body(m, alignment, 0, false, false))
                         return -ENOMEM;
 
-                r = bus_gvariant_is_fixed_size(contents);
+                r = info ? info->fixed_size : bus_gvariant_is_fixed_size(contents);
                 if (r < 0)
                         return r;
 
@@ -2012,10 +2109,11 @@ static int bus_message_open_dict_entry(
         return 0;
 }
 
-_public_ int sd_bus_message_open_container(
+static int message_open_container(
                 sd_bus_message *m,
                 char type,
-                const char *contents) {
+                const char *contents,
+                const BusContainerInfo *info) {
 
         struct bus_container *c;
         uint32_t *array_size = NULL;
@@ -2024,10 +2122,9 @@ _public_ int sd_bus_message_open_container(
         bool need_offsets = false;
         int r;
 
-        assert_return(m, -EINVAL);
-        assert_return(!m->sealed, -EPERM);
-        assert_return(contents, -EINVAL);
-        assert_return(!m->poisoned, -ESTALE);
+        assert(m);
+        assert(contents);
+        assert(!info || IN_SET(type, SD_BUS_TYPE_STRUCT, SD_BUS_TYPE_DICT_ENTRY));
 
         /* Make sure we have space for one more container */
         if (!GREEDY_REALLOC(m->containers, m->n_containers + 1)) {
@@ -2053,9 +2150,9 @@ _public_ int sd_bus_message_open_container(
         else if (type == SD_BUS_TYPE_VARIANT)
                 r = bus_message_open_variant(m, c, contents);
         else if (type == SD_BUS_TYPE_STRUCT)
-                r = bus_message_open_struct(m, c, contents, &begin, &need_offsets);
+                r = bus_message_open_struct(m, c, contents, info, &begin, &need_offsets);
         else if (type == SD_BUS_TYPE_DICT_ENTRY)
-                r = bus_message_open_dict_entry(m, c, contents, &begin, &need_offsets);
+                r = bus_message_open_dict_entry(m, c, contents, info, &begin, &need_offsets);
         else
                 r = -EINVAL;
         if (r < 0)
@@ -2074,6 +2171,19 @@ _public_ int sd_bus_message_open_container(
         return 0;
 }
 
+_public_ int sd_bus_message_open_container(
+                sd_bus_message *m,
+                char type,
+                const char *contents) {
+
+        assert_return(m, -EINVAL);
+        assert_return(!m->sealed, -EPERM);
+        assert_return(contents, -EINVAL);
+        assert_return(!m->poisoned, -ESTALE);
+
+        return message_open_container(m, type, contents, NULL);
+}
+
 static int bus_message_close_array(sd_bus_message *m, struct bus_container *c) {
 
         assert(m);
@@ -2322,20 +2432,82 @@ static int type_stack_pop(TypeStack *stack, unsigned max, unsigned *i, const cha
         return 1;
 }
 
-_public_ int sd_bus_message_appendv(
+static int message_append_basic_va(sd_bus_message *m, char type, va_list *ap) {
+        assert(m);
+        assert(ap);
+
+        switch (type) {
+
+        case SD_BUS_TYPE_BYTE: {
+                uint8_t x;
+
+                x = (uint8_t) va_arg(*ap, int);
+                return sd_bus_message_append_basic(m, type, &x);
+        }
+
+        case SD_BUS_TYPE_BOOLEAN:
+        case SD_BUS_TYPE_INT32:
+        case SD_BUS_TYPE_UINT32:
+        case SD_BUS_TYPE_UNIX_FD: {
+                uint32_t x;
+
+                /* We assume a boolean is the same as int32_t */
+                assert_cc(sizeof(int32_t) == sizeof(int));
+
+                x = va_arg(*ap, uint32_t);
+                return sd_bus_message_append_basic(m, type, &x);
+        }
+
+        case SD_BUS_TYPE_INT16:
+        case SD_BUS_TYPE_UINT16: {
+                uint16_t x;
+
+                x = (uint16_t) va_arg(*ap, int);
+                return sd_bus_message_append_basic(m, type, &x);
+        }
+
+        case SD_BUS_TYPE_INT64:
+        case SD_BUS_TYPE_UINT64: {
+                uint64_t x;
+
+                x = va_arg(*ap, uint64_t);
+                return sd_bus_message_append_basic(m, type, &x);
+        }
+
+        case SD_BUS_TYPE_DOUBLE: {
+                double x;
+
+                x = va_arg(*ap, double);
+                return sd_bus_message_append_basic(m, type, &x);
+        }
+
+        case SD_BUS_TYPE_STRING:
+        case SD_BUS_TYPE_OBJECT_PATH:
+        case SD_BUS_TYPE_SIGNATURE: {
+                const char *x;
+
+                x = va_arg(*ap, const char*);
+                return sd_bus_message_append_basic(m, type, x);
+        }
+
+        default:
+                return -EINVAL;
+        }
+}
+
+static int message_appendv(
                 sd_bus_message *m,
                 const char *types,
-                va_list ap) {
+                va_list *ap) {
 
         unsigned n_array, n_struct;
         TypeStack stack[BUS_CONTAINER_DEPTH];
         unsigned stack_ptr = 0;
         int r;
 
-        assert_return(m, -EINVAL);
-        assert_return(types, -EINVAL);
-        assert_return(!m->sealed, -EPERM);
-        assert_return(!m->poisoned, -ESTALE);
+        assert(m);
+        assert(types);
+        assert(ap);
 
         n_array = UINT_MAX;
         n_struct = strlen(types);
@@ -2367,64 +2539,6 @@ _public_ int sd_bus_message_appendv(
 
                 switch (*t) {
 
-                case SD_BUS_TYPE_BYTE: {
-                        uint8_t x;
-
-                        x = (uint8_t) va_arg(ap, int);
-                        r = sd_bus_message_append_basic(m, *t, &x);
-                        break;
-                }
-
-                case SD_BUS_TYPE_BOOLEAN:
-                case SD_BUS_TYPE_INT32:
-                case SD_BUS_TYPE_UINT32:
-                case SD_BUS_TYPE_UNIX_FD: {
-                        uint32_t x;
-
-                        /* We assume a boolean is the same as int32_t */
-                        assert_cc(sizeof(int32_t) == sizeof(int));
-
-                        x = va_arg(ap, uint32_t);
-                        r = sd_bus_message_append_basic(m, *t, &x);
-                        break;
-                }
-
-                case SD_BUS_TYPE_INT16:
-                case SD_BUS_TYPE_UINT16: {
-                        uint16_t x;
-
-                        x = (uint16_t) va_arg(ap, int);
-                        r = sd_bus_message_append_basic(m, *t, &x);
-                        break;
-                }
-
-                case SD_BUS_TYPE_INT64:
-                case SD_BUS_TYPE_UINT64: {
-                        uint64_t x;
-
-                        x = va_arg(ap, uint64_t);
-                        r = sd_bus_message_append_basic(m, *t, &x);
-                        break;
-                }
-
-                case SD_BUS_TYPE_DOUBLE: {
-                        double x;
-
-                        x = va_arg(ap, double);
-                        r = sd_bus_message_append_basic(m, *t, &x);
-                        break;
-                }
-
-                case SD_BUS_TYPE_STRING:
-                case SD_BUS_TYPE_OBJECT_PATH:
-                case SD_BUS_TYPE_SIGNATURE: {
-                        const char *x;
-
-                        x = va_arg(ap, const char*);
-                        r = sd_bus_message_append_basic(m, *t, x);
-                        break;
-                }
-
                 case SD_BUS_TYPE_ARRAY: {
                         size_t k;
 
@@ -2453,7 +2567,7 @@ _public_ int sd_bus_message_appendv(
 
                         types = t + 1;
                         n_struct = k;
-                        n_array = va_arg(ap, unsigned);
+                        n_array = va_arg(*ap, unsigned);
 
                         break;
                 }
@@ -2461,7 +2575,7 @@ _public_ int sd_bus_message_appendv(
                 case SD_BUS_TYPE_VARIANT: {
                         const char *s;
 
-                        s = va_arg(ap, const char*);
+                        s = va_arg(*ap, const char*);
                         if (!s)
                                 return -EINVAL;
 
@@ -2516,7 +2630,7 @@ _public_ int sd_bus_message_appendv(
                 }
 
                 default:
-                        r = -EINVAL;
+                        r = message_append_basic_va(m, *t, ap);
                 }
 
                 if (r < 0)
@@ -2526,17 +2640,174 @@ _public_ int sd_bus_message_appendv(
         return 1;
 }
 
+_public_ int sd_bus_message_appendv(
+                sd_bus_message *m,
+                const char *types,
+                va_list ap) {
+
+        va_list aq;
+        int r;
+
+        assert_return(m, -EINVAL);
+        assert_return(types, -EINVAL);
+        assert_return(!m->sealed, -EPERM);
+        assert_return(!m->poisoned, -ESTALE);
+
+        va_copy(aq, ap);
+        r = message_appendv(m, types, &aq);
+        va_end(aq);
+
+        return r;
+}
+
 _public_ int sd_bus_message_append(sd_bus_message *m, const char *types, ...) {
         va_list ap;
         int r;
 
+        assert_return(m, -EINVAL);
+        assert_return(types, -EINVAL);
+        assert_return(!m->sealed, -EPERM);
+        assert_return(!m->poisoned, -ESTALE);
+
         va_start(ap, types);
-        r = sd_bus_message_appendv(m, types, ap);
+        r = message_appendv(m, types, &ap);
         va_end(ap);
 
         return r;
 }
 
+struct BusCompiledSignature {
+        size_t n_ops;
+        struct {
+                /* A basic type, SD_BUS_TYPE_STRUCT or SD_BUS_TYPE_DICT_ENTRY to open a container, or 0 to
+                 * close the innermost one */
+                char type;
+                char *contents;
+                BusContainerInfo info;
+        } ops[];
+};
+
+BusCompiledSignature* bus_compiled_signature_free(BusCompiledSignature *s) {
+        if (!s)
+                return NULL;
+
+        for (size_t i = 0; i < s->n_ops; i++)
+                free(s->ops[i].contents);
+
+        return mfree(s);
+}
+
+int bus_compiled_signature_new(const char *types, BusCompiledSignature **ret) {
+        _cleanup_(bus_compiled_signature_freep) BusCompiledSignature *s = NULL;
+        unsigned depth = 0;
+        int r;
+
+        assert(types);
+        assert(ret);
+
+        /* Turns a signature into a list of append operations once, so that many values of the same type
+         * may be appended with bus_message_append_compiled() without parsing and validating the signature
+         * again and again. Only basic types, structs and dict entries are supported: arrays and variants
+         * take their size and contents signature as arguments, which hence can't be determined in
+         * advance. Each character of the signature corresponds to one operation. */
+
+        s = malloc0(offsetof(BusCompiledSignature, ops) + strlen(types) * sizeof(s->ops[0]));
+        if (!s)
+                return -ENOMEM;
+
+        for (const char *t = types; *t; t++) {
+                typeof(s->ops[0]) *op = s->ops + s->n_ops;
+
+                if (bus_type_is_basic(*t))
+                        op->type = *t;
+
+                else if (IN_SET(*t, SD_BUS_TYPE_STRUCT_BEGIN, SD_BUS_TYPE_DICT_ENTRY_BEGIN)) {
+                        size_t k;
+
+                        if (depth >= BUS_CONTAINER_DEPTH)
+                                return -EINVAL;
+
+                        r = signature_element_length(t, &k);
+                        if (r < 0)
+                                return r;
+
+                        op->contents = strndup(t + 1, k - 2);
+                        if (!op->contents)
+                                return -ENOMEM;
+
+                        if (*t == SD_BUS_TYPE_STRUCT_BEGIN) {
+                                op->type = SD_BUS_TYPE_STRUCT;
+                                if (!signature_is_valid(op->contents, false))
+                                        return -EINVAL;
+                        } else {
+                                op->type = SD_BUS_TYPE_DICT_ENTRY;
+                                if (!signature_is_pair(op->contents))
+                                        return -EINVAL;
+                        }
+
+                        op->info.contents_length = k - 2;
+
+                        op->info.alignment = bus_gvariant_get_alignment(op->contents);
+                        if (op->info.alignment < 0)
+                                return op->info.alignment;
+
+                        op->info.fixed_size = bus_gvariant_is_fixed_size(op->contents);
+                        if (op->info.fixed_size < 0)
+                                return op->info.fixed_size;
+
+                        depth++;
+
+                } else if (IN_SET(*t, SD_BUS_TYPE_STRUCT_END, SD_BUS_TYPE_DICT_ENTRY_END)) {
+                        if (depth == 0)
+                                return -EINVAL;
+
+                        op->type = 0;
+                        depth--;
+
+                } else if (IN_SET(*t, SD_BUS_TYPE_ARRAY, SD_BUS_TYPE_VARIANT))
+                        return -EOPNOTSUPP;
+                else
+                        return -EINVAL;
+
+                s->n_ops++;
+        }
+
+        if (s->n_ops == 0)
+                return -EINVAL;
+
+        *ret = TAKE_PTR(s);
+        return 0;
+}
+
+int bus_message_append_compiled(sd_bus_message *m, const BusCompiledSignature *s, ...) {
+        va_list ap;
+        int r = 0;
+
+        assert(m);
+        assert(s);
+
+        if (m->sealed)
+                return -EPERM;
+        if (m->poisoned)
+                return -ESTALE;
+
+        va_start(ap, s);
+
+        for (size_t i = 0; i < s->n_ops; i++) {
+                if (s->ops[i].type == 0)
+                        r = sd_bus_message_close_container(m);
+                else if (IN_SET(s->ops[i].type, SD_BUS_TYPE_STRUCT, SD_BUS_TYPE_DICT_ENTRY))
+                        r = message_open_container(m, s->ops[i].type, s->ops[i].contents, &s->ops[i].info);
+                else
+                        r = message_append_basic_va(m, s->ops[i].type, &ap);
+                if (r < 0)
+                        break;
+        }
+
+        va_end(ap);
+        return r;
+}
+
 _public_ int sd_bus_message_append_array_space(
                 sd_bus_message *m,
                 char type,
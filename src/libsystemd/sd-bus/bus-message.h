@@ -200,6 +200,16 @@ int bus_message_from_malloc(
                 const char *label,
                 sd_bus_message **ret);
 
+int bus_message_from_memfd(
+                sd_bus *bus,
+                void *buffer,
+                size_t length,
+                int memfd,
+                int *fds,
+                size_t n_fds,
+                const char *label,
+                sd_bus_message **ret);
+
 int bus_message_get_arg(sd_bus_message *m, unsigned i, const char **str);
 int bus_message_get_arg_strv(sd_bus_message *m, unsigned i, char ***strv);
 
@@ -222,5 +232,13 @@ int bus_message_remarshal(sd_bus *bus, sd_bus_message **m);
 void bus_message_set_sender_driver(sd_bus *bus, sd_bus_message *m);
 void bus_message_set_sender_local(sd_bus *bus, sd_bus_message *m);
 
+typedef struct BusCompiledSignature BusCompiledSignature;
+
+int bus_compiled_signature_new(const char *types, BusCompiledSignature **ret);
+BusCompiledSignature* bus_compiled_signature_free(BusCompiledSignature *s);
+DEFINE_TRIVIAL_CLEANUP_FUNC(BusCompiledSignature*, bus_compiled_signature_free);
+
+int bus_message_append_compiled(sd_bus_message *m, const BusCompiledSignature *s, ...);
+
 sd_bus_message* bus_message_ref_queued(sd_bus_message *m, sd_bus *bus);
 sd_bus_message* bus_message_unref_queued(sd_bus_message *m, sd_bus *bus);
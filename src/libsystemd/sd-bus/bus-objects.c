@@ -2267,7 +2267,7 @@ static int emit_properties_changed_on_interface(
         return 1;
 }
 
-_public_ int sd_bus_emit_properties_changed_strv(
+static int emit_properties_changed_now(
                 sd_bus *bus,
                 const char *path,
                 const char *interface,
@@ -2278,21 +2278,9 @@ _public_ int sd_bus_emit_properties_changed_strv(
         size_t pl;
         int r;
 
-        assert_return(bus, -EINVAL);
-        assert_return(bus = bus_resolve(bus), -ENOPKG);
-        assert_return(object_path_is_valid(path), -EINVAL);
-        assert_return(interface_name_is_valid(interface), -EINVAL);
-        assert_return(!bus_pid_changed(bus), -ECHILD);
-
-        if (!BUS_IS_OPEN(bus->state))
-                return -ENOTCONN;
-
-        /* A non-NULL but empty names list means nothing needs to be
-           generated. A NULL list OTOH indicates that all properties
-           that are set to EMITS_CHANGE or EMITS_INVALIDATION shall be
-           included in the PropertiesChanged message. */
-        if (names && names[0] == NULL)
-                return 0;
+        assert(bus);
+        assert(path);
+        assert(interface);
 
         BUS_DONT_DESTROY(bus);
 
@@ -2324,6 +2312,188 @@ _public_ int sd_bus_emit_properties_changed_strv(
         return found_interface ? 0 : -ENOENT;
 }
 
+typedef struct PendingPropertiesChanged {
+        char *path;
+        char *interface;
+        char **names; /* NULL if all properties changed */
+        bool all;
+} PendingPropertiesChanged;
+
+static PendingPropertiesChanged* pending_properties_changed_free(PendingPropertiesChanged *p) {
+        if (!p)
+                return NULL;
+
+        free(p->path);
+        free(p->interface);
+        strv_free(p->names);
+        return mfree(p);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(PendingPropertiesChanged*, pending_properties_changed_free);
+
+static void pending_properties_changed_hash_func(const PendingPropertiesChanged *p, struct siphash *state) {
+        assert(p);
+
+        string_hash_func(p->path, state);
+        string_hash_func(p->interface, state);
+}
+
+static int pending_properties_changed_compare_func(const PendingPropertiesChanged *x, const PendingPropertiesChanged *y) {
+        int r;
+
+        assert(x);
+        assert(y);
+
+        r = strcmp(x->path, y->path);
+        if (r != 0)
+                return r;
+
+        return strcmp(x->interface, y->interface);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(
+                pending_properties_changed_hash_ops,
+                PendingPropertiesChanged,
+                pending_properties_changed_hash_func,
+                pending_properties_changed_compare_func,
+                pending_properties_changed_free);
+
+int bus_emit_pending_properties_changed(sd_bus *bus) {
+        int ret = 0;
+
+        assert(bus);
+
+        /* Sends out all PropertiesChanged signals we held back so far, one per object and interface, in
+         * the order the first change was queued for them. */
+
+        for (;;) {
+                _cleanup_(pending_properties_changed_freep) PendingPropertiesChanged *p = NULL;
+                int r;
+
+                if (!BUS_IS_OPEN(bus->state)) {
+                        bus->pending_properties_changed = ordered_set_free(bus->pending_properties_changed);
+                        break;
+                }
+
+                p = ordered_set_steal_first(bus->pending_properties_changed);
+                if (!p)
+                        break;
+
+                r = emit_properties_changed_now(bus, p->path, p->interface, p->all ? NULL : p->names);
+                if (r < 0) {
+                        /* The object might very well be gone by now, which is not worth complaining about */
+                        log_debug_errno(r, "Failed to emit PropertiesChanged signal for %s on %s, ignoring: %m",
+                                        p->interface, p->path);
+                        if (ret == 0 && r != -ENOENT)
+                                ret = r;
+                }
+        }
+
+        return ret;
+}
+
+static int properties_changed_callback(sd_event_source *s, void *userdata) {
+        sd_bus *bus = userdata;
+
+        assert(bus);
+
+        (void) bus_emit_pending_properties_changed(bus);
+        return 0;
+}
+
+static int queue_properties_changed(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                char **names) {
+
+        PendingPropertiesChanged *p;
+        int r;
+
+        assert(bus);
+        assert(bus->event);
+        assert(path);
+        assert(interface);
+
+        p = ordered_set_get(bus->pending_properties_changed,
+                            &(PendingPropertiesChanged) {
+                                    .path = (char*) path,
+                                    .interface = (char*) interface,
+                            });
+        if (!p) {
+                _cleanup_(pending_properties_changed_freep) PendingPropertiesChanged *n = NULL;
+
+                n = new0(PendingPropertiesChanged, 1);
+                if (!n)
+                        return -ENOMEM;
+
+                n->path = strdup(path);
+                n->interface = strdup(interface);
+                if (!n->path || !n->interface)
+                        return -ENOMEM;
+
+                r = ordered_set_ensure_put(&bus->pending_properties_changed, &pending_properties_changed_hash_ops, n);
+                if (r < 0)
+                        return r;
+
+                p = TAKE_PTR(n);
+        }
+
+        if (!names) {
+                p->all = true;
+                p->names = strv_free(p->names);
+        } else if (!p->all) {
+                r = strv_extend_strv(&p->names, names, /* filter_duplicates= */ true);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!bus->properties_changed_event_source) {
+                r = sd_event_add_defer(bus->event, &bus->properties_changed_event_source, properties_changed_callback, bus);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_priority(bus->properties_changed_event_source, bus->event_priority);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(bus->properties_changed_event_source, "bus-properties-changed");
+                return 0;
+        }
+
+        return sd_event_source_set_enabled(bus->properties_changed_event_source, SD_EVENT_ONESHOT);
+}
+
+_public_ int sd_bus_emit_properties_changed_strv(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                char **names) {
+
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(object_path_is_valid(path), -EINVAL);
+        assert_return(interface_name_is_valid(interface), -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        if (!BUS_IS_OPEN(bus->state))
+                return -ENOTCONN;
+
+        /* A non-NULL but empty names list means nothing needs to be
+           generated. A NULL list OTOH indicates that all properties
+           that are set to EMITS_CHANGE or EMITS_INVALIDATION shall be
+           included in the PropertiesChanged message. */
+        if (names && names[0] == NULL)
+                return 0;
+
+        /* If requested, merge all changes of an object's interface until the event loop gets around to
+         * run the next time, and only send a single signal then. */
+        if (bus->coalesce_properties_changed && bus->event)
+                return queue_properties_changed(bus, path, interface, names);
+
+        return emit_properties_changed_now(bus, path, interface, names);
+}
+
 _public_ int sd_bus_emit_properties_changed(
                 sd_bus *bus,
                 const char *path,
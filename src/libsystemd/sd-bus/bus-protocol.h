@@ -57,6 +57,11 @@ enum {
         BUS_MESSAGE_NO_REPLY_EXPECTED               = 1 << 0,
         BUS_MESSAGE_NO_AUTO_START                   = 1 << 1,
         BUS_MESSAGE_ALLOW_INTERACTIVE_AUTHORIZATION = 1 << 2,
+
+        /* Our own extension, only used on connections where both sides agreed on it during
+         * authentication: the body is not part of the stream, but passed as sealed memfd, appended to the
+         * file descriptors of the message. Never set on messages outside of the wire. */
+        BUS_MESSAGE_MEMFD_BODY                      = 1 << 7,
 };
 
 /* Header fields */
@@ -259,6 +259,15 @@ _public_ void* sd_bus_slot_get_current_userdata(sd_bus_slot *slot) {
         return slot->bus->current_userdata;
 }
 
+_public_ int sd_bus_slot_get_match_hits(sd_bus_slot *slot, uint64_t *ret) {
+        assert_return(slot, -EINVAL);
+        assert_return(slot->type == BUS_MATCH_CALLBACK, -EOPNOTSUPP);
+        assert_return(ret, -EINVAL);
+
+        *ret = slot->match_callback.n_hits;
+        return 0;
+}
+
 _public_ int sd_bus_slot_get_floating(sd_bus_slot *slot) {
         assert_return(slot, -EINVAL);
 
@@ -10,6 +10,7 @@
 
 #include "alloc-util.h"
 #include "bus-internal.h"
+#include "bus-kernel.h"
 #include "bus-message.h"
 #include "bus-socket.h"
 #include "escape.h"
@@ -19,6 +20,7 @@
 #include "hexdecoct.h"
 #include "io-util.h"
 #include "macro.h"
+#include "memfd-util.h"
 #include "memory-util.h"
 #include "path-util.h"
 #include "process-util.h"
@@ -26,6 +28,7 @@
 #include "signal-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
+#include "unaligned.h"
 #include "user-util.h"
 #include "utf8.h"
 
@@ -155,18 +158,28 @@ static int bus_socket_write_auth(sd_bus *b) {
         return 1;
 }
 
+static bool bus_socket_want_memfd_body(sd_bus *b) {
+        assert(b);
+
+        /* Passing message bodies as memfds is our own extension of the protocol, hence we only ask for it
+         * on direct connections, where the peer is likely sd-bus too, and not on connections to a broker,
+         * which would have to forward the messages to peers that don't know about it. */
+        return b->accept_fd && !b->bus_client;
+}
+
 static int bus_socket_auth_verify_client(sd_bus *b) {
-        char *d, *e, *f, *start;
+        char *d, *e, *f, *g, *start;
         sd_id128_t peer;
         int r;
 
         assert(b);
 
         /*
-         * We expect three response lines:
+         * We expect up to four response lines:
          *   "DATA\r\n"
          *   "OK <server-id>\r\n"
-         *   "AGREE_UNIX_FD\r\n"        (optional)
+         *   "AGREE_UNIX_FD\r\n"                  (optional)
+         *   "EXTENSION_AGREE_MEMFD_BODY\r\n"     (optional)
          */
 
         d = memmem_safe(b->rbuffer, b->rbuffer_size, "\r\n", 2);
@@ -188,6 +201,15 @@ static int bus_socket_auth_verify_client(sd_bus *b) {
                 start = e + 2;
         }
 
+        if (bus_socket_want_memfd_body(b)) {
+                g = memmem(f + 2, b->rbuffer_size - (f - (char*) b->rbuffer) - 2, "\r\n", 2);
+                if (!g)
+                        return 0;
+
+                start = g + 2;
+        } else
+                g = NULL;
+
         /* Nice! We got all the lines we need. First check the DATA line. */
 
         if (d - (char*) b->rbuffer == 4) {
@@ -241,6 +263,14 @@ static int bus_socket_auth_verify_client(sd_bus *b) {
                         memcmp(e + 2, "AGREE_UNIX_FD",
                                STRLEN("AGREE_UNIX_FD")) == 0;
 
+        /* Passing memfds requires passing fds in the first place */
+        if (g)
+                b->can_memfd =
+                        b->can_fds &&
+                        (g - f == STRLEN("\r\nEXTENSION_AGREE_MEMFD_BODY")) &&
+                        memcmp(f + 2, "EXTENSION_AGREE_MEMFD_BODY",
+                               STRLEN("EXTENSION_AGREE_MEMFD_BODY")) == 0;
+
         b->rbuffer_size -= (start - (char*) b->rbuffer);
         memmove(b->rbuffer, start, b->rbuffer_size);
 
@@ -490,6 +520,13 @@ static int bus_socket_auth_verify_server(sd_bus *b) {
                                 b->can_fds = true;
                                 r = bus_socket_auth_write(b, "AGREE_UNIX_FD\r\n");
                         }
+                } else if (line_equals(line, l, "EXTENSION_NEGOTIATE_MEMFD_BODY")) {
+                        if (b->auth == _BUS_AUTH_INVALID || !b->can_fds)
+                                r = bus_socket_auth_write(b, "ERROR\r\n");
+                        else {
+                                b->can_memfd = true;
+                                r = bus_socket_auth_write(b, "EXTENSION_AGREE_MEMFD_BODY\r\n");
+                        }
                 } else
                         r = bus_socket_auth_write(b, "ERROR\r\n");
 
@@ -656,6 +693,9 @@ static int bus_socket_start_auth_client(sd_bus *b) {
         static const char sasl_negotiate_unix_fd[] = {
                 "NEGOTIATE_UNIX_FD\r\n"
         };
+        static const char sasl_negotiate_memfd_body[] = {
+                "EXTENSION_NEGOTIATE_MEMFD_BODY\r\n"
+        };
         static const char sasl_begin[] = {
                 "BEGIN\r\n"
         };
@@ -671,6 +711,9 @@ static int bus_socket_start_auth_client(sd_bus *b) {
         if (b->accept_fd)
                 b->auth_iovec[i++] = IOVEC_MAKE_STRING(sasl_negotiate_unix_fd);
 
+        if (bus_socket_want_memfd_body(b))
+                b->auth_iovec[i++] = IOVEC_MAKE_STRING(sasl_negotiate_memfd_body);
+
         b->auth_iovec[i++] = IOVEC_MAKE_STRING(sasl_begin);
 
         return bus_socket_write_auth(b);
@@ -1016,6 +1059,98 @@ int bus_socket_take_fd(sd_bus *b) {
         return bus_socket_start_auth(b);
 }
 
+static bool bus_socket_use_memfd_body(sd_bus *bus, sd_bus_message *m) {
+        assert(bus);
+        assert(m);
+
+        /* Whether to pass the body of this message as memfd instead of writing it to the socket. This is
+         * only worth it for large bodies, since creating and mapping a memfd is not for free. */
+
+        return bus->can_memfd &&
+                !BUS_MESSAGE_IS_GVARIANT(m) &&
+                m->body_size >= MEMFD_MIN_SIZE &&
+                m->n_fds < BUS_FDS_MAX;
+}
+
+static int bus_socket_make_memfd_body(sd_bus_message *m) {
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(m);
+        assert(m->n_iovec == 1 + m->n_body_parts);
+
+        fd = memfd_new(NULL);
+        if (fd < 0)
+                return fd;
+
+        for (unsigned i = 1; i < m->n_iovec; i++) {
+                r = loop_write(fd, m->iovec[i].iov_base, m->iovec[i].iov_len, false);
+                if (r < 0)
+                        return r;
+        }
+
+        r = memfd_set_sealed(fd);
+        if (r < 0)
+                return r;
+
+        return TAKE_FD(fd);
+}
+
+static int bus_socket_write_message_memfd(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+        _cleanup_close_ int memfd = -1;
+        struct bus_header h;
+        struct iovec iov[2];
+        struct msghdr mh = {
+                .msg_iov = iov,
+                .msg_iovlen = ELEMENTSOF(iov),
+        };
+        unsigned j = 0;
+        ssize_t k;
+
+        assert(bus);
+        assert(m);
+        assert(idx);
+
+        /* Only the header and the fields go to the socket, flagged accordingly. The body is copied into
+         * a sealed memfd once, which is sent along as an additional fd, and mapped by the receiver. */
+
+        h = *m->header;
+        h.flags |= BUS_MESSAGE_MEMFD_BODY;
+
+        iov[0] = IOVEC_MAKE(&h, sizeof(h));
+        iov[1] = IOVEC_MAKE(BUS_MESSAGE_FIELDS(m), BUS_MESSAGE_BODY_BEGIN(m) - sizeof(h));
+        iovec_advance(iov, &j, *idx);
+
+        if (*idx == 0) {
+                struct cmsghdr *control;
+
+                memfd = bus_socket_make_memfd_body(m);
+                if (memfd < 0)
+                        return memfd;
+
+                mh.msg_controllen = CMSG_SPACE(sizeof(int) * (m->n_fds + 1));
+                mh.msg_control = alloca0(mh.msg_controllen);
+                control = CMSG_FIRSTHDR(&mh);
+                control->cmsg_len = CMSG_LEN(sizeof(int) * (m->n_fds + 1));
+                control->cmsg_level = SOL_SOCKET;
+                control->cmsg_type = SCM_RIGHTS;
+                memcpy_safe(CMSG_DATA(control), m->fds, sizeof(int) * m->n_fds);
+                memcpy((int*) CMSG_DATA(control) + m->n_fds, &memfd, sizeof(int));
+        }
+
+        k = sendmsg(bus->output_fd, &mh, MSG_DONTWAIT|MSG_NOSIGNAL);
+        if (k < 0)
+                return errno == EAGAIN ? 0 : -errno;
+
+        *idx += (size_t) k;
+
+        /* The body went out with the first write already */
+        if (*idx >= BUS_MESSAGE_BODY_BEGIN(m))
+                *idx = BUS_MESSAGE_SIZE(m);
+
+        return 1;
+}
+
 int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         struct iovec *iov;
         ssize_t k;
@@ -1035,6 +1170,9 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         if (r < 0)
                 return r;
 
+        if (bus_socket_use_memfd_body(bus, m))
+                return bus_socket_write_message_memfd(bus, m, idx);
+
         n = m->n_iovec * sizeof(struct iovec);
         iov = newa(struct iovec, n);
         memcpy_safe(iov, m->iovec, n);
@@ -1076,16 +1214,17 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         return 1;
 }
 
-static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
+static int bus_socket_read_message_need(sd_bus *bus, size_t offset, size_t *need) {
+        const uint8_t *p;
         uint32_t a, b;
-        uint8_t e;
         uint64_t sum;
 
         assert(bus);
         assert(need);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
+        assert(offset <= bus->rbuffer_size);
 
-        if (bus->rbuffer_size < sizeof(struct bus_header)) {
+        if (bus->rbuffer_size - offset < sizeof(struct bus_header)) {
                 *need = sizeof(struct bus_header) + 8;
 
                 /* Minimum message size:
@@ -1107,19 +1246,23 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
                 return 0;
         }
 
-        a = ((const uint32_t*) bus->rbuffer)[1];
-        b = ((const uint32_t*) bus->rbuffer)[3];
+        /* Messages following each other in the buffer are not necessarily aligned, hence read the header
+         * fields unaligned. */
+        p = (const uint8_t*) bus->rbuffer + offset;
 
-        e = ((const uint8_t*) bus->rbuffer)[0];
-        if (e == BUS_LITTLE_ENDIAN) {
-                a = le32toh(a);
-                b = le32toh(b);
-        } else if (e == BUS_BIG_ENDIAN) {
-                a = be32toh(a);
-                b = be32toh(b);
+        if (p[0] == BUS_LITTLE_ENDIAN) {
+                a = unaligned_read_le32(p + 4);
+                b = unaligned_read_le32(p + 12);
+        } else if (p[0] == BUS_BIG_ENDIAN) {
+                a = unaligned_read_be32(p + 4);
+                b = unaligned_read_be32(p + 12);
         } else
                 return -EBADMSG;
 
+        /* A body passed as memfd is not part of the stream */
+        if (bus->can_memfd && FLAGS_SET(p[offsetof(struct bus_header, flags)], BUS_MESSAGE_MEMFD_BODY))
+                a = 0;
+
         sum = (uint64_t) sizeof(struct bus_header) + (uint64_t) ALIGN_TO(b, 8) + (uint64_t) a;
         if (sum >= BUS_MESSAGE_SIZE_MAX)
                 return -ENOBUFS;
@@ -1128,46 +1271,95 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         return 0;
 }
 
-static int bus_socket_make_message(sd_bus *bus, size_t size) {
+static int bus_socket_make_message(sd_bus *bus, size_t offset, size_t size) {
         sd_bus_message *t = NULL;
+        bool with_fds, handover, memfd_body;
         void *b;
         int r;
 
         assert(bus);
-        assert(bus->rbuffer_size >= size);
+        assert(offset <= bus->rbuffer_size);
+        assert(bus->rbuffer_size - offset >= size);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
         r = bus_rqueue_make_room(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size > size) {
-                b = memdup((const uint8_t*) bus->rbuffer + size,
-                           bus->rbuffer_size - size);
+        /* If the message is the only thing in the buffer, pass the buffer itself on to the message,
+         * otherwise give the message a copy of its own: the message might stay around much longer than
+         * the buffer, and needs to be suitably aligned. */
+        handover = offset == 0 && size == bus->rbuffer_size;
+        if (handover) {
+                /* Don't pin the unused part of a large read buffer to a small message */
+                if (MALLOC_SIZEOF_SAFE(bus->rbuffer) > size * 2) {
+                        b = realloc(bus->rbuffer, size);
+                        if (b)
+                                bus->rbuffer = b;
+                }
+
+                b = bus->rbuffer;
+        } else {
+                b = memdup((const uint8_t*) bus->rbuffer + offset, size);
                 if (!b)
                         return -ENOMEM;
-        } else
-                b = NULL;
+        }
 
-        r = bus_message_from_malloc(bus,
-                                    bus->rbuffer, size,
-                                    bus->fds, bus->n_fds,
-                                    NULL,
-                                    &t);
+        /* The kernel never merges data following a file descriptor carrying skb into the same read, hence
+         * the fds we got belong to a message at or after the point where the read that got them started,
+         * but not necessarily to the first one. Messages that don't declare file descriptors won't take
+         * them, hence try again without the fds if the message rejects them. */
+        with_fds = bus->n_fds > 0 && offset >= bus->rbuffer_fds_offset;
+
+        memfd_body = bus->can_memfd &&
+                FLAGS_SET(((const uint8_t*) b)[offsetof(struct bus_header, flags)], BUS_MESSAGE_MEMFD_BODY);
+
+        if (memfd_body) {
+                if (with_fds) {
+                        /* The memfd with the body follows the message's own file descriptors */
+                        r = bus_message_from_memfd(bus,
+                                                   b, size,
+                                                   bus->fds[bus->n_fds - 1],
+                                                   bus->fds, bus->n_fds - 1,
+                                                   NULL,
+                                                   &t);
+                        if (r < 0) {
+                                /* The memfd was closed already, and the rest is of no use to anyone */
+                                close_many(bus->fds, bus->n_fds - 1);
+                                bus->fds = mfree(bus->fds);
+                                bus->n_fds = 0;
+                                with_fds = false;
+                        }
+                } else
+                        r = -EBADMSG;
+        } else {
+                r = bus_message_from_malloc(bus,
+                                            b, size,
+                                            with_fds ? bus->fds : NULL, with_fds ? bus->n_fds : 0,
+                                            NULL,
+                                            &t);
+                if (r == -EBADMSG && with_fds) {
+                        with_fds = false;
+                        r = bus_message_from_malloc(bus, b, size, NULL, 0, NULL, &t);
+                }
+        }
         if (r == -EBADMSG) {
                 log_debug_errno(r, "Received invalid message from connection %s, dropping.", strna(bus->description));
-                free(bus->rbuffer); /* We want to drop current rbuffer and proceed with whatever remains in b */
+                free(b); /* We want to drop the message and proceed with whatever remains */
         } else if (r < 0) {
-                free(b);
+                if (!handover)
+                        free(b);
                 return r;
         }
 
-        /* rbuffer ownership was either transferred to t, or we got EBADMSG and dropped it. */
-        bus->rbuffer = b;
-        bus->rbuffer_size -= size;
+        /* The buffer ownership was either transferred to t, or we got EBADMSG and dropped it. */
+        if (handover)
+                bus->rbuffer = NULL;
 
-        bus->fds = NULL;
-        bus->n_fds = 0;
+        if (with_fds) {
+                bus->fds = NULL;
+                bus->n_fds = 0;
+        }
 
         if (t) {
                 t->read_counter = ++bus->read_counter;
@@ -1178,11 +1370,69 @@ static int bus_socket_make_message(sd_bus *bus, size_t size) {
         return 1;
 }
 
+static int bus_socket_make_messages(sd_bus *bus) {
+        size_t offset = 0, need;
+        bool queued = false;
+        int r;
+
+        assert(bus);
+
+        /* Turns all complete messages in the read buffer into message objects, and moves what remains
+         * to the front of the buffer, once. */
+
+        for (;;) {
+                r = bus_socket_read_message_need(bus, offset, &need);
+                if (r < 0)
+                        break;
+
+                if (bus->rbuffer_size - offset < need)
+                        break;
+
+                r = bus_socket_make_message(bus, offset, need);
+                if (r < 0)
+                        break;
+
+                offset += need;
+                queued = true;
+
+                if (!bus->rbuffer)
+                        break; /* The buffer was handed over to the message. */
+        }
+
+        if (!bus->rbuffer)
+                bus->rbuffer_size = 0;
+        else if (offset > 0) {
+                bus->rbuffer_size -= offset;
+
+                if (bus->rbuffer_size == 0)
+                        bus->rbuffer = mfree(bus->rbuffer);
+                else
+                        memmove(bus->rbuffer, (uint8_t*) bus->rbuffer + offset, bus->rbuffer_size);
+        }
+
+        bus->rbuffer_fds_offset = LESS_BY(bus->rbuffer_fds_offset, offset);
+
+        if (bus->rbuffer_size == 0 && bus->n_fds > 0) {
+                /* No message claimed the fds we got, and there's nothing left they could belong to. */
+                log_debug("Received %zu unexpected file descriptors from connection %s, closing.",
+                          bus->n_fds, strna(bus->description));
+                close_many(bus->fds, bus->n_fds);
+                bus->fds = mfree(bus->fds);
+                bus->n_fds = 0;
+        }
+
+        /* If we made progress, report that first. Any error will be hit again on the next invocation. */
+        if (queued)
+                return 1;
+
+        return r;
+}
+
 int bus_socket_read_message(sd_bus *bus) {
         struct msghdr mh;
         struct iovec iov = {};
         ssize_t k;
-        size_t need;
+        size_t need, n;
         int r;
         void *b;
         CMSG_BUFFER_TYPE(CMSG_SPACE(sizeof(int) * BUS_FDS_MAX)) control;
@@ -1191,20 +1441,32 @@ int bus_socket_read_message(sd_bus *bus) {
         assert(bus);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
-        r = bus_socket_read_message_need(bus, &need);
+        r = bus_socket_read_message_need(bus, 0, &need);
         if (r < 0)
                 return r;
 
         if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
+                return bus_socket_make_messages(bus);
 
-        b = realloc(bus->rbuffer, need);
-        if (!b)
-                return -ENOMEM;
+        if (bus->n_fds > 0)
+                /* As long as we hold file descriptors not assigned to a message yet, read only what is
+                 * missing from the current message, so that we never get fds of the next message mixed
+                 * up with these. */
+                n = need;
+        else
+                /* Otherwise read as much as we can, so that we get a whole burst of messages with a
+                 * single read. */
+                n = MAX(need, MAX(BUS_RBUFFER_SIZE, MALLOC_SIZEOF_SAFE(bus->rbuffer)));
 
-        bus->rbuffer = b;
+        if (MALLOC_SIZEOF_SAFE(bus->rbuffer) < n) {
+                b = realloc(bus->rbuffer, n);
+                if (!b)
+                        return -ENOMEM;
 
-        iov = IOVEC_MAKE((uint8_t *)bus->rbuffer + bus->rbuffer_size, need - bus->rbuffer_size);
+                bus->rbuffer = b;
+        }
+
+        iov = IOVEC_MAKE((uint8_t *)bus->rbuffer + bus->rbuffer_size, n - bus->rbuffer_size);
 
         if (bus->prefer_readv) {
                 k = readv(bus->input_fd, &iov, 1);
@@ -1237,34 +1499,35 @@ int bus_socket_read_message(sd_bus *bus) {
                 return -ECONNRESET;
         }
 
-        bus->rbuffer_size += k;
-
         if (handle_cmsg) {
                 struct cmsghdr *cmsg;
 
                 CMSG_FOREACH(cmsg, &mh)
                         if (cmsg->cmsg_level == SOL_SOCKET &&
                             cmsg->cmsg_type == SCM_RIGHTS) {
-                                int n, *f, i;
+                                int n_cmsg_fds, *f, i;
 
-                                n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                                n_cmsg_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
 
                                 if (!bus->can_fds) {
                                         /* Whut? We received fds but this
                                          * isn't actually enabled? Close them,
                                          * and fail */
 
-                                        close_many((int*) CMSG_DATA(cmsg), n);
+                                        close_many((int*) CMSG_DATA(cmsg), n_cmsg_fds);
                                         return -EIO;
                                 }
 
-                                f = reallocarray(bus->fds, bus->n_fds + n, sizeof(int));
+                                f = reallocarray(bus->fds, bus->n_fds + n_cmsg_fds, sizeof(int));
                                 if (!f) {
-                                        close_many((int*) CMSG_DATA(cmsg), n);
+                                        close_many((int*) CMSG_DATA(cmsg), n_cmsg_fds);
                                         return -ENOMEM;
                                 }
 
-                                for (i = 0; i < n; i++)
+                                if (bus->n_fds == 0)
+                                        bus->rbuffer_fds_offset = bus->rbuffer_size;
+
+                                for (i = 0; i < n_cmsg_fds; i++)
                                         f[bus->n_fds++] = fd_move_above_stdio(((int*) CMSG_DATA(cmsg))[i]);
                                 bus->fds = f;
                         } else
@@ -1272,12 +1535,14 @@ int bus_socket_read_message(sd_bus *bus) {
                                           cmsg->cmsg_level, cmsg->cmsg_type);
         }
 
-        r = bus_socket_read_message_need(bus, &need);
+        bus->rbuffer_size += k;
+
+        r = bus_socket_read_message_need(bus, 0, &need);
         if (r < 0)
                 return r;
 
         if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
+                return bus_socket_make_messages(bus);
 
         return 1;
 }
@@ -216,6 +216,8 @@ static sd_bus* bus_free(sd_bus *b) {
 
         hashmap_free_free(b->vtable_methods);
         hashmap_free_free(b->vtable_properties);
+        ordered_set_free(b->pending_properties_changed);
+        hashmap_free(b->name_creds_cache);
 
         assert(hashmap_isempty(b->nodes));
         hashmap_free(b->nodes);
@@ -3361,6 +3363,9 @@ _public_ int sd_bus_flush(sd_bus *bus) {
         if (r < 0)
                 return r;
 
+        /* Signals held back for coalescing should go out before we consider ourselves flushed */
+        (void) bus_emit_pending_properties_changed(bus);
+
         if (bus->wqueue_size <= 0)
                 return 0;
 
@@ -3872,6 +3877,10 @@ _public_ int sd_bus_detach_event(sd_bus *bus) {
                 bus->quit_event_source = sd_event_source_unref(bus->quit_event_source);
         }
 
+        /* Without an event loop there's nothing to defer coalesced signals to anymore, send them now */
+        bus->properties_changed_event_source = sd_event_source_disable_unref(bus->properties_changed_event_source);
+        (void) bus_emit_pending_properties_changed(bus);
+
         bus->event = sd_event_unref(bus->event);
         return 1;
 }
@@ -4407,6 +4416,25 @@ _public_ int sd_bus_get_close_on_exit(sd_bus *bus) {
         return bus->close_on_exit;
 }
 
+_public_ int sd_bus_set_coalesce_properties_changed(sd_bus *bus, int b) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        bus->coalesce_properties_changed = b;
+        if (!b)
+                (void) bus_emit_pending_properties_changed(bus);
+
+        return 0;
+}
+
+_public_ int sd_bus_get_coalesce_properties_changed(sd_bus *bus) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+
+        return bus->coalesce_properties_changed;
+}
+
 _public_ int sd_bus_enqueue_for_read(sd_bus *bus, sd_bus_message *m) {
         int r;
 
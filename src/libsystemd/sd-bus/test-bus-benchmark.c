@@ -8,16 +8,38 @@
 #include "alloc-util.h"
 #include "bus-internal.h"
 #include "bus-kernel.h"
+#include "bus-message.h"
 #include "def.h"
 #include "fd-util.h"
+#include "json.h"
+#include "memory-util.h"
 #include "missing_resource.h"
+#include "sort-util.h"
 #include "string-util.h"
 #include "time-util.h"
 #include "util.h"
 
+/* Usage: test-bus-benchmark [bisect|chart|rtt|fanout|marshal] [legacy|direct] [json] [DURATION]
+ *
+ * bisect:  find the message size from which on memfds are faster than copying
+ * chart:   transactions per second for a range of message sizes
+ * rtt:     method call round trip time percentiles
+ * fanout:  latency until a signal reached all of N subscribers, via the bus broker only
+ * marshal: appending and parsing a message with a complex signature, both encoded as dbus1 and GVariant
+ *
+ * "legacy" talks through the broker at $DBUS_SESSION_BUS_ADDRESS, "direct" over a socketpair. Each
+ * measurement runs for DURATION. With "json" every result is written as a JSON object on a line of its
+ * own, for consumption by scripts. */
+
 #define MAX_SIZE (2*1024*1024)
 
+/* Number of entries in the array of the message used by the marshalling benchmark */
+#define MARSHAL_N_ENTRIES 32
+
+static const unsigned fanout_subscribers[] = { 1, 4, 16, 64 };
+
 static usec_t arg_loop_usec = 100 * USEC_PER_MSEC;
+static bool arg_json = false;
 
 typedef enum Type {
         TYPE_LEGACY,
@@ -61,6 +83,62 @@ static void server(sd_bus *b, size_t *result) {
         }
 }
 
+static void report(JsonVariant *v) {
+        json_variant_dump(v, JSON_FORMAT_NEWLINE|JSON_FORMAT_FLUSH, stdout, NULL);
+}
+
+static unsigned per_sec(uint64_t n) {
+        return (unsigned) ((n * USEC_PER_SEC) / arg_loop_usec);
+}
+
+static int nsec_compare(const nsec_t *a, const nsec_t *b) {
+        return CMP(*a, *b);
+}
+
+static nsec_t percentile(const nsec_t *samples, size_t n, unsigned p) {
+        assert(samples);
+        assert(n > 0);
+        assert(p <= 100);
+
+        return samples[MIN(n * p / 100, n - 1)];
+}
+
+static void report_latency(const char *benchmark, const char *variant, unsigned n_peers, nsec_t *samples, size_t n) {
+        assert(samples);
+        assert(n > 0);
+
+        typesafe_qsort(samples, n, nsec_compare);
+
+        if (arg_json) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                                     JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING(benchmark)),
+                                                     JSON_BUILD_PAIR("transport", JSON_BUILD_STRING(variant)),
+                                                     JSON_BUILD_PAIR("peers", JSON_BUILD_UNSIGNED(n_peers)),
+                                                     JSON_BUILD_PAIR("samples", JSON_BUILD_UNSIGNED(n)),
+                                                     JSON_BUILD_PAIR("per_sec", JSON_BUILD_UNSIGNED(per_sec(n))),
+                                                     JSON_BUILD_PAIR("min_nsec", JSON_BUILD_UNSIGNED(samples[0])),
+                                                     JSON_BUILD_PAIR("p50_nsec", JSON_BUILD_UNSIGNED(percentile(samples, n, 50))),
+                                                     JSON_BUILD_PAIR("p90_nsec", JSON_BUILD_UNSIGNED(percentile(samples, n, 90))),
+                                                     JSON_BUILD_PAIR("p99_nsec", JSON_BUILD_UNSIGNED(percentile(samples, n, 99))),
+                                                     JSON_BUILD_PAIR("max_nsec", JSON_BUILD_UNSIGNED(samples[n - 1])))) >= 0);
+                report(v);
+        } else
+                printf("%u\t%zu\t%u\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n",
+                       n_peers, n, per_sec(n),
+                       (double) samples[0] / NSEC_PER_USEC,
+                       (double) percentile(samples, n, 50) / NSEC_PER_USEC,
+                       (double) percentile(samples, n, 90) / NSEC_PER_USEC,
+                       (double) percentile(samples, n, 99) / NSEC_PER_USEC,
+                       (double) samples[n - 1] / NSEC_PER_USEC);
+}
+
+static void print_latency_header(void) {
+        if (!arg_json)
+                printf("PEERS\tSAMPLES\tPER_SEC\tMIN_US\tP50_US\tP90_US\tP99_US\tMAX_US\n");
+}
+
 static void transaction(sd_bus *b, size_t sz, const char *server_name) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
         uint8_t *p;
@@ -94,7 +172,8 @@ static void client_bisect(const char *address, const char *server_name) {
         lsize = 1;
         rsize = MAX_SIZE;
 
-        printf("SIZE\tCOPY\tMEMFD\n");
+        if (!arg_json)
+                printf("SIZE\tCOPY\tMEMFD\n");
 
         for (;;) {
                 usec_t t;
@@ -108,8 +187,6 @@ static void client_bisect(const char *address, const char *server_name) {
                 if (csize <= 0)
                         break;
 
-                printf("%zu\t", csize);
-
                 b->use_memfd = 0;
 
                 t = now(CLOCK_MONOTONIC);
@@ -118,8 +195,6 @@ static void client_bisect(const char *address, const char *server_name) {
                         if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
                                 break;
                 }
-                printf("%u\t", (unsigned) ((n_copying * USEC_PER_SEC) / arg_loop_usec));
-
                 b->use_memfd = -1;
 
                 t = now(CLOCK_MONOTONIC);
@@ -128,7 +203,17 @@ static void client_bisect(const char *address, const char *server_name) {
                         if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
                                 break;
                 }
-                printf("%u\n", (unsigned) ((n_memfd * USEC_PER_SEC) / arg_loop_usec));
+                if (arg_json) {
+                        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                                             JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING("bisect")),
+                                                             JSON_BUILD_PAIR("size", JSON_BUILD_UNSIGNED(csize)),
+                                                             JSON_BUILD_PAIR("copy_per_sec", JSON_BUILD_UNSIGNED(per_sec(n_copying))),
+                                                             JSON_BUILD_PAIR("memfd_per_sec", JSON_BUILD_UNSIGNED(per_sec(n_memfd))))) >= 0);
+                        report(v);
+                } else
+                        printf("%zu\t%u\t%u\n", csize, per_sec(n_copying), per_sec(n_memfd));
 
                 if (n_copying == n_memfd)
                         break;
@@ -147,9 +232,7 @@ static void client_bisect(const char *address, const char *server_name) {
         sd_bus_unref(b);
 }
 
-static void client_chart(Type type, const char *address, const char *server_name, int fd) {
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *x = NULL;
-        size_t csize;
+static sd_bus* client_connect(Type type, const char *address, const char *server_name, int fd) {
         sd_bus *b;
         int r;
 
@@ -173,21 +256,36 @@ static void client_chart(Type type, const char *address, const char *server_name
         r = sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL);
         assert_se(r >= 0);
 
-        switch (type) {
-        case TYPE_LEGACY:
-                printf("SIZE\tLEGACY\n");
-                break;
-        case TYPE_DIRECT:
-                printf("SIZE\tDIRECT\n");
-                break;
-        }
+        return b;
+}
+
+static void client_exit(sd_bus *b, const char *server_name, uint64_t result) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *x = NULL;
+
+        b->use_memfd = 1;
+        assert_se(sd_bus_message_new_method_call(b, &x, server_name, "/", "benchmark.server", "Exit") >= 0);
+        assert_se(sd_bus_message_append(x, "t", result) >= 0);
+        assert_se(sd_bus_send(b, x, NULL) >= 0);
+
+        sd_bus_unref(b);
+
+        /* We leave via _exit(), make sure the results are not lost when stdout is not a tty */
+        fflush(stdout);
+}
+
+static void client_chart(Type type, const char *address, const char *server_name, int fd) {
+        size_t csize;
+        sd_bus *b;
+
+        b = client_connect(type, address, server_name, fd);
+
+        if (!arg_json)
+                printf("SIZE\t%s\n", type == TYPE_DIRECT ? "DIRECT" : "LEGACY");
 
         for (csize = 1; csize <= MAX_SIZE; csize *= 2) {
                 usec_t t;
                 unsigned n_memfd;
 
-                printf("%zu\t", csize);
-
                 t = now(CLOCK_MONOTONIC);
                 for (n_memfd = 0;; n_memfd++) {
                         transaction(b, csize, server_name);
@@ -195,21 +293,235 @@ static void client_chart(Type type, const char *address, const char *server_name
                                 break;
                 }
 
-                printf("%u\n", (unsigned) ((n_memfd * USEC_PER_SEC) / arg_loop_usec));
+                if (arg_json) {
+                        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                                             JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING("chart")),
+                                                             JSON_BUILD_PAIR("transport", JSON_BUILD_STRING(type == TYPE_DIRECT ? "direct" : "legacy")),
+                                                             JSON_BUILD_PAIR("size", JSON_BUILD_UNSIGNED(csize)),
+                                                             JSON_BUILD_PAIR("per_sec", JSON_BUILD_UNSIGNED(per_sec(n_memfd))))) >= 0);
+                        report(v);
+                } else
+                        printf("%zu\t%u\n", csize, per_sec(n_memfd));
         }
 
-        b->use_memfd = 1;
-        assert_se(sd_bus_message_new_method_call(b, &x, server_name, "/", "benchmark.server", "Exit") >= 0);
-        assert_se(sd_bus_message_append(x, "t", csize) >= 0);
-        assert_se(sd_bus_send(b, x, NULL) >= 0);
+        client_exit(b, server_name, csize);
+}
 
-        sd_bus_unref(b);
+static void client_rtt(Type type, const char *address, const char *server_name, int fd) {
+        _cleanup_free_ nsec_t *samples = NULL;
+        size_t n = 0;
+        usec_t t;
+        sd_bus *b;
+
+        b = client_connect(type, address, server_name, fd);
+
+        print_latency_header();
+
+        t = now(CLOCK_MONOTONIC);
+        do {
+                nsec_t start;
+
+                start = now_nsec(CLOCK_MONOTONIC);
+                assert_se(sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL) >= 0);
+
+                assert_se(GREEDY_REALLOC(samples, n + 1));
+                samples[n++] = now_nsec(CLOCK_MONOTONIC) - start;
+        } while (now(CLOCK_MONOTONIC) < t + arg_loop_usec);
+
+        report_latency("rtt", type == TYPE_DIRECT ? "direct" : "legacy", 1, samples, n);
+
+        client_exit(b, server_name, n);
+}
+
+static int fanout_handler(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        bool *received = userdata;
+
+        *received = true;
+        return 1;
+}
+
+static void client_fanout(const char *address, const char *server_name) {
+        sd_bus *b;
+        int r;
+
+        b = client_connect(TYPE_LEGACY, address, server_name, -1);
+
+        print_latency_header();
+
+        for (size_t i = 0; i < ELEMENTSOF(fanout_subscribers); i++) {
+                unsigned n_subscribers = fanout_subscribers[i];
+                _cleanup_free_ sd_bus **subscribers = NULL;
+                _cleanup_free_ bool *received = NULL;
+                _cleanup_free_ nsec_t *samples = NULL;
+                size_t n = 0;
+                usec_t t;
+
+                assert_se(subscribers = new0(sd_bus*, n_subscribers));
+                assert_se(received = new0(bool, n_subscribers));
+
+                for (unsigned j = 0; j < n_subscribers; j++) {
+                        assert_se(sd_bus_new(&subscribers[j]) >= 0);
+                        assert_se(sd_bus_set_address(subscribers[j], address) >= 0);
+                        assert_se(sd_bus_set_bus_client(subscribers[j], true) >= 0);
+                        assert_se(sd_bus_start(subscribers[j]) >= 0);
+
+                        /* Synchronous, hence the broker knows about the match once this returns */
+                        r = sd_bus_match_signal(subscribers[j], NULL, NULL, "/", "benchmark.client", "Tick", fanout_handler, received + j);
+                        assert_se(r >= 0);
+                }
+
+                t = now(CLOCK_MONOTONIC);
+                do {
+                        nsec_t start;
+
+                        memzero(received, sizeof(bool) * n_subscribers);
+
+                        start = now_nsec(CLOCK_MONOTONIC);
+                        assert_se(sd_bus_emit_signal(b, "/", "benchmark.client", "Tick", NULL) >= 0);
+                        assert_se(sd_bus_flush(b) >= 0);
+
+                        for (unsigned j = 0; j < n_subscribers; j++)
+                                while (!received[j]) {
+                                        r = sd_bus_process(subscribers[j], NULL);
+                                        assert_se(r >= 0);
+                                        if (r == 0 && !received[j])
+                                                assert_se(sd_bus_wait(subscribers[j], USEC_INFINITY) >= 0);
+                                }
+
+                        assert_se(GREEDY_REALLOC(samples, n + 1));
+                        samples[n++] = now_nsec(CLOCK_MONOTONIC) - start;
+                } while (now(CLOCK_MONOTONIC) < t + arg_loop_usec);
+
+                report_latency("fanout", "legacy", n_subscribers, samples, n);
+
+                for (unsigned j = 0; j < n_subscribers; j++)
+                        sd_bus_flush_close_unref(subscribers[j]);
+        }
+
+        client_exit(b, server_name, 0);
+}
+
+static void marshal_append(sd_bus_message *m) {
+        assert_se(sd_bus_message_open_container(m, 'a', "(usa{sv}as)") >= 0);
+
+        for (unsigned i = 0; i < MARSHAL_N_ENTRIES; i++)
+                assert_se(sd_bus_message_append(m, "(usa{sv}as)",
+                                                i, "waldo",
+                                                3,
+                                                "Id", "t", (uint64_t) i,
+                                                "Name", "s", "quux",
+                                                "Enabled", "b", true,
+                                                2, "foo", "bar") >= 0);
+
+        assert_se(sd_bus_message_close_container(m) >= 0);
+}
+
+static void marshal_read(sd_bus_message *m) {
+        assert_se(sd_bus_message_enter_container(m, 'a', "(usa{sv}as)") > 0);
+
+        for (unsigned i = 0; i < MARSHAL_N_ENTRIES; i++) {
+                const char *s, *k1, *k2, *k3, *name, *a1, *a2;
+                uint64_t id;
+                uint32_t u;
+                int enabled;
+
+                assert_se(sd_bus_message_read(m, "(usa{sv}as)",
+                                              &u, &s,
+                                              3,
+                                              &k1, "t", &id,
+                                              &k2, "s", &name,
+                                              &k3, "b", &enabled,
+                                              2, &a1, &a2) > 0);
+                assert_se(u == i && id == i);
+        }
+
+        assert_se(sd_bus_message_exit_container(m) > 0);
+}
+
+static sd_bus_message* marshal_new_message(sd_bus *b, uint64_t cookie) {
+        sd_bus_message *m;
+
+        assert_se(sd_bus_message_new_method_call(b, &m, "benchmark.server", "/", "benchmark.server", "Work") >= 0);
+        marshal_append(m);
+        assert_se(sd_bus_message_seal(m, cookie, 0) >= 0);
+
+        return m;
+}
+
+static void marshal(void) {
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        _cleanup_(sd_bus_unrefp) sd_bus *b = NULL;
+
+        /* Messages are never sent, the connection only needs to be started so that messages can be
+         * created. The encoding follows the message version the connection negotiated, which is faked
+         * below in order to get GVariant encoded messages. */
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_start(b) >= 0);
+
+        if (!arg_json)
+                printf("ENCODING\tSIZE\tAPPEND_PER_SEC\tPARSE_PER_SEC\n");
+
+        for (int version = 1; version <= 2; version++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                _cleanup_free_ void *blob = NULL;
+                unsigned n_append, n_parse;
+                size_t sz;
+                usec_t t;
+
+                b->message_version = version;
+
+                t = now(CLOCK_MONOTONIC);
+                for (n_append = 0;; n_append++) {
+                        sd_bus_message_unref(marshal_new_message(b, n_append + 1));
+                        if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                                break;
+                }
+
+                m = marshal_new_message(b, 1);
+                assert_se(bus_message_get_blob(m, &blob, &sz) >= 0);
+
+                t = now(CLOCK_MONOTONIC);
+                for (n_parse = 0;; n_parse++) {
+                        _cleanup_(sd_bus_message_unrefp) sd_bus_message *p = NULL;
+                        void *copy;
+
+                        assert_se(copy = memdup(blob, sz));
+                        assert_se(bus_message_from_malloc(b, copy, sz, NULL, 0, NULL, &p) >= 0);
+                        marshal_read(p);
+
+                        if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                                break;
+                }
+
+                if (arg_json) {
+                        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                                             JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING("marshal")),
+                                                             JSON_BUILD_PAIR("encoding", JSON_BUILD_STRING(version == 2 ? "gvariant" : "dbus1")),
+                                                             JSON_BUILD_PAIR("signature", JSON_BUILD_STRING("a(usa{sv}as)")),
+                                                             JSON_BUILD_PAIR("size", JSON_BUILD_UNSIGNED(sz)),
+                                                             JSON_BUILD_PAIR("append_per_sec", JSON_BUILD_UNSIGNED(per_sec(n_append))),
+                                                             JSON_BUILD_PAIR("parse_per_sec", JSON_BUILD_UNSIGNED(per_sec(n_parse))))) >= 0);
+                        report(v);
+                } else
+                        printf("%s\t%zu\t%u\t%u\n",
+                               version == 2 ? "GVARIANT" : "DBUS1", sz, per_sec(n_append), per_sec(n_parse));
+        }
 }
 
 int main(int argc, char *argv[]) {
         enum {
                 MODE_BISECT,
                 MODE_CHART,
+                MODE_RTT,
+                MODE_FANOUT,
+                MODE_MARSHAL,
         } mode = MODE_BISECT;
         Type type = TYPE_LEGACY;
         int i, pair[2] = { -1, -1 };
@@ -223,9 +535,24 @@ int main(int argc, char *argv[]) {
         int r;
 
         for (i = 1; i < argc; i++) {
-                if (streq(argv[i], "chart")) {
+                if (streq(argv[i], "bisect")) {
+                        mode = MODE_BISECT;
+                        continue;
+                } else if (streq(argv[i], "chart")) {
                         mode = MODE_CHART;
                         continue;
+                } else if (streq(argv[i], "rtt")) {
+                        mode = MODE_RTT;
+                        continue;
+                } else if (streq(argv[i], "fanout")) {
+                        mode = MODE_FANOUT;
+                        continue;
+                } else if (streq(argv[i], "marshal")) {
+                        mode = MODE_MARSHAL;
+                        continue;
+                } else if (streq(argv[i], "json")) {
+                        arg_json = true;
+                        continue;
                 } else if (streq(argv[i], "legacy")) {
                         type = TYPE_LEGACY;
                         continue;
@@ -239,6 +566,15 @@ int main(int argc, char *argv[]) {
 
         assert_se(arg_loop_usec > 0);
 
+        if (mode == MODE_MARSHAL) {
+                /* Purely in-process, no peer needed */
+                marshal();
+                return 0;
+        }
+
+        /* There's no fan-out on a point-to-point connection */
+        assert_se(mode != MODE_FANOUT || type == TYPE_LEGACY);
+
         if (type == TYPE_LEGACY) {
                 const char *e;
 
@@ -301,6 +637,17 @@ int main(int argc, char *argv[]) {
                 case MODE_CHART:
                         client_chart(type, address, server_name, pair[1]);
                         break;
+
+                case MODE_RTT:
+                        client_rtt(type, address, server_name, pair[1]);
+                        break;
+
+                case MODE_FANOUT:
+                        client_fanout(address, server_name);
+                        break;
+
+                case MODE_MARSHAL:
+                        assert_not_reached();
                 }
 
                 _exit(EXIT_SUCCESS);
@@ -312,7 +659,7 @@ int main(int argc, char *argv[]) {
 
         server(b, &result);
 
-        if (mode == MODE_BISECT)
+        if (mode == MODE_BISECT && !arg_json)
                 printf("Copying/memfd are equally fast at %zu bytes\n", result);
 
         assert_se(waitpid(pid, NULL, 0) == pid);
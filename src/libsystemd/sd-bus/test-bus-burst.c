@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd-bus.h"
+
+#include "bus-internal.h"
+#include "fd-util.h"
+#include "tests.h"
+
+#define N_MESSAGES 500
+
+/* Every so often a message carries a file descriptor, so that fd passing is interleaved with a burst of
+ * messages that are picked up with a few reads only */
+#define FD_EVERY 7
+
+static const char waldo[] = "waldowaldowaldo";
+
+static void test_burst(bool negotiate_fds) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *a = NULL, *b = NULL;
+        _cleanup_close_pair_ int pair[2] = { -1, -1 }, pipe_fds[2] = { -1, -1 };
+        struct stat pipe_st;
+        unsigned n = 0;
+        sd_id128_t id;
+
+        log_info("/* %s(negotiate_fds=%s) */", __func__, yes_no(negotiate_fds));
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(pipe2(pipe_fds, O_CLOEXEC) >= 0);
+        assert_se(fstat(pipe_fds[1], &pipe_st) >= 0);
+
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&a) >= 0);
+        assert_se(sd_bus_set_fd(a, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_set_server(a, 1, id) >= 0);
+        assert_se(sd_bus_set_anonymous(a, true) >= 0);
+        assert_se(sd_bus_negotiate_fds(a, negotiate_fds) >= 0);
+        assert_se(sd_bus_start(a) >= 0);
+
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, pair[1], pair[1]) >= 0);
+        TAKE_FD(pair[1]);
+        assert_se(sd_bus_set_anonymous(b, true) >= 0);
+        assert_se(sd_bus_negotiate_fds(b, negotiate_fds) >= 0);
+        assert_se(sd_bus_start(b) >= 0);
+
+        while (sd_bus_is_ready(a) <= 0 || sd_bus_is_ready(b) <= 0) {
+                assert_se(sd_bus_process(a, NULL) >= 0);
+                assert_se(sd_bus_process(b, NULL) >= 0);
+        }
+
+        assert_se((sd_bus_can_send(b, 'h') > 0) == negotiate_fds);
+
+        /* Queue the whole burst before the other side reads anything */
+        for (unsigned i = 0; i < N_MESSAGES; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                assert_se(sd_bus_message_new_signal(b, &m, "/org/freedesktop/systemd/test", "org.freedesktop.systemd.test", "Burst") >= 0);
+                if (negotiate_fds && i % FD_EVERY == 0)
+                        assert_se(sd_bus_message_append(m, "uh", i, pipe_fds[1]) >= 0);
+                else
+                        /* Vary the size, so that messages start at all kinds of alignments in the buffer */
+                        assert_se(sd_bus_message_append(m, "us", i, waldo + i % (sizeof(waldo) - 1)) >= 0);
+                assert_se(sd_bus_send(b, m, NULL) >= 0);
+        }
+        assert_se(sd_bus_flush(b) >= 0);
+
+        while (n < N_MESSAGES) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                uint32_t u;
+                int r;
+
+                r = sd_bus_process(a, &m);
+                assert_se(r >= 0);
+                if (r == 0) {
+                        assert_se(sd_bus_wait(a, UINT64_MAX) >= 0);
+                        continue;
+                }
+                if (!m)
+                        continue;
+
+                assert_se(sd_bus_message_is_signal(m, "org.freedesktop.systemd.test", "Burst"));
+
+                if (negotiate_fds && n % FD_EVERY == 0) {
+                        struct stat st;
+                        int fd;
+
+                        assert_se(sd_bus_message_has_signature(m, "uh"));
+                        assert_se(sd_bus_message_read(m, "uh", &u, &fd) >= 0);
+                        assert_se(fstat(fd, &st) >= 0);
+                        assert_se(st.st_dev == pipe_st.st_dev && st.st_ino == pipe_st.st_ino);
+                } else {
+                        const char *s;
+
+                        assert_se(sd_bus_message_has_signature(m, "us"));
+                        assert_se(sd_bus_message_read(m, "us", &u, &s) >= 0);
+                        assert_se(streq(s, waldo + n % (sizeof(waldo) - 1)));
+                }
+
+                assert_se(u == n);
+                n++;
+        }
+
+        /* Everything was consumed, including all file descriptors */
+        assert_se(a->rbuffer_size == 0);
+        assert_se(a->n_fds == 0);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_burst(false);
+        test_burst(true);
+
+        return 0;
+}
@@ -2,6 +2,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 
 #if HAVE_GLIB
 #include <gio/gio.h>
@@ -15,6 +16,7 @@
 
 #include "alloc-util.h"
 #include "bus-dump.h"
+#include "bus-internal.h"
 #include "bus-label.h"
 #include "bus-message.h"
 #include "bus-util.h"
@@ -22,6 +24,7 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "log.h"
+#include "memory-util.h"
 #include "tests.h"
 #include "util.h"
 
@@ -105,6 +108,96 @@ static void test_bus_label_escape(void) {
         test_bus_label_escape_one(":1", "_3a1");
 }
 
+static void append_unit_info(sd_bus_message *m, const BusCompiledSignature *s, unsigned i) {
+        const char *id = i % 2 ? "foo.service" : "bar.socket";
+
+        if (s)
+                assert_se(bus_message_append_compiled(m, s, id, "Waldo", "loaded", "active", "running", "",
+                                                      "/org/freedesktop/systemd1/unit/foo", i, "", "/") >= 0);
+        else
+                assert_se(sd_bus_message_append(m, "(ssssssouso)", id, "Waldo", "loaded", "active", "running", "",
+                                                "/org/freedesktop/systemd1/unit/foo", i, "", "/") >= 0);
+}
+
+static void test_bus_append_compiled_one(sd_bus *bus, int version) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *a = NULL, *b = NULL;
+        _cleanup_(bus_compiled_signature_freep) BusCompiledSignature *unit_info = NULL, *pair = NULL, *top = NULL;
+        _cleanup_free_ void *blob_a = NULL, *blob_b = NULL;
+        size_t size_a, size_b;
+
+        log_info("/* %s(version=%i) */", __func__, version);
+
+        bus->message_version = version;
+
+        assert_se(bus_compiled_signature_new("(ssssssouso)", &unit_info) >= 0);
+        assert_se(bus_compiled_signature_new("{su}", &pair) >= 0);
+        assert_se(bus_compiled_signature_new("ub(dt)", &top) >= 0);
+
+        /* Both ways of appending result in the very same message */
+        for (unsigned k = 0; k < 2; k++) {
+                sd_bus_message **m = k == 0 ? &a : &b;
+
+                assert_se(sd_bus_message_new_method_call(bus, m, "foobar.waldo", "/", "foobar.waldo", "Piep") >= 0);
+
+                if (k == 0)
+                        assert_se(sd_bus_message_append(*m, "ub(dt)", 4711, true, 3.5, UINT64_C(815)) >= 0);
+                else
+                        assert_se(bus_message_append_compiled(*m, top, 4711, true, 3.5, UINT64_C(815)) >= 0);
+
+                assert_se(sd_bus_message_open_container(*m, 'a', "(ssssssouso)") >= 0);
+                for (unsigned i = 0; i < 100; i++)
+                        append_unit_info(*m, k == 0 ? NULL : unit_info, i);
+                assert_se(sd_bus_message_close_container(*m) >= 0);
+
+                assert_se(sd_bus_message_open_container(*m, 'a', "{su}") >= 0);
+                for (unsigned i = 0; i < 10; i++)
+                        if (k == 0)
+                                assert_se(sd_bus_message_append(*m, "{su}", "key", i) >= 0);
+                        else
+                                assert_se(bus_message_append_compiled(*m, pair, "key", i) >= 0);
+                assert_se(sd_bus_message_close_container(*m) >= 0);
+
+                /* Neither may be used where a different type is expected */
+                assert_se(sd_bus_message_open_container(*m, 'a', "(su)") >= 0);
+                assert_se(bus_message_append_compiled(*m, unit_info, "a", "b", "c", "d", "e", "f", "/", 0, "g", "/") == -ENXIO);
+        }
+
+        /* The failed attempt left both messages intact */
+        assert_se(sd_bus_message_close_container(a) >= 0);
+        assert_se(sd_bus_message_close_container(b) >= 0);
+        assert_se(sd_bus_message_seal(a, 1, 0) >= 0);
+        assert_se(sd_bus_message_seal(b, 1, 0) >= 0);
+        assert_se(bus_message_get_blob(a, &blob_a, &size_a) >= 0);
+        assert_se(bus_message_get_blob(b, &blob_b, &size_b) >= 0);
+        assert_se(memcmp_nn(blob_a, size_a, blob_b, size_b) == 0);
+}
+
+static void test_bus_append_compiled(void) {
+        _cleanup_(bus_compiled_signature_freep) BusCompiledSignature *s = NULL;
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(bus_compiled_signature_new("", &s) == -EINVAL);
+        assert_se(bus_compiled_signature_new("(s", &s) == -EINVAL);
+        assert_se(bus_compiled_signature_new("s)", &s) == -EINVAL);
+        assert_se(bus_compiled_signature_new("()", &s) == -EINVAL);
+        assert_se(bus_compiled_signature_new("{ss}{s}", &s) == -EINVAL);
+        assert_se(bus_compiled_signature_new("(sas)", &s) == -EOPNOTSUPP);
+        assert_se(bus_compiled_signature_new("v", &s) == -EOPNOTSUPP);
+
+        /* Messages are only created, never sent */
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        test_bus_append_compiled_one(bus, 1);
+        test_bus_append_compiled_one(bus, 2);
+}
+
 int main(int argc, char *argv[]) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *copy = NULL;
         int r, boolean;
@@ -124,6 +217,8 @@ int main(int argc, char *argv[]) {
 
         test_setup_logging(LOG_INFO);
 
+        test_bus_append_compiled();
+
         r = sd_bus_default_user(&bus);
         if (r < 0)
                 r = sd_bus_default_system(&bus);
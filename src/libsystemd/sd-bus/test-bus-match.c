@@ -73,7 +73,7 @@ int main(int argc, char *argv[]) {
 
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
-        sd_bus_slot slots[19] = {};
+        sd_bus_slot slots[24] = {};
         int r;
 
         test_setup_logging(LOG_INFO);
@@ -102,6 +102,11 @@ int main(int argc, char *argv[]) {
         assert_se(match_add(slots, &root, "arg4has='pa'", 16) >= 0);
         assert_se(match_add(slots, &root, "arg4has='po'", 17) >= 0);
         assert_se(match_add(slots, &root, "arg4='pi'", 18) >= 0);
+        assert_se(match_add(slots, &root, "path_namespace='/'", 19) >= 0);
+        assert_se(match_add(slots, &root, "path_namespace='/foo/b'", 20) >= 0);
+        assert_se(match_add(slots, &root, "path_namespace='/foo/bar'", 21) >= 0);
+        assert_se(match_add(slots, &root, "arg3namespace='prefix.four'", 22) >= 0);
+        assert_se(match_add(slots, &root, "arg3namespace='pre'", 23) >= 0);
 
         bus_match_dump(stdout, &root, 0);
 
@@ -111,7 +116,7 @@ int main(int argc, char *argv[]) {
 
         zero(mask);
         assert_se(bus_match_run(NULL, &root, m) == 0);
-        assert_se(mask_contains((unsigned[]) { 9, 8, 7, 5, 10, 12, 13, 14, 15, 16, 17 }, 11));
+        assert_se(mask_contains((unsigned[]) { 9, 8, 7, 5, 10, 12, 13, 14, 15, 16, 17, 19, 21, 22 }, 14));
 
         assert_se(bus_match_remove(&root, &slots[8].match_callback) >= 0);
         assert_se(bus_match_remove(&root, &slots[13].match_callback) >= 0);
@@ -120,7 +125,11 @@ int main(int argc, char *argv[]) {
 
         zero(mask);
         assert_se(bus_match_run(NULL, &root, m) == 0);
-        assert_se(mask_contains((unsigned[]) { 9, 5, 10, 12, 14, 7, 15, 16, 17 }, 9));
+        assert_se(mask_contains((unsigned[]) { 9, 5, 10, 12, 14, 7, 15, 16, 17, 19, 21, 22 }, 12));
+
+        assert_se(slots[10].match_callback.n_hits == 2);
+        assert_se(slots[13].match_callback.n_hits == 1);
+        assert_se(slots[20].match_callback.n_hits == 0);
 
         for (enum bus_match_node_type i = 0; i < _BUS_MATCH_NODE_TYPE_MAX; i++) {
                 char buf[32];
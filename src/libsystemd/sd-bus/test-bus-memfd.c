@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd-bus.h"
+
+#include "bus-internal.h"
+#include "bus-kernel.h"
+#include "bus-message.h"
+#include "fd-util.h"
+#include "memory-util.h"
+#include "tests.h"
+
+static void connect_pair(sd_bus **ret_server, sd_bus **ret_client, bool negotiate_fds) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *a = NULL, *b = NULL;
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        sd_id128_t id;
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&a) >= 0);
+        assert_se(sd_bus_set_fd(a, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_set_server(a, 1, id) >= 0);
+        assert_se(sd_bus_set_anonymous(a, true) >= 0);
+        assert_se(sd_bus_negotiate_fds(a, negotiate_fds) >= 0);
+        assert_se(sd_bus_start(a) >= 0);
+
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, pair[1], pair[1]) >= 0);
+        TAKE_FD(pair[1]);
+        assert_se(sd_bus_set_anonymous(b, true) >= 0);
+        assert_se(sd_bus_negotiate_fds(b, negotiate_fds) >= 0);
+        assert_se(sd_bus_start(b) >= 0);
+
+        while (sd_bus_is_ready(a) <= 0 || sd_bus_is_ready(b) <= 0) {
+                assert_se(sd_bus_process(a, NULL) >= 0);
+                assert_se(sd_bus_process(b, NULL) >= 0);
+        }
+
+        *ret_server = TAKE_PTR(a);
+        *ret_client = TAKE_PTR(b);
+}
+
+static void test_memfd_body(bool negotiate_fds, size_t size) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *a = NULL, *b = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *received = NULL;
+        _cleanup_close_pair_ int pipe_fds[2] = { -1, -1 };
+        _cleanup_free_ uint8_t *payload = NULL;
+        struct stat pipe_st, st;
+        const void *data;
+        size_t n;
+        int fd;
+
+        log_info("/* %s(negotiate_fds=%s, size=%zu) */", __func__, yes_no(negotiate_fds), size);
+
+        connect_pair(&a, &b, negotiate_fds);
+
+        /* Both ends are sd-bus and talk directly to each other, hence agree on memfd bodies whenever they
+         * agree on passing fds */
+        assert_se(a->can_memfd == negotiate_fds);
+        assert_se(b->can_memfd == negotiate_fds);
+
+        assert_se(payload = malloc(size));
+        for (size_t i = 0; i < size; i++)
+                payload[i] = (uint8_t) (i * 7);
+
+        assert_se(sd_bus_message_new_signal(b, &m, "/org/freedesktop/systemd/test", "org.freedesktop.systemd.test", "Large") >= 0);
+        assert_se(sd_bus_message_append_array(m, 'y', payload, size) >= 0);
+        if (negotiate_fds) {
+                assert_se(pipe2(pipe_fds, O_CLOEXEC) >= 0);
+                assert_se(fstat(pipe_fds[1], &pipe_st) >= 0);
+                assert_se(sd_bus_message_append(m, "h", pipe_fds[1]) >= 0);
+        }
+        assert_se(sd_bus_send(b, m, NULL) >= 0);
+
+        /* Without memfds the message doesn't fit into the socket buffer, hence keep both sides going */
+        for (;;) {
+                int r;
+
+                r = sd_bus_process(a, &received);
+                assert_se(r >= 0);
+                if (received)
+                        break;
+                if (r == 0) {
+                        assert_se(sd_bus_process(b, NULL) >= 0);
+                        assert_se(sd_bus_wait(a, 10 * USEC_PER_MSEC) >= 0);
+                }
+        }
+
+        assert_se(sd_bus_message_is_signal(received, "org.freedesktop.systemd.test", "Large"));
+        assert_se((received->body.memfd >= 0) == (negotiate_fds && size >= MEMFD_MIN_SIZE));
+        assert_se(!FLAGS_SET(received->header->flags, BUS_MESSAGE_MEMFD_BODY));
+
+        assert_se(sd_bus_message_read_array(received, 'y', &data, &n) >= 0);
+        assert_se(memcmp_nn(data, n, payload, size) == 0);
+
+        if (negotiate_fds) {
+                assert_se(sd_bus_message_read(received, "h", &fd) >= 0);
+                assert_se(fstat(fd, &st) >= 0);
+                assert_se(st.st_dev == pipe_st.st_dev && st.st_ino == pipe_st.st_ino);
+        }
+
+        assert_se(sd_bus_message_at_end(received, true) > 0);
+
+        /* Nothing was left behind */
+        assert_se(a->rbuffer_size == 0);
+        assert_se(a->n_fds == 0);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_memfd_body(false, 4 * MEMFD_MIN_SIZE);
+        test_memfd_body(true, 4096);
+        test_memfd_body(true, 4 * MEMFD_MIN_SIZE);
+
+        return 0;
+}
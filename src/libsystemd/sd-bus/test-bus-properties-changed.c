@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+#include "sd-event.h"
+
+#include "bus-internal.h"
+#include "fd-util.h"
+#include "strv.h"
+#include "tests.h"
+
+typedef struct Object {
+        uint32_t a, b, c;
+} Object;
+
+static const sd_bus_vtable object_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_PROPERTY("A", "u", NULL, offsetof(Object, a), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("B", "u", NULL, offsetof(Object, b), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("C", "u", NULL, offsetof(Object, c), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_VTABLE_END
+};
+
+static void connect_pair(sd_bus **ret_server, sd_bus **ret_client) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *a = NULL, *b = NULL;
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        sd_id128_t id;
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&a) >= 0);
+        assert_se(sd_bus_set_fd(a, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_set_server(a, 1, id) >= 0);
+        assert_se(sd_bus_set_anonymous(a, true) >= 0);
+        assert_se(sd_bus_start(a) >= 0);
+
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, pair[1], pair[1]) >= 0);
+        TAKE_FD(pair[1]);
+        assert_se(sd_bus_set_anonymous(b, true) >= 0);
+        assert_se(sd_bus_start(b) >= 0);
+
+        while (sd_bus_is_ready(a) <= 0 || sd_bus_is_ready(b) <= 0) {
+                assert_se(sd_bus_process(a, NULL) >= 0);
+                assert_se(sd_bus_process(b, NULL) >= 0);
+        }
+
+        *ret_server = TAKE_PTR(a);
+        *ret_client = TAKE_PTR(b);
+}
+
+static void receive_properties_changed(sd_bus *server, sd_bus *client, const char *path, const char *expected) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_strv_free_ char **changed = NULL;
+        _cleanup_free_ char *joined = NULL;
+        const char *interface;
+
+        assert_se(sd_bus_flush(server) >= 0);
+
+        for (;;) {
+                int r;
+
+                r = sd_bus_process(client, &m);
+                assert_se(r >= 0);
+                if (m)
+                        break;
+                if (r == 0)
+                        assert_se(sd_bus_wait(client, UINT64_MAX) >= 0);
+        }
+
+        assert_se(sd_bus_message_is_signal(m, "org.freedesktop.DBus.Properties", "PropertiesChanged"));
+        assert_se(streq(sd_bus_message_get_path(m), path));
+
+        assert_se(sd_bus_message_read(m, "s", &interface) >= 0);
+        assert_se(streq(interface, "org.freedesktop.systemd.test"));
+
+        assert_se(sd_bus_message_enter_container(m, 'a', "{sv}") >= 0);
+        for (;;) {
+                const char *name;
+                uint32_t u;
+                int r;
+
+                r = sd_bus_message_read(m, "{sv}", &name, "u", &u);
+                assert_se(r >= 0);
+                if (r == 0)
+                        break;
+
+                assert_se(strv_extend(&changed, name) >= 0);
+        }
+        assert_se(sd_bus_message_exit_container(m) >= 0);
+
+        assert_se(joined = strv_join(changed, ","));
+        log_info("Received PropertiesChanged on %s: %s", path, joined);
+        assert_se(streq(joined, expected));
+}
+
+static void assert_nothing_received(sd_bus *client) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+        assert_se(sd_bus_process(client, &m) == 0);
+        assert_se(!m);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *server = NULL, *client = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        Object o = { 1, 2, 3 }, p = { 4, 5, 6 };
+
+        test_setup_logging(LOG_INFO);
+
+        connect_pair(&server, &client);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_bus_attach_event(server, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        assert_se(sd_bus_add_object_vtable(server, NULL, "/foo", "org.freedesktop.systemd.test", object_vtable, &o) >= 0);
+        assert_se(sd_bus_add_object_vtable(server, NULL, "/bar", "org.freedesktop.systemd.test", object_vtable, &p) >= 0);
+
+        /* Without coalescing every change results in a signal of its own */
+        assert_se(sd_bus_get_coalesce_properties_changed(server) == 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.systemd.test", "A", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.systemd.test", "B", NULL) >= 0);
+        receive_properties_changed(server, client, "/foo", "A");
+        receive_properties_changed(server, client, "/foo", "B");
+
+        assert_se(sd_bus_set_coalesce_properties_changed(server, true) >= 0);
+        assert_se(sd_bus_get_coalesce_properties_changed(server) > 0);
+
+        /* Changes are merged per object and interface, until the event loop runs */
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.systemd.test", "B", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/bar", "org.freedesktop.systemd.test", "C", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.systemd.test", "A", "B", NULL) >= 0);
+        assert_se(server->wqueue_size == 0);
+        assert_se(sd_event_run(e, 0) >= 0);
+        receive_properties_changed(server, client, "/foo", "B,A");
+        receive_properties_changed(server, client, "/bar", "C");
+        assert_nothing_received(client);
+
+        /* A change of all properties swallows individual ones */
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.systemd.test", "C", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed_strv(server, "/foo", "org.freedesktop.systemd.test", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.systemd.test", "B", NULL) >= 0);
+        assert_se(sd_event_run(e, 0) >= 0);
+        receive_properties_changed(server, client, "/foo", "A,B,C");
+        assert_nothing_received(client);
+
+        /* Flushing sends out pending changes without waiting for the event loop */
+        assert_se(sd_bus_emit_properties_changed(server, "/bar", "org.freedesktop.systemd.test", "A", NULL) >= 0);
+        receive_properties_changed(server, client, "/bar", "A");
+
+        /* And so does turning the feature off */
+        assert_se(sd_bus_emit_properties_changed(server, "/bar", "org.freedesktop.systemd.test", "B", NULL) >= 0);
+        assert_se(server->wqueue_size == 0);
+        assert_se(sd_bus_set_coalesce_properties_changed(server, false) >= 0);
+        receive_properties_changed(server, client, "/bar", "B");
+
+        assert_se(sd_event_run(e, 0) >= 0);
+        assert_nothing_received(client);
+
+        assert_se(sd_bus_detach_event(server) >= 0);
+
+        return 0;
+}
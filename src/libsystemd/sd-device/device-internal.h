@@ -24,6 +24,7 @@ struct sd_device {
         int watch_handle;
 
         sd_device *parent;
+        Hashmap *parent_cache; /* not owned, see device_set_parent_cache() */
 
         OrderedHashmap *properties;
         Iterator properties_iterator;
@@ -700,24 +700,51 @@ _public_ int sd_device_monitor_filter_update(sd_device_monitor *m) {
 
         /* add all subsystem matches */
         if (!hashmap_isempty(m->subsystem_filter)) {
-                HASHMAP_FOREACH_KEY(devtype, subsystem, m->subsystem_filter) {
-                        uint32_t hash = string_hash32(subsystem);
+                unsigned n_plain = 0, k = 0;
+
+                HASHMAP_FOREACH_KEY(devtype, subsystem, m->subsystem_filter)
+                        if (!devtype)
+                                n_plain++;
+
+                /* Subsystems without devtype only need to compare the subsystem hash, hence load it once and
+                 * compare it with all of them in a row, each jumping to a common "pass" statement behind the
+                 * comparisons on a match. This needs one instruction per subsystem instead of three. The jump
+                 * offsets are 8bit though. */
+                if (n_plain > 0) {
+                        if (n_plain > UINT8_MAX || i + n_plain + 3 >= ELEMENTSOF(ins))
+                                return -E2BIG;
 
                         /* load device subsystem value in A */
                         bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(monitor_netlink_header, filter_subsystem_hash));
-                        if (!devtype) {
-                                /* jump if subsystem does not match */
-                                bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, hash, 0, 1);
-                        } else {
-                                /* jump if subsystem does not match */
-                                bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, hash, 0, 3);
-                                /* load device devtype value in A */
-                                bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(monitor_netlink_header, filter_devtype_hash));
-                                /* jump if value does not match */
-                                hash = string_hash32(devtype);
-                                bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, hash, 0, 1);
+
+                        HASHMAP_FOREACH_KEY(devtype, subsystem, m->subsystem_filter) {
+                                if (devtype)
+                                        continue;
+
+                                /* jump to the pass statement if subsystem matches */
+                                bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, string_hash32(subsystem), n_plain - k, 0);
+                                k++;
                         }
 
+                        /* nothing matched, skip the pass statement */
+                        bpf_jmp(ins, &i, BPF_JMP|BPF_JA, 1, 0, 0);
+                        /* matched, pass packet */
+                        bpf_stmt(ins, &i, BPF_RET|BPF_K, 0xffffffff);
+                }
+
+                HASHMAP_FOREACH_KEY(devtype, subsystem, m->subsystem_filter) {
+                        if (!devtype)
+                                continue;
+
+                        /* load device subsystem value in A */
+                        bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(monitor_netlink_header, filter_subsystem_hash));
+                        /* jump if subsystem does not match */
+                        bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, string_hash32(subsystem), 0, 3);
+                        /* load device devtype value in A */
+                        bpf_stmt(ins, &i, BPF_LD|BPF_W|BPF_ABS, offsetof(monitor_netlink_header, filter_devtype_hash));
+                        /* jump if value does not match */
+                        bpf_jmp(ins, &i, BPF_JMP|BPF_JEQ|BPF_K, string_hash32(devtype), 0, 1);
+
                         /* matched, pass packet */
                         bpf_stmt(ins, &i, BPF_RET|BPF_K, 0xffffffff);
 
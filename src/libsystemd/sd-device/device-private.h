@@ -8,6 +8,7 @@
 
 #include "sd-device.h"
 
+#include "hashmap.h"
 #include "macro.h"
 
 int device_new_from_nulstr(sd_device **ret, uint8_t *nulstr, size_t len);
@@ -30,6 +31,9 @@ void device_set_is_initialized(sd_device *device);
 int device_set_watch_handle(sd_device *device, int wd);
 void device_set_db_persist(sd_device *device);
 void device_set_devlink_priority(sd_device *device, int priority);
+/* Parents looked up via sd_device_get_parent() are taken from, and added to, the specified map of syspath to
+ * sd_device, which holds a reference to each device. The cache is inherited by the parents added to it. */
+void device_set_parent_cache(sd_device *device, Hashmap *cache);
 int device_ensure_usec_initialized(sd_device *device, sd_device *device_old);
 int device_add_devlink(sd_device *device, const char *devlink);
 int device_add_property(sd_device *device, const char *property, const char *value);
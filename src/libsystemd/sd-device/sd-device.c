@@ -97,7 +97,7 @@ int device_add_property_aux(sd_device *device, const char *key, const char *valu
                 _cleanup_free_ char *new_key = NULL, *new_value = NULL, *old_key = NULL, *old_value = NULL;
                 int r;
 
-                r = ordered_hashmap_ensure_allocated(properties, &string_hash_ops_free_free);
+                r = ordered_hashmap_ensure_allocated(properties, &string_hash_ops_fast_free_free);
                 if (r < 0)
                         return r;
 
@@ -754,14 +754,38 @@ static int device_new_from_child(sd_device **ret, sd_device *child) {
 
                 *pos = '\0';
 
+                if (child->parent_cache) {
+                        sd_device *cached;
+
+                        cached = hashmap_get(child->parent_cache, path);
+                        if (cached) {
+                                *ret = sd_device_ref(cached);
+                                return 0;
+                        }
+                }
+
                 r = sd_device_new_from_syspath(ret, path);
                 if (r < 0)
                         continue;
 
+                if (child->parent_cache) {
+                        /* The cache is only an optimization, hence ignore failures here. */
+                        if (hashmap_put(child->parent_cache, (*ret)->syspath, *ret) >= 0) {
+                                sd_device_ref(*ret);
+                                (*ret)->parent_cache = child->parent_cache;
+                        }
+                }
+
                 return 0;
         }
 }
 
+void device_set_parent_cache(sd_device *device, Hashmap *cache) {
+        assert(device);
+
+        device->parent_cache = cache;
+}
+
 _public_ int sd_device_get_parent(sd_device *child, sd_device **ret) {
         assert_return(child, -EINVAL);
 
@@ -1937,7 +1961,7 @@ static int device_cache_sysattr_value(sd_device *device, const char *key, char *
                         return -ENOMEM;
         }
 
-        r = hashmap_ensure_put(&device->sysattr_values, &string_hash_ops_free_free, new_key, value);
+        r = hashmap_ensure_put(&device->sysattr_values, &string_hash_ops_fast_free_free, new_key, value);
         if (r < 0)
                 return r;
 
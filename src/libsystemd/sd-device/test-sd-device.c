@@ -164,6 +164,52 @@ static void test_sd_device_enumerator_filter_subsystem(void) {
         assert_se(n_new_dev <= 10);
 }
 
+static void test_sd_device_parent_cache(void) {
+        _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+        Hashmap *cache;
+        sd_device *d;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(cache = hashmap_new(&path_hash_ops));
+
+        assert_se(sd_device_enumerator_new(&e) >= 0);
+        assert_se(sd_device_enumerator_allow_uninitialized(e) >= 0);
+        FOREACH_DEVICE(e, d) {
+                _cleanup_(sd_device_unrefp) sd_device *a = NULL, *b = NULL;
+                sd_device *pa, *pb, *gp;
+                const char *syspath, *p;
+
+                assert_se(sd_device_get_syspath(d, &syspath) >= 0);
+                if (sd_device_get_parent(d, NULL) < 0)
+                        continue;
+
+                /* Two independent objects for the same device share their parents through the cache */
+                assert_se(sd_device_new_from_syspath(&a, syspath) >= 0);
+                assert_se(sd_device_new_from_syspath(&b, syspath) >= 0);
+                device_set_parent_cache(a, cache);
+                device_set_parent_cache(b, cache);
+
+                assert_se(sd_device_get_parent(a, &pa) >= 0);
+                assert_se(sd_device_get_parent(b, &pb) >= 0);
+                assert_se(pa == pb);
+
+                assert_se(sd_device_get_syspath(pa, &p) >= 0);
+                assert_se(hashmap_get(cache, p) == pa);
+
+                /* The parents use the cache for their own parents, too */
+                if (sd_device_get_parent(pa, &gp) >= 0) {
+                        assert_se(sd_device_get_syspath(gp, &p) >= 0);
+                        assert_se(hashmap_get(cache, p) == gp);
+                }
+
+                log_info("syspath:%s cached:%u", syspath, hashmap_size(cache));
+                break;
+        }
+
+        hashmap_free_with_destructor(cache, sd_device_unref);
+}
+
 static void test_sd_device_new_from_nulstr(void) {
         const char *devlinks =
                 "/dev/disk/by-partuuid/1290d63a-42cc-4c71-b87c-xxxxxxxxxxxx\0"
@@ -211,6 +257,7 @@ int main(int argc, char **argv) {
         test_sd_device_enumerator_devices();
         test_sd_device_enumerator_subsystems();
         test_sd_device_enumerator_filter_subsystem();
+        test_sd_device_parent_cache();
 
         test_sd_device_new_from_nulstr();
 
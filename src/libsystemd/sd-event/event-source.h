@@ -7,6 +7,8 @@
 
 #include "sd-event.h"
 
+#include "event-util.h"
+#include "event-work.h"
 #include "fs-util.h"
 #include "hashmap.h"
 #include "list.h"
@@ -27,6 +29,7 @@ typedef enum EventSourceType {
         SOURCE_EXIT,
         SOURCE_WATCHDOG,
         SOURCE_INOTIFY,
+        SOURCE_WORK,
         _SOURCE_EVENT_SOURCE_TYPE_MAX,
         _SOURCE_EVENT_SOURCE_TYPE_INVALID = -EINVAL,
 } EventSourceType;
@@ -81,6 +84,15 @@ struct sd_event_source {
         unsigned earliest_index;
         unsigned latest_index;
 
+        /* The times the two time prioqs are currently ordered by. These may lag behind the actual times
+         * when a timer is moved later, see event_source_time_prioq_update(). */
+        usec_t earliest_key;
+        usec_t latest_key;
+
+        /* The dispatch statistics entry of this event source, if profiling is enabled. Cached here, so
+         * that we don't have to look it up by description on each dispatch. */
+        EventSourceStatistics *statistics;
+
         union {
                 struct {
                         sd_event_io_handler_t callback;
@@ -127,6 +139,10 @@ struct sd_event_source {
                         struct inode_data *inode_data;
                         LIST_FIELDS(sd_event_source, by_inode_data);
                 } inotify;
+                struct {
+                        sd_event_work_done_handler_t callback;
+                        EventWork work;
+                } work;
         };
 };
 
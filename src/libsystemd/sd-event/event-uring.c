@@ -0,0 +1,421 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <endian.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "alloc-util.h"
+#include "event-uring.h"
+#include "fd-util.h"
+#include "hashmap.h"
+#include "memory-util.h"
+#include "missing_syscall.h"
+
+/* The number of submission queue entries. The kernel sizes the completion ring at twice that, and since
+ * we insist on IORING_FEAT_NODROP completions are never lost if the ring overflows, they are just
+ * delivered later. */
+#define EVENT_URING_ENTRIES 256U
+
+/* Our own user_data for requests whose completions we don't care about, i.e. poll removals. Poll
+ * requests use the fd in the upper and a generation counter in the lower 32 bits, with the counter never
+ * being zero. */
+#define USER_DATA_IGNORE UINT64_C(0)
+
+typedef struct EventUringPoll {
+        int fd;
+        uint32_t events;           /* Including EPOLLET and EPOLLONESHOT, as passed in */
+        void *ptr;
+
+        uint32_t generation;       /* Of the poll request currently in flight, if armed */
+        bool armed;
+} EventUringPoll;
+
+struct EventUring {
+        int fd;
+        bool multishot;
+
+        void *ring;
+        size_t ring_size;
+        struct io_uring_sqe *sqes;
+        size_t sqes_size;
+
+        unsigned *sq_head, *sq_tail, *sq_flags;
+        unsigned sq_mask, sq_entries;
+        unsigned sq_tail_local;    /* Entries we filled in, published on submission */
+        unsigned n_queued;         /* Entries published but not submitted yet */
+
+        unsigned *cq_head, *cq_tail;
+        unsigned cq_mask;
+        struct io_uring_cqe *cqes;
+
+        uint32_t generation;
+        Hashmap *polls;            /* fd → EventUringPoll */
+};
+
+EventUring* event_uring_free(EventUring *u) {
+        if (!u)
+                return NULL;
+
+        /* Closing the ring cancels all poll requests still in flight */
+        if (u->sqes)
+                (void) munmap(u->sqes, u->sqes_size);
+        if (u->ring)
+                (void) munmap(u->ring, u->ring_size);
+        safe_close(u->fd);
+
+        hashmap_free_free(u->polls);
+
+        return mfree(u);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(EventUring*, event_uring_free);
+
+int event_uring_new(EventUring **ret) {
+        _cleanup_(event_uring_freep) EventUring *u = NULL;
+        struct io_uring_params p = {
+                .flags = IORING_SETUP_CLAMP,
+        };
+        uint8_t *ring;
+        unsigned *array;
+
+        assert(ret);
+
+        u = new(EventUring, 1);
+        if (!u)
+                return -ENOMEM;
+
+        *u = (EventUring) {
+                .fd = io_uring_setup(EVENT_URING_ENTRIES, &p),
+        };
+        if (u->fd < 0)
+                return -errno;
+
+        u->fd = fd_move_above_stdio(u->fd);
+
+        /* We need a single mapping for both rings (5.4), completions that are never dropped (5.5) and a
+         * timeout argument to io_uring_enter() (5.11). Let the caller fall back to epoll otherwise. */
+        if (!FLAGS_SET(p.features, IORING_FEAT_SINGLE_MMAP|IORING_FEAT_NODROP|IORING_FEAT_EXT_ARG))
+                return -EOPNOTSUPP;
+
+        /* Multishot poll requests appeared in 5.13, which is also the release that introduced resource
+         * tags. There's no feature flag for the former, hence use the latter as marker. */
+        u->multishot = FLAGS_SET(p.features, IORING_FEAT_RSRC_TAGS);
+
+        u->ring_size = MAX(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                           p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe));
+        ring = mmap(NULL, u->ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+        if (ring == MAP_FAILED)
+                return -errno;
+        u->ring = ring;
+
+        u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        u->sqes = mmap(NULL, u->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQES);
+        if (u->sqes == MAP_FAILED) {
+                u->sqes = NULL;
+                return -errno;
+        }
+
+        u->sq_head = (unsigned*) (ring + p.sq_off.head);
+        u->sq_tail = (unsigned*) (ring + p.sq_off.tail);
+        u->sq_flags = (unsigned*) (ring + p.sq_off.flags);
+        u->sq_mask = *(unsigned*) (ring + p.sq_off.ring_mask);
+        u->sq_entries = p.sq_entries;
+        u->sq_tail_local = *u->sq_tail;
+
+        u->cq_head = (unsigned*) (ring + p.cq_off.head);
+        u->cq_tail = (unsigned*) (ring + p.cq_off.tail);
+        u->cq_mask = *(unsigned*) (ring + p.cq_off.ring_mask);
+        u->cqes = (struct io_uring_cqe*) (ring + p.cq_off.cqes);
+
+        /* Submission queue entries are used in order, hence the index array maps each slot to itself */
+        array = (unsigned*) (ring + p.sq_off.array);
+        for (unsigned i = 0; i < p.sq_entries; i++)
+                array[i] = i;
+
+        *ret = TAKE_PTR(u);
+        return 0;
+}
+
+int event_uring_fd(EventUring *u) {
+        assert(u);
+
+        return u->fd;
+}
+
+int event_uring_submit(EventUring *u) {
+        assert(u);
+
+        while (u->n_queued > 0) {
+                int r;
+
+                r = io_uring_enter(u->fd, u->n_queued, 0, 0, NULL, 0);
+                if (r < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+
+                u->n_queued -= MIN((unsigned) r, u->n_queued);
+        }
+
+        return 0;
+}
+
+static int uring_get_sqe(EventUring *u, struct io_uring_sqe **ret) {
+        struct io_uring_sqe *sqe;
+        int r;
+
+        assert(u);
+        assert(ret);
+
+        if (u->sq_tail_local - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+                /* No room left, hand what we have to the kernel. Without SQPOLL the kernel consumes
+                 * all entries synchronously, hence this frees the whole ring. */
+                r = event_uring_submit(u);
+                if (r < 0)
+                        return r;
+        }
+
+        sqe = u->sqes + (u->sq_tail_local & u->sq_mask);
+        zero(*sqe);
+
+        *ret = sqe;
+        return 0;
+}
+
+static void uring_queue_sqe(EventUring *u) {
+        assert(u);
+
+        u->sq_tail_local++;
+        __atomic_store_n(u->sq_tail, u->sq_tail_local, __ATOMIC_RELEASE);
+        u->n_queued++;
+}
+
+static uint64_t poll_user_data(const EventUringPoll *p) {
+        return (uint64_t) (unsigned) p->fd << 32 | p->generation;
+}
+
+static int uring_poll_arm(EventUring *u, EventUringPoll *p) {
+        struct io_uring_sqe *sqe;
+        uint32_t mask;
+        int r;
+
+        assert(u);
+        assert(p);
+        assert(!p->armed);
+
+        r = uring_get_sqe(u, &sqe);
+        if (r < 0)
+                return r;
+
+        /* Skip zero, that's USER_DATA_IGNORE */
+        if (++u->generation == 0)
+                u->generation = 1;
+        p->generation = u->generation;
+
+        mask = p->events & ~(EPOLLET|EPOLLONESHOT);
+#if __BYTE_ORDER == __BIG_ENDIAN
+        /* The kernel reads the 32bit mask as two 16bit halves, for compatibility with poll_events */
+        mask = (mask << 16) | (mask >> 16);
+#endif
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = p->fd;
+        sqe->poll32_events = mask;
+        sqe->user_data = poll_user_data(p);
+
+        /* Edge triggered sources stay armed. Level triggered ones are re-armed after each completion,
+         * which also reports readiness that is still pending at that point, like epoll does. */
+        if (u->multishot && FLAGS_SET(p->events, EPOLLET))
+                sqe->len = IORING_POLL_ADD_MULTI;
+
+        uring_queue_sqe(u);
+        p->armed = true;
+
+        return 0;
+}
+
+static int uring_poll_disarm(EventUring *u, EventUringPoll *p) {
+        struct io_uring_sqe *sqe;
+        int r;
+
+        assert(u);
+        assert(p);
+
+        if (!p->armed)
+                return 0;
+
+        r = uring_get_sqe(u, &sqe);
+        if (r < 0)
+                return r;
+
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = poll_user_data(p);
+        sqe->user_data = USER_DATA_IGNORE;
+
+        uring_queue_sqe(u);
+        p->armed = false;
+
+        return 0;
+}
+
+int event_uring_ctl(EventUring *u, int op, int fd, uint32_t events, void *ptr) {
+        _cleanup_free_ EventUringPoll *n = NULL;
+        EventUringPoll *p;
+        struct stat st;
+        int r;
+
+        assert(u);
+        assert(fd >= 0);
+
+        /* Like epoll_ctl(), but returns negative errno. Stale completions of requests that are removed
+         * here are recognized by their generation and dropped. Note that unlike epoll, a poll request in
+         * flight pins the file, until the removal is submitted with the next wait. */
+
+        switch (op) {
+
+        case EPOLL_CTL_ADD:
+                if (hashmap_contains(u->polls, FD_TO_PTR(fd)))
+                        return -EEXIST;
+
+                /* poll() on regular files and directories always succeeds, while epoll refuses them.
+                 * Let's stay compatible, callers rely on that. */
+                if (fstat(fd, &st) < 0)
+                        return -errno;
+                if (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode))
+                        return -EPERM;
+
+                n = new(EventUringPoll, 1);
+                if (!n)
+                        return -ENOMEM;
+
+                *n = (EventUringPoll) {
+                        .fd = fd,
+                        .events = events,
+                        .ptr = ptr,
+                };
+
+                r = hashmap_ensure_put(&u->polls, NULL, FD_TO_PTR(fd), n);
+                if (r < 0)
+                        return r;
+
+                r = uring_poll_arm(u, n);
+                if (r < 0) {
+                        hashmap_remove(u->polls, FD_TO_PTR(fd));
+                        return r;
+                }
+
+                TAKE_PTR(n);
+                return 0;
+
+        case EPOLL_CTL_MOD:
+                p = hashmap_get(u->polls, FD_TO_PTR(fd));
+                if (!p)
+                        return -ENOENT;
+
+                r = uring_poll_disarm(u, p);
+                if (r < 0)
+                        return r;
+
+                p->events = events;
+                p->ptr = ptr;
+
+                return uring_poll_arm(u, p);
+
+        case EPOLL_CTL_DEL:
+                p = hashmap_remove(u->polls, FD_TO_PTR(fd));
+                if (!p)
+                        return -ENOENT;
+
+                r = uring_poll_disarm(u, p);
+                free(p);
+                return r;
+
+        default:
+                return -EINVAL;
+        }
+}
+
+static bool uring_cq_empty(EventUring *u) {
+        assert(u);
+
+        return *u->cq_head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE) &&
+                !FLAGS_SET(__atomic_load_n(u->sq_flags, __ATOMIC_RELAXED), IORING_SQ_CQ_OVERFLOW);
+}
+
+int event_uring_wait(EventUring *u, struct epoll_event *events, size_t n_events, usec_t timeout) {
+        unsigned head, tail;
+        size_t m = 0;
+        int r;
+
+        assert(u);
+        assert(events);
+        assert(n_events > 0);
+
+        /* Like epoll_wait(), but returns negative errno. Submits all queued changes in the same go. */
+
+        if (u->n_queued > 0 || uring_cq_empty(u)) {
+                struct __kernel_timespec ts;
+                struct io_uring_getevents_arg arg = {};
+                unsigned min_complete;
+
+                min_complete = timeout > 0 && uring_cq_empty(u);
+                if (min_complete > 0 && timeout != USEC_INFINITY) {
+                        ts = (struct __kernel_timespec) {
+                                .tv_sec = timeout / USEC_PER_SEC,
+                                .tv_nsec = (timeout % USEC_PER_SEC) * NSEC_PER_USEC,
+                        };
+                        arg.ts = PTR_TO_UINT64(&ts);
+                }
+
+                r = io_uring_enter(u->fd, u->n_queued, min_complete,
+                                   IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+                if (r < 0 && errno != ETIME)
+                        return -errno;
+                if (r > 0)
+                        u->n_queued -= MIN((unsigned) r, u->n_queued);
+        }
+
+        head = *u->cq_head;
+        tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail && m < n_events; head++) {
+                const struct io_uring_cqe *cqe = u->cqes + (head & u->cq_mask);
+                EventUringPoll *p;
+                int fd;
+
+                if (cqe->user_data == USER_DATA_IGNORE)
+                        continue;
+
+                fd = (int) (cqe->user_data >> 32);
+                p = hashmap_get(u->polls, FD_TO_PTR(fd));
+                if (!p || !p->armed || p->generation != (uint32_t) cqe->user_data)
+                        continue; /* A completion for a request that was removed or replaced since */
+
+                if (!FLAGS_SET(cqe->flags, IORING_CQE_F_MORE))
+                        p->armed = false;
+
+                events[m++] = (struct epoll_event) {
+                        /* The request itself failed, e.g. because the fd was closed under us */
+                        .events = cqe->res < 0 ? EPOLLERR : (uint32_t) cqe->res,
+                        .data.ptr = p->ptr,
+                };
+
+                /* One-shot registrations stay disarmed until modified, like with EPOLLONESHOT */
+                if (!p->armed && !FLAGS_SET(p->events, EPOLLONESHOT)) {
+                        r = uring_poll_arm(u, p);
+                        if (r < 0) {
+                                __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+                                return r;
+                        }
+                }
+        }
+
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+        return (int) m;
+}
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+
+#include "time-util.h"
+
+/* An alternative to epoll for sd-event, built on io_uring poll requests. The interface mirrors
+ * epoll_ctl() and epoll_wait(), so that sd-event can use either transparently. Registration changes are
+ * queued in the submission ring and handed to the kernel together with the next wait, hence an event
+ * loop iteration needs a single system call, regardless of how many sources were changed. */
+
+typedef struct EventUring EventUring;
+
+int event_uring_new(EventUring **ret);
+EventUring* event_uring_free(EventUring *u);
+
+int event_uring_fd(EventUring *u);
+
+int event_uring_ctl(EventUring *u, int op, int fd, uint32_t events, void *ptr);
+int event_uring_submit(EventUring *u);
+int event_uring_wait(EventUring *u, struct epoll_event *events, size_t n_events, usec_t timeout);
@@ -2,12 +2,37 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "sd-event.h"
 
+#include "macro.h"
+#include "time-util.h"
+
 int event_reset_time(sd_event *e, sd_event_source **s,
                      clockid_t clock, uint64_t usec, uint64_t accuracy,
                      sd_event_time_handler_t callback, void *userdata,
                      int64_t priority, const char *description, bool force_reset);
 int event_source_disable(sd_event_source *s);
 int event_source_is_enabled(sd_event_source *s);
+
+typedef struct EventSourceStatistics {
+        const char *type;
+        char *description;
+
+        uint64_t n_dispatched;
+        usec_t total_usec;
+        usec_t max_usec;
+
+        /* Logarithmic histogram of dispatch times, in the range 2^0 … 2^63 us */
+        unsigned histogram[sizeof(usec_t) * 8];
+} EventSourceStatistics;
+
+EventSourceStatistics* event_source_statistics_free(EventSourceStatistics *s);
+DEFINE_TRIVIAL_CLEANUP_FUNC(EventSourceStatistics*, event_source_statistics_free);
+void event_source_statistics_free_many(EventSourceStatistics *s, size_t n);
+
+int event_set_profile_sources(sd_event *e, bool b);
+int event_get_profile_sources(sd_event *e);
+int event_get_source_statistics(sd_event *e, EventSourceStatistics **ret, size_t *ret_n);
+int event_dump_source_statistics(sd_event *e, FILE *f, const char *prefix);
@@ -0,0 +1,259 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+
+#include "alloc-util.h"
+#include "event-work.h"
+#include "fd-util.h"
+#include "macro.h"
+#include "process-util.h"
+
+struct EventWorkPool {
+        pthread_mutex_t mutex;
+        pthread_cond_t queued;     /* Signalled when work is queued, or the pool is going away */
+        pthread_cond_t finished;   /* Signalled when a thread finished executing work */
+
+        int fd;                    /* eventfd, written to when work is done */
+        pid_t original_pid;
+
+        pthread_t *threads;
+        unsigned n_threads, max_threads;
+        unsigned n_idle;
+        bool quit;
+
+        LIST_HEAD(EventWork, queue);
+        EventWork *queue_tail;
+        LIST_HEAD(EventWork, done);
+};
+
+static void* thread_worker(void *p) {
+        EventWorkPool *pool = p;
+
+        assert(pool);
+
+        assert_se(pthread_mutex_lock(&pool->mutex) == 0);
+
+        for (;;) {
+                EventWork *w;
+
+                while (!pool->quit && !pool->queue) {
+                        pool->n_idle++;
+                        assert_se(pthread_cond_wait(&pool->queued, &pool->mutex) == 0);
+                        pool->n_idle--;
+                }
+
+                if (pool->quit)
+                        break;
+
+                w = pool->queue;
+                LIST_REMOVE(work, pool->queue, w);
+                if (pool->queue_tail == w)
+                        pool->queue_tail = NULL;
+
+                w->state = EVENT_WORK_RUNNING;
+
+                /* Don't hold the lock while executing the work, that's the whole point */
+                assert_se(pthread_mutex_unlock(&pool->mutex) == 0);
+                w->result = w->func(w->userdata);
+                assert_se(pthread_mutex_lock(&pool->mutex) == 0);
+
+                w->state = EVENT_WORK_DONE;
+                LIST_PREPEND(work, pool->done, w);
+
+                /* Wake up the event loop. This never blocks, as the counter can't plausibly overflow. */
+                (void) eventfd_write(pool->fd, 1);
+
+                assert_se(pthread_cond_broadcast(&pool->finished) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&pool->mutex) == 0);
+        return NULL;
+}
+
+int event_work_pool_new(unsigned max_threads, EventWorkPool **ret) {
+        EventWorkPool *p;
+
+        assert(max_threads > 0);
+        assert(ret);
+
+        p = new(EventWorkPool, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *p = (EventWorkPool) {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .queued = PTHREAD_COND_INITIALIZER,
+                .finished = PTHREAD_COND_INITIALIZER,
+                .original_pid = getpid_cached(),
+                .max_threads = max_threads,
+        };
+
+        p->threads = new(pthread_t, max_threads);
+        if (!p->threads) {
+                free(p);
+                return -ENOMEM;
+        }
+
+        p->fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (p->fd < 0) {
+                free(p->threads);
+                free(p);
+                return -errno;
+        }
+
+        p->fd = fd_move_above_stdio(p->fd);
+
+        *ret = p;
+        return 0;
+}
+
+EventWorkPool* event_work_pool_free(EventWorkPool *p) {
+        if (!p)
+                return NULL;
+
+        /* The threads only exist in the process that created them. After fork() there's nothing to stop and
+         * nothing to join. */
+        if (p->original_pid == getpid_cached()) {
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+                p->quit = true;
+                assert_se(pthread_cond_broadcast(&p->queued) == 0);
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+                for (unsigned i = 0; i < p->n_threads; i++)
+                        (void) pthread_join(p->threads[i], NULL);
+        }
+
+        safe_close(p->fd);
+        free(p->threads);
+        return mfree(p);
+}
+
+int event_work_pool_fd(EventWorkPool *p) {
+        assert(p);
+
+        return p->fd;
+}
+
+static int start_thread(EventWorkPool *p) {
+        sigset_t ss, saved_ss;
+        int r, k;
+
+        assert(p);
+        assert(p->n_threads < p->max_threads);
+
+        assert_se(sigfillset(&ss) >= 0);
+
+        /* No signals in the threads please, they are delivered to the event loop's thread via signalfd. We
+         * set the mask before creating the thread, so that it never exists with a different mask than a
+         * fully blocked one. */
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        r = -pthread_create(p->threads + p->n_threads, NULL, thread_worker, p);
+        if (r == 0)
+                p->n_threads++;
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (k > 0 && r >= 0)
+                r = -k;
+
+        return r;
+}
+
+int event_work_pool_submit(EventWorkPool *p, EventWork *w) {
+        int r = 0;
+
+        assert(p);
+        assert(w);
+        assert(w->func);
+        assert(w->state == EVENT_WORK_IDLE);
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        /* Start another thread if all existing ones are busy, up to the limit. If that fails but there's
+         * at least one thread, the work will be executed eventually anyway. */
+        if (p->n_idle == 0 && p->n_threads < p->max_threads) {
+                r = start_thread(p);
+                if (r < 0 && p->n_threads > 0)
+                        r = 0;
+        }
+
+        if (r >= 0) {
+                w->state = EVENT_WORK_QUEUED;
+                LIST_INSERT_AFTER(work, p->queue, p->queue_tail, w);
+                p->queue_tail = w;
+
+                assert_se(pthread_cond_signal(&p->queued) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        return r;
+}
+
+void event_work_pool_cancel(EventWorkPool *p, EventWork *w) {
+        assert(p);
+        assert(w);
+
+        /* Makes sure the pool forgets about the work item. Work that is already being executed can't be
+         * interrupted, hence we wait for it to finish. */
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        while (w->state == EVENT_WORK_RUNNING)
+                assert_se(pthread_cond_wait(&p->finished, &p->mutex) == 0);
+
+        switch (w->state) {
+
+        case EVENT_WORK_QUEUED:
+                if (p->queue_tail == w)
+                        p->queue_tail = w->work_prev;
+                LIST_REMOVE(work, p->queue, w);
+                break;
+
+        case EVENT_WORK_DONE:
+                LIST_REMOVE(work, p->done, w);
+                break;
+
+        default:
+                break;
+        }
+
+        w->state = EVENT_WORK_IDLE;
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+}
+
+int event_work_pool_flush(EventWorkPool *p) {
+        eventfd_t x;
+
+        assert(p);
+
+        if (eventfd_read(p->fd, &x) < 0) {
+                if (IN_SET(errno, EAGAIN, EINTR))
+                        return 0;
+
+                return -errno;
+        }
+
+        return 1;
+}
+
+EventWork* event_work_pool_pop_done(EventWorkPool *p) {
+        EventWork *w;
+
+        assert(p);
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        w = p->done;
+        if (w) {
+                LIST_REMOVE(work, p->done, w);
+                w->state = EVENT_WORK_IDLE;
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        return w;
+}
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "list.h"
+#include "macro.h"
+
+/* A bounded pool of threads executing work items for sd-event's work event sources. Completion is
+ * signalled through an eventfd, which sd-event watches like its other internal file descriptors. */
+
+typedef struct EventWorkPool EventWorkPool;
+
+typedef enum EventWorkState {
+        EVENT_WORK_IDLE,      /* Not known to the pool */
+        EVENT_WORK_QUEUED,    /* Waiting for a thread */
+        EVENT_WORK_RUNNING,   /* Being executed by a thread */
+        EVENT_WORK_DONE,      /* Finished, waiting to be collected by event_work_pool_pop_done() */
+} EventWorkState;
+
+typedef struct EventWork EventWork;
+
+struct EventWork {
+        int (*func)(void *userdata);
+        void *userdata;
+        int result;
+
+        /* Protected by the pool's mutex while not idle */
+        EventWorkState state;
+        LIST_FIELDS(EventWork, work);
+};
+
+int event_work_pool_new(unsigned max_threads, EventWorkPool **ret);
+EventWorkPool* event_work_pool_free(EventWorkPool *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(EventWorkPool*, event_work_pool_free);
+
+int event_work_pool_fd(EventWorkPool *p);
+
+int event_work_pool_submit(EventWorkPool *p, EventWork *w);
+void event_work_pool_cancel(EventWorkPool *p, EventWork *w);
+
+int event_work_pool_flush(EventWorkPool *p);
+EventWork* event_work_pool_pop_done(EventWorkPool *p);
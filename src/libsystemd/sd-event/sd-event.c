@@ -11,17 +11,22 @@
 #include "alloc-util.h"
 #include "env-util.h"
 #include "event-source.h"
+#include "event-uring.h"
+#include "event-util.h"
+#include "event-work.h"
 #include "fd-util.h"
 #include "fs-util.h"
 #include "hashmap.h"
 #include "list.h"
 #include "macro.h"
 #include "memory-util.h"
+#include "mempool.h"
 #include "missing_syscall.h"
 #include "prioq.h"
 #include "process-util.h"
 #include "set.h"
 #include "signal-util.h"
+#include "sort-util.h"
 #include "string-table.h"
 #include "string-util.h"
 #include "strxcpyx.h"
@@ -61,10 +66,14 @@ static const char* const event_source_type_table[_SOURCE_EVENT_SOURCE_TYPE_MAX]
         [SOURCE_EXIT] = "exit",
         [SOURCE_WATCHDOG] = "watchdog",
         [SOURCE_INOTIFY] = "inotify",
+        [SOURCE_WORK] = "work",
 };
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING(event_source_type, int);
 
+/* The maximum number of threads executing the work of work event sources */
+#define WORK_THREADS_MAX 16U
+
 #define EVENT_SOURCE_IS_TIME(t)                 \
         IN_SET((t),                             \
                SOURCE_TIME_REALTIME,            \
@@ -96,6 +105,9 @@ struct sd_event {
         int epoll_fd;
         int watchdog_fd;
 
+        /* If set, used instead of epoll_fd */
+        EventUring *uring;
+
         Prioq *pending;
         Prioq *prepare;
 
@@ -122,6 +134,9 @@ struct sd_event {
 
         Hashmap *inotify_data; /* indexed by priority */
 
+        /* Executes the work of work event sources, created on first use */
+        EventWorkPool *work_pool;
+
         /* A list of inode structures that still have an fd open, that we need to close before the next loop iteration */
         LIST_HEAD(struct inode_data, inode_data_to_close);
 
@@ -138,6 +153,8 @@ struct sd_event {
         bool need_process_child:1;
         bool watchdog:1;
         bool profile_delays:1;
+        bool profile_sources:1;
+        bool uring_fd_exported:1;
 
         int exit_code;
 
@@ -154,6 +171,9 @@ struct sd_event {
 
         usec_t last_run_usec, last_log_usec;
         unsigned delays[sizeof(usec_t) * 8];
+
+        /* Dispatch statistics, indexed by event source type and description */
+        Set *source_statistics;
 };
 
 static thread_local sd_event *default_event = NULL;
@@ -266,8 +286,7 @@ static bool event_source_timer_candidate(const sd_event_source *s) {
         return !s->pending || s->ratelimited;
 }
 
-static int time_prioq_compare(const void *a, const void *b, usec_t (*time_func)(const sd_event_source *s)) {
-        const sd_event_source *x = a, *y = b;
+static int time_prioq_compare(const sd_event_source *x, const sd_event_source *y, usec_t tx, usec_t ty) {
         int r;
 
         /* Enabled ones first */
@@ -280,16 +299,20 @@ static int time_prioq_compare(const void *a, const void *b, usec_t (*time_func)(
         if (r != 0)
                 return r;
 
-        /* Order by time */
-        return CMP(time_func(x), time_func(y));
+        /* Order by time, as recorded when the event source was last placed in the prioq */
+        return CMP(tx, ty);
 }
 
 static int earliest_time_prioq_compare(const void *a, const void *b) {
-        return time_prioq_compare(a, b, time_event_source_next);
+        const sd_event_source *x = a, *y = b;
+
+        return time_prioq_compare(x, y, x->earliest_key, y->earliest_key);
 }
 
 static int latest_time_prioq_compare(const void *a, const void *b) {
-        return time_prioq_compare(a, b, time_event_source_latest);
+        const sd_event_source *x = a, *y = b;
+
+        return time_prioq_compare(x, y, x->latest_key, y->latest_key);
 }
 
 static int exit_prioq_compare(const void *a, const void *b) {
@@ -334,7 +357,9 @@ static sd_event *event_free(sd_event *e) {
                 *(e->default_event_ptr) = NULL;
 
         safe_close(e->epoll_fd);
+        event_uring_free(e->uring);
         safe_close(e->watchdog_fd);
+        event_work_pool_free(e->work_pool);
 
         free_clock_data(&e->realtime);
         free_clock_data(&e->boottime);
@@ -353,6 +378,7 @@ static sd_event *event_free(sd_event *e) {
 
         hashmap_free(e->child_sources);
         set_free(e->post_sources);
+        set_free(e->source_statistics);
 
         free(e->event_queue);
 
@@ -396,19 +422,32 @@ _public_ int sd_event_new(sd_event** ret) {
         if (r < 0)
                 goto fail;
 
-        e->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-        if (e->epoll_fd < 0) {
-                r = -errno;
-                goto fail;
+        if (getenv_bool_secure("SD_EVENT_IO_URING") > 0) {
+                r = event_uring_new(&e->uring);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to set up io_uring, falling back to epoll: %m");
         }
 
-        e->epoll_fd = fd_move_above_stdio(e->epoll_fd);
+        if (!e->uring) {
+                e->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+                if (e->epoll_fd < 0) {
+                        r = -errno;
+                        goto fail;
+                }
+
+                e->epoll_fd = fd_move_above_stdio(e->epoll_fd);
+        }
 
         if (secure_getenv("SD_EVENT_PROFILE_DELAYS")) {
                 log_debug("Event loop profiling enabled. Logarithmic histogram of event loop iterations in the range 2^0 … 2^63 us will be logged every 5s.");
                 e->profile_delays = true;
         }
 
+        if (secure_getenv("SD_EVENT_PROFILE_SOURCES")) {
+                log_debug("Event source profiling enabled.");
+                e->profile_sources = true;
+        }
+
         *ret = e;
         return 0;
 
@@ -434,7 +473,39 @@ static bool event_pid_changed(sd_event *e) {
         return e->original_pid != getpid_cached();
 }
 
+static int event_poll_ctl(sd_event *e, int op, int fd, uint32_t events, void *ptr) {
+        assert(e);
+        assert(fd >= 0);
+
+        if (e->uring)
+                return event_uring_ctl(e->uring, op, fd, events, ptr);
+
+        struct epoll_event ev = {
+                .events = events,
+                .data.ptr = ptr,
+        };
+
+        if (epoll_ctl(e->epoll_fd, op, fd, op == EPOLL_CTL_DEL ? NULL : &ev) < 0)
+                return -errno;
+
+        return 0;
+}
+
+static void event_poll_forget(sd_event *e, int fd) {
+        assert(e);
+
+        /* Called before closing an fd we registered, without removing it explicitly. Closing is enough
+         * for epoll, but an io_uring poll request keeps the file open, hence needs to be removed. */
+
+        if (!e->uring || fd < 0 || event_pid_changed(e))
+                return;
+
+        (void) event_uring_ctl(e->uring, EPOLL_CTL_DEL, fd, 0, NULL);
+}
+
 static void source_io_unregister(sd_event_source *s) {
+        int r;
+
         assert(s);
         assert(s->type == SOURCE_IO);
 
@@ -444,8 +515,9 @@ static void source_io_unregister(sd_event_source *s) {
         if (!s->io.registered)
                 return;
 
-        if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->io.fd, NULL) < 0)
-                log_debug_errno(errno, "Failed to remove source %s (type %s) from epoll, ignoring: %m",
+        r = event_poll_ctl(s->event, EPOLL_CTL_DEL, s->io.fd, 0, NULL);
+        if (r < 0)
+                log_debug_errno(r, "Failed to remove source %s (type %s) from epoll, ignoring: %m",
                                 strna(s->description), event_source_type_to_string(s->type));
 
         s->io.registered = false;
@@ -456,19 +528,19 @@ static int source_io_register(
                 int enabled,
                 uint32_t events) {
 
+        int r;
+
         assert(s);
         assert(s->type == SOURCE_IO);
         assert(enabled != SD_EVENT_OFF);
 
-        struct epoll_event ev = {
-                .events = events | (enabled == SD_EVENT_ONESHOT ? EPOLLONESHOT : 0),
-                .data.ptr = s,
-        };
-
-        if (epoll_ctl(s->event->epoll_fd,
-                      s->io.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
-                      s->io.fd, &ev) < 0)
-                return -errno;
+        r = event_poll_ctl(s->event,
+                           s->io.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                           s->io.fd,
+                           events | (enabled == SD_EVENT_ONESHOT ? EPOLLONESHOT : 0),
+                           s);
+        if (r < 0)
+                return r;
 
         s->io.registered = true;
 
@@ -476,6 +548,8 @@ static int source_io_register(
 }
 
 static void source_child_pidfd_unregister(sd_event_source *s) {
+        int r;
+
         assert(s);
         assert(s->type == SOURCE_CHILD);
 
@@ -485,10 +559,12 @@ static void source_child_pidfd_unregister(sd_event_source *s) {
         if (!s->child.registered)
                 return;
 
-        if (EVENT_SOURCE_WATCH_PIDFD(s))
-                if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->child.pidfd, NULL) < 0)
-                        log_debug_errno(errno, "Failed to remove source %s (type %s) from epoll, ignoring: %m",
+        if (EVENT_SOURCE_WATCH_PIDFD(s)) {
+                r = event_poll_ctl(s->event, EPOLL_CTL_DEL, s->child.pidfd, 0, NULL);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to remove source %s (type %s) from epoll, ignoring: %m",
                                         strna(s->description), event_source_type_to_string(s->type));
+        }
 
         s->child.registered = false;
 }
@@ -499,15 +575,15 @@ static int source_child_pidfd_register(sd_event_source *s, int enabled) {
         assert(enabled != SD_EVENT_OFF);
 
         if (EVENT_SOURCE_WATCH_PIDFD(s)) {
-                struct epoll_event ev = {
-                        .events = EPOLLIN | (enabled == SD_EVENT_ONESHOT ? EPOLLONESHOT : 0),
-                        .data.ptr = s,
-                };
+                int r;
 
-                if (epoll_ctl(s->event->epoll_fd,
-                              s->child.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
-                              s->child.pidfd, &ev) < 0)
-                        return -errno;
+                r = event_poll_ctl(s->event,
+                                   s->child.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                                   s->child.pidfd,
+                                   EPOLLIN | (enabled == SD_EVENT_ONESHOT ? EPOLLONESHOT : 0),
+                                   s);
+                if (r < 0)
+                        return r;
         }
 
         s->child.registered = true;
@@ -594,6 +670,7 @@ static void event_free_signal_data(sd_event *e, struct signal_data *d) {
                 return;
 
         hashmap_remove(e->signal_data, &d->priority);
+        event_poll_forget(e, d->fd);
         safe_close(d->fd);
         free(d);
 }
@@ -665,15 +742,9 @@ static int event_make_signal_data(
 
         d->fd = fd_move_above_stdio(r);
 
-        struct epoll_event ev = {
-                .events = EPOLLIN,
-                .data.ptr = d,
-        };
-
-        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, d->fd, &ev) < 0) {
-                r = -errno;
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, d->fd, EPOLLIN, d);
+        if (r < 0)
                 goto fail;
-        }
 
         if (ret)
                 *ret = d;
@@ -786,11 +857,76 @@ static void event_source_time_prioq_reshuffle(sd_event_source *s) {
         else
                 return; /* no-op for an event source which is neither a timer nor ratelimited. */
 
+        s->earliest_key = time_event_source_next(s);
+        s->latest_key = time_event_source_latest(s);
+
         prioq_reshuffle(d->earliest, s, &s->earliest_index);
         prioq_reshuffle(d->latest, s, &s->latest_index);
         d->needs_rearm = true;
 }
 
+static void event_source_time_prioq_update(sd_event_source *s) {
+        struct clock_data *d;
+
+        assert(s);
+        assert(EVENT_SOURCE_IS_TIME(s->type));
+
+        /* Called whenever the time or accuracy of a timer event source changed. Programs with many timers
+         * typically push them into the future over and over again (think: idle timeouts that are reset
+         * whenever there's activity), and most of them never actually elapse. Hence, if the timer only moved
+         * later, let's not reshuffle the prioqs right away, but leave the event source where it is, ordered
+         * by its old, earlier time. That's safe, as the keys in the prioqs are never later than the actual
+         * times: the event source at the top is only stale if its key differs from its actual time, which
+         * event_source_time_prioq_peek_earliest() and _peek_latest() check for, and fix up lazily. Any
+         * other change of the ordering properties (enable state, pending state, ratelimiting) as well as
+         * timers being moved earlier are reshuffled immediately as before. */
+
+        if (s->ratelimited ||
+            s->earliest_index == PRIOQ_IDX_NULL ||
+            s->latest_index == PRIOQ_IDX_NULL ||
+            time_event_source_next(s) < s->earliest_key ||
+            time_event_source_latest(s) < s->latest_key) {
+                event_source_time_prioq_reshuffle(s);
+                return;
+        }
+
+        assert_se(d = event_get_clock_data(s->event, s->type));
+        d->needs_rearm = true;
+}
+
+static sd_event_source* event_source_time_prioq_peek_earliest(struct clock_data *d) {
+        sd_event_source *s;
+
+        assert(d);
+
+        /* Returns the event source that elapses first, after fixing up the prioq for event sources that
+         * were moved later since they were last placed in it. */
+
+        while ((s = prioq_peek(d->earliest)) && s->earliest_key != time_event_source_next(s)) {
+                assert(s->earliest_key < time_event_source_next(s));
+
+                s->earliest_key = time_event_source_next(s);
+                prioq_reshuffle(d->earliest, s, &s->earliest_index);
+        }
+
+        return s;
+}
+
+static sd_event_source* event_source_time_prioq_peek_latest(struct clock_data *d) {
+        sd_event_source *s;
+
+        assert(d);
+
+        while ((s = prioq_peek(d->latest)) && s->latest_key != time_event_source_latest(s)) {
+                assert(s->latest_key < time_event_source_latest(s));
+
+                s->latest_key = time_event_source_latest(s);
+                prioq_reshuffle(d->latest, s, &s->latest_index);
+        }
+
+        return s;
+}
+
 static void event_source_time_prioq_remove(
                 sd_event_source *s,
                 struct clock_data *d) {
@@ -914,6 +1050,11 @@ static void source_disconnect(sd_event_source *s) {
                 break;
         }
 
+        case SOURCE_WORK:
+                /* This blocks if the work is being executed right now */
+                event_work_pool_cancel(s->event->work_pool, &s->work.work);
+                break;
+
         default:
                 assert_not_reached();
         }
@@ -927,6 +1068,8 @@ static void source_disconnect(sd_event_source *s) {
         if (s->ratelimited)
                 event_source_time_prioq_remove(s, &s->event->monotonic);
 
+        s->statistics = NULL;
+
         event = TAKE_PTR(s->event);
         LIST_REMOVE(sources, event->sources, s);
         event->n_sources--;
@@ -988,7 +1131,8 @@ static sd_event_source* source_free(sd_event_source *s) {
                 s->destroy_callback(s->userdata);
 
         free(s->description);
-        return mfree(s);
+        mempool_free(s, sizeof(sd_event_source));
+        return NULL;
 }
 DEFINE_TRIVIAL_CLEANUP_FUNC(sd_event_source*, source_free);
 
@@ -1046,7 +1190,7 @@ static sd_event_source *source_new(sd_event *e, bool floating, EventSourceType t
 
         assert(e);
 
-        s = new(sd_event_source, 1);
+        s = mempool_new(sd_event_source);
         if (!s)
                 return NULL;
 
@@ -1148,6 +1292,7 @@ static int event_setup_timer_fd(
                 return 0;
 
         _cleanup_close_ int fd = -1;
+        int r;
 
         fd = timerfd_create(clock, TFD_NONBLOCK|TFD_CLOEXEC);
         if (fd < 0)
@@ -1155,13 +1300,9 @@ static int event_setup_timer_fd(
 
         fd = fd_move_above_stdio(fd);
 
-        struct epoll_event ev = {
-                .events = EPOLLIN,
-                .data.ptr = d,
-        };
-
-        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
-                return -errno;
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, fd, EPOLLIN, d);
+        if (r < 0)
+                return r;
 
         d->fd = TAKE_FD(fd);
         return 0;
@@ -1205,6 +1346,9 @@ static int event_source_time_prioq_put(
         assert(d);
         assert(EVENT_SOURCE_USES_TIME_PRIOQ(s->type));
 
+        s->earliest_key = time_event_source_next(s);
+        s->latest_key = time_event_source_latest(s);
+
         r = prioq_put(d->earliest, s, &s->earliest_index);
         if (r < 0)
                 return r;
@@ -1673,7 +1817,74 @@ _public_ int sd_event_add_exit(
         return 0;
 }
 
+static int event_setup_work_pool(sd_event *e) {
+        _cleanup_(event_work_pool_freep) EventWorkPool *p = NULL;
+        int r;
+
+        assert(e);
+
+        if (e->work_pool)
+                return 0;
+
+        r = event_work_pool_new(WORK_THREADS_MAX, &p);
+        if (r < 0)
+                return r;
+
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, event_work_pool_fd(p), EPOLLIN, INT_TO_PTR(SOURCE_WORK));
+        if (r < 0)
+                return r;
+
+        e->work_pool = TAKE_PTR(p);
+        return 0;
+}
+
+_public_ int sd_event_add_work(
+                sd_event *e,
+                sd_event_source **ret,
+                sd_event_work_handler_t work,
+                sd_event_work_done_handler_t callback,
+                void *userdata) {
+
+        _cleanup_(source_freep) sd_event_source *s = NULL;
+        int r;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(work, -EINVAL);
+        assert_return(callback, -EINVAL);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        r = event_setup_work_pool(e);
+        if (r < 0)
+                return r;
+
+        s = source_new(e, !ret, SOURCE_WORK);
+        if (!s)
+                return -ENOMEM;
+
+        s->work.callback = callback;
+        s->work.work = (EventWork) {
+                .func = work,
+                .userdata = userdata,
+        };
+        s->userdata = userdata;
+        s->enabled = SD_EVENT_ONESHOT;
+
+        r = event_work_pool_submit(e->work_pool, &s->work.work);
+        if (r < 0)
+                return r;
+
+        if (ret)
+                *ret = s;
+        TAKE_PTR(s);
+
+        return 0;
+}
+
 static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
+        int r;
+
         assert(e);
 
         if (!d)
@@ -1691,8 +1902,9 @@ static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
         assert_se(hashmap_remove(e->inotify_data, &d->priority) == d);
 
         if (d->fd >= 0) {
-                if (epoll_ctl(e->epoll_fd, EPOLL_CTL_DEL, d->fd, NULL) < 0)
-                        log_debug_errno(errno, "Failed to remove inotify fd from epoll, ignoring: %m");
+                r = event_poll_ctl(e, EPOLL_CTL_DEL, d->fd, 0, NULL);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to remove inotify fd from epoll, ignoring: %m");
 
                 safe_close(d->fd);
         }
@@ -1740,13 +1952,8 @@ static int event_make_inotify_data(
                 return r;
         }
 
-        struct epoll_event ev = {
-                .events = EPOLLIN,
-                .data.ptr = d,
-        };
-
-        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, d->fd, &ev) < 0) {
-                r = -errno;
+        r = event_poll_ctl(e, EPOLL_CTL_ADD, d->fd, EPOLLIN, d);
+        if (r < 0) {
                 d->fd = safe_close(d->fd); /* let's close this ourselves, as event_free_inotify_data() would otherwise
                                             * remove the fd from the epoll first, which we don't want as we couldn't
                                             * add it in the first place. */
@@ -2080,6 +2287,9 @@ _public_ int sd_event_source_set_description(sd_event_source *s, const char *des
         assert_return(s, -EINVAL);
         assert_return(!event_pid_changed(s->event), -ECHILD);
 
+        /* The statistics are accounted by description, look them up again on the next dispatch */
+        s->statistics = NULL;
+
         return free_and_strdup(&s->description, description);
 }
 
@@ -2148,7 +2358,7 @@ _public_ int sd_event_source_set_io_fd(sd_event_source *s, int fd) {
                         return r;
                 }
 
-                (void) epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, saved_fd, NULL);
+                (void) event_poll_ctl(s->event, EPOLL_CTL_DEL, saved_fd, 0, NULL);
         }
 
         return 0;
@@ -2404,6 +2614,7 @@ static int event_source_offline(
         case SOURCE_DEFER:
         case SOURCE_POST:
         case SOURCE_INOTIFY:
+        case SOURCE_WORK:
                 break;
 
         default:
@@ -2492,6 +2703,7 @@ static int event_source_online(
         case SOURCE_DEFER:
         case SOURCE_POST:
         case SOURCE_INOTIFY:
+        case SOURCE_WORK:
                 break;
 
         default:
@@ -2562,13 +2774,19 @@ _public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
         assert_return(s->event->state != SD_EVENT_FINISHED, -ESTALE);
         assert_return(!event_pid_changed(s->event), -ECHILD);
 
+        /* No change? Then there's no need to reshuffle the prioqs and rearm the timer fd. Timer units in
+         * PID 1 for example reset their event sources on every clock or timezone change, usually to the
+         * same time. */
+        if (s->time.next == usec && !s->pending)
+                return 0;
+
         r = source_set_pending(s, false);
         if (r < 0)
                 return r;
 
         s->time.next = usec;
 
-        event_source_time_prioq_reshuffle(s);
+        event_source_time_prioq_update(s);
         return 0;
 }
 
@@ -2609,16 +2827,19 @@ _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec
         assert_return(s->event->state != SD_EVENT_FINISHED, -ESTALE);
         assert_return(!event_pid_changed(s->event), -ECHILD);
 
+        if (usec == 0)
+                usec = DEFAULT_ACCURACY_USEC;
+
+        if (s->time.accuracy == usec && !s->pending)
+                return 0;
+
         r = source_set_pending(s, false);
         if (r < 0)
                 return r;
 
-        if (usec == 0)
-                usec = DEFAULT_ACCURACY_USEC;
-
         s->time.accuracy = usec;
 
-        event_source_time_prioq_reshuffle(s);
+        event_source_time_prioq_update(s);
         return 0;
 }
 
@@ -2979,7 +3200,7 @@ static int event_arm_timer(
 
         d->needs_rearm = false;
 
-        a = prioq_peek(d->earliest);
+        a = event_source_time_prioq_peek_earliest(d);
         assert(!a || EVENT_SOURCE_USES_TIME_PRIOQ(a->type));
         if (!a || a->enabled == SD_EVENT_OFF || time_event_source_next(a) == USEC_INFINITY) {
 
@@ -2997,7 +3218,7 @@ static int event_arm_timer(
                 return 0;
         }
 
-        b = prioq_peek(d->latest);
+        b = event_source_time_prioq_peek_latest(d);
         assert(!b || EVENT_SOURCE_USES_TIME_PRIOQ(b->type));
         assert(b && b->enabled != SD_EVENT_OFF);
 
@@ -3066,6 +3287,33 @@ static int flush_timer(sd_event *e, int fd, uint32_t events, usec_t *next) {
         return 0;
 }
 
+static int process_work(sd_event *e, uint32_t events) {
+        bool something_new = false;
+        EventWork *w;
+        int r;
+
+        assert(e);
+        assert(e->work_pool);
+
+        assert_return(events == EPOLLIN, -EIO);
+
+        r = event_work_pool_flush(e->work_pool);
+        if (r <= 0)
+                return r;
+
+        while ((w = event_work_pool_pop_done(e->work_pool))) {
+                sd_event_source *s = container_of(w, sd_event_source, work.work);
+
+                r = source_set_pending(s, true);
+                if (r < 0)
+                        return r;
+
+                something_new = true;
+        }
+
+        return something_new;
+}
+
 static int process_timer(
                 sd_event *e,
                 usec_t n,
@@ -3078,7 +3326,7 @@ static int process_timer(
         assert(d);
 
         for (;;) {
-                s = prioq_peek(d->earliest);
+                s = event_source_time_prioq_peek_earliest(d);
                 assert(!s || EVENT_SOURCE_USES_TIME_PRIOQ(s->type));
 
                 if (!s || time_event_source_next(s) > n)
@@ -3443,9 +3691,95 @@ static int process_inotify(sd_event *e) {
         return done;
 }
 
+EventSourceStatistics* event_source_statistics_free(EventSourceStatistics *s) {
+        if (!s)
+                return NULL;
+
+        free(s->description);
+        return mfree(s);
+}
+
+void event_source_statistics_free_many(EventSourceStatistics *s, size_t n) {
+        for (size_t i = 0; i < n; i++)
+                free(s[i].description);
+
+        free(s);
+}
+
+static void event_source_statistics_hash_func(const EventSourceStatistics *s, struct siphash *state) {
+        string_hash_func(s->type, state);
+        string_hash_func(strempty(s->description), state);
+}
+
+static int event_source_statistics_compare_func(const EventSourceStatistics *x, const EventSourceStatistics *y) {
+        int r;
+
+        r = strcmp(x->type, y->type);
+        if (r != 0)
+                return r;
+
+        return strcmp_ptr(x->description, y->description);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(
+                event_source_statistics_hash_ops,
+                EventSourceStatistics,
+                event_source_statistics_hash_func,
+                event_source_statistics_compare_func,
+                event_source_statistics_free);
+
+static void event_source_account(sd_event *e, sd_event_source *s, EventSourceType type, usec_t t) {
+        EventSourceStatistics *st;
+
+        assert(e);
+        assert(s);
+
+        st = s->statistics;
+        if (!st) {
+                EventSourceStatistics key = {
+                        .type = event_source_type_to_string(type),
+                        .description = s->description,
+                };
+
+                st = set_get(e->source_statistics, &key);
+                if (!st) {
+                        _cleanup_(event_source_statistics_freep) EventSourceStatistics *n = NULL;
+
+                        n = new(EventSourceStatistics, 1);
+                        if (!n)
+                                return;
+
+                        *n = (EventSourceStatistics) {
+                                .type = key.type,
+                        };
+
+                        if (s->description) {
+                                n->description = strdup(s->description);
+                                if (!n->description)
+                                        return;
+                        }
+
+                        if (set_ensure_put(&e->source_statistics, &event_source_statistics_hash_ops, n) < 0)
+                                return;
+
+                        st = TAKE_PTR(n);
+                }
+
+                /* A disconnected event source won't be dispatched again, don't keep a reference then */
+                if (s->event)
+                        s->statistics = st;
+        }
+
+        st->n_dispatched++;
+        st->total_usec = usec_add(st->total_usec, t);
+        st->max_usec = MAX(st->max_usec, t);
+        st->histogram[u64log2(t)]++;
+}
+
 static int source_dispatch(sd_event_source *s) {
         _cleanup_(sd_event_unrefp) sd_event *saved_event = NULL;
         EventSourceType saved_type;
+        usec_t profile_begin = 0;
         int r = 0;
 
         assert(s);
@@ -3496,6 +3830,9 @@ static int source_dispatch(sd_event_source *s) {
                         return r;
         }
 
+        if (s->event->profile_sources)
+                profile_begin = now(CLOCK_MONOTONIC);
+
         s->dispatching = true;
 
         switch (s->type) {
@@ -3566,6 +3903,10 @@ static int source_dispatch(sd_event_source *s) {
                 break;
         }
 
+        case SOURCE_WORK:
+                r = s->work.callback(s, s->work.work.result, s->userdata);
+                break;
+
         case SOURCE_WATCHDOG:
         case _SOURCE_EVENT_SOURCE_TYPE_MAX:
         case _SOURCE_EVENT_SOURCE_TYPE_INVALID:
@@ -3574,6 +3915,9 @@ static int source_dispatch(sd_event_source *s) {
 
         s->dispatching = false;
 
+        if (profile_begin > 0 && saved_event->profile_sources)
+                event_source_account(saved_event, s, saved_type, usec_sub_unsigned(now(CLOCK_MONOTONIC), profile_begin));
+
         if (r < 0) {
                 log_debug_errno(r, "Event source %s (type %s) returned error, %s: %m",
                                 strna(s->description),
@@ -3783,6 +4127,12 @@ _public_ int sd_event_prepare(sd_event *e) {
         if (event_next_pending(e) || e->need_process_child)
                 goto pending;
 
+        if (e->uring_fd_exported) {
+                r = event_uring_submit(e->uring);
+                if (r < 0)
+                        return r;
+        }
+
         e->state = SD_EVENT_ARMED;
 
         return 0;
@@ -3872,11 +4222,18 @@ static int process_epoll(sd_event *e, usec_t timeout, int64_t threshold, int64_t
                 timeout = 0;
 
         for (;;) {
-                r = epoll_wait_usec(
-                                e->epoll_fd,
-                                e->event_queue,
-                                n_event_max,
-                                timeout);
+                if (e->uring)
+                        r = event_uring_wait(
+                                        e->uring,
+                                        e->event_queue,
+                                        n_event_max,
+                                        timeout);
+                else
+                        r = epoll_wait_usec(
+                                        e->epoll_fd,
+                                        e->event_queue,
+                                        n_event_max,
+                                        timeout);
                 if (r < 0)
                         return r;
 
@@ -3903,6 +4260,8 @@ static int process_epoll(sd_event *e, usec_t timeout, int64_t threshold, int64_t
 
                 if (e->event_queue[i].data.ptr == INT_TO_PTR(SOURCE_WATCHDOG))
                         r = flush_timer(e, e->watchdog_fd, e->event_queue[i].events, NULL);
+                else if (e->event_queue[i].data.ptr == INT_TO_PTR(SOURCE_WORK))
+                        r = process_work(e, e->event_queue[i].events);
                 else {
                         WakeupType *t = e->event_queue[i].data.ptr;
 
@@ -4098,6 +4457,125 @@ static void event_log_delays(sd_event *e) {
         log_debug("Event loop iterations: %s", b);
 }
 
+int event_set_profile_sources(sd_event *e, bool b) {
+        sd_event_source *s;
+
+        assert(e);
+
+        e = event_resolve(e);
+        if (!e)
+                return -ENOPKG;
+
+        if (e->profile_sources == b)
+                return 0;
+
+        e->profile_sources = b;
+
+        if (!b) {
+                /* Turning profiling off drops everything collected so far, so that it starts afresh when
+                 * turned on again. */
+                LIST_FOREACH(sources, s, e->sources)
+                        s->statistics = NULL;
+
+                e->source_statistics = set_free(e->source_statistics);
+        }
+
+        log_debug("Event source profiling %s.", b ? "enabled" : "disabled");
+        return 1;
+}
+
+int event_get_profile_sources(sd_event *e) {
+        assert(e);
+
+        e = event_resolve(e);
+        if (!e)
+                return -ENOPKG;
+
+        return e->profile_sources;
+}
+
+static int event_source_statistics_compare_by_time(const EventSourceStatistics *x, const EventSourceStatistics *y) {
+        int r;
+
+        /* Hot event sources first */
+        r = CMP(y->total_usec, x->total_usec);
+        if (r != 0)
+                return r;
+
+        return event_source_statistics_compare_func(x, y);
+}
+
+int event_get_source_statistics(sd_event *e, EventSourceStatistics **ret, size_t *ret_n) {
+        EventSourceStatistics *array, *st;
+        size_t n = 0;
+
+        assert(e);
+        assert(ret);
+        assert(ret_n);
+
+        e = event_resolve(e);
+        if (!e)
+                return -ENOPKG;
+
+        /* Returns a copy of the dispatch statistics of all event sources, ordered by the time spent in them,
+         * in descending order. */
+
+        array = new(EventSourceStatistics, MAX(set_size(e->source_statistics), 1U));
+        if (!array)
+                return -ENOMEM;
+
+        SET_FOREACH(st, e->source_statistics) {
+                array[n] = *st;
+
+                if (st->description) {
+                        array[n].description = strdup(st->description);
+                        if (!array[n].description) {
+                                event_source_statistics_free_many(array, n);
+                                return -ENOMEM;
+                        }
+                }
+
+                n++;
+        }
+
+        typesafe_qsort(array, n, event_source_statistics_compare_by_time);
+
+        *ret = array;
+        *ret_n = n;
+        return 0;
+}
+
+int event_dump_source_statistics(sd_event *e, FILE *f, const char *prefix) {
+        EventSourceStatistics *array = NULL;
+        size_t n = 0;
+        int r;
+
+        assert(e);
+        assert(f);
+
+        r = event_get_profile_sources(e);
+        if (r <= 0)
+                return r;
+
+        r = event_get_source_statistics(e, &array, &n);
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; i < n; i++)
+                fprintf(f,
+                        "%sEvent Source: %s (%s)\n"
+                        "%s\tDispatched: %" PRIu64 "\n"
+                        "%s\tTotal Time: %s\n"
+                        "%s\tMaximum Time: %s\n",
+                        strempty(prefix), strna(array[i].description), array[i].type,
+                        strempty(prefix), array[i].n_dispatched,
+                        strempty(prefix), FORMAT_TIMESPAN(array[i].total_usec, USEC_PER_MSEC),
+                        strempty(prefix), FORMAT_TIMESPAN(array[i].max_usec, 1));
+
+        event_source_statistics_free_many(array, n);
+        return 0;
+}
+
 _public_ int sd_event_run(sd_event *e, uint64_t timeout) {
         int r;
 
@@ -4170,6 +4648,13 @@ _public_ int sd_event_get_fd(sd_event *e) {
         assert_return(e = event_resolve(e), -ENOPKG);
         assert_return(!event_pid_changed(e), -ECHILD);
 
+        if (e->uring) {
+                /* The caller is going to poll the ring fd, hence changes need to be submitted before
+                 * that from now on, see sd_event_prepare() */
+                e->uring_fd_exported = true;
+                return event_uring_fd(e->uring);
+        }
+
         return e->epoll_fd;
 }
 
@@ -4296,19 +4781,13 @@ _public_ int sd_event_set_watchdog(sd_event *e, int b) {
                 if (r < 0)
                         goto fail;
 
-                struct epoll_event ev = {
-                        .events = EPOLLIN,
-                        .data.ptr = INT_TO_PTR(SOURCE_WATCHDOG),
-                };
-
-                if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, e->watchdog_fd, &ev) < 0) {
-                        r = -errno;
+                r = event_poll_ctl(e, EPOLL_CTL_ADD, e->watchdog_fd, EPOLLIN, INT_TO_PTR(SOURCE_WATCHDOG));
+                if (r < 0)
                         goto fail;
-                }
 
         } else {
                 if (e->watchdog_fd >= 0) {
-                        (void) epoll_ctl(e->epoll_fd, EPOLL_CTL_DEL, e->watchdog_fd, NULL);
+                        (void) event_poll_ctl(e, EPOLL_CTL_DEL, e->watchdog_fd, 0, NULL);
                         e->watchdog_fd = safe_close(e->watchdog_fd);
                 }
         }
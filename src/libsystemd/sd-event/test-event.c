@@ -5,8 +5,10 @@
 #include "sd-event.h"
 
 #include "alloc-util.h"
+#include "event-util.h"
 #include "exec-util.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "log.h"
 #include "macro.h"
@@ -347,6 +349,8 @@ static void test_rtqueue(void) {
 
         log_info("/* %s */", __func__);
 
+        n_rtqueue = last_rtqueue_sigval = 0;
+
         assert_se(sd_event_default(&e) >= 0);
 
         assert_se(sigprocmask_many(SIG_BLOCK, NULL, SIGRTMIN+2, SIGRTMIN+3, SIGUSR2, -1) >= 0);
@@ -713,6 +717,265 @@ static void test_simple_timeout(void) {
         assert_se(t >= usec_add(f, some_time));
 }
 
+#define N_MOVING_TIMERS 512U
+
+struct moving_timer {
+        usec_t expected;
+        unsigned *n_remaining;
+        bool fired;
+};
+
+static int moving_timer_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        struct moving_timer *t = userdata;
+
+        /* Timers must fire at the time they were last moved to, never earlier, and only once */
+        assert_se(!t->fired);
+        assert_se(usec == t->expected);
+        assert_se(now(CLOCK_MONOTONIC) >= usec);
+
+        t->fired = true;
+
+        assert_se(*t->n_remaining > 0);
+        if (--*t->n_remaining == 0)
+                assert_se(sd_event_exit(sd_event_source_get_event(s), 0) >= 0);
+
+        return 0;
+}
+
+static void test_moving_timers(void) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source *sources[N_MOVING_TIMERS];
+        struct moving_timer timers[N_MOVING_TIMERS] = {};
+        unsigned n_remaining = N_MOVING_TIMERS;
+        usec_t base;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        base = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < N_MOVING_TIMERS; i++) {
+                timers[i] = (struct moving_timer) {
+                        .expected = base + random_u64_range(50 * USEC_PER_MSEC),
+                        .n_remaining = &n_remaining,
+                };
+
+                assert_se(sd_event_add_time(e, &sources[i], CLOCK_MONOTONIC, timers[i].expected, 1,
+                                            moving_timer_handler, timers + i) >= 0);
+                assert_se(sd_event_source_set_enabled(sources[i], SD_EVENT_ONESHOT) >= 0);
+        }
+
+        /* Move the timers around, mostly into the future, as for idle timeouts that are reset over and over
+         * again, but sometimes also back, while the loop is already running. */
+        for (unsigned round = 0; round < 16; round++) {
+                for (unsigned i = 0; i < N_MOVING_TIMERS; i++) {
+                        if (timers[i].fired)
+                                continue;
+
+                        if (random_u64_range(8) == 0)
+                                timers[i].expected = base + random_u64_range(50 * USEC_PER_MSEC);
+                        else
+                                timers[i].expected += random_u64_range(10 * USEC_PER_MSEC);
+
+                        assert_se(sd_event_source_set_time(sources[i], timers[i].expected) >= 0);
+
+                        /* Changing the accuracy alone must not break anything either */
+                        if (random_u64_range(4) == 0)
+                                assert_se(sd_event_source_set_time_accuracy(sources[i], random_u64_range(2) + 1) >= 0);
+                }
+
+                assert_se(sd_event_run(e, 0) >= 0);
+        }
+
+        /* Finally, push half of them far away, these must not fire */
+        for (unsigned i = 0; i < N_MOVING_TIMERS; i++) {
+                if (timers[i].fired)
+                        continue;
+
+                if (i % 2 == 0) {
+                        timers[i].expected = base + USEC_PER_HOUR;
+                        assert_se(sd_event_source_set_time(sources[i], timers[i].expected) >= 0);
+                        n_remaining--;
+                }
+        }
+
+        if (n_remaining > 0)
+                assert_se(sd_event_loop(e) >= 0);
+
+        assert_se(n_remaining == 0);
+        for (unsigned i = 0; i < N_MOVING_TIMERS; i++) {
+                if (timers[i].expected == base + USEC_PER_HOUR)
+                        assert_se(!timers[i].fired);
+
+                sd_event_source_unref(sources[i]);
+        }
+}
+
+static int profile_defer_handler(sd_event_source *s, void *userdata) {
+        unsigned *n = userdata;
+
+        (*n)++;
+
+        /* Re-enable, so that both event sources get their turn */
+        return sd_event_source_set_enabled(s, SD_EVENT_ONESHOT);
+}
+
+static void test_profile_sources(void) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *a = NULL, *b = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        EventSourceStatistics *array = NULL;
+        _cleanup_free_ char *dump = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        unsigned n_a = 0, n_b = 0;
+        size_t n, size;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(sd_event_add_defer(e, &a, profile_defer_handler, &n_a) >= 0);
+        assert_se(sd_event_source_set_description(a, "test-profile") >= 0);
+
+        /* No description for this one */
+        assert_se(sd_event_add_defer(e, &b, profile_defer_handler, &n_b) >= 0);
+
+        assert_se(event_get_source_statistics(e, &array, &n) >= 0);
+        assert_se(n == 0);
+        event_source_statistics_free_many(array, n);
+
+        assert_se(event_set_profile_sources(e, true) > 0);
+        assert_se(event_get_profile_sources(e) > 0);
+        for (unsigned i = 0; i < 20; i++)
+                assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n_a == 10 && n_b == 10);
+
+        assert_se(event_get_source_statistics(e, &array, &n) >= 0);
+        assert_se(n == 2);
+        for (size_t i = 0; i < n; i++) {
+                unsigned total = 0;
+
+                assert_se(streq(array[i].type, "defer"));
+                assert_se(streq_ptr(array[i].description, "test-profile") || !array[i].description);
+                assert_se(array[i].n_dispatched == (array[i].description ? n_a : n_b));
+                assert_se(array[i].max_usec <= array[i].total_usec);
+
+                for (size_t j = 0; j < ELEMENTSOF(array[i].histogram); j++)
+                        total += array[i].histogram[j];
+                assert_se(total == array[i].n_dispatched);
+        }
+        assert_se(array[0].total_usec >= array[1].total_usec);
+        event_source_statistics_free_many(array, n);
+
+        assert_se(f = open_memstream_unlocked(&dump, &size));
+        assert_se(event_dump_source_statistics(e, f, "\t") >= 0);
+        assert_se(fflush_and_check(f) >= 0);
+        assert_se(strstr(dump, "\tEvent Source: test-profile (defer)\n"));
+        assert_se(strstr(dump, "\tEvent Source: n/a (defer)\n"));
+
+        /* Turning profiling off drops the statistics */
+        assert_se(event_set_profile_sources(e, false) > 0);
+        assert_se(event_get_source_statistics(e, &array, &n) >= 0);
+        assert_se(n == 0);
+        event_source_statistics_free_many(array, n);
+}
+
+#define N_WORK 64U
+
+struct work_state {
+        unsigned index;
+        unsigned *n_remaining;
+        bool done;
+};
+
+static int work_handler(void *userdata) {
+        struct work_state *w = userdata;
+
+        /* Block a bit, as the callbacks this is intended for do */
+        usleep(random_u64_range(2 * USEC_PER_MSEC));
+
+        return (int) w->index;
+}
+
+static int work_done_handler(sd_event_source *s, int result, void *userdata) {
+        struct work_state *w = userdata;
+
+        assert_se(!w->done);
+        assert_se(result == (int) w->index);
+
+        w->done = true;
+
+        assert_se(*w->n_remaining > 0);
+        if (--*w->n_remaining == 0)
+                assert_se(sd_event_exit(sd_event_source_get_event(s), 0) >= 0);
+
+        return 0;
+}
+
+static int work_slow_handler(void *userdata) {
+        usleep(200 * USEC_PER_MSEC);
+        return -EBADMSG;
+}
+
+static int work_slow_done_handler(sd_event_source *s, int result, void *userdata) {
+        bool *timer_fired = userdata;
+
+        /* The event loop kept running while the work was executed */
+        assert_se(*timer_fired);
+        assert_se(result == -EBADMSG);
+
+        return sd_event_exit(sd_event_source_get_event(s), 0);
+}
+
+static int work_timer_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        bool *timer_fired = userdata;
+
+        *timer_fired = true;
+        return 0;
+}
+
+static void test_work(void) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *slow = NULL, *timer = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source *sources[N_WORK];
+        struct work_state states[N_WORK];
+        unsigned n_remaining = N_WORK - 1;
+        bool timer_fired = false;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        for (unsigned i = 0; i < N_WORK; i++) {
+                states[i] = (struct work_state) {
+                        .index = i,
+                        .n_remaining = &n_remaining,
+                };
+
+                assert_se(sd_event_add_work(e, sources + i, work_handler, work_done_handler, states + i) >= 0);
+        }
+
+        /* Freeing a work event source cancels queued work, and waits for running work */
+        sources[0] = sd_event_source_unref(sources[0]);
+
+        assert_se(sd_event_loop(e) >= 0);
+        assert_se(!states[0].done);
+
+        for (unsigned i = 1; i < N_WORK; i++) {
+                assert_se(states[i].done);
+                assert_se(sd_event_source_get_enabled(sources[i], NULL) == SD_EVENT_OFF);
+                sd_event_source_unref(sources[i]);
+        }
+
+        e = sd_event_unref(e);
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(sd_event_add_work(e, &slow, work_slow_handler, work_slow_done_handler, &timer_fired) >= 0);
+        assert_se(sd_event_add_time_relative(e, &timer, CLOCK_MONOTONIC, 10 * USEC_PER_MSEC, 1,
+                                             work_timer_handler, &timer_fired) >= 0);
+        assert_se(sd_event_loop(e) >= 0);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -731,5 +994,24 @@ int main(int argc, char *argv[]) {
 
         test_ratelimit();
 
+        test_moving_timers();
+
+        test_profile_sources();
+
+        test_work();
+
+        /* Once more with the io_uring backend, which silently falls back to epoll if unsupported */
+        log_info("/* io_uring */");
+        assert_se(setenv("SD_EVENT_IO_URING", "1", 1) >= 0);
+
+        test_simple_timeout();
+        test_basic(true);
+        test_basic(false);
+        test_rtqueue();
+        test_inotify(100);
+        test_pidfd();
+        test_ratelimit();
+        test_work();
+
         return 0;
 }
@@ -22,6 +22,9 @@ struct sd_hwdb {
         OrderedHashmap *properties;
         Iterator properties_iterator;
         bool properties_modified;
+
+        /* Results of earlier lookups: modalias → NULL-terminated array of the matching value entries */
+        Hashmap *lookup_cache;
 };
 
 /* on-disk trie objects */
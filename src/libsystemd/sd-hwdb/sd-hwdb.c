@@ -21,6 +21,10 @@
 #include "string-util.h"
 #include "time-util.h"
 
+/* The number of lookup results to keep. The same modaliases are looked up again and again, e.g. for each of
+ * the keys udev queries, and for identical devices. */
+#define HWDB_LOOKUP_CACHE_MAX 1024U
+
 struct linebuf {
         char bytes[LINE_MAX];
         size_t size;
@@ -178,6 +182,26 @@ static int hwdb_add_property(sd_hwdb *hwdb, const struct trie_value_entry_f *ent
         return 0;
 }
 
+static bool trie_fnmatch_prefix_f(struct linebuf *buf, const char *search) {
+        const char *pattern;
+        bool r;
+
+        /* Checks whether any pattern starting with the pattern in buf may match. If the pattern with a '*'
+         * appended doesn't match, then no longer pattern can. This doesn't hold if the pattern ends in the
+         * middle of a bracket expression or after an escaping backslash, hence don't bother checking patterns
+         * with those. This saves walking subtrees of the trie for glob patterns, whose leading parts already
+         * don't match. */
+
+        if (!linebuf_add_char(buf, '*'))
+                return true;
+
+        pattern = linebuf_get(buf);
+        r = !pattern || strpbrk(pattern, "[\\") || fnmatch(pattern, search, 0) == 0;
+
+        linebuf_rem_char(buf);
+        return r;
+}
+
 static int trie_fnmatch_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t p,
                           struct linebuf *buf, const char *search) {
         size_t len;
@@ -189,6 +213,11 @@ static int trie_fnmatch_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t
         len = strlen(prefix + p);
         linebuf_add(buf, prefix + p, len);
 
+        if (node->children_count > 0 && !trie_fnmatch_prefix_f(buf, search)) {
+                linebuf_rem(buf, len);
+                return 0;
+        }
+
         for (i = 0; i < node->children_count; i++) {
                 const struct trie_child_entry_f *child = trie_node_child(hwdb, node, i);
 
@@ -317,6 +346,9 @@ _public_ int sd_hwdb_new(sd_hwdb **ret) {
         if (hwdb->map == MAP_FAILED)
                 return log_debug_errno(errno, "Failed to map %s: %m", hwdb_bin_path);
 
+        /* Lookups only touch a few nodes spread all over the file, reading ahead doesn't help them. */
+        (void) madvise((void *) hwdb->map, hwdb->st.st_size, MADV_RANDOM);
+
         if (memcmp(hwdb->map, sig, sizeof(hwdb->head->signature)) != 0 ||
             (size_t) hwdb->st.st_size != le64toh(hwdb->head->file_size))
                 return log_debug_errno(SYNTHETIC_ERRNO(EINVAL),
@@ -342,19 +374,72 @@ static sd_hwdb *hwdb_free(sd_hwdb *hwdb) {
                 munmap((void *)hwdb->map, hwdb->st.st_size);
         safe_fclose(hwdb->f);
         ordered_hashmap_free(hwdb->properties);
+        hashmap_free(hwdb->lookup_cache);
         return mfree(hwdb);
 }
 
 DEFINE_PUBLIC_TRIVIAL_REF_UNREF_FUNC(sd_hwdb, sd_hwdb, hwdb_free)
 
+static void lookup_cache_add(sd_hwdb *hwdb, const char *modalias) {
+        _cleanup_free_ const struct trie_value_entry_f **entries = NULL;
+        const struct trie_value_entry_f *entry;
+        _cleanup_free_ char *key = NULL;
+        size_t n = 0;
+
+        assert(hwdb);
+        assert(modalias);
+
+        /* The cache is only an optimization, hence failures are ignored here. */
+
+        if (hashmap_size(hwdb->lookup_cache) >= HWDB_LOOKUP_CACHE_MAX)
+                hashmap_clear(hwdb->lookup_cache);
+
+        entries = new(const struct trie_value_entry_f*, ordered_hashmap_size(hwdb->properties) + 1);
+        if (!entries)
+                return;
+
+        ORDERED_HASHMAP_FOREACH(entry, hwdb->properties)
+                entries[n++] = entry;
+        entries[n] = NULL;
+
+        key = strdup(modalias);
+        if (!key)
+                return;
+
+        if (hashmap_ensure_put(&hwdb->lookup_cache, &string_hash_ops_free_free, key, entries) < 0)
+                return;
+
+        TAKE_PTR(key);
+        TAKE_PTR(entries);
+}
+
 static int properties_prepare(sd_hwdb *hwdb, const char *modalias) {
+        const struct trie_value_entry_f **cached;
+        int r;
+
         assert(hwdb);
         assert(modalias);
 
         ordered_hashmap_clear(hwdb->properties);
         hwdb->properties_modified = true;
 
-        return trie_search_f(hwdb, modalias);
+        cached = hashmap_get(hwdb->lookup_cache, modalias);
+        if (cached) {
+                for (; *cached; cached++) {
+                        r = hwdb_add_property(hwdb, *cached);
+                        if (r < 0)
+                                return r;
+                }
+
+                return 0;
+        }
+
+        r = trie_search_f(hwdb, modalias);
+        if (r < 0)
+                return r;
+
+        lookup_cache_add(hwdb, modalias);
+        return 0;
 }
 
 _public_ int sd_hwdb_get(sd_hwdb *hwdb, const char *modalias, const char *key, const char **_value) {
@@ -18,6 +18,7 @@
 #endif
 
 #if HAVE_ZSTD
+#include <zdict.h>
 #include <zstd.h>
 #include <zstd_errors.h>
 #endif
@@ -34,11 +35,24 @@
 #include "unaligned.h"
 #include "util.h"
 
+#if HAVE_ZSTD
+/* Upper limit for the number of threads compress_stream_zstd() uses */
+#define ZSTD_STREAM_WORKERS_MAX 16L
+#endif
+
 #if HAVE_LZ4
 DEFINE_TRIVIAL_CLEANUP_FUNC_FULL(LZ4F_compressionContext_t, LZ4F_freeCompressionContext, NULL);
 DEFINE_TRIVIAL_CLEANUP_FUNC_FULL(LZ4F_decompressionContext_t, LZ4F_freeDecompressionContext, NULL);
 #endif
 
+struct CompressDictionary {
+#if HAVE_ZSTD
+        ZSTD_CDict *cdict;
+        ZSTD_DDict *ddict;
+#endif
+        unsigned id;
+};
+
 #if HAVE_ZSTD
 DEFINE_TRIVIAL_CLEANUP_FUNC_FULL(ZSTD_CCtx*, ZSTD_freeCCtx, NULL);
 DEFINE_TRIVIAL_CLEANUP_FUNC_FULL(ZSTD_DCtx*, ZSTD_freeDCtx, NULL);
@@ -135,7 +149,91 @@ int compress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
-int compress_blob_zstd(
+int compress_dictionary_new(const void *data, size_t size, CompressDictionary **ret) {
+#if HAVE_ZSTD
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+
+        assert(data);
+        assert(size > 0);
+        assert(ret);
+
+        d = new0(CompressDictionary, 1);
+        if (!d)
+                return -ENOMEM;
+
+        /* Digesting the dictionary is expensive, hence do it once here rather than for every object */
+        d->cdict = ZSTD_createCDict(data, size, 0);
+        d->ddict = ZSTD_createDDict(data, size);
+        if (!d->cdict || !d->ddict)
+                return -ENOMEM;
+
+        d->id = ZSTD_getDictID_fromDDict(d->ddict);
+
+        *ret = TAKE_PTR(d);
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+CompressDictionary* compress_dictionary_free(CompressDictionary *d) {
+        if (!d)
+                return NULL;
+
+#if HAVE_ZSTD
+        ZSTD_freeCDict(d->cdict);
+        ZSTD_freeDDict(d->ddict);
+#endif
+
+        return mfree(d);
+}
+
+int compress_dictionary_train(
+                const void *samples,
+                const size_t *sample_sizes,
+                size_t n_samples,
+                size_t max_size,
+                void **ret,
+                size_t *ret_size) {
+#if HAVE_ZSTD
+        _cleanup_free_ void *buf = NULL;
+        size_t k;
+
+        assert(samples);
+        assert(sample_sizes);
+        assert(max_size > 0);
+        assert(ret);
+        assert(ret_size);
+
+        if (n_samples > UINT_MAX)
+                return -E2BIG;
+
+        buf = malloc(max_size);
+        if (!buf)
+                return -ENOMEM;
+
+        k = ZDICT_trainFromBuffer(buf, max_size, samples, sample_sizes, n_samples);
+        if (ZDICT_isError(k)) {
+                log_debug("Failed to train ZSTD dictionary: %s", ZDICT_getErrorName(k));
+                return -ENODATA; /* Most likely not enough (or too uniform) samples */
+        }
+
+        *ret = TAKE_PTR(buf);
+        *ret_size = k;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+unsigned compress_dictionary_id(const CompressDictionary *d) {
+        assert(d);
+
+        return d->id;
+}
+
+int compress_blob_zstd_full(
+                const CompressDictionary *dict,
                 const void *src, uint64_t src_size,
                 void *dst, size_t dst_alloc_size, size_t *dst_size) {
 #if HAVE_ZSTD
@@ -147,7 +245,16 @@ int compress_blob_zstd(
         assert(dst_alloc_size > 0);
         assert(dst_size);
 
-        k = ZSTD_compress(dst, dst_alloc_size, src, src_size, 0);
+        if (dict) {
+                _cleanup_(ZSTD_freeCCtxp) ZSTD_CCtx *cctx = NULL;
+
+                cctx = ZSTD_createCCtx();
+                if (!cctx)
+                        return -ENOMEM;
+
+                k = ZSTD_compress_usingCDict(cctx, dst, dst_alloc_size, src, src_size, dict->cdict);
+        } else
+                k = ZSTD_compress(dst, dst_alloc_size, src, src_size, 0);
         if (ZSTD_isError(k))
                 return zstd_ret_to_errno(k);
 
@@ -257,7 +364,8 @@ int decompress_blob_lz4(
 #endif
 }
 
-int decompress_blob_zstd(
+int decompress_blob_zstd_full(
+                const CompressDictionary *dict,
                 const void *src,
                 uint64_t src_size,
                 void **dst,
@@ -288,6 +396,13 @@ int decompress_blob_zstd(
         if (!dctx)
                 return -ENOMEM;
 
+        /* Frames compressed without dictionary must be decompressed without one, too */
+        if (dict && ZSTD_getDictID_fromFrame(src, src_size) == dict->id) {
+                size_t z = ZSTD_DCtx_refDDict(dctx, dict->ddict);
+                if (ZSTD_isError(z))
+                        return zstd_ret_to_errno(z);
+        }
+
         ZSTD_inBuffer input = {
                 .src = src,
                 .size = src_size,
@@ -311,8 +426,9 @@ int decompress_blob_zstd(
 #endif
 }
 
-int decompress_blob(
+int decompress_blob_full(
                 int compression,
+                const CompressDictionary *dict,
                 const void *src,
                 uint64_t src_size,
                 void **dst,
@@ -328,7 +444,8 @@ int decompress_blob(
                                 src, src_size,
                                 dst, dst_size, dst_max);
         else if (compression == OBJECT_COMPRESSED_ZSTD)
-                return decompress_blob_zstd(
+                return decompress_blob_zstd_full(
+                                dict,
                                 src, src_size,
                                 dst, dst_size, dst_max);
         else
@@ -467,7 +584,8 @@ int decompress_startswith_lz4(
 #endif
 }
 
-int decompress_startswith_zstd(
+int decompress_startswith_zstd_full(
+                const CompressDictionary *dict,
                 const void *src,
                 uint64_t src_size,
                 void **buffer,
@@ -491,6 +609,13 @@ int decompress_startswith_zstd(
         if (!dctx)
                 return -ENOMEM;
 
+        /* Frames compressed without dictionary must be decompressed without one, too */
+        if (dict && ZSTD_getDictID_fromFrame(src, src_size) == dict->id) {
+                size_t z = ZSTD_DCtx_refDDict(dctx, dict->ddict);
+                if (ZSTD_isError(z))
+                        return zstd_ret_to_errno(z);
+        }
+
         if (!(greedy_realloc(buffer, MAX(ZSTD_DStreamOutSize(), prefix_len + 1), 1)))
                 return -ENOMEM;
 
@@ -518,8 +643,9 @@ int decompress_startswith_zstd(
 #endif
 }
 
-int decompress_startswith(
+int decompress_startswith_full(
                 int compression,
+                const CompressDictionary *dict,
                 const void *src,
                 uint64_t src_size,
                 void **buffer,
@@ -541,7 +667,8 @@ int decompress_startswith(
                                 prefix, prefix_len,
                                 extra);
         else if (compression == OBJECT_COMPRESSED_ZSTD)
-                return decompress_startswith_zstd(
+                return decompress_startswith_zstd_full(
+                                dict,
                                 src, src_size,
                                 buffer,
                                 prefix, prefix_len,
@@ -858,6 +985,7 @@ int compress_stream_zstd(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_unc
         size_t in_allocsize, out_allocsize;
         size_t z;
         uint64_t left = max_bytes, in_bytes = 0;
+        long cpus;
 
         assert(fdf >= 0);
         assert(fdt >= 0);
@@ -875,6 +1003,15 @@ int compress_stream_zstd(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_unc
         if (ZSTD_isError(z))
                 log_debug("Failed to enable ZSTD checksum, ignoring: %s", ZSTD_getErrorName(z));
 
+        /* Streams are usually large (e.g. core dumps), hence compress them on all CPUs. This only works if
+         * libzstd was built with multithreading support, otherwise we stay single-threaded. */
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus > 1) {
+                z = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, (int) MIN(cpus, ZSTD_STREAM_WORKERS_MAX));
+                if (ZSTD_isError(z))
+                        log_debug("Failed to enable ZSTD multithreading, ignoring: %s", ZSTD_getErrorName(z));
+        }
+
         /* This loop read from the input file, compresses that entire chunk,
          * and writes all output produced to the output file.
          */
@@ -4,22 +4,41 @@
 #include <unistd.h>
 
 #include "journal-def.h"
+#include "macro.h"
 
 const char* object_compressed_to_string(int compression);
 int object_compressed_from_string(const char *compression);
 
+/* A trained dictionary, prepared for use by both the compressor and the decompressor. Only supported for ZSTD. */
+typedef struct CompressDictionary CompressDictionary;
+
+int compress_dictionary_new(const void *data, size_t size, CompressDictionary **ret);
+CompressDictionary* compress_dictionary_free(CompressDictionary *d);
+DEFINE_TRIVIAL_CLEANUP_FUNC(CompressDictionary*, compress_dictionary_free);
+
+int compress_dictionary_train(const void *samples, const size_t *sample_sizes, size_t n_samples,
+                              size_t max_size, void **ret, size_t *ret_size);
+unsigned compress_dictionary_id(const CompressDictionary *d);
+
 int compress_blob_xz(const void *src, uint64_t src_size,
                      void *dst, size_t dst_alloc_size, size_t *dst_size);
 int compress_blob_lz4(const void *src, uint64_t src_size,
                       void *dst, size_t dst_alloc_size, size_t *dst_size);
-int compress_blob_zstd(const void *src, uint64_t src_size,
-                       void *dst, size_t dst_alloc_size, size_t *dst_size);
+int compress_blob_zstd_full(const CompressDictionary *dict,
+                            const void *src, uint64_t src_size,
+                            void *dst, size_t dst_alloc_size, size_t *dst_size);
+static inline int compress_blob_zstd(const void *src, uint64_t src_size,
+                                     void *dst, size_t dst_alloc_size, size_t *dst_size) {
+        return compress_blob_zstd_full(NULL, src, src_size, dst, dst_alloc_size, dst_size);
+}
 
-static inline int compress_blob(const void *src, uint64_t src_size,
-                                void *dst, size_t dst_alloc_size, size_t *dst_size) {
+/* The dictionary is only used if the compression algorithm in use supports it, and ignored otherwise */
+static inline int compress_blob_full(const CompressDictionary *dict,
+                                     const void *src, uint64_t src_size,
+                                     void *dst, size_t dst_alloc_size, size_t *dst_size) {
         int r;
 #if HAVE_ZSTD
-        r = compress_blob_zstd(src, src_size, dst, dst_alloc_size, dst_size);
+        r = compress_blob_zstd_full(dict, src, src_size, dst, dst_alloc_size, dst_size);
         if (r == 0)
                 return OBJECT_COMPRESSED_ZSTD;
 #elif HAVE_LZ4
@@ -36,15 +55,31 @@ static inline int compress_blob(const void *src, uint64_t src_size,
         return r;
 }
 
+static inline int compress_blob(const void *src, uint64_t src_size,
+                                void *dst, size_t dst_alloc_size, size_t *dst_size) {
+        return compress_blob_full(NULL, src, src_size, dst, dst_alloc_size, dst_size);
+}
+
 int decompress_blob_xz(const void *src, uint64_t src_size,
                        void **dst, size_t* dst_size, size_t dst_max);
 int decompress_blob_lz4(const void *src, uint64_t src_size,
                         void **dst, size_t* dst_size, size_t dst_max);
-int decompress_blob_zstd(const void *src, uint64_t src_size,
-                        void **dst, size_t* dst_size, size_t dst_max);
-int decompress_blob(int compression,
-                    const void *src, uint64_t src_size,
-                    void **dst, size_t* dst_size, size_t dst_max);
+int decompress_blob_zstd_full(const CompressDictionary *dict,
+                              const void *src, uint64_t src_size,
+                              void **dst, size_t* dst_size, size_t dst_max);
+static inline int decompress_blob_zstd(const void *src, uint64_t src_size,
+                                       void **dst, size_t* dst_size, size_t dst_max) {
+        return decompress_blob_zstd_full(NULL, src, src_size, dst, dst_size, dst_max);
+}
+int decompress_blob_full(int compression,
+                         const CompressDictionary *dict,
+                         const void *src, uint64_t src_size,
+                         void **dst, size_t* dst_size, size_t dst_max);
+static inline int decompress_blob(int compression,
+                                  const void *src, uint64_t src_size,
+                                  void **dst, size_t* dst_size, size_t dst_max) {
+        return decompress_blob_full(compression, NULL, src, src_size, dst, dst_size, dst_max);
+}
 
 int decompress_startswith_xz(const void *src, uint64_t src_size,
                              void **buffer,
@@ -54,15 +89,30 @@ int decompress_startswith_lz4(const void *src, uint64_t src_size,
                               void **buffer,
                               const void *prefix, size_t prefix_len,
                               uint8_t extra);
-int decompress_startswith_zstd(const void *src, uint64_t src_size,
+int decompress_startswith_zstd_full(const CompressDictionary *dict,
+                                    const void *src, uint64_t src_size,
+                                    void **buffer,
+                                    const void *prefix, size_t prefix_len,
+                                    uint8_t extra);
+static inline int decompress_startswith_zstd(const void *src, uint64_t src_size,
+                                             void **buffer,
+                                             const void *prefix, size_t prefix_len,
+                                             uint8_t extra) {
+        return decompress_startswith_zstd_full(NULL, src, src_size, buffer, prefix, prefix_len, extra);
+}
+int decompress_startswith_full(int compression,
+                               const CompressDictionary *dict,
+                               const void *src, uint64_t src_size,
                                void **buffer,
                                const void *prefix, size_t prefix_len,
                                uint8_t extra);
-int decompress_startswith(int compression,
-                          const void *src, uint64_t src_size,
-                          void **buffer,
-                          const void *prefix, size_t prefix_len,
-                          uint8_t extra);
+static inline int decompress_startswith(int compression,
+                                        const void *src, uint64_t src_size,
+                                        void **buffer,
+                                        const void *prefix, size_t prefix_len,
+                                        uint8_t extra) {
+        return decompress_startswith_full(compression, NULL, src, src_size, buffer, prefix, prefix_len, extra);
+}
 
 int compress_stream_xz(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_uncompressed_size);
 int compress_stream_lz4(int fdf, int fdt, uint64_t max_bytes, uint64_t *ret_uncompressed_size);
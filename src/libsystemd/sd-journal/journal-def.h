@@ -23,9 +23,14 @@ typedef struct EntryObject EntryObject;
 typedef struct HashTableObject HashTableObject;
 typedef struct EntryArrayObject EntryArrayObject;
 typedef struct TagObject TagObject;
+typedef struct FieldIndexObject FieldIndexObject;
+typedef struct SeekIndexObject SeekIndexObject;
+typedef struct CompressionDictionaryObject CompressionDictionaryObject;
 
 typedef struct EntryItem EntryItem;
 typedef struct HashItem HashItem;
+typedef struct FieldIndexItem FieldIndexItem;
+typedef struct SeekIndexItem SeekIndexItem;
 
 typedef struct FSSHeader FSSHeader;
 
@@ -39,6 +44,9 @@ typedef enum ObjectType {
         OBJECT_FIELD_HASH_TABLE,
         OBJECT_ENTRY_ARRAY,
         OBJECT_TAG,
+        OBJECT_FIELD_INDEX,
+        OBJECT_SEEK_INDEX,
+        OBJECT_COMPRESSION_DICTIONARY,
         _OBJECT_TYPE_MAX
 } ObjectType;
 
@@ -130,6 +138,39 @@ struct TagObject {
         uint8_t tag[TAG_LENGTH]; /* SHA-256 HMAC */
 } _packed_;
 
+struct FieldIndexItem {
+        le64_t data_offset;
+        le32_t payload_offset; /* relative to the beginning of the object */
+        le32_t payload_size;
+} _packed_;
+
+struct FieldIndexObject {
+        ObjectHeader object;
+        le64_t field_offset;
+        le64_t next_field_index_offset;
+        le64_t n_items;
+        FieldIndexItem items[]; /* sorted by payload, followed by the payloads */
+} _packed_;
+
+struct SeekIndexItem {
+        le64_t entry_array_offset;
+        le64_t entry_array_index;
+        le64_t seqnum;
+        le64_t realtime;
+} _packed_;
+
+struct SeekIndexObject {
+        ObjectHeader object;
+        le64_t n_entries;
+        le64_t stride;
+        SeekIndexItem items[]; /* one for every 'stride'th entry of the main entry array */
+} _packed_;
+
+struct CompressionDictionaryObject {
+        ObjectHeader object;
+        uint8_t payload[]; /* a ZSTD dictionary */
+} _packed_;
+
 union Object {
         ObjectHeader object;
         DataObject data;
@@ -138,6 +179,9 @@ union Object {
         HashTableObject hash_table;
         EntryArrayObject entry_array;
         TagObject tag;
+        FieldIndexObject field_index;
+        SeekIndexObject seek_index;
+        CompressionDictionaryObject compression_dictionary;
 };
 
 enum {
@@ -153,41 +197,49 @@ enum {
         HEADER_INCOMPATIBLE_COMPRESSED_LZ4  = 1 << 1,
         HEADER_INCOMPATIBLE_KEYED_HASH      = 1 << 2,
         HEADER_INCOMPATIBLE_COMPRESSED_ZSTD = 1 << 3,
+        HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY = 1 << 4,
 };
 
 #define HEADER_INCOMPATIBLE_ANY               \
         (HEADER_INCOMPATIBLE_COMPRESSED_XZ |  \
          HEADER_INCOMPATIBLE_COMPRESSED_LZ4 | \
          HEADER_INCOMPATIBLE_KEYED_HASH |     \
-         HEADER_INCOMPATIBLE_COMPRESSED_ZSTD)
+         HEADER_INCOMPATIBLE_COMPRESSED_ZSTD | \
+         HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY)
 
 #if HAVE_XZ && HAVE_LZ4 && HAVE_ZSTD
 #  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_ANY
 #elif HAVE_XZ && HAVE_LZ4
 #  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_COMPRESSED_LZ4|HEADER_INCOMPATIBLE_KEYED_HASH)
 #elif HAVE_XZ && HAVE_ZSTD
-#  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_COMPRESSED_ZSTD|HEADER_INCOMPATIBLE_KEYED_HASH)
+#  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_COMPRESSED_ZSTD|HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY|HEADER_INCOMPATIBLE_KEYED_HASH)
 #elif HAVE_LZ4 && HAVE_ZSTD
-#  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_LZ4|HEADER_INCOMPATIBLE_COMPRESSED_ZSTD|HEADER_INCOMPATIBLE_KEYED_HASH)
+#  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_LZ4|HEADER_INCOMPATIBLE_COMPRESSED_ZSTD|HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY|HEADER_INCOMPATIBLE_KEYED_HASH)
 #elif HAVE_XZ
 #  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_KEYED_HASH)
 #elif HAVE_LZ4
 #  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_LZ4|HEADER_INCOMPATIBLE_KEYED_HASH)
 #elif HAVE_ZSTD
-#  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_ZSTD|HEADER_INCOMPATIBLE_KEYED_HASH)
+#  define HEADER_INCOMPATIBLE_SUPPORTED (HEADER_INCOMPATIBLE_COMPRESSED_ZSTD|HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY|HEADER_INCOMPATIBLE_KEYED_HASH)
 #else
 #  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_KEYED_HASH
 #endif
 
 enum {
-        HEADER_COMPATIBLE_SEALED = 1 << 0,
+        HEADER_COMPATIBLE_SEALED      = 1 << 0,
+        HEADER_COMPATIBLE_FIELD_INDEX = 1 << 1,
+        HEADER_COMPATIBLE_SEEK_INDEX  = 1 << 2,
 };
 
-#define HEADER_COMPATIBLE_ANY HEADER_COMPATIBLE_SEALED
+#define HEADER_COMPATIBLE_ANY                   \
+        (HEADER_COMPATIBLE_SEALED |             \
+         HEADER_COMPATIBLE_FIELD_INDEX |        \
+         HEADER_COMPATIBLE_SEEK_INDEX)
+
 #if HAVE_GCRYPT
-#  define HEADER_COMPATIBLE_SUPPORTED HEADER_COMPATIBLE_SEALED
+#  define HEADER_COMPATIBLE_SUPPORTED HEADER_COMPATIBLE_ANY
 #else
-#  define HEADER_COMPATIBLE_SUPPORTED 0
+#  define HEADER_COMPATIBLE_SUPPORTED (HEADER_COMPATIBLE_FIELD_INDEX|HEADER_COMPATIBLE_SEEK_INDEX)
 #endif
 
 #define HEADER_SIGNATURE                                                \
@@ -227,12 +279,16 @@ enum {
         /* Added in 246 */                              \
         le64_t data_hash_chain_depth;                   \
         le64_t field_hash_chain_depth;                  \
+        /* Added in 250 */                              \
+        le64_t field_index_offset;                      \
+        le64_t seek_index_offset;                       \
+        le64_t compression_dictionary_offset;           \
         }
 
 struct Header struct_Header__contents;
 struct Header__packed struct_Header__contents _packed_;
 assert_cc(sizeof(struct Header) == sizeof(struct Header__packed));
-assert_cc(sizeof(struct Header) == 256);
+assert_cc(sizeof(struct Header) == 280);
 
 #define FSS_HEADER_SIGNATURE                                            \
         ((const char[]) { 'K', 'S', 'H', 'H', 'R', 'H', 'L', 'P' })
@@ -26,6 +26,7 @@
 #include "lookup3.h"
 #include "memory-util.h"
 #include "path-util.h"
+#include "prioq.h"
 #include "random-util.h"
 #include "set.h"
 #include "sort-util.h"
@@ -85,6 +86,23 @@
 /* Longest hash chain to rotate after */
 #define HASH_CHAIN_DEPTH_MAX 100
 
+/* The maximum size of the payloads stored in a single field index object */
+#define FIELD_INDEX_SIZE_MAX (256U * 1024U)
+
+/* Write one seek index item for every this many entries */
+#define SEEK_INDEX_STRIDE 256U
+
+/* Refuse seek indexes with strides larger than this, so that the range we bisect stays small */
+#define SEEK_INDEX_STRIDE_MAX (64U * 1024U)
+
+/* The maximum size of a trained compression dictionary, and how much DATA payload we feed into the trainer at
+ * most. The trainer wants about a hundred times the dictionary size in samples. Larger objects don't make good
+ * samples, they compress well enough on their own. */
+#define COMPRESSION_DICTIONARY_SIZE_MAX (16U * 1024U)
+#define COMPRESSION_DICTIONARY_SAMPLES_MAX (2U * 1024U * 1024U)
+#define COMPRESSION_DICTIONARY_SAMPLE_SIZE_MAX (4U * 1024U)
+#define COMPRESSION_DICTIONARY_SAMPLES_MIN 256U
+
 #ifdef __clang__
 #  pragma GCC diagnostic ignored "-Waddress-of-packed-member"
 #endif
@@ -401,6 +419,8 @@ JournalFile* journal_file_close(JournalFile *f) {
         free(f->compress_buffer);
 #endif
 
+        compress_dictionary_free(f->compress_dictionary);
+
 #if HAVE_GCRYPT
         if (f->fss_file)
                 munmap(f->fss_file, PAGE_ALIGN(f->fss_file_size));
@@ -497,13 +517,17 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                   f->path, type, flags & ~any);
                 flags = (flags & any) & ~supported;
                 if (flags) {
-                        const char* strv[5];
+                        const char* strv[6];
                         unsigned n = 0;
                         _cleanup_free_ char *t = NULL;
 
                         if (compatible) {
                                 if (flags & HEADER_COMPATIBLE_SEALED)
                                         strv[n++] = "sealed";
+                                if (flags & HEADER_COMPATIBLE_FIELD_INDEX)
+                                        strv[n++] = "field-index";
+                                if (flags & HEADER_COMPATIBLE_SEEK_INDEX)
+                                        strv[n++] = "seek-index";
                         } else {
                                 if (flags & HEADER_INCOMPATIBLE_COMPRESSED_XZ)
                                         strv[n++] = "xz-compressed";
@@ -513,6 +537,8 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                         strv[n++] = "zstd-compressed";
                                 if (flags & HEADER_INCOMPATIBLE_KEYED_HASH)
                                         strv[n++] = "keyed-hash";
+                                if (flags & HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY)
+                                        strv[n++] = "compression-dictionary";
                         }
                         strv[n] = NULL;
                         assert(n < ELEMENTSOF(strv));
@@ -768,6 +794,9 @@ static uint64_t minimum_header_size(Object *o) {
                 [OBJECT_FIELD_HASH_TABLE] = sizeof(HashTableObject),
                 [OBJECT_ENTRY_ARRAY] = sizeof(EntryArrayObject),
                 [OBJECT_TAG] = sizeof(TagObject),
+                [OBJECT_FIELD_INDEX] = sizeof(FieldIndexObject),
+                [OBJECT_SEEK_INDEX] = sizeof(SeekIndexObject),
+                [OBJECT_COMPRESSION_DICTIONARY] = sizeof(CompressionDictionaryObject),
         };
 
         if (o->object.type >= ELEMENTSOF(table) || table[o->object.type] <= 0)
@@ -919,6 +948,63 @@ static int journal_file_check_object(JournalFile *f, uint64_t offset, Object *o)
                                                le64toh(o->tag.epoch), offset);
 
                 break;
+
+        case OBJECT_FIELD_INDEX: {
+                uint64_t sz, n;
+
+                sz = le64toh(READ_NOW(o->object.size));
+                n = le64toh(o->field_index.n_items);
+                if (sz < offsetof(FieldIndexObject, items) ||
+                    n > (sz - offsetof(FieldIndexObject, items)) / sizeof(FieldIndexItem))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid field index size: %" PRIu64 ": %" PRIu64,
+                                               sz,
+                                               offset);
+
+                if (!VALID64(le64toh(o->field_index.field_offset)) ||
+                    !VALID64(le64toh(o->field_index.next_field_index_offset)))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid offset, field_offset=" OFSfmt ", next_field_index_offset=" OFSfmt ": %" PRIu64,
+                                               le64toh(o->field_index.field_offset),
+                                               le64toh(o->field_index.next_field_index_offset),
+                                               offset);
+                break;
+        }
+
+        case OBJECT_SEEK_INDEX: {
+                uint64_t sz, stride;
+
+                sz = le64toh(READ_NOW(o->object.size));
+                if ((sz - offsetof(SeekIndexObject, items)) % sizeof(SeekIndexItem) != 0 ||
+                    (sz - offsetof(SeekIndexObject, items)) / sizeof(SeekIndexItem) <= 0)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid seek index size: %" PRIu64 ": %" PRIu64,
+                                               sz,
+                                               offset);
+
+                stride = le64toh(o->seek_index.stride);
+                if (stride <= 0 || stride > SEEK_INDEX_STRIDE_MAX)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid seek index stride: %" PRIu64 ": %" PRIu64,
+                                               stride,
+                                               offset);
+
+                if (DIV_ROUND_UP(le64toh(o->seek_index.n_entries), stride) !=
+                    (sz - offsetof(SeekIndexObject, items)) / sizeof(SeekIndexItem))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid number of seek index items for %" PRIu64 " entries: %" PRIu64,
+                                               le64toh(o->seek_index.n_entries),
+                                               offset);
+                break;
+        }
+
+        case OBJECT_COMPRESSION_DICTIONARY:
+                if (le64toh(READ_NOW(o->object.size)) <= offsetof(CompressionDictionaryObject, payload))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid compression dictionary size: %" PRIu64 ": %" PRIu64,
+                                               le64toh(o->object.size),
+                                               offset);
+                break;
         }
 
         return 0;
@@ -1113,7 +1199,23 @@ int journal_file_append_object(
         return 0;
 }
 
-static int journal_file_setup_data_hash_table(JournalFile *f) {
+static uint64_t hash_table_size_for_template(JournalFile *f, uint64_t n_items) {
+        uint64_t s;
+
+        assert(f);
+
+        /* Size a hash table so that the number of items observed in the file we are replacing stays below
+         * 75% fill level, but never let the table take more than a quarter of the maximum file size. */
+
+        s = n_items / 3 * 4 * sizeof(HashItem);
+
+        if (f->metrics.max_size != UINT64_MAX)
+                s = MIN(s, f->metrics.max_size / 4);
+
+        return s;
+}
+
+static int journal_file_setup_data_hash_table(JournalFile *f, JournalFile *template) {
         uint64_t s, p;
         Object *o;
         int r;
@@ -1130,6 +1232,11 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
         if (s < DEFAULT_DATA_HASH_TABLE_SIZE)
                 s = DEFAULT_DATA_HASH_TABLE_SIZE;
 
+        /* If we are replacing a file, we know how many distinct data objects the workload actually
+         * generates, which might be a lot more than the estimate above. */
+        if (template && JOURNAL_HEADER_CONTAINS(template->header, n_data))
+                s = MAX(s, hash_table_size_for_template(f, le64toh(template->header->n_data)));
+
         log_debug("Reserving %"PRIu64" entries in data hash table.", s / sizeof(HashItem));
 
         r = journal_file_append_object(f,
@@ -1147,7 +1254,7 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
         return 0;
 }
 
-static int journal_file_setup_field_hash_table(JournalFile *f) {
+static int journal_file_setup_field_hash_table(JournalFile *f, JournalFile *template) {
         uint64_t s, p;
         Object *o;
         int r;
@@ -1156,9 +1263,12 @@ static int journal_file_setup_field_hash_table(JournalFile *f) {
         assert(f->header);
 
         /* We use a fixed size hash table for the fields as this
-         * number should grow very slowly only */
+         * number should grow very slowly only, unless the file we
+         * replace showed that it doesn't. */
 
         s = DEFAULT_FIELD_HASH_TABLE_SIZE;
+        if (template && JOURNAL_HEADER_CONTAINS(template->header, n_fields))
+                s = MAX(s, hash_table_size_for_template(f, le64toh(template->header->n_fields)));
         log_debug("Reserving %"PRIu64" entries in field hash table.", s / sizeof(HashItem));
 
         r = journal_file_append_object(f,
@@ -1494,8 +1604,8 @@ int journal_file_find_data_object_with_hash(
 
                         l -= offsetof(Object, data.payload);
 
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
-                                            o->data.payload, l, &f->compress_buffer, &rsize, 0);
+                        r = decompress_blob_full(o->object.flags & OBJECT_COMPRESSION_MASK, f->compress_dictionary,
+                                                 o->data.payload, l, &f->compress_buffer, &rsize, 0);
                         if (r < 0)
                                 return r;
 
@@ -1696,7 +1806,7 @@ static int journal_file_append_data(
         if (JOURNAL_FILE_COMPRESS(f) && size >= f->compress_threshold_bytes) {
                 size_t rsize = 0;
 
-                compression = compress_blob(data, size, o->data.payload, size - 1, &rsize);
+                compression = compress_blob_full(f->compress_dictionary, data, size, o->data.payload, size - 1, &rsize);
 
                 if (compression >= 0) {
                         o->object.size = htole64(offsetof(Object, data.payload) + rsize);
@@ -1800,12 +1910,60 @@ uint64_t journal_file_hash_table_n_items(Object *o) {
         return (sz - offsetof(Object, hash_table.items)) / sizeof(HashItem);
 }
 
+typedef struct ChainCacheItem {
+        uint64_t first; /* the array at the beginning of the chain */
+        uint64_t array; /* the cached array */
+        uint64_t begin; /* the first item in the cached array */
+        uint64_t total; /* the total number of items in all arrays before this one in the chain */
+        uint64_t last_index; /* the last index we looked at, to optimize locality when bisecting */
+} ChainCacheItem;
+
+static void chain_cache_put(
+                OrderedHashmap *h,
+                ChainCacheItem *ci,
+                uint64_t first,
+                uint64_t array,
+                uint64_t begin,
+                uint64_t total,
+                uint64_t last_index) {
+
+        if (!ci) {
+                /* If the chain item to cache for this chain is the
+                 * first one it's not worth caching anything */
+                if (array == first)
+                        return;
+
+                if (ordered_hashmap_size(h) >= CHAIN_CACHE_MAX) {
+                        ci = ordered_hashmap_steal_first(h);
+                        assert(ci);
+                } else {
+                        ci = new(ChainCacheItem, 1);
+                        if (!ci)
+                                return;
+                }
+
+                ci->first = first;
+
+                if (ordered_hashmap_put(h, &ci->first, ci) < 0) {
+                        free(ci);
+                        return;
+                }
+        } else
+                assert(ci->first == first);
+
+        ci->array = array;
+        ci->begin = begin;
+        ci->total = total;
+        ci->last_index = last_index;
+}
+
 static int link_entry_into_array(JournalFile *f,
                                  le64_t *first,
                                  le64_t *idx,
                                  uint64_t p) {
         int r;
-        uint64_t n = 0, ap = 0, q, i, a, hidx;
+        uint64_t n = 0, ap = 0, q, i, a, hidx, t = 0;
+        ChainCacheItem *ci;
         Object *o;
 
         assert(f);
@@ -1816,6 +1974,16 @@ static int link_entry_into_array(JournalFile *f,
 
         a = le64toh(*first);
         i = hidx = le64toh(READ_NOW(*idx));
+
+        /* Long chains are appended to over and over again, hence skip ahead to the array we wrote to the
+         * last time, if we know it, instead of walking the whole chain on every append. */
+        ci = a > 0 ? ordered_hashmap_get(f->chain_cache, &a) : NULL;
+        if (ci && hidx >= ci->total) {
+                t = ci->total;
+                i -= ci->total;
+                a = ci->array;
+        }
+
         while (a > 0) {
 
                 r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &o);
@@ -1826,10 +1994,12 @@ static int link_entry_into_array(JournalFile *f,
                 if (i < n) {
                         o->entry_array.items[i] = htole64(p);
                         *idx = htole64(hidx + 1);
+                        chain_cache_put(f->chain_cache, ci, le64toh(*first), a, le64toh(o->entry_array.items[0]), t, UINT64_MAX);
                         return 0;
                 }
 
                 i -= n;
+                t += n;
                 ap = a;
                 a = le64toh(o->entry_array.next_entry_array_offset);
         }
@@ -1864,6 +2034,8 @@ static int link_entry_into_array(JournalFile *f,
                         return r;
 
                 o->entry_array.next_entry_array_offset = htole64(q);
+
+                chain_cache_put(f->chain_cache, ci, le64toh(*first), q, p, t, UINT64_MAX);
         }
 
         if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
@@ -2110,22 +2282,26 @@ static int entry_item_cmp(const EntryItem *a, const EntryItem *b) {
         return CMP(le64toh(a->object_offset), le64toh(b->object_offset));
 }
 
-int journal_file_append_entry(
+static int journal_file_append_entry_full(
                 JournalFile *f,
                 const dual_timestamp *ts,
                 const sd_id128_t *boot_id,
-                const struct iovec iovec[], unsigned n_iovec,
+                const struct iovec iovec[], size_t n_iovec,
+                const struct iovec previous_iovec[], const EntryItem previous_items[], const uint64_t previous_xor[], size_t n_previous,
+                EntryItem items[], uint64_t xor[],
                 uint64_t *seqnum,
                 Object **ret, uint64_t *ret_offset) {
 
-        EntryItem *items;
-        int r;
+        EntryItem *sorted;
         uint64_t xor_hash = 0;
         struct dual_timestamp _ts;
+        int r;
 
         assert(f);
         assert(f->header);
         assert(iovec || n_iovec == 0);
+        assert(items || n_iovec == 0);
+        assert(xor || n_iovec == 0);
 
         if (ts) {
                 if (!VALID_REALTIME(ts->realtime))
@@ -2147,13 +2323,22 @@ int journal_file_append_entry(
                 return r;
 #endif
 
-        /* alloca() can't take 0, hence let's allocate at least one */
-        items = newa(EntryItem, MAX(1u, n_iovec));
-
-        for (unsigned i = 0; i < n_iovec; i++) {
+        for (size_t i = 0; i < n_iovec; i++) {
                 uint64_t p;
                 Object *o;
 
+                /* Consecutive entries from the same client tend to share most of their fields, in the
+                 * same order. If this field is identical to the one at the same position of the previous
+                 * entry, we can skip hashing it and looking it up in the data hash table. */
+                if (i < n_previous &&
+                    iovec[i].iov_len == previous_iovec[i].iov_len &&
+                    memcmp_safe(iovec[i].iov_base, previous_iovec[i].iov_base, iovec[i].iov_len) == 0) {
+                        items[i] = previous_items[i];
+                        xor[i] = previous_xor[i];
+                        xor_hash ^= xor[i];
+                        continue;
+                }
+
                 r = journal_file_append_data(f, iovec[i].iov_base, iovec[i].iov_len, &o, &p);
                 if (r < 0)
                         return r;
@@ -2168,19 +2353,29 @@ int journal_file_append_entry(
                  * files things are easier, we can just take the value from the stored record directly. */
 
                 if (JOURNAL_HEADER_KEYED_HASH(f->header))
-                        xor_hash ^= jenkins_hash64(iovec[i].iov_base, iovec[i].iov_len);
+                        xor[i] = jenkins_hash64(iovec[i].iov_base, iovec[i].iov_len);
                 else
-                        xor_hash ^= le64toh(o->data.hash);
+                        xor[i] = le64toh(o->data.hash);
+
+                xor_hash ^= xor[i];
 
                 items[i].object_offset = htole64(p);
                 items[i].hash = o->data.hash;
         }
 
         /* Order by the position on disk, in order to improve seek
-         * times for rotating media. */
-        typesafe_qsort(items, n_iovec, entry_item_cmp);
+         * times for rotating media. Note that we sort a copy, so that the caller can still match up the
+         * items with the iovec. alloca() can't take 0, hence let's allocate at least one */
+        sorted = newa(EntryItem, MAX(1u, n_iovec));
+        memcpy_safe(sorted, items, n_iovec * sizeof(EntryItem));
+        typesafe_qsort(sorted, n_iovec, entry_item_cmp);
 
-        r = journal_file_append_entry_internal(f, ts, boot_id, xor_hash, items, n_iovec, seqnum, ret, ret_offset);
+        return journal_file_append_entry_internal(f, ts, boot_id, xor_hash, sorted, n_iovec, seqnum, ret, ret_offset);
+}
+
+static void journal_file_append_entry_finish(JournalFile *f, int *r) {
+        assert(f);
+        assert(r);
 
         /* If the memory mapping triggered a SIGBUS then we return an
          * IO error and ignore the error code passed down to us, since
@@ -2188,61 +2383,89 @@ int journal_file_append_entry(
          * mapping page */
 
         if (mmap_cache_got_sigbus(f->mmap, f->cache_fd))
-                r = -EIO;
+                *r = -EIO;
 
         if (f->post_change_timer)
                 schedule_post_change(f);
         else
                 journal_file_post_change(f);
+}
+
+int journal_file_append_entry(
+                JournalFile *f,
+                const dual_timestamp *ts,
+                const sd_id128_t *boot_id,
+                const struct iovec iovec[], unsigned n_iovec,
+                uint64_t *seqnum,
+                Object **ret, uint64_t *ret_offset) {
+
+        EntryItem *items;
+        uint64_t *xor;
+        int r;
+
+        assert(f);
+        assert(iovec || n_iovec == 0);
+
+        /* alloca() can't take 0, hence let's allocate at least one */
+        items = newa(EntryItem, MAX(1u, n_iovec));
+        xor = newa(uint64_t, MAX(1u, n_iovec));
+
+        r = journal_file_append_entry_full(f, ts, boot_id, iovec, n_iovec, NULL, NULL, NULL, 0, items, xor, seqnum, ret, ret_offset);
+        journal_file_append_entry_finish(f, &r);
 
         return r;
 }
 
-typedef struct ChainCacheItem {
-        uint64_t first; /* the array at the beginning of the chain */
-        uint64_t array; /* the cached array */
-        uint64_t begin; /* the first item in the cached array */
-        uint64_t total; /* the total number of items in all arrays before this one in the chain */
-        uint64_t last_index; /* the last index we looked at, to optimize locality when bisecting */
-} ChainCacheItem;
+int journal_file_append_entries(
+                JournalFile *f,
+                const JournalAppendEntry entries[], size_t n_entries,
+                uint64_t *seqnum,
+                size_t *ret_n_appended) {
 
-static void chain_cache_put(
-                OrderedHashmap *h,
-                ChainCacheItem *ci,
-                uint64_t first,
-                uint64_t array,
-                uint64_t begin,
-                uint64_t total,
-                uint64_t last_index) {
+        _cleanup_free_ EntryItem *items = NULL, *previous_items = NULL;
+        _cleanup_free_ uint64_t *xor = NULL, *previous_xor = NULL;
+        size_t n_previous = 0, k = 0;
+        int r = 0;
 
-        if (!ci) {
-                /* If the chain item to cache for this chain is the
-                 * first one it's not worth caching anything */
-                if (array == first)
-                        return;
+        assert(f);
+        assert(entries || n_entries == 0);
 
-                if (ordered_hashmap_size(h) >= CHAIN_CACHE_MAX) {
-                        ci = ordered_hashmap_steal_first(h);
-                        assert(ci);
-                } else {
-                        ci = new(ChainCacheItem, 1);
-                        if (!ci)
-                                return;
-                }
+        /* Appends a number of entries in one go. This is mostly equivalent to calling
+         * journal_file_append_entry() for each of them, but DATA objects shared with the preceding entry
+         * are not looked up again, and change notifications are only generated once for the whole batch.
+         * On failure returns the error of the first entry that couldn't be written, the entries before it
+         * have been written. */
 
-                ci->first = first;
+        for (; k < n_entries; k++) {
+                const JournalAppendEntry *e = entries + k;
 
-                if (ordered_hashmap_put(h, &ci->first, ci) < 0) {
-                        free(ci);
-                        return;
+                if (!GREEDY_REALLOC(items, MAX(1u, e->n_iovec)) ||
+                    !GREEDY_REALLOC(xor, MAX(1u, e->n_iovec))) {
+                        r = -ENOMEM;
+                        break;
                 }
-        } else
-                assert(ci->first == first);
 
-        ci->array = array;
-        ci->begin = begin;
-        ci->total = total;
-        ci->last_index = last_index;
+                r = journal_file_append_entry_full(
+                                f, &e->ts, NULL,
+                                e->iovec, e->n_iovec,
+                                k > 0 ? entries[k-1].iovec : NULL, previous_items, previous_xor, n_previous,
+                                items, xor,
+                                seqnum, NULL, NULL);
+                if (r < 0)
+                        break;
+
+                SWAP_TWO(items, previous_items);
+                SWAP_TWO(xor, previous_xor);
+                n_previous = e->n_iovec;
+        }
+
+        if (k > 0 || r < 0)
+                journal_file_append_entry_finish(f, &r);
+
+        if (ret_n_appended)
+                *ret_n_appended = k;
+
+        return r;
 }
 
 static int generic_array_get(
@@ -2664,83 +2887,263 @@ static int test_object_seqnum(JournalFile *f, uint64_t p, uint64_t needle) {
                 return TEST_RIGHT;
 }
 
-int journal_file_move_to_entry_by_seqnum(
-                JournalFile *f,
-                uint64_t seqnum,
-                direction_t direction,
-                Object **ret,
-                uint64_t *ret_offset) {
-        assert(f);
-        assert(f->header);
-
-        return generic_array_bisect(
-                        f,
-                        le64toh(f->header->entry_array_offset),
-                        le64toh(f->header->n_entries),
-                        seqnum,
-                        test_object_seqnum,
-                        direction,
-                        ret, ret_offset, NULL);
-}
-
-static int test_object_realtime(JournalFile *f, uint64_t p, uint64_t needle) {
+static int journal_file_find_seek_index(JournalFile *f, uint64_t *ret_offset) {
+        uint64_t p;
         Object *o;
-        uint64_t rt;
         int r;
 
         assert(f);
-        assert(p > 0);
+        assert(f->header);
+        assert(ret_offset);
 
-        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
+        /* Like the field index, the seek index is only complete once the file has been archived */
+        if (!JOURNAL_HEADER_SEEK_INDEX(f->header) ||
+            !JOURNAL_HEADER_CONTAINS(f->header, seek_index_offset) ||
+            f->header->state != STATE_ARCHIVED)
+                return 0;
+
+        p = le64toh(READ_NOW(f->header->seek_index_offset));
+        if (p <= 0)
+                return 0;
+
+        r = journal_file_move_to_object(f, OBJECT_SEEK_INDEX, p, &o);
         if (r < 0)
                 return r;
 
-        rt = le64toh(READ_NOW(o->entry.realtime));
-        if (rt == needle)
-                return TEST_FOUND;
-        else if (rt < needle)
-                return TEST_LEFT;
-        else
-                return TEST_RIGHT;
+        if (le64toh(o->seek_index.n_entries) != le64toh(f->header->n_entries))
+                return -EBADMSG;
+
+        *ret_offset = p;
+        return 1;
 }
 
-int journal_file_move_to_entry_by_realtime(
+static uint64_t seek_index_item_key(const SeekIndexItem *i, bool seqnum) {
+        return le64toh(seqnum ? i->seqnum : i->realtime);
+}
+
+static int seek_index_bisect(
                 JournalFile *f,
-                uint64_t realtime,
+                uint64_t offset,
+                uint64_t needle,
+                bool seqnum,
+                int (*test_object)(JournalFile *f, uint64_t p, uint64_t needle),
                 direction_t direction,
                 Object **ret,
                 uint64_t *ret_offset) {
-        assert(f);
-        assert(f->header);
-
-        return generic_array_bisect(
-                        f,
-                        le64toh(f->header->entry_array_offset),
-                        le64toh(f->header->n_entries),
-                        realtime,
-                        test_object_realtime,
-                        direction,
-                        ret, ret_offset, NULL);
-}
 
-static int test_object_monotonic(JournalFile *f, uint64_t p, uint64_t needle) {
-        Object *o;
-        uint64_t m;
+        _cleanup_free_ uint64_t *entries = NULL;
+        uint64_t n, n_items, stride, left, right, c, a, j, k, start, m, p;
+        Object *o, *array;
         int r;
 
         assert(f);
-        assert(p > 0);
+        assert(test_object);
 
-        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
+        r = journal_file_move_to_object(f, OBJECT_SEEK_INDEX, offset, &o);
         if (r < 0)
                 return r;
 
-        m = le64toh(READ_NOW(o->entry.monotonic));
-        if (m == needle)
-                return TEST_FOUND;
-        else if (m < needle)
-                return TEST_LEFT;
-        else
+        n = le64toh(o->seek_index.n_entries);
+        stride = le64toh(o->seek_index.stride);
+        n_items = (le64toh(o->object.size) - offsetof(Object, seek_index.items)) / sizeof(SeekIndexItem);
+
+        /* First, find the number of samples left of what we are looking for. For DIRECTION_DOWN that's all
+         * samples smaller than the needle, for DIRECTION_UP all samples smaller or equal to it. */
+        left = 0;
+        right = n_items;
+        while (left < right) {
+                uint64_t middle = left + (right - left) / 2, key;
+
+                key = seek_index_item_key(o->seek_index.items + middle, seqnum);
+                if (key < needle || (direction == DIRECTION_UP && key == needle))
+                        left = middle + 1;
+                else
+                        right = middle;
+        }
+        c = left;
+
+        if (c == 0 && direction == DIRECTION_UP)
+                return 0;
+
+        /* The entry we are looking for is now somewhere between the sample before and the one after the
+         * boundary. For DIRECTION_DOWN the former is known to be too early, for DIRECTION_UP the latter
+         * is known to be too late. */
+        start = c > 0 ? c - 1 : 0;
+        m = MIN(stride + 1, n - start * stride);
+
+        entries = new(uint64_t, m);
+        if (!entries)
+                return -ENOMEM;
+
+        a = le64toh(o->seek_index.items[start].entry_array_offset);
+        j = le64toh(o->seek_index.items[start].entry_array_index);
+        for (k = 0; k < m;) {
+                if (a <= 0)
+                        return -EBADMSG;
+
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &array);
+                if (r < 0)
+                        return r;
+
+                for (; j < journal_file_entry_array_n_items(array) && k < m; j++) {
+                        p = le64toh(array->entry_array.items[j]);
+                        if (p <= 0)
+                                return -EBADMSG;
+
+                        entries[k++] = p;
+                }
+
+                a = le64toh(array->entry_array.next_entry_array_offset);
+                j = 0;
+        }
+
+        if (direction == DIRECTION_DOWN) {
+                left = c > 0 ? 1 : 0;
+                right = m;
+                while (left < right) {
+                        uint64_t middle = left + (right - left) / 2;
+
+                        r = test_object(f, entries[middle], needle);
+                        if (r < 0)
+                                return r;
+
+                        if (r == TEST_LEFT)
+                                left = middle + 1;
+                        else
+                                right = middle;
+                }
+
+                if (left >= m)
+                        return 0;
+        } else {
+                left = 0;
+                right = m;
+                while (right - left > 1) {
+                        uint64_t middle = left + (right - left) / 2;
+
+                        r = test_object(f, entries[middle], needle);
+                        if (r < 0)
+                                return r;
+
+                        if (r == TEST_RIGHT)
+                                right = middle;
+                        else
+                                left = middle;
+                }
+        }
+
+        p = entries[left];
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
+        if (r < 0)
+                return r;
+
+        if (ret)
+                *ret = o;
+
+        if (ret_offset)
+                *ret_offset = p;
+
+        return 1;
+}
+
+static int seek_index_or_array_bisect(
+                JournalFile *f,
+                uint64_t needle,
+                bool seqnum,
+                int (*test_object)(JournalFile *f, uint64_t p, uint64_t needle),
+                direction_t direction,
+                Object **ret,
+                uint64_t *ret_offset) {
+
+        uint64_t offset;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        r = journal_file_find_seek_index(f, &offset);
+        if (r > 0) {
+                r = seek_index_bisect(f, offset, needle, seqnum, test_object, direction, ret, ret_offset);
+                if (r >= 0)
+                        return r;
+        }
+        if (r < 0)
+                log_debug_errno(r, "Failed to use seek index of %s, bisecting entry array instead: %m", f->path);
+
+        return generic_array_bisect(
+                        f,
+                        le64toh(f->header->entry_array_offset),
+                        le64toh(f->header->n_entries),
+                        needle,
+                        test_object,
+                        direction,
+                        ret, ret_offset, NULL);
+}
+
+int journal_file_move_to_entry_by_seqnum(
+                JournalFile *f,
+                uint64_t seqnum,
+                direction_t direction,
+                Object **ret,
+                uint64_t *ret_offset) {
+        assert(f);
+        assert(f->header);
+
+        return seek_index_or_array_bisect(f, seqnum, true, test_object_seqnum, direction, ret, ret_offset);
+}
+
+static int test_object_realtime(JournalFile *f, uint64_t p, uint64_t needle) {
+        Object *o;
+        uint64_t rt;
+        int r;
+
+        assert(f);
+        assert(p > 0);
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
+        if (r < 0)
+                return r;
+
+        rt = le64toh(READ_NOW(o->entry.realtime));
+        if (rt == needle)
+                return TEST_FOUND;
+        else if (rt < needle)
+                return TEST_LEFT;
+        else
+                return TEST_RIGHT;
+}
+
+int journal_file_move_to_entry_by_realtime(
+                JournalFile *f,
+                uint64_t realtime,
+                direction_t direction,
+                Object **ret,
+                uint64_t *ret_offset) {
+        assert(f);
+        assert(f->header);
+
+        return seek_index_or_array_bisect(f, realtime, false, test_object_realtime, direction, ret, ret_offset);
+}
+
+static int test_object_monotonic(JournalFile *f, uint64_t p, uint64_t needle) {
+        Object *o;
+        uint64_t m;
+        int r;
+
+        assert(f);
+        assert(p > 0);
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
+        if (r < 0)
+                return r;
+
+        m = le64toh(READ_NOW(o->entry.monotonic));
+        if (m == needle)
+                return TEST_FOUND;
+        else if (m < needle)
+                return TEST_LEFT;
+        else
                 return TEST_RIGHT;
 }
 
@@ -3272,6 +3675,20 @@ fail:
 /* Note: the lifetime of the compound literal is the immediately surrounding block. */
 #define FORMAT_TIMESTAMP_SAFE(t) (FORMAT_TIMESTAMP(t) ?: " --- ")
 
+static void print_hash_table_usage(const char *name, const HashItem *table, uint64_t m, uint64_t n) {
+        uint64_t used = 0;
+
+        assert(name);
+        assert(table);
+
+        for (uint64_t i = 0; i < m; i++)
+                if (table[i].head_hash_offset != 0)
+                        used++;
+
+        printf("%s hash table buckets used: %"PRIu64" (average chain length %.2f)\n",
+               name, used, used > 0 ? (double) n / (double) used : 0.0);
+}
+
 void journal_file_print_header(JournalFile *f) {
         char a[SD_ID128_STRING_MAX], b[SD_ID128_STRING_MAX], c[SD_ID128_STRING_MAX], d[SD_ID128_STRING_MAX];
         struct stat st;
@@ -3285,8 +3702,8 @@ void journal_file_print_header(JournalFile *f) {
                "Boot ID: %s\n"
                "Sequential number ID: %s\n"
                "State: %s\n"
-               "Compatible flags:%s%s\n"
-               "Incompatible flags:%s%s%s%s%s\n"
+               "Compatible flags:%s%s%s%s\n"
+               "Incompatible flags:%s%s%s%s%s%s\n"
                "Header size: %"PRIu64"\n"
                "Arena size: %"PRIu64"\n"
                "Data hash table size: %"PRIu64"\n"
@@ -3308,10 +3725,13 @@ void journal_file_print_header(JournalFile *f) {
                f->header->state == STATE_ONLINE ? "ONLINE" :
                f->header->state == STATE_ARCHIVED ? "ARCHIVED" : "UNKNOWN",
                JOURNAL_HEADER_SEALED(f->header) ? " SEALED" : "",
+               JOURNAL_HEADER_FIELD_INDEX(f->header) ? " FIELD-INDEX" : "",
+               JOURNAL_HEADER_SEEK_INDEX(f->header) ? " SEEK-INDEX" : "",
                (le32toh(f->header->compatible_flags) & ~HEADER_COMPATIBLE_ANY) ? " ???" : "",
                JOURNAL_HEADER_COMPRESSED_XZ(f->header) ? " COMPRESSED-XZ" : "",
                JOURNAL_HEADER_COMPRESSED_LZ4(f->header) ? " COMPRESSED-LZ4" : "",
                JOURNAL_HEADER_COMPRESSED_ZSTD(f->header) ? " COMPRESSED-ZSTD" : "",
+               JOURNAL_HEADER_COMPRESSION_DICTIONARY(f->header) ? " COMPRESSION-DICTIONARY" : "",
                JOURNAL_HEADER_KEYED_HASH(f->header) ? " KEYED-HASH" : "",
                (le32toh(f->header->incompatible_flags) & ~HEADER_INCOMPATIBLE_ANY) ? " ???" : "",
                le64toh(f->header->header_size),
@@ -3354,6 +3774,16 @@ void journal_file_print_header(JournalFile *f) {
                 printf("Deepest data hash chain: %" PRIu64"\n",
                        f->header->data_hash_chain_depth);
 
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_fields) && journal_file_map_field_hash_table(f) >= 0)
+                print_hash_table_usage("Field", f->field_hash_table,
+                                       le64toh(f->header->field_hash_table_size) / sizeof(HashItem),
+                                       le64toh(f->header->n_fields));
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_data) && journal_file_map_data_hash_table(f) >= 0)
+                print_hash_table_usage("Data", f->data_hash_table,
+                                       le64toh(f->header->data_hash_table_size) / sizeof(HashItem),
+                                       le64toh(f->header->n_data));
+
         if (fstat(f->fd, &st) >= 0)
                 printf("Disk usage: %s\n", FORMAT_BYTES((uint64_t) st.st_blocks * 512ULL));
 }
@@ -3393,6 +3823,37 @@ static int journal_file_warn_btrfs(JournalFile *f) {
         return 1;
 }
 
+static int journal_file_load_compression_dictionary(JournalFile *f) {
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        if (!JOURNAL_HEADER_COMPRESSION_DICTIONARY(f->header))
+                return 0;
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, compression_dictionary_offset))
+                return -EBADMSG;
+
+        p = le64toh(READ_NOW(f->header->compression_dictionary_offset));
+        if (p == 0)
+                return -EBADMSG;
+
+        r = journal_file_move_to_object(f, OBJECT_COMPRESSION_DICTIONARY, p, &o);
+        if (r < 0)
+                return r;
+
+        r = compress_dictionary_new(o->compression_dictionary.payload,
+                                    le64toh(o->object.size) - offsetof(Object, compression_dictionary.payload),
+                                    &f->compress_dictionary);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to load compression dictionary of %s: %m", f->path);
+
+        return 0;
+}
+
 int journal_file_open(
                 int fd,
                 const char *fname,
@@ -3431,6 +3892,7 @@ int journal_file_open(
 
                 .flags = flags,
                 .writable = (flags & O_ACCMODE) != O_RDONLY,
+                .location_prioq_idx = PRIOQ_IDX_NULL,
 
 #if HAVE_ZSTD
                 .compress_zstd = compress,
@@ -3603,6 +4065,12 @@ int journal_file_open(
         }
 #endif
 
+        if (!newly_created) {
+                r = journal_file_load_compression_dictionary(f);
+                if (r < 0)
+                        goto fail;
+        }
+
         if (f->writable) {
                 if (metrics) {
                         journal_default_metrics(metrics, f->fd);
@@ -3622,11 +4090,11 @@ int journal_file_open(
 #endif
 
         if (newly_created) {
-                r = journal_file_setup_field_hash_table(f);
+                r = journal_file_setup_field_hash_table(f, template);
                 if (r < 0)
                         goto fail;
 
-                r = journal_file_setup_data_hash_table(f);
+                r = journal_file_setup_data_hash_table(f, template);
                 if (r < 0)
                         goto fail;
 
@@ -3667,89 +4135,669 @@ fail:
         return r;
 }
 
-int journal_file_archive(JournalFile *f) {
-        _cleanup_free_ char *p = NULL;
-
-        assert(f);
-
-        if (!f->writable)
-                return -EINVAL;
-
-        /* Is this a journal file that was passed to us as fd? If so, we synthesized a path name for it, and we refuse
-         * rotation, since we don't know the actual path, and couldn't rename the file hence. */
-        if (path_startswith(f->path, "/proc/self/fd"))
-                return -EINVAL;
-
-        if (!endswith(f->path, ".journal"))
-                return -EINVAL;
-
-        if (asprintf(&p, "%.*s@" SD_ID128_FORMAT_STR "-%016"PRIx64"-%016"PRIx64".journal",
-                     (int) strlen(f->path) - 8, f->path,
-                     SD_ID128_FORMAT_VAL(f->header->seqnum_id),
-                     le64toh(f->header->head_entry_seqnum),
-                     le64toh(f->header->head_entry_realtime)) < 0)
-                return -ENOMEM;
-
-        /* Try to rename the file to the archived version. If the file already was deleted, we'll get ENOENT, let's
-         * ignore that case. */
-        if (rename(f->path, p) < 0 && errno != ENOENT)
-                return -errno;
+typedef struct FieldIndexBuildItem {
+        uint64_t data_offset;
+        void *payload;
+        size_t size;
+} FieldIndexBuildItem;
 
-        /* Sync the rename to disk */
-        (void) fsync_directory_of_file(f->fd);
+static int field_index_payload_compare(const void *a, size_t a_size, const void *b, size_t b_size) {
+        int r;
 
-        /* Set as archive so offlining commits w/state=STATE_ARCHIVED. Previously we would set old_file->header->state
-         * to STATE_ARCHIVED directly here, but journal_file_set_offline() short-circuits when state != STATE_ONLINE,
-         * which would result in the rotated journal never getting fsync() called before closing.  Now we simply queue
-         * the archive state by setting an archive bit, leaving the state as STATE_ONLINE so proper offlining
-         * occurs. */
-        f->archive = true;
+        r = memcmp(a, b, MIN(a_size, b_size));
+        if (r != 0)
+                return r;
 
-        /* Currently, btrfs is not very good with out write patterns and fragments heavily. Let's defrag our journal
-         * files when we archive them */
-        f->defrag_on_close = true;
+        return CMP(a_size, b_size);
+}
 
-        return 0;
+static int field_index_build_item_compare(const FieldIndexBuildItem *a, const FieldIndexBuildItem *b) {
+        return field_index_payload_compare(a->payload, a->size, b->payload, b->size);
 }
 
-JournalFile* journal_initiate_close(
-                JournalFile *f,
-                Set *deferred_closes) {
+static void field_index_build_items_free(FieldIndexBuildItem *items, size_t n) {
+        for (size_t i = 0; i < n; i++)
+                free(items[i].payload);
+        free(items);
+}
 
+static int journal_file_append_field_index_one(JournalFile *f, uint64_t field_offset, uint64_t *head) {
+        FieldIndexBuildItem *items = NULL;
+        size_t n_items = 0, payload_size = 0;
+        uint64_t p, q, sz, depth = 0;
+        Object *o;
         int r;
 
         assert(f);
+        assert(head);
 
-        if (deferred_closes) {
+        r = journal_file_move_to_object(f, OBJECT_FIELD, field_offset, &o);
+        if (r < 0)
+                return r;
 
-                r = set_put(deferred_closes, f);
-                if (r < 0)
-                        log_debug_errno(r, "Failed to add file to deferred close set, closing immediately.");
-                else {
-                        (void) journal_file_set_offline(f, false);
-                        return NULL;
+        /* Collect the payloads of all DATA objects of this field first. Note that we copy them, since the
+         * objects we look at might get unmapped when we move to the next one. */
+        for (p = le64toh(o->field.head_data_offset); p > 0; p = le64toh(o->data.next_field_offset)) {
+                const void *data;
+                size_t size;
+
+                if (++depth > le64toh(f->header->n_data)) {
+                        r = -EBADMSG;
+                        goto finish;
                 }
-        }
 
-        return journal_file_close(f);
-}
+                r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                if (r < 0)
+                        goto finish;
 
-int journal_file_rotate(
-                JournalFile **f,
-                bool compress,
-                uint64_t compress_threshold_bytes,
-                bool seal,
-                Set *deferred_closes) {
+                sz = le64toh(READ_NOW(o->object.size));
+                if (sz <= offsetof(Object, data.payload)) {
+                        r = -EBADMSG;
+                        goto finish;
+                }
 
-        JournalFile *new_file = NULL;
-        int r;
+                sz -= offsetof(Object, data.payload);
 
-        assert(f);
-        assert(*f);
+                if (o->object.flags & OBJECT_COMPRESSION_MASK) {
+#if HAVE_COMPRESSION
+                        size_t rsize = 0;
 
-        r = journal_file_archive(*f);
-        if (r < 0)
-                return r;
+                        r = decompress_blob_full(o->object.flags & OBJECT_COMPRESSION_MASK, f->compress_dictionary,
+                                                 o->data.payload, sz, &f->compress_buffer, &rsize, 0);
+                        if (r < 0)
+                                goto finish;
+
+                        data = f->compress_buffer;
+                        size = rsize;
+#else
+                        r = -EPROTONOSUPPORT;
+                        goto finish;
+#endif
+                } else {
+                        data = o->data.payload;
+                        size = sz;
+                }
+
+                /* Fields with lots of distinct values (think MESSAGE=) are not worth indexing, the index
+                 * would just duplicate a large part of the file. */
+                if (payload_size + size > FIELD_INDEX_SIZE_MAX) {
+                        r = 0;
+                        goto finish;
+                }
+
+                if (!GREEDY_REALLOC(items, n_items + 1)) {
+                        r = -ENOMEM;
+                        goto finish;
+                }
+
+                items[n_items].payload = memdup(data, size);
+                if (!items[n_items].payload) {
+                        r = -ENOMEM;
+                        goto finish;
+                }
+
+                items[n_items].data_offset = p;
+                items[n_items].size = size;
+                n_items++;
+
+                payload_size += size;
+        }
+
+        if (n_items == 0) {
+                r = 0;
+                goto finish;
+        }
+
+        typesafe_qsort(items, n_items, field_index_build_item_compare);
+
+        sz = offsetof(Object, field_index.items) + n_items * sizeof(FieldIndexItem);
+        r = journal_file_append_object(f, OBJECT_FIELD_INDEX, sz + payload_size, &o, &q);
+        if (r < 0)
+                goto finish;
+
+        o->field_index.field_offset = htole64(field_offset);
+        o->field_index.next_field_index_offset = htole64(*head);
+        o->field_index.n_items = htole64(n_items);
+
+        for (size_t i = 0; i < n_items; i++) {
+                o->field_index.items[i] = (FieldIndexItem) {
+                        .data_offset = htole64(items[i].data_offset),
+                        .payload_offset = htole32(sz),
+                        .payload_size = htole32(items[i].size),
+                };
+
+                memcpy((uint8_t*) o + sz, items[i].payload, items[i].size);
+                sz += items[i].size;
+        }
+
+#if HAVE_GCRYPT
+        r = journal_file_hmac_put_object(f, OBJECT_FIELD_INDEX, o, q);
+        if (r < 0)
+                goto finish;
+#endif
+
+        *head = q;
+        r = 1;
+
+finish:
+        field_index_build_items_free(items, n_items);
+        return r;
+}
+
+static int journal_file_append_field_index(JournalFile *f) {
+        _cleanup_free_ uint64_t *fields = NULL;
+        size_t n_fields = 0;
+        uint64_t m, head = 0;
+        int r = 0;
+
+        assert(f);
+        assert(f->writable);
+
+        /* Writes a FIELD_INDEX object for each field with a limited set of values, so that readers can
+         * enumerate the values of a field without touching every DATA object in the file. Only done when
+         * archiving, since the file is not going to be modified anymore after that. */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, field_index_offset))
+                return 0;
+        if (le64toh(f->header->field_hash_table_size) <= 0)
+                return 0;
+
+        r = journal_file_map_field_hash_table(f);
+        if (r < 0)
+                return r;
+
+        m = le64toh(READ_NOW(f->header->field_hash_table_size)) / sizeof(HashItem);
+
+        for (uint64_t i = 0; i < m; i++) {
+                uint64_t p;
+
+                p = le64toh(f->field_hash_table[i].head_hash_offset);
+                while (p > 0) {
+                        Object *o;
+
+                        if (n_fields >= le64toh(f->header->n_fields))
+                                return -EBADMSG;
+
+                        r = journal_file_move_to_object(f, OBJECT_FIELD, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        if (!GREEDY_REALLOC(fields, n_fields + 1))
+                                return -ENOMEM;
+
+                        fields[n_fields++] = p;
+                        p = le64toh(o->field.next_hash_offset);
+                }
+        }
+
+        for (size_t i = 0; i < n_fields; i++) {
+                r = journal_file_append_field_index_one(f, fields[i], &head);
+                if (r < 0)
+                        break;
+        }
+
+        /* Link up whatever we managed to write, even if we failed half-way (for example because the file
+         * is full). Readers fall back to the DATA object chain for fields that have no index. */
+        if (head > 0) {
+                f->header->field_index_offset = htole64(head);
+                f->header->compatible_flags |= htole32(HEADER_COMPATIBLE_FIELD_INDEX);
+        }
+
+        return r < 0 ? r : head > 0;
+}
+
+int journal_file_find_field_index(JournalFile *f, uint64_t field_offset, uint64_t *ret_offset) {
+        uint64_t p;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* The index is only complete once the file has been archived, ignore it before that. */
+        if (!JOURNAL_HEADER_FIELD_INDEX(f->header) ||
+            !JOURNAL_HEADER_CONTAINS(f->header, field_index_offset) ||
+            f->header->state != STATE_ARCHIVED)
+                return 0;
+
+        p = le64toh(READ_NOW(f->header->field_index_offset));
+        while (p > 0) {
+                Object *o;
+                uint64_t next;
+
+                r = journal_file_move_to_object(f, OBJECT_FIELD_INDEX, p, &o);
+                if (r < 0)
+                        return r;
+
+                if (le64toh(o->field_index.field_offset) == field_offset) {
+                        if (ret_offset)
+                                *ret_offset = p;
+                        return 1;
+                }
+
+                /* The index objects are chained up backwards, refuse loops */
+                next = le64toh(o->field_index.next_field_index_offset);
+                if (next >= p)
+                        return -EBADMSG;
+
+                p = next;
+        }
+
+        return 0;
+}
+
+static int field_index_item_payload(Object *o, uint64_t i, const void **ret_data, size_t *ret_size) {
+        uint64_t sz, offset, size;
+
+        assert(o);
+        assert(o->object.type == OBJECT_FIELD_INDEX);
+
+        sz = le64toh(READ_NOW(o->object.size));
+        offset = le32toh(o->field_index.items[i].payload_offset);
+        size = le32toh(o->field_index.items[i].payload_size);
+
+        if (offset < offsetof(Object, field_index.items) + le64toh(o->field_index.n_items) * sizeof(FieldIndexItem) ||
+            offset + size > sz)
+                return -EBADMSG;
+
+        *ret_data = (const uint8_t*) o + offset;
+        *ret_size = size;
+        return 0;
+}
+
+int journal_file_field_index_get(
+                JournalFile *f,
+                uint64_t offset,
+                uint64_t i,
+                const void **ret_data,
+                size_t *ret_size) {
+
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(ret_data);
+        assert(ret_size);
+
+        /* We use OBJECT_UNUSED context here, so that the returned payload stays valid while other files'
+         * field indexes are searched. */
+        r = journal_file_move_to_object(f, OBJECT_UNUSED, offset, &o);
+        if (r < 0)
+                return r;
+
+        if (o->object.type != OBJECT_FIELD_INDEX)
+                return -EBADMSG;
+
+        if (i >= le64toh(o->field_index.n_items))
+                return 0;
+
+        r = field_index_item_payload(o, i, ret_data, ret_size);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+int journal_file_field_index_contains(JournalFile *f, uint64_t offset, const void *data, size_t size) {
+        uint64_t left, right;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(data || size == 0);
+
+        r = journal_file_move_to_object(f, OBJECT_FIELD_INDEX, offset, &o);
+        if (r < 0)
+                return r;
+
+        left = 0;
+        right = le64toh(o->field_index.n_items);
+
+        while (left < right) {
+                uint64_t middle = left + (right - left) / 2;
+                const void *d;
+                size_t l;
+
+                r = field_index_item_payload(o, middle, &d, &l);
+                if (r < 0)
+                        return r;
+
+                r = field_index_payload_compare(d, l, data, size);
+                if (r == 0)
+                        return 1;
+                if (r < 0)
+                        left = middle + 1;
+                else
+                        right = middle;
+        }
+
+        return 0;
+}
+
+static int journal_file_append_seek_index(JournalFile *f) {
+        _cleanup_free_ SeekIndexItem *items = NULL;
+        uint64_t n, n_items, a, i = 0, k = 0, q;
+        Object *o, *array;
+        int r;
+
+        assert(f);
+        assert(f->writable);
+
+        /* Writes a single SEEK_INDEX object sampling every SEEK_INDEX_STRIDE'th entry of the main entry array
+         * chain, so that readers seeking by realtime or seqnum only need to bisect this small and densely
+         * packed array, instead of the chain of entry arrays scattered all over the file. */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, seek_index_offset))
+                return 0;
+
+        /* For small files the entry array chain is short anyway */
+        n = le64toh(f->header->n_entries);
+        if (n <= SEEK_INDEX_STRIDE)
+                return 0;
+
+        n_items = DIV_ROUND_UP(n, SEEK_INDEX_STRIDE);
+        items = new(SeekIndexItem, n_items);
+        if (!items)
+                return -ENOMEM;
+
+        for (a = le64toh(f->header->entry_array_offset); a > 0 && i < n; a = le64toh(array->entry_array.next_entry_array_offset)) {
+                uint64_t m;
+
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &array);
+                if (r < 0)
+                        return r;
+
+                m = journal_file_entry_array_n_items(array);
+                for (uint64_t j = 0; j < m && i < n; j++, i++) {
+                        uint64_t p;
+
+                        if (i % SEEK_INDEX_STRIDE != 0)
+                                continue;
+
+                        p = le64toh(array->entry_array.items[j]);
+                        if (p <= 0)
+                                return -EBADMSG;
+
+                        r = journal_file_move_to_object(f, OBJECT_ENTRY, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        items[k++] = (SeekIndexItem) {
+                                .entry_array_offset = htole64(a),
+                                .entry_array_index = htole64(j),
+                                .seqnum = o->entry.seqnum,
+                                .realtime = o->entry.realtime,
+                        };
+                }
+        }
+
+        if (k != n_items)
+                return -EBADMSG;
+
+        r = journal_file_append_object(f, OBJECT_SEEK_INDEX,
+                                       offsetof(Object, seek_index.items) + n_items * sizeof(SeekIndexItem),
+                                       &o, &q);
+        if (r < 0)
+                return r;
+
+        o->seek_index.n_entries = htole64(n);
+        o->seek_index.stride = htole64(SEEK_INDEX_STRIDE);
+        memcpy(o->seek_index.items, items, n_items * sizeof(SeekIndexItem));
+
+#if HAVE_GCRYPT
+        r = journal_file_hmac_put_object(f, OBJECT_SEEK_INDEX, o, q);
+        if (r < 0)
+                return r;
+#endif
+
+        f->header->seek_index_offset = htole64(q);
+        f->header->compatible_flags |= htole32(HEADER_COMPATIBLE_SEEK_INDEX);
+
+        return 1;
+}
+
+void journal_file_append_indexes(JournalFile *f) {
+        int r;
+
+        assert(f);
+
+        /* The indexes are just an optimization for readers, don't fail if they can't be written */
+        r = journal_file_append_field_index(f);
+        if (r < 0)
+                log_debug_errno(r, "Failed to write field index to %s, ignoring: %m", f->path);
+
+        r = journal_file_append_seek_index(f);
+        if (r < 0)
+                log_debug_errno(r, "Failed to write seek index to %s, ignoring: %m", f->path);
+}
+
+int journal_file_archive(JournalFile *f) {
+        _cleanup_free_ char *p = NULL;
+
+        assert(f);
+
+        if (!f->writable)
+                return -EINVAL;
+
+        /* Is this a journal file that was passed to us as fd? If so, we synthesized a path name for it, and we refuse
+         * rotation, since we don't know the actual path, and couldn't rename the file hence. */
+        if (path_startswith(f->path, "/proc/self/fd"))
+                return -EINVAL;
+
+        if (!endswith(f->path, ".journal"))
+                return -EINVAL;
+
+        journal_file_append_indexes(f);
+
+        if (asprintf(&p, "%.*s@" SD_ID128_FORMAT_STR "-%016"PRIx64"-%016"PRIx64".journal",
+                     (int) strlen(f->path) - 8, f->path,
+                     SD_ID128_FORMAT_VAL(f->header->seqnum_id),
+                     le64toh(f->header->head_entry_seqnum),
+                     le64toh(f->header->head_entry_realtime)) < 0)
+                return -ENOMEM;
+
+        /* Try to rename the file to the archived version. If the file already was deleted, we'll get ENOENT, let's
+         * ignore that case. */
+        if (rename(f->path, p) < 0 && errno != ENOENT)
+                return -errno;
+
+        /* Sync the rename to disk */
+        (void) fsync_directory_of_file(f->fd);
+
+        /* Set as archive so offlining commits w/state=STATE_ARCHIVED. Previously we would set old_file->header->state
+         * to STATE_ARCHIVED directly here, but journal_file_set_offline() short-circuits when state != STATE_ONLINE,
+         * which would result in the rotated journal never getting fsync() called before closing.  Now we simply queue
+         * the archive state by setting an archive bit, leaving the state as STATE_ONLINE so proper offlining
+         * occurs. */
+        f->archive = true;
+
+        /* Currently, btrfs is not very good with out write patterns and fragments heavily. Let's defrag our journal
+         * files when we archive them */
+        f->defrag_on_close = true;
+
+        return 0;
+}
+
+JournalFile* journal_initiate_close(
+                JournalFile *f,
+                Set *deferred_closes) {
+
+        int r;
+
+        assert(f);
+
+        if (deferred_closes) {
+
+                r = set_put(deferred_closes, f);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to add file to deferred close set, closing immediately.");
+                else {
+                        (void) journal_file_set_offline(f, false);
+                        return NULL;
+                }
+        }
+
+        return journal_file_close(f);
+}
+
+int journal_file_set_compression_dictionary(JournalFile *f, const void *data, size_t size) {
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(data);
+        assert(size > 0);
+
+        /* Only ZSTD supports dictionaries, and all DATA objects need to be compressed with the same one, hence
+         * this may only be called on a file that has no DATA objects yet. */
+        if (!f->writable || !f->compress_zstd)
+                return -EOPNOTSUPP;
+        if (f->compress_dictionary || le64toh(f->header->n_data) > 0)
+                return -EBUSY;
+        if (!JOURNAL_HEADER_CONTAINS(f->header, compression_dictionary_offset))
+                return -EOPNOTSUPP;
+
+        r = compress_dictionary_new(data, size, &d);
+        if (r < 0)
+                return r;
+
+        r = journal_file_append_object(f, OBJECT_COMPRESSION_DICTIONARY,
+                                       offsetof(Object, compression_dictionary.payload) + size,
+                                       &o, &p);
+        if (r < 0)
+                return r;
+
+        memcpy(o->compression_dictionary.payload, data, size);
+
+#if HAVE_GCRYPT
+        r = journal_file_hmac_put_object(f, OBJECT_COMPRESSION_DICTIONARY, o, p);
+        if (r < 0)
+                return r;
+#endif
+
+        f->header->compression_dictionary_offset = htole64(p);
+        f->header->incompatible_flags |= htole32(HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY);
+
+        f->compress_dictionary = TAKE_PTR(d);
+        return 0;
+}
+
+int journal_file_train_compression_dictionary(JournalFile *f, void **ret, size_t *ret_size) {
+        _cleanup_free_ size_t *sample_sizes = NULL;
+        _cleanup_free_ uint8_t *samples = NULL;
+        size_t n_samples = 0, total = 0;
+        uint64_t n, i, depth = 0;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(ret);
+        assert(ret_size);
+
+        /* Feeds the DATA objects of this file into the dictionary trainer, so that the dictionary can be used
+         * for the file that succeeds this one. */
+
+        r = journal_file_map_data_hash_table(f);
+        if (r < 0)
+                return r;
+
+        n = le64toh(READ_NOW(f->header->data_hash_table_size)) / sizeof(HashItem);
+
+        for (i = 0; i < n && total < COMPRESSION_DICTIONARY_SAMPLES_MAX; i++) {
+                uint64_t p;
+
+                for (p = le64toh(f->data_hash_table[i].head_hash_offset); p > 0 && total < COMPRESSION_DICTIONARY_SAMPLES_MAX; ) {
+                        const void *data;
+                        size_t size;
+                        Object *o;
+
+                        if (++depth > le64toh(f->header->n_data))
+                                return -EBADMSG;
+
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        p = le64toh(o->data.next_hash_offset);
+
+                        size = le64toh(o->object.size) - offsetof(Object, data.payload);
+                        if (o->object.flags & OBJECT_COMPRESSION_MASK) {
+#if HAVE_COMPRESSION
+                                size_t rsize = 0;
+
+                                r = decompress_blob_full(o->object.flags & OBJECT_COMPRESSION_MASK, f->compress_dictionary,
+                                                         o->data.payload, size, &f->compress_buffer, &rsize,
+                                                         COMPRESSION_DICTIONARY_SAMPLE_SIZE_MAX + 1);
+                                if (r < 0)
+                                        return r;
+
+                                data = f->compress_buffer;
+                                size = rsize;
+#else
+                                return -EPROTONOSUPPORT;
+#endif
+                        } else
+                                data = o->data.payload;
+
+                        if (size <= 0 || size > COMPRESSION_DICTIONARY_SAMPLE_SIZE_MAX ||
+                            size > COMPRESSION_DICTIONARY_SAMPLES_MAX - total)
+                                continue;
+
+                        if (!GREEDY_REALLOC(samples, total + size) ||
+                            !GREEDY_REALLOC(sample_sizes, n_samples + 1))
+                                return -ENOMEM;
+
+                        memcpy(samples + total, data, size);
+                        sample_sizes[n_samples++] = size;
+                        total += size;
+                }
+        }
+
+        if (n_samples < COMPRESSION_DICTIONARY_SAMPLES_MIN)
+                return -ENODATA;
+
+        return compress_dictionary_train(samples, sample_sizes, n_samples, COMPRESSION_DICTIONARY_SIZE_MAX, ret, ret_size);
+}
+
+static int journal_file_inherit_compression_dictionary(JournalFile *f, JournalFile *template) {
+        _cleanup_free_ void *dict = NULL;
+        size_t size;
+        int r;
+
+        assert(f);
+        assert(template);
+
+        r = journal_file_train_compression_dictionary(template, &dict, &size);
+        if (r < 0)
+                return r;
+
+        r = journal_file_set_compression_dictionary(f, dict, size);
+        if (r < 0)
+                return r;
+
+        log_debug("Trained %zu byte compression dictionary for %s.", size, f->path);
+        return 0;
+}
+
+int journal_file_rotate(
+                JournalFile **f,
+                bool compress,
+                uint64_t compress_threshold_bytes,
+                bool compress_dictionary,
+                bool seal,
+                Set *deferred_closes) {
+
+        JournalFile *new_file = NULL;
+        int r;
+
+        assert(f);
+        assert(*f);
+
+        r = journal_file_archive(*f);
+        if (r < 0)
+                return r;
 
         r = journal_file_open(
                         -1,
@@ -3765,6 +4813,15 @@ int journal_file_rotate(
                         *f,              /* template */
                         &new_file);
 
+        /* Train the dictionary from the file we just archived, before anything gets written to the new one */
+        if (r >= 0 && compress_dictionary && new_file->compress_zstd) {
+                int k;
+
+                k = journal_file_inherit_compression_dictionary(new_file, *f);
+                if (k < 0)
+                        log_debug_errno(k, "Failed to set up compression dictionary for %s, ignoring: %m", new_file->path);
+        }
+
         journal_initiate_close(*f, deferred_closes);
         *f = new_file;
 
@@ -3855,7 +4912,69 @@ int journal_file_open_reliably(
                                  deferred_closes, template, ret);
 }
 
-int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p) {
+/* Remembers where a DATA object of one journal file ended up when it was copied into another one, so that
+ * copying further entries referencing it doesn't require decompressing, hashing and looking it up again. */
+typedef struct CopiedData {
+        JournalFile *from, *to;
+        uint64_t from_offset;
+        uint64_t to_offset;
+        le64_t to_hash;
+        uint64_t xor_hash;
+} CopiedData;
+
+/* Don't let the cache grow without bounds when copying huge files, it's just flushed once it's full */
+#define COPIED_DATA_CACHE_MAX 65536U
+
+static void copied_data_hash_func(const CopiedData *d, struct siphash *state) {
+        siphash24_compress(&d->from, sizeof(d->from), state);
+        siphash24_compress(&d->to, sizeof(d->to), state);
+        siphash24_compress(&d->from_offset, sizeof(d->from_offset), state);
+}
+
+static int copied_data_compare_func(const CopiedData *x, const CopiedData *y) {
+        int r;
+
+        r = CMP(x->from, y->from);
+        if (r != 0)
+                return r;
+
+        r = CMP(x->to, y->to);
+        if (r != 0)
+                return r;
+
+        return CMP(x->from_offset, y->from_offset);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(copied_data_hash_ops, CopiedData, copied_data_hash_func, copied_data_compare_func, free);
+
+static void copied_data_remember(Set **cache, JournalFile *from, JournalFile *to, uint64_t from_offset, Object *u, uint64_t to_offset, uint64_t xor_hash) {
+        _cleanup_free_ CopiedData *d = NULL;
+
+        assert(cache);
+
+        /* This is just an optimization, hence failing to allocate memory is not fatal */
+
+        if (set_size(*cache) >= COPIED_DATA_CACHE_MAX)
+                set_clear(*cache);
+
+        d = new(CopiedData, 1);
+        if (!d)
+                return;
+
+        *d = (CopiedData) {
+                .from = from,
+                .to = to,
+                .from_offset = from_offset,
+                .to_offset = to_offset,
+                .to_hash = u->data.hash,
+                .xor_hash = xor_hash,
+        };
+
+        if (set_ensure_put(cache, &copied_data_hash_ops, d) > 0)
+                TAKE_PTR(d);
+}
+
+int journal_file_copy_entry_full(JournalFile *from, JournalFile *to, Object *o, uint64_t p, uint64_t *seqnum, Set **data_cache) {
         uint64_t q, n, xor_hash = 0;
         const sd_id128_t *boot_id;
         dual_timestamp ts;
@@ -3879,7 +4998,7 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
         items = newa(EntryItem, MAX(1u, n));
 
         for (uint64_t i = 0; i < n; i++) {
-                uint64_t l, h;
+                uint64_t l, h, x;
                 le64_t le_hash;
                 size_t t;
                 void *data;
@@ -3888,6 +5007,18 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                 q = le64toh(o->entry.items[i].object_offset);
                 le_hash = o->entry.items[i].hash;
 
+                if (data_cache) {
+                        CopiedData *d;
+
+                        d = set_get(*data_cache, &(CopiedData) { .from = from, .to = to, .from_offset = q });
+                        if (d) {
+                                xor_hash ^= d->xor_hash;
+                                items[i].object_offset = htole64(d->to_offset);
+                                items[i].hash = d->to_hash;
+                                continue;
+                        }
+                }
+
                 r = journal_file_move_to_object(from, OBJECT_DATA, q, &o);
                 if (r < 0)
                         return r;
@@ -3910,8 +5041,9 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
 #if HAVE_COMPRESSION
                         size_t rsize = 0;
 
-                        r = decompress_blob(
+                        r = decompress_blob_full(
                                         o->object.flags & OBJECT_COMPRESSION_MASK,
+                                        from->compress_dictionary,
                                         o->data.payload, l,
                                         &from->compress_buffer, &rsize,
                                         0);
@@ -3930,21 +5062,22 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                 if (r < 0)
                         return r;
 
-                if (JOURNAL_HEADER_KEYED_HASH(to->header))
-                        xor_hash ^= jenkins_hash64(data, l);
-                else
-                        xor_hash ^= le64toh(u->data.hash);
+                x = JOURNAL_HEADER_KEYED_HASH(to->header) ? jenkins_hash64(data, l) : le64toh(u->data.hash);
+                xor_hash ^= x;
 
                 items[i].object_offset = htole64(h);
                 items[i].hash = u->data.hash;
 
+                if (data_cache)
+                        copied_data_remember(data_cache, from, to, q, u, h, x);
+
                 r = journal_file_move_to_object(from, OBJECT_ENTRY, p, &o);
                 if (r < 0)
                         return r;
         }
 
         r = journal_file_append_entry_internal(to, &ts, boot_id, xor_hash, items, n,
-                                               NULL, NULL, NULL);
+                                               seqnum, NULL, NULL);
 
         if (mmap_cache_got_sigbus(to->mmap, to->cache_fd))
                 return -EIO;
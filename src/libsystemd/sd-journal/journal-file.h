@@ -11,6 +11,7 @@
 #include "sd-event.h"
 #include "sd-id128.h"
 
+#include "compress.h"
 #include "hashmap.h"
 #include "journal-def.h"
 #include "mmap-cache.h"
@@ -76,6 +77,7 @@ typedef struct JournalFile {
         direction_t last_direction;
         LocationType location_type;
         uint64_t last_n_entries;
+        unsigned location_prioq_idx;
 
         char *path;
         struct stat last_stat;
@@ -109,6 +111,7 @@ typedef struct JournalFile {
 #if HAVE_COMPRESSION
         void *compress_buffer;
 #endif
+        CompressDictionary *compress_dictionary;
 
 #if HAVE_GCRYPT
         gcry_md_hd_t hmac;
@@ -128,6 +131,12 @@ typedef struct JournalFile {
 #endif
 } JournalFile;
 
+typedef struct JournalAppendEntry {
+        dual_timestamp ts;
+        const struct iovec *iovec;
+        size_t n_iovec;
+} JournalAppendEntry;
+
 int journal_file_open(
                 int fd,
                 const char *fname,
@@ -189,6 +198,12 @@ static inline bool VALID_EPOCH(uint64_t u) {
 #define JOURNAL_HEADER_SEALED(h) \
         FLAGS_SET(le32toh((h)->compatible_flags), HEADER_COMPATIBLE_SEALED)
 
+#define JOURNAL_HEADER_FIELD_INDEX(h) \
+        FLAGS_SET(le32toh((h)->compatible_flags), HEADER_COMPATIBLE_FIELD_INDEX)
+
+#define JOURNAL_HEADER_SEEK_INDEX(h) \
+        FLAGS_SET(le32toh((h)->compatible_flags), HEADER_COMPATIBLE_SEEK_INDEX)
+
 #define JOURNAL_HEADER_COMPRESSED_XZ(h) \
         FLAGS_SET(le32toh((h)->incompatible_flags), HEADER_INCOMPATIBLE_COMPRESSED_XZ)
 
@@ -201,6 +216,9 @@ static inline bool VALID_EPOCH(uint64_t u) {
 #define JOURNAL_HEADER_KEYED_HASH(h) \
         FLAGS_SET(le32toh((h)->incompatible_flags), HEADER_INCOMPATIBLE_KEYED_HASH)
 
+#define JOURNAL_HEADER_COMPRESSION_DICTIONARY(h) \
+        FLAGS_SET(le32toh((h)->incompatible_flags), HEADER_INCOMPATIBLE_COMPRESSION_DICTIONARY)
+
 int journal_file_move_to_object(JournalFile *f, ObjectType type, uint64_t offset, Object **ret);
 
 uint64_t journal_file_entry_n_items(Object *o) _pure_;
@@ -208,6 +226,11 @@ uint64_t journal_file_entry_array_n_items(Object *o) _pure_;
 uint64_t journal_file_hash_table_n_items(Object *o) _pure_;
 
 int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, Object **ret, uint64_t *offset);
+
+int journal_file_find_field_index(JournalFile *f, uint64_t field_offset, uint64_t *ret_offset);
+int journal_file_field_index_get(JournalFile *f, uint64_t offset, uint64_t i, const void **ret_data, size_t *ret_size);
+int journal_file_field_index_contains(JournalFile *f, uint64_t offset, const void *data, size_t size);
+
 int journal_file_append_entry(
                 JournalFile *f,
                 const dual_timestamp *ts,
@@ -216,6 +239,11 @@ int journal_file_append_entry(
                 uint64_t *seqno,
                 Object **ret,
                 uint64_t *offset);
+int journal_file_append_entries(
+                JournalFile *f,
+                const JournalAppendEntry entries[], size_t n_entries,
+                uint64_t *seqno,
+                size_t *ret_n_appended);
 
 int journal_file_find_data_object(JournalFile *f, const void *data, uint64_t size, Object **ret, uint64_t *offset);
 int journal_file_find_data_object_with_hash(JournalFile *f, const void *data, uint64_t size, uint64_t hash, Object **ret, uint64_t *offset);
@@ -239,14 +267,24 @@ int journal_file_move_to_entry_by_seqnum_for_data(JournalFile *f, uint64_t data_
 int journal_file_move_to_entry_by_realtime_for_data(JournalFile *f, uint64_t data_offset, uint64_t realtime, direction_t direction, Object **ret, uint64_t *offset);
 int journal_file_move_to_entry_by_monotonic_for_data(JournalFile *f, uint64_t data_offset, sd_id128_t boot_id, uint64_t monotonic, direction_t direction, Object **ret, uint64_t *offset);
 
-int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p);
+/* If data_cache is non-NULL, it is used to remember which DATA objects were already copied, so that they
+ * are reused without reading them again when copying many entries between the same files. It must be
+ * flushed whenever one of the files involved is closed. */
+int journal_file_copy_entry_full(JournalFile *from, JournalFile *to, Object *o, uint64_t p, uint64_t *seqnum, Set **data_cache);
+static inline int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p, uint64_t *seqnum) {
+        return journal_file_copy_entry_full(from, to, o, p, seqnum, NULL);
+}
 
 void journal_file_dump(JournalFile *f);
 void journal_file_print_header(JournalFile *f);
 
+void journal_file_append_indexes(JournalFile *f);
 int journal_file_archive(JournalFile *f);
 JournalFile* journal_initiate_close(JournalFile *f, Set *deferred_closes);
-int journal_file_rotate(JournalFile **f, bool compress, uint64_t compress_threshold_bytes, bool seal, Set *deferred_closes);
+int journal_file_rotate(JournalFile **f, bool compress, uint64_t compress_threshold_bytes, bool compress_dictionary, bool seal, Set *deferred_closes);
+
+int journal_file_set_compression_dictionary(JournalFile *f, const void *data, size_t size);
+int journal_file_train_compression_dictionary(JournalFile *f, void **ret, size_t *ret_size);
 
 int journal_file_dispose(int dir_fd, const char *fname);
 
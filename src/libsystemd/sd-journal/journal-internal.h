@@ -12,6 +12,7 @@
 #include "journal-def.h"
 #include "journal-file.h"
 #include "list.h"
+#include "prioq.h"
 #include "set.h"
 
 typedef struct Match Match;
@@ -64,6 +65,17 @@ struct Directory {
         unsigned last_seen_generation;
 };
 
+typedef struct DataCacheEntry DataCacheEntry;
+
+/* A decompressed DATA object payload, keyed by the file and the offset of the object in it. */
+struct DataCacheEntry {
+        JournalFile *file;
+        uint64_t offset;
+        size_t size;
+        LIST_FIELDS(DataCacheEntry, lru);
+        uint8_t payload[];
+};
+
 struct sd_journal {
         int toplevel_fd;
 
@@ -80,6 +92,13 @@ struct sd_journal {
         JournalFile *current_file;
         uint64_t current_field;
 
+        /* All files that currently have a candidate entry for the iteration direction, ordered by that
+         * entry. This way sd_journal_next() only has to advance the files whose candidate was consumed,
+         * instead of comparing the candidates of all files on each step. */
+        Prioq *files_by_location;
+        direction_t files_by_location_direction;
+        unsigned files_by_location_invalidate_counter;
+
         Match *level0, *level1, *level2;
 
         pid_t original_pid;
@@ -93,6 +112,8 @@ struct sd_journal {
         char *unique_field;
         JournalFile *unique_file;
         uint64_t unique_offset;
+        uint64_t unique_index_offset; /* If non-zero we iterate through the file's field index instead */
+        uint64_t unique_index_item;
 
         /* Iterating through known fields */
         JournalFile *fields_file;
@@ -115,6 +136,16 @@ struct sd_journal {
 
         size_t data_threshold;
 
+        /* Recently decompressed DATA objects, most recently used first. Fields such as _SYSTEMD_UNIT= or
+         * _CMDLINE= are shared by many entries, hence this saves us from decompressing them over and
+         * over again. */
+        Hashmap *data_cache;
+        LIST_HEAD(DataCacheEntry, data_cache_lru);
+        DataCacheEntry *data_cache_lru_tail;
+        size_t data_cache_size;
+        size_t data_cache_size_max;
+        unsigned n_data_cache_hit, n_data_cache_missed;
+
         Hashmap *directories_by_path;
         Hashmap *directories_by_wd;
 
@@ -13,10 +13,12 @@
 #include "fs-util.h"
 #include "journal-def.h"
 #include "journal-file.h"
+#include "journal-internal.h"
 #include "journal-vacuum.h"
 #include "sort-util.h"
 #include "string-util.h"
 #include "time-util.h"
+#include "tmpfile-util.h"
 #include "xattr-util.h"
 
 struct vacuum_info {
@@ -322,3 +324,165 @@ finish:
 
         return r;
 }
+
+static int compact_copy_dictionary(JournalFile *from, JournalFile *to) {
+        Object *o;
+        int r;
+
+        assert(from);
+        assert(to);
+
+        /* Reuse the dictionary of the original file, the data we keep is a subset of what it was trained on */
+        if (!from->compress_dictionary || !to->compress_zstd)
+                return 0;
+
+        r = journal_file_move_to_object(from, OBJECT_COMPRESSION_DICTIONARY,
+                                        le64toh(from->header->compression_dictionary_offset), &o);
+        if (r < 0)
+                return r;
+
+        return journal_file_set_compression_dictionary(
+                        to,
+                        o->compression_dictionary.payload,
+                        le64toh(o->object.size) - offsetof(Object, compression_dictionary.payload));
+}
+
+int journal_compact_file(sd_journal *j, bool verbose) {
+        uint64_t n_kept = 0, n_entries, size_before, size_after;
+        _cleanup_(unlink_and_freep) char *tmp = NULL;
+        JournalFile *from, *to = NULL;
+        JournalMetrics metrics;
+        struct stat st;
+        int fd, r;
+
+        assert(j);
+
+        /* Rewrites an archived journal file, keeping only the entries that match the filter installed on
+         * 'j', which must contain exactly this one file. The new file gets a data hash table sized for the
+         * data actually present, and since DATA objects are appended through the usual deduplicating path,
+         * only the fields still referenced by the remaining entries are copied over. Sequence numbers are
+         * kept, so cursors of the remaining entries stay valid. */
+
+        if (ordered_hashmap_size(j->files) != 1)
+                return -EINVAL;
+
+        from = ordered_hashmap_first(j->files);
+
+        if (from->header->state != STATE_ARCHIVED)
+                return log_debug_errno(SYNTHETIC_ERRNO(EBUSY),
+                                       "Journal file %s is not archived, refusing to compact.", from->path);
+
+        /* Dropping entries would break the seal chain */
+        if (JOURNAL_HEADER_SEALED(from->header))
+                return log_debug_errno(SYNTHETIC_ERRNO(EPERM),
+                                       "Journal file %s is sealed, refusing to compact.", from->path);
+
+        if (fstat(from->fd, &st) < 0)
+                return -errno;
+
+        size_before = 512UL * (uint64_t) st.st_blocks;
+        n_entries = le64toh(from->header->n_entries);
+
+        r = sd_journal_seek_head(j);
+        if (r < 0)
+                return r;
+
+        r = sd_journal_next(j);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                /* Nothing is left, remove the file altogether */
+                if (unlink(from->path) < 0)
+                        return -errno;
+
+                log_full(verbose ? LOG_INFO : LOG_DEBUG,
+                         "Deleted archived journal %s, none of its %" PRIu64 " entries matched (%s).",
+                         from->path, n_entries, FORMAT_BYTES(size_before));
+                return 0;
+        }
+
+        r = tempfn_random(from->path, NULL, &tmp);
+        if (r < 0)
+                return r;
+
+        fd = open(tmp, O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC|O_NOCTTY, st.st_mode & 07777);
+        if (fd < 0) {
+                tmp = mfree(tmp);
+                return -errno;
+        }
+
+        if (fchown(fd, st.st_uid, st.st_gid) < 0)
+                log_debug_errno(errno, "Failed to copy ownership of %s, ignoring: %m", from->path);
+
+        /* The data hash table is sized for max_size, hence pick the size that gives us a 75% fill level for
+         * the DATA objects of the original file, see journal_file_setup_data_hash_table(). */
+        journal_reset_metrics(&metrics);
+        metrics.max_size = MAX(le64toh(from->header->n_data), 1u) * 768;
+
+        /* On success the JournalFile object takes possession of the fd */
+        r = journal_file_open(fd, NULL, O_RDWR|O_CREAT, st.st_mode & 07777, JOURNAL_FILE_COMPRESS(from),
+                              UINT64_MAX, false, &metrics, NULL, NULL, NULL, &to);
+        if (r < 0) {
+                safe_close(fd);
+                return r;
+        }
+
+        /* The hash table is set up, now lift the size limit again */
+        to->metrics.max_size = 0;
+        to->header->seqnum_id = from->header->seqnum_id;
+        to->header->machine_id = from->header->machine_id;
+
+        r = compact_copy_dictionary(from, to);
+        if (r < 0)
+                log_debug_errno(r, "Failed to copy compression dictionary of %s, ignoring: %m", from->path);
+
+        do {
+                uint64_t seqnum;
+                Object *o;
+
+                assert(j->current_file == from);
+
+                r = journal_file_move_to_object(from, OBJECT_ENTRY, from->current_offset, &o);
+                if (r < 0)
+                        goto fail;
+
+                seqnum = le64toh(o->entry.seqnum) - 1;
+
+                r = journal_file_copy_entry(from, to, o, from->current_offset, &seqnum);
+                if (r < 0)
+                        goto fail;
+
+                n_kept++;
+
+                r = sd_journal_next(j);
+                if (r < 0)
+                        goto fail;
+        } while (r > 0);
+
+        journal_file_append_indexes(to);
+
+        /* Closing an archived file syncs it to disk */
+        to->archive = true;
+        to = journal_file_close(to);
+
+        if (stat(tmp, &st) < 0)
+                return -errno;
+
+        size_after = 512UL * (uint64_t) st.st_blocks;
+
+        if (rename(tmp, from->path) < 0)
+                return -errno;
+
+        tmp = mfree(tmp);
+        (void) fsync_parent_at(AT_FDCWD, from->path);
+
+        log_full(verbose ? LOG_INFO : LOG_DEBUG,
+                 "Compacted archived journal %s, kept %" PRIu64 " of %" PRIu64 " entries, freed %s.",
+                 from->path, n_kept, n_entries, FORMAT_BYTES(LESS_BY(size_before, size_after)));
+
+        return 1;
+
+fail:
+        (void) journal_file_close(to);
+        return r;
+}
@@ -4,6 +4,10 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include "sd-journal.h"
+
 #include "time-util.h"
 
 int journal_directory_vacuum(const char *directory, uint64_t max_use, uint64_t n_max_files, usec_t max_retention_usec, usec_t *oldest_usec, bool verbose);
+
+int journal_compact_file(sd_journal *j, bool verbose);
@@ -155,10 +155,10 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                         _cleanup_free_ void *b = NULL;
                         size_t b_size;
 
-                        r = decompress_blob(compression,
-                                            o->data.payload,
-                                            le64toh(o->object.size) - offsetof(Object, data.payload),
-                                            &b, &b_size, 0);
+                        r = decompress_blob_full(compression, f->compress_dictionary,
+                                                 o->data.payload,
+                                                 le64toh(o->object.size) - offsetof(Object, data.payload),
+                                                 &b, &b_size, 0);
                         if (r < 0) {
                                 error_errno(offset, r, "%s decompression failed: %m",
                                             object_compressed_to_string(compression));
@@ -346,9 +346,122 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                         return -EBADMSG;
                 }
 
+                break;
+
+        case OBJECT_FIELD_INDEX: {
+                uint64_t n, sz, i;
+
+                sz = le64toh(o->object.size);
+                n = le64toh(o->field_index.n_items);
+
+                if (sz < offsetof(FieldIndexObject, items) ||
+                    n > (sz - offsetof(FieldIndexObject, items)) / sizeof(FieldIndexItem)) {
+                        error(offset,
+                              "Invalid field index size %"PRIu64" for %"PRIu64" items",
+                              sz, n);
+                        return -EBADMSG;
+                }
+
+                if (!VALID64(le64toh(o->field_index.field_offset)) ||
+                    !VALID64(le64toh(o->field_index.next_field_index_offset)) ||
+                    le64toh(o->field_index.field_offset) == 0) {
+                        error(offset,
+                              "Invalid offset (field_offset="OFSfmt", next_field_index_offset="OFSfmt,
+                              le64toh(o->field_index.field_offset),
+                              le64toh(o->field_index.next_field_index_offset));
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < n; i++) {
+                        uint64_t po, ps;
+
+                        po = le32toh(o->field_index.items[i].payload_offset);
+                        ps = le32toh(o->field_index.items[i].payload_size);
+
+                        if (po < offsetof(FieldIndexObject, items) + n * sizeof(FieldIndexItem) ||
+                            po > sz || ps > sz - po) {
+                                error(offset,
+                                      "Invalid field index payload (%"PRIu64"/%"PRIu64")",
+                                      i, n);
+                                return -EBADMSG;
+                        }
+
+                        if (!VALID64(le64toh(o->field_index.items[i].data_offset)) ||
+                            le64toh(o->field_index.items[i].data_offset) == 0) {
+                                error(offset,
+                                      "Invalid field index data offset (%"PRIu64"/%"PRIu64"): "OFSfmt,
+                                      i, n,
+                                      le64toh(o->field_index.items[i].data_offset));
+                                return -EBADMSG;
+                        }
+
+                        if (i > 0) {
+                                uint64_t qo, qs;
+                                int c;
+
+                                qo = le32toh(o->field_index.items[i-1].payload_offset);
+                                qs = le32toh(o->field_index.items[i-1].payload_size);
+
+                                c = memcmp((uint8_t*) o + qo, (uint8_t*) o + po, MIN(qs, ps));
+                                if (c > 0 || (c == 0 && qs >= ps)) {
+                                        error(offset,
+                                              "Field index not sorted (%"PRIu64"/%"PRIu64")",
+                                              i, n);
+                                        return -EBADMSG;
+                                }
+                        }
+                }
+
                 break;
         }
 
+        case OBJECT_SEEK_INDEX: {
+                uint64_t n, stride, i;
+
+                n = (le64toh(o->object.size) - offsetof(SeekIndexObject, items)) / sizeof(SeekIndexItem);
+                stride = le64toh(o->seek_index.stride);
+
+                if ((le64toh(o->object.size) - offsetof(SeekIndexObject, items)) % sizeof(SeekIndexItem) != 0 ||
+                    stride <= 0 ||
+                    DIV_ROUND_UP(le64toh(o->seek_index.n_entries), stride) != n) {
+                        error(offset,
+                              "Invalid seek index size %"PRIu64" for %"PRIu64" entries",
+                              le64toh(o->object.size),
+                              le64toh(o->seek_index.n_entries));
+                        return -EBADMSG;
+                }
+
+                if (le64toh(o->seek_index.n_entries) != le64toh(f->header->n_entries)) {
+                        error(offset,
+                              "Seek index covers %"PRIu64" entries, but file has %"PRIu64,
+                              le64toh(o->seek_index.n_entries),
+                              le64toh(f->header->n_entries));
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < n; i++) {
+                        if (!VALID64(le64toh(o->seek_index.items[i].entry_array_offset)) ||
+                            le64toh(o->seek_index.items[i].entry_array_offset) == 0) {
+                                error(offset,
+                                      "Invalid seek index entry array offset (%"PRIu64"/%"PRIu64"): "OFSfmt,
+                                      i, n,
+                                      le64toh(o->seek_index.items[i].entry_array_offset));
+                                return -EBADMSG;
+                        }
+
+                        if (i > 0 &&
+                            le64toh(o->seek_index.items[i-1].seqnum) >= le64toh(o->seek_index.items[i].seqnum)) {
+                                error(offset,
+                                      "Seek index sequence numbers not increasing (%"PRIu64"/%"PRIu64")",
+                                      i, n);
+                                return -EBADMSG;
+                        }
+                }
+
+                break;
+        }
+        }
+
         return 0;
 }
 
@@ -1166,6 +1279,45 @@ int journal_file_verify(
                         n_tags++;
                         break;
 
+                case OBJECT_FIELD_INDEX:
+                        if (!JOURNAL_HEADER_FIELD_INDEX(f->header)) {
+                                error(p, "Field index object in file without field index");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        break;
+
+                case OBJECT_SEEK_INDEX:
+                        if (!JOURNAL_HEADER_SEEK_INDEX(f->header)) {
+                                error(p, "Seek index object in file without seek index");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        if (p != le64toh(f->header->seek_index_offset)) {
+                                error(p, "Seek index object not referenced by header");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        break;
+
+                case OBJECT_COMPRESSION_DICTIONARY:
+                        if (!JOURNAL_HEADER_COMPRESSION_DICTIONARY(f->header)) {
+                                error(p, "Compression dictionary object in file without compression dictionary");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        if (p != le64toh(f->header->compression_dictionary_offset)) {
+                                error(p, "Compression dictionary object not referenced by header");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        break;
+
                 default:
                         n_weird++;
                 }
@@ -1,12 +1,14 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 
 #include "alloc-util.h"
 #include "errno-util.h"
 #include "fd-util.h"
+#include "format-util.h"
 #include "hashmap.h"
 #include "list.h"
 #include "log.h"
@@ -50,6 +52,12 @@ struct MMapFileDescriptor {
         int fd;
         int prot;
         bool sigbus;
+
+        /* Size of the windows we create for this file, adjusted to the observed access pattern, and the
+         * end of the last (window-missing) access we mapped a window for. */
+        uint64_t window_size;
+        uint64_t last_miss_end;
+
         LIST_HEAD(Window, windows);
 };
 
@@ -57,7 +65,10 @@ struct MMapCache {
         unsigned n_ref;
         unsigned n_windows;
 
-        unsigned n_context_cache_hit, n_window_list_hit, n_missed;
+        unsigned n_context_cache_hit, n_window_list_hit, n_missed, n_evicted, n_readahead;
+        uint64_t n_bytes_mapped, n_bytes_mapped_max;
+
+        bool readahead;
 
         Hashmap *fds;
         Context *contexts[MMAP_CACHE_MAX_CONTEXTS];
@@ -70,9 +81,16 @@ struct MMapCache {
 
 #if ENABLE_DEBUG_MMAP_CACHE
 /* Tiny windows increase mmap activity and the chance of exposing unsafe use. */
-# define WINDOW_SIZE (page_size())
+# define WINDOW_SIZE_DEFAULT (page_size())
+# define WINDOW_SIZE_MIN (page_size())
+# define WINDOW_SIZE_MAX (page_size())
 #else
-# define WINDOW_SIZE (8ULL*1024ULL*1024ULL)
+/* Windows start out at the default size, grow (doubling each time) while misses continue where the previous
+ * one ended, i.e. while the file is read sequentially, and shrink (halving each time) while misses are
+ * scattered across the file, i.e. on random seeks. */
+# define WINDOW_SIZE_DEFAULT (8ULL*1024ULL*1024ULL)
+# define WINDOW_SIZE_MIN (page_size())
+# define WINDOW_SIZE_MAX (32ULL*1024ULL*1024ULL)
 #endif
 
 MMapCache* mmap_cache_new(void) {
@@ -91,9 +109,13 @@ static void window_unlink(Window *w) {
 
         assert(w);
 
-        if (w->ptr)
+        if (w->ptr) {
                 munmap(w->ptr, w->size);
 
+                assert(w->cache->n_bytes_mapped >= w->size);
+                w->cache->n_bytes_mapped -= w->size;
+        }
+
         if (w->fd)
                 LIST_REMOVE(by_fd, w->fd->windows, w);
 
@@ -170,6 +192,7 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, bool keep_always,
                 /* Reuse an existing one */
                 w = m->last_unused;
                 window_unlink(w);
+                m->n_evicted++;
         }
 
         *w = (Window) {
@@ -183,6 +206,9 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, bool keep_always,
 
         LIST_PREPEND(by_fd, f->windows, w);
 
+        m->n_bytes_mapped += size;
+        m->n_bytes_mapped_max = MAX(m->n_bytes_mapped_max, m->n_bytes_mapped);
+
         return w;
 }
 
@@ -296,6 +322,7 @@ static int make_room(MMapCache *m) {
                 return 0;
 
         window_free(m->last_unused);
+        m->n_evicted++;
         return 1;
 }
 
@@ -408,6 +435,36 @@ static int mmap_try_harder(MMapCache *m, void *addr, MMapFileDescriptor *f, int
         return 0;
 }
 
+static void readahead_next_window(MMapCache *m, MMapFileDescriptor *f, uint64_t woffset, uint64_t wsize, struct stat *st) {
+        uint64_t offset, size;
+        int r;
+
+        assert(m);
+        assert(f);
+
+        /* We are reading through this file sequentially, hence the next miss will most likely be right
+         * after the window we just mapped. Ask the kernel to start reading that range in the background
+         * now, so that we don't have to take the page faults on it synchronously later on. */
+
+        offset = woffset + wsize;
+        size = f->window_size;
+
+        if (st) {
+                if (offset >= (uint64_t) st->st_size)
+                        return;
+
+                size = MIN(size, (uint64_t) st->st_size - offset);
+        }
+
+        r = posix_fadvise(f->fd, offset, size, POSIX_FADV_WILLNEED);
+        if (r != 0) {
+                log_debug_errno(r, "Failed to issue readahead for next mmap window, ignoring: %m");
+                return;
+        }
+
+        m->n_readahead++;
+}
+
 static int add_mmap(
                 MMapCache *m,
                 MMapFileDescriptor *f,
@@ -419,6 +476,7 @@ static int add_mmap(
                 void **ret) {
 
         uint64_t woffset, wsize;
+        bool sequential;
         Context *c;
         Window *w;
         void *d;
@@ -430,21 +488,32 @@ static int add_mmap(
         assert(size > 0);
         assert(ret);
 
+        /* A miss shortly after the end of the previous one means we are walking through the file
+         * sequentially: map bigger windows, and map them ahead of the access only. Otherwise make the
+         * windows smaller, so that random seeks don't pin a lot of memory that is never looked at. */
+        sequential = f->last_miss_end > 0 &&
+                offset >= f->last_miss_end &&
+                offset <= f->last_miss_end + f->window_size;
+        if (sequential)
+                f->window_size = MIN(f->window_size * 2, WINDOW_SIZE_MAX);
+        else if (f->last_miss_end > 0)
+                f->window_size = MAX(f->window_size / 2, WINDOW_SIZE_MIN);
+
         woffset = offset & ~((uint64_t) page_size() - 1ULL);
         wsize = size + (offset - woffset);
         wsize = PAGE_ALIGN(wsize);
 
-        if (wsize < WINDOW_SIZE) {
+        if (wsize < f->window_size) {
                 uint64_t delta;
 
-                delta = PAGE_ALIGN((WINDOW_SIZE - wsize) / 2);
+                delta = sequential ? 0 : PAGE_ALIGN((f->window_size - wsize) / 2);
 
                 if (delta > offset)
                         woffset = 0;
                 else
                         woffset -= delta;
 
-                wsize = WINDOW_SIZE;
+                wsize = f->window_size;
         }
 
         if (st) {
@@ -473,6 +542,11 @@ static int add_mmap(
 
         context_attach_window(c, w);
 
+        f->last_miss_end = offset + size;
+
+        if (sequential && m->readahead)
+                readahead_next_window(m, f, woffset, wsize, st);
+
         *ret = (uint8_t*) w->ptr + (offset - w->offset);
 
         return 1;
@@ -521,10 +595,38 @@ int mmap_cache_get(
         return add_mmap(m, f, context, keep_always, offset, size, st, ret);
 }
 
+void mmap_cache_get_statistics(MMapCache *m, MMapCacheStatistics *ret) {
+        assert(m);
+        assert(ret);
+
+        *ret = (MMapCacheStatistics) {
+                .n_context_cache_hit = m->n_context_cache_hit,
+                .n_window_list_hit = m->n_window_list_hit,
+                .n_missed = m->n_missed,
+                .n_evicted = m->n_evicted,
+                .n_readahead = m->n_readahead,
+                .n_windows = m->n_windows,
+                .n_bytes_mapped = m->n_bytes_mapped,
+                .n_bytes_mapped_max = m->n_bytes_mapped_max,
+        };
+}
+
+void mmap_cache_set_readahead(MMapCache *m, bool b) {
+        assert(m);
+
+        m->readahead = b;
+}
+
 void mmap_cache_stats_log_debug(MMapCache *m) {
+        char a[FORMAT_BYTES_MAX], b[FORMAT_BYTES_MAX];
+
         assert(m);
 
-        log_debug("mmap cache statistics: %u context cache hit, %u window list hit, %u miss", m->n_context_cache_hit, m->n_window_list_hit, m->n_missed);
+        log_debug("mmap cache statistics: %u context cache hit, %u window list hit, %u miss, %u evicted, "
+                  "%u readahead, %u windows, %s mapped, %s mapped at most",
+                  m->n_context_cache_hit, m->n_window_list_hit, m->n_missed, m->n_evicted, m->n_readahead,
+                  m->n_windows, format_bytes(a, sizeof(a), m->n_bytes_mapped),
+                  format_bytes(b, sizeof(b), m->n_bytes_mapped_max));
 }
 
 static void mmap_cache_process_sigbus(MMapCache *m) {
@@ -620,6 +722,7 @@ MMapFileDescriptor* mmap_cache_add_fd(MMapCache *m, int fd, int prot) {
         f->cache = m;
         f->fd = fd;
         f->prot = prot;
+        f->window_size = WINDOW_SIZE_DEFAULT;
 
         r = hashmap_put(m->fds, FD_TO_PTR(fd), f);
         if (r < 0)
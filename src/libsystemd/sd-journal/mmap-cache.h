@@ -2,14 +2,26 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/stat.h>
 
 /* One context per object type, plus one of the header, plus one "additional" one */
-#define MMAP_CACHE_MAX_CONTEXTS 9
+#define MMAP_CACHE_MAX_CONTEXTS 12
 
 typedef struct MMapCache MMapCache;
 typedef struct MMapFileDescriptor MMapFileDescriptor;
 
+typedef struct MMapCacheStatistics {
+        unsigned n_context_cache_hit;
+        unsigned n_window_list_hit;
+        unsigned n_missed;
+        unsigned n_evicted;
+        unsigned n_readahead;
+        unsigned n_windows;
+        uint64_t n_bytes_mapped;
+        uint64_t n_bytes_mapped_max;
+} MMapCacheStatistics;
+
 MMapCache* mmap_cache_new(void);
 MMapCache* mmap_cache_ref(MMapCache *m);
 MMapCache* mmap_cache_unref(MMapCache *m);
@@ -26,6 +38,9 @@ int mmap_cache_get(
 MMapFileDescriptor * mmap_cache_add_fd(MMapCache *m, int fd, int prot);
 void mmap_cache_free_fd(MMapCache *m, MMapFileDescriptor *f);
 
+void mmap_cache_set_readahead(MMapCache *m, bool b);
+
+void mmap_cache_get_statistics(MMapCache *m, MMapCacheStatistics *ret);
 void mmap_cache_stats_log_debug(MMapCache *m);
 
 bool mmap_cache_got_sigbus(MMapCache *m, MMapFileDescriptor *f);
@@ -17,6 +17,7 @@
 #include "compress.h"
 #include "dirent-util.h"
 #include "env-file.h"
+#include "env-util.h"
 #include "escape.h"
 #include "fd-util.h"
 #include "fileio.h"
@@ -51,7 +52,10 @@
 
 #define DEFAULT_DATA_THRESHOLD (64*1024)
 
+#define DEFAULT_DATA_CACHE_SIZE (1024*1024)
+
 static void remove_file_real(sd_journal *j, JournalFile *f);
+static void data_cache_flush(sd_journal *j, JournalFile *f);
 
 static bool journal_pid_changed(sd_journal *j) {
         assert(j);
@@ -98,6 +102,20 @@ static int journal_put_error(sd_journal *j, int r, const char *path) {
         return 0;
 }
 
+static void files_by_location_clear(sd_journal *j) {
+        JournalFile *f;
+
+        assert(j);
+
+        /* Note that we don't pop the entries one by one here: this is called when the file locations are
+         * being reset, hence they cannot be compared with each other anymore. */
+
+        PRIOQ_FOREACH_ITEM(j->files_by_location, f)
+                f->location_prioq_idx = PRIOQ_IDX_NULL;
+
+        j->files_by_location = prioq_free(j->files_by_location);
+}
+
 static void detach_location(sd_journal *j) {
         JournalFile *f;
 
@@ -106,6 +124,8 @@ static void detach_location(sd_journal *j) {
         j->current_file = NULL;
         j->current_field = 0;
 
+        files_by_location_clear(j);
+
         ORDERED_HASHMAP_FOREACH(f, j->files)
                 journal_file_reset_location(f);
 }
@@ -813,48 +833,155 @@ static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direc
         }
 }
 
-static int real_journal_next(sd_journal *j, direction_t direction) {
-        JournalFile *new_file = NULL;
+static int compare_files_by_location_down(const void *a, const void *b) {
+        return journal_file_compare_locations((JournalFile*) a, (JournalFile*) b);
+}
+
+static int compare_files_by_location_up(const void *a, const void *b) {
+        return journal_file_compare_locations((JournalFile*) b, (JournalFile*) a);
+}
+
+static int files_by_location_put(sd_journal *j, JournalFile *f, direction_t direction) {
+        int r;
+
+        assert(j);
+        assert(f);
+
+        r = next_beyond_location(j, f, direction);
+        if (r < 0) {
+                log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
+                remove_file_real(j, f);
+                return 0;
+        }
+        if (r == 0) {
+                f->location_type = LOCATION_TAIL;
+                return 0;
+        }
+
+        r = prioq_put(j->files_by_location, f, &f->location_prioq_idx);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+static int files_by_location_rebuild(sd_journal *j, direction_t direction) {
         unsigned i, n_files;
         const void **files;
-        Object *o;
         int r;
 
-        assert_return(j, -EINVAL);
-        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert(j);
+
+        /* Drop whatever is left from a previous iteration, and redo the full O(n) scan over all files,
+         * entering every file that has a candidate entry into the prioq. */
+
+        files_by_location_clear(j);
+
+        j->files_by_location = prioq_new(direction == DIRECTION_DOWN ? compare_files_by_location_down
+                                                                     : compare_files_by_location_up);
+        if (!j->files_by_location)
+                return -ENOMEM;
+
+        j->files_by_location_direction = direction;
 
         r = iterated_cache_get(j->files_cache, NULL, &files, &n_files);
         if (r < 0)
-                return r;
+                goto fail;
 
         for (i = 0; i < n_files; i++) {
-                JournalFile *f = (JournalFile *)files[i];
-                bool found;
+                r = files_by_location_put(j, (JournalFile*) files[i], direction);
+                if (r < 0)
+                        goto fail;
+        }
+
+        /* Files might have been removed above, take the counter only now */
+        j->files_by_location_invalidate_counter = j->current_invalidate_counter;
+        return 0;
+
+fail:
+        files_by_location_clear(j);
+        return r;
+}
+
+static int files_by_location_advance(sd_journal *j, direction_t direction) {
+        unsigned i, n_files;
+        const void **files;
+        JournalFile *f;
+        int r;
+
+        assert(j);
+
+        /* The files are ordered by their candidate entry, hence only the files at the top of the prioq
+         * can refer to the entry we are currently looking at (or an identical one from another file).
+         * Advance those until the top of the prioq is beyond the current location. Note that the file
+         * at the top was picked last time and is hence not in LOCATION_SEEK state anymore, which means
+         * it must be handled before anything else is compared with it. */
+        while ((f = prioq_peek(j->files_by_location))) {
+                uint64_t offset = f->current_offset;
+                LocationType type = f->location_type;
 
                 r = next_beyond_location(j, f, direction);
-                if (r < 0) {
-                        log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
-                        remove_file_real(j, f);
-                        continue;
-                } else if (r == 0) {
-                        f->location_type = LOCATION_TAIL;
+                if (r <= 0) {
+                        assert_se(prioq_remove(j->files_by_location, f, &f->location_prioq_idx) > 0);
+                        f->location_prioq_idx = PRIOQ_IDX_NULL;
+
+                        if (r < 0) {
+                                log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
+                                remove_file_real(j, f);
+                        } else
+                                f->location_type = LOCATION_TAIL;
+
                         continue;
                 }
 
-                if (!new_file)
-                        found = true;
-                else {
-                        int k;
+                if (type == LOCATION_SEEK && f->current_offset == offset)
+                        break;
 
-                        k = journal_file_compare_locations(f, new_file);
+                assert_se(prioq_reshuffle(j->files_by_location, f, &f->location_prioq_idx) > 0);
+        }
 
-                        found = direction == DIRECTION_DOWN ? k < 0 : k > 0;
-                }
+        /* Files that hit EOF earlier will only have a candidate again if new entries got appended to
+         * them. next_beyond_location() checks that cheaply by looking at the number of entries. */
+        r = iterated_cache_get(j->files_cache, NULL, &files, &n_files);
+        if (r < 0)
+                return r;
 
-                if (found)
-                        new_file = f;
+        for (i = 0; i < n_files; i++) {
+                f = (JournalFile*) files[i];
+
+                if (f->location_type != LOCATION_TAIL)
+                        continue;
+
+                r = files_by_location_put(j, f, direction);
+                if (r < 0)
+                        goto fail;
         }
 
+        return 0;
+
+fail:
+        files_by_location_clear(j);
+        return r;
+}
+
+static int real_journal_next(sd_journal *j, direction_t direction) {
+        JournalFile *new_file;
+        Object *o;
+        int r;
+
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+
+        if (!j->files_by_location ||
+            j->files_by_location_direction != direction ||
+            j->files_by_location_invalidate_counter != j->current_invalidate_counter)
+                r = files_by_location_rebuild(j, direction);
+        else
+                r = files_by_location_advance(j, direction);
+        if (r < 0)
+                return r;
+
+        new_file = prioq_peek(j->files_by_location);
         if (!new_file)
                 return 0;
 
@@ -1425,8 +1552,16 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
 
         (void) ordered_hashmap_remove(j->files, f->path);
 
+        /* The prioq is rebuilt on the next iteration step anyway, since the invalidation counter is bumped
+         * below. Don't try to remove the file from it individually, the other entries might not be in a
+         * comparable state right now. */
+        if (f->location_prioq_idx != PRIOQ_IDX_NULL)
+                files_by_location_clear(j);
+
         log_debug("File %s removed.", f->path);
 
+        data_cache_flush(j, f);
+
         if (j->current_file == f) {
                 j->current_file = NULL;
                 j->current_field = 0;
@@ -1436,6 +1571,7 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
                 /* Jump to the next unique_file or NULL if that one was last */
                 j->unique_file = ordered_hashmap_next(j->files, j->unique_file->path);
                 j->unique_offset = 0;
+                j->unique_index_offset = 0;
                 if (!j->unique_file)
                         j->unique_file_lost = true;
         }
@@ -1481,6 +1617,19 @@ static int dirname_is_machine_id(const char *fn) {
         return sd_id128_equal(id, machine);
 }
 
+static bool namespace_matches(const char *n, const char *namespace) {
+        _cleanup_free_ char *base = NULL;
+
+        if (streq(n, namespace))
+                return true;
+
+        /* The shards of a namespace are read along with it */
+        if (log_namespace_shard_from_string(n, &base, NULL) < 0)
+                return false;
+
+        return streq(base, namespace);
+}
+
 static int dirname_has_namespace(const char *fn, const char *namespace) {
         const char *e;
 
@@ -1493,7 +1642,7 @@ static int dirname_has_namespace(const char *fn, const char *namespace) {
                 if (!namespace)
                         return false;
 
-                if (!streq(e + 1, namespace))
+                if (!namespace_matches(e + 1, namespace))
                         return false;
 
                 k = strndupa(fn, e - fn);
@@ -1889,6 +2038,7 @@ static int allocate_inotify(sd_journal *j) {
 
 static sd_journal *journal_new(int flags, const char *path, const char *namespace) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        int r;
 
         j = new0(sd_journal, 1);
         if (!j)
@@ -1899,6 +2049,7 @@ static sd_journal *journal_new(int flags, const char *path, const char *namespac
         j->inotify_fd = -1;
         j->flags = flags;
         j->data_threshold = DEFAULT_DATA_THRESHOLD;
+        j->data_cache_size_max = DEFAULT_DATA_CACHE_SIZE;
 
         if (path) {
                 char *t;
@@ -1929,6 +2080,13 @@ static sd_journal *journal_new(int flags, const char *path, const char *namespac
         if (!j->files_cache || !j->directories_by_path || !j->mmap)
                 return NULL;
 
+        /* Read ahead of sequential iteration by default, but allow turning that off, for example where
+         * page cache is scarce */
+        r = getenv_bool("SYSTEMD_JOURNAL_READAHEAD");
+        if (r < 0 && r != -ENXIO)
+                log_debug_errno(r, "Failed to parse $SYSTEMD_JOURNAL_READAHEAD environment variable, ignoring.");
+        mmap_cache_set_readahead(j->mmap, r != 0);
+
         return TAKE_PTR(j);
 }
 
@@ -2154,6 +2312,7 @@ _public_ void sd_journal_close(sd_journal *j) {
 
         ordered_hashmap_free_with_destructor(j->files, journal_file_close);
         iterated_cache_free(j->files_cache);
+        prioq_free(j->files_by_location);
 
         while ((d = hashmap_first(j->directories_by_path)))
                 remove_directory(j, d);
@@ -2171,6 +2330,11 @@ _public_ void sd_journal_close(sd_journal *j) {
                 mmap_cache_unref(j->mmap);
         }
 
+        log_debug("Data cache: hit=%u miss=%u size=%zu",
+                  j->n_data_cache_hit, j->n_data_cache_missed, j->data_cache_size);
+        data_cache_flush(j, NULL);
+        hashmap_free(j->data_cache);
+
         hashmap_free_free(j->errors);
 
         free(j->path);
@@ -2271,6 +2435,178 @@ static bool field_is_valid(const char *field) {
         return true;
 }
 
+static void data_cache_entry_hash_func(const DataCacheEntry *e, struct siphash *state) {
+        assert(e);
+
+        siphash24_compress(&e->file, sizeof(e->file), state);
+        siphash24_compress(&e->offset, sizeof(e->offset), state);
+}
+
+static int data_cache_entry_compare_func(const DataCacheEntry *a, const DataCacheEntry *b) {
+        int r;
+
+        r = CMP(a->file, b->file);
+        if (r != 0)
+                return r;
+
+        return CMP(a->offset, b->offset);
+}
+
+DEFINE_PRIVATE_HASH_OPS(data_cache_hash_ops, DataCacheEntry, data_cache_entry_hash_func, data_cache_entry_compare_func);
+
+static void data_cache_remove(sd_journal *j, DataCacheEntry *e) {
+        assert(j);
+        assert(e);
+
+        assert_se(hashmap_remove(j->data_cache, e) == e);
+
+        if (j->data_cache_lru_tail == e)
+                j->data_cache_lru_tail = e->lru_prev;
+        LIST_REMOVE(lru, j->data_cache_lru, e);
+
+        assert(j->data_cache_size >= e->size);
+        j->data_cache_size -= e->size;
+
+        free(e);
+}
+
+static void data_cache_trim(sd_journal *j, size_t size) {
+        assert(j);
+
+        /* Evicts the least recently used entries until there's room for 'size' more bytes */
+        while (j->data_cache_lru_tail && j->data_cache_size + size > j->data_cache_size_max)
+                data_cache_remove(j, j->data_cache_lru_tail);
+}
+
+static void data_cache_flush(sd_journal *j, JournalFile *f) {
+        DataCacheEntry *e, *n;
+
+        assert(j);
+
+        /* Drops all entries referring to the specified file, or all entries if f is NULL */
+        LIST_FOREACH_SAFE(lru, e, n, j->data_cache_lru)
+                if (!f || e->file == f)
+                        data_cache_remove(j, e);
+}
+
+#if HAVE_COMPRESSION
+static DataCacheEntry* data_cache_get(sd_journal *j, JournalFile *f, uint64_t offset) {
+        DataCacheEntry key = {
+                .file = f,
+                .offset = offset,
+        }, *e;
+
+        assert(j);
+
+        e = hashmap_get(j->data_cache, &key);
+        if (!e)
+                return NULL;
+
+        j->n_data_cache_hit++;
+
+        if (e != j->data_cache_lru) {
+                if (j->data_cache_lru_tail == e)
+                        j->data_cache_lru_tail = e->lru_prev;
+                LIST_REMOVE(lru, j->data_cache_lru, e);
+                LIST_PREPEND(lru, j->data_cache_lru, e);
+        }
+
+        return e;
+}
+
+static int data_cache_put(
+                sd_journal *j,
+                JournalFile *f,
+                uint64_t offset,
+                const void *data,
+                size_t size,
+                DataCacheEntry **ret) {
+
+        DataCacheEntry *e;
+        int r;
+
+        assert(j);
+        assert(f);
+        assert(data || size == 0);
+        assert(ret);
+
+        /* Objects that would take up a major part of the cache would only push out a lot of others, don't
+         * bother with them. */
+        if (size == 0 || size > j->data_cache_size_max / 4)
+                return 0;
+
+        data_cache_trim(j, size);
+
+        e = malloc(offsetof(DataCacheEntry, payload) + size);
+        if (!e)
+                return -ENOMEM;
+
+        *e = (DataCacheEntry) {
+                .file = f,
+                .offset = offset,
+                .size = size,
+        };
+        memcpy(e->payload, data, size);
+
+        r = hashmap_ensure_put(&j->data_cache, &data_cache_hash_ops, e, e);
+        if (r < 0) {
+                free(e);
+                return r;
+        }
+
+        LIST_PREPEND(lru, j->data_cache_lru, e);
+        if (!j->data_cache_lru_tail)
+                j->data_cache_lru_tail = e;
+        j->data_cache_size += size;
+
+        *ret = e;
+        return 1;
+}
+
+static int decompress_data(
+                sd_journal *j,
+                JournalFile *f,
+                Object *o,
+                uint64_t offset,
+                uint64_t l,
+                int compression,
+                const void **ret_data,
+                size_t *ret_size) {
+
+        DataCacheEntry *e;
+        size_t rsize;
+        int r;
+
+        assert(j);
+        assert(f);
+        assert(o);
+
+        r = decompress_blob_full(
+                        compression,
+                        f->compress_dictionary,
+                        o->data.payload, l,
+                        &f->compress_buffer, &rsize,
+                        j->data_threshold);
+        if (r < 0)
+                return r;
+
+        j->n_data_cache_missed++;
+
+        r = data_cache_put(j, f, offset, f->compress_buffer, rsize, &e);
+        if (r < 0)
+                log_debug_errno(r, "Failed to cache decompressed data object at offset "OFSfmt", ignoring: %m", offset);
+        if (r > 0) {
+                if (ret_data)
+                        *ret_data = e->payload;
+        } else if (ret_data)
+                *ret_data = f->compress_buffer;
+        if (ret_size)
+                *ret_size = rsize;
+
+        return 0;
+}
+#endif
+
 _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **data, size_t *size) {
         JournalFile *f;
         uint64_t i, n;
@@ -2319,28 +2655,29 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
                 compression = o->object.flags & OBJECT_COMPRESSION_MASK;
                 if (compression) {
 #if HAVE_COMPRESSION
-                        r = decompress_startswith(compression,
-                                                  o->data.payload, l,
-                                                  &f->compress_buffer,
-                                                  field, field_length, '=');
-                        if (r < 0)
-                                log_debug_errno(r, "Cannot decompress %s object of length %"PRIu64" at offset "OFSfmt": %m",
-                                                object_compressed_to_string(compression), l, p);
-                        else if (r > 0) {
+                        DataCacheEntry *e;
 
-                                size_t rsize;
+                        e = data_cache_get(j, f, p);
+                        if (e) {
+                                if (e->size >= field_length+1 &&
+                                    memcmp(e->payload, field, field_length) == 0 &&
+                                    e->payload[field_length] == '=') {
 
-                                r = decompress_blob(compression,
-                                                    o->data.payload, l,
-                                                    &f->compress_buffer, &rsize,
-                                                    j->data_threshold);
-                                if (r < 0)
-                                        return r;
-
-                                *data = f->compress_buffer;
-                                *size = (size_t) rsize;
+                                        *data = e->payload;
+                                        *size = e->size;
 
-                                return 0;
+                                        return 0;
+                                }
+                        } else {
+                                r = decompress_startswith_full(compression, f->compress_dictionary,
+                                                               o->data.payload, l,
+                                                               &f->compress_buffer,
+                                                               field, field_length, '=');
+                                if (r < 0)
+                                        log_debug_errno(r, "Cannot decompress %s object of length %"PRIu64" at offset "OFSfmt": %m",
+                                                        object_compressed_to_string(compression), l, p);
+                                else if (r > 0)
+                                        return decompress_data(j, f, o, p, l, compression, data, size);
                         }
 #else
                         return -EPROTONOSUPPORT;
@@ -2372,6 +2709,7 @@ static int return_data(
                 sd_journal *j,
                 JournalFile *f,
                 Object *o,
+                uint64_t offset,
                 const void **ret_data,
                 size_t *ret_size) {
 
@@ -2395,21 +2733,16 @@ static int return_data(
         compression = o->object.flags & OBJECT_COMPRESSION_MASK;
         if (compression) {
 #if HAVE_COMPRESSION
-                size_t rsize;
-                int r;
+                DataCacheEntry *e;
 
-                r = decompress_blob(
-                                compression,
-                                o->data.payload, l,
-                                &f->compress_buffer, &rsize,
-                                j->data_threshold);
-                if (r < 0)
-                        return r;
+                e = data_cache_get(j, f, offset);
+                if (!e)
+                        return decompress_data(j, f, o, offset, l, compression, ret_data, ret_size);
 
                 if (ret_data)
-                        *ret_data = f->compress_buffer;
+                        *ret_data = e->payload;
                 if (ret_size)
-                        *ret_size = (size_t) rsize;
+                        *ret_size = e->size;
 #else
                 return -EPROTONOSUPPORT;
 #endif
@@ -2459,7 +2792,7 @@ _public_ int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t
         if (le_hash != o->data.hash)
                 return -EBADMSG;
 
-        r = return_data(j, f, o, data, size);
+        r = return_data(j, f, o, p, data, size);
         if (r < 0)
                 return r;
 
@@ -2628,6 +2961,14 @@ static void process_inotify_event(sd_journal *j, const struct inotify_event *e)
 
                         /* Event for a journal file */
 
+                        if ((e->mask & (IN_CREATE|IN_MOVED_TO|IN_MODIFY|IN_ATTRIB)) == IN_MODIFY &&
+                            ordered_hashmap_contains(j->files, prefix_roota(d->path, e->name)))
+                                /* The file is written to, which happens all the time for the active journal
+                                 * files. If we already track it there's nothing to do: if it got replaced we'd
+                                 * have seen IN_CREATE or IN_MOVED_TO for it, hence don't bother reopening and
+                                 * stat()ing it only to find out it's the same file. */
+                                return;
+
                         if (e->mask & (IN_CREATE|IN_MOVED_TO|IN_MODIFY|IN_ATTRIB))
                                 (void) add_file_by_name(j, d->path, e->name);
                         else if (e->mask & (IN_DELETE|IN_MOVED_FROM|IN_UNMOUNT))
@@ -2899,11 +3240,96 @@ _public_ int sd_journal_query_unique(sd_journal *j, const char *field) {
 
         j->unique_file = NULL;
         j->unique_offset = 0;
+        j->unique_index_offset = 0;
         j->unique_file_lost = false;
 
         return 0;
 }
 
+static int unique_data_in_file(
+                sd_journal *j,
+                JournalFile *of,
+                size_t field_length,
+                const void *data,
+                size_t size,
+                Object *o) {
+
+        uint64_t p, q;
+        Object *fo;
+        int r;
+
+        assert(j);
+        assert(of);
+
+        /* Skip this file it didn't have any fields indexed */
+        if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
+                return 0;
+
+        /* If the file has a field index for this field, search that, it's compact and sorted. */
+        if (JOURNAL_HEADER_FIELD_INDEX(of->header)) {
+                r = journal_file_find_field_object(of, j->unique_field, field_length, &fo, &p);
+                if (r <= 0)
+                        return r;
+
+                r = journal_file_find_field_index(of, p, &q);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        return journal_file_field_index_contains(of, q, data, size);
+        }
+
+        /* We can reuse the hash from our current file only on old-style journal files without keyed
+         * hashes. On new-style files we have to calculate the hash anew, to take the per-file hash seed
+         * into consideration. */
+        if (o && !JOURNAL_HEADER_KEYED_HASH(j->unique_file->header) && !JOURNAL_HEADER_KEYED_HASH(of->header))
+                return journal_file_find_data_object_with_hash(of, data, size, le64toh(o->data.hash), NULL, NULL);
+
+        return journal_file_find_data_object(of, data, size, NULL, NULL);
+}
+
+static int unique_get_data(
+                sd_journal *j,
+                Object **ret_object,
+                const void **ret_data,
+                size_t *ret_size) {
+
+        Object *o;
+        int r;
+
+        assert(j);
+        assert(j->unique_file);
+        assert(j->unique_offset > 0);
+
+        if (j->unique_index_offset > 0) {
+                *ret_object = NULL;
+
+                /* Returns 0 if we reached the end of the index */
+                return journal_file_field_index_get(j->unique_file, j->unique_index_offset, j->unique_index_item, ret_data, ret_size);
+        }
+
+        /* We do not use OBJECT_DATA context here, but OBJECT_UNUSED
+         * instead, so that we can look at this data object at the same
+         * time as one on another file */
+        r = journal_file_move_to_object(j->unique_file, OBJECT_UNUSED, j->unique_offset, &o);
+        if (r < 0)
+                return r;
+
+        /* Let's do the type check by hand, since we used 0 context above. */
+        if (o->object.type != OBJECT_DATA)
+                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "%s:offset " OFSfmt ": object has type %d, expected %d",
+                                       j->unique_file->path,
+                                       j->unique_offset,
+                                       o->object.type, OBJECT_DATA);
+
+        r = return_data(j, j->unique_file, o, j->unique_offset, ret_data, ret_size);
+        if (r < 0)
+                return r;
+
+        *ret_object = o;
+        return 1;
+}
+
 _public_ int sd_journal_enumerate_unique(
                 sd_journal *j,
                 const void **ret_data,
@@ -2926,6 +3352,7 @@ _public_ int sd_journal_enumerate_unique(
                         return 0;
 
                 j->unique_offset = 0;
+                j->unique_index_offset = 0;
         }
 
         for (;;) {
@@ -2936,14 +3363,27 @@ _public_ int sd_journal_enumerate_unique(
                 bool found;
                 int r;
 
-                /* Proceed to next data object in the field's linked list */
+                /* Proceed to next data object in the field's linked list, or the next item in the
+                 * field's index */
                 if (j->unique_offset == 0) {
-                        r = journal_file_find_field_object(j->unique_file, j->unique_field, k, &o, NULL);
+                        uint64_t p;
+
+                        r = journal_file_find_field_object(j->unique_file, j->unique_field, k, &o, &p);
                         if (r < 0)
                                 return r;
 
                         j->unique_offset = r > 0 ? le64toh(o->field.head_data_offset) : 0;
-                } else {
+                        j->unique_index_offset = 0;
+                        j->unique_index_item = 0;
+
+                        if (j->unique_offset > 0) {
+                                r = journal_file_find_field_index(j->unique_file, p, &j->unique_index_offset);
+                                if (r < 0)
+                                        return r;
+                        }
+                } else if (j->unique_index_offset > 0)
+                        j->unique_index_item++;
+                else {
                         r = journal_file_move_to_object(j->unique_file, OBJECT_DATA, j->unique_offset, &o);
                         if (r < 0)
                                 return r;
@@ -2951,8 +3391,17 @@ _public_ int sd_journal_enumerate_unique(
                         j->unique_offset = le64toh(o->data.next_field_offset);
                 }
 
+                if (j->unique_offset > 0) {
+                        r = unique_get_data(j, &o, &odata, &ol);
+                        if (r < 0)
+                                return r;
+                        if (r == 0)
+                                j->unique_offset = 0;
+                }
+
                 /* We reached the end of the list? Then start again, with the next file */
                 if (j->unique_offset == 0) {
+                        j->unique_index_offset = 0;
                         j->unique_file = ordered_hashmap_next(j->files, j->unique_file->path);
                         if (!j->unique_file)
                                 return 0;
@@ -2960,25 +3409,6 @@ _public_ int sd_journal_enumerate_unique(
                         continue;
                 }
 
-                /* We do not use OBJECT_DATA context here, but OBJECT_UNUSED
-                 * instead, so that we can look at this data object at the same
-                 * time as one on another file */
-                r = journal_file_move_to_object(j->unique_file, OBJECT_UNUSED, j->unique_offset, &o);
-                if (r < 0)
-                        return r;
-
-                /* Let's do the type check by hand, since we used 0 context above. */
-                if (o->object.type != OBJECT_DATA)
-                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
-                                               "%s:offset " OFSfmt ": object has type %d, expected %d",
-                                               j->unique_file->path,
-                                               j->unique_offset,
-                                               o->object.type, OBJECT_DATA);
-
-                r = return_data(j, j->unique_file, o, &odata, &ol);
-                if (r < 0)
-                        return r;
-
                 /* Check if we have at least the field name and "=". */
                 if (ol <= k)
                         return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
@@ -3000,17 +3430,7 @@ _public_ int sd_journal_enumerate_unique(
                         if (of == j->unique_file)
                                 break;
 
-                        /* Skip this file it didn't have any fields indexed */
-                        if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
-                                continue;
-
-                        /* We can reuse the hash from our current file only on old-style journal files
-                         * without keyed hashes. On new-style files we have to calculate the hash anew, to
-                         * take the per-file hash seed into consideration. */
-                        if (!JOURNAL_HEADER_KEYED_HASH(j->unique_file->header) && !JOURNAL_HEADER_KEYED_HASH(of->header))
-                                r = journal_file_find_data_object_with_hash(of, odata, ol, le64toh(o->data.hash), NULL, NULL);
-                        else
-                                r = journal_file_find_data_object(of, odata, ol, NULL, NULL);
+                        r = unique_data_in_file(j, of, k, odata, ol, o);
                         if (r < 0)
                                 return r;
                         if (r > 0) {
@@ -3022,9 +3442,11 @@ _public_ int sd_journal_enumerate_unique(
                 if (found)
                         continue;
 
-                r = return_data(j, j->unique_file, o, ret_data, ret_size);
+                r = unique_get_data(j, &o, ret_data, ret_size);
                 if (r < 0)
                         return r;
+                if (r == 0)
+                        return -EBADMSG;
 
                 return 1;
         }
@@ -3050,6 +3472,7 @@ _public_ void sd_journal_restart_unique(sd_journal *j) {
 
         j->unique_file = NULL;
         j->unique_offset = 0;
+        j->unique_index_offset = 0;
         j->unique_file_lost = false;
 }
 
@@ -3273,6 +3696,11 @@ _public_ int sd_journal_set_data_threshold(sd_journal *j, size_t sz) {
         assert_return(j, -EINVAL);
         assert_return(!journal_pid_changed(j), -ECHILD);
 
+        /* Cached objects were decompressed with the old threshold in effect, hence might be truncated
+         * differently. */
+        if (sz != j->data_threshold)
+                data_cache_flush(j, NULL);
+
         j->data_threshold = sz;
         return 0;
 }
@@ -3286,6 +3714,24 @@ _public_ int sd_journal_get_data_threshold(sd_journal *j, size_t *sz) {
         return 0;
 }
 
+_public_ int sd_journal_set_data_cache_size(sd_journal *j, size_t sz) {
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+
+        j->data_cache_size_max = sz;
+        data_cache_trim(j, 0);
+        return 0;
+}
+
+_public_ int sd_journal_get_data_cache_size(sd_journal *j, size_t *sz) {
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert_return(sz, -EINVAL);
+
+        *sz = j->data_cache_size_max;
+        return 0;
+}
+
 _public_ int sd_journal_has_runtime_files(sd_journal *j) {
         assert_return(j, -EINVAL);
 
@@ -0,0 +1,293 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "chattr-util.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "log.h"
+#include "parse-util.h"
+#include "rm-rf.h"
+#include "stat-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Appends synthetic or replayed entries to a fresh journal file through journal_file_append_entry(), and
+ * reports the throughput, file space used per entry, page faults and fsync() latency, for each combination
+ * of workload, compression and sealing.
+ *
+ * Usage: test-journal-append-benchmark [SECONDS [JOURNAL-FILE|JOURNAL-DIRECTORY]]
+ *
+ * If a journal file or directory is specified its entries are loaded into memory first and replayed
+ * instead of the synthetic workloads, in order to benchmark with a captured workload. */
+
+#define SYNC_INTERVAL 1000U
+#define REPLAY_ENTRIES_MAX 100000U
+#define N_FIELDS_MAX 32U
+
+typedef struct Entry {
+        struct iovec iovec[N_FIELDS_MAX];
+        size_t n_iovec;
+} Entry;
+
+typedef struct Workload {
+        const char *name;
+        size_t message_size;
+        bool high_cardinality;
+} Workload;
+
+static const Workload workloads[] = {
+        { "small/low-cardinality",  64,       false },
+        { "small/high-cardinality", 64,       true  },
+        { "large/low-cardinality",  4 * 1024, false },
+        { "large/high-cardinality", 4 * 1024, true  },
+};
+
+static usec_t arg_duration;
+static const char *arg_replay = NULL;
+
+static Entry *replay_entries = NULL;
+static size_t n_replay_entries = 0;
+
+static void entry_done(Entry *e) {
+        for (size_t i = 0; i < e->n_iovec; i++)
+                free(e->iovec[i].iov_base);
+        e->n_iovec = 0;
+}
+
+static void entry_add(Entry *e, const char *field) {
+        char *s;
+
+        assert_se(e->n_iovec < N_FIELDS_MAX);
+
+        s = strdup(field);
+        assert_se(s);
+        e->iovec[e->n_iovec++] = IOVEC_MAKE_STRING(s);
+}
+
+static void entry_addf(Entry *e, const char *format, ...) _printf_(2, 3);
+static void entry_addf(Entry *e, const char *format, ...) {
+        va_list ap;
+        char *s;
+
+        assert_se(e->n_iovec < N_FIELDS_MAX);
+
+        va_start(ap, format);
+        assert_se(vasprintf(&s, format, ap) >= 0);
+        va_end(ap);
+
+        e->iovec[e->n_iovec++] = IOVEC_MAKE_STRING(s);
+}
+
+static void make_entry(const Workload *w, uint64_t i, Entry *ret) {
+        _cleanup_free_ char *message = NULL;
+        uint64_t k;
+        int l;
+
+        /* With low cardinality the entries are made of a small set of distinct field values, which are
+         * hence deduplicated in the file. With high cardinality most values are unique. */
+        k = w->high_cardinality ? i : i % 16;
+
+        l = asprintf(&message, "MESSAGE=Benchmark message %" PRIu64 " ", k);
+        assert_se(l >= 0);
+        if ((size_t) l < w->message_size) {
+                assert_se(message = realloc(message, w->message_size + 1));
+                for (size_t j = l; j < w->message_size; j++)
+                        message[j] = 'a' + (j + k) % ('z' - 'a' + 1);
+                message[w->message_size] = 0;
+        }
+
+        entry_add(ret, message);
+        entry_addf(ret, "PRIORITY=%" PRIu64, i % 8);
+        entry_add(ret, "SYSLOG_FACILITY=3");
+        entry_add(ret, "SYSLOG_IDENTIFIER=benchmark");
+        entry_addf(ret, "CODE_LINE=%" PRIu64, k % 1024);
+        entry_addf(ret, "_PID=%" PRIu64, 1000 + (w->high_cardinality ? i / 64 : k % 4));
+        entry_addf(ret, "_SYSTEMD_UNIT=benchmark-%" PRIu64 ".service", w->high_cardinality ? i / 64 : k % 4);
+        entry_add(ret, "_UID=0");
+        entry_add(ret, "_TRANSPORT=journal");
+}
+
+static void load_replay_entries(void) {
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        const void *data;
+        size_t size;
+        int r;
+
+        if (is_dir(arg_replay, true) > 0)
+                r = sd_journal_open_directory(&j, arg_replay, 0);
+        else
+                r = sd_journal_open_files(&j, (const char*[]) { arg_replay, NULL }, 0);
+        assert_se(r >= 0);
+
+        SD_JOURNAL_FOREACH(j) {
+                Entry *e;
+
+                if (n_replay_entries >= REPLAY_ENTRIES_MAX)
+                        break;
+
+                assert_se(GREEDY_REALLOC(replay_entries, n_replay_entries + 1));
+                e = replay_entries + n_replay_entries++;
+                *e = (Entry) {};
+
+                SD_JOURNAL_FOREACH_DATA(j, data, size) {
+                        void *d;
+
+                        if (e->n_iovec >= N_FIELDS_MAX)
+                                break;
+
+                        d = memdup(data, size);
+                        assert_se(d);
+                        e->iovec[e->n_iovec++] = IOVEC_MAKE(d, size);
+                }
+        }
+
+        log_info("Loaded %zu entries from %s.", n_replay_entries, arg_replay);
+}
+
+static uint64_t journal_file_used_bytes(JournalFile *f) {
+        uint64_t p;
+        Object *o;
+
+        p = le64toh(f->header->tail_object_offset);
+        if (p == 0)
+                return le64toh(f->header->header_size);
+
+        assert_se(journal_file_move_to_object(f, OBJECT_UNUSED, p, &o) >= 0);
+        return p + ALIGN64(le64toh(o->object.size));
+}
+
+static uint64_t page_faults(void) {
+        struct rusage ru;
+
+        assert_se(getrusage(RUSAGE_SELF, &ru) >= 0);
+        return ru.ru_minflt + ru.ru_majflt;
+}
+
+static void sync_file(JournalFile *f, usec_t *total, usec_t *max) {
+        usec_t start, d;
+
+        start = now(CLOCK_MONOTONIC);
+        assert_se(fsync(f->fd) >= 0);
+        d = now(CLOCK_MONOTONIC) - start;
+
+        *total += d;
+        *max = MAX(*max, d);
+}
+
+static void run_benchmark(const char *label, const Workload *w, bool compress, bool seal) {
+        _cleanup_(journal_file_closep) JournalFile *f = NULL;
+        usec_t start, end, sync_total = 0, sync_max = 0;
+        uint64_t n = 0, n_sync = 0, input = 0, faults;
+        char t[] = "/var/tmp/journal-append-benchmark-XXXXXX";
+        dual_timestamp ts;
+        bool effective_seal;
+        const char *fn;
+
+        assert_se(mkdtemp(t));
+        (void) chattr_path(t, FS_NOCOW_FL, FS_NOCOW_FL, NULL);
+        fn = strjoina(t, "/test.journal");
+
+        assert_se(journal_file_open(-1, fn, O_RDWR|O_CREAT, 0644, compress, UINT64_MAX, seal, NULL, NULL, NULL, NULL, &f) == 0);
+        /* Sealing silently turns itself off if no sealing key is installed, report what was actually used */
+        effective_seal = f->seal;
+
+        faults = page_faults();
+        start = now(CLOCK_MONOTONIC);
+
+        for (;;) {
+                Entry synthetic = {}, *e;
+
+                if (w) {
+                        make_entry(w, n, &synthetic);
+                        e = &synthetic;
+                } else {
+                        if (n >= n_replay_entries)
+                                break;
+                        e = replay_entries + n;
+                }
+
+                dual_timestamp_get(&ts);
+                assert_se(journal_file_append_entry(f, &ts, NULL, e->iovec, e->n_iovec, NULL, NULL, NULL) == 0);
+
+                for (size_t i = 0; i < e->n_iovec; i++)
+                        input += e->iovec[i].iov_len;
+                entry_done(&synthetic);
+                n++;
+
+                if (n % SYNC_INTERVAL == 0) {
+                        sync_file(f, &sync_total, &sync_max);
+                        n_sync++;
+
+                        if (w && now(CLOCK_MONOTONIC) - start > arg_duration)
+                                break;
+                }
+        }
+
+        if (n % SYNC_INTERVAL != 0) {
+                sync_file(f, &sync_total, &sync_max);
+                n_sync++;
+        }
+
+        end = now(CLOCK_MONOTONIC);
+        faults = page_faults() - faults;
+
+        log_info("%s compress=%s seal=%s: %" PRIu64 " entries in %.2fs (%.0f entries/s), "
+                 "%.1f input bytes/entry, %.1f file bytes/entry, %.2f page faults/entry, "
+                 "fsync avg %s max %s",
+                 label, yes_no(compress), yes_no(effective_seal),
+                 n, (end - start) / 1e6, n * 1e6 / MAX(end - start, 1ULL),
+                 (double) input / MAX(n, 1ULL),
+                 (double) journal_file_used_bytes(f) / MAX(n, 1ULL),
+                 (double) faults / MAX(n, 1ULL),
+                 FORMAT_TIMESPAN(sync_total / MAX(n_sync, 1ULL), 1),
+                 FORMAT_TIMESPAN(sync_max, 1));
+
+        f = journal_file_close(f);
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
+static void run_all(const char *label, const Workload *w) {
+        for (int compress = 0; compress <= 1; compress++) {
+                run_benchmark(label, w, compress, false);
+#if HAVE_GCRYPT
+                run_benchmark(label, w, compress, true);
+#endif
+        }
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        if (argc >= 2) {
+                unsigned x;
+
+                assert_se(safe_atou(argv[1], &x) >= 0);
+                arg_duration = x * USEC_PER_SEC;
+        } else
+                arg_duration = slow_tests_enabled() ?
+                        2 * USEC_PER_SEC : USEC_PER_SEC / 50;
+
+        if (argc >= 3)
+                arg_replay = argv[2];
+
+        if (arg_replay) {
+                load_replay_entries();
+                run_all(arg_replay, NULL);
+
+                for (size_t i = 0; i < n_replay_entries; i++)
+                        entry_done(replay_entries + i);
+                free(replay_entries);
+        } else
+                for (size_t i = 0; i < ELEMENTSOF(workloads); i++)
+                        run_all(workloads[i].name, workloads + i);
+
+        return 0;
+}
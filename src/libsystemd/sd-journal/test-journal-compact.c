@@ -0,0 +1,118 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "chattr-util.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "journal-internal.h"
+#include "journal-vacuum.h"
+#include "macro.h"
+#include "memory-util.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+#define N_ENTRIES 1000
+
+static void append_entries(JournalFile *f) {
+        for (unsigned i = 0; i < N_ENTRIES; i++) {
+                _cleanup_free_ char *message = NULL, *priority = NULL;
+                struct iovec iovec[3];
+                dual_timestamp ts;
+
+                dual_timestamp_get(&ts);
+
+                assert_se(asprintf(&message, "MESSAGE=message %u", i) >= 0);
+                /* Every tenth entry is an error, the rest is debug noise */
+                assert_se(asprintf(&priority, "PRIORITY=%i", i % 10 == 0 ? LOG_ERR : LOG_DEBUG) >= 0);
+
+                iovec[0] = IOVEC_MAKE_STRING(message);
+                iovec[1] = IOVEC_MAKE_STRING(priority);
+                iovec[2] = IOVEC_MAKE_STRING("SYSLOG_IDENTIFIER=test-journal-compact");
+
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL) >= 0);
+        }
+}
+
+static void test_compact(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *dn = NULL;
+        _cleanup_free_ char *fn = NULL;
+        sd_id128_t seqnum_id;
+        JournalFile *f = NULL;
+        sd_journal *j = NULL;
+        unsigned n = 0;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(mkdtemp_malloc("/var/tmp/test-journal-compact-XXXXXX", &dn) >= 0);
+        (void) chattr_path(dn, FS_NOCOW_FL, FS_NOCOW_FL, NULL);
+
+        fn = path_join(dn, "test.journal");
+        assert_se(fn);
+
+        assert_se(journal_file_open(-1, fn, O_CREAT|O_RDWR, 0644, true, 0, false, NULL, NULL, NULL, NULL, &f) >= 0);
+        append_entries(f);
+        seqnum_id = f->header->seqnum_id;
+
+        /* Compaction refuses files that are still in use */
+        assert_se(sd_journal_open_files(&j, (const char**) STRV_MAKE(fn), 0) >= 0);
+        assert_se(journal_compact_file(j, true) == -EBUSY);
+        sd_journal_close(j);
+
+        f->archive = true;
+        f = journal_file_close(f);
+
+        assert_se(sd_journal_open_files(&j, (const char**) STRV_MAKE(fn), 0) >= 0);
+        assert_se(sd_journal_add_match(j, "PRIORITY=3", 0) >= 0);
+        assert_se(journal_compact_file(j, true) > 0);
+        sd_journal_close(j);
+
+        assert_se(journal_file_open(-1, fn, O_RDONLY, 0, false, 0, false, NULL, NULL, NULL, NULL, &f) >= 0);
+        assert_se(f->header->state == STATE_ARCHIVED);
+        assert_se(sd_id128_equal(f->header->seqnum_id, seqnum_id));
+        assert_se(le64toh(f->header->n_entries) == N_ENTRIES / 10);
+        /* The MESSAGE= fields of the debug entries and PRIORITY=7 are gone */
+        assert_se(le64toh(f->header->n_data) == N_ENTRIES / 10 + 2);
+        f = journal_file_close(f);
+
+        assert_se(sd_journal_open_files(&j, (const char**) STRV_MAKE(fn), 0) >= 0);
+        SD_JOURNAL_FOREACH(j) {
+                const void *data;
+                size_t length;
+                Object *o;
+
+                assert_se(sd_journal_get_data(j, "PRIORITY", &data, &length) >= 0);
+                assert_se(memcmp_nn(data, length, "PRIORITY=3", STRLEN("PRIORITY=3")) == 0);
+
+                /* Sequence numbers are unchanged, so that cursors stay valid */
+                assert_se(journal_file_move_to_object(j->current_file, OBJECT_ENTRY, j->current_file->current_offset, &o) >= 0);
+                assert_se(le64toh(o->entry.seqnum) == n * 10 + 1);
+
+                n++;
+        }
+        assert_se(n == N_ENTRIES / 10);
+        sd_journal_close(j);
+
+        /* Nothing matches, hence the file is removed */
+        assert_se(sd_journal_open_files(&j, (const char**) STRV_MAKE(fn), 0) >= 0);
+        assert_se(sd_journal_add_match(j, "PRIORITY=0", 0) >= 0);
+        assert_se(journal_compact_file(j, true) == 0);
+        sd_journal_close(j);
+
+        assert_se(access(fn, F_OK) < 0 && errno == ENOENT);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_compact();
+
+        return 0;
+}
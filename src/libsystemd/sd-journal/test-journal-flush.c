@@ -46,7 +46,7 @@ int main(int argc, char *argv[]) {
                         log_error_errno(r, "journal_file_move_to_object failed: %m");
                 assert_se(r >= 0);
 
-                r = journal_file_copy_entry(f, new_journal, o, f->current_offset);
+                r = journal_file_copy_entry(f, new_journal, o, f->current_offset, NULL);
                 if (r < 0)
                         log_error_errno(r, "journal_file_copy_entry failed: %m");
                 assert_se(r >= 0);
@@ -7,12 +7,14 @@
 
 #include "alloc-util.h"
 #include "chattr-util.h"
+#include "glob-util.h"
 #include "io-util.h"
 #include "journal-file.h"
 #include "journal-vacuum.h"
 #include "log.h"
 #include "parse-util.h"
 #include "rm-rf.h"
+#include "strv.h"
 #include "tests.h"
 #include "util.h"
 
@@ -131,6 +133,29 @@ static void setup_interleaved(void) {
         test_close(two);
 }
 
+#define N_MANY_FILES 16
+#define N_MANY_ENTRIES (N_MANY_FILES * 4)
+
+static void setup_many_interleaved(void) {
+        JournalFile *f[N_MANY_FILES];
+
+        /* Enough files to make sure iterating across them doesn't depend on the order the files are
+         * looked at in. Entries are spread across the files in an irregular pattern. */
+
+        for (unsigned i = 0; i < N_MANY_FILES; i++) {
+                _cleanup_free_ char *fn = NULL;
+
+                assert_se(asprintf(&fn, "many-%02u.journal", i) >= 0);
+                f[i] = test_open(fn);
+        }
+
+        for (int n = 1; n <= N_MANY_ENTRIES; n++)
+                append_number(f[(n * 7) % N_MANY_FILES], n, NULL);
+
+        for (unsigned i = 0; i < N_MANY_FILES; i++)
+                test_close(f[i]);
+}
+
 static void mkdtemp_chdir_chattr(char *path) {
         assert_se(mkdtemp(path));
         assert_se(chdir(path) >= 0);
@@ -140,7 +165,7 @@ static void mkdtemp_chdir_chattr(char *path) {
         (void) chattr_path(path, FS_NOCOW_FL, FS_NOCOW_FL, NULL);
 }
 
-static void test_skip(void (*setup)(void)) {
+static void test_skip(void (*setup)(void), int count) {
         char t[] = "/var/tmp/journal-skip-XXXXXX";
         sd_journal *j;
         int r;
@@ -154,7 +179,7 @@ static void test_skip(void (*setup)(void)) {
         assert_ret(sd_journal_open_directory(&j, t, 0));
         assert_ret(sd_journal_seek_head(j));
         assert_ret(sd_journal_next(j));
-        test_check_numbers_down(j, 4);
+        test_check_numbers_down(j, count);
         sd_journal_close(j);
 
         /* Seek to tail, iterate up.
@@ -162,25 +187,25 @@ static void test_skip(void (*setup)(void)) {
         assert_ret(sd_journal_open_directory(&j, t, 0));
         assert_ret(sd_journal_seek_tail(j));
         assert_ret(sd_journal_previous(j));
-        test_check_numbers_up(j, 4);
+        test_check_numbers_up(j, count);
         sd_journal_close(j);
 
         /* Seek to tail, skip to head, iterate down.
          */
         assert_ret(sd_journal_open_directory(&j, t, 0));
         assert_ret(sd_journal_seek_tail(j));
-        assert_ret(r = sd_journal_previous_skip(j, 4));
-        assert_se(r == 4);
-        test_check_numbers_down(j, 4);
+        assert_ret(r = sd_journal_previous_skip(j, count));
+        assert_se(r == count);
+        test_check_numbers_down(j, count);
         sd_journal_close(j);
 
         /* Seek to head, skip to tail, iterate up.
          */
         assert_ret(sd_journal_open_directory(&j, t, 0));
         assert_ret(sd_journal_seek_head(j));
-        assert_ret(r = sd_journal_next_skip(j, 4));
-        assert_se(r == 4);
-        test_check_numbers_up(j, 4);
+        assert_ret(r = sd_journal_next_skip(j, count));
+        assert_se(r == count);
+        test_check_numbers_up(j, count);
         sd_journal_close(j);
 
         log_info("Done...");
@@ -278,6 +303,135 @@ static void test_sequence_numbers(void) {
         }
 }
 
+static void test_unique(void) {
+        char t[] = "/var/tmp/journal-unique-XXXXXX";
+        JournalFile *one, *two, *three;
+        bool seen[16] = {};
+        const void *d;
+        sd_journal *j;
+        size_t l;
+
+        mkdtemp_chdir_chattr(t);
+
+        /* An archived file which carries a field index, and two that don't, with overlapping values */
+        one = test_open("one.journal");
+        two = test_open("two.journal");
+        three = test_open("three.journal");
+        for (int i = 0; i < 12; i++)
+                append_number(one, i, NULL);
+        for (int i = 4; i < 16; i += 2)
+                append_number(two, i, NULL);
+        for (int i = 8; i < 16; i++)
+                append_number(three, i, NULL);
+        assert_ret(journal_file_archive(one));
+        assert_ret(journal_file_archive(two));
+        assert_se(JOURNAL_HEADER_FIELD_INDEX(one->header));
+        assert_se(JOURNAL_HEADER_FIELD_INDEX(two->header));
+        test_close(one);
+        test_close(two);
+        test_close(three);
+
+        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_query_unique(j, "NUMBER"));
+        SD_JOURNAL_FOREACH_UNIQUE(j, d, l) {
+                unsigned n;
+
+                assert_se(l > STRLEN("NUMBER="));
+                assert_se(memcmp(d, "NUMBER=", STRLEN("NUMBER=")) == 0);
+                assert_ret(safe_atou(strndupa(d + STRLEN("NUMBER="), l - STRLEN("NUMBER=")), &n));
+                assert_se(n < ELEMENTSOF(seen));
+                assert_se(!seen[n]);
+                seen[n] = true;
+        }
+        for (size_t i = 0; i < ELEMENTSOF(seen); i++)
+                assert_se(seen[i]);
+
+        /* Fields without values are not listed at all */
+        assert_ret(sd_journal_query_unique(j, "FOOBAR"));
+        assert_se(sd_journal_enumerate_unique(j, &d, &l) == 0);
+        sd_journal_close(j);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else {
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+        }
+}
+
+static void test_seek_index(void) {
+        char t[] = "/var/tmp/journal-seek-XXXXXX";
+        _cleanup_strv_free_ char **files = NULL;
+        uint64_t seqnums[1000], offsets[1000], offset, seqnum = 0;
+        JournalFile *f;
+        Object *o;
+
+        mkdtemp_chdir_chattr(t);
+
+        f = test_open("test.journal");
+        for (size_t i = 0; i < ELEMENTSOF(seqnums); i++) {
+                append_number(f, i, &seqnum);
+                seqnums[i] = seqnum;
+        }
+        assert_ret(journal_file_archive(f));
+        assert_se(JOURNAL_HEADER_SEEK_INDEX(f->header));
+        test_close(f);
+
+        assert_se(glob_extend(&files, "test@*.journal", 0) >= 0);
+        assert_se(strv_length(files) == 1);
+        assert_ret(journal_file_open(-1, files[0], O_RDONLY, 0, true, UINT64_MAX, false, NULL, NULL, NULL, NULL, &f));
+        assert_se(f->header->state == STATE_ARCHIVED);
+
+        for (size_t i = 0; i < ELEMENTSOF(seqnums); i++) {
+                assert_se(journal_file_move_to_entry_by_seqnum(f, seqnums[i], DIRECTION_DOWN, &o, &offsets[i]) == 1);
+                assert_se(le64toh(o->entry.seqnum) == seqnums[i]);
+                assert_se(journal_file_move_to_entry_by_seqnum(f, seqnums[i], DIRECTION_UP, &o, &offset) == 1);
+                assert_se(offset == offsets[i]);
+        }
+
+        /* Seeking by realtime has to end up on the same entries, or their immediate neighbours if we miss */
+        for (size_t i = 0; i < ELEMENTSOF(seqnums); i++) {
+                uint64_t rt;
+                int r;
+
+                assert_ret(journal_file_move_to_object(f, OBJECT_ENTRY, offsets[i], &o));
+                rt = le64toh(o->entry.realtime);
+
+                assert_se(journal_file_move_to_entry_by_realtime(f, rt, DIRECTION_DOWN, NULL, &offset) == 1);
+                assert_se(offset == offsets[i]);
+                assert_se(journal_file_move_to_entry_by_realtime(f, rt, DIRECTION_UP, NULL, &offset) == 1);
+                assert_se(offset == offsets[i]);
+
+                r = journal_file_move_to_entry_by_realtime(f, rt + 1, DIRECTION_DOWN, NULL, &offset);
+                if (i == ELEMENTSOF(seqnums) - 1)
+                        assert_se(r == 0);
+                else
+                        assert_se(r == 1 && offset == offsets[i+1]);
+
+                r = journal_file_move_to_entry_by_realtime(f, rt - 1, DIRECTION_UP, NULL, &offset);
+                if (i == 0)
+                        assert_se(r == 0);
+                else
+                        assert_se(r == 1 && offset == offsets[i-1]);
+        }
+
+        assert_se(journal_file_move_to_entry_by_seqnum(f, seqnums[0] - 1, DIRECTION_UP, NULL, NULL) == 0);
+        assert_se(journal_file_move_to_entry_by_seqnum(f, seqnums[ELEMENTSOF(seqnums) - 1] + 1, DIRECTION_DOWN, NULL, NULL) == 0);
+        assert_se(journal_file_move_to_entry_by_seqnum(f, seqnums[0] - 1, DIRECTION_DOWN, NULL, &offset) == 1);
+        assert_se(offset == offsets[0]);
+
+        test_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else {
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+        }
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -287,10 +441,14 @@ int main(int argc, char *argv[]) {
 
         arg_keep = argc > 1;
 
-        test_skip(setup_sequential);
-        test_skip(setup_interleaved);
+        test_skip(setup_sequential, 4);
+        test_skip(setup_interleaved, 4);
+        test_skip(setup_many_interleaved, N_MANY_ENTRIES);
 
         test_sequence_numbers();
 
+        test_unique();
+        test_seek_index();
+
         return 0;
 }
@@ -7,9 +7,11 @@
 #include "io-util.h"
 #include "journal-authenticate.h"
 #include "journal-file.h"
+#include "journal-internal.h"
 #include "journal-vacuum.h"
 #include "log.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 #include "tests.h"
 
 static bool arg_keep = false;
@@ -98,8 +100,8 @@ static void test_non_empty(void) {
 
         assert_se(journal_file_move_to_entry_by_seqnum(f, 10, DIRECTION_DOWN, &o, NULL) == 0);
 
-        journal_file_rotate(&f, true, UINT64_MAX, true, NULL);
-        journal_file_rotate(&f, true, UINT64_MAX, true, NULL);
+        journal_file_rotate(&f, true, UINT64_MAX, false, true, NULL);
+        journal_file_rotate(&f, true, UINT64_MAX, false, true, NULL);
 
         (void) journal_file_close(f);
 
@@ -116,6 +118,76 @@ static void test_non_empty(void) {
         puts("------------------------------------------------------------");
 }
 
+static void test_append_entries(void) {
+        JournalAppendEntry entries[300];
+        struct iovec iovec[ELEMENTSOF(entries)][3];
+        char numbers[ELEMENTSOF(entries)][STRLEN("NUMBER=") + DECIMAL_STR_MAX(size_t)];
+        uint64_t common, even, seqnum = 0;
+        dual_timestamp ts;
+        JournalFile *f;
+        size_t n, j;
+        Object *o;
+        char t[] = "/var/tmp/journal-batch-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, UINT64_MAX, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(dual_timestamp_get(&ts));
+
+        /* Mix fields shared with the previous entry with ones that are not */
+        for (size_t i = 0; i < ELEMENTSOF(entries); i++) {
+                xsprintf(numbers[i], "NUMBER=%zu", i);
+                iovec[i][0] = IOVEC_MAKE_STRING("COMMON=yes");
+                iovec[i][1] = IOVEC_MAKE_STRING(numbers[i]);
+                iovec[i][2] = IOVEC_MAKE_STRING((i % 2 == 0 ? "PARITY=even" : "PARITY=odd"));
+
+                entries[i] = (JournalAppendEntry) {
+                        .ts = ts,
+                        .iovec = iovec[i],
+                        .n_iovec = i % 3 == 0 ? 2 : 3,
+                };
+        }
+
+        assert_se(journal_file_append_entries(f, entries, ELEMENTSOF(entries), &seqnum, &n) == 0);
+        assert_se(n == ELEMENTSOF(entries));
+        assert_se(seqnum == ELEMENTSOF(entries));
+        assert_se(le64toh(f->header->n_entries) == ELEMENTSOF(entries));
+        assert_se(le64toh(f->header->n_data) == ELEMENTSOF(entries) + 3);
+
+        assert_se(journal_file_find_data_object(f, "COMMON=yes", STRLEN("COMMON=yes"), &o, &common) == 1);
+        assert_se(le64toh(o->data.n_entries) == ELEMENTSOF(entries));
+        assert_se(journal_file_find_data_object(f, "PARITY=even", STRLEN("PARITY=even"), &o, &even) == 1);
+        assert_se(le64toh(o->data.n_entries) == 100);
+
+        for (size_t i = 0; i < ELEMENTSOF(entries); i++) {
+                assert_se(journal_file_move_to_entry_by_seqnum_for_data(f, common, i + 1, DIRECTION_DOWN, &o, NULL) == 1);
+                assert_se(le64toh(o->entry.seqnum) == i + 1);
+                assert_se(journal_file_entry_n_items(o) == entries[i].n_iovec);
+                assert_se(sd_id128_equal(o->entry.boot_id, f->header->boot_id));
+
+                /* PARITY=even is only in entries with all three fields */
+                j = i;
+                while (j < ELEMENTSOF(entries) && (j % 2 != 0 || entries[j].n_iovec != 3))
+                        j++;
+                if (j < ELEMENTSOF(entries)) {
+                        assert_se(journal_file_move_to_entry_by_seqnum_for_data(f, even, i + 1, DIRECTION_DOWN, &o, NULL) == 1);
+                        assert_se(le64toh(o->entry.seqnum) == j + 1);
+                } else
+                        assert_se(journal_file_move_to_entry_by_seqnum_for_data(f, even, i + 1, DIRECTION_DOWN, &o, NULL) == 0);
+        }
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else {
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+        }
+}
+
 static void test_empty(void) {
         JournalFile *f1, *f2, *f3, *f4;
         char t[] = "/var/tmp/journal-XXXXXX";
@@ -238,6 +310,144 @@ static void test_min_compress_size(void) {
         assert_se(check_compressed(256, 256));
         assert_se(!check_compressed(256, 255));
 }
+
+static void test_data_cache(void) {
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        char t[] = "/var/tmp/journal-data-cache-XXXXXX";
+        char message[LINE_MAX], cmdline[LINE_MAX];
+        unsigned n = 0, n_hit;
+        dual_timestamp ts;
+        JournalFile *f;
+        const void *d;
+        size_t l;
+
+        mkdtemp_chdir_chattr(t);
+
+        /* Make the shared field long and repetitive enough to be compressible even with XZ, while the
+         * messages stay below the compression threshold */
+        xsprintf(cmdline, "_CMDLINE=/usr/bin/foo%s", " --verbose --verbose --verbose --verbose --verbose"
+                                                      " --verbose --verbose --verbose --verbose --verbose"
+                                                      " --verbose --verbose --verbose --verbose --verbose");
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, 64, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        for (unsigned i = 0; i < 100; i++) {
+                struct iovec iovec[2];
+
+                xsprintf(message, "MESSAGE=Message number %u", i);
+                iovec[0] = IOVEC_MAKE_STRING(message);
+                iovec[1] = IOVEC_MAKE_STRING(cmdline);
+
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL) == 0);
+        }
+
+        (void) journal_file_close(f);
+
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+        assert_se(sd_journal_get_data_cache_size(j, &l) >= 0);
+        assert_se(l > 0);
+
+        SD_JOURNAL_FOREACH(j) {
+                assert_se(sd_journal_get_data(j, "_CMDLINE", &d, &l) >= 0);
+                assert_se(memcmp_nn(d, l, cmdline, strlen(cmdline)) == 0);
+
+                assert_se(sd_journal_get_data(j, "MESSAGE", &d, &l) >= 0);
+                xsprintf(message, "MESSAGE=Message number %u", n);
+                assert_se(memcmp_nn(d, l, message, strlen(message)) == 0);
+
+                n++;
+        }
+        assert_se(n == 100);
+
+        /* The shared field is decompressed only once, and then served from the cache, also when it is
+         * skipped over while looking for MESSAGE= */
+        log_info("Data cache: %u hits, %u misses", j->n_data_cache_hit, j->n_data_cache_missed);
+        assert_se(j->n_data_cache_missed == 1);
+        assert_se(j->n_data_cache_hit >= 99);
+
+        /* With the cache turned off, nothing is served from it anymore */
+        assert_se(sd_journal_set_data_cache_size(j, 0) >= 0);
+        assert_se(j->data_cache_size == 0);
+        n_hit = j->n_data_cache_hit;
+
+        SD_JOURNAL_FOREACH(j) {
+                assert_se(sd_journal_get_data(j, "_CMDLINE", &d, &l) >= 0);
+                assert_se(memcmp_nn(d, l, cmdline, strlen(cmdline)) == 0);
+        }
+        assert_se(j->n_data_cache_hit == n_hit);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+#endif
+
+#if HAVE_ZSTD
+static void test_compression_dictionary(void) {
+        char t[] = "/var/tmp/journal-dict-XXXXXX";
+        char buf[LINE_MAX];
+        dual_timestamp ts;
+        JournalFile *f;
+        Object *o;
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, 8, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(!JOURNAL_HEADER_COMPRESSION_DICTIONARY(f->header));
+
+        /* Fill the file we'll train the dictionary from with similar, but distinct, messages */
+        for (unsigned i = 0; i < 2000; i++) {
+                struct iovec iovec;
+
+                xsprintf(buf, "MESSAGE=Started session %u of user %u on seat%u.", i, i % 17, i % 3);
+                iovec = IOVEC_MAKE_STRING(buf);
+
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        assert_se(journal_file_rotate(&f, true, 8, true, false, NULL) >= 0);
+        assert_se(JOURNAL_HEADER_COMPRESSION_DICTIONARY(f->header));
+        assert_se(f->compress_dictionary);
+
+        /* A file that already got a dictionary can't get another one */
+        assert_se(journal_file_set_compression_dictionary(f, "x", 1) == -EBUSY);
+
+        for (unsigned i = 0; i < 100; i++) {
+                struct iovec iovec;
+
+                xsprintf(buf, "MESSAGE=Started session %u of user %u on seat%u.", 5000 + i, i % 17, i % 3);
+                iovec = IOVEC_MAKE_STRING(buf);
+
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        (void) journal_file_close(f);
+
+        /* Reopen, so that the dictionary is loaded from the file, and look for the objects we wrote */
+        assert_se(journal_file_open(-1, "test.journal", O_RDONLY, 0666, true, 8, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(f->compress_dictionary);
+
+        for (unsigned i = 0; i < 100; i++) {
+                xsprintf(buf, "MESSAGE=Started session %u of user %u on seat%u.", 5000 + i, i % 17, i % 3);
+
+                assert_se(journal_file_find_data_object(f, buf, strlen(buf), &o, NULL) == 1);
+                assert_se(o->object.flags & OBJECT_COMPRESSED_ZSTD);
+        }
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else {
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+        }
+}
 #endif
 
 int main(int argc, char *argv[]) {
@@ -250,9 +460,14 @@ int main(int argc, char *argv[]) {
                 return log_tests_skipped("/etc/machine-id not found");
 
         test_non_empty();
+        test_append_entries();
         test_empty();
 #if HAVE_COMPRESSION
         test_min_compress_size();
+        test_data_cache();
+#endif
+#if HAVE_ZSTD
+        test_compression_dictionary();
 #endif
 
         return 0;
@@ -15,6 +15,7 @@ int main(int argc, char *argv[]) {
         MMapFileDescriptor *fx;
         int x, y, z, r;
         char px[] = "/tmp/testmmapXXXXXXX", py[] = "/tmp/testmmapYXXXXXX", pz[] = "/tmp/testmmapZXXXXXX";
+        MMapCacheStatistics stats;
         MMapCache *m;
         void *p, *q;
 
@@ -55,7 +56,18 @@ int main(int argc, char *argv[]) {
 
         assert_se((uint8_t*) p + 1 == (uint8_t*) q);
 
+        mmap_cache_get_statistics(m, &stats);
+        assert_se(stats.n_context_cache_hit + stats.n_window_list_hit + stats.n_missed == 5);
+        assert_se(stats.n_missed >= 2);
+        assert_se(stats.n_windows <= stats.n_missed);
+        assert_se(stats.n_bytes_mapped > 0);
+        assert_se(stats.n_bytes_mapped <= stats.n_bytes_mapped_max);
+
         mmap_cache_free_fd(m, fx);
+
+        mmap_cache_get_statistics(m, &stats);
+        assert_se(stats.n_bytes_mapped == 0);
+        assert_se(stats.n_bytes_mapped_max > 0);
         mmap_cache_unref(m);
 
         safe_close(x);
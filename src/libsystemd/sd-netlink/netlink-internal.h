@@ -14,8 +14,19 @@
 
 #define RTNL_RQUEUE_MAX 64*1024
 
+/* The kernel caps the datagrams it builds for dumps at 32K, including the skb overhead. */
+#define RTNL_RBUFFER_SIZE_MIN (32U * 1024U)
+
+/* Sealed requests queued while the connection is corked are flushed with one sendmsg() per chunk of at
+ * most this many messages or bytes. The byte limit stays well below the default socket send buffer. */
+#define RTNL_WQUEUE_MAX 64U
+#define RTNL_WQUEUE_BYTES_MAX (32U * 1024U)
+
 #define RTNL_CONTAINER_DEPTH 32
 
+/* Most requests fit into this, so appending attributes to them does not need to reallocate the message. */
+#define RTNL_MESSAGE_SIZE_INITIAL 512U
+
 struct reply_callback {
         sd_netlink_message_handler_t callback;
         usec_t timeout;
@@ -77,6 +88,11 @@ struct sd_netlink {
 
         struct nlmsghdr *rbuffer;
 
+        sd_netlink_message **wqueue;
+        size_t wqueue_size;
+        size_t wqueue_bytes;
+        unsigned n_cork;
+
         bool processing:1;
 
         uint32_t serial;
@@ -67,7 +67,7 @@ int message_new(sd_netlink *rtnl, sd_netlink_message **ret, uint16_t type) {
         size = NLMSG_SPACE(type_get_size(nl_type));
 
         assert(size >= sizeof(struct nlmsghdr));
-        m->hdr = malloc0(size);
+        m->hdr = malloc0(MAX(size, RTNL_MESSAGE_SIZE_INITIAL));
         if (!m->hdr)
                 return -ENOMEM;
 
@@ -142,7 +142,6 @@ int sd_netlink_message_is_broadcast(sd_netlink_message *m) {
    unsuccessful the old message is untouched. */
 static int add_rtattr(sd_netlink_message *m, unsigned short type, const void *data, size_t data_length) {
         size_t message_length;
-        struct nlmsghdr *new_hdr;
         struct rtattr *rta;
         int offset;
 
@@ -159,11 +158,10 @@ static int add_rtattr(sd_netlink_message *m, unsigned short type, const void *da
         if (message_length > MIN(page_size(), 8192UL))
                 return -ENOBUFS;
 
-        /* realloc to fit the new attribute */
-        new_hdr = realloc(m->hdr, message_length);
-        if (!new_hdr)
+        /* realloc to fit the new attribute, growing the buffer geometrically, so that a message with many
+         * attributes is not reallocated for each of them */
+        if (!greedy_realloc((void**) &m->hdr, message_length, 1))
                 return -ENOMEM;
-        m->hdr = new_hdr;
 
         /* get pointer to the attribute we are about to add */
         rta = (struct rtattr *) ((uint8_t *) m->hdr + m->hdr->nlmsg_len);
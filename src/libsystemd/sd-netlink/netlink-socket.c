@@ -295,8 +295,9 @@ int socket_read_message(sd_netlink *rtnl) {
         else
                 len = (size_t) r;
 
-        /* make room for the pending message */
-        if (!greedy_realloc((void **)&rtnl->rbuffer, len, sizeof(uint8_t)))
+        /* make room for the pending message. The kernel sizes the datagrams of dumps by the largest read
+         * buffer we ever offered, hence always offer a large one, so that big dumps need fewer reads. */
+        if (!greedy_realloc((void **)&rtnl->rbuffer, MAX(len, RTNL_RBUFFER_SIZE_MIN), sizeof(uint8_t)))
                 return -ENOMEM;
 
         allocated = MALLOC_SIZEOF_SAFE(rtnl->rbuffer);
@@ -188,6 +188,10 @@ static sd_netlink *netlink_free(sd_netlink *rtnl) {
 
         free(rtnl->rbuffer);
 
+        for (size_t j = 0; j < rtnl->wqueue_size; j++)
+                sd_netlink_message_unref(rtnl->wqueue[j]);
+        free(rtnl->wqueue);
+
         while ((s = rtnl->slots)) {
                 assert(s->floating);
                 netlink_slot_disconnect(s, true);
@@ -232,6 +236,94 @@ static void rtnl_seal_message(sd_netlink *rtnl, sd_netlink_message *m) {
         rtnl_message_seal(m);
 }
 
+static int rtnl_queue_synthetic_error(sd_netlink *rtnl, int error, uint32_t serial) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
+        int r;
+
+        assert(rtnl);
+
+        r = rtnl_message_new_synthetic_error(rtnl, error, serial, &m);
+        if (r < 0)
+                return r;
+
+        r = rtnl_rqueue_make_room(rtnl);
+        if (r < 0)
+                return r;
+
+        rtnl->rqueue[rtnl->rqueue_size++] = TAKE_PTR(m);
+        return 0;
+}
+
+static int rtnl_flush_wqueue(sd_netlink *rtnl) {
+        size_t i = 0;
+        int r;
+
+        assert(rtnl);
+
+        /* The kernel processes every message of a multi-message write on its own, and acknowledges each
+         * of them with its own sequence number, hence per-request errors are reported exactly as if the
+         * requests were sent one by one. */
+
+        while (i < rtnl->wqueue_size) {
+                size_t n = 0, bytes = 0;
+
+                while (i + n < rtnl->wqueue_size && n < RTNL_WQUEUE_MAX) {
+                        size_t len = rtnl->wqueue[i + n]->hdr->nlmsg_len;
+
+                        if (n > 0 && bytes + len > RTNL_WQUEUE_BYTES_MAX)
+                                break;
+
+                        bytes += len;
+                        n++;
+                }
+
+                r = socket_writev_message(rtnl, rtnl->wqueue + i, n);
+                if (r < 0) {
+                        log_debug_errno(r, "sd-netlink: failed to send %zu queued messages at once, sending them one by one: %m", n);
+
+                        /* The callers have already been told that their requests were sent, hence report
+                         * failures through the reply path, like timeouts. */
+                        for (size_t j = i; j < i + n; j++) {
+                                r = socket_write_message(rtnl, rtnl->wqueue[j]);
+                                if (r >= 0)
+                                        continue;
+
+                                r = rtnl_queue_synthetic_error(rtnl, r, rtnl_message_get_serial(rtnl->wqueue[j]));
+                                if (r < 0)
+                                        log_debug_errno(r, "sd-netlink: failed to queue error reply, ignoring: %m");
+                        }
+                }
+
+                for (size_t j = i; j < i + n; j++)
+                        rtnl->wqueue[j] = sd_netlink_message_unref(rtnl->wqueue[j]);
+
+                i += n;
+        }
+
+        rtnl->wqueue_size = 0;
+        rtnl->wqueue_bytes = 0;
+        return 0;
+}
+
+int sd_netlink_cork(sd_netlink *nl) {
+        assert_return(nl, -EINVAL);
+        assert_return(!rtnl_pid_changed(nl), -ECHILD);
+
+        nl->n_cork++;
+        return 0;
+}
+
+int sd_netlink_uncork(sd_netlink *nl) {
+        assert_return(nl, -EINVAL);
+        assert_return(!rtnl_pid_changed(nl), -ECHILD);
+        assert_return(nl->n_cork > 0, -EINVAL);
+
+        if (--nl->n_cork > 0)
+                return 0;
+
+        return rtnl_flush_wqueue(nl);
+}
+
 int sd_netlink_send(sd_netlink *nl,
                     sd_netlink_message *message,
                     uint32_t *serial) {
@@ -244,9 +336,30 @@ int sd_netlink_send(sd_netlink *nl,
 
         rtnl_seal_message(nl, message);
 
-        r = socket_write_message(nl, message);
-        if (r < 0)
-                return r;
+        if (nl->n_cork > 0) {
+                /* Queue the message, it is written together with the others when the connection is
+                 * uncorked, or when the queue is full. */
+                if (nl->wqueue_size >= RTNL_WQUEUE_MAX || nl->wqueue_bytes >= RTNL_WQUEUE_BYTES_MAX) {
+                        r = rtnl_flush_wqueue(nl);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (!GREEDY_REALLOC(nl->wqueue, nl->wqueue_size + 1))
+                        return -ENOMEM;
+
+                nl->wqueue[nl->wqueue_size++] = sd_netlink_message_ref(message);
+                nl->wqueue_bytes += message->hdr->nlmsg_len;
+        } else {
+                /* Keep the ordering with anything queued earlier. */
+                r = rtnl_flush_wqueue(nl);
+                if (r < 0)
+                        return r;
+
+                r = socket_write_message(nl, message);
+                if (r < 0)
+                        return r;
+        }
 
         if (serial)
                 *serial = rtnl_message_get_serial(message);
@@ -282,6 +395,10 @@ int sd_netlink_sendv(
                         serials[i] = rtnl_message_get_serial(messages[i]);
         }
 
+        r = rtnl_flush_wqueue(nl);
+        if (r < 0)
+                return r;
+
         r = socket_writev_message(nl, messages, msgcount);
         if (r < 0)
                 return r;
@@ -658,6 +775,11 @@ int sd_netlink_read(
         assert_return(rtnl, -EINVAL);
         assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
 
+        /* The request we are waiting for might still be queued. */
+        r = rtnl_flush_wqueue(rtnl);
+        if (r < 0)
+                return r;
+
         timeout = calc_elapse(usec);
 
         for (;;) {
@@ -723,6 +845,144 @@ int sd_netlink_read(
         }
 }
 
+static int rtnl_queue_find(sd_netlink_message **queue, unsigned size, uint32_t serial) {
+        for (unsigned i = 0; i < size; i++)
+                if (rtnl_message_get_serial(queue[i]) == serial)
+                        return (int) i;
+
+        return -ENOENT;
+}
+
+static sd_netlink_message *rtnl_queue_take(sd_netlink_message **queue, unsigned *size, uint32_t serial) {
+        sd_netlink_message *m;
+        int i;
+
+        assert(size);
+
+        i = rtnl_queue_find(queue, *size, serial);
+        if (i < 0)
+                return NULL;
+
+        m = queue[i];
+        memmove(queue + i, queue + i + 1, sizeof(sd_netlink_message*) * (*size - i - 1));
+        (*size)--;
+
+        return m;
+}
+
+static int rtnl_dump_dispatch(
+                sd_netlink *rtnl,
+                sd_netlink_message *chain,
+                sd_netlink_message_handler_t callback,
+                void *userdata) {
+
+        int r = 0;
+
+        assert(rtnl);
+        assert(callback);
+
+        while (chain) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = chain;
+                uint16_t type;
+                int k;
+
+                /* Detach each message before handing it out, so that its part of the dump can be freed as
+                 * soon as the callback is done with it. */
+                chain = TAKE_PTR(m->next);
+
+                if (sd_netlink_message_get_type(m, &type) >= 0 && type == NLMSG_DONE)
+                        continue;
+
+                k = callback(rtnl, m, userdata);
+                if (k < 0 && r >= 0)
+                        r = k;
+        }
+
+        return r;
+}
+
+int sd_netlink_call_dump(
+                sd_netlink *rtnl,
+                sd_netlink_message *message,
+                uint64_t usec,
+                sd_netlink_message_handler_t callback,
+                void *userdata) {
+
+        uint32_t serial;
+        usec_t timeout;
+        int r, ret = 0;
+
+        assert_return(rtnl, -EINVAL);
+        assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+        assert_return(message, -EINVAL);
+        assert_return(callback, -EINVAL);
+
+        /* Like sd_netlink_call() for a dump request, but instead of collecting the whole reply in one
+         * chain of messages, every part is passed to the callback as soon as the datagram carrying it has
+         * been read, and freed right after. This keeps the memory used by dumps of large tables bounded.
+         * All parts are consumed even if the callback fails, the first error is returned at the end. */
+
+        r = sd_netlink_send(rtnl, message, &serial);
+        if (r < 0)
+                return r;
+
+        r = rtnl_flush_wqueue(rtnl);
+        if (r < 0)
+                return r;
+
+        timeout = calc_elapse(usec);
+
+        for (;;) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
+                usec_t left;
+
+                /* The last part completes the reply and moves it to the read queue, as does an error. */
+                m = rtnl_queue_take(rtnl->rqueue, &rtnl->rqueue_size, serial);
+                if (m) {
+                        r = sd_netlink_message_get_errno(m);
+                        if (r < 0)
+                                return r;
+
+                        r = rtnl_dump_dispatch(rtnl, TAKE_PTR(m), callback, userdata);
+                        return ret < 0 ? ret : r;
+                }
+
+                m = rtnl_queue_take(rtnl->rqueue_partial, &rtnl->rqueue_partial_size, serial);
+                if (m) {
+                        /* Later parts will start a new partial chain, and the terminating NLMSG_DONE is
+                         * queued on its own if nothing else is pending. */
+                        r = rtnl_dump_dispatch(rtnl, TAKE_PTR(m), callback, userdata);
+                        if (r < 0 && ret >= 0)
+                                ret = r;
+                        continue;
+                }
+
+                r = socket_read_message(rtnl);
+                if (r < 0)
+                        return r;
+                if (r > 0 || rtnl_queue_find(rtnl->rqueue_partial, rtnl->rqueue_partial_size, serial) >= 0)
+                        /* received (part of) a message, so try to process straight away */
+                        continue;
+
+                if (timeout > 0) {
+                        usec_t n;
+
+                        n = now(CLOCK_MONOTONIC);
+                        if (n >= timeout)
+                                return -ETIMEDOUT;
+
+                        left = usec_sub_unsigned(timeout, n);
+                } else
+                        left = USEC_INFINITY;
+
+                r = rtnl_poll(rtnl, true, left);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return -ETIMEDOUT;
+        }
+}
+
 int sd_netlink_call(
                 sd_netlink *rtnl,
                 sd_netlink_message *message,
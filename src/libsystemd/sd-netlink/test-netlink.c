@@ -390,6 +390,39 @@ static void test_pipe(int ifindex) {
         assert_se((rtnl = sd_netlink_unref(rtnl)) == NULL);
 }
 
+static void test_cork(int ifindex) {
+        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m1 = NULL, *m2 = NULL, *m3 = NULL, *reply = NULL;
+        int counter = 0;
+
+        assert_se(sd_netlink_open(&rtnl) >= 0);
+
+        assert_se(sd_rtnl_message_new_link(rtnl, &m1, RTM_GETLINK, ifindex) >= 0);
+        assert_se(sd_rtnl_message_new_link(rtnl, &m2, RTM_GETLINK, ifindex) >= 0);
+        assert_se(sd_rtnl_message_new_link(rtnl, &m3, RTM_GETLINK, ifindex) >= 0);
+
+        assert_se(sd_netlink_uncork(rtnl) == -EINVAL);
+        assert_se(sd_netlink_cork(rtnl) >= 0);
+
+        counter++;
+        assert_se(sd_netlink_call_async(rtnl, NULL, m1, pipe_handler, NULL, &counter, 0, NULL) >= 0);
+
+        counter++;
+        assert_se(sd_netlink_call_async(rtnl, NULL, m2, pipe_handler, NULL, &counter, 0, NULL) >= 0);
+
+        /* Synchronous calls must not wait for a request that is still queued */
+        assert_se(sd_netlink_call(rtnl, m3, 0, &reply) == 1);
+
+        assert_se(sd_netlink_uncork(rtnl) >= 0);
+
+        while (counter > 0) {
+                assert_se(sd_netlink_wait(rtnl, 0) >= 0);
+                assert_se(sd_netlink_process(rtnl, NULL) >= 0);
+        }
+
+        assert_se((rtnl = sd_netlink_unref(rtnl)) == NULL);
+}
+
 static void test_container(sd_netlink *rtnl) {
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
         uint16_t u16_data;
@@ -469,6 +502,39 @@ static void test_get_addresses(sd_netlink *rtnl) {
         }
 }
 
+static int dump_handler(sd_netlink *rtnl, sd_netlink_message *m, void *userdata) {
+        unsigned *counter = userdata;
+        uint16_t type;
+
+        assert_se(m);
+        assert_se(sd_netlink_message_get_type(m, &type) >= 0);
+        assert_se(type == RTM_NEWLINK);
+
+        (*counter)++;
+        return 0;
+}
+
+static void test_call_dump(sd_netlink *rtnl) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *req = NULL, *reply = NULL;
+        unsigned counter = 0, expected = 0;
+
+        assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 0) >= 0);
+        assert_se(sd_netlink_message_request_dump(req, true) >= 0);
+        assert_se(sd_netlink_call(rtnl, req, 0, &reply) >= 0);
+
+        for (sd_netlink_message *m = reply; m; m = sd_netlink_message_next(m))
+                expected++;
+
+        req = sd_netlink_message_unref(req);
+        assert_se(sd_rtnl_message_new_link(rtnl, &req, RTM_GETLINK, 0) >= 0);
+        assert_se(sd_netlink_message_request_dump(req, true) >= 0);
+        assert_se(sd_netlink_call_dump(rtnl, req, 0, dump_handler, &counter) >= 0);
+
+        /* at least the loopback device exists, and interfaces might come and go in between */
+        assert_se(counter > 0);
+        log_debug("Dumped %u links, %u earlier", counter, expected);
+}
+
 static void test_message(sd_netlink *rtnl) {
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
 
@@ -574,10 +640,12 @@ int main(void) {
         test_slot_set(if_loopback);
         test_async_destroy_callback(if_loopback);
         test_pipe(if_loopback);
+        test_cork(if_loopback);
         test_event_loop(if_loopback);
         test_link_configure(rtnl, if_loopback);
 
         test_get_addresses(rtnl);
+        test_call_dump(rtnl);
         test_message_link_bridge(rtnl);
 
         assert_se(sd_rtnl_message_new_link(rtnl, &m, RTM_GETLINK, if_loopback) >= 0);
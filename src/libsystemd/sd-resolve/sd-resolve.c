@@ -29,6 +29,7 @@
 #define WORKERS_MIN 1U
 #define WORKERS_MAX 16U
 #define QUERIES_MAX 256U
+#define RESPONSES_PER_WAKEUP_MAX 64U
 #define BUFSIZE 10240U
 
 typedef enum {
@@ -1241,9 +1242,18 @@ static int io_callback(sd_event_source *s, int fd, uint32_t revents, void *userd
 
         assert(resolve);
 
-        r = sd_resolve_process(resolve);
-        if (r < 0)
-                return r;
+        RESOLVE_DONT_DESTROY(resolve);
+
+        /* When many queries are in flight their responses tend to arrive in bursts, hence process a bunch
+         * of them per wakeup instead of going through the event loop for each. The limit ensures we don't
+         * starve other event sources. */
+        for (unsigned i = 0; i < RESPONSES_PER_WAKEUP_MAX; i++) {
+                r = sd_resolve_process(resolve);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+        }
 
         return 1;
 }
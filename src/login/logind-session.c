@@ -1410,9 +1410,14 @@ void session_drop_controller(Session *s) {
                 return;
 
         s->track = sd_bus_track_unref(s->track);
-        session_set_type(s, s->original_type);
         session_release_controller(s, false);
-        session_save(s);
+
+        /* Resetting the type writes out the state file, hence only do it ourselves if that doesn't happen */
+        if (s->type != s->original_type)
+                session_set_type(s, s->original_type);
+        else
+                session_save(s);
+
         session_restore_vt(s);
 }
 
@@ -335,6 +335,10 @@ typedef struct LinkInfo {
         uint16_t ipvlan_mode;
         uint16_t ipvlan_flags;
 
+        /* setup durations */
+        usec_t pending_usec;
+        usec_t configuring_usec;
+
         /* ethtool info */
         int autonegotiation;
         uint64_t speed;
@@ -353,6 +357,7 @@ typedef struct LinkInfo {
         bool has_stats64:1;
         bool has_stats:1;
         bool has_bitrates:1;
+        bool has_setup_durations:1;
         bool has_ethtool_link_info:1;
         bool has_wlan_link_info:1;
         bool has_tunnel_ipv4:1;
@@ -671,6 +676,32 @@ static int acquire_link_bitrates(sd_bus *bus, LinkInfo *link) {
         return 0;
 }
 
+static int acquire_link_setup_durations(sd_bus *bus, LinkInfo *link) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        int r;
+
+        r = link_get_property(bus, link, &error, &reply, "org.freedesktop.network1.Link", "SetupDurations");
+        if (r < 0)
+                return log_debug_errno(r, "Failed to query link setup durations: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, 'v', "(tt)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_read(reply, "(tt)", &link->pending_usec, &link->configuring_usec);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        link->has_setup_durations = link->pending_usec != USEC_INFINITY || link->configuring_usec != USEC_INFINITY;
+
+        return 0;
+}
+
 static void acquire_ether_link_info(int *fd, LinkInfo *link) {
         if (ethtool_get_link_info(fd, link->name,
                                   &link->autonegotiation,
@@ -777,8 +808,10 @@ static int acquire_link_info(sd_bus *bus, sd_netlink *rtnl, char **patterns, Lin
         typesafe_qsort(links, c, link_info_compare);
 
         if (bus)
-                for (size_t j = 0; j < c; j++)
+                for (size_t j = 0; j < c; j++) {
                         (void) acquire_link_bitrates(bus, links + j);
+                        (void) acquire_link_setup_durations(bus, links + j);
+                }
 
         *ret = TAKE_PTR(links);
 
@@ -2133,6 +2166,19 @@ static int link_status_one(
                         return table_log_add_error(r);
         }
 
+        if (info->has_setup_durations) {
+                r = table_add_many(table,
+                                   TABLE_EMPTY,
+                                   TABLE_STRING, "Setup Time:");
+                if (r < 0)
+                        return table_log_add_error(r);
+                r = table_add_cell_stringf(table, NULL, "%s (udev), %s (configuring)",
+                                           info->pending_usec != USEC_INFINITY ? FORMAT_TIMESPAN(info->pending_usec, USEC_PER_MSEC) : "n/a",
+                                           info->configuring_usec != USEC_INFINITY ? FORMAT_TIMESPAN(info->configuring_usec, USEC_PER_MSEC) : "n/a");
+                if (r < 0)
+                        return table_log_add_error(r);
+        }
+
         if (info->has_tx_queues || info->has_rx_queues) {
                 r = table_add_many(table,
                                    TABLE_EMPTY,
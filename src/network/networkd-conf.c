@@ -8,6 +8,7 @@
 #include "networkd-conf.h"
 #include "networkd-manager.h"
 #include "networkd-speed-meter.h"
+#include "strv.h"
 
 int manager_parse_config_file(Manager *m) {
         int r;
@@ -28,10 +29,15 @@ int manager_parse_config_file(Manager *m) {
         if (r < 0)
                 return r;
 
-        if (m->use_speed_meter && m->speed_meter_interval_usec < SPEED_METER_MINIMUM_TIME_INTERVAL) {
-                log_warning("SpeedMeterIntervalSec= is too small, using %s.",
-                            FORMAT_TIMESPAN(SPEED_METER_MINIMUM_TIME_INTERVAL, USEC_PER_SEC));
-                m->speed_meter_interval_usec = SPEED_METER_MINIMUM_TIME_INTERVAL;
+        if (m->use_speed_meter) {
+                usec_t min = strv_isempty(m->speed_meter_interfaces) ?
+                        SPEED_METER_MINIMUM_TIME_INTERVAL : SPEED_METER_MINIMUM_TIME_INTERVAL_SELECTED;
+
+                if (m->speed_meter_interval_usec < min) {
+                        log_warning("SpeedMeterIntervalSec= is too small, using %s.",
+                                    FORMAT_TIMESPAN(min, USEC_PER_MSEC));
+                        m->speed_meter_interval_usec = min;
+                }
         }
 
         return 0;
@@ -37,14 +37,17 @@ static int device_build_json(sd_device *device, JsonVariant **ret) {
                                         JSON_BUILD_PAIR("Model", JSON_BUILD_STRING(model))));
 }
 
-int link_build_json(Link *link, JsonVariant **ret) {
+static int link_build_json_uncached(Link *link, JsonVariant **ret) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
         _cleanup_free_ char *type = NULL;
+        usec_t pending, configuring;
         int r;
 
         assert(link);
         assert(ret);
 
+        link_get_setup_durations(link, &pending, &configuring);
+
         r = link_get_type_string(link->sd_device, link->iftype, &type);
         if (r == -ENOMEM)
                 return r;
@@ -61,7 +64,9 @@ int link_build_json(Link *link, JsonVariant **ret) {
                                         JSON_BUILD_PAIR("AddressState", JSON_BUILD_STRING(link_address_state_to_string(link->address_state))),
                                         JSON_BUILD_PAIR("IPv4AddressState", JSON_BUILD_STRING(link_address_state_to_string(link->ipv4_address_state))),
                                         JSON_BUILD_PAIR("IPv6AddressState", JSON_BUILD_STRING(link_address_state_to_string(link->ipv6_address_state))),
-                                        JSON_BUILD_PAIR("OnlineState", JSON_BUILD_STRING(link_online_state_to_string(link->online_state)))));
+                                        JSON_BUILD_PAIR("OnlineState", JSON_BUILD_STRING(link_online_state_to_string(link->online_state))),
+                                        JSON_BUILD_PAIR_CONDITION(pending != USEC_INFINITY, "PendingUSec", JSON_BUILD_UNSIGNED(pending)),
+                                        JSON_BUILD_PAIR_CONDITION(configuring != USEC_INFINITY, "ConfiguringUSec", JSON_BUILD_UNSIGNED(configuring))));
         if (r < 0)
                 return r;
 
@@ -93,6 +98,23 @@ int link_build_json(Link *link, JsonVariant **ret) {
         return 0;
 }
 
+int link_build_json(Link *link, JsonVariant **ret) {
+        int r;
+
+        assert(link);
+        assert(ret);
+
+        /* networkctl asks for the description of all links at once, even if only few of them changed. */
+        if (!link->json) {
+                r = link_build_json_uncached(link, &link->json);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = json_variant_ref(link->json);
+        return 0;
+}
+
 static int link_json_compare(JsonVariant * const *a, JsonVariant * const *b) {
         intmax_t index_a, index_b;
 
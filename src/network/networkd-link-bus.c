@@ -68,6 +68,63 @@ static int property_get_bit_rates(
         return sd_bus_message_append(reply, "(tt)", tx, rx);
 }
 
+static int property_get_bit_rate_percentiles(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        static const unsigned percentiles[] = { 50, 90, 99, 100 };
+        Link *link = userdata;
+        int r;
+
+        assert(bus);
+        assert(reply);
+        assert(userdata);
+
+        r = sd_bus_message_open_container(reply, 'a', "(utt)");
+        if (r < 0)
+                return r;
+
+        if (link->manager->use_speed_meter)
+                for (size_t i = 0; i < ELEMENTSOF(percentiles); i++) {
+                        uint64_t tx, rx;
+
+                        if (speed_meter_ring_get_rates(link->speed_meter_ring, percentiles[i], &tx, &rx) < 0)
+                                break;
+
+                        r = sd_bus_message_append(reply, "(utt)", percentiles[i], tx, rx);
+                        if (r < 0)
+                                return r;
+                }
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int property_get_setup_durations(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Link *link = userdata;
+        usec_t pending, configuring;
+
+        assert(bus);
+        assert(reply);
+        assert(userdata);
+
+        link_get_setup_durations(link, &pending, &configuring);
+
+        return sd_bus_message_append(reply, "(tt)", (uint64_t) pending, (uint64_t) configuring);
+}
+
 static int verify_managed_link(Link *l, sd_bus_error *error) {
         assert(l);
 
@@ -720,6 +777,8 @@ const sd_bus_vtable link_vtable[] = {
         SD_BUS_PROPERTY("OnlineState", "s", property_get_online_state, offsetof(Link, online_state), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
         SD_BUS_PROPERTY("AdministrativeState", "s", property_get_administrative_state, offsetof(Link, state), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
         SD_BUS_PROPERTY("BitRates", "(tt)", property_get_bit_rates, 0, 0),
+        SD_BUS_PROPERTY("BitRatePercentiles", "a(utt)", property_get_bit_rate_percentiles, 0, 0),
+        SD_BUS_PROPERTY("SetupDurations", "(tt)", property_get_setup_durations, 0, 0),
 
         SD_BUS_METHOD_WITH_ARGS("SetNTP",
                                 SD_BUS_ARGS("as", servers),
@@ -267,6 +267,9 @@ static Link *link_free(Link *link) {
         unlink_and_free(link->lease_file);
         unlink_and_free(link->lldp_file);
         unlink_and_free(link->state_file);
+        free(link->saved_state);
+        json_variant_unref(link->json);
+        free(link->speed_meter_ring);
 
         sd_device_unref(link->sd_device);
 
@@ -349,11 +352,32 @@ void link_set_state(Link *link, LinkState state) {
                        link_state_to_string(state));
 
         link->state = state;
+        link->state_timestamps[state] = now(CLOCK_MONOTONIC);
 
         link_send_changed(link, "AdministrativeState", NULL);
         link_dirty(link);
 }
 
+static usec_t link_state_duration(Link *link, LinkState from, LinkState to) {
+        assert(link);
+
+        /* The link may be reconfigured, hence only report a duration if the later state was entered after
+         * the earlier state was entered the last time. */
+        if (link->state_timestamps[from] == 0 || link->state_timestamps[to] < link->state_timestamps[from])
+                return USEC_INFINITY;
+
+        return link->state_timestamps[to] - link->state_timestamps[from];
+}
+
+void link_get_setup_durations(Link *link, usec_t *ret_pending, usec_t *ret_configuring) {
+        assert(link);
+        assert(ret_pending);
+        assert(ret_configuring);
+
+        *ret_pending = link_state_duration(link, LINK_STATE_PENDING, LINK_STATE_INITIALIZED);
+        *ret_configuring = link_state_duration(link, LINK_STATE_CONFIGURING, LINK_STATE_CONFIGURED);
+}
+
 int link_stop_engines(Link *link, bool may_keep_dhcp) {
         int r = 0, k;
 
@@ -978,6 +1002,7 @@ static Link *link_drop(Link *link) {
         link_unref(set_remove(link->manager->links_requesting_uuid, link));
 
         (void) unlink(link->state_file);
+        link->saved_state = mfree(link->saved_state);
         link_clean(link);
 
         STRV_FOREACH(n, link->alternative_names)
@@ -1410,6 +1435,7 @@ static int link_initialized(Link *link, sd_device *device) {
         link_set_state(link, LINK_STATE_INITIALIZED);
 
         link->sd_device = sd_device_ref(device);
+        link->json = json_variant_unref(link->json);
 
         /* udev has initialized the link, but we don't know if we have yet
          * processed the NEWLINK messages with the latest state. Do a GETLINK,
@@ -2256,6 +2282,9 @@ static int link_update(Link *link, sd_netlink_message *message) {
         assert(link);
         assert(message);
 
+        /* Names, driver etc. are part of the JSON description, but do not necessarily mark the link dirty. */
+        link->json = json_variant_unref(link->json);
+
         r = link_update_name(link, message);
         if (r < 0)
                 return r;
@@ -2340,6 +2369,7 @@ static int link_new(Manager *manager, sd_netlink_message *message, Link **ret) {
         *link = (Link) {
                 .n_ref = 1,
                 .state = LINK_STATE_PENDING,
+                .state_timestamps[LINK_STATE_PENDING] = now(CLOCK_MONOTONIC),
                 .online_state = _LINK_ONLINE_STATE_INVALID,
                 .ifindex = ifindex,
                 .iftype = iftype,
@@ -17,8 +17,10 @@
 #include "sd-netlink.h"
 
 #include "ether-addr-util.h"
+#include "json.h"
 #include "log-link.h"
 #include "network-util.h"
+#include "networkd-speed-meter.h"
 #include "networkd-util.h"
 #include "ordered-set.h"
 #include "resolve-util.h"
@@ -53,6 +55,8 @@ typedef struct Link {
         char *kind;
         unsigned short iftype;
         char *state_file;
+        char *saved_state; /* what was written to state_file last time */
+        JsonVariant *json; /* cached description, invalidated by link_dirty() */
         struct hw_addr_data hw_addr;
         struct hw_addr_data bcast_addr;
         struct ether_addr permanent_mac;
@@ -82,6 +86,14 @@ typedef struct Link {
         LinkAddressState ipv6_address_state;
         LinkOnlineState online_state;
 
+        /* When the link entered each setup state the last time, in CLOCK_MONOTONIC. For
+         * LINK_STATE_PENDING, this is when the link appeared. */
+        usec_t state_timestamps[_LINK_STATE_MAX];
+
+        /* For spreading the request queue processing fairly over links, see manager_process_requests(). */
+        unsigned request_pass;
+        unsigned n_requests_in_pass;
+
         unsigned static_address_messages;
         unsigned static_address_label_messages;
         unsigned static_bridge_fdb_messages;
@@ -189,6 +201,7 @@ typedef struct Link {
         /* For speed meter */
         struct rtnl_link_stats64 stats_old, stats_new;
         bool stats_updated;
+        SpeedMeterRing *speed_meter_ring;
 
         /* All kinds of DNS configuration the user configured via D-Bus */
         struct in_addr_full **dns;
@@ -228,6 +241,7 @@ int link_handle_bound_to_list(Link *link);
 
 void link_enter_failed(Link *link);
 void link_set_state(Link *link, LinkState state);
+void link_get_setup_durations(Link *link, usec_t *ret_pending, usec_t *ret_configuring);
 void link_check_ready(Link *link);
 
 void link_update_operstate(Link *link, bool also_update_bond_master);
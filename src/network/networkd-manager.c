@@ -450,6 +450,7 @@ Manager* manager_free(Manager *m) {
                 return NULL;
 
         free(m->state_file);
+        free(m->saved_state);
 
         HASHMAP_FOREACH(link, m->links_by_index)
                 (void) link_stop_engines(link, true);
@@ -474,6 +475,9 @@ Manager* manager_free(Manager *m) {
         hashmap_free(m->route_table_names_by_number);
         hashmap_free(m->route_table_numbers_by_name);
 
+        set_free(m->ignore_foreign_route_protocols);
+        set_free(m->ignore_foreign_route_tables);
+
         /* routing_policy_rule_free() access m->rules and m->rules_foreign.
          * So, it is necessary to set NULL after the sets are freed. */
         m->rules = set_free(m->rules);
@@ -495,6 +499,7 @@ Manager* manager_free(Manager *m) {
         m->nexthops_by_id = hashmap_free(m->nexthops_by_id);
 
         sd_event_source_unref(m->speed_meter_event_source);
+        strv_free(m->speed_meter_interfaces);
         sd_event_unref(m->event);
 
         sd_device_monitor_unref(m->device_monitor);
@@ -559,13 +564,39 @@ bool manager_should_reload(Manager *m) {
         return paths_check_timestamp(NETWORK_DIRS, &m->network_dirs_ts_usec, false);
 }
 
+typedef struct EnumerateContext {
+        Manager *manager;
+        int (*process)(sd_netlink *, sd_netlink_message *, Manager *);
+        int error;
+} EnumerateContext;
+
+static int manager_enumerate_one(sd_netlink *rtnl, sd_netlink_message *message, void *userdata) {
+        EnumerateContext *c = userdata;
+        int r;
+
+        assert(c);
+
+        c->manager->enumerating = true;
+        r = c->process(rtnl, message, c->manager);
+        c->manager->enumerating = false;
+
+        /* Keep kernel errors and our own apart, see below. */
+        if (r < 0 && c->error >= 0)
+                c->error = r;
+
+        return 0;
+}
+
 static int manager_enumerate_internal(
                 Manager *m,
                 sd_netlink_message *req,
                 int (*process)(sd_netlink *, sd_netlink_message *, Manager *),
                 const char *name) {
 
-        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *reply = NULL;
+        EnumerateContext c = {
+                .manager = m,
+                .process = process,
+        };
         int r;
 
         assert(m);
@@ -577,29 +608,17 @@ static int manager_enumerate_internal(
         if (r < 0)
                 return r;
 
-        r = sd_netlink_call(m->rtnl, req, 0, &reply);
-        if (r < 0) {
-                if (name && (r == -EOPNOTSUPP || (r == -EINVAL && mac_selinux_enforcing()))) {
-                        log_debug_errno(r, "%s are not supported by the kernel. Ignoring.", name);
-                        return 0;
-                }
-
-                return r;
-        }
-
-        for (sd_netlink_message *reply_one = reply; reply_one; reply_one = sd_netlink_message_next(reply_one)) {
-                int k;
-
-                m->enumerating = true;
-
-                k = process(m->rtnl, reply_one, m);
-                if (k < 0 && r >= 0)
-                        r = k;
-
-                m->enumerating = false;
+        /* Routing tables and neighbor caches may be huge, hence process the dump while it is received
+         * rather than collecting it first. */
+        r = sd_netlink_call_dump(m->rtnl, req, 0, manager_enumerate_one, &c);
+        if (r < 0 && name && (r == -EOPNOTSUPP || (r == -EINVAL && mac_selinux_enforcing()))) {
+                log_debug_errno(r, "%s are not supported by the kernel. Ignoring.", name);
+                return 0;
         }
+        if (r < 0)
+                return r;
 
-        return r;
+        return c.error;
 }
 
 static int manager_enumerate_links(Manager *m) {
@@ -34,9 +34,14 @@ struct Manager {
         bool manage_foreign_routes;
         bool manage_foreign_rules;
 
+        /* Foreign routes with these protocols or in these tables are not tracked at all */
+        Set *ignore_foreign_route_protocols;
+        Set *ignore_foreign_route_tables;
+
         Set *dirty_links;
 
         char *state_file;
+        char *saved_state; /* what was written to state_file last time */
         LinkOperationalState operational_state;
         LinkCarrierState carrier_state;
         LinkAddressState address_state;
@@ -92,6 +97,7 @@ struct Manager {
         usec_t speed_meter_interval_usec;
         usec_t speed_meter_usec_new;
         usec_t speed_meter_usec_old;
+        char **speed_meter_interfaces;
 
         bool dhcp4_prefix_root_cannot_set_table;
         bool bridge_mdb_on_master_not_supported;
@@ -99,6 +105,7 @@ struct Manager {
         FirewallContext *fw_ctx;
 
         OrderedSet *request_queue;
+        unsigned request_pass;
 };
 
 int manager_new(Manager **ret);
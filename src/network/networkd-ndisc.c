@@ -283,6 +283,22 @@ static int ndisc_remove_old(Link *link) {
         return r;
 }
 
+static bool ndisc_lifetime_needs_refresh(usec_t current, usec_t advertised, usec_t time_now) {
+        /* Routers usually advertise the same lifetimes again and again, hence the deadline moves forward
+         * with every RA. Refreshing it in the kernel each time would mean one netlink message per address
+         * and route for every RA, so only do that when less than half of the advertised lifetime is left.
+         * A shortened lifetime is always applied immediately. */
+
+        if (advertised < current)
+                return true;
+        if (current == USEC_INFINITY)
+                return false;
+        if (advertised == USEC_INFINITY)
+                return true;
+
+        return usec_sub_unsigned(current, time_now) < usec_sub_unsigned(advertised, time_now) / 2;
+}
+
 static void ndisc_route_hash_func(const NDiscRoute *x, struct siphash *state) {
         route_hash_func(x->route, state);
 }
@@ -355,12 +371,18 @@ static int ndisc_after_route_configure(Request *req, void *object) {
         *nr = (NDiscRoute) {
                 .router = router,
                 .route = route,
+                .lifetime = req->route->lifetime,
+                .mtu = req->route->mtu,
+                .pref = req->route->pref,
         };
 
         nr_exist = set_get(link->ndisc_routes, nr);
         if (nr_exist) {
                 nr_exist->marked = false;
                 nr_exist->router = router;
+                nr_exist->lifetime = nr->lifetime;
+                nr_exist->mtu = nr->mtu;
+                nr_exist->pref = nr->pref;
                 return 0;
         }
 
@@ -379,8 +401,38 @@ static void ndisc_request_on_free(Request *req) {
         sd_ndisc_router_unref(req->userdata);
 }
 
+static bool ndisc_route_is_unchanged(Link *link, const Route *route, sd_ndisc_router *rt) {
+        struct in6_addr router;
+        usec_t time_now;
+        NDiscRoute *nr;
+
+        assert(link);
+        assert(route);
+        assert(rt);
+
+        /* Returns true when the route was already configured from a previous RA of the same router, and
+         * neither its attributes nor (significantly) its lifetime changed. */
+
+        nr = set_get(link->ndisc_routes, &(NDiscRoute) { .route = (Route*) route });
+        if (!nr)
+                return false;
+
+        if (sd_ndisc_router_get_address(rt, &router) < 0 ||
+            !in6_addr_equal(&nr->router, &router))
+                return false;
+
+        if (nr->mtu != route->mtu || nr->pref != route->pref)
+                return false;
+
+        if (sd_ndisc_router_get_timestamp(rt, clock_boottime_or_monotonic(), &time_now) < 0)
+                return false;
+
+        return !ndisc_lifetime_needs_refresh(nr->lifetime, route->lifetime, time_now);
+}
+
 static int ndisc_request_route(Route *in, Link *link, sd_ndisc_router *rt) {
         _cleanup_(route_freep) Route *route = in;
+        NDiscRoute *nr;
         Request *req;
         int r;
 
@@ -393,6 +445,12 @@ static int ndisc_request_route(Route *in, Link *link, sd_ndisc_router *rt) {
                 return r;
         if (r == 0)
                 link->ndisc_routes_configured = false;
+        else if (ndisc_route_is_unchanged(link, route, rt)) {
+                /* Keep the route, but do not bother the kernel with it. */
+                nr = set_get(link->ndisc_routes, &(NDiscRoute) { .route = route });
+                nr->marked = false;
+                return 0;
+        }
 
         r = link_request_route(link, TAKE_PTR(route), true, &link->ndisc_routes_messages,
                                ndisc_route_handler, &req);
@@ -447,12 +505,20 @@ static int ndisc_address_handler(sd_netlink *rtnl, sd_netlink_message *m, Link *
         return 1;
 }
 
+static usec_t ndisc_address_lifetime_to_usec(uint32_t lifetime, usec_t time_now) {
+        if (lifetime == CACHE_INFO_INFINITY_LIFE_TIME)
+                return USEC_INFINITY;
+
+        return usec_add(time_now, lifetime * USEC_PER_SEC);
+}
+
 static int ndisc_after_address_configure(Request *req, void *object) {
         _cleanup_free_ NDiscAddress *na = NULL;
         NDiscAddress *na_exist;
         struct in6_addr router;
         sd_ndisc_router *rt;
         Address *address = object;
+        usec_t time_now;
         Link *link;
         int r;
 
@@ -469,6 +535,10 @@ static int ndisc_after_address_configure(Request *req, void *object) {
         if (r < 0)
                 return log_link_error_errno(link, r, "Failed to get router address from RA: %m");
 
+        r = sd_ndisc_router_get_timestamp(rt, CLOCK_MONOTONIC, &time_now);
+        if (r < 0)
+                return log_link_error_errno(link, r, "Failed to get RA timestamp: %m");
+
         na = new(NDiscAddress, 1);
         if (!na)
                 return log_oom();
@@ -476,12 +546,16 @@ static int ndisc_after_address_configure(Request *req, void *object) {
         *na = (NDiscAddress) {
                 .router = router,
                 .address = address,
+                .valid_until = ndisc_address_lifetime_to_usec(req->address->cinfo.ifa_valid, time_now),
+                .preferred_until = ndisc_address_lifetime_to_usec(req->address->cinfo.ifa_prefered, time_now),
         };
 
         na_exist = set_get(link->ndisc_addresses, na);
         if (na_exist) {
                 na_exist->marked = false;
                 na_exist->router = router;
+                na_exist->valid_until = na->valid_until;
+                na_exist->preferred_until = na->preferred_until;
                 return 0;
         }
 
@@ -494,8 +568,40 @@ static int ndisc_after_address_configure(Request *req, void *object) {
         return 0;
 }
 
+static bool ndisc_address_is_unchanged(Link *link, const Address *address, sd_ndisc_router *rt) {
+        struct in6_addr router;
+        NDiscAddress *na;
+        usec_t time_now;
+
+        assert(link);
+        assert(address);
+        assert(rt);
+
+        /* Returns true when the address was already configured from a previous RA of the same router, and
+         * its lifetimes did not change significantly. */
+
+        na = set_get(link->ndisc_addresses, &(NDiscAddress) { .address = (Address*) address });
+        if (!na)
+                return false;
+
+        if (sd_ndisc_router_get_address(rt, &router) < 0 ||
+            !in6_addr_equal(&na->router, &router))
+                return false;
+
+        if (sd_ndisc_router_get_timestamp(rt, CLOCK_MONOTONIC, &time_now) < 0)
+                return false;
+
+        return !ndisc_lifetime_needs_refresh(na->valid_until,
+                                             ndisc_address_lifetime_to_usec(address->cinfo.ifa_valid, time_now),
+                                             time_now) &&
+               !ndisc_lifetime_needs_refresh(na->preferred_until,
+                                             ndisc_address_lifetime_to_usec(address->cinfo.ifa_prefered, time_now),
+                                             time_now);
+}
+
 static int ndisc_request_address(Address *in, Link *link, sd_ndisc_router *rt) {
         _cleanup_(address_freep) Address *address = in;
+        NDiscAddress *na;
         Request *req;
         int r;
 
@@ -505,6 +611,12 @@ static int ndisc_request_address(Address *in, Link *link, sd_ndisc_router *rt) {
 
         if (address_get(link, address, NULL) < 0)
                 link->ndisc_addresses_configured = false;
+        else if (ndisc_address_is_unchanged(link, address, rt)) {
+                /* Keep the address, but do not bother the kernel with it. */
+                na = set_get(link->ndisc_addresses, &(NDiscAddress) { .address = address });
+                na->marked = false;
+                return 0;
+        }
 
         r = link_request_address(link, TAKE_PTR(address), true, &link->ndisc_addresses_messages,
                                  ndisc_address_handler, &req);
@@ -30,6 +30,9 @@ typedef struct NDiscAddress {
         bool marked;
         struct in6_addr router;
         Address *address;
+        /* The lifetimes last passed to the kernel, to avoid refreshing them on every RA. */
+        usec_t valid_until;
+        usec_t preferred_until;
 } NDiscAddress;
 
 typedef struct NDiscRoute {
@@ -37,6 +40,10 @@ typedef struct NDiscRoute {
         bool marked;
         struct in6_addr router;
         Route *route;
+        /* The attributes last passed to the kernel, which are not part of the route's hash. */
+        usec_t lifetime;
+        uint32_t mtu;
+        unsigned char pref;
 } NDiscRoute;
 
 typedef struct NDiscRDNSS {
@@ -14,6 +14,10 @@
 #include "networkd-queue.h"
 #include "networkd-setlink.h"
 
+/* How many requests of one link are processed in one pass over the request queue, before the requests of
+ * the other links get their turn. */
+#define LINK_REQUESTS_PER_PASS_MAX 64U
+
 static void request_free_object(RequestType type, void *object) {
         switch(type) {
         case REQUEST_TYPE_ACTIVATE_LINK:
@@ -273,11 +277,30 @@ int manager_process_requests(sd_event_source *s, void *userdata) {
 
         assert(manager);
 
+        /* Requests are usually processed in bursts, e.g. when a link is configured. Write all netlink
+         * messages of one run with as few sendmsg() calls as possible. */
+        (void) sd_netlink_cork(manager->rtnl);
+
         for (;;) {
                 bool processed = false;
                 Request *req;
 
+                /* The requests of all links share one queue in the order they were made. Without a limit,
+                 * a link with thousands of routes would keep all links queued after it waiting until its
+                 * routes are sent, although their configuration does not depend on each other. */
+                manager->request_pass++;
+
                 ORDERED_SET_FOREACH(req, manager->request_queue) {
+                        Link *link = req->link;
+
+                        if (link->request_pass != manager->request_pass) {
+                                link->request_pass = manager->request_pass;
+                                link->n_requests_in_pass = 0;
+                        }
+
+                        if (link->n_requests_in_pass >= LINK_REQUESTS_PER_PASS_MAX)
+                                continue;
+
                         switch(req->type) {
                         case REQUEST_TYPE_ACTIVATE_LINK:
                                 r = request_process_activation(req);
@@ -325,11 +348,13 @@ int manager_process_requests(sd_event_source *s, void *userdata) {
                                 r = request_process_link_up_or_down(req);
                                 break;
                         default:
-                                return -EINVAL;
+                                r = -EINVAL;
+                                goto finalize;
                         }
                         if (r < 0)
                                 link_enter_failed(req->link);
                         if (r > 0) {
+                                link->n_requests_in_pass++;
                                 ordered_set_remove(manager->request_queue, req);
                                 request_free(req);
                                 processed = true;
@@ -340,5 +365,9 @@ int manager_process_requests(sd_event_source *s, void *userdata) {
                         break;
         }
 
-        return 0;
+        r = 0;
+
+finalize:
+        (void) sd_netlink_uncork(manager->rtnl);
+        return r;
 }
@@ -167,6 +167,7 @@ static const char * const route_protocol_full_table[] = {
 };
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING_FALLBACK(route_protocol_full, int, UINT8_MAX);
+DEFINE_PRIVATE_STRING_TABLE_LOOKUP_FROM_STRING_FALLBACK(route_protocol_full, int, UINT8_MAX);
 
 static unsigned routes_max(void) {
         static thread_local unsigned cached = 0;
@@ -584,31 +585,24 @@ static int route_add_foreign(Manager *manager, Link *link, const Route *in, Rout
 }
 
 static int route_add(Manager *manager, Link *link, const Route *in, const MultipathRoute *m, const NextHop *nh, uint8_t nh_weight, Route **ret) {
-        _cleanup_(route_freep) Route *tmp = NULL;
-        Route *route;
+        Route tmp, *route;
         int r;
 
         assert(manager || link);
         assert(in);
 
+        /* The temporary route is only used for the lookup below and copied by route_add_internal(), both
+         * of which only need the entries set by route_copy(), hence it does not need to be allocated. */
         if (nh) {
                 assert(hashmap_isempty(nh->group));
 
-                r = route_new(&tmp);
-                if (r < 0)
-                        return r;
-
-                route_copy(tmp, in, NULL, nh, nh_weight);
-                in = tmp;
+                route_copy(&tmp, in, NULL, nh, nh_weight);
+                in = &tmp;
         } else if (m) {
                 assert(link && (m->ifindex == 0 || m->ifindex == link->ifindex));
 
-                r = route_new(&tmp);
-                if (r < 0)
-                        return r;
-
-                route_copy(tmp, in, m, NULL, UINT8_MAX);
-                in = tmp;
+                route_copy(&tmp, in, m, NULL, UINT8_MAX);
+                in = &tmp;
         }
 
         r = route_get(manager, link, in, &route);
@@ -642,23 +636,19 @@ static bool route_type_is_reject(const Route *route) {
 }
 
 static int link_has_route_one(Link *link, const Route *route, const NextHop *nh, uint8_t nh_weight) {
-        _cleanup_(route_freep) Route *tmp = NULL;
-        int r;
+        Route tmp;
 
         assert(link);
         assert(route);
         assert(nh);
 
-        r = route_new(&tmp);
-        if (r < 0)
-                return r;
-
-        route_copy(tmp, route, NULL, nh, nh_weight);
+        /* Only used for the lookup, so the entries set by route_copy() are sufficient. */
+        route_copy(&tmp, route, NULL, nh, nh_weight);
 
         if (route_type_is_reject(route) || (nh && nh->blackhole))
-                return route_get(link->manager, NULL, tmp, NULL) >= 0;
+                return route_get(link->manager, NULL, &tmp, NULL) >= 0;
         else
-                return route_get(NULL, link, tmp, NULL) >= 0;
+                return route_get(NULL, link, &tmp, NULL) >= 0;
 }
 
 int link_has_route(Link *link, const Route *route) {
@@ -700,7 +690,7 @@ int link_has_route(Link *link, const Route *route) {
         }
 
         ORDERED_SET_FOREACH(m, route->multipath_routes) {
-                _cleanup_(route_freep) Route *tmp = NULL;
+                Route tmp;
                 Link *l;
 
                 if (m->ifname) {
@@ -711,13 +701,9 @@ int link_has_route(Link *link, const Route *route) {
                 } else
                         l = link;
 
-                r = route_new(&tmp);
-                if (r < 0)
-                        return r;
-
-                route_copy(tmp, route, m, NULL, UINT8_MAX);
+                route_copy(&tmp, route, m, NULL, UINT8_MAX);
 
-                if (route_get(NULL, l, tmp, NULL) < 0)
+                if (route_get(NULL, l, &tmp, NULL) < 0)
                         return false;
         }
 
@@ -1887,6 +1873,34 @@ static int process_route_one(Manager *manager, Link *link, uint16_t type, const
         return 1;
 }
 
+static bool manager_ignores_foreign_route(Manager *m, sd_netlink_message *message) {
+        unsigned char protocol, table_compat;
+        uint32_t table;
+
+        assert(m);
+        assert(message);
+
+        /* This is checked before anything else is read from the message, so that routers with huge
+         * routing tables installed by routing daemons don't need to pay for parsing and storing them. */
+
+        if (set_isempty(m->ignore_foreign_route_protocols) && set_isempty(m->ignore_foreign_route_tables))
+                return false;
+
+        if (sd_rtnl_message_route_get_protocol(message, &protocol) >= 0 &&
+            set_contains(m->ignore_foreign_route_protocols, UINT_TO_PTR(protocol)))
+                return true;
+
+        /* Tables above 255 are only found in RTA_TABLE */
+        if (sd_netlink_message_read_u32(message, RTA_TABLE, &table) < 0) {
+                if (sd_rtnl_message_route_get_table(message, &table_compat) < 0)
+                        return false;
+
+                table = table_compat;
+        }
+
+        return set_contains(m->ignore_foreign_route_tables, UINT32_TO_PTR(table));
+}
+
 int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, Manager *m) {
         _cleanup_ordered_set_free_free_ OrderedSet *multipath_routes = NULL;
         _cleanup_(route_freep) Route *tmp = NULL;
@@ -1919,6 +1933,9 @@ int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, Ma
                 return 0;
         }
 
+        if (manager_ignores_foreign_route(m, message))
+                return 0;
+
         r = sd_netlink_message_read_u32(message, RTA_OIF, &ifindex);
         if (r < 0 && r != -ENODATA) {
                 log_warning_errno(r, "rtnl: could not get ifindex from route message, ignoring: %m");
@@ -3216,3 +3233,127 @@ void network_drop_invalid_routes(Network *network) {
                 if (route_section_verify(route, network) < 0)
                         route_free(route);
 }
+
+int config_parse_ignore_foreign_route_protocols(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        Set **protocols = data;
+        int r;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(data);
+
+        if (isempty(rvalue)) {
+                *protocols = set_free(*protocols);
+                return 0;
+        }
+
+        for (const char *p = rvalue;;) {
+                _cleanup_free_ char *word = NULL;
+                int protocol;
+
+                r = extract_first_word(&p, &word, NULL, 0);
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, r,
+                                   "Invalid %s=, ignoring assignment: %s", lvalue, rvalue);
+                        return 0;
+                }
+                if (r == 0)
+                        return 0;
+
+                protocol = route_protocol_full_from_string(word);
+                if (protocol < 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, protocol,
+                                   "Failed to parse route protocol \"%s\", ignoring: %m", word);
+                        continue;
+                }
+                if (IN_SET(protocol, RTPROT_UNSPEC, RTPROT_KERNEL)) {
+                        log_syntax(unit, LOG_WARNING, filename, line, 0,
+                                   "Routes with protocol \"%s\" cannot be ignored, ignoring.", word);
+                        continue;
+                }
+
+                r = set_ensure_put(protocols, NULL, UINT_TO_PTR(protocol));
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0)
+                        log_syntax(unit, LOG_WARNING, filename, line, r,
+                                   "Failed to store route protocol \"%s\", ignoring: %m", word);
+        }
+}
+
+int config_parse_ignore_foreign_route_tables(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        Set **tables = data;
+        Manager *m = userdata;
+        int r;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(data);
+        assert(userdata);
+
+        if (isempty(rvalue)) {
+                *tables = set_free(*tables);
+                return 0;
+        }
+
+        for (const char *p = rvalue;;) {
+                _cleanup_free_ char *word = NULL;
+                uint32_t table;
+
+                r = extract_first_word(&p, &word, NULL, 0);
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, r,
+                                   "Invalid %s=, ignoring assignment: %s", lvalue, rvalue);
+                        return 0;
+                }
+                if (r == 0)
+                        return 0;
+
+                r = manager_get_route_table_from_string(m, word, &table);
+                if (r < 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, r,
+                                   "Failed to parse route table \"%s\", ignoring: %m", word);
+                        continue;
+                }
+                if (table == 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, 0,
+                                   "Invalid route table number, ignoring: %s", word);
+                        continue;
+                }
+
+                r = set_ensure_put(tables, NULL, UINT32_TO_PTR(table));
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0)
+                        log_syntax(unit, LOG_WARNING, filename, line, r,
+                                   "Failed to store route table \"%s\", ignoring: %m", word);
+        }
+}
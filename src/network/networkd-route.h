@@ -121,4 +121,6 @@ CONFIG_PARSER_PROTOTYPE(config_parse_route_mtu);
 CONFIG_PARSER_PROTOTYPE(config_parse_multipath_route);
 CONFIG_PARSER_PROTOTYPE(config_parse_tcp_advmss);
 CONFIG_PARSER_PROTOTYPE(config_parse_route_table_names);
+CONFIG_PARSER_PROTOTYPE(config_parse_ignore_foreign_route_protocols);
+CONFIG_PARSER_PROTOTYPE(config_parse_ignore_foreign_route_tables);
 CONFIG_PARSER_PROTOTYPE(config_parse_route_nexthop);
@@ -5,10 +5,98 @@
 #include "sd-event.h"
 #include "sd-netlink.h"
 
+#include "alloc-util.h"
 #include "networkd-link-bus.h"
 #include "networkd-link.h"
 #include "networkd-manager.h"
 #include "networkd-speed-meter.h"
+#include "netlink-util.h"
+#include "sort-util.h"
+#include "strv.h"
+
+int speed_meter_ring_add(SpeedMeterRing **ring, usec_t timestamp, const struct rtnl_link_stats64 *stats) {
+        SpeedMeterRing *r;
+
+        assert(ring);
+        assert(stats);
+
+        if (!*ring) {
+                *ring = new0(SpeedMeterRing, 1);
+                if (!*ring)
+                        return -ENOMEM;
+        }
+
+        r = *ring;
+
+        r->samples[r->next] = (SpeedMeterSample) {
+                .timestamp = timestamp,
+                .tx_bytes = stats->tx_bytes,
+                .rx_bytes = stats->rx_bytes,
+        };
+
+        r->next = (r->next + 1) % SPEED_METER_SAMPLES_MAX;
+        r->n_samples = MIN(r->n_samples + 1, SPEED_METER_SAMPLES_MAX);
+
+        return 0;
+}
+
+static int uint64_compare(const uint64_t *a, const uint64_t *b) {
+        return CMP(*a, *b);
+}
+
+int speed_meter_ring_get_rates(const SpeedMeterRing *ring, unsigned percent, uint64_t *ret_tx, uint64_t *ret_rx) {
+        uint64_t tx[SPEED_METER_SAMPLES_MAX], rx[SPEED_METER_SAMPLES_MAX];
+        size_t n = 0, first, i;
+
+        assert(percent > 0 && percent <= 100);
+        assert(ret_tx);
+        assert(ret_rx);
+
+        /* Returns the given percentile of the transfer rates in bytes per second between subsequent
+         * samples, for transmitted and received bytes separately. */
+
+        if (!ring || ring->n_samples < 2)
+                return -ENODATA;
+
+        first = (ring->next + SPEED_METER_SAMPLES_MAX - ring->n_samples) % SPEED_METER_SAMPLES_MAX;
+
+        for (size_t k = 1; k < ring->n_samples; k++) {
+                const SpeedMeterSample
+                        *a = ring->samples + (first + k - 1) % SPEED_METER_SAMPLES_MAX,
+                        *b = ring->samples + (first + k) % SPEED_METER_SAMPLES_MAX;
+
+                /* Skip intervals in which the counters were reset. */
+                if (b->timestamp <= a->timestamp || b->tx_bytes < a->tx_bytes || b->rx_bytes < a->rx_bytes)
+                        continue;
+
+                tx[n] = (uint64_t) ((double) (b->tx_bytes - a->tx_bytes) * USEC_PER_SEC / (b->timestamp - a->timestamp));
+                rx[n] = (uint64_t) ((double) (b->rx_bytes - a->rx_bytes) * USEC_PER_SEC / (b->timestamp - a->timestamp));
+                n++;
+        }
+
+        if (n == 0)
+                return -ENODATA;
+
+        typesafe_qsort(tx, n, uint64_compare);
+        typesafe_qsort(rx, n, uint64_compare);
+
+        i = DIV_ROUND_UP(n * percent, 100U) - 1;
+
+        *ret_tx = tx[i];
+        *ret_rx = rx[i];
+        return 0;
+}
+
+bool link_speed_meter_selected(Link *link) {
+        assert(link);
+        assert(link->manager);
+
+        if (strv_isempty(link->manager->speed_meter_interfaces))
+                return true;
+
+        return strv_contains(link->manager->speed_meter_interfaces, link->ifname) ||
+                strv_overlap(link->manager->speed_meter_interfaces, link->alternative_names);
+}
 
 static int process_message(Manager *manager, sd_netlink_message *message) {
         uint16_t type;
@@ -38,6 +126,49 @@ static int process_message(Manager *manager, sd_netlink_message *message) {
 
         link->stats_updated = true;
 
+        r = speed_meter_ring_add(&link->speed_meter_ring, now(CLOCK_MONOTONIC), &link->stats_new);
+        if (r < 0)
+                return log_oom();
+
+        return 0;
+}
+
+static int speed_meter_link_handler(sd_netlink *rtnl, sd_netlink_message *m, Link *link) {
+        int r;
+
+        assert(m);
+        assert(link);
+
+        if (IN_SET(link->state, LINK_STATE_FAILED, LINK_STATE_LINGER))
+                return 0;
+
+        r = sd_netlink_message_get_errno(m);
+        if (r < 0) {
+                log_link_debug_errno(link, r, "Failed to get link statistics, ignoring: %m");
+                return 0;
+        }
+
+        (void) process_message(link->manager, m);
+        return 0;
+}
+
+static int speed_meter_request_link(Link *link) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *req = NULL;
+        int r;
+
+        assert(link);
+        assert(link->manager);
+
+        r = sd_rtnl_message_new_link(link->manager->rtnl, &req, RTM_GETLINK, link->ifindex);
+        if (r < 0)
+                return r;
+
+        r = netlink_call_async(link->manager->rtnl, NULL, req, speed_meter_link_handler,
+                               link_netlink_destroy_callback, link);
+        if (r < 0)
+                return r;
+
+        link_ref(link);
         return 0;
 }
 
@@ -65,6 +196,20 @@ static int speed_meter_handler(sd_event_source *s, uint64_t usec, void *userdata
         HASHMAP_FOREACH(link, manager->links_by_index)
                 link->stats_updated = false;
 
+        if (!strv_isempty(manager->speed_meter_interfaces)) {
+                /* Only query the selected interfaces, rather than dumping all of them. */
+                HASHMAP_FOREACH(link, manager->links_by_index) {
+                        if (!link_speed_meter_selected(link))
+                                continue;
+
+                        r = speed_meter_request_link(link);
+                        if (r < 0)
+                                log_link_warning_errno(link, r, "Failed to request link statistics, ignoring: %m");
+                }
+
+                return 0;
+        }
+
         r = sd_rtnl_message_new_link(manager->rtnl, &req, RTM_GETLINK, 0);
         if (r < 0) {
                 log_warning_errno(r, "Failed to allocate RTM_GETLINK netlink message, ignoring: %m");
@@ -1,12 +1,40 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 #pragma once
 
+#include <linux/if_link.h>
+
+#include "time-util.h"
+
 /* Default interval is 10sec. The speed meter periodically make networkd
  * to be woke up. So, too small interval value is not desired.
  * We set the minimum value 100msec = 0.1sec. */
 #define SPEED_METER_DEFAULT_TIME_INTERVAL (10 * USEC_PER_SEC)
 #define SPEED_METER_MINIMUM_TIME_INTERVAL (100 * USEC_PER_MSEC)
+/* When only selected interfaces are measured, each tick only queries those, hence allow more frequent
+ * sampling. */
+#define SPEED_METER_MINIMUM_TIME_INTERVAL_SELECTED (10 * USEC_PER_MSEC)
 
+/* The number of samples kept per interface. */
+#define SPEED_METER_SAMPLES_MAX 128U
+
+typedef struct Link Link;
 typedef struct Manager Manager;
 
+typedef struct SpeedMeterSample {
+        usec_t timestamp;
+        uint64_t tx_bytes;
+        uint64_t rx_bytes;
+} SpeedMeterSample;
+
+typedef struct SpeedMeterRing {
+        SpeedMeterSample samples[SPEED_METER_SAMPLES_MAX];
+        size_t n_samples;
+        size_t next; /* the slot the next sample is written to */
+} SpeedMeterRing;
+
+int speed_meter_ring_add(SpeedMeterRing **ring, usec_t timestamp, const struct rtnl_link_stats64 *stats);
+int speed_meter_ring_get_rates(const SpeedMeterRing *ring, unsigned percent, uint64_t *ret_tx, uint64_t *ret_rx);
+
+bool link_speed_meter_selected(Link *link);
+
 int manager_start_speed_meter(Manager *m);
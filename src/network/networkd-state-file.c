@@ -103,6 +103,42 @@ static int ordered_set_put_in4_addrv(
         return c;
 }
 
+static int state_file_write(const char *path, char **saved, const char *contents, size_t size) {
+        _cleanup_(unlink_and_freep) char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        int r;
+
+        assert(path);
+        assert(saved);
+        assert(contents);
+
+        /* Many events (e.g. address lifetime updates) mark links dirty without changing anything that is
+         * serialized. Compare with what we wrote last time, and leave the file alone if nothing changed,
+         * so that neither we nor the readers watching the directory with inotify do any work. */
+        if (streq_ptr(*saved, contents))
+                return 0;
+
+        r = fopen_temporary(path, &f, &temp_path);
+        if (r < 0)
+                return r;
+
+        (void) fchmod(fileno(f), 0644);
+
+        fwrite(contents, 1, size, f);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        r = conservative_rename(temp_path, path);
+        if (r < 0)
+                return r;
+
+        temp_path = mfree(temp_path);
+
+        return free_and_strdup(saved, contents);
+}
+
 int manager_save(Manager *m) {
         _cleanup_ordered_set_free_ OrderedSet *dns = NULL, *ntp = NULL, *sip = NULL, *search_domains = NULL, *route_domains = NULL;
         const char *operstate_str, *carrier_state_str, *address_state_str, *ipv4_address_state_str, *ipv6_address_state_str, *online_state_str;
@@ -112,9 +148,10 @@ int manager_save(Manager *m) {
                 address_state = LINK_ADDRESS_STATE_OFF;
         LinkOnlineState online_state;
         size_t links_offline = 0, links_online = 0;
-        _cleanup_(unlink_and_freep) char *temp_path = NULL;
         _cleanup_strv_free_ char **p = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *contents = NULL;
+        size_t size = 0;
         Link *link;
         int r;
 
@@ -243,11 +280,9 @@ int manager_save(Manager *m) {
         ipv6_address_state_str = link_address_state_to_string(ipv6_address_state);
         assert(ipv6_address_state_str);
 
-        r = fopen_temporary(m->state_file, &f, &temp_path);
-        if (r < 0)
-                return r;
-
-        (void) fchmod(fileno(f), 0644);
+        f = open_memstream_unlocked(&contents, &size);
+        if (!f)
+                return -ENOMEM;
 
         fprintf(f,
                 "# This is private data. Do not parse.\n"
@@ -272,12 +307,12 @@ int manager_save(Manager *m) {
         if (r < 0)
                 return r;
 
-        r = conservative_rename(temp_path, m->state_file);
+        f = safe_fclose(f);
+
+        r = state_file_write(m->state_file, &m->saved_state, contents, size);
         if (r < 0)
                 return r;
 
-        temp_path = mfree(temp_path);
-
         if (m->operational_state != operstate) {
                 m->operational_state = operstate;
                 if (strv_extend(&p, "OperationalState") < 0)
@@ -418,8 +453,9 @@ static void serialize_addresses(
 
 int link_save(Link *link) {
         const char *admin_state, *oper_state, *carrier_state, *address_state, *ipv4_address_state, *ipv6_address_state;
-        _cleanup_(unlink_and_freep) char *temp_path = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *contents = NULL;
+        size_t size = 0;
         int r;
 
         assert(link);
@@ -450,11 +486,9 @@ int link_save(Link *link) {
         ipv6_address_state = link_address_state_to_string(link->ipv6_address_state);
         assert(ipv6_address_state);
 
-        r = fopen_temporary(link->state_file, &f, &temp_path);
-        if (r < 0)
-                return r;
-
-        (void) fchmod(fileno(f), 0644);
+        f = open_memstream_unlocked(&contents, &size);
+        if (!f)
+                return -ENOMEM;
 
         fprintf(f,
                 "# This is private data. Do not parse.\n"
@@ -672,13 +706,9 @@ int link_save(Link *link) {
         if (r < 0)
                 return r;
 
-        r = conservative_rename(temp_path, link->state_file);
-        if (r < 0)
-                return r;
-
-        temp_path = mfree(temp_path);
+        f = safe_fclose(f);
 
-        return 0;
+        return state_file_write(link->state_file, &link->saved_state, contents, size);
 }
 
 void link_dirty(Link *link) {
@@ -692,6 +722,9 @@ void link_dirty(Link *link) {
         /* Also mark manager dirty as link is dirty */
         link->manager->dirty = true;
 
+        /* The JSON description contains mostly the same data. */
+        link->json = json_variant_unref(link->json);
+
         r = set_ensure_put(&link->manager->dirty_links, NULL, link);
         if (r <= 0)
                 /* Ignore allocation errors and don't take another ref if the link was already dirty */
@@ -11,6 +11,7 @@
 #include "hostname-setup.h"
 #include "network-internal.h"
 #include "networkd-manager.h"
+#include "networkd-speed-meter.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
@@ -258,6 +259,37 @@ static void test_dhcp_hostname_shorten_overlong(void) {
 
 }
 
+static void test_speed_meter_ring(void) {
+        _cleanup_free_ SpeedMeterRing *ring = NULL;
+        struct rtnl_link_stats64 stats = {};
+        uint64_t tx, rx;
+
+        assert_se(speed_meter_ring_get_rates(ring, 50, &tx, &rx) == -ENODATA);
+
+        /* Overflow the ring: tx grows by 1000 bytes per second, rx by i * 100. */
+        for (unsigned i = 0; i < SPEED_METER_SAMPLES_MAX + 10; i++) {
+                stats.tx_bytes += 1000;
+                stats.rx_bytes += i * 100;
+                assert_se(speed_meter_ring_add(&ring, (i + 1) * USEC_PER_SEC, &stats) >= 0);
+        }
+
+        assert_se(ring->n_samples == SPEED_METER_SAMPLES_MAX);
+
+        assert_se(speed_meter_ring_get_rates(ring, 50, &tx, &rx) >= 0);
+        assert_se(tx == 1000);
+        assert_se(rx == (10 + SPEED_METER_SAMPLES_MAX / 2) * 100);
+
+        assert_se(speed_meter_ring_get_rates(ring, 100, &tx, &rx) >= 0);
+        assert_se(tx == 1000);
+        assert_se(rx == (SPEED_METER_SAMPLES_MAX + 9) * 100);
+
+        /* A counter reset must not show up as a huge rate. */
+        stats = (struct rtnl_link_stats64) {};
+        assert_se(speed_meter_ring_add(&ring, (SPEED_METER_SAMPLES_MAX + 11) * USEC_PER_SEC, &stats) >= 0);
+        assert_se(speed_meter_ring_get_rates(ring, 100, &tx, &rx) >= 0);
+        assert_se(tx == 1000);
+}
+
 int main(void) {
         _cleanup_(manager_freep) Manager *manager = NULL;
         int r;
@@ -268,6 +300,7 @@ int main(void) {
         test_deserialize_dhcp_routes();
         test_address_equality();
         test_dhcp_hostname_shorten_overlong();
+        test_speed_meter_ring();
 
         assert_se(manager_new(&manager) >= 0);
 
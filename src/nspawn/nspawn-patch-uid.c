@@ -19,6 +19,13 @@
 #include "strv.h"
 #include "user-util.h"
 
+typedef struct PatchState {
+        /* The last file system we found not to support ACLs on, so that we don't query them for every
+         * inode on it again */
+        dev_t no_acl_dev;
+        bool no_acl_dev_valid;
+} PatchState;
+
 #if HAVE_ACL
 
 static int get_acl(int fd, const char *name, acl_type_t type, acl_t *ret) {
@@ -158,21 +165,30 @@ static int shift_acl(acl_t acl, uid_t shift, acl_t *ret) {
         return !!*ret;
 }
 
-static int patch_acls(int fd, const char *name, const struct stat *st, uid_t shift) {
+static int patch_acls(int fd, const char *name, const struct stat *st, uid_t shift, PatchState *state) {
         _cleanup_(acl_freep) acl_t acl = NULL, shifted = NULL;
         bool changed = false;
         int r;
 
         assert(fd >= 0);
         assert(st);
+        assert(state);
 
         /* ACLs are not supported on symlinks, there's no point in trying */
         if (S_ISLNK(st->st_mode))
                 return 0;
 
+        /* Reading the ACL costs a couple of syscalls per inode, skip that on file systems we already know
+         * not to support them */
+        if (state->no_acl_dev_valid && state->no_acl_dev == st->st_dev)
+                return 0;
+
         r = get_acl(fd, name, ACL_TYPE_ACCESS, &acl);
-        if (r == -EOPNOTSUPP)
+        if (r == -EOPNOTSUPP) {
+                state->no_acl_dev = st->st_dev;
+                state->no_acl_dev_valid = true;
                 return 0;
+        }
         if (r < 0)
                 return r;
 
@@ -214,13 +230,13 @@ static int patch_acls(int fd, const char *name, const struct stat *st, uid_t shi
 
 #else
 
-static int patch_acls(int fd, const char *name, const struct stat *st, uid_t shift) {
+static int patch_acls(int fd, const char *name, const struct stat *st, uid_t shift, PatchState *state) {
         return 0;
 }
 
 #endif
 
-static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift) {
+static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift, PatchState *state) {
         uid_t new_uid;
         gid_t new_gid;
         bool changed = false;
@@ -257,7 +273,7 @@ static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift
                 changed = true;
         }
 
-        r = patch_acls(fd, name, st, shift);
+        r = patch_acls(fd, name, st, shift, state);
         if (r < 0)
                 return r;
 
@@ -292,7 +308,7 @@ static int is_fs_fully_userns_compatible(const struct statfs *sfs) {
                F_TYPE_EQUAL(sfs->f_type, SYSFS_MAGIC);
 }
 
-static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift, bool is_toplevel) {
+static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift, bool is_toplevel, PatchState *state) {
         _cleanup_closedir_ DIR *d = NULL;
         bool changed = false;
         struct statfs sfs;
@@ -363,14 +379,14 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
 
                                 }
 
-                                r = recurse_fd(subdir_fd, true, &fst, shift, false);
+                                r = recurse_fd(subdir_fd, true, &fst, shift, false, state);
                                 if (r < 0)
                                         goto finish;
                                 if (r > 0)
                                         changed = true;
 
                         } else {
-                                r = patch_fd(dirfd(d), de->d_name, &fst, shift);
+                                r = patch_fd(dirfd(d), de->d_name, &fst, shift, state);
                                 if (r < 0)
                                         goto finish;
                                 if (r > 0)
@@ -382,7 +398,7 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
         /* After we descended, also patch the directory itself. It's key to do this in this order so that the top-level
          * directory is patched as very last object in the tree, so that we can use it as quick indicator whether the
          * tree is properly chown()ed already. */
-        r = patch_fd(d ? dirfd(d) : fd, NULL, st, shift);
+        r = patch_fd(d ? dirfd(d) : fd, NULL, st, shift, state);
         if (r == -EROFS)
                 goto read_only;
         if (r > 0)
@@ -409,6 +425,7 @@ finish:
 }
 
 static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t range) {
+        PatchState state = {};
         struct stat st;
         int r;
 
@@ -465,7 +482,7 @@ static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t rang
                 }
         }
 
-        return recurse_fd(fd, donate_fd, &st, shift, true);
+        return recurse_fd(fd, donate_fd, &st, shift, true, &state);
 
 finish:
         if (donate_fd)
@@ -3595,6 +3595,7 @@ static int outer_child(
         _cleanup_close_ int fd = -1;
         bool idmap = false;
         const char *p;
+        usec_t mount_usec;
         pid_t pid;
         ssize_t l;
         int r;
@@ -3848,6 +3849,8 @@ static int outer_child(
                         return log_error_errno(r, "Failed to make tree read-only: %m");
         }
 
+        mount_usec = now(CLOCK_MONOTONIC);
+
         r = mount_all(directory,
                       arg_mount_settings,
                       arg_uid_shift,
@@ -3872,6 +3875,9 @@ static int outer_child(
         if (r < 0)
                 return r;
 
+        log_debug("Set up API file systems and device nodes in %s.",
+                  FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), mount_usec), USEC_PER_MSEC));
+
         r = setup_propagate(directory);
         if (r < 0)
                 return r;
@@ -4705,6 +4711,7 @@ static int run_container(
         _cleanup_free_ uid_t *bind_user_uid = NULL;
         size_t n_bind_user_uid = 0;
         ContainerStatus container_status = 0;
+        usec_t clone_usec, init_usec;
         int ifi = 0, r;
         ssize_t l;
         sigset_t mask_chld;
@@ -4781,6 +4788,8 @@ static int run_container(
                                                "Path %s doesn't refer to a network namespace, refusing.", arg_network_namespace_path);
         }
 
+        clone_usec = now(CLOCK_MONOTONIC);
+
         *pid = raw_clone(SIGCHLD|CLONE_NEWNS);
         if (*pid < 0)
                 return log_error_errno(errno, "clone() failed%s: %m",
@@ -4918,7 +4927,9 @@ static int run_container(
                 return log_error_errno(notify_socket,
                                        "Failed to receive notification socket from the outer child: %m");
 
-        log_debug("Init process invoked as PID "PID_FMT, *pid);
+        init_usec = now(CLOCK_MONOTONIC);
+        log_debug("Init process invoked as PID "PID_FMT", outer child took %s.",
+                  *pid, FORMAT_TIMESPAN(usec_sub_unsigned(init_usec, clone_usec), USEC_PER_MSEC));
 
         if (arg_userns_mode != USER_NAMESPACE_NO) {
                 if (!barrier_place_and_sync(&barrier)) /* #1 */
@@ -5102,6 +5113,11 @@ static int run_container(
         if (!barrier_place_and_sync(&barrier)) /* #5 */
                 return log_error_errno(SYNTHETIC_ERRNO(ESRCH), "Child died too early.");
 
+        log_debug("Container set up in %s (outer child %s, host side and inner child %s).",
+                  FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), clone_usec), USEC_PER_MSEC),
+                  FORMAT_TIMESPAN(usec_sub_unsigned(init_usec, clone_usec), USEC_PER_MSEC),
+                  FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), init_usec), USEC_PER_MSEC));
+
         /* At this point we have made use of the UID we picked, and thus nss-systemd/systemd-machined.service
          * will make them appear in getpwuid(), thus we can release the /etc/passwd lock. */
         etc_passwd_lock = safe_close(etc_passwd_lock);
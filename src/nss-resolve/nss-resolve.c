@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "alloc-util.h"
 #include "env-util.h"
 #include "errno-util.h"
 #include "in-addr-util.h"
@@ -66,6 +67,111 @@ static int connect_to_resolved(Varlink **ret) {
         return 0;
 }
 
+/* Connecting to resolved for each lookup is expensive for processes doing many of them, hence we keep the
+ * connection around for the next lookup. Varlink objects are not thread-safe, and a lookup may take a while,
+ * hence we keep one connection per thread, which is dropped when the thread exits. */
+typedef struct LinkCache {
+        Varlink *link;
+        pid_t pid;
+} LinkCache;
+
+static pthread_key_t link_cache_key;
+static bool link_cache_key_valid = false;
+
+static void link_cache_free(void *p) {
+        LinkCache *c = p;
+
+        if (!c)
+                return;
+
+        varlink_unref(c->link);
+        free(c);
+}
+
+static void link_cache_key_init(void) {
+        link_cache_key_valid = pthread_key_create(&link_cache_key, link_cache_free) == 0;
+}
+
+static LinkCache* link_cache_get(void) {
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+        LinkCache *c;
+
+        assert_se(pthread_once(&once, link_cache_key_init) == 0);
+        if (!link_cache_key_valid)
+                return NULL;
+
+        c = pthread_getspecific(link_cache_key);
+        if (!c) {
+                c = new0(LinkCache, 1);
+                if (!c)
+                        return NULL;
+
+                if (pthread_setspecific(link_cache_key, c) != 0)
+                        return mfree(c);
+        }
+
+        /* The connection is shared with the parent if we have been forked off since it was established.
+         * Don't use it then, the replies might end up on the wrong side. */
+        if (c->link && c->pid != getpid()) {
+                c->link = varlink_unref(c->link);
+                c->pid = 0;
+        }
+
+        return c;
+}
+
+static int call_resolved(
+                const char *method,
+                JsonVariant *parameters,
+                Varlink **ret_link,
+                JsonVariant **ret_parameters,
+                const char **ret_error_id) {
+
+        LinkCache *c;
+        int r;
+
+        assert(method);
+        assert(ret_link);
+        assert(ret_parameters);
+        assert(ret_error_id);
+
+        /* Like varlink_call(), but reuses the connection of the previous call from this thread if there is
+         * one. Returns the connection, which owns the returned reply. */
+
+        c = link_cache_get();
+
+        for (;;) {
+                _cleanup_(varlink_unrefp) Varlink *link = NULL;
+                bool reused;
+
+                reused = c && c->link;
+                if (reused)
+                        link = TAKE_PTR(c->link);
+                else {
+                        r = connect_to_resolved(&link);
+                        if (r < 0)
+                                return r;
+                }
+
+                r = varlink_call(link, method, parameters, ret_parameters, ret_error_id, NULL);
+
+                /* resolved might have closed an idle connection in the meantime, e.g. because it was
+                 * restarted. Try again once, on a fresh connection. */
+                if (reused && (r < 0 || streq_ptr(*ret_error_id, VARLINK_ERROR_DISCONNECTED)))
+                        continue;
+
+                /* Only keep connections that are in a well-defined state, i.e. not after a timeout,
+                 * protocol error or similar. */
+                if (c && r >= 0 && (isempty(*ret_error_id) || !error_shall_fallback(*ret_error_id))) {
+                        c->link = varlink_ref(link);
+                        c->pid = getpid();
+                }
+
+                *ret_link = TAKE_PTR(link);
+                return r;
+        }
+}
+
 static uint32_t ifindex_to_scopeid(int family, const void *a, int ifindex) {
         struct in6_addr in6;
 
@@ -222,10 +328,6 @@ enum nss_status _nss_resolve_gethostbyname4_r(
         assert(errnop);
         assert(h_errnop);
 
-        r = connect_to_resolved(&link);
-        if (r < 0)
-                goto fail;
-
         r = json_build(&cparams, JSON_BUILD_OBJECT(
                                        JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name)),
                                        JSON_BUILD_PAIR("flags", JSON_BUILD_UNSIGNED(query_flags()))));
@@ -238,7 +340,7 @@ enum nss_status _nss_resolve_gethostbyname4_r(
          * configuration can distinguish such executed but negative replies from complete failure to
          * talk to resolved). */
         const char *error_id;
-        r = varlink_call(link, "io.systemd.Resolve.ResolveHostname", cparams, &rparams, &error_id, NULL);
+        r = call_resolved("io.systemd.Resolve.ResolveHostname", cparams, &link, &rparams, &error_id);
         if (r < 0)
                 goto fail;
         if (!isempty(error_id)) {
@@ -375,10 +477,6 @@ enum nss_status _nss_resolve_gethostbyname3_r(
                 goto fail;
         }
 
-        r = connect_to_resolved(&link);
-        if (r < 0)
-                goto fail;
-
         r = json_build(&cparams, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name)),
                                                    JSON_BUILD_PAIR("family", JSON_BUILD_INTEGER(af)),
                                                    JSON_BUILD_PAIR("flags", JSON_BUILD_UNSIGNED(query_flags()))));
@@ -386,7 +484,7 @@ enum nss_status _nss_resolve_gethostbyname3_r(
                 goto fail;
 
         const char *error_id;
-        r = varlink_call(link, "io.systemd.Resolve.ResolveHostname", cparams, &rparams, &error_id, NULL);
+        r = call_resolved("io.systemd.Resolve.ResolveHostname", cparams, &link, &rparams, &error_id);
         if (r < 0)
                 goto fail;
         if (!isempty(error_id)) {
@@ -579,10 +677,6 @@ enum nss_status _nss_resolve_gethostbyaddr2_r(
                 goto fail;
         }
 
-        r = connect_to_resolved(&link);
-        if (r < 0)
-                goto fail;
-
         r = json_build(&cparams, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("address", JSON_BUILD_BYTE_ARRAY(addr, len)),
                                                    JSON_BUILD_PAIR("family", JSON_BUILD_INTEGER(af)),
                                                    JSON_BUILD_PAIR("flags", JSON_BUILD_UNSIGNED(query_flags()))));
@@ -590,7 +684,7 @@ enum nss_status _nss_resolve_gethostbyaddr2_r(
                 goto fail;
 
         const char* error_id;
-        r = varlink_call(link, "io.systemd.Resolve.ResolveAddress", cparams, &rparams, &error_id, NULL);
+        r = call_resolved("io.systemd.Resolve.ResolveAddress", cparams, &link, &rparams, &error_id);
         if (r < 0)
                 goto fail;
         if (!isempty(error_id)) {
@@ -1,9 +1,15 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <pthread.h>
+
 #include "env-util.h"
 #include "fd-util.h"
+#include "fs-util.h"
 #include "nss-systemd.h"
+#include "pthread-util.h"
+#include "stdio-util.h"
 #include "strv.h"
+#include "time-util.h"
 #include "user-record-nss.h"
 #include "user-record.h"
 #include "user-util.h"
@@ -64,62 +70,206 @@ int nss_pack_user_record(
         return 0;
 }
 
-enum nss_status userdb_getpwnam(
-                const char *name,
-                struct passwd *pwd,
-                char *buffer, size_t buflen,
-                int *errnop) {
+/* A single entry cache for user lookups, so that programs that resolve the same user over and over again
+ * don't do a varlink round trip each time. Disabled by default, since changes to the user database only
+ * become visible after the entry expired. Set $SYSTEMD_NSS_USERDB_CACHE_USEC to enable it. */
+static struct {
+        pthread_mutex_t mutex;
+        char *name;          /* Key if looked up by name, NULL otherwise */
+        uid_t uid;           /* Key if looked up by UID, UID_INVALID otherwise */
+        UserRecord *record;  /* NULL if the user wasn't found */
+        usec_t until;
+} user_cache = {
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .uid = UID_INVALID,
+};
+
+static usec_t user_cache_ttl(void) {
+        const char *e;
+        usec_t t;
+
+        e = secure_getenv("SYSTEMD_NSS_USERDB_CACHE_USEC");
+        if (!e || parse_sec(e, &t) < 0)
+                return 0;
+
+        return t;
+}
+
+static bool user_cache_matches(const char *name, uid_t uid) {
+        if (user_cache.until == 0 || now(CLOCK_MONOTONIC) >= user_cache.until)
+                return false;
+
+        return name ? streq_ptr(user_cache.name, name) : user_cache.uid == uid;
+}
 
+static void user_cache_put(const char *name, uid_t uid, UserRecord *hr, usec_t ttl) {
+        assert(ttl > 0);
+
+        user_cache.record = user_record_unref(user_cache.record);
+        user_cache.name = mfree(user_cache.name);
+        user_cache.uid = UID_INVALID;
+        user_cache.until = 0;
+
+        if (name) {
+                user_cache.name = strdup(name);
+                if (!user_cache.name)
+                        return;
+        } else
+                user_cache.uid = uid;
+
+        user_cache.record = hr ? user_record_ref(hr) : NULL;
+        user_cache.until = usec_add(now(CLOCK_MONOTONIC), ttl);
+}
+
+static int dynamic_user_by_symlink(const char *name, uid_t uid, UserRecord **ret) {
         _cleanup_(user_record_unrefp) UserRecord *hr = NULL;
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_free_ char *target = NULL;
+        char buf[STRLEN("/run/systemd/dynamic-uid/direct:") + DECIMAL_STR_MAX(uid_t) + 1];
+        const char *p;
         int r;
 
-        assert(pwd);
-        assert(errnop);
+        assert(name || uid_is_valid(uid));
+        assert(ret);
 
-        if (_nss_systemd_is_blocked())
-                return NSS_STATUS_NOTFOUND;
+        /* PID 1 maintains world-readable symlinks mapping the names of dynamic users to their UIDs and back
+         * in /run/systemd/dynamic-uid/ (see make_uid_symlinks()). Reading them is a lot cheaper than asking
+         * PID 1 via varlink, and they tell us everything PID 1 would, hence synthesize the same record from
+         * them. Returns -ESRCH if there's no such dynamic user. */
 
-        r = userdb_by_name(name, nss_glue_userdb_flags()|USERDB_SUPPRESS_SHADOW, &hr);
-        if (r == -ESRCH)
-                return NSS_STATUS_NOTFOUND;
-        if (r < 0) {
-                *errnop = -r;
-                return NSS_STATUS_UNAVAIL;
+        if (name) {
+                if (!valid_user_group_name(name, 0))
+                        return -ESRCH;
+
+                p = strjoina("/run/systemd/dynamic-uid/direct:", name);
+        } else {
+                if (!uid_is_dynamic(uid))
+                        return -ESRCH;
+
+                xsprintf(buf, "/run/systemd/dynamic-uid/direct:" UID_FMT, uid);
+                p = buf;
         }
 
-        r = nss_pack_user_record(hr, pwd, buffer, buflen);
-        if (r < 0) {
-                *errnop = -r;
-                return NSS_STATUS_TRYAGAIN;
+        r = readlink_malloc(p, &target);
+        if (r == -ENOENT)
+                return -ESRCH;
+        if (r < 0)
+                return r;
+
+        if (name) {
+                r = parse_uid(target, &uid);
+                if (r < 0)
+                        return r;
+                if (!uid_is_dynamic(uid))
+                        return -EBADMSG;
+        } else {
+                if (!valid_user_group_name(target, 0))
+                        return -EBADMSG;
+
+                name = target;
         }
 
-        return NSS_STATUS_SUCCESS;
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("userName", JSON_BUILD_STRING(name)),
+                                       JSON_BUILD_PAIR("uid", JSON_BUILD_UNSIGNED(uid)),
+                                       JSON_BUILD_PAIR("gid", JSON_BUILD_UNSIGNED(uid)),
+                                       JSON_BUILD_PAIR("realName", JSON_BUILD_STRING("Dynamic User")),
+                                       JSON_BUILD_PAIR("homeDirectory", JSON_BUILD_STRING("/")),
+                                       JSON_BUILD_PAIR("shell", JSON_BUILD_STRING(NOLOGIN)),
+                                       JSON_BUILD_PAIR("locked", JSON_BUILD_BOOLEAN(true)),
+                                       JSON_BUILD_PAIR("service", JSON_BUILD_STRING("io.systemd.DynamicUser")),
+                                       JSON_BUILD_PAIR("disposition", JSON_BUILD_STRING("dynamic"))));
+        if (r < 0)
+                return r;
+
+        hr = user_record_new();
+        if (!hr)
+                return -ENOMEM;
+
+        r = user_record_load(hr, v, USER_RECORD_LOAD_REFUSE_SECRET|USER_RECORD_PERMISSIVE);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(hr);
+        return 0;
 }
 
-enum nss_status userdb_getpwuid(
+static enum nss_status userdb_getpw(
+                const char *name,
                 uid_t uid,
                 struct passwd *pwd,
                 char *buffer,
                 size_t buflen,
                 int *errnop) {
 
+        _cleanup_(pthread_mutex_unlock_assertp) pthread_mutex_t *_l = NULL;
         _cleanup_(user_record_unrefp) UserRecord *hr = NULL;
+        usec_t ttl;
         int r;
 
+        assert(name || uid_is_valid(uid));
         assert(pwd);
         assert(errnop);
 
         if (_nss_systemd_is_blocked())
                 return NSS_STATUS_NOTFOUND;
 
-        r = userdb_by_uid(uid, nss_glue_userdb_flags()|USERDB_SUPPRESS_SHADOW, &hr);
-        if (r == -ESRCH)
-                return NSS_STATUS_NOTFOUND;
-        if (r < 0) {
+        /* Dynamic users are common and can be resolved without IPC, try that first. If anything goes wrong
+         * with that, just do the full lookup. */
+        if (!FLAGS_SET(nss_glue_userdb_flags(), USERDB_EXCLUDE_DYNAMIC_USER) &&
+            dynamic_user_by_symlink(name, uid, &hr) >= 0) {
+                r = nss_pack_user_record(hr, pwd, buffer, buflen);
+                if (r < 0) {
+                        *errnop = -r;
+                        return NSS_STATUS_TRYAGAIN;
+                }
+
+                return NSS_STATUS_SUCCESS;
+        }
+
+        /* Note that UserRecord objects are not reference counted atomically, hence we access the cached one
+         * (and any record we share with it) only while holding the lock. */
+
+        ttl = user_cache_ttl();
+        if (ttl > 0) {
+                _l = pthread_mutex_lock_assert(&user_cache.mutex);
+
+                if (user_cache_matches(name, uid)) {
+                        if (!user_cache.record)
+                                return NSS_STATUS_NOTFOUND;
+
+                        r = nss_pack_user_record(user_cache.record, pwd, buffer, buflen);
+                        if (r < 0) {
+                                *errnop = -r;
+                                return NSS_STATUS_TRYAGAIN;
+                        }
+
+                        return NSS_STATUS_SUCCESS;
+                }
+
+                /* Don't hold the lock while talking to the userdb services, so that lookups in other threads
+                 * are not serialized behind ours. */
+                pthread_mutex_unlock_assertp(&_l);
+                _l = NULL;
+        }
+
+        if (name)
+                r = userdb_by_name(name, nss_glue_userdb_flags()|USERDB_SUPPRESS_SHADOW, &hr);
+        else
+                r = userdb_by_uid(uid, nss_glue_userdb_flags()|USERDB_SUPPRESS_SHADOW, &hr);
+        if (r < 0 && r != -ESRCH) {
                 *errnop = -r;
                 return NSS_STATUS_UNAVAIL;
         }
 
+        if (ttl > 0) {
+                _l = pthread_mutex_lock_assert(&user_cache.mutex);
+                user_cache_put(name, uid, hr, ttl);
+        }
+
+        if (!hr)
+                return NSS_STATUS_NOTFOUND;
+
         r = nss_pack_user_record(hr, pwd, buffer, buflen);
         if (r < 0) {
                 *errnop = -r;
@@ -129,6 +279,27 @@ enum nss_status userdb_getpwuid(
         return NSS_STATUS_SUCCESS;
 }
 
+enum nss_status userdb_getpwnam(
+                const char *name,
+                struct passwd *pwd,
+                char *buffer, size_t buflen,
+                int *errnop) {
+
+        assert(name);
+
+        return userdb_getpw(name, UID_INVALID, pwd, buffer, buflen, errnop);
+}
+
+enum nss_status userdb_getpwuid(
+                uid_t uid,
+                struct passwd *pwd,
+                char *buffer,
+                size_t buflen,
+                int *errnop) {
+
+        return userdb_getpw(NULL, uid, pwd, buffer, buflen, errnop);
+}
+
 int nss_pack_user_record_shadow(
                 UserRecord *hr,
                 struct spwd *spwd,
@@ -6,11 +6,13 @@
 #include "cgroup-util.h"
 #include "fd-util.h"
 #include "fileio.h"
+#include "io-util.h"
 #include "memory-util.h"
 #include "oomd-manager-bus.h"
 #include "oomd-manager.h"
 #include "path-util.h"
 #include "percent-util.h"
+#include "stdio-util.h"
 
 typedef struct ManagedOOMReply {
         ManagedOOMMode mode;
@@ -19,6 +21,193 @@ typedef struct ManagedOOMReply {
         uint32_t limit;
 } ManagedOOMReply;
 
+typedef struct MemoryPressureTrigger {
+        char *path;
+        loadavg_t limit;
+        sd_event_source *event_source;
+} MemoryPressureTrigger;
+
+static MemoryPressureTrigger* memory_pressure_trigger_free(MemoryPressureTrigger *t) {
+        if (!t)
+                return NULL;
+
+        sd_event_source_disable_unref(t->event_source);
+        free(t->path);
+        return mfree(t);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(MemoryPressureTrigger*, memory_pressure_trigger_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(
+                memory_pressure_trigger_hash_ops,
+                char, path_hash_func, path_compare,
+                MemoryPressureTrigger, memory_pressure_trigger_free);
+
+static void manager_wake_memory_pressure_monitor(Manager *m) {
+        int r;
+
+        assert(m);
+
+        if (!m->mem_pressure_context_event_source)
+                return;
+
+        r = sd_event_source_get_enabled(m->mem_pressure_context_event_source, NULL);
+        if (r != 0)
+                return; /* Already polling (or failed to query, in which case we leave it alone) */
+
+        r = sd_event_source_set_time_relative(m->mem_pressure_context_event_source, 0);
+        if (r >= 0)
+                r = sd_event_source_set_enabled(m->mem_pressure_context_event_source, SD_EVENT_ON);
+        if (r < 0)
+                log_warning_errno(r, "Failed to resume memory pressure monitoring, ignoring: %m");
+}
+
+static int on_memory_pressure_trigger(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        Manager *m = userdata;
+
+        assert(s);
+        assert(m);
+
+        /* The cgroup was removed. Stop watching, the trigger is dropped with the next update. */
+        if (revents & EPOLLERR)
+                (void) sd_event_source_set_enabled(s, SD_EVENT_OFF);
+
+        manager_wake_memory_pressure_monitor(m);
+        return 0;
+}
+
+static int memory_pressure_trigger_new(Manager *m, const OomdCGroupContext *ctx, MemoryPressureTrigger **ret) {
+        _cleanup_(memory_pressure_trigger_freep) MemoryPressureTrigger *t = NULL;
+        _cleanup_free_ char *p = NULL;
+        _cleanup_close_ int fd = -1;
+        char buf[STRLEN("full ") + DECIMAL_STR_MAX(usec_t) * 2 + 1];
+        usec_t threshold;
+        int r;
+
+        assert(m);
+        assert(ctx);
+        assert(ret);
+
+        /* The limit is a percentage of the time all tasks were stalled. Ask the kernel to notify us when
+         * half of the limit was exceeded within the window, so that we start polling early enough. */
+        threshold = MEM_PRESSURE_TRIGGER_WINDOW_USEC * ctx->mem_pressure_limit / (100 * FIXED_1) / 2;
+        if (threshold == 0)
+                return -EINVAL;
+
+        t = new(MemoryPressureTrigger, 1);
+        if (!t)
+                return -ENOMEM;
+
+        *t = (MemoryPressureTrigger) {
+                .limit = ctx->mem_pressure_limit,
+        };
+
+        t->path = strdup(ctx->path);
+        if (!t->path)
+                return -ENOMEM;
+
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, ctx->path, "memory.pressure", &p);
+        if (r < 0)
+                return r;
+
+        fd = open(p, O_RDWR|O_NONBLOCK|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        xsprintf(buf, "full " USEC_FMT " " USEC_FMT, threshold, MEM_PRESSURE_TRIGGER_WINDOW_USEC);
+
+        /* The kernel expects the trailing NUL to be written, too. */
+        r = loop_write(fd, buf, strlen(buf) + 1, false);
+        if (r < 0)
+                return r;
+
+        r = sd_event_add_io(m->event, &t->event_source, fd, EPOLLPRI, on_memory_pressure_trigger, m);
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_set_io_fd_own(t->event_source, true);
+        if (r < 0)
+                return r;
+        TAKE_FD(fd);
+
+        (void) sd_event_source_set_description(t->event_source, "oomd-memory-pressure-trigger");
+
+        *ret = TAKE_PTR(t);
+        return 0;
+}
+
+static bool manager_update_memory_pressure_triggers(Manager *m) {
+        MemoryPressureTrigger *t;
+        OomdCGroupContext *ctx;
+        bool all = true;
+        int r;
+
+        assert(m);
+
+        /* Makes sure every cgroup monitored for memory pressure has a PSI trigger, and drops the triggers of
+         * cgroups that are not monitored anymore or whose limit changed. Returns true if all monitored cgroups
+         * have a working trigger, i.e. if it is safe to stop polling. */
+
+        HASHMAP_FOREACH(t, m->mem_pressure_triggers) {
+                ctx = hashmap_get(m->monitored_mem_pressure_cgroup_contexts, t->path);
+                if (!ctx || ctx->mem_pressure_limit != t->limit ||
+                    sd_event_source_get_enabled(t->event_source, NULL) <= 0)
+                        memory_pressure_trigger_free(hashmap_remove(m->mem_pressure_triggers, t->path));
+        }
+
+        if (m->mem_pressure_triggers_unsupported)
+                return false;
+
+        HASHMAP_FOREACH(ctx, m->monitored_mem_pressure_cgroup_contexts) {
+                _cleanup_(memory_pressure_trigger_freep) MemoryPressureTrigger *n = NULL;
+
+                if (hashmap_contains(m->mem_pressure_triggers, ctx->path))
+                        continue;
+
+                r = memory_pressure_trigger_new(m, ctx, &n);
+                if (ERRNO_IS_NOT_SUPPORTED(r) || r == -EACCES) {
+                        log_debug_errno(r, "PSI triggers are not supported, polling memory pressure: %m");
+                        m->mem_pressure_triggers_unsupported = true;
+                        return false;
+                }
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to set up memory pressure trigger for %s, ignoring: %m", ctx->path);
+                        all = false;
+                        continue;
+                }
+
+                r = hashmap_ensure_put(&m->mem_pressure_triggers, &memory_pressure_trigger_hash_ops, n->path, n);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to store memory pressure trigger for %s, ignoring: %m", ctx->path);
+                        all = false;
+                        continue;
+                }
+
+                TAKE_PTR(n);
+        }
+
+        return all;
+}
+
+static bool manager_memory_pressure_is_idle(Manager *m) {
+        OomdCGroupContext *ctx;
+        bool all_triggers;
+
+        assert(m);
+
+        all_triggers = manager_update_memory_pressure_triggers(m);
+
+        if (!all_triggers || m->mem_pressure_post_action_delay_start > 0)
+                return false;
+
+        HASHMAP_FOREACH(ctx, m->monitored_mem_pressure_cgroup_contexts)
+                if (ctx->mem_pressure_limit_hit_start > 0 ||
+                    ctx->memory_pressure.avg10 > ctx->mem_pressure_limit / 2)
+                        return false;
+
+        return true;
+}
+
 static void managed_oom_reply_destroy(ManagedOOMReply *reply) {
         assert(reply);
         free(reply->path);
@@ -131,6 +320,9 @@ finish:
         if (!FLAGS_SET(flags, VARLINK_REPLY_CONTINUES))
                 m->varlink = varlink_close_unref(link);
 
+        /* Pick up new cgroups and limits right away */
+        manager_wake_memory_pressure_monitor(m);
+
         return r;
 }
 
@@ -384,7 +576,7 @@ static void clear_candidate_hashmapp(Manager **m) {
                 hashmap_clear((*m)->monitored_mem_pressure_cgroup_contexts_candidates);
 }
 
-static int monitor_memory_pressure_contexts_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+static int monitor_memory_pressure_contexts_one(sd_event_source *s, uint64_t usec, void *userdata) {
         /* Don't want to use stale candidate data. Setting this will clear the candidate hashmap on return unless we
          * update the candidate data (in which case clear_candidates will be NULL). */
         _cleanup_(clear_candidate_hashmapp) Manager *clear_candidates = userdata;
@@ -511,6 +703,31 @@ static int monitor_memory_pressure_contexts_handler(sd_event_source *s, uint64_t
         return 0;
 }
 
+static int monitor_memory_pressure_contexts_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *m = userdata;
+        int r;
+
+        assert(s);
+        assert(m);
+
+        r = monitor_memory_pressure_contexts_one(s, usec, userdata);
+        if (r < 0)
+                return r;
+
+        /* Nothing is close to its limit, so instead of reading the pressure of every monitored cgroup each
+         * interval, wait until a PSI trigger fires. Note that reclaim activity is then measured over the
+         * whole idle period once we wake up again. */
+        if (manager_memory_pressure_is_idle(m)) {
+                r = sd_event_source_set_enabled(s, SD_EVENT_OFF);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to disable memory pressure timer: %m");
+
+                log_debug("No monitored cgroup is under memory pressure, waiting for PSI triggers.");
+        }
+
+        return 0;
+}
+
 static int monitor_swap_contexts(Manager *m) {
         _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
         int r;
@@ -567,6 +784,7 @@ Manager* manager_free(Manager *m) {
         varlink_close_unref(m->varlink);
         sd_event_source_unref(m->swap_context_event_source);
         sd_event_source_unref(m->mem_pressure_context_event_source);
+        hashmap_free(m->mem_pressure_triggers);
         sd_event_unref(m->event);
 
         bus_verify_polkit_async_registry_free(m->polkit_registry);
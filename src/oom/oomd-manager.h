@@ -10,6 +10,10 @@
 #define SWAP_INTERVAL_USEC 150000 /* 0.15 seconds */
 /* Pressure counters are lagging (~2 seconds) compared to swap so polling too frequently just wastes CPU */
 #define MEM_PRESSURE_INTERVAL_USEC (1 * USEC_PER_SEC)
+/* While no monitored cgroup is close to its memory pressure limit, polling is stopped, and PSI triggers on
+ * memory.pressure wake us up again once all tasks of a cgroup were stalled for more than half of the limit
+ * within this window. */
+#define MEM_PRESSURE_TRIGGER_WINDOW_USEC (1 * USEC_PER_SEC)
 
 /* Take action if 10s of memory pressure > 60 for more than 30s. We use the "full" value from PSI so this is the
  * percentage of time all tasks were delayed (i.e. unproductive).
@@ -51,6 +55,11 @@ struct Manager {
         sd_event_source *swap_context_event_source;
         sd_event_source *mem_pressure_context_event_source;
 
+        /* k: cgroup paths -> v: MemoryPressureTrigger
+         * PSI triggers for the cgroups in monitored_mem_pressure_cgroup_contexts. */
+        Hashmap *mem_pressure_triggers;
+        bool mem_pressure_triggers_unsupported;
+
         Varlink *varlink;
 };
 
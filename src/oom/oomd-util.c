@@ -6,6 +6,7 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "format-util.h"
+#include "io-util.h"
 #include "oomd-util.h"
 #include "parse-util.h"
 #include "path-util.h"
@@ -23,6 +24,54 @@ DEFINE_HASH_OPS_WITH_VALUE_DESTRUCTOR(
                 OomdCGroupContext,
                 oomd_cgroup_context_free);
 
+/* Large enough for memory.stat of current kernels, which has a few dozen keys. */
+#define MEMORY_STAT_SIZE_MAX (8U * 1024U)
+
+static int cgroup_get_pgscan(const char *path, uint64_t *ret) {
+        _cleanup_free_ char *p = NULL, *val = NULL;
+        _cleanup_close_ int fd = -1;
+        char buf[MEMORY_STAT_SIZE_MAX + 1];
+        const char *k;
+        ssize_t n;
+        int r;
+
+        assert(path);
+        assert(ret);
+
+        /* memory.stat is read for every candidate cgroup, but only pgscan is used. Read the file into a stack
+         * buffer and only look for that key, instead of going through the generic keyed attribute parser,
+         * which allocates a copy of the whole file. */
+
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, path, "memory.stat", &p);
+        if (r < 0)
+                return r;
+
+        fd = open(p, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        n = loop_read(fd, buf, sizeof(buf) - 1, false);
+        if (n < 0)
+                return (int) n;
+        buf[n] = 0;
+
+        k = startswith(buf, "pgscan ");
+        if (!k) {
+                k = strstr(buf, "\npgscan ");
+                if (k)
+                        k += STRLEN("\npgscan ");
+        }
+        if (k && k[strcspn(k, NEWLINE)] != 0)
+                return safe_atou64(strndupa(k, strcspn(k, NEWLINE)), ret);
+
+        /* Truncated or unexpected contents, fall back to the generic parser. */
+        r = cg_get_keyed_attribute(SYSTEMD_CGROUP_CONTROLLER, path, "memory.stat", STRV_MAKE("pgscan"), &val);
+        if (r < 0)
+                return r;
+
+        return safe_atou64(val, ret);
+}
+
 static int log_kill(pid_t pid, int sig, void *userdata) {
         log_debug("oomd attempting to kill " PID_FMT " with %s", pid, signal_to_string(sig));
         return 0;
@@ -142,17 +191,16 @@ bool oomd_swap_free_below(const OomdSystemContext *ctx, int threshold_permyriad)
         return (ctx->swap_total - ctx->swap_used) < swap_threshold;
 }
 
-int oomd_sort_cgroup_contexts(Hashmap *h, oomd_compare_t compare_func, const char *prefix, OomdCGroupContext ***ret) {
-        _cleanup_free_ OomdCGroupContext **sorted = NULL;
+static int collect_cgroup_contexts(Hashmap *h, const char *prefix, OomdCGroupContext ***ret) {
+        _cleanup_free_ OomdCGroupContext **items = NULL;
         OomdCGroupContext *item;
         size_t k = 0;
 
         assert(h);
-        assert(compare_func);
         assert(ret);
 
-        sorted = new0(OomdCGroupContext*, hashmap_size(h));
-        if (!sorted)
+        items = new0(OomdCGroupContext*, hashmap_size(h));
+        if (!items)
                 return -ENOMEM;
 
         HASHMAP_FOREACH(item, h) {
@@ -160,17 +208,85 @@ int oomd_sort_cgroup_contexts(Hashmap *h, oomd_compare_t compare_func, const cha
                 if ((item->path && prefix && !path_startswith(item->path, prefix)) || item->preference == MANAGED_OOM_PREFERENCE_OMIT)
                         continue;
 
-                sorted[k++] = item;
+                items[k++] = item;
         }
 
-        typesafe_qsort(sorted, k, compare_func);
-
-        *ret = TAKE_PTR(sorted);
+        *ret = TAKE_PTR(items);
 
         assert(k <= INT_MAX);
         return (int) k;
 }
 
+int oomd_sort_cgroup_contexts(Hashmap *h, oomd_compare_t compare_func, const char *prefix, OomdCGroupContext ***ret) {
+        _cleanup_free_ OomdCGroupContext **sorted = NULL;
+        int n;
+
+        assert(h);
+        assert(compare_func);
+        assert(ret);
+
+        n = collect_cgroup_contexts(h, prefix, &sorted);
+        if (n < 0)
+                return n;
+
+        typesafe_qsort(sorted, n, compare_func);
+
+        *ret = TAKE_PTR(sorted);
+        return n;
+}
+
+static void cgroup_contexts_sift_down(OomdCGroupContext **heap, size_t n, size_t i, oomd_compare_t compare_func) {
+        for (;;) {
+                size_t l = 2 * i + 1, r = l + 1, top = i;
+
+                if (l < n && compare_func(heap + l, heap + top) < 0)
+                        top = l;
+                if (r < n && compare_func(heap + r, heap + top) < 0)
+                        top = r;
+                if (top == i)
+                        return;
+
+                SWAP_TWO(heap[i], heap[top]);
+                i = top;
+        }
+}
+
+int oomd_heapify_cgroup_contexts(Hashmap *h, oomd_compare_t compare_func, const char *prefix, OomdCGroupContext ***ret) {
+        _cleanup_free_ OomdCGroupContext **heap = NULL;
+        int n;
+
+        assert(h);
+        assert(compare_func);
+        assert(ret);
+
+        n = collect_cgroup_contexts(h, prefix, &heap);
+        if (n < 0)
+                return n;
+
+        for (size_t i = n / 2; i > 0; i--)
+                cgroup_contexts_sift_down(heap, n, i - 1, compare_func);
+
+        *ret = TAKE_PTR(heap);
+        return n;
+}
+
+OomdCGroupContext* oomd_cgroup_contexts_pop(OomdCGroupContext **heap, size_t *n, oomd_compare_t compare_func) {
+        OomdCGroupContext *top;
+
+        assert(heap);
+        assert(n);
+        assert(compare_func);
+
+        if (*n == 0)
+                return NULL;
+
+        top = heap[0];
+        heap[0] = heap[--*n];
+        cgroup_contexts_sift_down(heap, *n, 0, compare_func);
+
+        return top;
+}
+
 int oomd_cgroup_kill(const char *path, bool recurse, bool dry_run) {
         _cleanup_set_free_ Set *pids_killed = NULL;
         int r;
@@ -207,23 +323,27 @@ int oomd_cgroup_kill(const char *path, bool recurse, bool dry_run) {
 }
 
 int oomd_kill_by_pgscan_rate(Hashmap *h, const char *prefix, bool dry_run, char **ret_selected) {
-        _cleanup_free_ OomdCGroupContext **sorted = NULL;
+        _cleanup_free_ OomdCGroupContext **candidates = NULL;
+        OomdCGroupContext *c;
+        size_t n_candidates;
         int n, r, ret = 0;
 
         assert(h);
         assert(ret_selected);
 
-        n = oomd_sort_cgroup_contexts(h, compare_pgscan_rate_and_memory_usage, prefix, &sorted);
+        /* Usually the first candidate is killed, so do not sort all of them, but take them from a heap. */
+        n = oomd_heapify_cgroup_contexts(h, compare_pgscan_rate_and_memory_usage, prefix, &candidates);
         if (n < 0)
                 return n;
+        n_candidates = n;
 
-        for (int i = 0; i < n; i++) {
+        while ((c = oomd_cgroup_contexts_pop(candidates, &n_candidates, compare_pgscan_rate_and_memory_usage))) {
                 /* Skip cgroups with no reclaim and memory usage; it won't alleviate pressure.
                  * Continue since there might be "avoid" cgroups at the end. */
-                if (sorted[i]->pgscan == 0 && sorted[i]->current_memory_usage == 0)
+                if (c->pgscan == 0 && c->current_memory_usage == 0)
                         continue;
 
-                r = oomd_cgroup_kill(sorted[i]->path, true, dry_run);
+                r = oomd_cgroup_kill(c->path, true, dry_run);
                 if (r == 0)
                         continue; /* We didn't find anything to kill */
                 if (r == -ENOMEM)
@@ -234,7 +354,7 @@ int oomd_kill_by_pgscan_rate(Hashmap *h, const char *prefix, bool dry_run, char
                         continue; /* Try to find something else to kill */
                 }
 
-                char *selected = strdup(sorted[i]->path);
+                char *selected = strdup(c->path);
                 if (!selected)
                         return -ENOMEM;
                 *ret_selected = selected;
@@ -245,25 +365,29 @@ int oomd_kill_by_pgscan_rate(Hashmap *h, const char *prefix, bool dry_run, char
 }
 
 int oomd_kill_by_swap_usage(Hashmap *h, uint64_t threshold_usage, bool dry_run, char **ret_selected) {
-        _cleanup_free_ OomdCGroupContext **sorted = NULL;
+        _cleanup_free_ OomdCGroupContext **candidates = NULL;
+        OomdCGroupContext *c;
+        size_t n_candidates;
         int n, r, ret = 0;
 
         assert(h);
         assert(ret_selected);
 
-        n = oomd_sort_cgroup_contexts(h, compare_swap_usage, NULL, &sorted);
+        /* Usually the first candidate is killed, so do not sort all of them, but take them from a heap. */
+        n = oomd_heapify_cgroup_contexts(h, compare_swap_usage, NULL, &candidates);
         if (n < 0)
                 return n;
+        n_candidates = n;
 
         /* Try to kill cgroups with non-zero swap usage until we either succeed in killing or we get to a cgroup with
          * no swap usage. Threshold killing only cgroups with more than threshold swap usage. */
-        for (int i = 0; i < n; i++) {
+        while ((c = oomd_cgroup_contexts_pop(candidates, &n_candidates, compare_swap_usage))) {
                 /* Skip over cgroups with not enough swap usage. Don't break since there might be "avoid"
                  * cgroups at the end. */
-                if (sorted[i]->swap_usage <= threshold_usage)
+                if (c->swap_usage <= threshold_usage)
                         continue;
 
-                r = oomd_cgroup_kill(sorted[i]->path, true, dry_run);
+                r = oomd_cgroup_kill(c->path, true, dry_run);
                 if (r == 0)
                         continue; /* We didn't find anything to kill */
                 if (r == -ENOMEM)
@@ -274,7 +398,7 @@ int oomd_kill_by_swap_usage(Hashmap *h, uint64_t threshold_usage, bool dry_run,
                         continue; /* Try to find something else to kill */
                 }
 
-                char *selected = strdup(sorted[i]->path);
+                char *selected = strdup(c->path);
                 if (!selected)
                         return -ENOMEM;
                 *ret_selected = selected;
@@ -286,7 +410,7 @@ int oomd_kill_by_swap_usage(Hashmap *h, uint64_t threshold_usage, bool dry_run,
 
 int oomd_cgroup_context_acquire(const char *path, OomdCGroupContext **ret) {
         _cleanup_(oomd_cgroup_context_freep) OomdCGroupContext *ctx = NULL;
-        _cleanup_free_ char *p = NULL, *val = NULL;
+        _cleanup_free_ char *p = NULL;
         bool is_root;
         uid_t uid;
         int r;
@@ -351,13 +475,9 @@ int oomd_cgroup_context_acquire(const char *path, OomdCGroupContext **ret) {
                 else if (r < 0)
                         return log_debug_errno(r, "Error getting memory.swap.current from %s: %m", path);
 
-                r = cg_get_keyed_attribute(SYSTEMD_CGROUP_CONTROLLER, path, "memory.stat", STRV_MAKE("pgscan"), &val);
+                r = cgroup_get_pgscan(path, &ctx->pgscan);
                 if (r < 0)
                         return log_debug_errno(r, "Error getting pgscan from memory.stat under %s: %m", path);
-
-                r = safe_atou64(val, &ctx->pgscan);
-                if (r < 0)
-                        return log_debug_errno(r, "Error converting pgscan value to uint64_t: %m");
         }
 
         ctx->path = strdup(empty_to_root(path));
@@ -108,6 +108,12 @@ static inline int compare_swap_usage(OomdCGroupContext * const *c1, OomdCGroupCo
  * Returns the number of sorted items; negative on error. */
 int oomd_sort_cgroup_contexts(Hashmap *h, oomd_compare_t compare_func, const char *prefix, OomdCGroupContext ***ret);
 
+/* Like oomd_sort_cgroup_contexts(), but only arranges the array as a binary heap in O(n). Take the OomdCGroupContexts
+ * from largest to smallest with oomd_cgroup_contexts_pop(), passing the same `compare_func`, which is cheaper when
+ * only the first few are needed. */
+int oomd_heapify_cgroup_contexts(Hashmap *h, oomd_compare_t compare_func, const char *prefix, OomdCGroupContext ***ret);
+OomdCGroupContext* oomd_cgroup_contexts_pop(OomdCGroupContext **heap, size_t *n, oomd_compare_t compare_func);
+
 /* Returns a negative value on error, 0 if no processes were killed, or 1 if processes were killed. */
 int oomd_cgroup_kill(const char *path, bool recurse, bool dry_run);
 
@@ -10,6 +10,7 @@
 #include "oomd-util.h"
 #include "parse-util.h"
 #include "path-util.h"
+#include "random-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
@@ -439,6 +440,73 @@ static void test_oomd_sort_cgroups(void) {
         sorted_cgroups = mfree(sorted_cgroups);
 }
 
+static void test_oomd_heapify_cgroups(void) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        _cleanup_free_ OomdCGroupContext *ctx = NULL;
+        _cleanup_free_ OomdCGroupContext **sorted = NULL, **heap = NULL;
+        _cleanup_strv_free_ char **paths = NULL;
+        OomdCGroupContext *c;
+        usec_t ts;
+        size_t n_heap;
+        int n;
+
+        /* Make sure the heap yields the candidates in the same order as the sorted array, and print how long
+         * picking the first candidate takes with many cgroups, as oomd does this while memory is scarce. */
+
+        const size_t n_cgroups = 50000;
+
+        assert_se(ctx = new0(OomdCGroupContext, n_cgroups));
+        assert_se(h = hashmap_new(&string_hash_ops));
+
+        for (size_t i = 0; i < n_cgroups; i++) {
+                assert_se(strv_extendf(&paths, "/bench.slice/cg%zu.scope", i) >= 0);
+
+                ctx[i] = (OomdCGroupContext) {
+                        .path = paths[i],
+                        .swap_usage = random_u64() % 1000,
+                        .last_pgscan = 0,
+                        .pgscan = random_u64() % 1000,
+                        .current_memory_usage = i,
+                        .preference = i % 100 == 0 ? MANAGED_OOM_PREFERENCE_AVOID :
+                                      i % 101 == 0 ? MANAGED_OOM_PREFERENCE_OMIT : MANAGED_OOM_PREFERENCE_NONE,
+                };
+
+                assert_se(hashmap_put(h, paths[i], &ctx[i]) >= 0);
+        }
+
+        ts = now(CLOCK_MONOTONIC);
+        n = oomd_sort_cgroup_contexts(h, compare_pgscan_rate_and_memory_usage, NULL, &sorted);
+        log_info("Sorting %zu cgroups took %s", n_cgroups,
+                 FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), ts), 1));
+        assert_se(n > 0);
+
+        ts = now(CLOCK_MONOTONIC);
+        assert_se(oomd_heapify_cgroup_contexts(h, compare_pgscan_rate_and_memory_usage, NULL, &heap) == n);
+        n_heap = n;
+        assert_se(oomd_cgroup_contexts_pop(heap, &n_heap, compare_pgscan_rate_and_memory_usage) == sorted[0]);
+        log_info("Picking the first of %zu cgroups from a heap took %s", n_cgroups,
+                 FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), ts), 1));
+
+        /* Items comparing equal may come out in any order, hence compare the keys. */
+        for (int i = 1; i < n; i++) {
+                assert_se(c = oomd_cgroup_contexts_pop(heap, &n_heap, compare_pgscan_rate_and_memory_usage));
+                assert_se(compare_pgscan_rate_and_memory_usage(&c, &sorted[i]) == 0);
+        }
+        assert_se(n_heap == 0);
+        assert_se(!oomd_cgroup_contexts_pop(heap, &n_heap, compare_pgscan_rate_and_memory_usage));
+
+        sorted = mfree(sorted);
+        heap = mfree(heap);
+
+        n = oomd_sort_cgroup_contexts(h, compare_swap_usage, NULL, &sorted);
+        assert_se(oomd_heapify_cgroup_contexts(h, compare_swap_usage, NULL, &heap) == n);
+        n_heap = n;
+        for (int i = 0; i < n; i++) {
+                assert_se(c = oomd_cgroup_contexts_pop(heap, &n_heap, compare_swap_usage));
+                assert_se(compare_swap_usage(&c, &sorted[i]) == 0);
+        }
+}
+
 int main(void) {
         int r;
 
@@ -449,6 +517,7 @@ int main(void) {
         test_oomd_pressure_above();
         test_oomd_mem_and_swap_free_below();
         test_oomd_sort_cgroups();
+        test_oomd_heapify_cgroups();
 
         /* The following tests operate on live cgroups */
 
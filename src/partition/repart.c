@@ -2729,6 +2729,7 @@ static int context_copy_blocks(Context *context) {
                 _cleanup_(loop_device_unrefp) LoopDevice *d = NULL;
                 _cleanup_free_ char *encrypted = NULL;
                 _cleanup_close_ int encrypted_dev_fd = -1;
+                usec_t start, elapsed;
                 int target_fd;
 
                 if (p->copy_blocks_fd < 0)
@@ -2774,7 +2775,12 @@ static int context_copy_blocks(Context *context) {
                 log_info("Copying in '%s' (%s) on block level into future partition %" PRIu64 ".",
                          p->copy_blocks_path, FORMAT_BYTES(p->copy_blocks_size), p->partno);
 
-                r = copy_bytes_full(p->copy_blocks_fd, target_fd, p->copy_blocks_size, 0, NULL, NULL, NULL, NULL);
+                start = now(CLOCK_MONOTONIC);
+
+                /* If both source and target are regular files (i.e. we are building an image file), reflink
+                 * or copy_file_range() the data, and keep holes in the source as holes in the target, so
+                 * that sparse file system images don't needlessly become fully allocated. */
+                r = copy_bytes(p->copy_blocks_fd, target_fd, p->copy_blocks_size, COPY_REFLINK|COPY_HOLES|COPY_SIGINT);
                 if (r < 0)
                         return log_error_errno(r, "Failed to copy in data from '%s': %m", p->copy_blocks_path);
 
@@ -2796,7 +2802,11 @@ static int context_copy_blocks(Context *context) {
                                 return log_error_errno(r, "Failed to sync loopback device: %m");
                 }
 
-                log_info("Copying in of '%s' on block level completed.", p->copy_blocks_path);
+                elapsed = usec_sub_unsigned(now(CLOCK_MONOTONIC), start);
+                log_info("Copying in of '%s' on block level completed in %s (%s/s).",
+                         p->copy_blocks_path,
+                         FORMAT_TIMESPAN(elapsed, USEC_PER_MSEC),
+                         FORMAT_BYTES(elapsed > 0 ? (uint64_t) ((double) p->copy_blocks_size * USEC_PER_SEC / elapsed) : p->copy_blocks_size));
         }
 
         return 0;
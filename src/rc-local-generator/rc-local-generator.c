@@ -8,6 +8,7 @@
 #include "log.h"
 #include "mkdir.h"
 #include "string-util.h"
+#include "strv.h"
 #include "util.h"
 
 static const char *arg_dest = NULL;
@@ -65,6 +66,9 @@ static int run(const char *dest, const char *dest_early, const char *dest_late)
                 r = add_symlink("rc-local.service", "multi-user.target");
         }
 
+        if (r >= 0 && k >= 0)
+                (void) generator_declare_inputs(STRV_MAKE(RC_LOCAL_PATH));
+
         return r < 0 ? r : k;
 }
 
@@ -1046,6 +1046,7 @@ static int show_statistics(int argc, char **argv, void *userdata) {
         sd_bus *bus = userdata;
         uint64_t n_current_transactions, n_total_transactions,
                 cache_size, n_cache_hit, n_cache_miss,
+                cache_memory, cache_memory_max, n_cache_evicted,
                 n_dnssec_secure, n_dnssec_insecure, n_dnssec_bogus, n_dnssec_indeterminate;
         int r, dnssec_supported;
 
@@ -1085,6 +1086,19 @@ static int show_statistics(int argc, char **argv, void *userdata) {
 
         reply = sd_bus_message_unref(reply);
 
+        r = bus_get_property(bus, bus_resolve_mgr, "CacheMemoryStatistics", &error, &reply, "(ttt)");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cache memory statistics: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_read(reply, "(ttt)",
+                                &cache_memory,
+                                &cache_memory_max,
+                                &n_cache_evicted);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        reply = sd_bus_message_unref(reply);
+
         r = bus_get_property(bus, bus_resolve_mgr, "DNSSECStatistics", &error, &reply, "(tttt)");
         if (r < 0)
                 return log_error_errno(r, "Failed to get DNSSEC statistics: %s", bus_error_message(&error, r));
@@ -1124,6 +1138,12 @@ static int show_statistics(int argc, char **argv, void *userdata) {
                            TABLE_UINT64, n_cache_hit,
                            TABLE_STRING, "Cache Misses:",
                            TABLE_UINT64, n_cache_miss,
+                           TABLE_STRING, "Cache Evictions:",
+                           TABLE_UINT64, n_cache_evicted,
+                           TABLE_STRING, "Current Cache Memory:",
+                           TABLE_SIZE, cache_memory,
+                           TABLE_STRING, "Cache Memory Limit:",
+                           TABLE_SIZE, cache_memory_max,
                            TABLE_EMPTY, TABLE_EMPTY,
                            TABLE_STRING, "DNSSEC Verdicts",
                            TABLE_SET_COLOR, ansi_highlight(),
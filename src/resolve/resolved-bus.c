@@ -1613,6 +1613,28 @@ static int bus_property_get_cache_statistics(
         return sd_bus_message_append(reply, "(ttt)", size, hit, miss);
 }
 
+static int bus_property_get_cache_memory_statistics(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        uint64_t evicted = 0;
+        Manager *m = userdata;
+        DnsScope *s;
+
+        assert(reply);
+        assert(m);
+
+        LIST_FOREACH(scopes, s, m->dns_scopes)
+                evicted += s->cache.n_evicted;
+
+        return sd_bus_message_append(reply, "(ttt)", m->cache_lru.size, m->cache_lru.size_max, evicted);
+}
+
 static int bus_property_get_dnssec_statistics(
                 sd_bus *bus,
                 const char *path,
@@ -1700,11 +1722,13 @@ static int bus_method_reset_statistics(sd_bus_message *message, void *userdata,
         bus_client_log(message, "statistics reset");
 
         LIST_FOREACH(scopes, s, m->dns_scopes)
-                s->cache.n_hit = s->cache.n_miss = 0;
+                s->cache.n_hit = s->cache.n_miss = s->cache.n_evicted = 0;
 
         m->n_transactions_total = 0;
         zero(m->n_dnssec_verdict);
 
+        manager_statistics_reset(m);
+
         return sd_bus_reply_method_return(message, NULL);
 }
 
@@ -2068,6 +2092,7 @@ static const sd_bus_vtable resolve_vtable[] = {
         SD_BUS_PROPERTY("Domains", "a(isb)", bus_property_get_domains, 0, 0),
         SD_BUS_PROPERTY("TransactionStatistics", "(tt)", bus_property_get_transaction_statistics, 0, 0),
         SD_BUS_PROPERTY("CacheStatistics", "(ttt)", bus_property_get_cache_statistics, 0, 0),
+        SD_BUS_PROPERTY("CacheMemoryStatistics", "(ttt)", bus_property_get_cache_memory_statistics, 0, 0),
         SD_BUS_PROPERTY("DNSSEC", "s", bus_property_get_dnssec_mode, 0, 0),
         SD_BUS_PROPERTY("DNSSECStatistics", "(tttt)", bus_property_get_dnssec_statistics, 0, 0),
         SD_BUS_PROPERTY("DNSSECSupported", "b", bus_property_get_dnssec_supported, 0, 0),
@@ -11,10 +11,6 @@
 #include "resolved-dns-packet.h"
 #include "string-util.h"
 
-/* Never cache more than 4K entries. RFC 1536, Section 5 suggests to
- * leave DNS caches unbounded, but that's crazy. */
-#define CACHE_MAX 4096
-
 /* We never keep any item longer than 2h in our cache */
 #define CACHE_TTL_MAX_USEC (2 * USEC_PER_HOUR)
 
@@ -24,8 +20,15 @@
 
 #define CACHEABLE_QUERY_FLAGS (SD_RESOLVED_AUTHENTICATED|SD_RESOLVED_CONFIDENTIAL)
 
+/* The TTL of stale RRs, as recommended by RFC 8767, Section 4 */
+#define CACHE_STALE_TTL_SEC 30U
+
+/* An entry is refreshed ahead of its expiry once it was looked up that often, and is in the last tenth of
+ * its lifetime */
+#define CACHE_REFRESH_HITS_MIN 3U
+#define CACHE_REFRESH_FRACTION 10U
+
 typedef enum DnsCacheItemType DnsCacheItemType;
-typedef struct DnsCacheItem DnsCacheItem;
 
 enum DnsCacheItemType {
         DNS_CACHE_POSITIVE,
@@ -43,6 +46,10 @@ struct DnsCacheItem {
         DnsPacket *full_packet;  /* The full packet this information was acquired with */
 
         usec_t until;
+        usec_t stale_until;      /* When to remove the item, if stale items are kept, otherwise the same as until */
+        usec_t refresh_after;    /* When to refresh the item ahead of its expiry, if it is popular */
+        unsigned n_hits;
+        bool refreshing;         /* Whether the caller was told to refresh this item already */
         uint64_t query_flags;    /* SD_RESOLVED_AUTHENTICATED and/or SD_RESOLVED_CONFIDENTIAL */
         DnssecResult dnssec_result;
 
@@ -53,6 +60,10 @@ struct DnsCacheItem {
         unsigned prioq_idx;
         LIST_FIELDS(DnsCacheItem, by_key);
 
+        DnsCache *cache;         /* The cache this item is linked into, if it is */
+        size_t size;             /* The memory accounted for this item in DnsCacheLRU */
+        LIST_FIELDS(DnsCacheItem, lru);
+
         bool shared_owner;
 };
 
@@ -95,6 +106,80 @@ static DnsCacheItem* dns_cache_item_free(DnsCacheItem *i) {
 }
 DEFINE_TRIVIAL_CLEANUP_FUNC(DnsCacheItem*, dns_cache_item_free);
 
+static size_t dns_cache_item_size(DnsCacheItem *i) {
+        size_t size = sizeof(DnsCacheItem);
+
+        assert(i);
+
+        /* This is only an estimate: keys, RRs and packets may be shared between items, and we don't follow
+         * the RR data beyond its wire format. But it scales with what we actually keep around, unlike a
+         * plain count of items. */
+
+        if (i->key)
+                size += sizeof(DnsResourceKey) + strlen(dns_resource_key_name(i->key)) + 1;
+        if (i->rr)
+                size += sizeof(DnsResourceRecord) + i->rr->wire_format_size;
+        if (i->full_packet)
+                size += sizeof(DnsPacket) + i->full_packet->size;
+
+        return size;
+}
+
+static void dns_cache_item_lru_link(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(c->lru);
+        assert(i);
+        assert(!i->cache);
+
+        i->cache = c;
+        i->size = dns_cache_item_size(i);
+
+        LIST_PREPEND(lru, c->lru->items, i);
+        if (!c->lru->items_tail)
+                c->lru->items_tail = i;
+
+        c->lru->size += i->size;
+}
+
+static void dns_cache_item_lru_unlink(DnsCacheItem *i) {
+        DnsCacheLRU *lru;
+
+        assert(i);
+
+        if (!i->cache)
+                return;
+
+        lru = i->cache->lru;
+
+        if (lru->items_tail == i)
+                lru->items_tail = i->lru_prev;
+        LIST_REMOVE(lru, lru->items, i);
+
+        assert(lru->size >= i->size);
+        lru->size -= i->size;
+
+        i->cache = NULL;
+        i->size = 0;
+}
+
+static void dns_cache_item_lru_touch(DnsCacheItem *i) {
+        DnsCacheLRU *lru;
+
+        assert(i);
+
+        if (!i->cache)
+                return;
+
+        lru = i->cache->lru;
+        if (lru->items == i)
+                return;
+
+        if (lru->items_tail == i)
+                lru->items_tail = i->lru_prev;
+        LIST_REMOVE(lru, lru->items, i);
+        LIST_PREPEND(lru, lru->items, i);
+}
+
 static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
         DnsCacheItem *first;
 
@@ -112,6 +197,7 @@ static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
                 hashmap_remove(c->by_key, i->key);
 
         prioq_remove(c->by_expiry, i, &i->prioq_idx);
+        dns_cache_item_lru_unlink(i);
 
         dns_cache_item_free(i);
 }
@@ -146,6 +232,7 @@ static bool dns_cache_remove_by_key(DnsCache *c, DnsResourceKey *key) {
 
         LIST_FOREACH_SAFE(by_key, i, n, first) {
                 prioq_remove(c->by_expiry, i, &i->prioq_idx);
+                dns_cache_item_lru_unlink(i);
                 dns_cache_item_free(i);
         }
 
@@ -165,36 +252,47 @@ void dns_cache_flush(DnsCache *c) {
 
         c->by_key = hashmap_free(c->by_key);
         c->by_expiry = prioq_free(c->by_expiry);
+
+        /* The stub workers check this from their threads */
+        if (c->lru)
+                (void) __atomic_add_fetch(&c->lru->generation, 1, __ATOMIC_RELEASE);
 }
 
-static void dns_cache_make_space(DnsCache *c, unsigned add) {
+static void dns_cache_make_space(DnsCache *c, size_t add) {
+        DnsCacheLRU *lru;
+
         assert(c);
+        assert(c->lru);
 
-        if (add <= 0)
-                return;
+        lru = c->lru;
 
-        /* Makes space for n new entries. Note that we actually allow
-         * the cache to grow beyond CACHE_MAX, but only when we shall
-         * add more RRs to the cache than CACHE_MAX at once. In that
-         * case the cache will be emptied completely otherwise. */
+        /* Makes space for a new entry of the specified size, by evicting the least recently used entries of
+         * all caches. Note that the cache may grow beyond the budget if a single entry is larger than the
+         * budget, the cache is emptied completely otherwise. */
 
-        for (;;) {
-                _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
-                DnsCacheItem *i;
+        while (lru->items_tail && lru->size + add > lru->size_max) {
+                DnsCacheItem *i = lru->items_tail;
+                DnsCache *owner = i->cache;
+                char key_str[DNS_RESOURCE_KEY_STRING_MAX];
 
-                if (prioq_size(c->by_expiry) <= 0)
-                        break;
+                log_debug("Evicting %scache entry for %s, cache is full.",
+                          i->shared_owner ? "shared " : "",
+                          dns_resource_key_to_string(i->key, key_str, sizeof key_str));
 
-                if (prioq_size(c->by_expiry) + add < CACHE_MAX)
-                        break;
+                owner->n_evicted++;
 
-                i = prioq_peek(c->by_expiry);
-                assert(i);
+                /* Depending whether this is an mDNS shared entry either remove only this one RR or the whole
+                 * RRset, like dns_cache_prune() does. */
+                if (i->shared_owner)
+                        dns_cache_item_unlink_and_free(owner, i);
+                else {
+                        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
 
-                /* Take an extra reference to the key so that it
-                 * doesn't go away in the middle of the remove call */
-                key = dns_resource_key_ref(i->key);
-                dns_cache_remove_by_key(c, key);
+                        /* Take an extra reference to the key so that it
+                         * doesn't go away in the middle of the remove call */
+                        key = dns_resource_key_ref(i->key);
+                        dns_cache_remove_by_key(owner, key);
+                }
         }
 }
 
@@ -216,7 +314,7 @@ void dns_cache_prune(DnsCache *c) {
                 if (t <= 0)
                         t = now(clock_boottime_or_monotonic());
 
-                if (i->until > t)
+                if (i->stale_until > t)
                         break;
 
                 /* Depending whether this is an mDNS shared entry
@@ -242,13 +340,14 @@ void dns_cache_prune(DnsCache *c) {
 static int dns_cache_item_prioq_compare_func(const void *a, const void *b) {
         const DnsCacheItem *x = a, *y = b;
 
-        return CMP(x->until, y->until);
+        return CMP(x->stale_until, y->stale_until);
 }
 
 static int dns_cache_init(DnsCache *c) {
         int r;
 
         assert(c);
+        assert(c->lru);
 
         r = prioq_ensure_allocated(&c->by_expiry, dns_cache_item_prioq_compare_func);
         if (r < 0)
@@ -297,6 +396,7 @@ static int dns_cache_link_item(DnsCache *c, DnsCacheItem *i) {
                 }
         }
 
+        dns_cache_item_lru_link(c, i);
         return 0;
 }
 
@@ -352,6 +452,19 @@ static usec_t calculate_until(
         return timestamp + u;
 }
 
+static void dns_cache_item_set_until(DnsCache *c, DnsCacheItem *i, usec_t until, usec_t timestamp) {
+        assert(c);
+        assert(i);
+        assert(until >= timestamp);
+
+        i->until = until;
+        i->refresh_after = until - (until - timestamp) / CACHE_REFRESH_FRACTION;
+        i->refreshing = false;
+
+        /* Strange rcodes are not worth serving after they expired, see RFC 8767, Section 5 */
+        i->stale_until = i->type == DNS_CACHE_RCODE ? until : usec_add(until, c->stale_retention_usec);
+}
+
 static void dns_cache_item_update_positive(
                 DnsCache *c,
                 DnsCacheItem *i,
@@ -395,7 +508,7 @@ static void dns_cache_item_update_positive(
         dns_packet_unref(i->full_packet);
         i->full_packet = full_packet;
 
-        i->until = calculate_until(rr, min_ttl, UINT32_MAX, timestamp, false);
+        dns_cache_item_set_until(c, i, calculate_until(rr, min_ttl, UINT32_MAX, timestamp, false), timestamp);
         i->query_flags = query_flags & CACHEABLE_QUERY_FLAGS;
         i->shared_owner = shared_owner;
         i->dnssec_result = dnssec_result;
@@ -406,6 +519,10 @@ static void dns_cache_item_update_positive(
         i->owner_address = *owner_address;
 
         prioq_reshuffle(c->by_expiry, i, &i->prioq_idx);
+
+        /* The size changed, and the entry counts as used again */
+        dns_cache_item_lru_unlink(i);
+        dns_cache_item_lru_link(c, i);
 }
 
 static int dns_cache_put_positive(
@@ -476,8 +593,6 @@ static int dns_cache_put_positive(
         if (r < 0)
                 return r;
 
-        dns_cache_make_space(c, 1);
-
         i = new(DnsCacheItem, 1);
         if (!i)
                 return -ENOMEM;
@@ -488,7 +603,6 @@ static int dns_cache_put_positive(
                 .rr = dns_resource_record_ref(rr),
                 .answer = dns_answer_ref(answer),
                 .full_packet = dns_packet_ref(full_packet),
-                .until = calculate_until(rr, min_ttl, UINT32_MAX, timestamp, false),
                 .query_flags = query_flags & CACHEABLE_QUERY_FLAGS,
                 .shared_owner = shared_owner,
                 .dnssec_result = dnssec_result,
@@ -498,6 +612,10 @@ static int dns_cache_put_positive(
                 .prioq_idx = PRIOQ_IDX_NULL,
         };
 
+        dns_cache_item_set_until(c, i, calculate_until(rr, min_ttl, UINT32_MAX, timestamp, false), timestamp);
+
+        dns_cache_make_space(c, dns_cache_item_size(i));
+
         r = dns_cache_link_item(c, i);
         if (r < 0)
                 return r;
@@ -570,8 +688,6 @@ static int dns_cache_put_negative(
         if (r < 0)
                 return r;
 
-        dns_cache_make_space(c, 1);
-
         i = new(DnsCacheItem, 1);
         if (!i)
                 return -ENOMEM;
@@ -593,9 +709,11 @@ static int dns_cache_put_negative(
         /* Determine how long to cache this entry. In case we have some RRs in the answer use the lowest TTL
          * of any of them. Typically that's the SOA's TTL, which is OK, but could possibly be lower because
          * of some other RR. Let's better take the lowest option here than a needlessly high one */
-        i->until =
-                i->type == DNS_CACHE_RCODE ? timestamp + CACHE_TTL_STRANGE_RCODE_USEC :
-                calculate_until(soa, dns_answer_min_ttl(answer), nsec_ttl, timestamp, true);
+        dns_cache_item_set_until(
+                        c, i,
+                        i->type == DNS_CACHE_RCODE ? timestamp + CACHE_TTL_STRANGE_RCODE_USEC :
+                        calculate_until(soa, dns_answer_min_ttl(answer), nsec_ttl, timestamp, true),
+                        timestamp);
 
         if (i->type == DNS_CACHE_NXDOMAIN) {
                 /* NXDOMAIN entries should apply equally to all types, so we use ANY as
@@ -614,6 +732,8 @@ static int dns_cache_put_negative(
         } else
                 i->key = dns_resource_key_ref(key);
 
+        dns_cache_make_space(c, dns_cache_item_size(i));
+
         r = dns_cache_link_item(c, i);
         if (r < 0)
                 return r;
@@ -696,7 +816,6 @@ int dns_cache_put(
         bool weird_rcode = false;
         DnsAnswerItem *item;
         DnsAnswerFlags flags;
-        unsigned cache_keys;
         usec_t timestamp;
         int r;
 
@@ -731,13 +850,6 @@ int dns_cache_put(
                 weird_rcode = true;
         }
 
-        cache_keys = dns_answer_size(answer);
-        if (key)
-                cache_keys++;
-
-        /* Make some space for our new entries */
-        dns_cache_make_space(c, cache_keys);
-
         timestamp = now(clock_boottime_or_monotonic());
 
         /* Second, add in positive entries for all contained RRs */
@@ -943,9 +1055,10 @@ static int answer_add_clamp_ttl(
                 /* Let's determine how much time is left for this cache entry. Note that we round down, but
                  * clamp this to be 1s at minimum, since we usually want records to remain cached better too
                  * short a time than too long a time, but otoh don't want to return 0 ever, since that has
-                 * special semantics in various contexts — in particular in mDNS */
+                 * special semantics in various contexts — in particular in mDNS. Stale records are returned
+                 * with a fixed TTL. */
 
-                left_ttl = MAX(1U, LESS_BY(until, current) / USEC_PER_SEC);
+                left_ttl = until > current ? MAX(1U, (until - current) / USEC_PER_SEC) : CACHE_STALE_TTL_SEC;
 
                 patched = dns_resource_record_ref(rr);
 
@@ -976,11 +1089,13 @@ int dns_cache_lookup(
                 DnsCache *c,
                 DnsResourceKey *key,
                 uint64_t query_flags,
+                bool serve_stale,
                 int *ret_rcode,
                 DnsAnswer **ret_answer,
                 DnsPacket **ret_full_packet,
                 uint64_t *ret_query_flags,
-                DnssecResult *ret_dnssec_result) {
+                DnssecResult *ret_dnssec_result,
+                bool *ret_refresh) {
 
         _cleanup_(dns_packet_unrefp) DnsPacket *full_packet = NULL;
         _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
@@ -990,7 +1105,8 @@ int dns_cache_lookup(
         bool nxdomain = false;
         DnsCacheItem *j, *first, *nsec = NULL;
         bool have_authenticated = false, have_non_authenticated = false, have_confidential = false, have_non_confidential = false;
-        usec_t current = 0;
+        bool refresh = false;
+        usec_t current;
         int found_rcode = -1;
         DnssecResult dnssec_result = -1;
         int have_dnssec_result = -1;
@@ -1016,12 +1132,8 @@ int dns_cache_lookup(
                 goto miss;
         }
 
-        if (FLAGS_SET(query_flags, SD_RESOLVED_CLAMP_TTL)) {
-                /* 'current' is always passed to answer_add_clamp_ttl(), but is only used conditionally.
-                 * We'll do the same assert there to make sure that it was initialized properly. */
-                current = now(clock_boottime_or_monotonic());
-                assert(current > 0);
-        }
+        current = now(clock_boottime_or_monotonic());
+        assert(current > 0);
 
         LIST_FOREACH(by_key, j, first) {
                 /* If the caller doesn't allow us to answer questions from cache data learned from
@@ -1034,6 +1146,27 @@ int dns_cache_lookup(
                         goto miss;
                 }
 
+                /* Expired entries are only kept around to be served if the servers cannot be reached */
+                if (j->until <= current && !serve_stale) {
+                        log_debug("Cache entry for %s is stale, not using it.",
+                                  dns_resource_key_to_string(key, key_str, sizeof key_str));
+
+                        goto miss;
+                }
+
+                dns_cache_item_lru_touch(j);
+
+                /* Tell the caller once to refresh popular entries shortly before they expire, so that
+                 * they never actually expire while they are being used. */
+                j->n_hits++;
+                if (!j->refreshing &&
+                    j->n_hits >= CACHE_REFRESH_HITS_MIN &&
+                    current >= j->refresh_after &&
+                    current < j->until) {
+                        j->refreshing = true;
+                        refresh = true;
+                }
+
                 if (j->type == DNS_CACHE_NXDOMAIN)
                         nxdomain = true;
                 else if (j->type == DNS_CACHE_RCODE)
@@ -1129,6 +1262,8 @@ int dns_cache_lookup(
                         *ret_query_flags = 0;
                 if (ret_dnssec_result)
                         *ret_dnssec_result = dnssec_result;
+                if (ret_refresh)
+                        *ret_refresh = refresh;
 
                 c->n_hit++;
                 return 1;
@@ -1154,6 +1289,8 @@ int dns_cache_lookup(
                         *ret_query_flags = nsec->query_flags;
                 if (ret_dnssec_result)
                         *ret_dnssec_result = nsec->dnssec_result;
+                if (ret_refresh)
+                        *ret_refresh = refresh;
 
                 if (!bitmap_isset(nsec->rr->nsec.types, key->type) &&
                     !bitmap_isset(nsec->rr->nsec.types, DNS_TYPE_CNAME) &&
@@ -1186,6 +1323,8 @@ int dns_cache_lookup(
                                 ((have_confidential && !have_non_confidential) ? SD_RESOLVED_CONFIDENTIAL : 0);
                 if (ret_dnssec_result)
                         *ret_dnssec_result = dnssec_result;
+                if (ret_refresh)
+                        *ret_refresh = refresh;
 
                 return 1;
         }
@@ -1204,6 +1343,8 @@ int dns_cache_lookup(
                         ((have_confidential && !have_non_confidential) ? SD_RESOLVED_CONFIDENTIAL : 0);
         if (ret_dnssec_result)
                 *ret_dnssec_result = dnssec_result;
+        if (ret_refresh)
+                *ret_refresh = refresh;
 
         return n;
 
@@ -1218,6 +1359,8 @@ miss:
                 *ret_query_flags = 0;
         if (ret_dnssec_result)
                 *ret_dnssec_result = _DNSSEC_RESULT_INVALID;
+        if (ret_refresh)
+                *ret_refresh = false;
 
         c->n_miss++;
         return 0;
@@ -8,11 +8,29 @@
 #include "resolved-dns-dnssec.h"
 #include "time-util.h"
 
+/* The default memory budget of the caches of all scopes together, see CacheSizeMax= */
+#define DNS_CACHE_SIZE_MAX_DEFAULT (8U * 1024U * 1024U)
+
+typedef struct DnsCacheItem DnsCacheItem;
+
+/* The caches of all scopes share one memory budget. When it is exhausted, the least recently used entries
+ * are evicted first, regardless of the scope they belong to. */
+typedef struct DnsCacheLRU {
+        LIST_HEAD(DnsCacheItem, items); /* most recently used first */
+        DnsCacheItem *items_tail;
+        uint64_t size;                  /* estimated memory used by all cache entries, in bytes */
+        uint64_t size_max;
+        uint64_t generation;            /* bumped whenever a cache is flushed */
+} DnsCacheLRU;
+
 typedef struct DnsCache {
         Hashmap *by_key;
         Prioq *by_expiry;
+        DnsCacheLRU *lru;
+        usec_t stale_retention_usec;    /* How long to keep entries after they expired, see StaleRetentionSec= */
         unsigned n_hit;
         unsigned n_miss;
+        unsigned n_evicted;
 } DnsCache;
 
 #include "resolved-dns-answer.h"
@@ -40,11 +58,13 @@ int dns_cache_lookup(
                 DnsCache *c,
                 DnsResourceKey *key,
                 uint64_t query_flags,
+                bool serve_stale,
                 int *ret_rcode,
                 DnsAnswer **ret_answer,
                 DnsPacket **ret_full_packet,
                 uint64_t *ret_query_flags,
-                DnssecResult *ret_dnssec_result);
+                DnssecResult *ret_dnssec_result,
+                bool *ret_refresh);
 
 int dns_cache_check_conflicts(DnsCache *cache, DnsResourceRecord *rr, int owner_family, const union in_addr_union *owner_address);
 
@@ -7,8 +7,10 @@
 #include "gcrypt-util.h"
 #include "hexdecoct.h"
 #include "memory-util.h"
+#include "random-util.h"
 #include "resolved-dns-dnssec.h"
 #include "resolved-dns-packet.h"
+#include "siphash24.h"
 #include "sort-util.h"
 #include "string-table.h"
 
@@ -60,6 +62,79 @@ uint16_t dnssec_keytag(DnsResourceRecord *dnskey, bool mask_revoke) {
 
 #if HAVE_GCRYPT
 
+/* Verifying signatures is expensive, and the same RRsets, most notably the DNSKEY and DS RRsets along the
+ * chain of trust, are verified again and again. Hence remember the signed data, signature and public key
+ * of successful verifications, so that they don't have to be repeated. The table is direct-mapped, a new
+ * entry replaces whatever was in its slot before. */
+#define VERIFY_CACHE_SLOTS 512U
+
+typedef struct VerifyCacheEntry {
+        uint8_t *data; /* the signed data, followed by the signature and the public key */
+        size_t data_size, signature_size, key_size;
+} VerifyCacheEntry;
+
+static VerifyCacheEntry verify_cache[VERIFY_CACHE_SLOTS];
+static uint8_t verify_cache_hash_key[16];
+static bool verify_cache_hash_key_set = false;
+
+static unsigned verify_cache_slot(const void *data, size_t data_size, DnsResourceRecord *rrsig, DnsResourceRecord *dnskey) {
+        struct siphash state;
+
+        if (!verify_cache_hash_key_set) {
+                random_bytes(verify_cache_hash_key, sizeof(verify_cache_hash_key));
+                verify_cache_hash_key_set = true;
+        }
+
+        siphash24_init(&state, verify_cache_hash_key);
+        siphash24_compress(data, data_size, &state);
+        siphash24_compress(rrsig->rrsig.signature, rrsig->rrsig.signature_size, &state);
+        siphash24_compress(dnskey->dnskey.key, dnskey->dnskey.key_size, &state);
+
+        return siphash24_finalize(&state) % VERIFY_CACHE_SLOTS;
+}
+
+static bool verify_cache_contains(unsigned slot, const void *data, size_t data_size, DnsResourceRecord *rrsig, DnsResourceRecord *dnskey) {
+        const VerifyCacheEntry *e = verify_cache + slot;
+
+        /* Compare everything byte by byte, the hash only picks the slot */
+        return e->data &&
+                e->data_size == data_size &&
+                e->signature_size == rrsig->rrsig.signature_size &&
+                e->key_size == dnskey->dnskey.key_size &&
+                memcmp(e->data, data, data_size) == 0 &&
+                memcmp(e->data + data_size, rrsig->rrsig.signature, e->signature_size) == 0 &&
+                memcmp(e->data + data_size + e->signature_size, dnskey->dnskey.key, e->key_size) == 0;
+}
+
+static void verify_cache_add(unsigned slot, const void *data, size_t data_size, DnsResourceRecord *rrsig, DnsResourceRecord *dnskey) {
+        VerifyCacheEntry *e = verify_cache + slot;
+        uint8_t *p;
+
+        p = malloc(data_size + rrsig->rrsig.signature_size + dnskey->dnskey.key_size);
+        if (!p)
+                return; /* It's just a cache */
+
+        memcpy(mempcpy(mempcpy(p, data, data_size),
+                       rrsig->rrsig.signature, rrsig->rrsig.signature_size),
+               dnskey->dnskey.key, dnskey->dnskey.key_size);
+
+        free(e->data);
+        *e = (VerifyCacheEntry) {
+                .data = p,
+                .data_size = data_size,
+                .signature_size = rrsig->rrsig.signature_size,
+                .key_size = dnskey->dnskey.key_size,
+        };
+}
+
+#if VALGRIND
+_destructor_ static void verify_cache_free(void) {
+        /* Be nice to valgrind */
+        for (unsigned i = 0; i < VERIFY_CACHE_SLOTS; i++)
+                verify_cache[i].data = mfree(verify_cache[i].data);
+}
+#endif
+
 static int rr_compare(DnsResourceRecord * const *a, DnsResourceRecord * const *b) {
         const DnsResourceRecord *x = *a, *y = *b;
         size_t m;
@@ -643,6 +718,7 @@ int dnssec_verify_rrset(
         _cleanup_free_ char *sig_data = NULL;
         _cleanup_fclose_ FILE *f = NULL;
         size_t hash_size;
+        unsigned slot;
         void *hash;
         bool wildcard;
 
@@ -793,6 +869,13 @@ int dnssec_verify_rrset(
         if (r < 0)
                 return r;
 
+        /* Skip the public key operation if we successfully verified the very same data before */
+        slot = verify_cache_slot(sig_data, sig_size, rrsig, dnskey);
+        if (verify_cache_contains(slot, sig_data, sig_size, rrsig, dnskey)) {
+                r = 1;
+                goto verified;
+        }
+
         initialize_libgcrypt(false);
 
         switch (rrsig->rrsig.algorithm) {
@@ -866,7 +949,10 @@ int dnssec_verify_rrset(
         }
         if (r < 0)
                 return r;
+        if (r > 0)
+                verify_cache_add(slot, sig_data, sig_size, rrsig, dnskey);
 
+verified:
         /* Now, fix the ttl, expiry, and remember the synthesizing source and the signer */
         if (r > 0)
                 dnssec_fix_rrset_ttl(list, n, rrsig, realtime);
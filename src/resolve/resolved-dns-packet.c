@@ -1475,6 +1475,10 @@ int dns_packet_read_name(
                         if (r < 0)
                                 return r;
 
+                        /* If the caller only wants to skip over the name, there's no need to build it */
+                        if (!ret)
+                                continue;
+
                         if (!GREEDY_REALLOC(name, n + !first + DNS_LABEL_ESCAPED_MAX))
                                 return -ENOMEM;
 
@@ -1511,10 +1515,12 @@ int dns_packet_read_name(
                         return -EBADMSG;
         }
 
-        if (!GREEDY_REALLOC(name, n + 1))
-                return -ENOMEM;
+        if (ret) {
+                if (!GREEDY_REALLOC(name, n + 1))
+                        return -ENOMEM;
 
-        name[n] = 0;
+                name[n] = 0;
+        }
 
         if (after_rindex != 0)
                 p->rindex= after_rindex;
@@ -1640,7 +1646,7 @@ int dns_packet_read_key(
         assert(p);
         INIT_REWINDER(rewinder, p);
 
-        r = dns_packet_read_name(p, &name, true, NULL);
+        r = dns_packet_read_name(p, ret ? &name : NULL, true, NULL);
         if (r < 0)
                 return r;
 
@@ -8,6 +8,7 @@
 #include "escape.h"
 #include "hexdecoct.h"
 #include "memory-util.h"
+#include "mempool.h"
 #include "resolved-dns-dnssec.h"
 #include "resolved-dns-packet.h"
 #include "resolved-dns-rr.h"
@@ -23,7 +24,7 @@ DnsResourceKey* dns_resource_key_new(uint16_t class, uint16_t type, const char *
         assert(name);
 
         l = strlen(name);
-        k = malloc0(sizeof(DnsResourceKey) + l + 1);
+        k = mempool_alloc0(sizeof(DnsResourceKey) + l + 1);
         if (!k)
                 return NULL;
 
@@ -97,7 +98,7 @@ DnsResourceKey* dns_resource_key_new_consume(uint16_t class, uint16_t type, char
 
         assert(name);
 
-        k = new(DnsResourceKey, 1);
+        k = mempool_new(DnsResourceKey);
         if (!k)
                 return NULL;
 
@@ -134,8 +135,12 @@ DnsResourceKey* dns_resource_key_unref(DnsResourceKey *k) {
         assert(k->n_ref > 0);
 
         if (k->n_ref == 1) {
-                free(k->_name);
-                free(k);
+                /* Keys are allocated from the pool, either with the name inline or separately */
+                if (k->_name) {
+                        free(k->_name);
+                        mempool_free(k, sizeof(DnsResourceKey));
+                } else
+                        mempool_free(k, sizeof(DnsResourceKey) + strlen((char*) k + sizeof(DnsResourceKey)) + 1);
         } else
                 k->n_ref--;
 
@@ -373,7 +378,7 @@ bool dns_resource_key_reduce(DnsResourceKey **a, DnsResourceKey **b) {
 DnsResourceRecord* dns_resource_record_new(DnsResourceKey *key) {
         DnsResourceRecord *rr;
 
-        rr = new(DnsResourceRecord, 1);
+        rr = mempool_new(DnsResourceRecord);
         if (!rr)
                 return NULL;
 
@@ -490,7 +495,8 @@ static DnsResourceRecord* dns_resource_record_free(DnsResourceRecord *rr) {
         }
 
         free(rr->to_string);
-        return mfree(rr);
+        mempool_free(rr, sizeof(DnsResourceRecord));
+        return NULL;
 }
 
 DEFINE_TRIVIAL_REF_UNREF_FUNC(DnsResourceRecord, dns_resource_record, dns_resource_record_free);
@@ -40,6 +40,7 @@ int dns_scope_new(Manager *m, DnsScope **ret, Link *l, DnsProtocol protocol, int
                 .link = l,
                 .protocol = protocol,
                 .family = family,
+                .cache.lru = &m->cache_lru,
                 .resend_timeout = MULTICAST_RESEND_TIMEOUT_MIN_USEC,
         };
 
@@ -58,6 +59,9 @@ int dns_scope_new(Manager *m, DnsScope **ret, Link *l, DnsProtocol protocol, int
                         s->dns_over_tls_mode = manager_get_dns_over_tls_mode(m);
                 }
 
+                /* Serving stale data is only useful for unicast DNS, where servers may be unreachable */
+                s->cache.stale_retention_usec = m->stale_retention_usec;
+
         } else {
                 s->dnssec_mode = DNSSEC_NO;
                 s->dns_over_tls_mode = DNS_OVER_TLS_NO;
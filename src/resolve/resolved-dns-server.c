@@ -19,6 +19,11 @@
 /* The number of times we will attempt a certain feature set before degrading */
 #define DNS_SERVER_FEATURE_RETRY_ATTEMPTS 3
 
+/* How many connections to keep open to a server, and how many queries to pipeline on one of them before
+ * opening another */
+#define DNS_SERVER_STREAMS_MAX 4U
+#define DNS_SERVER_STREAM_PIPELINE_MAX 16U
+
 int dns_server_new(
                 Manager *m,
                 DnsServer **ret,
@@ -112,7 +117,7 @@ int dns_server_new(
 static DnsServer* dns_server_free(DnsServer *s)  {
         assert(s);
 
-        dns_server_unref_stream(s);
+        dns_server_unref_streams(s);
 
 #if ENABLE_DNS_OVER_TLS
         dnstls_server_free(s);
@@ -169,8 +174,8 @@ void dns_server_unlink(DnsServer *s) {
         if (s->manager->current_dns_server == s)
                 manager_set_dns_server(s->manager, NULL);
 
-        /* No need to keep a default stream around anymore */
-        dns_server_unref_stream(s);
+        /* No need to keep the streams around anymore */
+        dns_server_unref_streams(s);
 
         dns_server_unref(s);
 }
@@ -995,8 +1000,8 @@ void dns_server_reset_features(DnsServer *s) {
 
         dns_server_reset_counters(s);
 
-        /* Let's close the default stream, so that we reprobe with the new features */
-        dns_server_unref_stream(s);
+        /* Let's close the streams, so that we reprobe with the new features */
+        dns_server_unref_streams(s);
 }
 
 void dns_server_reset_features_all(DnsServer *s) {
@@ -1061,18 +1066,82 @@ void dns_server_dump(DnsServer *s, FILE *f) {
                 yes_no(s->packet_do_off));
 }
 
-void dns_server_unref_stream(DnsServer *s) {
-        DnsStream *ref;
+void dns_server_add_stream(DnsServer *s, DnsStream *stream) {
+        assert(s);
+        assert(stream);
+        assert(!stream->server);
+
+        /* Don't let the pool grow without bounds, drop the oldest stream instead. Transactions still
+         * pending on it keep it alive until they are done. */
+        if (s->n_streams >= DNS_SERVER_STREAMS_MAX) {
+                DnsStream *tail;
+
+                LIST_FIND_TAIL(streams_by_server, s->streams, tail);
+                dns_server_remove_stream(s, tail);
+        }
+
+        stream->server = dns_server_ref(s);
+        LIST_PREPEND(streams_by_server, s->streams, dns_stream_ref(stream));
+        s->n_streams++;
+}
 
+void dns_server_remove_stream(DnsServer *s, DnsStream *stream) {
         assert(s);
+        assert(stream);
 
-        /* Detaches the default stream of this server. Some special care needs to be taken here, as that stream and
-         * this server reference each other. First, take the stream out of the server. It's destructor will check if it
-         * is registered with us, hence let's invalidate this separately, so that it is already unregistered. */
-        ref = TAKE_PTR(s->stream);
+        /* Detaches a stream from this server. Some special care needs to be taken here, as the stream and
+         * this server reference each other. First, take the stream out of the server. Its destructor will
+         * check if it is registered with us, hence let's unregister it before dropping our reference. */
+        if (!stream->streams_by_server_prev && s->streams != stream)
+                return;
+
+        LIST_REMOVE(streams_by_server, s->streams, stream);
+        assert(s->n_streams > 0);
+        s->n_streams--;
 
         /* And then, unref it */
-        dns_stream_unref(ref);
+        dns_stream_unref(stream);
+}
+
+void dns_server_unref_streams(DnsServer *s) {
+        assert(s);
+
+        while (s->streams)
+                dns_server_remove_stream(s, s->streams);
+}
+
+DnsStream *dns_server_pick_stream(DnsServer *s, bool encrypted) {
+        DnsStream *i, *best = NULL;
+        unsigned n_best = UINT_MAX, n_matching = 0;
+
+        assert(s);
+
+        /* Returns the least busy stream with the right encryption, or NULL if a new one shall be opened */
+
+        LIST_FOREACH(streams_by_server, i, s->streams) {
+                DnsTransaction *t;
+                unsigned n = 0;
+
+                if (i->encrypted != encrypted)
+                        continue;
+
+                n_matching++;
+
+                LIST_FOREACH(transactions_by_stream, t, i->transactions)
+                        n++;
+
+                if (n < n_best) {
+                        best = i;
+                        n_best = n;
+                }
+        }
+
+        /* If all streams have plenty of queries in flight, open another one in parallel, so that a slow
+         * reply doesn't hold up everything else queued behind it */
+        if (best && n_best >= DNS_SERVER_STREAM_PIPELINE_MAX && n_matching < DNS_SERVER_STREAMS_MAX)
+                return NULL;
+
+        return best;
 }
 
 DnsScope *dns_server_scope(DnsServer *s) {
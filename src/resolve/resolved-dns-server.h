@@ -4,6 +4,7 @@
 #include "in-addr-util.h"
 #include "list.h"
 #include "resolve-util.h"
+#include "resolved-statistics.h"
 #include "time-util.h"
 
 typedef struct DnsScope DnsScope;
@@ -65,8 +66,9 @@ struct DnsServer {
         char *server_string;
         char *server_string_full;
 
-        /* The long-lived stream towards this server. */
-        DnsStream *stream;
+        /* The long-lived streams towards this server, queries are pipelined on them. */
+        LIST_HEAD(DnsStream, streams);
+        unsigned n_streams;
 
 #if ENABLE_DNS_OVER_TLS
         DnsTlsServerData dnstls_data;
@@ -91,6 +93,9 @@ struct DnsServer {
         usec_t verified_usec;
         usec_t features_grace_period_usec;
 
+        /* Round trip times of the replies we got from this server */
+        LatencyHistogram rtt;
+
         /* Whether we already warned about downgrading to non-DNSSEC mode for this server */
         bool warned_downgrade:1;
 
@@ -170,6 +175,9 @@ void dns_server_reset_features_all(DnsServer *s);
 
 void dns_server_dump(DnsServer *s, FILE *f);
 
-void dns_server_unref_stream(DnsServer *s);
+void dns_server_add_stream(DnsServer *s, DnsStream *stream);
+void dns_server_remove_stream(DnsServer *s, DnsStream *stream);
+void dns_server_unref_streams(DnsServer *s);
+DnsStream *dns_server_pick_stream(DnsServer *s, bool encrypted);
 
 DnsScope *dns_server_scope(DnsServer *s);
@@ -11,6 +11,7 @@
 #include "resolved-manager.h"
 
 #define DNS_STREAM_TIMEOUT_USEC (10 * USEC_PER_SEC)
+#define DNS_STREAM_IDLE_TLS_TIMEOUT_USEC (60 * USEC_PER_SEC)
 #define DNS_STREAMS_MAX 128
 
 #define DNS_QUERIES_PER_STREAM 32
@@ -281,6 +282,17 @@ static int on_stream_timeout(sd_event_source *es, usec_t usec, void *userdata) {
         return dns_stream_complete(s, ETIMEDOUT);
 }
 
+static usec_t dns_stream_timeout_usec(DnsStream *s) {
+        assert(s);
+
+        /* Keep idle connections to DNS-over-TLS servers open for longer, so that the next lookup doesn't
+         * have to pay for another TCP and TLS handshake. */
+        if (s->type == DNS_STREAM_LOOKUP && s->encrypted && !s->transactions)
+                return DNS_STREAM_IDLE_TLS_TIMEOUT_USEC;
+
+        return DNS_STREAM_TIMEOUT_USEC;
+}
+
 static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         _cleanup_(dns_stream_unrefp) DnsStream *s = dns_stream_ref(userdata); /* Protect stream while we process it */
         bool progressed = false;
@@ -437,7 +449,7 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
 
         /* If we did something, let's restart the timeout event source */
         if (progressed && s->timeout_event_source) {
-                r = sd_event_source_set_time_relative(s->timeout_event_source, DNS_STREAM_TIMEOUT_USEC);
+                r = sd_event_source_set_time_relative(s->timeout_event_source, dns_stream_timeout_usec(s));
                 if (r < 0)
                         log_warning_errno(errno, "Couldn't restart TCP connection timeout, ignoring: %m");
         }
@@ -583,8 +595,5 @@ void dns_stream_detach(DnsStream *s) {
         if (!s->server)
                 return;
 
-        if (s->server->stream != s)
-                return;
-
-        dns_server_unref_stream(s->server);
+        dns_server_remove_stream(s->server, s);
 }
@@ -79,6 +79,7 @@ struct DnsStream {
         DnsStubListenerExtra *stub_listener_extra;
 
         LIST_FIELDS(DnsStream, streams);
+        LIST_FIELDS(DnsStream, streams_by_server);
 };
 
 int dns_stream_new(Manager *m, DnsStream **s, DnsStreamType type, DnsProtocol protocol, int fd, const union sockaddr_union *tfo_address);
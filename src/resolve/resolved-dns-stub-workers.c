@@ -0,0 +1,528 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "io-util.h"
+#include "list.h"
+#include "memory-util.h"
+#include "random-util.h"
+#include "resolve-util.h"
+#include "resolved-dns-stub-workers.h"
+#include "resolved-manager.h"
+#include "siphash24.h"
+#include "socket-util.h"
+
+/* The table is direct-mapped, i.e. a new reply simply replaces whatever was stored in its slot before */
+#define STUB_WORKERS_SLOTS 4096U
+#define STUB_WORKERS_LOCKS 64U
+
+/* How many requests may wait for the main thread, further ones are dropped */
+#define STUB_WORKERS_QUEUE_MAX 4096U
+
+typedef struct StubWorkersSlot {
+        uint8_t *request;       /* The request without its ID */
+        size_t request_size;
+        uint8_t *reply;
+        size_t reply_size;
+        usec_t timestamp;       /* What the TTLs in the reply are relative to */
+        usec_t until;           /* When the first RR in the reply expires */
+        uint64_t generation;    /* DnsCacheLRU.generation when the reply was generated */
+} StubWorkersSlot;
+
+typedef struct StubWorkersDatagram StubWorkersDatagram;
+
+struct StubWorkersDatagram {
+        union sockaddr_union sender;
+        size_t size;
+        LIST_FIELDS(StubWorkersDatagram, queue);
+        uint8_t data[];
+};
+
+typedef struct StubWorker {
+        DnsStubWorkers *workers;
+        int fd;
+        pthread_t thread;
+        bool started;
+
+        /* Requests larger than that are dropped, which is not an issue in practice */
+        uint8_t buffers[MANAGER_DATAGRAM_BATCH_MAX][DNS_PACKET_UNICAST_SIZE_LARGE_MAX];
+} StubWorker;
+
+struct DnsStubWorkers {
+        Manager *manager;
+
+        StubWorker *workers;
+        size_t n_workers;
+
+        int stop_fd;                    /* eventfd, becomes readable when the threads shall exit */
+
+        /* The replies, written by the main thread, read by the workers */
+        uint8_t hash_key[16];
+        StubWorkersSlot slots[STUB_WORKERS_SLOTS];
+        pthread_mutex_t locks[STUB_WORKERS_LOCKS];
+        const uint64_t *generation;     /* Points to Manager.cache_lru.generation */
+
+        /* The requests handed over to the main thread, in reverse order */
+        pthread_mutex_t queue_lock;
+        LIST_HEAD(StubWorkersDatagram, queue);
+        size_t n_queue;
+        int queue_fd;                   /* eventfd, becomes readable when requests were queued */
+        sd_event_source *queue_event_source;
+};
+
+static size_t stub_workers_slot(DnsStubWorkers *w, const uint8_t *request, size_t size) {
+        assert(w);
+        assert(request);
+        assert(size >= DNS_PACKET_HEADER_SIZE);
+
+        /* Skip the ID, which is the first field of the header */
+        return siphash24(request + sizeof(uint16_t), size - sizeof(uint16_t), w->hash_key) % STUB_WORKERS_SLOTS;
+}
+
+static pthread_mutex_t* stub_workers_slot_lock(DnsStubWorkers *w, size_t slot) {
+        assert(w);
+        assert(slot < STUB_WORKERS_SLOTS);
+
+        return w->locks + slot % STUB_WORKERS_LOCKS;
+}
+
+static int stub_workers_lookup(DnsStubWorkers *w, const uint8_t *request, size_t size, usec_t n, DnsPacket **ret) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *reply = NULL;
+        pthread_mutex_t *lock;
+        StubWorkersSlot *slot;
+        usec_t timestamp = 0;
+        size_t i;
+
+        assert(w);
+        assert(request);
+        assert(ret);
+
+        /* Runs in the worker threads. Don't touch anything but the slot, and only with its lock taken. */
+
+        i = stub_workers_slot(w, request, size);
+        slot = w->slots + i;
+        lock = stub_workers_slot_lock(w, i);
+
+        assert_se(pthread_mutex_lock(lock) == 0);
+
+        if (slot->reply &&
+            slot->request_size == size - sizeof(uint16_t) &&
+            memcmp(slot->request, request + sizeof(uint16_t), slot->request_size) == 0 &&
+            n < slot->until &&
+            slot->generation == __atomic_load_n(w->generation, __ATOMIC_ACQUIRE) &&
+            dns_packet_new(&reply, DNS_PROTOCOL_DNS, slot->reply_size, DNS_PACKET_SIZE_MAX) >= 0) {
+
+                memcpy(DNS_PACKET_DATA(reply), slot->reply, slot->reply_size);
+                reply->size = slot->reply_size;
+                timestamp = slot->timestamp;
+        }
+
+        assert_se(pthread_mutex_unlock(lock) == 0);
+
+        if (!reply)
+                return 0;
+
+        /* Copy in the client's ID, and lower all TTLs by the time passed since the reply was generated */
+        memcpy(DNS_PACKET_DATA(reply), request, sizeof(uint16_t));
+
+        if (dns_packet_patch_ttls(reply, timestamp) < 0)
+                return 0;
+
+        *ret = TAKE_PTR(reply);
+        return 1;
+}
+
+static void stub_workers_hand_over(DnsStubWorkers *w, const union sockaddr_union *sender, const uint8_t *data, size_t size) {
+        StubWorkersDatagram *d;
+        bool wake;
+
+        assert(w);
+        assert(sender);
+        assert(data);
+
+        /* Runs in the worker threads */
+
+        d = malloc(offsetof(StubWorkersDatagram, data) + size);
+        if (!d)
+                return;
+
+        *d = (StubWorkersDatagram) {
+                .sender = *sender,
+                .size = size,
+        };
+        memcpy(d->data, data, size);
+
+        assert_se(pthread_mutex_lock(&w->queue_lock) == 0);
+
+        if (w->n_queue >= STUB_WORKERS_QUEUE_MAX) {
+                assert_se(pthread_mutex_unlock(&w->queue_lock) == 0);
+                free(d);
+                return;
+        }
+
+        /* The main thread empties the queue completely whenever it is woken up, hence only wake it up
+         * when the queue was empty before. */
+        wake = !w->queue;
+        LIST_PREPEND(queue, w->queue, d);
+        w->n_queue++;
+
+        assert_se(pthread_mutex_unlock(&w->queue_lock) == 0);
+
+        if (wake)
+                (void) eventfd_write(w->queue_fd, 1);
+}
+
+static void stub_worker_send(StubWorker *worker, struct mmsghdr *mh, size_t n) {
+        size_t sent = 0;
+
+        assert(worker);
+        assert(mh || n == 0);
+
+        while (sent < n) {
+                int k;
+
+                k = sendmmsg(worker->fd, mh + sent, n - sent, MSG_DONTWAIT);
+                if (k < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        /* Like any datagram, replies may get lost, the client will ask again. */
+                        sent++;
+                        continue;
+                }
+
+                sent += k;
+        }
+}
+
+static void stub_worker_process(StubWorker *worker) {
+        union sockaddr_union sa[MANAGER_DATAGRAM_BATCH_MAX], reply_sa[MANAGER_DATAGRAM_BATCH_MAX];
+        struct iovec iov[MANAGER_DATAGRAM_BATCH_MAX], reply_iov[MANAGER_DATAGRAM_BATCH_MAX];
+        struct mmsghdr mh[MANAGER_DATAGRAM_BATCH_MAX], reply_mh[MANAGER_DATAGRAM_BATCH_MAX];
+        DnsPacket *replies[MANAGER_DATAGRAM_BATCH_MAX];
+        DnsStubWorkers *w;
+        size_t n_replies = 0;
+        usec_t n;
+        int k;
+
+        assert(worker);
+        assert(worker->workers);
+
+        w = worker->workers;
+
+        for (size_t i = 0; i < MANAGER_DATAGRAM_BATCH_MAX; i++) {
+                iov[i] = IOVEC_MAKE(worker->buffers[i], sizeof(worker->buffers[i]));
+                mh[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_name = &sa[i].sa,
+                                .msg_namelen = sizeof(sa[i]),
+                                .msg_iov = iov + i,
+                                .msg_iovlen = 1,
+                        },
+                };
+        }
+
+        k = recvmmsg(worker->fd, mh, MANAGER_DATAGRAM_BATCH_MAX, MSG_DONTWAIT, NULL);
+        if (k <= 0)
+                return;
+
+        n = now(clock_boottime_or_monotonic());
+
+        for (int i = 0; i < k; i++) {
+                DnsPacket *reply = NULL;
+
+                if (mh[i].msg_hdr.msg_flags & MSG_TRUNC)
+                        continue;
+                if (mh[i].msg_len < DNS_PACKET_HEADER_SIZE)
+                        continue;
+                if (sa[i].sa.sa_family != AF_INET)
+                        continue;
+
+                if (stub_workers_lookup(w, worker->buffers[i], mh[i].msg_len, n, &reply) <= 0) {
+                        stub_workers_hand_over(w, sa + i, worker->buffers[i], mh[i].msg_len);
+                        continue;
+                }
+
+                /* The socket is bound to 127.0.0.53, hence there is no need to pick the source address
+                 * explicitly, unlike in dns_stub_send(). */
+                reply_sa[n_replies] = sa[i];
+                reply_iov[n_replies] = IOVEC_MAKE(DNS_PACKET_DATA(reply), reply->size);
+                reply_mh[n_replies] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_name = &reply_sa[n_replies].sa,
+                                .msg_namelen = sizeof(reply_sa[n_replies].in),
+                                .msg_iov = reply_iov + n_replies,
+                                .msg_iovlen = 1,
+                        },
+                };
+                replies[n_replies++] = reply;
+        }
+
+        stub_worker_send(worker, reply_mh, n_replies);
+
+        for (size_t i = 0; i < n_replies; i++)
+                dns_packet_unref(replies[i]);
+}
+
+static void* stub_worker_thread(void *userdata) {
+        StubWorker *worker = userdata;
+
+        assert(worker);
+
+        /* Runs until the stop eventfd becomes readable. Note that nothing must be logged from here. */
+
+        for (;;) {
+                struct pollfd pollfd[] = {
+                        { .fd = worker->fd,                 .events = POLLIN },
+                        { .fd = worker->workers->stop_fd,   .events = POLLIN },
+                };
+
+                if (poll(pollfd, ELEMENTSOF(pollfd), -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        break;
+                }
+
+                if (pollfd[1].revents != 0)
+                        break;
+
+                if (pollfd[0].revents != 0)
+                        stub_worker_process(worker);
+        }
+
+        return NULL;
+}
+
+static int stub_workers_datagram_to_packet(StubWorkersDatagram *d, DnsPacket **ret) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        int r;
+
+        assert(d);
+        assert(ret);
+
+        r = dns_packet_new(&p, DNS_PROTOCOL_DNS, d->size, DNS_PACKET_SIZE_MAX);
+        if (r < 0)
+                return r;
+
+        memcpy(DNS_PACKET_DATA(p), d->data, d->size);
+        p->size = d->size;
+
+        /* Fill in what manager_recv() would have found out if this had been received on the main stub socket */
+        p->family = AF_INET;
+        p->ipproto = IPPROTO_UDP;
+        p->sender.in = d->sender.in.sin_addr;
+        p->sender_port = be16toh(d->sender.in.sin_port);
+        p->destination.in.s_addr = htobe32(INADDR_DNS_STUB);
+        p->timestamp = now(clock_boottime_or_monotonic());
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+static int on_stub_workers_queue(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        DnsStubWorkers *w = userdata;
+        StubWorkersDatagram *queue, *d, *prev;
+        DnsPacket *packets[MANAGER_DATAGRAM_BATCH_MAX];
+        size_t n = 0;
+        eventfd_t v;
+        int stub_fd, r;
+
+        assert(w);
+
+        (void) eventfd_read(fd, &v);
+
+        assert_se(pthread_mutex_lock(&w->queue_lock) == 0);
+        queue = TAKE_PTR(w->queue);
+        w->n_queue = 0;
+        assert_se(pthread_mutex_unlock(&w->queue_lock) == 0);
+
+        stub_fd = sd_event_source_get_io_fd(w->manager->dns_stub_udp_event_source);
+
+        /* The queue is in reverse order, start with its tail, i.e. the oldest request */
+        LIST_FIND_TAIL(queue, queue, d);
+        for (; d; d = prev) {
+                prev = d->queue_prev;
+
+                r = stub_workers_datagram_to_packet(d, packets + n);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to process request handed over by stub worker, ignoring: %m");
+                else
+                        n++;
+
+                free(d);
+
+                if (n >= ELEMENTSOF(packets)) {
+                        dns_stub_process_datagrams(w->manager, NULL, stub_fd, packets, n);
+                        n = 0;
+                }
+        }
+
+        dns_stub_process_datagrams(w->manager, NULL, stub_fd, packets, n);
+        return 0;
+}
+
+void dns_stub_workers_publish(
+                DnsStubWorkers *w,
+                DnsPacket *request,
+                DnsPacket *reply,
+                usec_t timestamp,
+                usec_t until,
+                uint64_t generation) {
+
+        _cleanup_free_ uint8_t *req = NULL, *rep = NULL;
+        pthread_mutex_t *lock;
+        StubWorkersSlot *slot;
+        size_t i;
+
+        assert(request);
+        assert(reply);
+
+        if (!w)
+                return;
+
+        assert(request->size >= DNS_PACKET_HEADER_SIZE);
+
+        req = memdup(DNS_PACKET_DATA(request) + sizeof(uint16_t), request->size - sizeof(uint16_t));
+        rep = memdup(DNS_PACKET_DATA(reply), reply->size);
+        if (!req || !rep)
+                return (void) log_oom_debug();
+
+        i = stub_workers_slot(w, DNS_PACKET_DATA(request), request->size);
+        slot = w->slots + i;
+        lock = stub_workers_slot_lock(w, i);
+
+        assert_se(pthread_mutex_lock(lock) == 0);
+
+        free(slot->request);
+        free(slot->reply);
+
+        *slot = (StubWorkersSlot) {
+                .request = TAKE_PTR(req),
+                .request_size = request->size - sizeof(uint16_t),
+                .reply = TAKE_PTR(rep),
+                .reply_size = reply->size,
+                .timestamp = timestamp,
+                .until = until,
+                .generation = generation,
+        };
+
+        assert_se(pthread_mutex_unlock(lock) == 0);
+}
+
+DnsStubWorkers* dns_stub_workers_free(DnsStubWorkers *w) {
+        StubWorkersDatagram *d, *next;
+
+        if (!w)
+                return NULL;
+
+        if (w->stop_fd >= 0)
+                (void) eventfd_write(w->stop_fd, 1);
+
+        for (size_t i = 0; i < w->n_workers; i++) {
+                if (w->workers[i].started)
+                        assert_se(pthread_join(w->workers[i].thread, NULL) == 0);
+
+                safe_close(w->workers[i].fd);
+        }
+        free(w->workers);
+
+        w->queue_event_source = sd_event_source_disable_unref(w->queue_event_source);
+        safe_close(w->queue_fd);
+        safe_close(w->stop_fd);
+
+        LIST_FOREACH_SAFE(queue, d, next, w->queue)
+                free(d);
+
+        for (size_t i = 0; i < STUB_WORKERS_SLOTS; i++) {
+                free(w->slots[i].request);
+                free(w->slots[i].reply);
+        }
+
+        for (size_t i = 0; i < STUB_WORKERS_LOCKS; i++)
+                assert_se(pthread_mutex_destroy(w->locks + i) == 0);
+        assert_se(pthread_mutex_destroy(&w->queue_lock) == 0);
+
+        return mfree(w);
+}
+
+int dns_stub_workers_new(Manager *m, unsigned n, DnsStubWorkers **ret) {
+        _cleanup_(dns_stub_workers_freep) DnsStubWorkers *w = NULL;
+        sigset_t ss, saved_ss;
+        int r;
+
+        assert(m);
+        assert(n > 0);
+        assert(ret);
+
+        w = new0(DnsStubWorkers, 1);
+        if (!w)
+                return -ENOMEM;
+
+        w->manager = m;
+        w->generation = &m->cache_lru.generation;
+        w->stop_fd = w->queue_fd = -1;
+
+        for (size_t i = 0; i < STUB_WORKERS_LOCKS; i++)
+                assert_se(pthread_mutex_init(w->locks + i, NULL) == 0);
+        assert_se(pthread_mutex_init(&w->queue_lock, NULL) == 0);
+
+        random_bytes(w->hash_key, sizeof(w->hash_key));
+
+        w->stop_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (w->stop_fd < 0)
+                return -errno;
+
+        w->queue_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (w->queue_fd < 0)
+                return -errno;
+
+        r = sd_event_add_io(m->event, &w->queue_event_source, w->queue_fd, EPOLLIN, on_stub_workers_queue, w);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(w->queue_event_source, "dns-stub-workers-queue");
+
+        w->workers = new0(StubWorker, n);
+        if (!w->workers)
+                return -ENOMEM;
+
+        for (; w->n_workers < n; w->n_workers++) {
+                StubWorker *worker = w->workers + w->n_workers;
+
+                worker->workers = w;
+                worker->fd = manager_dns_stub_make_socket(m, SOCK_DGRAM);
+                if (worker->fd < 0)
+                        return worker->fd;
+        }
+
+        /* Block all signals while starting the threads, so that they are started with all signals blocked,
+         * and don't affect signal handling of the main thread. */
+        assert_se(sigfillset(&ss) >= 0);
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        for (size_t i = 0; i < w->n_workers; i++) {
+                r = pthread_create(&w->workers[i].thread, NULL, stub_worker_thread, w->workers + i);
+                if (r > 0)
+                        break;
+
+                w->workers[i].started = true;
+        }
+
+        assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+
+        if (r > 0)
+                return -r;
+
+        log_debug("Started %zu DNS stub workers.", w->n_workers);
+
+        *ret = TAKE_PTR(w);
+        return 0;
+}
@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "resolved-dns-packet.h"
+#include "time-util.h"
+
+/* The stub workers are threads that answer UDP requests to the main stub listener from a table of replies
+ * in wire format, each on a socket of its own bound to 127.0.0.53:53 with SO_REUSEPORT. The table is filled
+ * by the main thread, with the replies that end up in the stub reply cache. Everything else, i.e. all
+ * requests that cannot be answered from the table, is handed over to the main thread, and processed there
+ * as if it had been received on the main stub socket. */
+
+#define DNS_STUB_WORKERS_MAX 64U
+
+typedef struct DnsStubWorkers DnsStubWorkers;
+
+typedef struct Manager Manager;
+
+int dns_stub_workers_new(Manager *m, unsigned n, DnsStubWorkers **ret);
+DnsStubWorkers* dns_stub_workers_free(DnsStubWorkers *w);
+DEFINE_TRIVIAL_CLEANUP_FUNC(DnsStubWorkers*, dns_stub_workers_free);
+
+void dns_stub_workers_publish(
+                DnsStubWorkers *w,
+                DnsPacket *request,
+                DnsPacket *reply,
+                usec_t timestamp,
+                usec_t until,
+                uint64_t generation);
@@ -20,6 +20,18 @@
 /* On the extra stubs, use a more conservative choice */
 #define ADVERTISE_EXTRA_DATAGRAM_SIZE_MAX DNS_PACKET_UNICAST_SIZE_LARGE_MAX
 
+/* How many replies to keep in wire format per stub listener, see dns_stub_reply_cache_add() */
+#define STUB_REPLY_CACHE_MAX 1024U
+
+typedef struct DnsStubCachedReply {
+        DnsPacket *request;     /* The request this is the reply to, the ID is ignored */
+        bool stream;            /* Whether the request was received via TCP */
+        DnsPacket *reply;
+        usec_t timestamp;       /* When the reply was generated, i.e. what its TTLs are relative to */
+        usec_t until;           /* When the first RR in the reply expires */
+        uint64_t generation;    /* DnsCacheLRU.generation when the reply was generated */
+} DnsStubCachedReply;
+
 static int manager_dns_stub_fd_extra(Manager *m, DnsStubListenerExtra *l, int type);
 
 static void dns_stub_listener_extra_hash_func(const DnsStubListenerExtra *a, struct siphash *state) {
@@ -85,6 +97,7 @@ DnsStubListenerExtra *dns_stub_listener_extra_free(DnsStubListenerExtra *p) {
         p->tcp_event_source = sd_event_source_disable_unref(p->tcp_event_source);
 
         hashmap_free(p->queries_by_packet);
+        set_free(p->reply_cache);
 
         return mfree(p);
 }
@@ -130,6 +143,51 @@ static int stub_packet_compare_func(const DnsPacket *x, const DnsPacket *y) {
 
 DEFINE_HASH_OPS(stub_packet_hash_ops, DnsPacket, stub_packet_hash_func, stub_packet_compare_func);
 
+static DnsStubCachedReply* dns_stub_cached_reply_free(DnsStubCachedReply *c) {
+        if (!c)
+                return NULL;
+
+        dns_packet_unref(c->request);
+        dns_packet_unref(c->reply);
+        return mfree(c);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(DnsStubCachedReply*, dns_stub_cached_reply_free);
+
+static void dns_stub_cached_reply_hash_func(const DnsStubCachedReply *c, struct siphash *state) {
+        assert(c);
+        assert(c->request->size >= sizeof(DnsPacketHeader));
+
+        siphash24_compress_boolean(c->stream, state);
+        siphash24_compress(&c->request->size, sizeof(c->request->size), state);
+
+        /* Skip the ID, which is the first field of the header */
+        siphash24_compress(DNS_PACKET_DATA(c->request) + sizeof(uint16_t), c->request->size - sizeof(uint16_t), state);
+}
+
+static int dns_stub_cached_reply_compare_func(const DnsStubCachedReply *x, const DnsStubCachedReply *y) {
+        int r;
+
+        r = CMP(x->stream, y->stream);
+        if (r != 0)
+                return r;
+
+        r = CMP(x->request->size, y->request->size);
+        if (r != 0)
+                return r;
+
+        return memcmp(DNS_PACKET_DATA(x->request) + sizeof(uint16_t),
+                      DNS_PACKET_DATA(y->request) + sizeof(uint16_t),
+                      x->request->size - sizeof(uint16_t));
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(
+                dns_stub_cached_reply_hash_ops,
+                DnsStubCachedReply,
+                dns_stub_cached_reply_hash_func,
+                dns_stub_cached_reply_compare_func,
+                dns_stub_cached_reply_free);
+
 static int reply_add_with_rrsig(
                 DnsAnswer **reply,
                 DnsResourceRecord *rr,
@@ -498,15 +556,31 @@ static int dns_stub_send(
 
         if (s)
                 r = dns_stream_write_packet(s, reply);
-        else
+        else {
+                int fd, ifindex;
+
+                fd = manager_dns_stub_fd_extra(m, l, SOCK_DGRAM);
+                ifindex = l ? p->ifindex : LOOPBACK_IFINDEX; /* force loopback iface if this is the main listener stub */
+
+                /* Replies to queries of the batch currently being processed are sent together once the
+                 * batch is done, see on_dns_stub_packet_internal(). */
+                if (fd >= 0 && fd == m->stub_send_fd && m->n_stub_send_queue < MANAGER_DATAGRAM_BATCH_MAX) {
+                        m->stub_send_queue[m->n_stub_send_queue++] = (ManagerDatagram) {
+                                .ifindex = ifindex,
+                                .family = p->family,
+                                .destination = p->sender,
+                                .port = p->sender_port,
+                                .source = p->destination,
+                                .packet = dns_packet_ref(reply),
+                        };
+                        return 0;
+                }
+
                 /* Note that it is essential here that we explicitly choose the source IP address for this packet. This
                  * is because otherwise the kernel will choose it automatically based on the routing table and will
                  * thus pick 127.0.0.1 rather than 127.0.0.53. */
-                r = manager_send(m,
-                                 manager_dns_stub_fd_extra(m, l, SOCK_DGRAM),
-                                 l ? p->ifindex : LOOPBACK_IFINDEX, /* force loopback iface if this is the main listener stub */
-                                 p->family, &p->sender, p->sender_port, &p->destination,
-                                 reply);
+                r = manager_send(m, fd, ifindex, p->family, &p->sender, p->sender_port, &p->destination, reply);
+        }
         if (r < 0)
                 return log_debug_errno(r, "Failed to send reply packet: %m");
 
@@ -544,6 +618,136 @@ static void dns_stub_suppress_duplicate_section_rrs(DnsQuery *q) {
         dns_answer_remove_by_answer_keys(&q->reply_additional, q->reply_authoritative);
 }
 
+static bool dns_stub_cached_reply_is_valid(Manager *m, DnsStubCachedReply *c, usec_t n) {
+        assert(m);
+        assert(c);
+
+        /* Replies are dropped as soon as any RR in them expires, or when any cache is flushed, e.g. because
+         * the DNS servers changed. */
+        return n < c->until && c->generation == m->cache_lru.generation;
+}
+
+static void dns_stub_reply_cache_add(DnsQuery *q, int rcode, DnsPacket *reply) {
+        _cleanup_(dns_stub_cached_reply_freep) DnsStubCachedReply *c = NULL;
+        Manager *m;
+        Set **cache;
+        uint32_t ttl;
+        usec_t n;
+        int r;
+
+        assert(q);
+        assert(q->manager);
+        assert(reply);
+
+        m = q->manager;
+
+        /* Keep the reply in wire format, so that identical requests can be answered without building the
+         * reply again, see dns_stub_reply_from_cache(). We only do this for replies made up of cached data
+         * exclusively. That way, all cache settings apply as they are, and nothing is kept that is not
+         * cached anyway. Synthesized replies and local zones are always looked up again. */
+
+        if (m->enable_cache == DNS_CACHE_MODE_NO)
+                return;
+        if (!IN_SET(rcode, DNS_RCODE_SUCCESS, DNS_RCODE_NXDOMAIN))
+                return;
+        if (DNS_PACKET_TC(reply))
+                return;
+        if ((q->answer_query_flags & (SD_RESOLVED_FROM_MASK|SD_RESOLVED_SYNTHETIC)) != SD_RESOLVED_FROM_CACHE)
+                return;
+
+        ttl = MIN3(dns_answer_min_ttl(q->reply_answer),
+                   dns_answer_min_ttl(q->reply_authoritative),
+                   dns_answer_min_ttl(q->reply_additional));
+        if (ttl == 0 || ttl == UINT32_MAX)
+                return;
+
+        cache = q->stub_listener_extra ? &q->stub_listener_extra->reply_cache : &m->stub_reply_cache;
+        n = now(clock_boottime_or_monotonic());
+
+        if (set_size(*cache) >= STUB_REPLY_CACHE_MAX) {
+                DnsStubCachedReply *i;
+
+                SET_FOREACH(i, *cache)
+                        if (!dns_stub_cached_reply_is_valid(m, i, n))
+                                dns_stub_cached_reply_free(set_remove(*cache, i));
+
+                if (set_size(*cache) >= STUB_REPLY_CACHE_MAX)
+                        dns_stub_cached_reply_free(set_steal_first(*cache));
+        }
+
+        c = new(DnsStubCachedReply, 1);
+        if (!c)
+                return (void) log_oom_debug();
+
+        *c = (DnsStubCachedReply) {
+                .request = dns_packet_ref(q->request_packet),
+                .stream = !!q->request_stream,
+                .reply = dns_packet_ref(reply),
+                .timestamp = n,
+                .until = usec_add(n, ttl * USEC_PER_SEC),
+                .generation = m->cache_lru.generation,
+        };
+
+        /* An older reply for the same request may still be around, if it was not looked at since it
+         * became invalid. */
+        dns_stub_cached_reply_free(set_remove(*cache, c));
+
+        r = set_ensure_put(cache, &dns_stub_cached_reply_hash_ops, c);
+        if (r < 0)
+                return (void) log_debug_errno(r, "Failed to add reply to stub reply cache, ignoring: %m");
+
+        /* The stub workers only answer UDP requests to the main stub listener, and know nothing about the
+         * DO+CD bypass, see dns_stub_process_query(). */
+        if (!q->stub_listener_extra && !q->request_stream &&
+            !(DNS_PACKET_DO(q->request_packet) && DNS_PACKET_CD(q->request_packet)))
+                dns_stub_workers_publish(m->stub_workers, c->request, c->reply, c->timestamp, c->until, c->generation);
+
+        TAKE_PTR(c);
+}
+
+static int dns_stub_reply_from_cache(Manager *m, DnsStubListenerExtra *l, DnsStream *s, DnsPacket *p) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *reply = NULL;
+        DnsStubCachedReply *c;
+        Set **cache;
+        int r;
+
+        assert(m);
+        assert(p);
+
+        if (m->enable_cache == DNS_CACHE_MODE_NO)
+                return 0;
+
+        cache = l ? &l->reply_cache : &m->stub_reply_cache;
+
+        c = set_get(*cache, &(DnsStubCachedReply) {
+                        .request = p,
+                        .stream = !!s,
+                });
+        if (!c)
+                return 0;
+
+        if (!dns_stub_cached_reply_is_valid(m, c, now(clock_boottime_or_monotonic()))) {
+                dns_stub_cached_reply_free(set_remove(*cache, c));
+                return 0;
+        }
+
+        r = dns_packet_dup(&reply, c->reply);
+        if (r < 0)
+                return r;
+
+        DNS_PACKET_HEADER(reply)->id = DNS_PACKET_HEADER(p)->id;
+
+        /* Lower all TTLs by the time passed since we generated the reply. */
+        r = dns_packet_patch_ttls(reply, c->timestamp);
+        if (r < 0)
+                return r;
+
+        log_debug("Answering request from stub reply cache.");
+
+        (void) dns_stub_send(m, l, s, p, reply);
+        return 1;
+}
+
 static int dns_stub_send_reply(
                 DnsQuery *q,
                 int rcode) {
@@ -592,6 +796,8 @@ static int dns_stub_send_reply(
         if (r < 0)
                 return log_debug_errno(r, "Failed to build failure packet: %m");
 
+        dns_stub_reply_cache_add(q, rcode, reply);
+
         return dns_stub_send(q->manager, q->stub_listener_extra, q->request_stream, q->request_packet, reply);
 }
 
@@ -901,6 +1107,14 @@ static void dns_stub_process_query(Manager *m, DnsStubListenerExtra *l, DnsStrea
                 return;
         }
 
+        if (!(DNS_PACKET_DO(p) && DNS_PACKET_CD(p))) {
+                r = dns_stub_reply_from_cache(m, l, s, p);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to answer request from stub reply cache, ignoring: %m");
+                if (r > 0)
+                        return;
+        }
+
         r = hashmap_ensure_allocated(queries_by_packet, &stub_packet_hash_ops);
         if (r < 0) {
                 log_oom();
@@ -962,21 +1176,60 @@ static void dns_stub_process_query(Manager *m, DnsStubListenerExtra *l, DnsStrea
         TAKE_PTR(q);
 }
 
-static int on_dns_stub_packet_internal(sd_event_source *s, int fd, uint32_t revents, Manager *m, DnsStubListenerExtra *l) {
-        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+static void dns_stub_flush_send_queue(Manager *m) {
         int r;
 
-        r = manager_recv(m, fd, DNS_PROTOCOL_DNS, &p);
-        if (r <= 0)
-                return r;
+        assert(m);
 
-        if (dns_packet_validate_query(p) > 0) {
-                log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+        if (m->n_stub_send_queue > 0) {
+                r = manager_send_many(m, m->stub_send_fd, m->stub_send_queue, m->n_stub_send_queue);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to send reply packets: %m");
+        }
 
-                dns_stub_process_query(m, l, NULL, p);
-        } else
-                log_debug("Invalid DNS stub UDP packet, ignoring.");
+        for (size_t i = 0; i < m->n_stub_send_queue; i++)
+                dns_packet_unref(m->stub_send_queue[i].packet);
 
+        m->n_stub_send_queue = 0;
+        m->stub_send_fd = -1;
+}
+
+void dns_stub_process_datagrams(Manager *m, DnsStubListenerExtra *l, int fd, DnsPacket **packets, size_t n) {
+        assert(m);
+        assert(fd >= 0);
+        assert(packets || n == 0);
+        assert(n <= MANAGER_DATAGRAM_BATCH_MAX);
+
+        /* Takes possession of the packets */
+
+        m->stub_send_fd = fd;
+
+        for (size_t i = 0; i < n; i++) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = packets[i];
+
+                if (dns_packet_validate_query(p) > 0) {
+                        log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+
+                        dns_stub_process_query(m, l, NULL, p);
+                } else
+                        log_debug("Invalid DNS stub UDP packet, ignoring.");
+        }
+
+        dns_stub_flush_send_queue(m);
+}
+
+static int on_dns_stub_packet_internal(sd_event_source *s, int fd, uint32_t revents, Manager *m, DnsStubListenerExtra *l) {
+        DnsPacket *packets[MANAGER_DATAGRAM_BATCH_MAX];
+        int n;
+
+        /* Receive a batch of queries at once, and send all replies that can be answered right away (i.e.
+         * from the cache, or locally synthesized ones) together when we are done with the batch. This
+         * saves a lot of system calls when a client sends many queries at once. */
+        n = manager_recv_many(m, fd, DNS_PROTOCOL_DNS, packets, ELEMENTSOF(packets));
+        if (n <= 0)
+                return n;
+
+        dns_stub_process_datagrams(m, l, fd, packets, n);
         return 0;
 }
 
@@ -1085,7 +1338,7 @@ static int set_dns_stub_common_tcp_socket_options(int fd) {
         return 0;
 }
 
-static int manager_dns_stub_fd(Manager *m, int type) {
+int manager_dns_stub_make_socket(Manager *m, int type) {
         union sockaddr_union sa = {
                 .in.sin_family = AF_INET,
                 .in.sin_addr.s_addr = htobe32(INADDR_DNS_STUB),
@@ -1094,12 +1347,9 @@ static int manager_dns_stub_fd(Manager *m, int type) {
         _cleanup_close_ int fd = -1;
         int r;
 
+        assert(m);
         assert(IN_SET(type, SOCK_DGRAM, SOCK_STREAM));
 
-        sd_event_source **event_source = type == SOCK_DGRAM ? &m->dns_stub_udp_event_source : &m->dns_stub_tcp_event_source;
-        if (*event_source)
-                return sd_event_source_get_io_fd(*event_source);
-
         fd = socket(AF_INET, type | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
         if (fd < 0)
                 return -errno;
@@ -1123,6 +1373,13 @@ static int manager_dns_stub_fd(Manager *m, int type) {
         if (r < 0)
                 return r;
 
+        /* The stub workers each listen on a socket of their own, see resolved-dns-stub-workers.c */
+        if (type == SOCK_DGRAM && m->n_stub_workers > 0) {
+                r = setsockopt_int(fd, SOL_SOCKET, SO_REUSEPORT, true);
+                if (r < 0)
+                        return r;
+        }
+
         if (bind(fd, &sa.sa, sizeof(sa.in)) < 0)
                 return -errno;
 
@@ -1130,6 +1387,23 @@ static int manager_dns_stub_fd(Manager *m, int type) {
             listen(fd, SOMAXCONN) < 0)
                 return -errno;
 
+        return TAKE_FD(fd);
+}
+
+static int manager_dns_stub_fd(Manager *m, int type) {
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(IN_SET(type, SOCK_DGRAM, SOCK_STREAM));
+
+        sd_event_source **event_source = type == SOCK_DGRAM ? &m->dns_stub_udp_event_source : &m->dns_stub_tcp_event_source;
+        if (*event_source)
+                return sd_event_source_get_io_fd(*event_source);
+
+        fd = manager_dns_stub_make_socket(m, type);
+        if (fd < 0)
+                return fd;
+
         r = sd_event_add_io(m->event, event_source, fd, EPOLLIN,
                             type == SOCK_DGRAM ? on_dns_stub_packet : on_dns_stub_stream,
                             m);
@@ -1285,6 +1559,12 @@ int manager_dns_stub_start(Manager *m) {
         } else if (r < 0)
                 return log_error_errno(r, "Failed to listen on %s socket 127.0.0.53:53: %m", t);
 
+        if (m->n_stub_workers > 0 && m->dns_stub_udp_event_source) {
+                r = dns_stub_workers_new(m, MIN(m->n_stub_workers, DNS_STUB_WORKERS_MAX), &m->stub_workers);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to start DNS stub workers, ignoring: %m");
+        }
+
         if (!ordered_set_isempty(m->dns_extra_stub_listeners)) {
                 DnsStubListenerExtra *l;
 
@@ -1304,8 +1584,12 @@ int manager_dns_stub_start(Manager *m) {
 void manager_dns_stub_stop(Manager *m) {
         assert(m);
 
+        m->stub_workers = dns_stub_workers_free(m->stub_workers);
+
         m->dns_stub_udp_event_source = sd_event_source_disable_unref(m->dns_stub_udp_event_source);
         m->dns_stub_tcp_event_source = sd_event_source_disable_unref(m->dns_stub_tcp_event_source);
+
+        m->stub_reply_cache = set_free(m->stub_reply_cache);
 }
 
 static const char* const dns_stub_listener_mode_table[_DNS_STUB_LISTENER_MODE_MAX] = {
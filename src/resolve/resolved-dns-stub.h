@@ -29,6 +29,7 @@ struct DnsStubListenerExtra {
         sd_event_source *tcp_event_source;
 
         Hashmap *queries_by_packet;
+        Set *reply_cache;
 };
 
 extern const struct hash_ops dns_stub_listener_extra_hash_ops;
@@ -44,5 +45,8 @@ static inline uint16_t dns_stub_listener_extra_port(DnsStubListenerExtra *p) {
 void manager_dns_stub_stop(Manager *m);
 int manager_dns_stub_start(Manager *m);
 
+int manager_dns_stub_make_socket(Manager *m, int type);
+void dns_stub_process_datagrams(Manager *m, DnsStubListenerExtra *l, int fd, DnsPacket **packets, size_t n);
+
 const char* dns_stub_listener_mode_to_string(DnsStubListenerMode p) _const_;
 DnsStubListenerMode dns_stub_listener_mode_from_string(const char *s) _pure_;
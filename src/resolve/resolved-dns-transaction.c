@@ -13,6 +13,7 @@
 #include "resolved-dns-transaction.h"
 #include "resolved-dnstls.h"
 #include "resolved-llmnr.h"
+#include "resolved-varlink.h"
 #include "string-table.h"
 
 #define TRANSACTIONS_MAX 4096
@@ -170,6 +171,10 @@ DnsTransaction* dns_transaction_gc(DnsTransaction *t) {
         if (t->block_gc > 0)
                 return t;
 
+        /* Nobody references transactions refreshing the cache, keep them around until they are done */
+        if (t->refresh_ahead && DNS_TRANSACTION_IS_LIVE(t->state))
+                return t;
+
         if (set_isempty(t->notify_query_candidates) &&
             set_isempty(t->notify_query_candidates_done) &&
             set_isempty(t->notify_zone_items) &&
@@ -276,6 +281,7 @@ int dns_transaction_new(
                 .answer_source = _DNS_TRANSACTION_SOURCE_INVALID,
                 .answer_dnssec_result = _DNSSEC_RESULT_INVALID,
                 .answer_nsec_ttl = UINT32_MAX,
+                .latency_usec = USEC_INFINITY,
                 .key = dns_resource_key_ref(key),
                 .query_flags = query_flags,
                 .bypass = dns_packet_ref(bypass),
@@ -379,6 +385,70 @@ static void dns_transaction_tentative(DnsTransaction *t, DnsPacket *p) {
         dns_transaction_gc(t);
 }
 
+static bool dns_transaction_serve_stale(DnsTransaction *t, DnsTransactionState *state) {
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        _cleanup_(dns_packet_unrefp) DnsPacket *received = NULL;
+        DnssecResult dnssec_result;
+        uint64_t query_flags;
+        int r, rcode;
+
+        assert(t);
+        assert(state);
+
+        /* If the servers could not be reached, or failed to answer, answer from stale cache entries instead,
+         * as described in RFC 8767. Note that the cache only keeps stale entries at all if
+         * StaleRetentionSec= is set. */
+
+        if (t->scope->protocol != DNS_PROTOCOL_DNS ||
+            t->scope->cache.stale_retention_usec == 0 ||
+            t->bypass ||
+            FLAGS_SET(t->query_flags, SD_RESOLVED_NO_CACHE))
+                return false;
+
+        if (!IN_SET(*state,
+                    DNS_TRANSACTION_NO_SERVERS,
+                    DNS_TRANSACTION_TIMEOUT,
+                    DNS_TRANSACTION_ATTEMPTS_MAX_REACHED,
+                    DNS_TRANSACTION_INVALID_REPLY,
+                    DNS_TRANSACTION_ERRNO,
+                    DNS_TRANSACTION_NETWORK_DOWN,
+                    DNS_TRANSACTION_RCODE_FAILURE))
+                return false;
+
+        if (*state == DNS_TRANSACTION_RCODE_FAILURE && !IN_SET(t->answer_rcode, DNS_RCODE_SERVFAIL, DNS_RCODE_REFUSED))
+                return false;
+
+        r = dns_cache_lookup(
+                        &t->scope->cache,
+                        dns_transaction_key(t),
+                        t->query_flags,
+                        /* serve_stale= */ true,
+                        &rcode,
+                        &answer,
+                        &received,
+                        &query_flags,
+                        &dnssec_result,
+                        NULL);
+        if (r < 0)
+                log_debug_errno(r, "Failed to look up stale cache entry for transaction %" PRIu16 ", ignoring: %m", t->id);
+        if (r <= 0)
+                return false;
+
+        dns_transaction_reset_answer(t);
+        t->answer_rcode = rcode;
+        t->answer = TAKE_PTR(answer);
+        t->received = TAKE_PTR(received);
+        t->answer_query_flags = query_flags;
+        t->answer_dnssec_result = dnssec_result;
+
+        log_debug("Answering transaction %" PRIu16 " from stale cache entry, as the servers failed with <%s>.",
+                  t->id, dns_transaction_state_to_string(*state));
+
+        t->answer_source = DNS_TRANSACTION_CACHE;
+        *state = t->answer_rcode == DNS_RCODE_SUCCESS ? DNS_TRANSACTION_SUCCESS : DNS_TRANSACTION_RCODE_FAILURE;
+        return true;
+}
+
 void dns_transaction_complete(DnsTransaction *t, DnsTransactionState state) {
         DnsQueryCandidate *c;
         DnsZoneItem *z;
@@ -389,6 +459,8 @@ void dns_transaction_complete(DnsTransaction *t, DnsTransactionState state) {
         assert(t);
         assert(!DNS_TRANSACTION_IS_LIVE(state));
 
+        (void) dns_transaction_serve_stale(t, &state);
+
         if (state == DNS_TRANSACTION_DNSSEC_FAILED) {
                 dns_resource_key_to_string(dns_transaction_key(t), key_str, sizeof key_str);
 
@@ -426,6 +498,8 @@ void dns_transaction_complete(DnsTransaction *t, DnsTransactionState state) {
 
         t->state = state;
 
+        manager_varlink_notify_transaction(t->scope->manager, t);
+
         dns_transaction_close_connection(t, true);
         dns_transaction_stop_timeout(t);
 
@@ -703,8 +777,9 @@ static int dns_transaction_emit_tcp(DnsTransaction *t) {
                                 return r;
                 }
 
-                if (t->server->stream && (DNS_SERVER_FEATURE_LEVEL_IS_TLS(t->current_feature_level) == t->server->stream->encrypted))
-                        s = dns_stream_ref(t->server->stream);
+                s = dns_server_pick_stream(t->server, DNS_SERVER_FEATURE_LEVEL_IS_TLS(t->current_feature_level));
+                if (s)
+                        dns_stream_ref(s);
                 else
                         fd = dns_scope_socket_tcp(t->scope, AF_UNSPEC, NULL, t->server, dns_transaction_port(t), &sa);
 
@@ -762,11 +837,8 @@ static int dns_transaction_emit_tcp(DnsTransaction *t) {
                 }
 #endif
 
-                if (t->server) {
-                        dns_server_unref_stream(t->server);
-                        s->server = dns_server_ref(t->server);
-                        t->server->stream = dns_stream_ref(s);
-                }
+                if (t->server)
+                        dns_server_add_stream(t->server, s);
 
                 s->complete = on_stream_complete;
                 s->on_packet = on_stream_packet;
@@ -1030,6 +1102,33 @@ static int dns_transaction_fix_rcode(DnsTransaction *t) {
         return 0;
 }
 
+static void dns_transaction_record_latency(DnsTransaction *t, DnsPacket *p, bool encrypted) {
+        DnsTransport transport;
+        usec_t ts;
+
+        assert(t);
+        assert(p);
+        assert(t->server);
+
+        if (timestamp_is_set(p->timestamp))
+                ts = p->timestamp;
+        else
+                assert_se(sd_event_now(t->scope->manager->event, clock_boottime_or_monotonic(), &ts) >= 0);
+
+        if (ts < t->start_usec)
+                return;
+
+        if (p->ipproto == IPPROTO_UDP)
+                transport = DNS_TRANSPORT_UDP;
+        else
+                transport = encrypted ? DNS_TRANSPORT_TLS : DNS_TRANSPORT_TCP;
+
+        t->latency_usec = ts - t->start_usec;
+
+        latency_histogram_add(&t->server->rtt, t->latency_usec);
+        latency_histogram_add(t->scope->manager->transport_latency + transport, t->latency_usec);
+}
+
 void dns_transaction_process_reply(DnsTransaction *t, DnsPacket *p, bool encrypted) {
         bool retry_with_tcp = false;
         int r;
@@ -1323,6 +1422,8 @@ void dns_transaction_process_reply(DnsTransaction *t, DnsPacket *p, bool encrypt
                  * size/fragment size we got. Which is useful for announcing the EDNS(0) packet size we can
                  * receive to our server. */
                 dns_server_packet_received(t->server, p->ipproto, t->current_feature_level, dns_packet_size_unfragmented(p));
+
+                dns_transaction_record_latency(t, p, encrypted);
         }
 
         /* See if we know things we didn't know before that indicate we better restart the lookup immediately. */
@@ -1595,6 +1696,42 @@ static void dns_transaction_randomize_answer(DnsTransaction *t) {
         dns_answer_randomize(t->answer);
 }
 
+static void dns_transaction_refresh_ahead(DnsTransaction *t) {
+        DnsTransaction *refresh;
+        uint64_t query_flags;
+        int r;
+
+        assert(t);
+
+        /* The cache entry that answered this transaction is popular and about to expire. Ask the network
+         * in the background, so that it is replaced before it expires, and nobody has to wait for it. */
+
+        if (!t->scope->manager->cache_refresh_ahead ||
+            !IN_SET(t->scope->protocol, DNS_PROTOCOL_DNS, DNS_PROTOCOL_LLMNR))
+                return;
+
+        query_flags = t->query_flags | SD_RESOLVED_NO_CACHE;
+
+        /* Maybe somebody is asking the network already? */
+        if (dns_scope_find_transaction(t->scope, dns_transaction_key(t), query_flags))
+                return;
+
+        r = dns_transaction_new(&refresh, t->scope, dns_transaction_key(t), NULL, query_flags);
+        if (r < 0)
+                return (void) log_debug_errno(r, "Failed to create transaction to refresh cache entry, ignoring: %m");
+
+        refresh->refresh_ahead = true;
+
+        log_debug("Refreshing cache entry for transaction %" PRIu16 " ahead of its expiry with transaction %" PRIu16 ".",
+                  t->id, refresh->id);
+
+        r = dns_transaction_go(refresh);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to start transaction to refresh cache entry, ignoring: %m");
+                dns_transaction_free(refresh);
+        }
+}
+
 static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
         int r;
 
@@ -1632,6 +1769,9 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
                 return 0;
         }
 
+        if (t->n_attempts > 0)
+                t->scope->manager->n_transaction_retries++;
+
         t->n_attempts++;
         t->start_usec = ts;
 
@@ -1696,6 +1836,7 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
 
         /* Check the cache. */
         if (!FLAGS_SET(t->query_flags, SD_RESOLVED_NO_CACHE)) {
+                bool refresh;
 
                 /* Before trying the cache, let's make sure we figured out a server to use. Should this cause
                  * a change of server this might flush the cache. */
@@ -1708,13 +1849,19 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
                                 &t->scope->cache,
                                 dns_transaction_key(t),
                                 t->query_flags,
+                                /* serve_stale= */ false,
                                 &t->answer_rcode,
                                 &t->answer,
                                 &t->received,
                                 &t->answer_query_flags,
-                                &t->answer_dnssec_result);
+                                &t->answer_dnssec_result,
+                                &refresh);
                 if (r < 0)
                         return r;
+
+                manager_statistics_cache_lookup(t->scope->manager, dns_transaction_key(t)->type,
+                                                r > 0 && !(t->bypass && t->scope->protocol == DNS_PROTOCOL_DNS && !t->received));
+
                 if (r > 0) {
                         dns_transaction_randomize_answer(t);
 
@@ -1723,6 +1870,9 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
                                  * packet. */
                                 dns_transaction_reset_answer(t);
                         else {
+                                if (refresh)
+                                        dns_transaction_refresh_ahead(t);
+
                                 t->answer_source = DNS_TRANSACTION_CACHE;
                                 if (t->answer_rcode == DNS_RCODE_SUCCESS)
                                         dns_transaction_complete(t, DNS_TRANSACTION_SUCCESS);
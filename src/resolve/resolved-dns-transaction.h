@@ -80,6 +80,7 @@ struct DnsTransaction {
         DnsAnswer *validated_keys;
 
         usec_t start_usec;
+        usec_t latency_usec; /* how long the server took to reply, if the answer came from the network */
         usec_t next_attempt_after;
         sd_event_source *timeout_event_source;
         unsigned n_attempts;
@@ -112,6 +113,9 @@ struct DnsTransaction {
 
         bool probing:1;
 
+        /* Refreshes a cache entry ahead of its expiry, nobody is waiting for the result */
+        bool refresh_ahead:1;
+
         /* Query candidates this transaction is referenced by and that
          * shall be notified about this specific transaction
          * completing. */
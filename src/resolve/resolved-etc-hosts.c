@@ -1,5 +1,6 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -286,12 +287,56 @@ int etc_hosts_parse(EtcHosts *hosts, FILE *f) {
         return 0;
 }
 
+static int manager_etc_hosts_read(Manager *m);
+
+static int on_etc_hosts_changed(sd_event_source *s, const struct inotify_event *event, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+        assert(event);
+
+        /* We watch all of /etc, but only care about the hosts file */
+        if (event->len == 0 || !streq(event->name, "hosts"))
+                return 0;
+
+        /* Re-read the file right away, so that the next lookup doesn't have to wait for a big file to be
+         * parsed. The new data only replaces the old one once it has been parsed completely. */
+        m->etc_hosts_last = USEC_INFINITY;
+        (void) manager_etc_hosts_read(m);
+
+        return 0;
+}
+
+static void manager_etc_hosts_watch(Manager *m) {
+        int r;
+
+        assert(m);
+
+        if (m->etc_hosts_event_source)
+                return;
+
+        /* Watch the directory rather than the file, so that we notice when the file is replaced via
+         * rename(), or removed and created again. Changes to the target of a symlinked /etc/hosts are not
+         * seen this way, but are still picked up by the stat() check on lookups. */
+        r = sd_event_add_inotify(m->event, &m->etc_hosts_event_source, "/etc",
+                                 IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_DELETE|IN_ONLYDIR,
+                                 on_etc_hosts_changed, m);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to watch /etc for changes of /etc/hosts, ignoring: %m");
+                return;
+        }
+
+        (void) sd_event_source_set_description(m->etc_hosts_event_source, "etc-hosts-inotify");
+}
+
 static int manager_etc_hosts_read(Manager *m) {
         _cleanup_fclose_ FILE *f = NULL;
         struct stat st;
         usec_t ts;
         int r;
 
+        manager_etc_hosts_watch(m);
+
         assert_se(sd_event_now(m->event, clock_boottime_or_monotonic(), &ts) >= 0);
 
         /* See if we checked /etc/hosts recently already */
@@ -586,12 +586,14 @@ int manager_new(Manager **ret) {
                 .mdns_ipv4_fd = -1,
                 .mdns_ipv6_fd = -1,
                 .hostname_fd = -1,
+                .stub_send_fd = -1,
 
                 .llmnr_support = DEFAULT_LLMNR_MODE,
                 .mdns_support = DEFAULT_MDNS_MODE,
                 .dnssec_mode = DEFAULT_DNSSEC_MODE,
                 .dns_over_tls_mode = DEFAULT_DNS_OVER_TLS_MODE,
                 .enable_cache = DNS_CACHE_MODE_YES,
+                .cache_lru.size_max = DNS_CACHE_SIZE_MAX_DEFAULT,
                 .dns_stub_listener_mode = DNS_STUB_LISTENER_YES,
                 .read_resolv_conf = true,
                 .need_builtin_fallbacks = true,
@@ -740,6 +742,7 @@ Manager *manager_free(Manager *m) {
         dns_resource_key_unref(m->mdns_host_ipv6_key);
 
         sd_event_source_unref(m->hostname_event_source);
+        sd_event_source_unref(m->etc_hosts_event_source);
         safe_close(m->hostname_fd);
 
         sd_event_unref(m->event);
@@ -755,67 +758,45 @@ Manager *manager_free(Manager *m) {
         dns_trust_anchor_flush(&m->trust_anchor);
         manager_etc_hosts_flush(m);
 
+        hashmap_free_free(m->cache_statistics_by_type);
+
         return mfree(m);
 }
 
-int manager_recv(Manager *m, int fd, DnsProtocol protocol, DnsPacket **ret) {
-        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
-        CMSG_BUFFER_TYPE(CMSG_SPACE(MAXSIZE(struct in_pktinfo, struct in6_pktinfo))
+typedef CMSG_BUFFER_TYPE(CMSG_SPACE(MAXSIZE(struct in_pktinfo, struct in6_pktinfo))
                          + CMSG_SPACE(int) /* ttl/hoplimit */
-                         + EXTRA_CMSG_SPACE /* kernel appears to require extra buffer space */) control;
-        union sockaddr_union sa;
-        struct iovec iov;
-        struct msghdr mh = {
-                .msg_name = &sa.sa,
-                .msg_namelen = sizeof(sa),
-                .msg_iov = &iov,
-                .msg_iovlen = 1,
-                .msg_control = &control,
-                .msg_controllen = sizeof(control),
-        };
+                         + EXTRA_CMSG_SPACE /* kernel appears to require extra buffer space */) RecvControlBuffer;
+
+static int manager_recv_finish(Manager *m, DnsProtocol protocol, DnsPacket *p, struct msghdr *mh, size_t l) {
+        const union sockaddr_union *sa;
         struct cmsghdr *cmsg;
-        ssize_t ms, l;
-        int r;
 
         assert(m);
-        assert(fd >= 0);
-        assert(ret);
-
-        ms = next_datagram_size_fd(fd);
-        if (ms < 0)
-                return ms;
+        assert(p);
+        assert(mh);
 
-        r = dns_packet_new(&p, protocol, ms, DNS_PACKET_SIZE_MAX);
-        if (r < 0)
-                return r;
+        /* Initializes the packet from the data and the metadata of the datagram it was received with */
 
-        iov = IOVEC_MAKE(DNS_PACKET_DATA(p), p->allocated);
+        assert(!(mh->msg_flags & MSG_TRUNC));
 
-        l = recvmsg_safe(fd, &mh, 0);
-        if (IN_SET(l, -EAGAIN, -EINTR))
-                return 0;
-        if (l <= 0)
-                return l;
-
-        assert(!(mh.msg_flags & MSG_TRUNC));
-
-        p->size = (size_t) l;
+        p->size = l;
 
-        p->family = sa.sa.sa_family;
+        sa = mh->msg_name;
+        p->family = sa->sa.sa_family;
         p->ipproto = IPPROTO_UDP;
         if (p->family == AF_INET) {
-                p->sender.in = sa.in.sin_addr;
-                p->sender_port = be16toh(sa.in.sin_port);
+                p->sender.in = sa->in.sin_addr;
+                p->sender_port = be16toh(sa->in.sin_port);
         } else if (p->family == AF_INET6) {
-                p->sender.in6 = sa.in6.sin6_addr;
-                p->sender_port = be16toh(sa.in6.sin6_port);
-                p->ifindex = sa.in6.sin6_scope_id;
+                p->sender.in6 = sa->in6.sin6_addr;
+                p->sender_port = be16toh(sa->in6.sin6_port);
+                p->ifindex = sa->in6.sin6_scope_id;
         } else
                 return -EAFNOSUPPORT;
 
         p->timestamp = now(clock_boottime_or_monotonic());
 
-        CMSG_FOREACH(cmsg, &mh) {
+        CMSG_FOREACH(cmsg, mh) {
 
                 if (cmsg->cmsg_level == IPPROTO_IPV6) {
                         assert(p->family == AF_INET6);
@@ -883,10 +864,126 @@ int manager_recv(Manager *m, int fd, DnsProtocol protocol, DnsPacket **ret) {
         log_debug("Received %s UDP packet of size %zu, ifindex=%i, ttl=%i, fragsize=%zu",
                   dns_protocol_to_string(protocol), p->size, p->ifindex, p->ttl, p->fragsize);
 
+        return 0;
+}
+
+int manager_recv(Manager *m, int fd, DnsProtocol protocol, DnsPacket **ret) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        RecvControlBuffer control;
+        union sockaddr_union sa;
+        struct iovec iov;
+        struct msghdr mh = {
+                .msg_name = &sa.sa,
+                .msg_namelen = sizeof(sa),
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+        };
+        ssize_t ms, l;
+        int r;
+
+        assert(m);
+        assert(fd >= 0);
+        assert(ret);
+
+        ms = next_datagram_size_fd(fd);
+        if (ms < 0)
+                return ms;
+
+        r = dns_packet_new(&p, protocol, ms, DNS_PACKET_SIZE_MAX);
+        if (r < 0)
+                return r;
+
+        iov = IOVEC_MAKE(DNS_PACKET_DATA(p), p->allocated);
+
+        l = recvmsg_safe(fd, &mh, 0);
+        if (IN_SET(l, -EAGAIN, -EINTR))
+                return 0;
+        if (l <= 0)
+                return l;
+
+        r = manager_recv_finish(m, protocol, p, &mh, (size_t) l);
+        if (r < 0)
+                return r;
+
         *ret = TAKE_PTR(p);
         return 1;
 }
 
+int manager_recv_many(Manager *m, int fd, DnsProtocol protocol, DnsPacket **ret, size_t n_max) {
+        RecvControlBuffer control[MANAGER_DATAGRAM_BATCH_MAX];
+        union sockaddr_union sa[MANAGER_DATAGRAM_BATCH_MAX];
+        struct iovec iov[MANAGER_DATAGRAM_BATCH_MAX];
+        struct mmsghdr mh[MANAGER_DATAGRAM_BATCH_MAX];
+        DnsPacket *p[MANAGER_DATAGRAM_BATCH_MAX] = {};
+        size_t n = 0;
+        int k, r;
+
+        assert(m);
+        assert(fd >= 0);
+        assert(ret);
+        assert(n_max > 0);
+
+        /* Like manager_recv(), but receives up to n_max datagrams with a single system call. Unlike
+         * manager_recv() we cannot size the packets to the datagrams upfront, hence datagrams larger than
+         * DNS_PACKET_UNICAST_SIZE_LARGE_MAX are dropped. That's fine for queries, which are tiny, but not
+         * for replies. Returns the number of packets received. */
+
+        n_max = MIN(n_max, (size_t) MANAGER_DATAGRAM_BATCH_MAX);
+
+        for (size_t i = 0; i < n_max; i++) {
+                r = dns_packet_new(p + i, protocol, DNS_PACKET_UNICAST_SIZE_LARGE_MAX, DNS_PACKET_SIZE_MAX);
+                if (r < 0)
+                        goto finish;
+
+                iov[i] = IOVEC_MAKE(DNS_PACKET_DATA(p[i]), p[i]->allocated);
+                mh[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_name = &sa[i].sa,
+                                .msg_namelen = sizeof(sa[i]),
+                                .msg_iov = iov + i,
+                                .msg_iovlen = 1,
+                                .msg_control = control + i,
+                                .msg_controllen = sizeof(control[i]),
+                        },
+                };
+        }
+
+        k = recvmmsg(fd, mh, n_max, MSG_DONTWAIT, NULL);
+        if (k < 0) {
+                r = IN_SET(errno, EAGAIN, EINTR) ? 0 : -errno;
+                goto finish;
+        }
+
+        for (int i = 0; i < k; i++) {
+                if (mh[i].msg_hdr.msg_flags & (MSG_TRUNC|MSG_CTRUNC)) {
+                        log_debug("Received oversized %s UDP packet, ignoring.", dns_protocol_to_string(protocol));
+                        continue;
+                }
+
+                if (mh[i].msg_len == 0)
+                        continue;
+
+                r = manager_recv_finish(m, protocol, p[i], &mh[i].msg_hdr, mh[i].msg_len);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to process received %s UDP packet, ignoring: %m",
+                                        dns_protocol_to_string(protocol));
+                        continue;
+                }
+
+                ret[n++] = TAKE_PTR(p[i]);
+        }
+
+        r = (int) n;
+
+finish:
+        for (size_t i = 0; i < n_max; i++)
+                dns_packet_unref(p[i]);
+
+        return r;
+}
+
 static int sendmsg_loop(int fd, struct msghdr *mh, int flags) {
         int r;
 
@@ -1093,6 +1190,157 @@ int manager_send(
         return -EAFNOSUPPORT;
 }
 
+typedef CMSG_BUFFER_TYPE(CMSG_SPACE(MAXSIZE(struct in_pktinfo, struct in6_pktinfo))) SendControlBuffer;
+
+static int manager_datagram_to_msghdr(
+                const ManagerDatagram *d,
+                union sockaddr_union *sa,
+                struct iovec *iov,
+                SendControlBuffer *control,
+                struct msghdr *ret) {
+
+        struct msghdr mh = {
+                .msg_iov = iov,
+                .msg_iovlen = 1,
+                .msg_name = &sa->sa,
+        };
+        struct cmsghdr *cmsg;
+
+        assert(d);
+        assert(d->packet);
+        assert(d->port > 0);
+        assert(sa);
+        assert(iov);
+        assert(control);
+        assert(ret);
+
+        /* Same as manager_ipv4_send() and manager_ipv6_send(), but only fills in the message header */
+
+        *iov = IOVEC_MAKE(DNS_PACKET_DATA(d->packet), d->packet->size);
+        *control = (SendControlBuffer) {};
+
+        if (d->family == AF_INET) {
+                *sa = (union sockaddr_union) {
+                        .in.sin_family = AF_INET,
+                        .in.sin_addr = d->destination.in,
+                        .in.sin_port = htobe16(d->port),
+                };
+                mh.msg_namelen = sizeof(sa->in);
+
+                if (d->ifindex > 0) {
+                        struct in_pktinfo *pi;
+
+                        mh.msg_control = control;
+                        mh.msg_controllen = CMSG_SPACE(sizeof(struct in_pktinfo));
+
+                        cmsg = CMSG_FIRSTHDR(&mh);
+                        cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+                        cmsg->cmsg_level = IPPROTO_IP;
+                        cmsg->cmsg_type = IP_PKTINFO;
+
+                        pi = (struct in_pktinfo*) CMSG_DATA(cmsg);
+                        pi->ipi_ifindex = d->ifindex;
+                        pi->ipi_spec_dst = d->source.in;
+                }
+
+        } else if (d->family == AF_INET6) {
+                *sa = (union sockaddr_union) {
+                        .in6.sin6_family = AF_INET6,
+                        .in6.sin6_addr = d->destination.in6,
+                        .in6.sin6_port = htobe16(d->port),
+                        .in6.sin6_scope_id = d->ifindex,
+                };
+                mh.msg_namelen = sizeof(sa->in6);
+
+                if (d->ifindex > 0) {
+                        struct in6_pktinfo *pi;
+
+                        mh.msg_control = control;
+                        mh.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
+
+                        cmsg = CMSG_FIRSTHDR(&mh);
+                        cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+                        cmsg->cmsg_level = IPPROTO_IPV6;
+                        cmsg->cmsg_type = IPV6_PKTINFO;
+
+                        pi = (struct in6_pktinfo*) CMSG_DATA(cmsg);
+                        pi->ipi6_ifindex = d->ifindex;
+                        pi->ipi6_addr = d->source.in6;
+                }
+        } else
+                return -EAFNOSUPPORT;
+
+        *ret = mh;
+        return 0;
+}
+
+int manager_send_many(Manager *m, int fd, const ManagerDatagram *datagrams, size_t n) {
+        SendControlBuffer control[MANAGER_DATAGRAM_BATCH_MAX];
+        union sockaddr_union sa[MANAGER_DATAGRAM_BATCH_MAX];
+        struct iovec iov[MANAGER_DATAGRAM_BATCH_MAX];
+        struct mmsghdr mh[MANAGER_DATAGRAM_BATCH_MAX];
+        size_t n_mh = 0, sent = 0;
+        int r, ret = 0;
+
+        assert(m);
+        assert(fd >= 0);
+        assert(datagrams || n == 0);
+        assert(n <= MANAGER_DATAGRAM_BATCH_MAX);
+
+        /* Sends the specified datagrams with as few system calls as possible. If sending a datagram fails,
+         * the remaining ones are sent nonetheless, and the first error is returned. */
+
+        for (size_t i = 0; i < n; i++) {
+                const ManagerDatagram *d = datagrams + i;
+
+                log_debug("Sending %s%s packet with id %" PRIu16 " on interface %i/%s of size %zu.",
+                          DNS_PACKET_TC(d->packet) ? "truncated (!) " : "",
+                          DNS_PACKET_QR(d->packet) ? "response" : "query",
+                          DNS_PACKET_ID(d->packet),
+                          d->ifindex, af_to_name(d->family),
+                          d->packet->size);
+
+                r = manager_datagram_to_msghdr(d, sa + n_mh, iov + n_mh, control + n_mh, &mh[n_mh].msg_hdr);
+                if (r < 0) {
+                        if (ret == 0)
+                                ret = r;
+                        continue;
+                }
+
+                n_mh++;
+        }
+
+        while (sent < n_mh) {
+                int k;
+
+                k = sendmmsg(fd, mh + sent, n_mh - sent, 0);
+                if (k < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        if (errno == EAGAIN) {
+                                r = fd_wait_for_event(fd, POLLOUT, SEND_TIMEOUT_USEC);
+                                if (r == 0)
+                                        r = -ETIMEDOUT;
+                                if (r < 0)
+                                        return ret < 0 ? ret : r;
+                                continue;
+                        }
+
+                        /* sendmmsg() only reports an error if the first datagram couldn't be sent. Skip it,
+                         * and continue with the next one. */
+                        if (ret == 0)
+                                ret = -errno;
+                        sent++;
+                        continue;
+                }
+
+                sent += k;
+        }
+
+        return ret;
+}
+
 uint32_t manager_find_mtu(Manager *m) {
         uint32_t mtu = 0;
         Link *l;
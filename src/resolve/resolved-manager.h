@@ -19,13 +19,27 @@ typedef struct Manager Manager;
 #include "resolved-dns-search-domain.h"
 #include "resolved-dns-stream.h"
 #include "resolved-dns-stub.h"
+#include "resolved-dns-stub-workers.h"
 #include "resolved-dns-trust-anchor.h"
 #include "resolved-link.h"
 #include "resolved-socket-graveyard.h"
+#include "resolved-statistics.h"
 
 #define MANAGER_SEARCH_DOMAINS_MAX 256
 #define MANAGER_DNS_SERVERS_MAX 256
 
+/* The number of datagrams received or sent with a single recvmmsg() or sendmmsg() call */
+#define MANAGER_DATAGRAM_BATCH_MAX 32
+
+typedef struct ManagerDatagram {
+        int ifindex;
+        int family;
+        union in_addr_union destination;
+        uint16_t port;
+        union in_addr_union source;
+        DnsPacket *packet;
+} ManagerDatagram;
+
 typedef struct EtcHosts {
         Hashmap *by_address;
         Hashmap *by_name;
@@ -41,6 +55,9 @@ struct Manager {
         DnsOverTlsMode dns_over_tls_mode;
         DnsCacheMode enable_cache;
         bool cache_from_localhost;
+        bool cache_refresh_ahead;
+        usec_t stale_retention_usec;
+        DnsCacheLRU cache_lru;
         DnsStubListenerMode dns_stub_listener_mode;
 
 #if ENABLE_DNS_OVER_TLS
@@ -61,6 +78,7 @@ struct Manager {
         LIST_HEAD(DnsQuery, dns_queries);
         unsigned n_dns_queries;
         Hashmap *stub_queries_by_packet;
+        Set *stub_reply_cache;
 
         LIST_HEAD(DnsStream, dns_streams);
         unsigned n_dns_streams[_DNS_STREAM_TYPE_MAX];
@@ -128,10 +146,16 @@ struct Manager {
         unsigned n_transactions_total;
         unsigned n_dnssec_verdict[_DNSSEC_VERDICT_MAX];
 
+        /* More detailed statistics, exposed via the monitoring Varlink interface */
+        LatencyHistogram transport_latency[_DNS_TRANSPORT_MAX];
+        Hashmap *cache_statistics_by_type;
+        uint64_t n_transaction_retries;
+
         /* Data from /etc/hosts */
         EtcHosts etc_hosts;
         usec_t etc_hosts_last;
         struct stat etc_hosts_stat;
+        sd_event_source *etc_hosts_event_source;
         bool read_etc_hosts;
 
         OrderedSet *dns_extra_stub_listeners;
@@ -140,9 +164,20 @@ struct Manager {
         sd_event_source *dns_stub_udp_event_source;
         sd_event_source *dns_stub_tcp_event_source;
 
+        /* Replies to the datagrams received on stub_send_fd are queued while a batch of them is
+         * processed, and sent together afterwards */
+        int stub_send_fd;
+        ManagerDatagram stub_send_queue[MANAGER_DATAGRAM_BATCH_MAX];
+        size_t n_stub_send_queue;
+
+        unsigned n_stub_workers;
+        DnsStubWorkers *stub_workers;
+
         Hashmap *polkit_registry;
 
         VarlinkServer *varlink_server;
+        VarlinkServer *varlink_monitor_server;
+        Set *varlink_subscriptions;
 
         sd_event_source *clock_change_event_source;
 
@@ -163,6 +198,8 @@ uint32_t manager_find_mtu(Manager *m);
 int manager_write(Manager *m, int fd, DnsPacket *p);
 int manager_send(Manager *m, int fd, int ifindex, int family, const union in_addr_union *destination, uint16_t port, const union in_addr_union *source, DnsPacket *p);
 int manager_recv(Manager *m, int fd, DnsProtocol protocol, DnsPacket **ret);
+int manager_recv_many(Manager *m, int fd, DnsProtocol protocol, DnsPacket **ret, size_t n_max);
+int manager_send_many(Manager *m, int fd, const ManagerDatagram *datagrams, size_t n);
 
 int manager_find_ifindex(Manager *m, int family, const union in_addr_union *in_addr);
 LinkAddress* manager_find_link_address(Manager *m, int family, const union in_addr_union *in_addr);
@@ -0,0 +1,270 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "dns-type.h"
+#include "memory-util.h"
+#include "resolved-dns-server.h"
+#include "resolved-link.h"
+#include "resolved-manager.h"
+#include "resolved-statistics.h"
+#include "string-table.h"
+
+typedef struct DnsCacheTypeStatistics {
+        uint64_t n_hit;
+        uint64_t n_miss;
+} DnsCacheTypeStatistics;
+
+static const char* const dns_transport_table[_DNS_TRANSPORT_MAX] = {
+        [DNS_TRANSPORT_UDP] = "udp",
+        [DNS_TRANSPORT_TCP] = "tcp",
+        [DNS_TRANSPORT_TLS] = "tls",
+};
+DEFINE_STRING_TABLE_LOOKUP_TO_STRING(dns_transport, DnsTransport);
+
+void manager_statistics_cache_lookup(Manager *m, uint16_t type, bool hit) {
+        DnsCacheTypeStatistics *s;
+
+        assert(m);
+
+        s = hashmap_get(m->cache_statistics_by_type, UINT_TO_PTR(type));
+        if (!s) {
+                s = new0(DnsCacheTypeStatistics, 1);
+                if (!s) {
+                        log_oom_debug();
+                        return;
+                }
+
+                if (hashmap_ensure_put(&m->cache_statistics_by_type, NULL, UINT_TO_PTR(type), s) < 0) {
+                        free(s);
+                        log_oom_debug();
+                        return;
+                }
+        }
+
+        if (hit)
+                s->n_hit++;
+        else
+                s->n_miss++;
+}
+
+static void dns_servers_reset_statistics(DnsServer *first) {
+        DnsServer *s;
+
+        LIST_FOREACH(servers, s, first)
+                zero(s->rtt);
+}
+
+void manager_statistics_reset(Manager *m) {
+        Link *l;
+
+        assert(m);
+
+        zero(m->transport_latency);
+        m->n_transaction_retries = 0;
+        hashmap_clear_free(m->cache_statistics_by_type);
+
+        dns_servers_reset_statistics(m->dns_servers);
+        dns_servers_reset_statistics(m->fallback_dns_servers);
+        HASHMAP_FOREACH(l, m->links)
+                dns_servers_reset_statistics(l->dns_servers);
+}
+
+static int dns_servers_build_json(DnsServer *first, JsonVariant **array) {
+        DnsServer *s;
+        int r;
+
+        assert(array);
+
+        LIST_FOREACH(servers, s, first) {
+                _cleanup_(json_variant_unrefp) JsonVariant *rtt = NULL, *v = NULL;
+
+                r = latency_histogram_build_json(&s->rtt, &rtt);
+                if (r < 0)
+                        return r;
+
+                r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("server", JSON_BUILD_STRING(dns_server_string_full(s))),
+                                       JSON_BUILD_PAIR("type", JSON_BUILD_STRING(dns_server_type_to_string(s->type))),
+                                       JSON_BUILD_PAIR_CONDITION(s->link, "ifindex", JSON_BUILD_INTEGER(s->link ? s->link->ifindex : 0)),
+                                       JSON_BUILD_PAIR("rtt", JSON_BUILD_VARIANT(rtt))));
+                if (r < 0)
+                        return r;
+
+                r = json_variant_append_array(array, v);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+int manager_statistics_build_json(Manager *m, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *servers = NULL, *types = NULL, *udp = NULL, *tcp = NULL, *tls = NULL;
+        DnsCacheTypeStatistics *s;
+        uint64_t hit = 0, miss = 0;
+        DnsScope *scope;
+        void *type;
+        Link *l;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        r = latency_histogram_build_json(m->transport_latency + DNS_TRANSPORT_UDP, &udp);
+        if (r < 0)
+                return r;
+
+        r = latency_histogram_build_json(m->transport_latency + DNS_TRANSPORT_TCP, &tcp);
+        if (r < 0)
+                return r;
+
+        r = latency_histogram_build_json(m->transport_latency + DNS_TRANSPORT_TLS, &tls);
+        if (r < 0)
+                return r;
+
+        r = json_variant_new_array(&servers, NULL, 0);
+        if (r < 0)
+                return r;
+
+        r = dns_servers_build_json(m->dns_servers, &servers);
+        if (r < 0)
+                return r;
+
+        r = dns_servers_build_json(m->fallback_dns_servers, &servers);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH(l, m->links) {
+                r = dns_servers_build_json(l->dns_servers, &servers);
+                if (r < 0)
+                        return r;
+        }
+
+        r = json_variant_new_array(&types, NULL, 0);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(s, type, m->cache_statistics_by_type) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+                const char *name = dns_type_to_string(PTR_TO_UINT(type));
+
+                r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("type", JSON_BUILD_UNSIGNED(PTR_TO_UINT(type))),
+                                       JSON_BUILD_PAIR_CONDITION(name, "typeName", JSON_BUILD_STRING(name)),
+                                       JSON_BUILD_PAIR("hits", JSON_BUILD_UNSIGNED(s->n_hit)),
+                                       JSON_BUILD_PAIR("misses", JSON_BUILD_UNSIGNED(s->n_miss))));
+                if (r < 0)
+                        return r;
+
+                r = json_variant_append_array(&types, v);
+                if (r < 0)
+                        return r;
+        }
+
+        LIST_FOREACH(scopes, scope, m->dns_scopes) {
+                hit += scope->cache.n_hit;
+                miss += scope->cache.n_miss;
+        }
+
+        return json_build(ret, JSON_BUILD_OBJECT(
+                                 JSON_BUILD_PAIR("transactions", JSON_BUILD_OBJECT(
+                                                 JSON_BUILD_PAIR("total", JSON_BUILD_UNSIGNED(m->n_transactions_total)),
+                                                 JSON_BUILD_PAIR("current", JSON_BUILD_UNSIGNED(hashmap_size(m->dns_transactions))),
+                                                 JSON_BUILD_PAIR("retries", JSON_BUILD_UNSIGNED(m->n_transaction_retries)))),
+                                 JSON_BUILD_PAIR("transports", JSON_BUILD_OBJECT(
+                                                 JSON_BUILD_PAIR("udp", JSON_BUILD_VARIANT(udp)),
+                                                 JSON_BUILD_PAIR("tcp", JSON_BUILD_VARIANT(tcp)),
+                                                 JSON_BUILD_PAIR("tls", JSON_BUILD_VARIANT(tls)))),
+                                 JSON_BUILD_PAIR("servers", JSON_BUILD_VARIANT(servers)),
+                                 JSON_BUILD_PAIR("cache", JSON_BUILD_OBJECT(
+                                                 JSON_BUILD_PAIR("hits", JSON_BUILD_UNSIGNED(hit)),
+                                                 JSON_BUILD_PAIR("misses", JSON_BUILD_UNSIGNED(miss)),
+                                                 JSON_BUILD_PAIR("byType", JSON_BUILD_VARIANT(types))))));
+}
+
+static uint64_t metric_transactions_total(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->n_transactions_total;
+}
+
+static uint64_t metric_transactions_current(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return hashmap_size(m->dns_transactions);
+}
+
+static uint64_t metric_transaction_retries_total(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->n_transaction_retries;
+}
+
+static uint64_t metric_cache_hits_total(void *userdata) {
+        Manager *m = userdata;
+        DnsScope *scope;
+        uint64_t n = 0;
+
+        assert(m);
+
+        LIST_FOREACH(scopes, scope, m->dns_scopes)
+                n += scope->cache.n_hit;
+
+        return n;
+}
+
+static uint64_t metric_cache_misses_total(void *userdata) {
+        Manager *m = userdata;
+        DnsScope *scope;
+        uint64_t n = 0;
+
+        assert(m);
+
+        LIST_FOREACH(scopes, scope, m->dns_scopes)
+                n += scope->cache.n_miss;
+
+        return n;
+}
+
+static const LatencyHistogram* metric_udp_latency(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->transport_latency + DNS_TRANSPORT_UDP;
+}
+
+static const LatencyHistogram* metric_tcp_latency(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->transport_latency + DNS_TRANSPORT_TCP;
+}
+
+static const LatencyHistogram* metric_tls_latency(void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return m->transport_latency + DNS_TRANSPORT_TLS;
+}
+
+const Metric manager_metrics[] = {
+        { "resolved_transactions_total",        "DNS transactions started",               METRIC_COUNTER,   .get_value = metric_transactions_total        },
+        { "resolved_transactions_current",      "DNS transactions currently in progress", METRIC_GAUGE,     .get_value = metric_transactions_current      },
+        { "resolved_transaction_retries_total", "DNS transaction attempts repeated",      METRIC_COUNTER,   .get_value = metric_transaction_retries_total },
+        { "resolved_cache_hits_total",          "Lookups answered from the cache",        METRIC_COUNTER,   .get_value = metric_cache_hits_total          },
+        { "resolved_cache_misses_total",        "Lookups not found in the cache",         METRIC_COUNTER,   .get_value = metric_cache_misses_total        },
+        { "resolved_udp_latency",               "Latency of DNS transactions over UDP",   METRIC_HISTOGRAM, .get_histogram = metric_udp_latency           },
+        { "resolved_tcp_latency",               "Latency of DNS transactions over TCP",   METRIC_HISTOGRAM, .get_histogram = metric_tcp_latency           },
+        { "resolved_tls_latency",               "Latency of DNS transactions over TLS",   METRIC_HISTOGRAM, .get_histogram = metric_tls_latency           },
+};
+
+const size_t manager_n_metrics = ELEMENTSOF(manager_metrics);
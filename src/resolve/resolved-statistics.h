@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "json.h"
+#include "macro.h"
+#include "metrics.h"
+
+typedef struct Manager Manager;
+
+typedef enum DnsTransport {
+        DNS_TRANSPORT_UDP,
+        DNS_TRANSPORT_TCP,
+        DNS_TRANSPORT_TLS,
+        _DNS_TRANSPORT_MAX,
+        _DNS_TRANSPORT_INVALID = -EINVAL,
+} DnsTransport;
+
+const char* dns_transport_to_string(DnsTransport t) _const_;
+
+void manager_statistics_cache_lookup(Manager *m, uint16_t type, bool hit);
+void manager_statistics_reset(Manager *m);
+int manager_statistics_build_json(Manager *m, JsonVariant **ret);
+
+extern const Metric manager_metrics[];
+extern const size_t manager_n_metrics;
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include "in-addr-util.h"
+#include "metrics.h"
 #include "resolved-dns-synthesize.h"
 #include "resolved-varlink.h"
 #include "socket-netlink.h"
@@ -518,12 +519,161 @@ fail:
         return r;
 }
 
+static int vl_method_dump_statistics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        Manager *m;
+        int r;
+
+        assert(link);
+
+        m = varlink_server_get_userdata(varlink_get_server(link));
+        assert(m);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        r = manager_statistics_build_json(m, &v);
+        if (r < 0)
+                return r;
+
+        return varlink_reply(link, v);
+}
+
+static int vl_method_list_metrics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        Manager *m;
+
+        assert(link);
+
+        m = varlink_server_get_userdata(varlink_get_server(link));
+        assert(m);
+
+        return metrics_method_list(link, parameters, manager_metrics, manager_n_metrics, m);
+}
+
+static int vl_method_subscribe_transactions(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        Manager *m;
+        int r;
+
+        assert(link);
+
+        m = varlink_server_get_userdata(varlink_get_server(link));
+        assert(m);
+
+        if (!FLAGS_SET(flags, VARLINK_METHOD_MORE))
+                return varlink_error(link, VARLINK_ERROR_EXPECTED_MORE, NULL);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        r = set_ensure_put(&m->varlink_subscriptions, NULL, link);
+        if (r < 0)
+                return r;
+        if (r > 0)
+                varlink_ref(link);
+
+        /* Replies are sent as transactions complete, see manager_varlink_notify_transaction() */
+        return 1;
+}
+
+static void vl_monitor_on_disconnect(VarlinkServer *s, Varlink *link, void *userdata) {
+        Manager *m;
+
+        assert(s);
+        assert(link);
+
+        m = varlink_server_get_userdata(s);
+        assert(m);
+
+        if (set_remove(m->varlink_subscriptions, link))
+                varlink_unref(link);
+}
+
+void manager_varlink_notify_transaction(Manager *m, DnsTransaction *t) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        char key_str[DNS_RESOURCE_KEY_STRING_MAX];
+        Varlink *link;
+        int r;
+
+        assert(m);
+        assert(t);
+
+        if (set_isempty(m->varlink_subscriptions))
+                return;
+
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                               JSON_BUILD_PAIR("id", JSON_BUILD_UNSIGNED(t->id)),
+                               JSON_BUILD_PAIR("key", JSON_BUILD_STRING(dns_resource_key_to_string(dns_transaction_key(t), key_str, sizeof key_str))),
+                               JSON_BUILD_PAIR("protocol", JSON_BUILD_STRING(dns_protocol_to_string(t->scope->protocol))),
+                               JSON_BUILD_PAIR_CONDITION(t->scope->link, "ifindex", JSON_BUILD_INTEGER(t->scope->link ? t->scope->link->ifindex : 0)),
+                               JSON_BUILD_PAIR("state", JSON_BUILD_STRING(dns_transaction_state_to_string(t->state))),
+                               JSON_BUILD_PAIR_CONDITION(t->answer_source >= 0, "source", JSON_BUILD_STRING(dns_transaction_source_to_string(t->answer_source))),
+                               JSON_BUILD_PAIR_CONDITION(t->server, "server", JSON_BUILD_STRING(t->server ? dns_server_string_full(t->server) : NULL)),
+                               JSON_BUILD_PAIR_CONDITION(t->answer_source >= 0, "rcode", JSON_BUILD_UNSIGNED(t->answer_rcode)),
+                               JSON_BUILD_PAIR("attempts", JSON_BUILD_UNSIGNED(t->n_attempts)),
+                               JSON_BUILD_PAIR_CONDITION(t->answer_source == DNS_TRANSACTION_NETWORK && t->latency_usec != USEC_INFINITY,
+                                                         "latencyUSec", JSON_BUILD_UNSIGNED(t->latency_usec))));
+        if (r < 0) {
+                log_debug_errno(r, "Failed to build transaction notification, ignoring: %m");
+                return;
+        }
+
+        SET_FOREACH(link, m->varlink_subscriptions) {
+                r = varlink_notify(link, v);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to send transaction notification to subscriber, ignoring: %m");
+        }
+}
+
+static int manager_varlink_monitor_init(Manager *m) {
+        _cleanup_(varlink_server_unrefp) VarlinkServer *s = NULL;
+        int r;
+
+        assert(m);
+
+        if (m->varlink_monitor_server)
+                return 0;
+
+        /* The monitoring interface reveals what everybody else looks up, hence it is for root only */
+        r = varlink_server_new(&s, VARLINK_SERVER_ROOT_ONLY);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate varlink server object: %m");
+
+        varlink_server_set_userdata(s, m);
+
+        r = varlink_server_bind_method_many(
+                        s,
+                        "io.systemd.Resolve.Monitor.DumpStatistics",        vl_method_dump_statistics,
+                        "io.systemd.Resolve.Monitor.SubscribeTransactions", vl_method_subscribe_transactions,
+                        "io.systemd.Metrics.List",                          vl_method_list_metrics);
+        if (r < 0)
+                return log_error_errno(r, "Failed to register varlink methods: %m");
+
+        r = varlink_server_bind_disconnect(s, vl_monitor_on_disconnect);
+        if (r < 0)
+                return log_error_errno(r, "Failed to register varlink disconnect handler: %m");
+
+        r = varlink_server_listen_address(s, "/run/systemd/resolve/io.systemd.Resolve.Monitor", 0600);
+        if (r < 0)
+                return log_error_errno(r, "Failed to bind to varlink socket: %m");
+
+        r = varlink_server_attach_event(s, m->event, SD_EVENT_PRIORITY_NORMAL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to attach varlink connection to event loop: %m");
+
+        m->varlink_monitor_server = TAKE_PTR(s);
+        return 0;
+}
+
 int manager_varlink_init(Manager *m) {
         _cleanup_(varlink_server_unrefp) VarlinkServer *s = NULL;
         int r;
 
         assert(m);
 
+        r = manager_varlink_monitor_init(m);
+        if (r < 0)
+                return r;
+
         if (m->varlink_server)
                 return 0;
 
@@ -560,4 +710,7 @@ void manager_varlink_done(Manager *m) {
         assert(m);
 
         m->varlink_server = varlink_server_unref(m->varlink_server);
+
+        m->varlink_subscriptions = set_free_with_destructor(m->varlink_subscriptions, varlink_unref);
+        m->varlink_monitor_server = varlink_server_unref(m->varlink_monitor_server);
 }
@@ -5,3 +5,5 @@
 
 int manager_varlink_init(Manager *m);
 void manager_varlink_done(Manager *m);
+
+void manager_varlink_notify_transaction(Manager *m, DnsTransaction *t);
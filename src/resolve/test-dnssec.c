@@ -349,6 +349,15 @@ static void test_dnssec_verify_rrset(void) {
         /* Validate the RR as it if was 2015-12-2 today */
         assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
         assert_se(result == DNSSEC_VALIDATED);
+
+        /* The second time around the result is cached */
+        assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_VALIDATED);
+
+        /* A different signature must not be taken from the cache */
+        ((uint8_t*) rrsig->rrsig.signature)[0] ^= 0x01;
+        assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_INVALID);
 }
 
 static void test_dnssec_verify_rrset2(void) {
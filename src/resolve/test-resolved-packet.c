@@ -1,7 +1,9 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include "alloc-util.h"
 #include "log.h"
 #include "resolved-dns-packet.h"
+#include "string-util.h"
 #include "tests.h"
 
 static void test_dns_packet_new(void) {
@@ -23,10 +25,38 @@ static void test_dns_packet_new(void) {
         assert_se(dns_packet_new(&p2, DNS_PROTOCOL_DNS, DNS_PACKET_SIZE_MAX + 1, DNS_PACKET_SIZE_MAX) == -EFBIG);
 }
 
+static void test_dns_packet_read_name_skip(void) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        _cleanup_free_ char *a = NULL, *b = NULL;
+        size_t after_first, after_second;
+
+        assert_se(dns_packet_new(&p, DNS_PROTOCOL_DNS, 0, DNS_PACKET_SIZE_MAX) == 0);
+
+        /* The second name is compressed, pointing into the first one */
+        assert_se(dns_packet_append_name(p, "www.example.com", true, false, NULL) >= 0);
+        assert_se(dns_packet_append_name(p, "mail.example.com", true, false, NULL) >= 0);
+
+        dns_packet_rewind(p, DNS_PACKET_HEADER_SIZE);
+        assert_se(dns_packet_read_name(p, &a, true, NULL) >= 0);
+        after_first = p->rindex;
+        assert_se(dns_packet_read_name(p, &b, true, NULL) >= 0);
+        after_second = p->rindex;
+        assert_se(streq(a, "www.example.com"));
+        assert_se(streq(b, "mail.example.com"));
+
+        /* Skipping over the names must end up at the same places */
+        dns_packet_rewind(p, DNS_PACKET_HEADER_SIZE);
+        assert_se(dns_packet_read_name(p, NULL, true, NULL) >= 0);
+        assert_se(p->rindex == after_first);
+        assert_se(dns_packet_read_name(p, NULL, true, NULL) >= 0);
+        assert_se(p->rindex == after_second);
+}
+
 int main(int argc, char **argv) {
         test_setup_logging(LOG_DEBUG);
 
         test_dns_packet_new();
+        test_dns_packet_read_name_skip();
 
         return 0;
 }
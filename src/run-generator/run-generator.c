@@ -131,7 +131,12 @@ static int run(const char *dest, const char *dest_early, const char *dest_late)
         if (r < 0)
                 log_warning_errno(r, "Failed to parse kernel command line, ignoring: %m");
 
-        return generate();
+        r = generate();
+        if (r < 0)
+                return r;
+
+        /* We only look at the kernel command line */
+        return generator_declare_inputs(NULL);
 }
 
 DEFINE_MAIN_GENERATOR_FUNCTION(run);
@@ -323,6 +323,25 @@ int bpf_map_update_element(int fd, const void *key, void *value) {
         return 0;
 }
 
+int bpf_map_update_batch(int fd, const void *keys, const void *values, size_t n) {
+        union bpf_attr attr;
+
+        /* Requires kernel 5.6 and a map type that supports batch operations. Callers should fall back to
+         * bpf_map_update_element() if this fails. Note that on failure some of the elements might have been
+         * updated already. */
+
+        zero(attr);
+        attr.batch.map_fd = fd;
+        attr.batch.keys = PTR_TO_UINT64(keys);
+        attr.batch.values = PTR_TO_UINT64(values);
+        attr.batch.count = n;
+
+        if (bpf(BPF_MAP_UPDATE_BATCH, &attr, sizeof(attr)) < 0)
+                return -errno;
+
+        return 0;
+}
+
 int bpf_map_lookup_element(int fd, const void *key, void *value) {
         union bpf_attr attr;
 
@@ -58,6 +58,7 @@ extern const struct hash_ops bpf_program_hash_ops;
 
 int bpf_map_new(enum bpf_map_type type, size_t key_size, size_t value_size, size_t max_entries, uint32_t flags);
 int bpf_map_update_element(int fd, const void *key, void *value);
+int bpf_map_update_batch(int fd, const void *keys, const void *values, size_t n);
 int bpf_map_lookup_element(int fd, const void *key, void *value);
 
 int bpf_cgroup_attach_type_from_string(const char *str) _pure_;
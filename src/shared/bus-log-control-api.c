@@ -4,6 +4,7 @@
 #include "bus-get-properties.h"
 #include "bus-log-control-api.h"
 #include "bus-util.h"
+#include "event-util.h"
 #include "log.h"
 #include "sd-bus.h"
 #include "syslog-util.h"
@@ -94,12 +95,142 @@ int bus_property_set_log_target(
 
 BUS_DEFINE_PROPERTY_GET_GLOBAL(bus_property_get_syslog_identifier, "s", program_invocation_short_name);
 
+static int property_get_event_source_profiling(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        sd_event *e;
+        int r = 0;
+
+        assert(bus);
+        assert(reply);
+
+        e = sd_bus_get_event(bus);
+        if (e) {
+                r = event_get_profile_sources(e);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_append(reply, "b", r > 0);
+}
+
+static int property_set_event_source_profiling(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *value,
+                void *userdata,
+                sd_bus_error *error) {
+
+        sd_event *e;
+        int b, r;
+
+        assert(bus);
+        assert(value);
+
+        r = sd_bus_message_read(value, "b", &b);
+        if (r < 0)
+                return r;
+
+        e = sd_bus_get_event(bus);
+        if (!e)
+                return sd_bus_error_set(error, SD_BUS_ERROR_NOT_SUPPORTED, "Service does not run an event loop.");
+
+        r = event_set_profile_sources(e, b);
+        if (r < 0)
+                return r;
+        if (r > 0)
+                log_info("%s event source profiling.", b ? "Enabling" : "Disabling");
+
+        return 0;
+}
+
+static int method_get_event_source_statistics(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        EventSourceStatistics *array = NULL;
+        size_t n = 0;
+        sd_event *e;
+        int r;
+
+        assert(message);
+
+        e = sd_bus_get_event(sd_bus_message_get_bus(message));
+        if (!e)
+                return sd_bus_error_set(error, SD_BUS_ERROR_NOT_SUPPORTED, "Service does not run an event loop.");
+
+        r = event_get_source_statistics(e, &array, &n);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                goto finish;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sstttau)");
+        if (r < 0)
+                goto finish;
+
+        for (size_t i = 0; i < n; i++) {
+                size_t m = ELEMENTSOF(array[i].histogram);
+
+                /* Leave out the empty buckets at the end of the histogram */
+                while (m > 0 && array[i].histogram[m - 1] == 0)
+                        m--;
+
+                r = sd_bus_message_open_container(reply, 'r', "sstttau");
+                if (r < 0)
+                        goto finish;
+
+                r = sd_bus_message_append(reply, "ssttt",
+                                          strempty(array[i].description),
+                                          array[i].type,
+                                          array[i].n_dispatched,
+                                          array[i].total_usec,
+                                          array[i].max_usec);
+                if (r < 0)
+                        goto finish;
+
+                r = sd_bus_message_append_array(reply, 'u', array[i].histogram, m * sizeof(unsigned));
+                if (r < 0)
+                        goto finish;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                goto finish;
+
+        r = sd_bus_send(NULL, reply, NULL);
+
+finish:
+        event_source_statistics_free_many(array, n);
+        return r;
+}
+
 static const sd_bus_vtable log_control_vtable[] = {
         SD_BUS_VTABLE_START(0),
 
         SD_BUS_WRITABLE_PROPERTY("LogLevel", "s", bus_property_get_log_level, bus_property_set_log_level, 0, 0),
         SD_BUS_WRITABLE_PROPERTY("LogTarget", "s", bus_property_get_log_target, bus_property_set_log_target, 0, 0),
         SD_BUS_PROPERTY("SyslogIdentifier", "s", bus_property_get_syslog_identifier, 0, 0),
+        SD_BUS_WRITABLE_PROPERTY("EventSourceProfiling", "b", property_get_event_source_profiling, property_set_event_source_profiling, 0, 0),
+
+        SD_BUS_METHOD_WITH_NAMES("GetEventSourceStatistics",
+                                 NULL,,
+                                 "a(sstttau)",
+                                 SD_BUS_PARAM(statistics),
+                                 method_get_event_source_statistics,
+                                 SD_BUS_VTABLE_UNPRIVILEGED),
 
         /* One of those days we might want to add a similar, second interface to cover common service
          * operations such as Reload(), Reexecute(), Exit() …  and maybe some properties exposing version
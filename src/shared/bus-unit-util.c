@@ -1022,7 +1022,8 @@ static int bus_append_execute_property(sd_bus_message *m, const char *field, con
         if (streq(field, "LogRateLimitIntervalSec"))
                 return bus_append_parse_sec_rename(m, field, eq);
 
-        if (streq(field, "LogRateLimitBurst"))
+        if (STR_IN_SET(field, "LogRateLimitBurst",
+                              "LogNamespaceShards"))
                 return bus_append_safe_atou(m, field, eq);
 
         if (streq(field, "MountFlags"))
@@ -1973,6 +1974,9 @@ static int bus_append_path_property(sd_bus_message *m, const char *field, const
         if (streq(field, "DirectoryMode"))
                 return bus_append_parse_mode(m, field, eq);
 
+        if (streq(field, "TriggerDelaySec"))
+                return bus_append_parse_sec_rename(m, field, eq);
+
         if (STR_IN_SET(field, "PathExists",
                               "PathExistsGlob",
                               "PathChanged",
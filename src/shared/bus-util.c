@@ -14,6 +14,7 @@
 #include "sd-event.h"
 #include "sd-id128.h"
 
+#include "alloc-util.h"
 #include "bus-common-errors.h"
 #include "bus-internal.h"
 #include "bus-label.h"
@@ -573,6 +574,119 @@ int bus_reply_pair_array(sd_bus_message *m, char **l) {
         return sd_bus_send(NULL, reply, NULL);
 }
 
+typedef struct BusCallBatch {
+        bus_call_batch_handler_t handler;
+        void *userdata;
+        sd_bus_slot **slots;
+        size_t n_sent;
+        size_t n_in_flight;
+        int error;
+} BusCallBatch;
+
+typedef struct BusCallBatchItem {
+        BusCallBatch *batch;
+        size_t idx;
+} BusCallBatchItem;
+
+static int bus_call_batch_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        BusCallBatchItem *item = userdata;
+        BusCallBatch *b;
+        int r;
+
+        assert(m);
+        assert(item);
+
+        b = item->batch;
+        assert(b->n_in_flight > 0);
+        b->n_in_flight--;
+
+        if (b->error < 0)
+                return 0;
+
+        r = b->handler(m, item->idx, b->userdata);
+        if (r < 0)
+                b->error = r;
+
+        return 0;
+}
+
+int bus_call_batch(
+                sd_bus *bus,
+                sd_bus_message **calls,
+                size_t n_calls,
+                size_t max_in_flight,
+                bus_call_batch_handler_t handler,
+                void *userdata) {
+
+        _cleanup_free_ BusCallBatchItem *items = NULL;
+        BusCallBatch b = {
+                .handler = handler,
+                .userdata = userdata,
+        };
+        int r;
+
+        assert(bus);
+        assert(calls || n_calls == 0);
+        assert(max_in_flight > 0);
+        assert(handler);
+
+        /* Issues the specified method calls asynchronously, keeping at most max_in_flight of them
+         * outstanding at any time, so that a caller needing many of them doesn't have to wait for a full
+         * round trip for each. The handler is called for each reply (which may be an error reply) as it
+         * comes in, with the index of the call it belongs to. Other messages, e.g. signals, are
+         * dispatched as usual in the meantime. Returns the first error returned by the handler, after
+         * which no further calls are issued. */
+
+        if (n_calls == 0)
+                return 0;
+
+        items = new(BusCallBatchItem, n_calls);
+        if (!items)
+                return -ENOMEM;
+
+        b.slots = new0(sd_bus_slot*, n_calls);
+        if (!b.slots)
+                return -ENOMEM;
+
+        while (b.error >= 0 && (b.n_sent < n_calls || b.n_in_flight > 0)) {
+
+                while (b.n_sent < n_calls && b.n_in_flight < max_in_flight) {
+                        items[b.n_sent] = (BusCallBatchItem) {
+                                .batch = &b,
+                                .idx = b.n_sent,
+                        };
+
+                        r = sd_bus_call_async(bus, b.slots + b.n_sent, calls[b.n_sent], bus_call_batch_reply, items + b.n_sent, 0);
+                        if (r < 0)
+                                goto finish;
+
+                        b.n_sent++;
+                        b.n_in_flight++;
+                }
+
+                r = sd_bus_process(bus, NULL);
+                if (r < 0)
+                        goto finish;
+                if (r > 0)
+                        continue;
+
+                r = sd_bus_wait(bus, UINT64_MAX);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = b.error;
+
+finish:
+        /* Drop the calls still outstanding, if we failed, so that their replies are not dispatched to us
+         * anymore */
+        for (size_t i = 0; i < b.n_sent; i++)
+                sd_bus_slot_unref(b.slots[i]);
+        free(b.slots);
+
+        return r;
+}
+
 static void bus_message_unref_wrapper(void *m) {
         sd_bus_message_unref(m);
 }
@@ -74,4 +74,8 @@ static inline int bus_open_system_watch_bind(sd_bus **ret) {
 
 int bus_reply_pair_array(sd_bus_message *m, char **l);
 
+typedef int (*bus_call_batch_handler_t)(sd_bus_message *reply, size_t idx, void *userdata);
+
+int bus_call_batch(sd_bus *bus, sd_bus_message **calls, size_t n_calls, size_t max_in_flight, bus_call_batch_handler_t handler, void *userdata);
+
 extern const struct hash_ops bus_message_hash_ops;
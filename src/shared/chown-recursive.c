@@ -14,29 +14,66 @@
 #include "strv.h"
 #include "user-util.h"
 
+typedef struct ChownState {
+        /* The last file system we found not to support ACLs on, so that we don't try to remove them on
+         * each inode on it again */
+        dev_t no_acl_dev;
+        bool no_acl_dev_valid;
+} ChownState;
+
+static bool stat_ownership_ok(const struct stat *st, uid_t uid, gid_t gid, mode_t mask) {
+        assert(st);
+
+        return (!uid_is_valid(uid) || st->st_uid == uid) &&
+                (!gid_is_valid(gid) || st->st_gid == gid) &&
+                ((st->st_mode & ~mask & 07777) == 0);
+}
+
 static int chown_one(
                 int fd,
                 const struct stat *st,
                 uid_t uid,
                 gid_t gid,
-                mode_t mask) {
+                mode_t mask,
+                ChownState *state) {
 
         char procfs_path[STRLEN("/proc/self/fd/") + DECIMAL_STR_MAX(int) + 1];
+        bool changed = false;
         const char *n;
         int r;
 
         assert(fd >= 0);
         assert(st);
+        assert(state);
 
-        /* We change ACLs through the /proc/self/fd/%i path, so that we have a stable reference that works
-         * with O_PATH. */
-        xsprintf(procfs_path, "/proc/self/fd/%i", fd);
+        if (!state->no_acl_dev_valid || state->no_acl_dev != st->st_dev) {
+                /* We change ACLs through the /proc/self/fd/%i path, so that we have a stable reference that
+                 * works with O_PATH. */
+                xsprintf(procfs_path, "/proc/self/fd/%i", fd);
 
-        /* Drop any ACL if there is one */
-        FOREACH_STRING(n, "system.posix_acl_access", "system.posix_acl_default")
-                if (removexattr(procfs_path, n) < 0)
-                        if (!IN_SET(errno, ENODATA, EOPNOTSUPP, ENOSYS, ENOTTY))
+                /* Drop any ACL if there is one */
+                FOREACH_STRING(n, "system.posix_acl_access", "system.posix_acl_default") {
+                        if (removexattr(procfs_path, n) >= 0) {
+                                changed = true;
+                                continue;
+                        }
+
+                        if (IN_SET(errno, EOPNOTSUPP, ENOSYS, ENOTTY)) {
+                                /* No ACL support on this file system, don't bother with the other inodes
+                                 * on it. */
+                                state->no_acl_dev = st->st_dev;
+                                state->no_acl_dev_valid = true;
+                                break;
+                        }
+                        if (errno != ENODATA)
                                 return -errno;
+                }
+        }
+
+        /* Most inodes are already owned correctly when we are called again on the same tree, skip the
+         * chmod/chown (and the additional fstat() it does) for them. */
+        if (stat_ownership_ok(st, uid, gid, mask))
+                return changed;
 
         r = fchmod_and_chown(fd, st->st_mode & mask, uid, gid);
         if (r < 0)
@@ -50,7 +87,8 @@ static int chown_recursive_internal(
                 const struct stat *st,
                 uid_t uid,
                 gid_t gid,
-                mode_t mask) {
+                mode_t mask,
+                ChownState *state) {
 
         _cleanup_closedir_ DIR *d = NULL;
         bool changed = false;
@@ -59,6 +97,7 @@ static int chown_recursive_internal(
 
         assert(fd >= 0);
         assert(st);
+        assert(state);
 
         d = fdopendir(fd);
         if (!d) {
@@ -90,13 +129,13 @@ static int chown_recursive_internal(
                         if (subdir_fd < 0)
                                 return subdir_fd;
 
-                        r = chown_recursive_internal(subdir_fd, &fst, uid, gid, mask); /* takes possession of subdir_fd even on failure */
+                        r = chown_recursive_internal(subdir_fd, &fst, uid, gid, mask, state); /* takes possession of subdir_fd even on failure */
                         if (r < 0)
                                 return r;
                         if (r > 0)
                                 changed = true;
                 } else {
-                        r = chown_one(path_fd, &fst, uid, gid, mask);
+                        r = chown_one(path_fd, &fst, uid, gid, mask, state);
                         if (r < 0)
                                 return r;
                         if (r > 0)
@@ -104,7 +143,7 @@ static int chown_recursive_internal(
                 }
         }
 
-        r = chown_one(dirfd(d), st, uid, gid, mask);
+        r = chown_one(dirfd(d), st, uid, gid, mask, state);
         if (r < 0)
                 return r;
 
@@ -118,6 +157,7 @@ int path_chown_recursive(
                 mode_t mask) {
 
         _cleanup_close_ int fd = -1;
+        ChownState state = {};
         struct stat st;
 
         fd = open(path, O_RDONLY|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW|O_NOATIME);
@@ -132,12 +172,10 @@ int path_chown_recursive(
 
         /* Let's take a shortcut: if the top-level directory is properly owned, we don't descend into the
          * whole tree, under the assumption that all is OK anyway. */
-        if ((!uid_is_valid(uid) || st.st_uid == uid) &&
-            (!gid_is_valid(gid) || st.st_gid == gid) &&
-            ((st.st_mode & ~mask & 07777) == 0))
+        if (stat_ownership_ok(&st, uid, gid, mask))
                 return 0;
 
-        return chown_recursive_internal(TAKE_FD(fd), &st, uid, gid, mask); /* we donate the fd to the call, regardless if it succeeded or failed */
+        return chown_recursive_internal(TAKE_FD(fd), &st, uid, gid, mask, &state); /* we donate the fd to the call, regardless if it succeeded or failed */
 }
 
 int fd_chown_recursive(
@@ -147,6 +185,7 @@ int fd_chown_recursive(
                 mode_t mask) {
 
         int duplicated_fd = -1;
+        ChownState state = {};
         struct stat st;
 
         /* Note that the slightly different order of fstat() and the checks here and in
@@ -164,9 +203,7 @@ int fd_chown_recursive(
                 return 0; /* nothing to do */
 
         /* Shortcut, as above */
-        if ((!uid_is_valid(uid) || st.st_uid == uid) &&
-            (!gid_is_valid(gid) || st.st_gid == gid) &&
-            ((st.st_mode & ~mask & 07777) == 0))
+        if (stat_ownership_ok(&st, uid, gid, mask))
                 return 0;
 
         /* Let's duplicate the fd here, as opendir() wants to take possession of it and close it afterwards */
@@ -174,5 +211,5 @@ int fd_chown_recursive(
         if (duplicated_fd < 0)
                 return -errno;
 
-        return chown_recursive_internal(duplicated_fd, &st, uid, gid, mask); /* fd donated even on failure */
+        return chown_recursive_internal(duplicated_fd, &st, uid, gid, mask, &state); /* fd donated even on failure */
 }
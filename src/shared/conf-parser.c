@@ -270,6 +270,7 @@ int config_parse(
         _cleanup_fclose_ FILE *ours = NULL;
         unsigned line = 0, section_line = 0;
         bool section_ignored = false, bom_seen = false;
+        ReadLineFlags read_flags;
         int r, fd;
         usec_t mtime;
 
@@ -301,15 +302,20 @@ int config_parse(
 
                 (void) stat_warn_permissions(filename, &st);
                 mtime = timespec_load(&st.st_mtim);
-        } else
+
+                /* Determine this once, instead of letting read_line() call isatty() for every line */
+                read_flags = S_ISCHR(st.st_mode) && isatty(fd) ? READ_LINE_IS_A_TTY : READ_LINE_NOT_A_TTY;
+        } else {
                 mtime = 0;
+                read_flags = READ_LINE_NOT_A_TTY;
+        }
 
         for (;;) {
                 _cleanup_free_ char *buf = NULL;
                 bool escaped = false;
                 char *l, *p, *e;
 
-                r = read_line(f, LONG_LINE_MAX, &buf);
+                r = read_line_full(f, LONG_LINE_MAX, read_flags, &buf);
                 if (r == 0)
                         break;
                 if (r == -ENOBUFS) {
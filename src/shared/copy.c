@@ -105,6 +105,76 @@ static int look_for_signals(CopyFlags copy_flags) {
         return 0;
 }
 
+static int create_hole(int fd, off_t size) {
+        off_t offset, end;
+
+        /* Skips over 'size' bytes in the output file, turning them into a hole. */
+
+        offset = lseek(fd, 0, SEEK_CUR);
+        if (offset < 0)
+                return -errno;
+
+        end = lseek(fd, 0, SEEK_END);
+        if (end < 0)
+                return -errno;
+
+        /* If there's existing data in the range, punch a hole into it */
+        if (offset < end &&
+            fallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, offset, MIN(size, end - offset)) < 0)
+                return -errno;
+
+        /* If the hole reaches beyond the end of the file, extend it, so that trailing holes are not lost */
+        if (offset + size > end &&
+            ftruncate(fd, offset + size) < 0)
+                return -errno;
+
+        if (lseek(fd, offset + size, SEEK_SET) < 0)
+                return -errno;
+
+        return 0;
+}
+
+static int seek_data_segment(int fd, uint64_t *ret_hole, uint64_t *ret_data) {
+        off_t c, d, h;
+
+        assert(ret_hole);
+        assert(ret_data);
+
+        /* Determines the size of the hole at the current file offset (which is zero if we are on data) and
+         * the size of the data segment following it. Leaves the file offset at the beginning of the data
+         * segment. Returns 0 if there's no data left, 1 otherwise. */
+
+        c = lseek(fd, 0, SEEK_CUR);
+        if (c < 0)
+                return -errno;
+
+        d = lseek(fd, c, SEEK_DATA);
+        if (d < 0) {
+                if (errno != ENXIO)
+                        return -errno;
+
+                /* Only a hole (or nothing) left until the end of the file */
+                d = lseek(fd, 0, SEEK_END);
+                if (d < 0)
+                        return -errno;
+
+                *ret_hole = d > c ? (uint64_t) (d - c) : 0;
+                *ret_data = 0;
+                return 0;
+        }
+
+        h = lseek(fd, d, SEEK_HOLE);
+        if (h < 0)
+                return -errno;
+
+        if (lseek(fd, d, SEEK_SET) < 0)
+                return -errno;
+
+        *ret_hole = d - c;
+        *ret_data = h - d;
+        return 1;
+}
+
 int copy_bytes_full(
                 int fdf, int fdt,
                 uint64_t max_bytes,
@@ -134,6 +204,19 @@ int copy_bytes_full(
         if (ret_remains_size)
                 *ret_remains_size = 0;
 
+        /* Holes can only be found and recreated between regular files */
+        if (FLAGS_SET(copy_flags, COPY_HOLES)) {
+                struct stat a, b;
+
+                if (fstat(fdf, &a) < 0)
+                        return -errno;
+                if (fstat(fdt, &b) < 0)
+                        return -errno;
+
+                if (!S_ISREG(a.st_mode) || !S_ISREG(b.st_mode))
+                        copy_flags &= ~COPY_HOLES;
+        }
+
         /* Try btrfs reflinks first. This only works on regular, seekable files, hence let's check the file offsets of
          * source and destination first. */
         if ((copy_flags & COPY_REFLINK)) {
@@ -197,6 +280,41 @@ int copy_bytes_full(
                 if (r < 0)
                         return r;
 
+                if (FLAGS_SET(copy_flags, COPY_HOLES)) {
+                        uint64_t hole, data;
+                        int more;
+
+                        more = seek_data_segment(fdf, &hole, &data);
+                        if (more < 0)
+                                return more;
+
+                        if (hole > 0) {
+                                hole = MIN(hole, max_bytes);
+
+                                r = create_hole(fdt, hole);
+                                if (r < 0)
+                                        return r;
+
+                                if (max_bytes != UINT64_MAX)
+                                        max_bytes -= hole;
+
+                                if (progress) {
+                                        r = progress(hole, userdata);
+                                        if (r < 0)
+                                                return r;
+                                }
+
+                                if (max_bytes <= 0)
+                                        return 1;
+                        }
+
+                        if (more == 0)
+                                break;
+
+                        /* Don't read beyond the data segment, so that the next iteration finds the next hole */
+                        m = MIN(data, (uint64_t) SSIZE_MAX);
+                }
+
                 if (max_bytes != UINT64_MAX && m > max_bytes)
                         m = max_bytes;
 
@@ -639,7 +757,11 @@ static int fd_copy_regular(
         if (fdt < 0)
                 return -errno;
 
-        r = copy_bytes_full(fdf, fdt, UINT64_MAX, copy_flags, NULL, NULL, progress, userdata);
+        /* When reflinking isn't possible (e.g. because the tree is copied across file systems), at least keep
+         * sparse files sparse, instead of filling the holes with zeroes on the target. */
+        r = copy_bytes_full(fdf, fdt, UINT64_MAX,
+                            FLAGS_SET(copy_flags, COPY_REFLINK) ? copy_flags|COPY_HOLES : copy_flags,
+                            NULL, NULL, progress, userdata);
         if (r < 0)
                 goto fail;
 
@@ -23,6 +23,7 @@ typedef enum CopyFlags {
         COPY_FSYNC       = 1 << 10, /* fsync() after we are done */
         COPY_FSYNC_FULL  = 1 << 11, /* fsync_full() after we are done */
         COPY_SYNCFS      = 1 << 12, /* syncfs() the *top-level* dir after we are done */
+        COPY_HOLES       = 1 << 13, /* Copy holes of regular files as holes, rather than as zeroes */
 } CopyFlags;
 
 typedef int (*copy_progress_bytes_t)(uint64_t n_bytes, void *userdata);
@@ -1117,6 +1117,143 @@ int image_set_limit(Image *i, uint64_t referenced_max) {
         return btrfs_subvol_set_subtree_quota_limit(i->path, 0, referenced_max);
 }
 
+/* Reading the metadata of a disk image requires setting up a loopback device and dissecting and mounting the
+ * file systems in it. Hence, remember what we found for the regular image files we looked at, and reuse it as
+ * long as the file is still the same inode and wasn't modified since. */
+#define IMAGE_METADATA_CACHE_MAX 64U
+
+typedef struct ImageMetadata {
+        char *path;
+        dev_t devnum;
+        ino_t inode;
+        off_t size;
+        nsec_t mtime;
+
+        char *hostname;
+        sd_id128_t machine_id;
+        char **machine_info;
+        char **os_release;
+        char **extension_release;
+} ImageMetadata;
+
+static ImageMetadata* image_metadata_free(ImageMetadata *m) {
+        if (!m)
+                return NULL;
+
+        free(m->path);
+        free(m->hostname);
+        strv_free(m->machine_info);
+        strv_free(m->os_release);
+        strv_free(m->extension_release);
+
+        return mfree(m);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(ImageMetadata*, image_metadata_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(image_metadata_hash_ops, char, string_hash_func, string_compare_func,
+                                              ImageMetadata, image_metadata_free);
+
+static Hashmap *image_metadata_cache = NULL;
+
+static bool image_metadata_matches(const ImageMetadata *m, const struct stat *st) {
+        assert(m);
+        assert(st);
+
+        return m->devnum == st->st_dev &&
+                m->inode == st->st_ino &&
+                m->size == st->st_size &&
+                m->mtime == timespec_load_nsec(&st->st_mtim);
+}
+
+static int image_set_metadata(
+                Image *i,
+                const char *hostname,
+                sd_id128_t machine_id,
+                char **machine_info,
+                char **os_release,
+                char **extension_release) {
+
+        _cleanup_strv_free_ char **mi = NULL, **osr = NULL, **er = NULL;
+        _cleanup_free_ char *hn = NULL;
+
+        assert(i);
+
+        if (hostname) {
+                hn = strdup(hostname);
+                if (!hn)
+                        return -ENOMEM;
+        }
+
+        if (machine_info) {
+                mi = strv_copy(machine_info);
+                if (!mi)
+                        return -ENOMEM;
+        }
+
+        if (os_release) {
+                osr = strv_copy(os_release);
+                if (!osr)
+                        return -ENOMEM;
+        }
+
+        if (extension_release) {
+                er = strv_copy(extension_release);
+                if (!er)
+                        return -ENOMEM;
+        }
+
+        free_and_replace(i->hostname, hn);
+        i->machine_id = machine_id;
+        strv_free_and_replace(i->machine_info, mi);
+        strv_free_and_replace(i->os_release, osr);
+        strv_free_and_replace(i->extension_release, er);
+
+        return 0;
+}
+
+static void image_metadata_remember(const Image *i, const struct stat *st) {
+        _cleanup_(image_metadata_freep) ImageMetadata *m = NULL;
+
+        assert(i);
+        assert(st);
+
+        /* This is just an optimization, hence failures are ignored */
+
+        m = new(ImageMetadata, 1);
+        if (!m)
+                return;
+
+        *m = (ImageMetadata) {
+                .devnum = st->st_dev,
+                .inode = st->st_ino,
+                .size = st->st_size,
+                .mtime = timespec_load_nsec(&st->st_mtim),
+                .machine_id = i->machine_id,
+        };
+
+        m->path = strdup(i->path);
+        if (!m->path)
+                return;
+
+        if (i->hostname && !(m->hostname = strdup(i->hostname)))
+                return;
+        if (i->machine_info && !(m->machine_info = strv_copy(i->machine_info)))
+                return;
+        if (i->os_release && !(m->os_release = strv_copy(i->os_release)))
+                return;
+        if (i->extension_release && !(m->extension_release = strv_copy(i->extension_release)))
+                return;
+
+        image_metadata_free(hashmap_remove(image_metadata_cache, i->path));
+
+        if (hashmap_size(image_metadata_cache) >= IMAGE_METADATA_CACHE_MAX)
+                hashmap_clear(image_metadata_cache);
+
+        if (hashmap_ensure_put(&image_metadata_cache, &image_metadata_hash_ops, m->path, m) >= 0)
+                TAKE_PTR(m);
+}
+
 int image_read_metadata(Image *i) {
         _cleanup_(release_lock_file) LockFile global_lock = LOCK_FILE_INIT, local_lock = LOCK_FILE_INIT;
         int r;
@@ -1195,6 +1332,29 @@ int image_read_metadata(Image *i) {
         case IMAGE_BLOCK: {
                 _cleanup_(loop_device_unrefp) LoopDevice *d = NULL;
                 _cleanup_(dissected_image_unrefp) DissectedImage *m = NULL;
+                struct stat st;
+                bool cacheable;
+
+                /* Block devices may change their contents without the inode noticing, hence only cache
+                 * metadata of regular files */
+                cacheable = i->type == IMAGE_RAW && stat(i->path, &st) >= 0 && S_ISREG(st.st_mode);
+                if (cacheable) {
+                        ImageMetadata *cached;
+
+                        cached = hashmap_get(image_metadata_cache, i->path);
+                        if (cached && image_metadata_matches(cached, &st)) {
+                                r = image_set_metadata(i,
+                                                       cached->hostname,
+                                                       cached->machine_id,
+                                                       cached->machine_info,
+                                                       cached->os_release,
+                                                       cached->extension_release);
+                                if (r < 0)
+                                        return r;
+
+                                break;
+                        }
+                }
 
                 r = loop_device_make_by_path(i->path, O_RDONLY, LO_FLAGS_PARTSCAN, &d);
                 if (r < 0)
@@ -1224,6 +1384,9 @@ int image_read_metadata(Image *i) {
                 strv_free_and_replace(i->os_release, m->os_release);
                 strv_free_and_replace(i->extension_release, m->extension_release);
 
+                if (cacheable)
+                        image_metadata_remember(i, &st);
+
                 break;
         }
 
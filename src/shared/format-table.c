@@ -2251,8 +2251,8 @@ int table_print(Table *t, FILE *f) {
                                 _cleanup_free_ char *buffer = NULL, *extracted = NULL;
                                 bool lines_truncated = false;
                                 const char *field, *color = NULL;
+                                size_t l, lpad = 0, rpad = 0;
                                 TableData *d;
-                                size_t l;
 
                                 assert_se(d = row[t->display_map ? t->display_map[j] : j]);
 
@@ -2307,20 +2307,32 @@ int table_print(Table *t, FILE *f) {
 
                                         if (l < width[j]) {
                                                 _cleanup_free_ char *aligned = NULL;
-                                                /* Field is shorter than allocated space. Let's align with spaces */
+                                                bool strip;
 
-                                                aligned = align_string_mem(field, d->url, width[j], d->align_percent);
-                                                if (!aligned)
-                                                        return -ENOMEM;
+                                                /* Field is shorter than allocated space. Let's align with spaces */
 
                                                 /* Drop trailing white spaces of last column when no cosmetics is set. */
-                                                if (j == display_columns - 1 &&
-                                                    (!colors_enabled() || (!table_data_color(d) && row != t->data)) &&
-                                                    (!urlify_enabled() || !d->url))
-                                                        delete_trailing_chars(aligned, NULL);
-
-                                                free_and_replace(buffer, aligned);
-                                                field = buffer;
+                                                strip = j == display_columns - 1 &&
+                                                        (!colors_enabled() || (!table_data_color(d) && row != t->data)) &&
+                                                        (!urlify_enabled() || !d->url);
+
+                                                if (!strip && !d->url) {
+                                                        /* The common case: just write out the padding around the
+                                                         * field below, instead of allocating an aligned copy of it
+                                                         * for every cell. */
+                                                        lpad = (width[j] - l) * d->align_percent / 100U;
+                                                        rpad = width[j] - l - lpad;
+                                                } else {
+                                                        aligned = align_string_mem(field, d->url, width[j], d->align_percent);
+                                                        if (!aligned)
+                                                                return -ENOMEM;
+
+                                                        if (strip)
+                                                                delete_trailing_chars(aligned, NULL);
+
+                                                        free_and_replace(buffer, aligned);
+                                                        field = buffer;
+                                                }
                                         }
                                 }
 
@@ -2358,7 +2370,7 @@ int table_print(Table *t, FILE *f) {
                                                 fputs(ansi_underline(), f);
                                 }
 
-                                fputs(field, f);
+                                fprintf(f, "%*s%s%*s", (int) lpad, "", field, (int) rpad, "");
 
                                 if (colors_enabled() && (color || row == t->data))
                                         fputs(ANSI_NORMAL, f);
@@ -18,6 +18,7 @@
 #include "special.h"
 #include "specifier.h"
 #include "string-util.h"
+#include "strv.h"
 #include "time-util.h"
 #include "unit-name.h"
 #include "util.h"
@@ -736,6 +737,30 @@ int generator_write_veritysetup_service_section(
         return 0;
 }
 
+int generator_declare_inputs(char * const *paths) {
+        _cleanup_free_ char *p = NULL, *contents = NULL;
+        const char *e;
+        int r;
+
+        e = getenv("SYSTEMD_GENERATOR_INPUTS_DIR");
+        if (!e)
+                return 0;
+
+        p = path_join(e, program_invocation_short_name);
+        if (!p)
+                return log_oom();
+
+        contents = strv_join(paths, "\n");
+        if (!contents)
+                return log_oom();
+
+        r = write_string_file(p, contents, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to write %s, ignoring: %m", p);
+
+        return 0;
+}
+
 void log_setup_generator(void) {
         /* Disable talking to syslog/journal (i.e. the two IPC-based loggers) if we run in system context. */
         if (cg_pid_get_owner_uid(0, NULL) == -ENXIO /* not running in a per-user slice */)
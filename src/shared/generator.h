@@ -81,6 +81,11 @@ int generator_enable_remount_fs_service(const char *dir);
 
 void log_setup_generator(void);
 
+/* Tells the service manager which files the output of the generator depends on, besides the kernel command
+ * line and the environment. If none of the files changed, the service manager doesn't run the generators
+ * again on daemon-reload. */
+int generator_declare_inputs(char * const *paths);
+
 /* Similar to DEFINE_MAIN_FUNCTION, but initializes logging and assigns positional arguments. */
 #define DEFINE_MAIN_GENERATOR_FUNCTION(impl)                            \
         _DEFINE_MAIN_FUNCTION(                                          \
@@ -76,19 +76,31 @@ static int trie_children_cmp(const struct trie_child_entry *a, const struct trie
 }
 
 static int node_add_child(struct trie *trie, struct trie_node *node, struct trie_node *node_child, uint8_t c) {
-        struct trie_child_entry *child;
+        size_t left = 0, right;
 
-        /* extend array, add new entry, sort for bisection */
-        child = reallocarray(node->children, node->children_count + 1, sizeof(struct trie_child_entry));
-        if (!child)
+        /* extend array, insert new entry at its position to keep the array sorted for bisection */
+        if (!GREEDY_REALLOC(node->children, node->children_count + 1))
                 return -ENOMEM;
 
-        node->children = child;
-        trie->children_count++;
-        node->children[node->children_count].c = c;
-        node->children[node->children_count].child = node_child;
+        right = node->children_count;
+        while (left < right) {
+                size_t middle = (left + right) / 2;
+
+                if (node->children[middle].c < c)
+                        left = middle + 1;
+                else
+                        right = middle;
+        }
+
+        memmove(node->children + left + 1, node->children + left,
+                sizeof(struct trie_child_entry) * (node->children_count - left));
+        node->children[left] = (struct trie_child_entry) {
+                .c = c,
+                .child = node_child,
+        };
         node->children_count++;
-        typesafe_qsort(node->children, node->children_count, trie_children_cmp);
+
+        trie->children_count++;
         trie->nodes_count++;
 
         return 0;
@@ -137,6 +149,7 @@ static int trie_node_add_value(struct trie *trie, struct trie_node *node,
                                const char *filename, uint16_t file_priority, uint32_t line_number, bool compat) {
         ssize_t k, v, fn = 0;
         struct trie_value_entry *val;
+        size_t left = 0, right;
 
         k = strbuf_add_string(trie->strings, key, strlen(key));
         if (k < 0)
@@ -169,13 +182,23 @@ static int trie_node_add_value(struct trie *trie, struct trie_node *node,
                 }
         }
 
-        /* extend array, add new entry, sort for bisection */
-        val = reallocarray(node->values, node->values_count + 1, sizeof(struct trie_value_entry));
-        if (!val)
+        /* extend array, insert new entry at its position to keep the array sorted for bisection */
+        if (!GREEDY_REALLOC(node->values, node->values_count + 1))
                 return -ENOMEM;
-        trie->values_count++;
-        node->values = val;
-        node->values[node->values_count] = (struct trie_value_entry) {
+
+        right = node->values_count;
+        while (left < right) {
+                size_t middle = (left + right) / 2;
+
+                if (strcmp(trie->strings->buf + node->values[middle].key_off, key) < 0)
+                        left = middle + 1;
+                else
+                        right = middle;
+        }
+
+        memmove(node->values + left + 1, node->values + left,
+                sizeof(struct trie_value_entry) * (node->values_count - left));
+        node->values[left] = (struct trie_value_entry) {
                 .key_off = k,
                 .value_off = v,
                 .filename_off = fn,
@@ -183,7 +206,8 @@ static int trie_node_add_value(struct trie *trie, struct trie_node *node,
                 .line_number = line_number,
         };
         node->values_count++;
-        typesafe_qsort_r(node->values, node->values_count, trie_values_cmp, trie);
+
+        trie->values_count++;
         return 0;
 }
 
@@ -19,6 +19,7 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
+#include "glob-util.h"
 #include "hashmap.h"
 #include "install-printf.h"
 #include "install.h"
@@ -87,6 +88,10 @@ void unit_file_presets_freep(UnitFilePresets *p) {
 
         free(p->rules);
         p->n_rules = 0;
+
+        p->literal_rules = hashmap_free(p->literal_rules);
+        p->other_rules = mfree(p->other_rules);
+        p->n_other_rules = 0;
 }
 
 static const char *const unit_file_type_table[_UNIT_FILE_TYPE_MAX] = {
@@ -718,6 +723,61 @@ static int is_symlink_with_known_name(const UnitFileInstallInfo *i, const char *
         return false;
 }
 
+static int symlink_destination(
+                DIR *dir,
+                const char *dir_path,
+                const char *name,
+                Hashmap **cache,
+                const char **ret) {
+
+        _cleanup_free_ char *path = NULL, *dest = NULL;
+        const char *cached;
+        int r;
+
+        assert(dir);
+        assert(dir_path);
+        assert(name);
+        assert(cache);
+        assert(ret);
+
+        /* Returns the absolute destination of the specified symlink. When the states of many units are
+         * determined in one go the same symlinks are looked at over and over again, hence remember the
+         * results. */
+
+        path = path_join(dir_path, name);
+        if (!path)
+                return -ENOMEM;
+
+        cached = hashmap_get(*cache, path);
+        if (cached) {
+                *ret = cached;
+                return 0;
+        }
+
+        r = readlinkat_malloc(dirfd(dir), name, &dest);
+        if (r < 0)
+                return r;
+
+        /* Make absolute */
+        if (!path_is_absolute(dest)) {
+                char *x;
+
+                x = path_join(dir_path, dest);
+                if (!x)
+                        return -ENOMEM;
+
+                free_and_replace(dest, x);
+        }
+
+        r = hashmap_ensure_put(cache, &string_hash_ops_free_free, path, dest);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(path);
+        *ret = TAKE_PTR(dest);
+        return 0;
+}
+
 static int find_symlinks_in_directory(
                 DIR *dir,
                 const char *dir_path,
@@ -726,21 +786,24 @@ static int find_symlinks_in_directory(
                 bool match_aliases,
                 bool ignore_same_name,
                 const char *config_path,
+                Hashmap **symlink_cache,
                 bool *same_name_link) {
 
         struct dirent *de;
         int r = 0;
 
         FOREACH_DIRENT(de, dir, return -errno) {
-                _cleanup_free_ char *dest = NULL;
                 bool found_path = false, found_dest, b = false;
+                const char *dest;
                 int q;
 
                 if (de->d_type != DT_LNK)
                         continue;
 
                 /* Acquire symlink destination */
-                q = readlinkat_malloc(dirfd(dir), de->d_name, &dest);
+                q = symlink_destination(dir, dir_path, de->d_name, symlink_cache, &dest);
+                if (q == -ENOMEM)
+                        return q;
                 if (q == -ENOENT)
                         continue;
                 if (q < 0) {
@@ -749,17 +812,6 @@ static int find_symlinks_in_directory(
                         continue;
                 }
 
-                /* Make absolute */
-                if (!path_is_absolute(dest)) {
-                        char *x;
-
-                        x = path_join(dir_path, dest);
-                        if (!x)
-                                return -ENOMEM;
-
-                        free_and_replace(dest, x);
-                }
-
                 assert(unit_name_is_valid(i->name, UNIT_NAME_ANY));
                 if (!ignore_same_name)
                                /* Check if the symlink itself matches what we are looking for.
@@ -810,6 +862,7 @@ static int find_symlinks(
                 bool match_name,
                 bool ignore_same_name,
                 const char *config_path,
+                Hashmap **symlink_cache,
                 bool *same_name_link) {
 
         _cleanup_closedir_ DIR *config_dir = NULL;
@@ -849,7 +902,7 @@ static int find_symlinks(
                         continue;
                 }
 
-                r = find_symlinks_in_directory(d, path, root_dir, i, match_name, ignore_same_name, config_path, same_name_link);
+                r = find_symlinks_in_directory(d, path, root_dir, i, match_name, ignore_same_name, config_path, symlink_cache, same_name_link);
                 if (r > 0)
                         return 1;
                 else if (r < 0)
@@ -858,7 +911,7 @@ static int find_symlinks(
 
         /* We didn't find any suitable symlinks in .wants or .requires directories, let's look for linked unit files in this directory. */
         rewinddir(config_dir);
-        return find_symlinks_in_directory(config_dir, config_path, root_dir, i, match_name, ignore_same_name, config_path, same_name_link);
+        return find_symlinks_in_directory(config_dir, config_path, root_dir, i, match_name, ignore_same_name, config_path, symlink_cache, same_name_link);
 }
 
 static int find_symlinks_in_scope(
@@ -866,6 +919,7 @@ static int find_symlinks_in_scope(
                 const LookupPaths *paths,
                 const UnitFileInstallInfo *i,
                 bool match_name,
+                Hashmap **symlink_cache,
                 UnitFileState *state) {
 
         bool same_name_link_runtime = false, same_name_link_config = false;
@@ -884,7 +938,7 @@ static int find_symlinks_in_scope(
         STRV_FOREACH(p, paths->search_path)  {
                 bool same_name_link = false;
 
-                r = find_symlinks(paths->root_dir, i, match_name, ignore_same_name, *p, &same_name_link);
+                r = find_symlinks(paths->root_dir, i, match_name, ignore_same_name, *p, symlink_cache, &same_name_link);
                 if (r < 0)
                         return r;
                 if (r > 0) {
@@ -2806,10 +2860,11 @@ int unit_file_get_default(
         return 0;
 }
 
-int unit_file_lookup_state(
+static int unit_file_lookup_state_full(
                 UnitFileScope scope,
                 const LookupPaths *paths,
                 const char *name,
+                Hashmap **symlink_cache,
                 UnitFileState *ret) {
 
         _cleanup_(install_context_done) InstallContext c = {};
@@ -2819,6 +2874,7 @@ int unit_file_lookup_state(
 
         assert(paths);
         assert(name);
+        assert(symlink_cache);
 
         if (!unit_name_is_valid(name, UNIT_NAME_ANY))
                 return -EINVAL;
@@ -2872,7 +2928,7 @@ int unit_file_lookup_state(
                 /* Check if any of the Alias= symlinks have been created.
                  * We ignore other aliases, and only check those that would
                  * be created by systemctl enable for this unit. */
-                r = find_symlinks_in_scope(scope, paths, i, true, &state);
+                r = find_symlinks_in_scope(scope, paths, i, true, symlink_cache, &state);
                 if (r < 0)
                         return r;
                 if (r > 0)
@@ -2880,7 +2936,7 @@ int unit_file_lookup_state(
 
                 /* Check if the file is known under other names. If it is,
                  * it might be in use. Report that as UNIT_FILE_INDIRECT. */
-                r = find_symlinks_in_scope(scope, paths, i, false, &state);
+                r = find_symlinks_in_scope(scope, paths, i, false, symlink_cache, &state);
                 if (r < 0)
                         return r;
                 if (r > 0)
@@ -2904,6 +2960,17 @@ int unit_file_lookup_state(
         return 0;
 }
 
+int unit_file_lookup_state(
+                UnitFileScope scope,
+                const LookupPaths *paths,
+                const char *name,
+                UnitFileState *ret) {
+
+        _cleanup_hashmap_free_ Hashmap *symlink_cache = NULL;
+
+        return unit_file_lookup_state_full(scope, paths, name, &symlink_cache, ret);
+}
+
 int unit_file_get_state(
                 UnitFileScope scope,
                 const char *root_dir,
@@ -2994,6 +3061,35 @@ static int presets_find_config(UnitFileScope scope, const char *root_dir, char *
         return conf_files_list_strv(files, ".preset", root_dir, 0, dirs);
 }
 
+static int presets_build_index(UnitFilePresets *ps) {
+        int r;
+
+        assert(ps);
+
+        /* Most preset rules name a unit literally. Put those in a hash table, so that a query only needs to
+         * go through the rules with globs (and those with instances, which match differently). Since the
+         * first matching rule wins, we only index the first rule for each literal name. */
+
+        for (size_t i = 0; i < ps->n_rules; i++) {
+                const UnitFilePresetRule *rule = ps->rules + i;
+
+                if (!rule->instances && !string_is_glob(rule->pattern)) {
+                        r = hashmap_ensure_put(&ps->literal_rules, &string_hash_ops, rule->pattern, SIZE_TO_PTR(i + 1));
+                        if (r < 0 && r != -EEXIST)
+                                return r;
+
+                        continue;
+                }
+
+                if (!GREEDY_REALLOC(ps->other_rules, ps->n_other_rules + 1))
+                        return -ENOMEM;
+
+                ps->other_rules[ps->n_other_rules++] = i;
+        }
+
+        return 0;
+}
+
 static int read_presets(UnitFileScope scope, const char *root_dir, UnitFilePresets *presets) {
         _cleanup_(unit_file_presets_freep) UnitFilePresets ps = {};
         _cleanup_strv_free_ char **files = NULL;
@@ -3085,6 +3181,10 @@ static int read_presets(UnitFileScope scope, const char *root_dir, UnitFilePrese
                 }
         }
 
+        r = presets_build_index(&ps);
+        if (r < 0)
+                return r;
+
         ps.initialized = true;
         *presets = ps;
         ps = (UnitFilePresets){};
@@ -3146,16 +3246,30 @@ static int pattern_match_multiple_instances(
 
 static int query_presets(const char *name, const UnitFilePresets *presets, char ***instance_name_list) {
         PresetAction action = PRESET_UNKNOWN;
+        size_t match = SIZE_MAX;
+        void *p;
 
         if (!unit_name_is_valid(name, UNIT_NAME_ANY))
                 return -EINVAL;
 
-        for (size_t i = 0; i < presets->n_rules; i++)
+        /* Find the first rule that matches: the literal rule for this name if there is one, unless one of the
+         * other rules before it matches too. */
+        p = hashmap_get(presets->literal_rules, name);
+        if (p)
+                match = PTR_TO_SIZE(p) - 1;
+
+        for (size_t j = 0; j < presets->n_other_rules && presets->other_rules[j] < match; j++) {
+                size_t i = presets->other_rules[j];
+
                 if (pattern_match_multiple_instances(presets->rules[i], name, instance_name_list) > 0 ||
                     fnmatch(presets->rules[i].pattern, name, FNM_NOESCAPE) == 0) {
-                        action = presets->rules[i].action;
+                        match = i;
                         break;
                 }
+        }
+
+        if (match != SIZE_MAX)
+                action = presets->rules[match].action;
 
         switch (action) {
         case PRESET_UNKNOWN:
@@ -3420,6 +3534,7 @@ int unit_file_get_list(
                 char **patterns) {
 
         _cleanup_(lookup_paths_free) LookupPaths paths = {};
+        _cleanup_hashmap_free_ Hashmap *symlink_cache = NULL;
         char **dirname;
         int r;
 
@@ -3470,7 +3585,7 @@ int unit_file_get_list(
                         if (!f->path)
                                 return -ENOMEM;
 
-                        r = unit_file_lookup_state(scope, &paths, de->d_name, &f->state);
+                        r = unit_file_lookup_state_full(scope, &paths, de->d_name, &symlink_cache, &f->state);
                         if (r < 0)
                                 f->state = UNIT_FILE_BAD;
 
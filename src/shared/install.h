@@ -200,6 +200,13 @@ typedef struct UnitFilePresetRule UnitFilePresetRule;
 typedef struct {
         UnitFilePresetRule *rules;
         size_t n_rules;
+
+        /* Index for quicker matching: rules with literal patterns by name (only the first one for each name,
+         * pointing to the rule index + 1), and the indexes of all other rules in ascending order. */
+        Hashmap *literal_rules;
+        size_t *other_rules;
+        size_t n_other_rules;
+
         bool initialized;
 } UnitFilePresets;
 
@@ -0,0 +1,596 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "compress.h"
+#include "journal-batch.h"
+#include "journal-file.h"
+#include "journal-importer.h"
+#include "memory-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "unaligned.h"
+
+/* Don't bother compressing tiny frames */
+#define JOURNAL_BATCH_COMPRESS_THRESHOLD 512U
+
+struct JournalBatchField {
+        const char *name;
+        size_t name_len;
+        const uint8_t *value;
+        size_t value_len;
+};
+
+void journal_batch_encoder_done(JournalBatchEncoder *e) {
+        assert(e);
+
+        e->names = hashmap_free(e->names);
+        e->payload = mfree(e->payload);
+        e->payload_size = 0;
+}
+
+void journal_batch_encoder_reset(JournalBatchEncoder *e) {
+        assert(e);
+
+        /* Start a new stream: the receiver knows no field names and no boot ID yet */
+        hashmap_clear(e->names);
+        e->n_names = 0;
+        e->payload_size = 0;
+        e->n_entries = 0;
+        e->boot_id = SD_ID128_NULL;
+}
+
+static int encoder_put(JournalBatchEncoder *e, const void *data, size_t size) {
+        assert(e);
+
+        if (!GREEDY_REALLOC(e->payload, e->payload_size + size))
+                return -ENOMEM;
+
+        memcpy_safe(e->payload + e->payload_size, data, size);
+        e->payload_size += size;
+
+        return 0;
+}
+
+static int encoder_put_varint(JournalBatchEncoder *e, uint64_t v) {
+        uint8_t buf[10];
+        size_t n = 0;
+
+        do {
+                buf[n] = v & 0x7f;
+                v >>= 7;
+                if (v > 0)
+                        buf[n] |= 0x80;
+                n++;
+        } while (v > 0);
+
+        return encoder_put(e, buf, n);
+}
+
+static int encoder_put_blob(JournalBatchEncoder *e, const void *data, size_t size) {
+        int r;
+
+        r = encoder_put_varint(e, size);
+        if (r < 0)
+                return r;
+
+        return encoder_put(e, data, size);
+}
+
+int journal_batch_encoder_begin_entry(
+                JournalBatchEncoder *e,
+                uint64_t realtime,
+                uint64_t monotonic,
+                sd_id128_t boot_id) {
+
+        uint8_t flags = 0;
+        int r;
+
+        assert(e);
+
+        r = encoder_put_varint(e, realtime);
+        if (r < 0)
+                return r;
+
+        r = encoder_put_varint(e, monotonic);
+        if (r < 0)
+                return r;
+
+        if (!sd_id128_equal(boot_id, e->boot_id))
+                flags |= JOURNAL_BATCH_ENTRY_BOOT_ID;
+
+        r = encoder_put(e, &flags, sizeof(flags));
+        if (r < 0)
+                return r;
+
+        if (flags & JOURNAL_BATCH_ENTRY_BOOT_ID) {
+                r = encoder_put(e, boot_id.bytes, sizeof(boot_id.bytes));
+                if (r < 0)
+                        return r;
+
+                e->boot_id = boot_id;
+        }
+
+        return 0;
+}
+
+int journal_batch_encoder_add_field(JournalBatchEncoder *e, const void *data, size_t size) {
+        const char *eq;
+        size_t l;
+        int r;
+
+        assert(e);
+        assert(data || size == 0);
+
+        eq = memchr(data, '=', size);
+        if (!eq || eq == data)
+                return -EINVAL;
+
+        l = eq - (const char*) data;
+
+        /* Only valid field names are interned, anything else is passed on literally and left to the
+         * receiver to deal with */
+        if (journal_field_valid(data, l, true)) {
+                _cleanup_free_ char *name = NULL;
+                unsigned idx;
+
+                name = strndup(data, l);
+                if (!name)
+                        return -ENOMEM;
+
+                idx = PTR_TO_UINT(hashmap_get(e->names, name));
+                if (idx > 0)
+                        r = encoder_put_varint(e, 2 + idx - 1);
+                else if (e->n_names < JOURNAL_BATCH_NAMES_MAX) {
+                        r = hashmap_ensure_put(&e->names, &string_hash_ops_free, name, UINT_TO_PTR(e->n_names + 1));
+                        if (r < 0)
+                                return r;
+                        TAKE_PTR(name);
+
+                        r = encoder_put_varint(e, 2 + e->n_names);
+                        if (r < 0)
+                                return r;
+
+                        e->n_names++;
+
+                        r = encoder_put_blob(e, data, l);
+                } else {
+                        r = encoder_put_varint(e, 1);
+                        if (r < 0)
+                                return r;
+
+                        r = encoder_put_blob(e, data, l);
+                }
+        } else {
+                r = encoder_put_varint(e, 1);
+                if (r < 0)
+                        return r;
+
+                r = encoder_put_blob(e, data, l);
+        }
+        if (r < 0)
+                return r;
+
+        return encoder_put_blob(e, eq + 1, size - l - 1);
+}
+
+int journal_batch_encoder_end_entry(JournalBatchEncoder *e) {
+        int r;
+
+        assert(e);
+
+        r = encoder_put_varint(e, 0);
+        if (r < 0)
+                return r;
+
+        e->n_entries++;
+        return 0;
+}
+
+int journal_batch_encoder_finish(JournalBatchEncoder *e, void **ret, size_t *ret_size) {
+        _cleanup_free_ uint8_t *frame = NULL;
+        size_t size = 0;
+        int compression = 0;
+
+        assert(e);
+        assert(e->n_entries > 0);
+        assert(ret);
+        assert(ret_size);
+
+        frame = malloc(JOURNAL_BATCH_FRAME_HEADER_SIZE + e->payload_size);
+        if (!frame)
+                return -ENOMEM;
+
+        if (e->compress && e->payload_size >= JOURNAL_BATCH_COMPRESS_THRESHOLD) {
+                int r;
+
+                /* Only use the compressed payload if it is actually smaller */
+                r = compress_blob(e->payload, e->payload_size,
+                                  frame + JOURNAL_BATCH_FRAME_HEADER_SIZE, e->payload_size - 1, &size);
+                if (r > 0)
+                        compression = r;
+                else
+                        log_debug_errno(r, "Failed to compress batch of %zu bytes, sending it uncompressed: %m",
+                                        e->payload_size);
+        }
+
+        if (compression == 0) {
+                memcpy(frame + JOURNAL_BATCH_FRAME_HEADER_SIZE, e->payload, e->payload_size);
+                size = e->payload_size;
+        }
+
+        unaligned_write_le32(frame, compression);
+        unaligned_write_le32(frame + 4, e->n_entries);
+        unaligned_write_le64(frame + 8, size);
+        unaligned_write_le64(frame + 16, e->payload_size);
+
+        /* Field names and the boot ID stay known to the receiver for the next frames of the stream */
+        e->payload_size = 0;
+        e->n_entries = 0;
+
+        *ret_size = JOURNAL_BATCH_FRAME_HEADER_SIZE + size;
+        *ret = TAKE_PTR(frame);
+        return 0;
+}
+
+void journal_batch_decoder_done(JournalBatchDecoder *d) {
+        assert(d);
+
+        for (size_t i = 0; i < d->n_names; i++)
+                free(d->names[i]);
+        d->names = mfree(d->names);
+        d->n_names = 0;
+
+        d->payload = mfree(d->payload);
+        d->fields = mfree(d->fields);
+        d->entry = mfree(d->entry);
+}
+
+int journal_batch_parse_frame_header(
+                const void *header,
+                int *ret_compression,
+                uint32_t *ret_n_entries,
+                uint64_t *ret_size,
+                uint64_t *ret_uncompressed_size) {
+
+        uint32_t compression, n_entries;
+        uint64_t size, uncompressed_size;
+
+        assert(header);
+        assert(ret_compression);
+        assert(ret_n_entries);
+        assert(ret_size);
+        assert(ret_uncompressed_size);
+
+        compression = unaligned_read_le32(header);
+        n_entries = unaligned_read_le32((const uint8_t*) header + 4);
+        size = unaligned_read_le64((const uint8_t*) header + 8);
+        uncompressed_size = unaligned_read_le64((const uint8_t*) header + 16);
+
+        if (!IN_SET(compression, 0, OBJECT_COMPRESSED_XZ, OBJECT_COMPRESSED_LZ4, OBJECT_COMPRESSED_ZSTD))
+                return log_warning_errno(SYNTHETIC_ERRNO(EPROTONOSUPPORT),
+                                         "Batch uses unknown compression %" PRIu32 ".", compression);
+        if (n_entries == 0)
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Batch without entries.");
+        if (size > DATA_SIZE_MAX || uncompressed_size > DATA_SIZE_MAX)
+                return log_warning_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                         "Batch is bigger than %u bytes.", DATA_SIZE_MAX);
+        /* Each entry takes at least four bytes: two timestamps, the flags and the end tag */
+        if (size == 0 || uncompressed_size < (uint64_t) n_entries * 4 ||
+            (compression == 0 && size != uncompressed_size))
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Batch has invalid size.");
+
+        *ret_compression = compression;
+        *ret_n_entries = n_entries;
+        *ret_size = size;
+        *ret_uncompressed_size = uncompressed_size;
+        return 0;
+}
+
+int journal_batch_decoder_load_frame(
+                JournalBatchDecoder *d,
+                int compression,
+                uint32_t n_entries,
+                const void *data,
+                size_t size,
+                size_t uncompressed_size) {
+
+        int r;
+
+        assert(d);
+        assert(d->n_entries == 0);
+        assert(data || size == 0);
+
+        /* The payload is copied out of the input buffer, since the entries are returned one by one while
+         * the input buffer is reused. */
+        if (compression == 0) {
+                if (!GREEDY_REALLOC(d->payload, size))
+                        return -ENOMEM;
+
+                memcpy_safe(d->payload, data, size);
+        } else {
+                size_t n = 0;
+
+                r = decompress_blob(compression, data, size, (void**) &d->payload, &n, uncompressed_size);
+                if (r < 0)
+                        return log_warning_errno(r, "Failed to decompress batch: %m");
+                if (n != uncompressed_size)
+                        return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                                 "Batch decompressed to %zu bytes, expected %zu.",
+                                                 n, uncompressed_size);
+        }
+
+        d->payload_size = uncompressed_size;
+        d->payload_offset = 0;
+        d->n_entries = n_entries;
+        return 0;
+}
+
+static int decoder_get(JournalBatchDecoder *d, size_t size, const uint8_t **ret) {
+        assert(d);
+        assert(ret);
+
+        if (size > d->payload_size - d->payload_offset)
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Batch is truncated.");
+
+        *ret = d->payload + d->payload_offset;
+        d->payload_offset += size;
+        return 0;
+}
+
+static int decoder_get_varint(JournalBatchDecoder *d, uint64_t *ret) {
+        uint64_t v = 0;
+
+        assert(d);
+        assert(ret);
+
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+                const uint8_t *b;
+                int r;
+
+                r = decoder_get(d, 1, &b);
+                if (r < 0)
+                        return r;
+
+                v |= (uint64_t) (*b & 0x7f) << shift;
+                if (!(*b & 0x80)) {
+                        *ret = v;
+                        return 0;
+                }
+        }
+
+        return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Batch contains invalid varint.");
+}
+
+static int decoder_get_blob(JournalBatchDecoder *d, const uint8_t **ret, size_t *ret_size) {
+        uint64_t l;
+        int r;
+
+        assert(d);
+        assert(ret);
+        assert(ret_size);
+
+        r = decoder_get_varint(d, &l);
+        if (r < 0)
+                return r;
+        if (l > DATA_SIZE_MAX)
+                return log_warning_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                         "Batch declares field with size %" PRIu64 " > DATA_SIZE_MAX = %u",
+                                         l, DATA_SIZE_MAX);
+
+        r = decoder_get(d, l, ret);
+        if (r < 0)
+                return r;
+
+        *ret_size = l;
+        return 0;
+}
+
+static int decoder_get_name(JournalBatchDecoder *d, const char **ret, size_t *ret_len) {
+        const uint8_t *name;
+        uint64_t tag;
+        size_t l;
+        int r;
+
+        assert(d);
+        assert(ret);
+        assert(ret_len);
+
+        /* Returns 0 at the end of the entry, 1 with the field name otherwise. The returned name is NULL if
+         * it is not valid, in which case the field shall be skipped. */
+
+        r = decoder_get_varint(d, &tag);
+        if (r < 0)
+                return r;
+        if (tag == 0)
+                return 0;
+
+        if (tag >= 2 && tag - 2 < d->n_names) {
+                *ret = d->names[tag - 2];
+                *ret_len = strlen_ptr(*ret);
+                return 1;
+        }
+
+        if (tag != 1 && tag - 2 != d->n_names)
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                         "Batch refers to unknown field name %" PRIu64 ".", tag - 2);
+
+        r = decoder_get_blob(d, &name, &l);
+        if (r < 0)
+                return r;
+
+        if (!journal_field_valid((const char*) name, l, true)) {
+                char buf[64], *t;
+
+                t = strndupa((const char*) name, MIN(l, sizeof(buf)));
+                log_debug("Ignoring invalid field: \"%s\"", cellescape(buf, sizeof buf, t));
+                name = NULL;
+        }
+
+        if (tag == 1) {
+                *ret = (const char*) name;
+                *ret_len = name ? l : 0;
+                return 1;
+        }
+
+        /* A new field name to remember for the rest of the stream */
+        if (d->n_names >= JOURNAL_BATCH_NAMES_MAX)
+                return log_warning_errno(SYNTHETIC_ERRNO(E2BIG),
+                                         "Batch defines more than %u field names.", JOURNAL_BATCH_NAMES_MAX);
+
+        if (!GREEDY_REALLOC(d->names, d->n_names + 1))
+                return -ENOMEM;
+
+        if (name) {
+                d->names[d->n_names] = strndup((const char*) name, l);
+                if (!d->names[d->n_names])
+                        return -ENOMEM;
+        } else
+                d->names[d->n_names] = NULL;
+
+        *ret = d->names[d->n_names++];
+        *ret_len = name ? l : 0;
+        return 1;
+}
+
+int journal_batch_decoder_next(
+                JournalBatchDecoder *d,
+                struct iovec_wrapper *iovw,
+                dual_timestamp *ts,
+                sd_id128_t *boot_id) {
+
+        uint64_t realtime, monotonic;
+        size_t n_fields = 0, total = 0;
+        const uint8_t *flags;
+        int r, skip = 0;
+        char *p;
+
+        assert(d);
+        assert(d->n_entries > 0);
+        assert(iovw);
+        assert(ts);
+        assert(boot_id);
+
+        r = decoder_get_varint(d, &realtime);
+        if (r < 0)
+                return r;
+        if (!VALID_REALTIME(realtime))
+                return log_warning_errno(SYNTHETIC_ERRNO(ERANGE),
+                                         "__REALTIME_TIMESTAMP out of range: %" PRIu64, realtime);
+
+        r = decoder_get_varint(d, &monotonic);
+        if (r < 0)
+                return r;
+        if (!VALID_MONOTONIC(monotonic))
+                return log_warning_errno(SYNTHETIC_ERRNO(ERANGE),
+                                         "__MONOTONIC_TIMESTAMP out of range: %" PRIu64, monotonic);
+
+        r = decoder_get(d, 1, &flags);
+        if (r < 0)
+                return r;
+        if (*flags & ~JOURNAL_BATCH_ENTRY_BOOT_ID)
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Batch entry has unknown flags 0x%x.", *flags);
+
+        if (*flags & JOURNAL_BATCH_ENTRY_BOOT_ID) {
+                const uint8_t *b;
+
+                r = decoder_get(d, sizeof(d->boot_id.bytes), &b);
+                if (r < 0)
+                        return r;
+
+                memcpy(d->boot_id.bytes, b, sizeof(d->boot_id.bytes));
+        }
+
+        if (!sd_id128_is_null(d->boot_id))
+                total += STRLEN("_BOOT_ID=") + SD_ID128_STRING_MAX - 1;
+
+        /* First collect the fields, so that the entry can be assembled in a buffer of the right size */
+        for (;;) {
+                const uint8_t *value;
+                const char *name;
+                size_t name_len, value_len;
+
+                r = decoder_get_name(d, &name, &name_len);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                r = decoder_get_blob(d, &value, &value_len);
+                if (r < 0)
+                        return r;
+
+                /* Like the export format, ignore fields with invalid names and dunder fields */
+                if (!name || startswith(name, "__"))
+                        continue;
+
+                /* Oversized entries are parsed to the end nevertheless, so that the following entries of
+                 * the frame can still be processed */
+                if (skip < 0)
+                        continue;
+
+                if (n_fields >= ENTRY_FIELD_COUNT_MAX) {
+                        skip = log_debug_errno(SYNTHETIC_ERRNO(E2BIG),
+                                               "Batch entry has more than %u fields.", ENTRY_FIELD_COUNT_MAX);
+                        continue;
+                }
+
+                total += name_len + 1 + value_len;
+                if (total > ENTRY_SIZE_MAX) {
+                        skip = log_debug_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                               "Batch entry is bigger than %u bytes.", ENTRY_SIZE_MAX);
+                        continue;
+                }
+
+                if (!GREEDY_REALLOC(d->fields, n_fields + 1))
+                        return -ENOMEM;
+
+                d->fields[n_fields++] = (JournalBatchField) {
+                        .name = name,
+                        .name_len = name_len,
+                        .value = value,
+                        .value_len = value_len,
+                };
+        }
+
+        d->n_entries--;
+        if (d->n_entries == 0 && d->payload_offset != d->payload_size)
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Batch has trailing garbage.");
+
+        if (skip < 0)
+                return skip;
+
+        if (!GREEDY_REALLOC(d->entry, MAX(total, 1U)))
+                return -ENOMEM;
+
+        p = d->entry;
+
+        if (!sd_id128_is_null(d->boot_id)) {
+                char *start = p;
+
+                p = stpcpy(p, "_BOOT_ID=");
+                sd_id128_to_string(d->boot_id, p);
+                p += SD_ID128_STRING_MAX - 1;
+
+                r = iovw_put(iovw, start, p - start);
+                if (r < 0)
+                        return r;
+        }
+
+        for (size_t i = 0; i < n_fields; i++) {
+                char *start = p;
+
+                p = mempcpy(p, d->fields[i].name, d->fields[i].name_len);
+                *(p++) = '=';
+                p = mempcpy(p, d->fields[i].value, d->fields[i].value_len);
+
+                r = iovw_put(iovw, start, p - start);
+                if (r < 0)
+                        return r;
+        }
+
+        ts->realtime = realtime;
+        ts->monotonic = monotonic;
+        *boot_id = d->boot_id;
+
+        return 1;
+}
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sd-id128.h"
+
+#include "hashmap.h"
+#include "io-util.h"
+#include "time-util.h"
+
+/* A compact binary alternative to the journal export format, used by systemd-journal-upload and
+ * systemd-journal-remote as "application/vnd.fdo.journal-batch".
+ *
+ * The stream is a sequence of frames. Each frame starts with a header of four little-endian integers:
+ *
+ *     le32 compression         0, or one of the OBJECT_COMPRESSED_* flags the payload is compressed with
+ *     le32 n_entries           number of entries in the payload, at least one
+ *     le64 size                size of the payload following the header, as transferred
+ *     le64 uncompressed_size   size of the payload after decompression
+ *
+ * The (decompressed) payload consists of n_entries entries, using unsigned LEB128 varints:
+ *
+ *     varint realtime          __REALTIME_TIMESTAMP
+ *     varint monotonic         __MONOTONIC_TIMESTAMP
+ *     u8     flags             if JOURNAL_BATCH_ENTRY_BOOT_ID is set, 16 bytes of boot ID follow,
+ *                              otherwise the boot ID of the previous entry in the stream applies
+ *     fields...
+ *     varint 0                 end of entry
+ *
+ * Each field starts with a varint tag: 1 means the field name follows literally as a varint length and
+ * the name, N ≥ 2 refers to the (N-2)th name in the table of the stream. If N-2 equals the number of
+ * names in the table, the field name follows as a varint length and the name, and is appended to the
+ * table. Then follows the value as a varint length and the data. Field names are thus transferred only
+ * once per stream, and the table is shared by all frames of the stream. The boot ID is turned into a
+ * _BOOT_ID= field by the receiver, like in the export format. */
+
+#define JOURNAL_BATCH_CONTENT_TYPE "application/vnd.fdo.journal-batch"
+
+/* Defaults for the sender: finish a frame when either limit is reached */
+#define JOURNAL_BATCH_ENTRIES_MAX 1024U
+#define JOURNAL_BATCH_SIZE_MAX (4U*1024U*1024U)
+
+/* The maximum number of interned field names per stream */
+#define JOURNAL_BATCH_NAMES_MAX 4096U
+
+#define JOURNAL_BATCH_FRAME_HEADER_SIZE 24U
+
+enum {
+        JOURNAL_BATCH_ENTRY_BOOT_ID = 1 << 0,
+};
+
+typedef struct JournalBatchEncoder {
+        Hashmap *names;          /* field name → index in the table + 1 */
+        unsigned n_names;
+
+        uint8_t *payload;
+        size_t payload_size;
+        uint32_t n_entries;
+
+        sd_id128_t boot_id;
+        bool compress;
+} JournalBatchEncoder;
+
+#define JOURNAL_BATCH_ENCODER_INIT(_compress) { .compress = (_compress) }
+
+void journal_batch_encoder_done(JournalBatchEncoder *e);
+void journal_batch_encoder_reset(JournalBatchEncoder *e);
+int journal_batch_encoder_begin_entry(JournalBatchEncoder *e, uint64_t realtime, uint64_t monotonic, sd_id128_t boot_id);
+int journal_batch_encoder_add_field(JournalBatchEncoder *e, const void *data, size_t size);
+int journal_batch_encoder_end_entry(JournalBatchEncoder *e);
+int journal_batch_encoder_finish(JournalBatchEncoder *e, void **ret, size_t *ret_size);
+
+static inline bool journal_batch_encoder_full(const JournalBatchEncoder *e) {
+        return e->n_entries >= JOURNAL_BATCH_ENTRIES_MAX || e->payload_size >= JOURNAL_BATCH_SIZE_MAX;
+}
+
+typedef struct JournalBatchField JournalBatchField;
+
+typedef struct JournalBatchDecoder {
+        char **names;            /* NULL entries for invalid names, whose fields are skipped */
+        size_t n_names;
+
+        uint8_t *payload;
+        size_t payload_size;
+        size_t payload_offset;
+        uint32_t n_entries;      /* entries left in the current frame */
+
+        JournalBatchField *fields;
+        char *entry;             /* the fields of the current entry, as NAME=value */
+
+        sd_id128_t boot_id;
+} JournalBatchDecoder;
+
+void journal_batch_decoder_done(JournalBatchDecoder *d);
+int journal_batch_parse_frame_header(const void *header, int *ret_compression, uint32_t *ret_n_entries,
+                                     uint64_t *ret_size, uint64_t *ret_uncompressed_size);
+int journal_batch_decoder_load_frame(JournalBatchDecoder *d, int compression, uint32_t n_entries,
+                                     const void *data, size_t size, size_t uncompressed_size);
+int journal_batch_decoder_next(JournalBatchDecoder *d, struct iovec_wrapper *iovw, dual_timestamp *ts,
+                               sd_id128_t *boot_id);
+
+static inline bool journal_batch_decoder_frame_done(const JournalBatchDecoder *d) {
+        return d->n_entries == 0;
+}
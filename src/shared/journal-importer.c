@@ -22,6 +22,9 @@ enum {
         IMPORTER_STATE_DATA,        /* reading binary data */
         IMPORTER_STATE_DATA_FINISH, /* expecting newline */
         IMPORTER_STATE_EOF,         /* done */
+        IMPORTER_STATE_BATCH_HEADER,  /* reading batch frame header */
+        IMPORTER_STATE_BATCH_PAYLOAD, /* reading batch frame payload */
+        IMPORTER_STATE_BATCH_ENTRIES, /* returning the entries of the batch frame */
 };
 
 void journal_importer_cleanup(JournalImporter *imp) {
@@ -33,6 +36,7 @@ void journal_importer_cleanup(JournalImporter *imp) {
         free(imp->name);
         free(imp->buf);
         iovw_free_contents(&imp->iovw, false);
+        journal_batch_decoder_done(&imp->batch_decoder);
 }
 
 static char* realloc_buffer(JournalImporter *imp, size_t size) {
@@ -113,7 +117,8 @@ static int get_line(JournalImporter *imp, char **line, size_t *size) {
 static int fill_fixed_size(JournalImporter *imp, void **data, size_t size) {
 
         assert(imp);
-        assert(IN_SET(imp->state, IMPORTER_STATE_DATA_START, IMPORTER_STATE_DATA, IMPORTER_STATE_DATA_FINISH));
+        assert(IN_SET(imp->state, IMPORTER_STATE_DATA_START, IMPORTER_STATE_DATA, IMPORTER_STATE_DATA_FINISH,
+                      IMPORTER_STATE_BATCH_HEADER, IMPORTER_STATE_BATCH_PAYLOAD));
         assert(size <= DATA_SIZE_MAX);
         assert(imp->offset <= imp->filled);
         assert(imp->filled <= MALLOC_SIZEOF_SAFE(imp->buf));
@@ -278,9 +283,74 @@ static int process_special_field(JournalImporter *imp, char *line) {
         return 0;
 }
 
+static int process_batch_data(JournalImporter *imp) {
+        void *data;
+        int r;
+
+        assert(imp);
+
+        switch (imp->state) {
+
+        case IMPORTER_STATE_LINE:
+                /* Nothing read yet */
+                imp->state = IMPORTER_STATE_BATCH_HEADER;
+                _fallthrough_;
+
+        case IMPORTER_STATE_BATCH_HEADER:
+                r = fill_fixed_size(imp, &data, JOURNAL_BATCH_FRAME_HEADER_SIZE);
+                if (r < 0)
+                        return r;
+                if (r == 0) {
+                        imp->state = IMPORTER_STATE_EOF;
+                        return 0;
+                }
+
+                r = journal_batch_parse_frame_header(data, &imp->batch_compression, &imp->batch_n_entries,
+                                                     &imp->batch_size, &imp->batch_uncompressed_size);
+                if (r < 0)
+                        return r;
+
+                imp->state = IMPORTER_STATE_BATCH_PAYLOAD;
+                return 0; /* continue */
+
+        case IMPORTER_STATE_BATCH_PAYLOAD:
+                r = fill_fixed_size(imp, &data, imp->batch_size);
+                if (r < 0)
+                        return r;
+                if (r == 0) {
+                        imp->state = IMPORTER_STATE_EOF;
+                        return 0;
+                }
+
+                r = journal_batch_decoder_load_frame(&imp->batch_decoder, imp->batch_compression,
+                                                     imp->batch_n_entries, data, imp->batch_size,
+                                                     imp->batch_uncompressed_size);
+                if (r < 0)
+                        return r;
+
+                imp->state = IMPORTER_STATE_BATCH_ENTRIES;
+                return 0; /* continue */
+
+        case IMPORTER_STATE_BATCH_ENTRIES:
+                r = journal_batch_decoder_next(&imp->batch_decoder, &imp->iovw, &imp->ts, &imp->boot_id);
+                if (journal_batch_decoder_frame_done(&imp->batch_decoder))
+                        imp->state = IMPORTER_STATE_BATCH_HEADER;
+                if (r < 0)
+                        return r;
+
+                return 1; /* event is ready */
+
+        default:
+                assert_not_reached();
+        }
+}
+
 int journal_importer_process_data(JournalImporter *imp) {
         int r;
 
+        if (imp->batch)
+                return process_batch_data(imp);
+
         switch(imp->state) {
         case IMPORTER_STATE_LINE: {
                 char *line, *sep;
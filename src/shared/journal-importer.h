@@ -9,6 +9,7 @@
 #include "sd-id128.h"
 
 #include "io-util.h"
+#include "journal-batch.h"
 #include "time-util.h"
 
 /* Make sure not to make this smaller than the maximum coredump size.
@@ -43,6 +44,13 @@ typedef struct JournalImporter {
         int state;
         dual_timestamp ts;
         sd_id128_t boot_id;
+
+        bool batch;        /* the input is in the batch format rather than the export format */
+        JournalBatchDecoder batch_decoder;
+        int batch_compression;       /* the header of the frame being processed */
+        uint32_t batch_n_entries;
+        uint64_t batch_size;
+        uint64_t batch_uncompressed_size;
 } JournalImporter;
 
 #define JOURNAL_IMPORTER_INIT(_fd) { .fd = (_fd), .iovw = {} }
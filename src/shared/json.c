@@ -90,6 +90,9 @@ struct JsonVariant {
         /* If in addition to this object all objects referenced by it are also ordered strictly by name */
         bool normalized:1;
 
+        /* If this is not an actual variant, but the header of a JsonArena, see below */
+        bool is_arena:1;
+
         union {
                 /* For simple types we store the value in-line. */
                 JsonValue value;
@@ -126,6 +129,34 @@ assert_cc(sizeof(JsonVariant) == 48U);
 assert_cc(INLINE_STRING_MAX == 15U);
 #endif
 
+/* When parsing with JSON_PARSE_ARENA all variants of the resulting tree are allocated from a JsonArena, i.e. from
+ * a few large chunks of JsonVariant slots instead of one malloc() per variant. Each variant allocated from the
+ * arena is marked as embedded, with the arena's header as parent. Hence taking or dropping a reference on any
+ * of them takes or drops a reference on the arena, and the whole tree is released as a unit once the last
+ * reference to any part of it is gone. References between nodes of the same arena are not counted, and
+ * neither are the references nodes hold on the source, which is pinned by the arena instead. Arena variants
+ * are never modified in place, changes always result in copies (which then reference the arena as needed). */
+#define ARENA_CHUNK_SLOTS_MIN 32U
+#define ARENA_CHUNK_SLOTS_MAX 8192U
+
+typedef struct JsonArenaChunk {
+        struct JsonArenaChunk *next;
+        size_t n_slots;
+        JsonVariant slots[];
+} JsonArenaChunk;
+
+typedef struct JsonArena {
+        JsonVariant header;
+
+        JsonArenaChunk *chunks;
+        size_t n_chunk_slots;           /* The size of the most recently allocated regular chunk */
+
+        JsonVariant *next_slot;         /* The unused tail of that chunk */
+        size_t n_slots_left;
+
+        JsonVariant *free_slots;        /* Single slots of temporary variants, linked via their .reference field */
+} JsonArena;
+
 static JsonSource* json_source_new(const char *name) {
         JsonSource *s;
 
@@ -288,17 +319,192 @@ static JsonVariant *json_variant_conservative_formalize(JsonVariant *v) {
         return json_variant_formalize(v);
 }
 
-static int json_variant_new(JsonVariant **ret, JsonVariantType type, size_t space) {
+static JsonArena *json_variant_arena(JsonVariant *v) {
+
+        /* Returns the arena the variant was allocated from, or NULL if it wasn't */
+
+        if (!json_variant_is_regular(v))
+                return NULL;
+
+        while (v->is_embedded)
+                v = v->parent;
+
+        return v->is_arena ? container_of(v, JsonArena, header) : NULL;
+}
+
+static JsonArena *json_arena_new(JsonSource *source) {
+        JsonArena *a;
+
+        a = new(JsonArena, 1);
+        if (!a)
+                return NULL;
+
+        *a = (JsonArena) {
+                .header = {
+                        .n_ref = 1,
+                        .type = JSON_VARIANT_NULL,
+                        .is_arena = true,
+                        .source = json_source_ref(source),
+                },
+        };
+
+        return a;
+}
+
+static void json_arena_free(JsonArena *a) {
+        JsonArenaChunk *c;
+
+        assert(a);
+        assert(a->header.n_ref == 0);
+
+        while ((c = a->chunks)) {
+                a->chunks = c->next;
+
+                if (a->header.sensitive)
+                        explicit_bzero_safe(c->slots, c->n_slots * sizeof(JsonVariant));
+
+                free(c);
+        }
+
+        json_source_unref(a->header.source);
+        free(a);
+}
+
+static JsonVariant *json_arena_alloc(JsonArena *a, size_t n) {
+        JsonArenaChunk *c;
+        JsonVariant *v;
+        bool dedicated;
+        size_t k;
+
+        assert(a);
+        assert(n > 0);
+
+        /* Returns n zeroed consecutive slots, and takes a reference on the arena for them */
+
+        if (n == 1 && a->free_slots) {
+                v = a->free_slots;
+                a->free_slots = v->reference;
+                goto finish;
+        }
+
+        if (n <= a->n_slots_left) {
+                v = a->next_slot;
+                a->next_slot += n;
+                a->n_slots_left -= n;
+                goto finish;
+        }
+
+        /* Start out small, since most documents are, and then grow the chunks exponentially. Anything that
+         * doesn't fit into a chunk of the current size gets a chunk of its own. */
+        k = CLAMP(a->n_chunk_slots * 2, ARENA_CHUNK_SLOTS_MIN, ARENA_CHUNK_SLOTS_MAX);
+        dedicated = n > k;
+        if (dedicated)
+                k = n;
+
+        if (k > (SIZE_MAX - offsetof(JsonArenaChunk, slots)) / sizeof(JsonVariant))
+                return NULL;
+
+        c = malloc(offsetof(JsonArenaChunk, slots) + k * sizeof(JsonVariant));
+        if (!c)
+                return NULL;
+
+        c->n_slots = k;
+        c->next = a->chunks;
+        a->chunks = c;
+
+        v = c->slots;
+
+        if (!dedicated) {
+                a->n_chunk_slots = k;
+                a->next_slot = c->slots + n;
+                a->n_slots_left = k - n;
+        }
+
+finish:
+        memzero(v, n * sizeof(JsonVariant));
+        a->header.n_ref++;
+        return v;
+}
+
+static void json_arena_recycle(JsonArena *a, JsonVariant **elements, size_t n) {
+        assert(a);
+        assert(elements || n == 0);
+
+        /* Called for the elements of a container allocated from the arena once they have been copied into
+         * it, right before they are unreferenced. Those the container doesn't reference (see
+         * json_variant_set()) are unused from now on, and their slots can be reused for the following
+         * ones. */
+
+        for (size_t i = 0; i < n; i++) {
+                JsonVariant *v = elements[i];
+
+                if (json_variant_arena(v) != a || v->is_reference)
+                        continue;
+
+                if (IN_SET(v->type, JSON_VARIANT_ARRAY, JSON_VARIANT_OBJECT))
+                        continue;
+
+                if (v->type == JSON_VARIANT_STRING && strnlen(v->string, INLINE_STRING_MAX+1) > INLINE_STRING_MAX)
+                        continue;
+
+                v->reference = a->free_slots;
+                a->free_slots = v;
+        }
+}
+
+static void json_arena_disown(JsonArena *a, JsonVariant *w) {
+        assert(a);
+        assert(w);
+
+        /* Drops the references json_variant_set() and json_variant_copy_source() took for an element of a
+         * container allocated from the arena. The arena keeps the referenced variants and the source alive
+         * anyway, and counting them would keep the arena alive forever. */
+
+        if (w->is_reference && json_variant_is_regular(w->reference)) {
+                assert(json_variant_arena(w->reference) == a);
+                assert(a->header.n_ref > 1);
+                a->header.n_ref--;
+        }
+
+        if (w->source) {
+                assert(w->source == a->header.source);
+                assert(w->source->n_ref > 1);
+                w->source->n_ref--;
+        }
+}
+
+static JsonVariant *json_variant_alloc(JsonArena *arena, size_t size) {
+        JsonVariant *v;
+
+        /* Allocates a zeroed variant of the specified size, either from the specified arena or from the heap */
+
+        if (arena) {
+                v = json_arena_alloc(arena, DIV_ROUND_UP(size, sizeof(JsonVariant)));
+                if (!v)
+                        return NULL;
+
+                v->is_embedded = true;
+                v->parent = &arena->header;
+        } else {
+                v = malloc0(size);
+                if (!v)
+                        return NULL;
+
+                v->n_ref = 1;
+        }
+
+        return v;
+}
+
+static int json_variant_new(JsonArena *arena, JsonVariant **ret, JsonVariantType type, size_t space) {
         JsonVariant *v;
 
         assert_return(ret, -EINVAL);
 
-        v = malloc0(MAX(sizeof(JsonVariant),
-                        offsetof(JsonVariant, value) + space));
+        v = json_variant_alloc(arena, MAX(sizeof(JsonVariant), offsetof(JsonVariant, value) + space));
         if (!v)
                 return -ENOMEM;
 
-        v->n_ref = 1;
         v->type = type;
 
         *ret = v;
@@ -316,7 +522,7 @@ int json_variant_new_integer(JsonVariant **ret, intmax_t i) {
                 return 0;
         }
 
-        r = json_variant_new(&v, JSON_VARIANT_INTEGER, sizeof(i));
+        r = json_variant_new(NULL, &v, JSON_VARIANT_INTEGER, sizeof(i));
         if (r < 0)
                 return r;
 
@@ -336,7 +542,7 @@ int json_variant_new_unsigned(JsonVariant **ret, uintmax_t u) {
                 return 0;
         }
 
-        r = json_variant_new(&v, JSON_VARIANT_UNSIGNED, sizeof(u));
+        r = json_variant_new(NULL, &v, JSON_VARIANT_UNSIGNED, sizeof(u));
         if (r < 0)
                 return r;
 
@@ -359,7 +565,7 @@ int json_variant_new_real(JsonVariant **ret, long double d) {
         }
         REENABLE_WARNING;
 
-        r = json_variant_new(&v, JSON_VARIANT_REAL, sizeof(d));
+        r = json_variant_new(NULL, &v, JSON_VARIANT_REAL, sizeof(d));
         if (r < 0)
                 return r;
 
@@ -408,7 +614,7 @@ int json_variant_new_stringn(JsonVariant **ret, const char *s, size_t n) {
         if (!utf8_is_valid_n(s, n)) /* JSON strings must be valid UTF-8 */
                 return -EUCLEAN;
 
-        r = json_variant_new(&v, JSON_VARIANT_STRING, n + 1);
+        r = json_variant_new(NULL, &v, JSON_VARIANT_STRING, n + 1);
         if (r < 0)
                 return r;
 
@@ -521,7 +727,7 @@ static void json_variant_copy_source(JsonVariant *v, JsonVariant *from) {
         v->source = json_source_ref(from->source);
 }
 
-int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
+static int json_variant_new_array_internal(JsonArena *arena, JsonVariant **ret, JsonVariant **array, size_t n) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
         bool normalized = true;
 
@@ -532,14 +738,14 @@ int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
         }
         assert_return(array, -EINVAL);
 
-        v = new(JsonVariant, n + 1);
+        if (n >= SIZE_MAX / sizeof(JsonVariant))
+                return -ENOMEM;
+
+        v = json_variant_alloc(arena, (n + 1) * sizeof(JsonVariant));
         if (!v)
                 return -ENOMEM;
 
-        *v = (JsonVariant) {
-                .n_ref = 1,
-                .type = JSON_VARIANT_ARRAY,
-        };
+        v->type = JSON_VARIANT_ARRAY;
 
         for (v->n_elements = 0; v->n_elements < n; v->n_elements++) {
                 JsonVariant *w = v + 1 + v->n_elements,
@@ -559,6 +765,8 @@ int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
 
                 json_variant_set(w, c);
                 json_variant_copy_source(w, c);
+                if (arena)
+                        json_arena_disown(arena, w);
 
                 if (!json_variant_is_normalized(c))
                         normalized = false;
@@ -570,6 +778,10 @@ int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
         return 0;
 }
 
+int json_variant_new_array(JsonVariant **ret, JsonVariant **array, size_t n) {
+        return json_variant_new_array_internal(NULL, ret, array, n);
+}
+
 int json_variant_new_array_bytes(JsonVariant **ret, const void *p, size_t n) {
         JsonVariant *v;
         size_t i;
@@ -666,7 +878,7 @@ int json_variant_new_array_strv(JsonVariant **ret, char **l) {
         return 0;
 }
 
-int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
+static int json_variant_new_object_internal(JsonArena *arena, JsonVariant **ret, JsonVariant **array, size_t n) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
         const char *prev = NULL;
         bool sorted = true, normalized = true;
@@ -679,14 +891,14 @@ int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
         assert_return(array, -EINVAL);
         assert_return(n % 2 == 0, -EINVAL);
 
-        v = new(JsonVariant, n + 1);
+        if (n >= SIZE_MAX / sizeof(JsonVariant))
+                return -ENOMEM;
+
+        v = json_variant_alloc(arena, (n + 1) * sizeof(JsonVariant));
         if (!v)
                 return -ENOMEM;
 
-        *v = (JsonVariant) {
-                .n_ref = 1,
-                .type = JSON_VARIANT_OBJECT,
-        };
+        v->type = JSON_VARIANT_OBJECT;
 
         for (v->n_elements = 0; v->n_elements < n; v->n_elements++) {
                 JsonVariant *w = v + 1 + v->n_elements,
@@ -721,6 +933,8 @@ int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
 
                 json_variant_set(w, c);
                 json_variant_copy_source(w, c);
+                if (arena)
+                        json_arena_disown(arena, w);
         }
 
         v->normalized = normalized;
@@ -730,6 +944,10 @@ int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
         return 0;
 }
 
+int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
+        return json_variant_new_object_internal(NULL, ret, array, n);
+}
+
 static size_t json_variant_size(JsonVariant* v) {
 
         if (!json_variant_is_regular(v))
@@ -827,8 +1045,12 @@ JsonVariant *json_variant_unref(JsonVariant *v) {
                 v->n_ref--;
 
                 if (v->n_ref == 0) {
-                        json_variant_free_inner(v, false);
-                        free(v);
+                        if (v->is_arena)
+                                json_arena_free(container_of(v, JsonArena, header));
+                        else {
+                                json_variant_free_inner(v, false);
+                                free(v);
+                        }
                 }
         }
 
@@ -1414,11 +1636,18 @@ void json_variant_sensitive(JsonVariant *v) {
          * flag to all contained variants. And if those are then destroyed this is propagated further down,
          * and so on. */
 
+        JsonArena *a;
+
         v = json_variant_formalize(v);
         if (!json_variant_is_regular(v))
                 return;
 
         v->sensitive = true;
+
+        /* Variants allocated from an arena aren't destroyed individually, hence mark the arena instead */
+        a = json_variant_arena(v);
+        if (a)
+                a->header.sensitive = true;
 }
 
 bool json_variant_is_sensitive(JsonVariant *v) {
@@ -2269,6 +2498,9 @@ static bool json_single_ref(JsonVariant *v) {
         if (v->is_embedded)
                 return json_single_ref(v->parent);
 
+        if (v->is_arena) /* Never modify variants allocated from an arena in place */
+                return false;
+
         assert(v->n_ref > 0);
         return v->n_ref == 1;
 }
@@ -2400,7 +2632,7 @@ static int unhex_ucs2(const char *c, uint16_t *ret) {
 static int json_parse_string(const char **p, char **ret) {
         _cleanup_free_ char *s = NULL;
         size_t n = 0;
-        const char *c;
+        const char *c, *e;
 
         assert(p);
         assert(*p);
@@ -2414,8 +2646,6 @@ static int json_parse_string(const char **p, char **ret) {
         c++;
 
         for (;;) {
-                int len;
-
                 /* Check for EOF */
                 if (*c == 0)
                         return -EINVAL;
@@ -2508,16 +2738,35 @@ static int json_parse_string(const char **p, char **ret) {
                         continue;
                 }
 
-                len = utf8_encoded_valid_unichar(c, SIZE_MAX);
-                if (len < 0)
-                        return len;
+                /* Everything else is copied verbatim, hence find the whole run of such characters, and
+                 * copy it in one go, instead of one character at a time. */
+                for (e = c;;) {
+                        uint8_t u = *e;
+                        int len;
+
+                        if (u >= ' ' && u < 0x7f && u != '"' && u != '\\') {
+                                e++;
+                                continue;
+                        }
+
+                        if (u < 0x80)
+                                break;
+
+                        len = utf8_encoded_valid_unichar(e, SIZE_MAX);
+                        if (len < 0)
+                                return len;
+
+                        e += len;
+                }
+
+                assert(e > c);
 
-                if (!GREEDY_REALLOC(s, n + len + 1))
+                if (!GREEDY_REALLOC(s, n + (e - c) + 1))
                         return -ENOMEM;
 
-                memcpy(s + n, c, len);
-                n += len;
-                c += len;
+                memcpy(s + n, c, e - c);
+                n += e - c;
+                c = e;
         }
 }
 
@@ -2838,76 +3087,267 @@ static void json_stack_release(JsonStack *s) {
         s->elements = mfree(s->elements);
 }
 
-static int json_parse_internal(
-                const char **input,
-                JsonSource *source,
-                JsonParseFlags flags,
-                JsonVariant **ret,
-                unsigned *line,
-                unsigned *column,
-                bool continue_end) {
+struct JsonParser {
+        JsonSource *source;
+        JsonParseFlags flags;
 
-        size_t n_stack = 1, i;
-        unsigned line_buffer = 0, column_buffer = 0;
-        void *tokenizer_state = NULL;
-        JsonStack *stack = NULL;
-        const char *p;
-        int r;
+        /* If JSON_PARSE_ARENA is set, the arena the current document is allocated from */
+        JsonArena *arena;
 
-        assert_return(input, -EINVAL);
-        assert_return(ret, -EINVAL);
+        JsonStack *stack;
+        size_t n_stack;
 
-        p = *input;
+        void *tokenizer_state;
+        unsigned line, column;
 
-        if (!GREEDY_REALLOC(stack, n_stack))
+        /* The amount of yet unconsumed input the last incremental parsing attempt ended with */
+        size_t deferred;
+};
+
+static void json_parser_done(JsonParser *parser) {
+        assert(parser);
+
+        for (size_t i = 0; i < parser->n_stack; i++)
+                json_stack_release(parser->stack + i);
+
+        parser->stack = mfree(parser->stack);
+        parser->n_stack = 0;
+
+        if (parser->arena) {
+                json_variant_unref(&parser->arena->header);
+                parser->arena = NULL;
+        }
+}
+
+static int json_parser_start(JsonParser *parser) {
+        assert(parser);
+
+        json_parser_done(parser);
+
+        if (!GREEDY_REALLOC(parser->stack, 1))
                 return -ENOMEM;
 
-        stack[0] = (JsonStack) {
+        parser->stack[0] = (JsonStack) {
                 .expect = EXPECT_TOPLEVEL,
         };
+        parser->n_stack = 1;
+
+        if (FLAGS_SET(parser->flags, JSON_PARSE_ARENA)) {
+                parser->arena = json_arena_new(parser->source);
+                if (!parser->arena)
+                        return -ENOMEM;
+        }
+
+        parser->tokenizer_state = NULL;
+        parser->deferred = 0;
+
+        return 0;
+}
+
+static int json_parser_new_value(JsonParser *parser, int token, const char *string, const JsonValue *value, JsonVariant **ret) {
+        JsonVariant *v;
+        size_t n;
+        int r;
+
+        assert(parser);
+        assert(value);
+        assert(ret);
+
+        if (!parser->arena)
+                switch (token) {
+
+                case JSON_TOKEN_STRING:
+                        return json_variant_new_string(ret, string);
+                case JSON_TOKEN_REAL:
+                        return json_variant_new_real(ret, value->real);
+                case JSON_TOKEN_INTEGER:
+                        return json_variant_new_integer(ret, value->integer);
+                case JSON_TOKEN_UNSIGNED:
+                        return json_variant_new_unsigned(ret, value->unsig);
+                case JSON_TOKEN_BOOLEAN:
+                        return json_variant_new_boolean(ret, value->boolean);
+                case JSON_TOKEN_NULL:
+                        return json_variant_new_null(ret);
+                default:
+                        assert_not_reached();
+                }
+
+        /* Variants allocated from the arena always carry their location, hence there's no point in using
+         * the magic variants for any of them, as they'd have to be copied anyway. */
+
+        switch (token) {
+
+        case JSON_TOKEN_STRING:
+                assert(string);
+
+                n = strlen(string);
+                if (!utf8_is_valid_n(string, n)) /* JSON strings must be valid UTF-8 */
+                        return -EUCLEAN;
+
+                r = json_variant_new(parser->arena, &v, JSON_VARIANT_STRING, n + 1);
+                if (r < 0)
+                        return r;
+
+                memcpy(v->string, string, n + 1);
+                break;
 
-        if (!line)
-                line = &line_buffer;
-        if (!column)
-                column = &column_buffer;
+        case JSON_TOKEN_REAL:
+                r = json_variant_new(parser->arena, &v, JSON_VARIANT_REAL, sizeof(long double));
+                if (r < 0)
+                        return r;
+
+                v->value.real = value->real;
+                break;
+
+        case JSON_TOKEN_INTEGER:
+                r = json_variant_new(parser->arena, &v, JSON_VARIANT_INTEGER, sizeof(intmax_t));
+                if (r < 0)
+                        return r;
+
+                v->value.integer = value->integer;
+                break;
+
+        case JSON_TOKEN_UNSIGNED:
+                r = json_variant_new(parser->arena, &v, JSON_VARIANT_UNSIGNED, sizeof(uintmax_t));
+                if (r < 0)
+                        return r;
+
+                v->value.unsig = value->unsig;
+                break;
+
+        case JSON_TOKEN_BOOLEAN:
+                r = json_variant_new(parser->arena, &v, JSON_VARIANT_BOOLEAN, sizeof(bool));
+                if (r < 0)
+                        return r;
+
+                v->value.boolean = value->boolean;
+                break;
+
+        case JSON_TOKEN_NULL:
+                r = json_variant_new(parser->arena, &v, JSON_VARIANT_NULL, 0);
+                if (r < 0)
+                        return r;
+
+                break;
+
+        default:
+                assert_not_reached();
+        }
+
+        *ret = v;
+        return 0;
+}
+
+static int json_parser_set_source(JsonParser *parser, JsonVariant **v, unsigned line, unsigned column) {
+        JsonSource *source;
+        JsonVariant *w;
+        int r;
+
+        assert(parser);
+        assert(v);
+
+        if (!parser->arena)
+                return json_variant_set_source(v, parser->source, line, column);
+
+        /* Variants allocated from the arena are not shared with anyone yet, hence patch them in place. Only
+         * the magic empty containers need to be copied into the arena first. */
+
+        if (!json_variant_is_regular(*v)) {
+                r = json_variant_new(parser->arena, &w, JSON_VARIANT_NULL, sizeof(JsonVariant*));
+                if (r < 0)
+                        return r;
+
+                json_variant_set(w, *v);
+                *v = w;
+        }
+
+        assert(json_variant_arena(*v) == parser->arena);
+
+        source = parser->arena->header.source;
+        if (source && line > source->max_line)
+                source->max_line = line;
+        if (source && column > source->max_column)
+                source->max_column = column;
+
+        (*v)->source = source; /* Not counted, the arena holds a reference */
+        (*v)->line = line;
+        (*v)->column = column;
+
+        return 1;
+}
+
+static int json_parser_run(
+                JsonParser *parser,
+                const char **input,
+                bool final,
+                bool continue_end,
+                JsonVariant **ret) {
+
+        const char *p;
+        int r;
+
+        /* Returns 1 and the parsed variant if a complete JSON document was read, and 0 if the input ended
+         * before that — which may only happen if 'final' is false, i.e. if the input is just a prefix of
+         * the document. In that case *input is updated to point to the first byte that wasn't consumed
+         * yet, and parsing is supposed to be continued from there once more input is available. */
+
+        assert(parser);
+        assert(parser->n_stack > 0);
+        assert(input);
+        assert(ret);
+
+        p = *input;
 
         for (;;) {
                 _cleanup_(json_variant_unrefp) JsonVariant *add = NULL;
                 _cleanup_free_ char *string = NULL;
-                unsigned line_token, column_token;
+                unsigned line_token, column_token, saved_line, saved_column;
+                const char *token_start;
                 JsonStack *current;
+                void *saved_state;
                 JsonValue value;
                 int token;
 
-                assert(n_stack > 0);
-                current = stack + n_stack - 1;
+                assert(parser->n_stack > 0);
+                current = parser->stack + parser->n_stack - 1;
 
                 if (continue_end && current->expect == EXPECT_END)
                         goto done;
 
-                token = json_tokenize(&p, &string, &value, &line_token, &column_token, &tokenizer_state, line, column);
-                if (token < 0) {
-                        r = token;
-                        goto finish;
+                token_start = p;
+                saved_state = parser->tokenizer_state;
+                saved_line = parser->line;
+                saved_column = parser->column;
+
+                token = json_tokenize(&p, &string, &value, &line_token, &column_token, &parser->tokenizer_state, &parser->line, &parser->column);
+                if (!final && (token < 0 || token == JSON_TOKEN_END || *p == 0)) {
+                        /* We reached the end of the input fed so far, hence the token might just be
+                         * incomplete. Rewind to its beginning, and try again once more data arrived. */
+                        parser->tokenizer_state = saved_state;
+                        parser->line = saved_line;
+                        parser->column = saved_column;
+
+                        *input = token_start;
+                        return 0;
                 }
+                if (token < 0)
+                        return token;
 
                 switch (token) {
 
                 case JSON_TOKEN_END:
                         if (current->expect != EXPECT_END) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
                         assert(current->n_elements == 1);
-                        assert(n_stack == 1);
+                        assert(parser->n_stack == 1);
                         goto done;
 
                 case JSON_TOKEN_COLON:
 
                         if (current->expect != EXPECT_OBJECT_COLON) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
                         current->expect = EXPECT_OBJECT_VALUE;
@@ -2920,8 +3360,7 @@ static int json_parse_internal(
                         else if (current->expect == EXPECT_ARRAY_COMMA)
                                 current->expect = EXPECT_ARRAY_NEXT_ELEMENT;
                         else {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
                         break;
@@ -2929,15 +3368,13 @@ static int json_parse_internal(
                 case JSON_TOKEN_OBJECT_OPEN:
 
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        if (!GREEDY_REALLOC(stack, n_stack+1)) {
-                                r = -ENOMEM;
-                                goto finish;
+                        if (!GREEDY_REALLOC(parser->stack, parser->n_stack+1)) {
+                                return -ENOMEM;
                         }
-                        current = stack + n_stack - 1;
+                        current = parser->stack + parser->n_stack - 1;
 
                         /* Prepare the expect for when we return from the child */
                         if (current->expect == EXPECT_TOPLEVEL)
@@ -2949,46 +3386,45 @@ static int json_parse_internal(
                                 current->expect = EXPECT_ARRAY_COMMA;
                         }
 
-                        stack[n_stack++] = (JsonStack) {
+                        parser->stack[parser->n_stack++] = (JsonStack) {
                                 .expect = EXPECT_OBJECT_FIRST_KEY,
                                 .line_before = line_token,
                                 .column_before = column_token,
                         };
 
-                        current = stack + n_stack - 1;
+                        current = parser->stack + parser->n_stack - 1;
                         break;
 
                 case JSON_TOKEN_OBJECT_CLOSE:
                         if (!IN_SET(current->expect, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_COMMA)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        assert(n_stack > 1);
+                        assert(parser->n_stack > 1);
 
-                        r = json_variant_new_object(&add, current->elements, current->n_elements);
+                        r = json_variant_new_object_internal(parser->arena, &add, current->elements, current->n_elements);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         line_token = current->line_before;
                         column_token = current->column_before;
 
+                        if (parser->arena)
+                                json_arena_recycle(parser->arena, current->elements, current->n_elements);
                         json_stack_release(current);
-                        n_stack--, current--;
+                        parser->n_stack--, current--;
 
                         break;
 
                 case JSON_TOKEN_ARRAY_OPEN:
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        if (!GREEDY_REALLOC(stack, n_stack+1)) {
-                                r = -ENOMEM;
-                                goto finish;
+                        if (!GREEDY_REALLOC(parser->stack, parser->n_stack+1)) {
+                                return -ENOMEM;
                         }
-                        current = stack + n_stack - 1;
+                        current = parser->stack + parser->n_stack - 1;
 
                         /* Prepare the expect for when we return from the child */
                         if (current->expect == EXPECT_TOPLEVEL)
@@ -3000,7 +3436,7 @@ static int json_parse_internal(
                                 current->expect = EXPECT_ARRAY_COMMA;
                         }
 
-                        stack[n_stack++] = (JsonStack) {
+                        parser->stack[parser->n_stack++] = (JsonStack) {
                                 .expect = EXPECT_ARRAY_FIRST_ELEMENT,
                                 .line_before = line_token,
                                 .column_before = column_token,
@@ -3010,32 +3446,32 @@ static int json_parse_internal(
 
                 case JSON_TOKEN_ARRAY_CLOSE:
                         if (!IN_SET(current->expect, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_COMMA)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        assert(n_stack > 1);
+                        assert(parser->n_stack > 1);
 
-                        r = json_variant_new_array(&add, current->elements, current->n_elements);
+                        r = json_variant_new_array_internal(parser->arena, &add, current->elements, current->n_elements);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         line_token = current->line_before;
                         column_token = current->column_before;
 
+                        if (parser->arena)
+                                json_arena_recycle(parser->arena, current->elements, current->n_elements);
                         json_stack_release(current);
-                        n_stack--, current--;
+                        parser->n_stack--, current--;
                         break;
 
                 case JSON_TOKEN_STRING:
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_NEXT_KEY, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        r = json_variant_new_string(&add, string);
+                        r = json_parser_new_value(parser, token, string, &value, &add);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         if (current->expect == EXPECT_TOPLEVEL)
                                 current->expect = EXPECT_END;
@@ -3052,13 +3488,12 @@ static int json_parse_internal(
 
                 case JSON_TOKEN_REAL:
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        r = json_variant_new_real(&add, value.real);
+                        r = json_parser_new_value(parser, token, string, &value, &add);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         if (current->expect == EXPECT_TOPLEVEL)
                                 current->expect = EXPECT_END;
@@ -3073,13 +3508,12 @@ static int json_parse_internal(
 
                 case JSON_TOKEN_INTEGER:
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        r = json_variant_new_integer(&add, value.integer);
+                        r = json_parser_new_value(parser, token, string, &value, &add);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         if (current->expect == EXPECT_TOPLEVEL)
                                 current->expect = EXPECT_END;
@@ -3094,13 +3528,12 @@ static int json_parse_internal(
 
                 case JSON_TOKEN_UNSIGNED:
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        r = json_variant_new_unsigned(&add, value.unsig);
+                        r = json_parser_new_value(parser, token, string, &value, &add);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         if (current->expect == EXPECT_TOPLEVEL)
                                 current->expect = EXPECT_END;
@@ -3115,13 +3548,12 @@ static int json_parse_internal(
 
                 case JSON_TOKEN_BOOLEAN:
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        r = json_variant_new_boolean(&add, value.boolean);
+                        r = json_parser_new_value(parser, token, string, &value, &add);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         if (current->expect == EXPECT_TOPLEVEL)
                                 current->expect = EXPECT_END;
@@ -3136,13 +3568,12 @@ static int json_parse_internal(
 
                 case JSON_TOKEN_NULL:
                         if (!IN_SET(current->expect, EXPECT_TOPLEVEL, EXPECT_OBJECT_VALUE, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT)) {
-                                r = -EINVAL;
-                                goto finish;
+                                return -EINVAL;
                         }
 
-                        r = json_variant_new_null(&add);
+                        r = json_parser_new_value(parser, token, string, &value, &add);
                         if (r < 0)
-                                goto finish;
+                                return r;
 
                         if (current->expect == EXPECT_TOPLEVEL)
                                 current->expect = EXPECT_END;
@@ -3163,14 +3594,15 @@ static int json_parse_internal(
                         /* If we are asked to make this parsed object sensitive, then let's apply this
                          * immediately after allocating each variant, so that when we abort half-way
                          * everything we already allocated that is then freed is correctly marked. */
-                        if (FLAGS_SET(flags, JSON_PARSE_SENSITIVE))
+                        if (FLAGS_SET(parser->flags, JSON_PARSE_SENSITIVE))
                                 json_variant_sensitive(add);
 
-                        (void) json_variant_set_source(&add, source, line_token, column_token);
+                        r = json_parser_set_source(parser, &add, line_token, column_token);
+                        if (r < 0)
+                                return r;
 
                         if (!GREEDY_REALLOC(current->elements, current->n_elements + 1)) {
-                                r = -ENOMEM;
-                                goto finish;
+                                return -ENOMEM;
                         }
 
                         current->elements[current->n_elements++] = TAKE_PTR(add);
@@ -3178,20 +3610,109 @@ static int json_parse_internal(
         }
 
 done:
-        assert(n_stack == 1);
-        assert(stack[0].n_elements == 1);
+        assert(parser->n_stack == 1);
+        assert(parser->stack[0].n_elements == 1);
 
-        *ret = json_variant_ref(stack[0].elements[0]);
+        *ret = json_variant_ref(parser->stack[0].elements[0]);
         *input = p;
-        r = 0;
+        return 1;
+}
 
-finish:
-        for (i = 0; i < n_stack; i++)
-                json_stack_release(stack + i);
+static int json_parse_internal(
+                const char **input,
+                JsonSource *source,
+                JsonParseFlags flags,
+                JsonVariant **ret,
+                unsigned *line,
+                unsigned *column,
+                bool continue_end) {
 
-        free(stack);
+        _cleanup_(json_parser_done) JsonParser parser = {
+                .source = source,
+                .flags = flags,
+        };
+        int r;
 
-        return r;
+        assert_return(input, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        r = json_parser_start(&parser);
+        if (r < 0)
+                return r;
+
+        r = json_parser_run(&parser, input, /* final= */ true, continue_end, ret);
+
+        if (line)
+                *line = parser.line;
+        if (column)
+                *column = parser.column;
+
+        return r < 0 ? r : 0;
+}
+
+int json_parser_new(JsonParseFlags flags, JsonParser **ret) {
+        _cleanup_(json_parser_freep) JsonParser *parser = NULL;
+        int r;
+
+        assert(ret);
+
+        parser = new(JsonParser, 1);
+        if (!parser)
+                return -ENOMEM;
+
+        *parser = (JsonParser) {
+                .flags = flags,
+        };
+
+        r = json_parser_start(parser);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(parser);
+        return 0;
+}
+
+JsonParser* json_parser_free(JsonParser *parser) {
+        if (!parser)
+                return NULL;
+
+        json_parser_done(parser);
+        return mfree(parser);
+}
+
+int json_parser_feed(JsonParser *parser, const char **input, bool final, JsonVariant **ret) {
+        int r;
+
+        assert(parser);
+        assert(input);
+        assert(*input);
+        assert(ret);
+
+        /* Parses a JSON document that is delivered piecemeal. *input must point to a NUL terminated prefix
+         * of the document, and 'final' indicates whether the document is actually complete with it. Returns
+         * 1 and the variant once the document was parsed completely, after which the parser may be used for
+         * the next document. Returns 0 if more input is needed: *input is updated to point to the input that
+         * was not consumed yet — which is the beginning of a token that might still be incomplete — and
+         * needs to be passed in again, extended by the data that arrives later. */
+
+        if (!final && parser->deferred > 0 && strnlen(*input, parser->deferred * 2) < parser->deferred * 2)
+                /* Don't bother tokenizing a potentially incomplete token again before its size doubled,
+                 * so that a large string trickling in doesn't result in quadratic work. */
+                return 0;
+
+        r = json_parser_run(parser, input, final, /* continue_end= */ false, ret);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                parser->deferred = strlen(*input);
+                return 0;
+        }
+
+        r = json_parser_start(parser);
+        if (r < 0)
+                return r;
+
+        return 1;
 }
 
 int json_parse(const char *input, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column) {
@@ -205,12 +205,20 @@ int json_variant_normalize(JsonVariant **v);
 
 typedef enum JsonParseFlags {
         JSON_PARSE_SENSITIVE = 1 << 0, /* mark variant as "sensitive", i.e. something containing secret key material or such */
+        JSON_PARSE_ARENA     = 1 << 1, /* allocate the whole tree in one go, and release it only once all of it is unused */
 } JsonParseFlags;
 
 int json_parse(const char *string, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column);
 int json_parse_continue(const char **p, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column);
 int json_parse_file_at(FILE *f, int dir_fd, const char *path, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column);
 
+typedef struct JsonParser JsonParser;
+
+int json_parser_new(JsonParseFlags flags, JsonParser **ret);
+JsonParser* json_parser_free(JsonParser *parser);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JsonParser*, json_parser_free);
+int json_parser_feed(JsonParser *parser, const char **input, bool final, JsonVariant **ret);
+
 static inline int json_parse_file(FILE *f, const char *path, JsonParseFlags flags, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column) {
         return json_parse_file_at(f, AT_FDCWD, path, flags, ret, ret_line, ret_column);
 }
@@ -25,6 +25,22 @@ int label_fix_container(const char *path, const char *inside_path, LabelFixFlags
         return 0;
 }
 
+int label_fix_container_fd(int fd, const char *path, const char *inside_path, LabelFixFlags flags) {
+        int r, q;
+
+        assert(fd >= 0);
+
+        r = mac_selinux_fix_container_fd(fd, path, inside_path, flags);
+        q = mac_smack_fix_container_fd(fd, path, inside_path, flags);
+
+        if (r < 0)
+                return r;
+        if (q < 0)
+                return q;
+
+        return 0;
+}
+
 int symlink_label(const char *old_path, const char *new_path) {
         int r;
 
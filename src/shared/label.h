@@ -14,6 +14,11 @@ static inline int label_fix(const char *path, LabelFixFlags flags) {
         return label_fix_container(path, path, flags);
 }
 
+int label_fix_container_fd(int fd, const char *path, const char *inside_path, LabelFixFlags flags);
+static inline int label_fix_fd(int fd, const char *path, LabelFixFlags flags) {
+        return label_fix_container_fd(fd, path, path, flags);
+}
+
 int mkdir_label(const char *path, mode_t mode);
 int mkdirat_label(int dirfd, const char *path, mode_t mode);
 int symlink_label(const char *old_path, const char *new_path);
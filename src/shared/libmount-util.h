@@ -10,6 +10,7 @@
 
 DEFINE_TRIVIAL_CLEANUP_FUNC_FULL(struct libmnt_table*, mnt_free_table, NULL);
 DEFINE_TRIVIAL_CLEANUP_FUNC_FULL(struct libmnt_iter*, mnt_free_iter, NULL);
+DEFINE_TRIVIAL_CLEANUP_FUNC_FULL(struct libmnt_tabdiff*, mnt_free_tabdiff, NULL);
 
 static inline int libmount_parse(
                 const char *path,
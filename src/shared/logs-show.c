@@ -2,6 +2,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -14,6 +15,7 @@
 
 #include "alloc-util.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "format-util.h"
 #include "hashmap.h"
 #include "hostname-util.h"
@@ -979,92 +981,70 @@ static int update_json_data_split(
         return update_json_data(h, flags, name, eq + 1, size - fieldlen - 1);
 }
 
-static int output_json(
-                FILE *f,
-                sd_journal *j,
-                OutputMode mode,
-                unsigned n_columns,
-                OutputFlags flags,
-                const Set *output_fields,
-                const size_t highlight[2]) {
-
-        char sid[SD_ID128_STRING_MAX], usecbuf[DECIMAL_STR_MAX(usec_t)];
-        _cleanup_(json_variant_unrefp) JsonVariant *object = NULL;
-        _cleanup_free_ char *cursor = NULL;
-        uint64_t realtime, monotonic;
-        JsonVariant **array = NULL;
+static Hashmap *json_data_hashmap_free(Hashmap *h) {
         struct json_data *d;
-        sd_id128_t boot_id;
-        Hashmap *h = NULL;
-        size_t n = 0;
-        int r;
 
-        assert(j);
+        while ((d = hashmap_steal_first(h))) {
+                json_variant_unref(d->name);
+                json_variant_unref_many(d->values, d->n_values);
+                free(d);
+        }
 
-        (void) sd_journal_set_data_threshold(j, flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD);
+        return hashmap_free(h);
+}
 
-        r = sd_journal_get_realtime_usec(j, &realtime);
-        if (r < 0)
-                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+DEFINE_TRIVIAL_CLEANUP_FUNC(Hashmap*, json_data_hashmap_free);
 
-        r = sd_journal_get_monotonic_usec(j, &monotonic, &boot_id);
-        if (r < 0)
-                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+static int update_json_data_header(
+                Hashmap *h,
+                OutputFlags flags,
+                const char *cursor,
+                usec_t realtime,
+                usec_t monotonic,
+                sd_id128_t boot_id) {
 
-        r = sd_journal_get_cursor(j, &cursor);
-        if (r < 0)
-                return log_error_errno(r, "Failed to get cursor: %m");
+        char sid[SD_ID128_STRING_MAX], usecbuf[DECIMAL_STR_MAX(usec_t)];
+        int r;
 
-        h = hashmap_new(&string_hash_ops);
-        if (!h)
-                return log_oom();
+        assert(h);
+        assert(cursor);
 
         r = update_json_data(h, flags, "__CURSOR", cursor, strlen(cursor));
         if (r < 0)
-                goto finish;
+                return r;
 
         xsprintf(usecbuf, USEC_FMT, realtime);
         r = update_json_data(h, flags, "__REALTIME_TIMESTAMP", usecbuf, strlen(usecbuf));
         if (r < 0)
-                goto finish;
+                return r;
 
         xsprintf(usecbuf, USEC_FMT, monotonic);
         r = update_json_data(h, flags, "__MONOTONIC_TIMESTAMP", usecbuf, strlen(usecbuf));
         if (r < 0)
-                goto finish;
+                return r;
 
         sd_id128_to_string(boot_id, sid);
-        r = update_json_data(h, flags, "_BOOT_ID", sid, strlen(sid));
-        if (r < 0)
-                goto finish;
+        return update_json_data(h, flags, "_BOOT_ID", sid, strlen(sid));
+}
 
-        for (;;) {
-                const void *data;
-                size_t size;
+static int output_json_data(
+                FILE *f,
+                OutputMode mode,
+                OutputFlags flags,
+                Hashmap *h) {
 
-                r = sd_journal_enumerate_data(j, &data, &size);
-                if (r == -EBADMSG) {
-                        log_debug_errno(r, "Skipping message we can't read: %m");
-                        r = 0;
-                        goto finish;
-                }
-                if (r < 0) {
-                        log_error_errno(r, "Failed to read journal: %m");
-                        goto finish;
-                }
-                if (r == 0)
-                        break;
+        _cleanup_(json_variant_unrefp) JsonVariant *object = NULL;
+        JsonVariant **array = NULL;
+        struct json_data *d;
+        size_t n = 0;
+        int r;
 
-                r = update_json_data_split(h, flags, output_fields, data, size);
-                if (r < 0)
-                        goto finish;
-        }
+        assert(f);
+        assert(h);
 
         array = new(JsonVariant*, hashmap_size(h)*2);
-        if (!array) {
-                r = log_oom();
-                goto finish;
-        }
+        if (!array)
+                return log_oom();
 
         HASHMAP_FOREACH(d, h) {
                 assert(d->n_values > 0);
@@ -1100,22 +1080,71 @@ static int output_json(
         r = 0;
 
 finish:
-        while ((d = hashmap_steal_first(h))) {
-                size_t k;
+        json_variant_unref_many(array, n);
+        free(array);
 
-                json_variant_unref(d->name);
-                for (k = 0; k < d->n_values; k++)
-                        json_variant_unref(d->values[k]);
+        return r;
+}
 
-                free(d);
-        }
+static int output_json(
+                FILE *f,
+                sd_journal *j,
+                OutputMode mode,
+                unsigned n_columns,
+                OutputFlags flags,
+                const Set *output_fields,
+                const size_t highlight[2]) {
+
+        _cleanup_(json_data_hashmap_freep) Hashmap *h = NULL;
+        _cleanup_free_ char *cursor = NULL;
+        uint64_t realtime, monotonic;
+        sd_id128_t boot_id;
+        int r;
 
-        hashmap_free(h);
+        assert(j);
 
-        json_variant_unref_many(array, n);
-        free(array);
+        (void) sd_journal_set_data_threshold(j, flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD);
 
-        return r;
+        r = sd_journal_get_realtime_usec(j, &realtime);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+
+        r = sd_journal_get_monotonic_usec(j, &monotonic, &boot_id);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+
+        r = sd_journal_get_cursor(j, &cursor);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cursor: %m");
+
+        h = hashmap_new(&string_hash_ops);
+        if (!h)
+                return log_oom();
+
+        r = update_json_data_header(h, flags, cursor, realtime, monotonic, boot_id);
+        if (r < 0)
+                return r;
+
+        for (;;) {
+                const void *data;
+                size_t size;
+
+                r = sd_journal_enumerate_data(j, &data, &size);
+                if (r == -EBADMSG) {
+                        log_debug_errno(r, "Skipping message we can't read: %m");
+                        return 0;
+                }
+                if (r < 0)
+                        return log_error_errno(r, "Failed to read journal: %m");
+                if (r == 0)
+                        break;
+
+                r = update_json_data_split(h, flags, output_fields, data, size);
+                if (r < 0)
+                        return r;
+        }
+
+        return output_json_data(f, mode, flags, h);
 }
 
 static int output_cat_field(
@@ -1406,6 +1435,345 @@ int show_journal(
         return 0;
 }
 
+typedef struct OutputJob {
+        /* Filled in by the reader */
+        char *cursor;
+        usec_t realtime, monotonic;
+        sd_id128_t boot_id;
+        struct iovec *fields;
+        size_t n_fields;
+        bool skip;
+
+        /* Filled in by the worker */
+        bool done;
+        char *buf;
+        size_t size;
+        int error;
+} OutputJob;
+
+struct OutputPipeline {
+        FILE *f;
+        OutputMode mode;
+        OutputFlags flags;
+        Set *output_fields;
+
+        pthread_t *threads;
+        size_t n_threads;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t work_cond;  /* signalled when a job got submitted, or when we shall quit */
+        pthread_cond_t done_cond;  /* signalled when a job got formatted */
+
+        /* Ring buffer of jobs. Jobs in [n_written, n_taken) are being formatted by a worker, jobs in
+         * [n_taken, n_submitted) are waiting for one. Serial numbers map to slots modulo n_jobs. */
+        OutputJob *jobs;
+        size_t n_jobs;
+        uint64_t n_submitted, n_taken, n_written;
+
+        bool quit;
+};
+
+static void output_job_clear(OutputJob *job) {
+        assert(job);
+
+        free(job->cursor);
+
+        for (size_t i = 0; i < job->n_fields; i++)
+                free(job->fields[i].iov_base);
+        free(job->fields);
+
+        free(job->buf);
+
+        *job = (OutputJob) {};
+}
+
+static int output_job_format(OutputPipeline *p, OutputJob *job) {
+        _cleanup_(json_data_hashmap_freep) Hashmap *h = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        int r;
+
+        assert(p);
+        assert(job);
+
+        if (job->skip)
+                return 0;
+
+        h = hashmap_new(&string_hash_ops);
+        if (!h)
+                return log_oom();
+
+        r = update_json_data_header(h, p->flags, job->cursor, job->realtime, job->monotonic, job->boot_id);
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; i < job->n_fields; i++) {
+                r = update_json_data_split(h, p->flags, p->output_fields, job->fields[i].iov_base, job->fields[i].iov_len);
+                if (r < 0)
+                        return r;
+        }
+
+        f = open_memstream_unlocked(&job->buf, &job->size);
+        if (!f)
+                return log_oom();
+
+        r = output_json_data(f, p->mode, p->flags, h);
+        if (r < 0)
+                return r;
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to format journal entry: %m");
+
+        return 0;
+}
+
+static void *output_pipeline_worker(void *userdata) {
+        OutputPipeline *p = userdata;
+
+        assert(p);
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        for (;;) {
+                OutputJob *job;
+
+                if (p->n_taken >= p->n_submitted) {
+                        if (p->quit)
+                                break;
+
+                        assert_se(pthread_cond_wait(&p->work_cond, &p->mutex) == 0);
+                        continue;
+                }
+
+                job = p->jobs + (p->n_taken++ % p->n_jobs);
+
+                /* Format without holding the lock, that's the whole point of having multiple workers */
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+                job->error = output_job_format(p, job);
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+                job->done = true;
+                assert_se(pthread_cond_signal(&p->done_cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return NULL;
+}
+
+OutputPipeline* output_pipeline_free(OutputPipeline *p) {
+        if (!p)
+                return NULL;
+
+        if (p->threads) {
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+                p->quit = true;
+                assert_se(pthread_cond_broadcast(&p->work_cond) == 0);
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+                for (size_t i = 0; i < p->n_threads; i++)
+                        (void) pthread_join(p->threads[i], NULL);
+
+                free(p->threads);
+        }
+
+        /* Anything not written out yet is dropped */
+        for (size_t i = 0; i < p->n_jobs; i++)
+                output_job_clear(p->jobs + i);
+        free(p->jobs);
+
+        set_free(p->output_fields);
+
+        assert_se(pthread_mutex_destroy(&p->mutex) == 0);
+        assert_se(pthread_cond_destroy(&p->work_cond) == 0);
+        assert_se(pthread_cond_destroy(&p->done_cond) == 0);
+
+        return mfree(p);
+}
+
+int output_pipeline_new(
+                FILE *f,
+                OutputMode mode,
+                OutputFlags flags,
+                char **output_fields,
+                unsigned n_threads,
+                OutputPipeline **ret) {
+
+        _cleanup_(output_pipeline_freep) OutputPipeline *p = NULL;
+        int r;
+
+        assert(f);
+        assert(mode >= 0);
+        assert(mode < _OUTPUT_MODE_MAX);
+        assert(n_threads > 0);
+        assert(ret);
+
+        /* Only the JSON formatter is independent of the sd_journal object once the entry's fields are read,
+         * hence only the JSON output modes may be formatted in parallel. */
+        if (!OUTPUT_MODE_IS_JSON(mode))
+                return -EOPNOTSUPP;
+
+        p = new(OutputPipeline, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *p = (OutputPipeline) {
+                .f = f,
+                .mode = mode,
+                .flags = flags,
+                .n_jobs = n_threads * OUTPUT_PIPELINE_JOBS_PER_THREAD,
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .work_cond = PTHREAD_COND_INITIALIZER,
+                .done_cond = PTHREAD_COND_INITIALIZER,
+        };
+
+        r = set_put_strdupv(&p->output_fields, output_fields);
+        if (r < 0)
+                return r;
+
+        p->jobs = new0(OutputJob, p->n_jobs);
+        if (!p->jobs)
+                return -ENOMEM;
+
+        p->threads = new(pthread_t, n_threads);
+        if (!p->threads)
+                return -ENOMEM;
+
+        for (; p->n_threads < n_threads; p->n_threads++) {
+                r = pthread_create(p->threads + p->n_threads, NULL, output_pipeline_worker, p);
+                if (r != 0)
+                        return -r;
+        }
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+static int output_pipeline_write(OutputPipeline *p, uint64_t max_pending) {
+        int r = 0;
+
+        assert(p);
+
+        /* Writes out formatted jobs in the order they were submitted. Waits for the workers until at most
+         * max_pending jobs are left, then writes out whatever else is ready without waiting. */
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        while (p->n_written < p->n_submitted) {
+                OutputJob *job = p->jobs + (p->n_written % p->n_jobs);
+
+                if (!job->done) {
+                        if (p->n_submitted - p->n_written <= max_pending)
+                                break;
+
+                        assert_se(pthread_cond_wait(&p->done_cond, &p->mutex) == 0);
+                        continue;
+                }
+
+                /* Done jobs are not touched by workers anymore, hence write without holding the lock */
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+                if (job->error < 0) {
+                        if (r >= 0)
+                                r = job->error;
+                } else if (job->size > 0)
+                        fwrite(job->buf, 1, job->size, p->f);
+
+                output_job_clear(job);
+
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+                p->n_written++;
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return r;
+}
+
+int output_pipeline_submit(OutputPipeline *p, sd_journal *j) {
+        OutputJob *job;
+        int r;
+
+        assert(p);
+        assert(j);
+
+        /* Make room for one more job, writing out completed ones on the way */
+        r = output_pipeline_write(p, p->n_jobs - 1);
+        if (r < 0)
+                return r;
+
+        /* The slot after the last submitted one is neither looked at by workers nor by the writer, hence we
+         * can fill it in without taking the lock. */
+        job = p->jobs + (p->n_submitted % p->n_jobs);
+        assert(!job->done);
+
+        (void) sd_journal_set_data_threshold(j, p->flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD);
+
+        r = sd_journal_get_realtime_usec(j, &job->realtime);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+
+        r = sd_journal_get_monotonic_usec(j, &job->monotonic, &job->boot_id);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+
+        r = sd_journal_get_cursor(j, &job->cursor);
+        if (r < 0) {
+                output_job_clear(job);
+                return log_error_errno(r, "Failed to get cursor: %m");
+        }
+
+        /* Reading the fields (and decompressing them) has to happen here, as sd_journal is not thread
+         * safe, but everything after that, i.e. validation, building the JSON object and serializing it, is
+         * left to the workers. */
+        for (;;) {
+                const void *data;
+                size_t size;
+                void *copy;
+
+                r = sd_journal_enumerate_data(j, &data, &size);
+                if (r == -EBADMSG) {
+                        log_debug_errno(r, "Skipping message we can't read: %m");
+                        job->skip = true;
+                        break;
+                }
+                if (r < 0) {
+                        output_job_clear(job);
+                        return log_error_errno(r, "Failed to read journal: %m");
+                }
+                if (r == 0)
+                        break;
+
+                copy = memdup(data, size);
+                if (!copy || !GREEDY_REALLOC(job->fields, job->n_fields + 1)) {
+                        free(copy);
+                        output_job_clear(job);
+                        return log_oom();
+                }
+
+                job->fields[job->n_fields++] = IOVEC_MAKE(copy, size);
+        }
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        p->n_submitted++;
+        assert_se(pthread_cond_signal(&p->work_cond) == 0);
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return 0;
+}
+
+int output_pipeline_flush(OutputPipeline *p) {
+        int r;
+
+        assert(p);
+
+        r = output_pipeline_write(p, 0);
+        if (r < 0)
+                return r;
+
+        return fflush_and_check(p->f);
+}
+
 int add_matches_for_unit(sd_journal *j, const char *unit) {
         const char *m1, *m2, *m3, *m4;
         int r;
@@ -32,6 +32,25 @@ int show_journal(
                 OutputFlags flags,
                 bool *ellipsized);
 
+/* Formats entries on a pool of worker threads while the caller keeps reading the journal, and writes them
+ * out in the order they were submitted. Only supported for the JSON output modes. */
+typedef struct OutputPipeline OutputPipeline;
+
+#define OUTPUT_PIPELINE_JOBS_PER_THREAD 64U
+
+int output_pipeline_new(
+                FILE *f,
+                OutputMode mode,
+                OutputFlags flags,
+                char **output_fields,
+                unsigned n_threads,
+                OutputPipeline **ret);
+OutputPipeline* output_pipeline_free(OutputPipeline *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(OutputPipeline*, output_pipeline_free);
+
+int output_pipeline_submit(OutputPipeline *p, sd_journal *j);
+int output_pipeline_flush(OutputPipeline *p);
+
 int add_match_this_boot(sd_journal *j, const char *machine);
 
 int add_matches_for_unit(
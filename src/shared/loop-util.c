@@ -18,6 +18,7 @@
 #include "alloc-util.h"
 #include "blockdev-util.h"
 #include "device-util.h"
+#include "env-util.h"
 #include "errno-util.h"
 #include "fd-util.h"
 #include "fileio.h"
@@ -530,6 +531,15 @@ int loop_device_make_by_path(
         } else if (open_flags < 0)
                 open_flags = O_RDWR;
 
+        /* Use direct I/O by default, so that the data isn't cached twice, once in the page cache of the
+         * backing file and once in the one of the loopback block device. The kernel turns it off again
+         * by itself if the backing file system or the alignment of the image doesn't allow it. */
+        r = getenv_bool("SYSTEMD_LOOP_DIRECT_IO");
+        if (r < 0 && r != -ENXIO)
+                log_debug_errno(r, "Failed to parse $SYSTEMD_LOOP_DIRECT_IO, ignoring: %m");
+        if (r != 0)
+                loop_flags |= LO_FLAGS_DIRECT_IO;
+
         return loop_device_make(fd, open_flags, 0, 0, loop_flags, ret);
 }
 
@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "metrics.h"
+#include "string-table.h"
+#include "util.h"
+
+static usec_t latency_histogram_bucket_limit(unsigned i) {
+        assert(i < LATENCY_HISTOGRAM_BUCKETS);
+
+        if (i == LATENCY_HISTOGRAM_BUCKETS - 1)
+                return USEC_INFINITY;
+
+        return (UINT64_C(1) << i) * USEC_PER_MSEC;
+}
+
+void latency_histogram_add(LatencyHistogram *h, usec_t latency) {
+        usec_t ms;
+        unsigned i;
+
+        assert(h);
+
+        ms = latency / USEC_PER_MSEC;
+        i = ms == 0 ? 0 : u64log2(ms) + 1;
+
+        h->buckets[MIN(i, LATENCY_HISTOGRAM_BUCKETS - 1U)]++;
+        h->n++;
+        h->sum = usec_add(h->sum, latency);
+}
+
+usec_t latency_histogram_percentile(const LatencyHistogram *h, unsigned percent) {
+        uint64_t threshold, n = 0;
+
+        assert(h);
+        assert(percent <= 100);
+
+        /* Returns the upper limit of the bucket the percentile falls into, or USEC_INFINITY if that's the
+         * last bucket or there's no data. */
+
+        if (h->n == 0)
+                return USEC_INFINITY;
+
+        threshold = DIV_ROUND_UP(h->n * percent, 100U);
+
+        for (unsigned i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+                n += h->buckets[i];
+                if (n >= threshold)
+                        return latency_histogram_bucket_limit(i);
+        }
+
+        return USEC_INFINITY;
+}
+
+int latency_histogram_build_json(const LatencyHistogram *h, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *buckets = NULL;
+        usec_t p50, p90, p99;
+        int r;
+
+        assert(h);
+        assert(ret);
+
+        r = json_variant_new_array(&buckets, NULL, 0);
+        if (r < 0)
+                return r;
+
+        for (unsigned i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+                usec_t limit = latency_histogram_bucket_limit(i);
+
+                if (h->buckets[i] == 0)
+                        continue;
+
+                r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR_CONDITION(limit != USEC_INFINITY, "belowUSec", JSON_BUILD_UNSIGNED(limit)),
+                                       JSON_BUILD_PAIR("count", JSON_BUILD_UNSIGNED(h->buckets[i]))));
+                if (r < 0)
+                        return r;
+
+                r = json_variant_append_array(&buckets, v);
+                if (r < 0)
+                        return r;
+        }
+
+        p50 = latency_histogram_percentile(h, 50);
+        p90 = latency_histogram_percentile(h, 90);
+        p99 = latency_histogram_percentile(h, 99);
+
+        return json_build(ret, JSON_BUILD_OBJECT(
+                                 JSON_BUILD_PAIR("count", JSON_BUILD_UNSIGNED(h->n)),
+                                 JSON_BUILD_PAIR_CONDITION(h->n > 0, "averageUSec", JSON_BUILD_UNSIGNED(h->sum / MAX(h->n, UINT64_C(1)))),
+                                 JSON_BUILD_PAIR_CONDITION(p50 != USEC_INFINITY, "p50USec", JSON_BUILD_UNSIGNED(p50)),
+                                 JSON_BUILD_PAIR_CONDITION(p90 != USEC_INFINITY, "p90USec", JSON_BUILD_UNSIGNED(p90)),
+                                 JSON_BUILD_PAIR_CONDITION(p99 != USEC_INFINITY, "p99USec", JSON_BUILD_UNSIGNED(p99)),
+                                 JSON_BUILD_PAIR("buckets", JSON_BUILD_VARIANT(buckets))));
+}
+
+static const char* const metric_type_table[_METRIC_TYPE_MAX] = {
+        [METRIC_COUNTER]   = "counter",
+        [METRIC_GAUGE]     = "gauge",
+        [METRIC_HISTOGRAM] = "histogram",
+};
+DEFINE_STRING_TABLE_LOOKUP_TO_STRING(metric_type, MetricType);
+
+static int metric_build_json(const Metric *metric, void *userdata, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *value = NULL;
+        int r;
+
+        assert(metric);
+        assert(ret);
+
+        switch (metric->type) {
+
+        case METRIC_COUNTER:
+        case METRIC_GAUGE:
+                assert(metric->get_value);
+
+                r = json_variant_new_unsigned(&value, metric->get_value(userdata));
+                break;
+
+        case METRIC_HISTOGRAM:
+                assert(metric->get_histogram);
+
+                r = latency_histogram_build_json(metric->get_histogram(userdata), &value);
+                break;
+
+        default:
+                assert_not_reached();
+        }
+        if (r < 0)
+                return r;
+
+        return json_build(ret, JSON_BUILD_OBJECT(
+                                 JSON_BUILD_PAIR("name", JSON_BUILD_STRING(metric->name)),
+                                 JSON_BUILD_PAIR("type", JSON_BUILD_STRING(metric_type_to_string(metric->type))),
+                                 JSON_BUILD_PAIR_CONDITION(metric->description, "description", JSON_BUILD_STRING(metric->description)),
+                                 JSON_BUILD_PAIR("value", JSON_BUILD_VARIANT(value))));
+}
+
+int metrics_build_json(const Metric *metrics, size_t n_metrics, void *userdata, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *array = NULL;
+        int r;
+
+        assert(metrics || n_metrics == 0);
+        assert(ret);
+
+        r = json_variant_new_array(&array, NULL, 0);
+        if (r < 0)
+                return r;
+
+        for (size_t i = 0; i < n_metrics; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                r = metric_build_json(metrics + i, userdata, &v);
+                if (r < 0)
+                        return r;
+
+                r = json_variant_append_array(&array, v);
+                if (r < 0)
+                        return r;
+        }
+
+        return json_build(ret, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("metrics", JSON_BUILD_VARIANT(array))));
+}
+
+int metrics_method_list(Varlink *link, JsonVariant *parameters, const Metric *metrics, size_t n_metrics, void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        int r;
+
+        assert(link);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        r = metrics_build_json(metrics, n_metrics, userdata, &v);
+        if (r < 0)
+                return r;
+
+        return varlink_reply(link, v);
+}
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <inttypes.h>
+
+#include "json.h"
+#include "macro.h"
+#include "time-util.h"
+#include "varlink.h"
+
+/* Latencies are counted in buckets of exponentially growing size: bucket 0 counts latencies below 1ms,
+ * bucket i those below 2^i ms, and the last bucket everything beyond. */
+#define LATENCY_HISTOGRAM_BUCKETS 16
+
+typedef struct LatencyHistogram {
+        uint64_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+        uint64_t n;
+        usec_t sum;
+} LatencyHistogram;
+
+void latency_histogram_add(LatencyHistogram *h, usec_t latency);
+usec_t latency_histogram_percentile(const LatencyHistogram *h, unsigned percent);
+int latency_histogram_build_json(const LatencyHistogram *h, JsonVariant **ret);
+
+typedef enum MetricType {
+        METRIC_COUNTER,   /* monotonically increasing, e.g. the number of messages processed */
+        METRIC_GAUGE,     /* a current value that may go up and down, e.g. the number of open connections */
+        METRIC_HISTOGRAM, /* a LatencyHistogram */
+        _METRIC_TYPE_MAX,
+        _METRIC_TYPE_INVALID = -EINVAL,
+} MetricType;
+
+const char* metric_type_to_string(MetricType t) _const_;
+
+/* Describes one metric a daemon exposes. The values are not copied anywhere: the daemons keep counting in
+ * plain fields of their own objects, as before, and the getters are only called when somebody asks for
+ * the metrics, hence there's no cost on the hot paths. */
+typedef struct Metric {
+        const char *name;
+        const char *description;
+        MetricType type;
+        union {
+                uint64_t (*get_value)(void *userdata);                  /* METRIC_COUNTER, METRIC_GAUGE */
+                const LatencyHistogram* (*get_histogram)(void *userdata); /* METRIC_HISTOGRAM */
+        };
+} Metric;
+
+int metrics_build_json(const Metric *metrics, size_t n_metrics, void *userdata, JsonVariant **ret);
+
+/* Implements io.systemd.Metrics.List(), for daemons to call from their method handlers */
+int metrics_method_list(Varlink *link, JsonVariant *parameters, const Metric *metrics, size_t n_metrics, void *userdata);
@@ -138,6 +138,55 @@ int umount_recursive(const char *prefix, int flags) {
 
 /* Use this function only if you do not have direct access to /proc/self/mountinfo but the caller can open it
  * for you. This is the case when /proc is masked or not mounted. Otherwise, use bind_remount_recursive. */
+static uint64_t ms_flags_to_mount_attr(unsigned long flags) {
+        uint64_t attr = 0;
+
+        if (FLAGS_SET(flags, MS_RDONLY))
+                attr |= MOUNT_ATTR_RDONLY;
+        if (FLAGS_SET(flags, MS_NOSUID))
+                attr |= MOUNT_ATTR_NOSUID;
+        if (FLAGS_SET(flags, MS_NODEV))
+                attr |= MOUNT_ATTR_NODEV;
+        if (FLAGS_SET(flags, MS_NOEXEC))
+                attr |= MOUNT_ATTR_NOEXEC;
+
+        return attr;
+}
+
+static int bind_remount_recursive_setattr(
+                const char *prefix,
+                unsigned long new_flags,
+                unsigned long flags_mask,
+                char **deny_list) {
+
+        char **i;
+
+        assert(prefix);
+
+        /* Applies the flags to the mount at 'prefix' and all its submounts in a single mount_setattr() call,
+         * instead of one remount per mount. This only works if there's nothing to exclude below the
+         * top-level mount, and only for the flags that have a per-mount attribute equivalent. The caller
+         * must make sure 'prefix' is a mount point, as otherwise the attributes would be applied to the
+         * mount it is located on. Returns < 0 if the caller should fall back to the slow path. */
+
+        if ((flags_mask & ~(MS_RDONLY|MS_NOSUID|MS_NODEV|MS_NOEXEC)) != 0)
+                return -EOPNOTSUPP;
+
+        STRV_FOREACH(i, deny_list)
+                if (path_startswith(*i, prefix) && !path_equal(*i, prefix))
+                        return -EOPNOTSUPP;
+
+        if (mount_setattr(AT_FDCWD, prefix, AT_SYMLINK_NOFOLLOW|AT_RECURSIVE,
+                          &(struct mount_attr) {
+                                  .attr_set = ms_flags_to_mount_attr(new_flags & flags_mask),
+                                  .attr_clr = ms_flags_to_mount_attr(~new_flags & flags_mask),
+                          }, sizeof(struct mount_attr)) < 0)
+                return log_debug_errno(errno, "Failed to change mount attributes of '%s' recursively, falling back to remounting one by one: %m", prefix);
+
+        log_debug("Remounted %s and its submounts.", prefix);
+        return 0;
+}
+
 int bind_remount_recursive_with_mountinfo(
                 const char *prefix,
                 unsigned long new_flags,
@@ -284,6 +333,11 @@ int bind_remount_recursive_with_mountinfo(
                 if (hashmap_isempty(todo))
                         return 0;
 
+                /* On the first iteration, try to do everything in one go, if the kernel supports that */
+                if (set_isempty(done) && !top_autofs &&
+                    bind_remount_recursive_setattr(prefix, new_flags, flags_mask, deny_list) >= 0)
+                        return 0;
+
                 for (;;) {
                         unsigned long flags;
                         char *x = NULL;
@@ -129,6 +129,18 @@ static int rm_rf_children_inner(
         assert(fd >= 0);
         assert(fname);
 
+        if (is_dir < 0 && !(flags & REMOVE_ONLY_DIRECTORIES)) {
+                /* If the file type is not known (i.e. the file system doesn't fill in d_type), optimistically
+                 * assume the common case of a non-directory and try to unlink it right away. This saves an
+                 * fstatat() per entry. Linux returns EISDIR for directories here (POSIX says EPERM), in which
+                 * case we continue below and find out what this really is. */
+                r = unlinkat_harder(fd, fname, 0, flags);
+                if (r >= 0)
+                        return 1;
+                if (!IN_SET(r, -EISDIR, -EPERM))
+                        return r;
+        }
+
         if (is_dir < 0 || (is_dir > 0 && (root_dev || (flags & REMOVE_SUBVOLUME)))) {
 
                 r = fstatat_harder(fd, fname, &st, AT_SYMLINK_NOFOLLOW, flags);
@@ -14,7 +14,9 @@
 #include "alloc-util.h"
 #include "env-util.h"
 #include "errno-list.h"
+#include "fd-util.h"
 #include "macro.h"
+#include "memfd-util.h"
 #include "nsflags.h"
 #include "nulstr-util.h"
 #include "process-util.h"
@@ -248,6 +250,163 @@ int seccomp_init_for_arch(scmp_filter_ctx *ret, uint32_t arch, uint32_t default_
         return 0;
 }
 
+#ifndef SECCOMP_FILTER_FLAG_LOG
+#define SECCOMP_FILTER_FLAG_LOG (1UL << 1)
+#endif
+
+/* While recording, the programs are appended here instead of being installed */
+static SeccompPrograms *seccomp_recording = NULL;
+static int seccomp_recording_error = 0;
+static uint32_t seccomp_recording_saved_archs[ELEMENTSOF(seccomp_local_archs)];
+
+SeccompPrograms* seccomp_programs_free(SeccompPrograms *p) {
+        if (!p)
+                return NULL;
+
+        for (size_t i = 0; i < p->n_programs; i++)
+                free(p->programs[i].instructions);
+        free(p->programs);
+
+        return mfree(p);
+}
+
+void seccomp_record_begin(SeccompPrograms *p) {
+        assert(p);
+        assert(!seccomp_recording);
+
+        /* seccomp_restrict_archs() blocks the architectures it filters out for all subsequent filters. That
+         * must only happen in the process that eventually installs the filters, hence restore the array
+         * once we are done. */
+        memcpy(seccomp_recording_saved_archs, seccomp_local_archs, sizeof(seccomp_local_archs));
+
+        seccomp_recording = p;
+        seccomp_recording_error = 0;
+}
+
+void seccomp_record_switch(SeccompPrograms *p) {
+        assert(p);
+        assert(seccomp_recording);
+
+        seccomp_recording = p;
+}
+
+int seccomp_record_end(void) {
+        assert(seccomp_recording);
+
+        memcpy(seccomp_local_archs, seccomp_recording_saved_archs, sizeof(seccomp_local_archs));
+        seccomp_recording = NULL;
+
+        return seccomp_recording_error;
+}
+
+static int seccomp_record(scmp_filter_ctx seccomp) {
+        _cleanup_free_ struct sock_filter *instructions = NULL;
+        _cleanup_close_ int fd = -1;
+        unsigned flags = 0;
+        struct stat st;
+        ssize_t n;
+        int r;
+
+        assert(seccomp);
+        assert(seccomp_recording);
+
+#if SCMP_VER_MAJOR >= 3 || (SCMP_VER_MAJOR == 2 && SCMP_VER_MINOR >= 4)
+        uint32_t log = 0;
+
+        r = seccomp_attr_get(seccomp, SCMP_FLTATR_CTL_LOG, &log);
+        if (r >= 0 && log != 0)
+                flags |= SECCOMP_FILTER_FLAG_LOG;
+#endif
+
+        fd = memfd_new("seccomp-bpf");
+        if (fd < 0)
+                return fd;
+
+        r = seccomp_export_bpf(seccomp, fd);
+        if (r < 0)
+                return r;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+        if (st.st_size <= 0 ||
+            st.st_size % sizeof(struct sock_filter) != 0 ||
+            (uint64_t) st.st_size / sizeof(struct sock_filter) > USHRT_MAX)
+                return -EBADMSG;
+
+        instructions = malloc(st.st_size);
+        if (!instructions)
+                return -ENOMEM;
+
+        n = pread(fd, instructions, st.st_size, 0);
+        if (n < 0)
+                return -errno;
+        if (n != st.st_size)
+                return -EIO;
+
+        if (!GREEDY_REALLOC(seccomp_recording->programs, seccomp_recording->n_programs + 1))
+                return -ENOMEM;
+
+        seccomp_recording->programs[seccomp_recording->n_programs++] = (SeccompProgram) {
+                .instructions = TAKE_PTR(instructions),
+                .n_instructions = st.st_size / sizeof(struct sock_filter),
+                .flags = flags,
+        };
+
+        return 0;
+}
+
+static int seccomp_load_filter(scmp_filter_ctx seccomp) {
+        int r;
+
+        assert(seccomp);
+
+        if (!seccomp_recording)
+                return seccomp_load(seccomp);
+
+        /* Callers skip filters that fail to install with non-fatal errors, but a program that could not be
+         * recorded must never be silently missing when installing the recorded programs later on. */
+        r = seccomp_record(seccomp);
+        if (r < 0 && seccomp_recording_error >= 0)
+                seccomp_recording_error = r;
+
+        return r;
+}
+
+int seccomp_programs_load(const SeccompPrograms *p) {
+        int r;
+
+        /* Installs programs recorded earlier with seccomp_record_begin(). No libseccomp involved. */
+
+        assert(p);
+
+        for (size_t i = 0; i < p->n_programs; i++) {
+                const SeccompProgram *program = p->programs + i;
+                struct sock_fprog prog = {
+                        .len = program->n_instructions,
+                        .filter = program->instructions,
+                };
+
+#ifdef __NR_seccomp
+                r = syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, program->flags, &prog);
+#else
+                errno = ENOSYS;
+                r = -1;
+#endif
+                /* seccomp() was added after the prctl() interface, which doesn't take any flags though */
+                if (r < 0 && errno == ENOSYS && program->flags == 0)
+                        r = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog, 0, 0);
+                if (r < 0) {
+                        if (ERRNO_IS_SECCOMP_FATAL(errno))
+                                return -errno;
+
+                        /* Same as when installing the filters right away */
+                        log_debug_errno(errno, "Failed to install seccomp filter, skipping: %m");
+                }
+        }
+
+        return 0;
+}
+
 static bool is_basic_seccomp_available(void) {
         return prctl(PR_GET_SECCOMP, 0, 0, 0, 0) >= 0;
 }
@@ -1052,7 +1211,7 @@ int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilter
                 if (r < 0)
                         return log_debug_errno(r, "Failed to add filter set: %m");
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1113,7 +1272,7 @@ int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* filter
                         }
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1304,7 +1463,7 @@ int seccomp_restrict_namespaces(unsigned long retain) {
                 if (r < 0)
                         continue;
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1347,7 +1506,7 @@ int seccomp_protect_sysctl(void) {
                         continue;
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1379,7 +1538,7 @@ int seccomp_protect_syslog(void) {
                         continue;
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1543,7 +1702,7 @@ int seccomp_restrict_address_families(Set *address_families, bool allow_list) {
                         }
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1620,7 +1779,7 @@ int seccomp_restrict_realtime(void) {
                         continue;
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1752,7 +1911,7 @@ int seccomp_memory_deny_write_execute(void) {
                                 continue;
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1821,7 +1980,7 @@ int seccomp_restrict_archs(Set *archs) {
         if (r < 0)
                 return r;
 
-        r = seccomp_load(seccomp);
+        r = seccomp_load_filter(seccomp);
         if (ERRNO_IS_SECCOMP_FATAL(r))
                 return r;
         if (r < 0)
@@ -1918,7 +2077,7 @@ int seccomp_lock_personality(unsigned long personality) {
                         continue;
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1959,7 +2118,7 @@ int seccomp_protect_hostname(void) {
                         continue;
                 }
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -2139,7 +2298,7 @@ int seccomp_restrict_suid_sgid(void) {
                 if (r < 0 && k < 0)
                         continue;
 
-                r = seccomp_load(seccomp);
+                r = seccomp_load_filter(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
                 if (r < 0)
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 #pragma once
 
+#include <linux/filter.h>
 #include <seccomp.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -17,6 +18,34 @@ int seccomp_init_for_arch(scmp_filter_ctx *ret, uint32_t arch, uint32_t default_
 
 bool is_seccomp_available(void);
 
+/* A seccomp filter compiled to BPF, ready to be installed */
+typedef struct SeccompProgram {
+        struct sock_filter *instructions;
+        size_t n_instructions;
+        unsigned flags;           /* SECCOMP_FILTER_FLAG_* to pass when installing the program */
+} SeccompProgram;
+
+struct SeccompPrograms {
+        SeccompProgram *programs;
+        size_t n_programs;
+};
+
+typedef struct SeccompPrograms SeccompPrograms;
+
+SeccompPrograms* seccomp_programs_free(SeccompPrograms *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(SeccompPrograms*, seccomp_programs_free);
+
+/* Between these two calls, the seccomp_xyz() calls below don't install any filters, but compile them and
+ * append them to the specified SeccompPrograms instead, so that they can be installed later, for example
+ * in a forked off child, with seccomp_programs_load(). seccomp_record_end() returns an error if any of
+ * the filters could not be recorded. seccomp_record_switch() continues recording into another
+ * SeccompPrograms, so that filters can be split up while the state carries over, e.g. the architectures
+ * blocked by seccomp_restrict_archs(). */
+void seccomp_record_begin(SeccompPrograms *p);
+void seccomp_record_switch(SeccompPrograms *p);
+int seccomp_record_end(void);
+int seccomp_programs_load(const SeccompPrograms *p);
+
 typedef struct SyscallFilterSet {
         const char *name;
         const char *help;
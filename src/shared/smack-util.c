@@ -231,6 +231,29 @@ int mac_smack_fix_container(const char *path, const char *inside_path, LabelFixF
         return smack_fix_fd(fd, inside_path, flags);
 }
 
+int mac_smack_fix_container_fd(int fd, const char *path, const char *inside_path, LabelFixFlags flags) {
+        _cleanup_free_ char *abspath = NULL;
+        int r;
+
+        assert(fd >= 0);
+        assert(inside_path);
+
+        /* Like mac_smack_fix_container(), but operates on an already opened fd, 'path' is only used for
+         * resolving a relative 'inside_path'. */
+
+        if (!mac_smack_use())
+                return 0;
+
+        if (!path_is_absolute(inside_path)) {
+                r = path_make_absolute_cwd(path ?: inside_path, &abspath);
+                if (r < 0)
+                        return r;
+                inside_path = abspath;
+        }
+
+        return smack_fix_fd(fd, inside_path, flags);
+}
+
 int mac_smack_copy(const char *dest, const char *src) {
         int r;
         _cleanup_free_ char *label = NULL;
@@ -282,6 +305,10 @@ int mac_smack_fix_at(int dirfd, const char *path, LabelFixFlags flags) {
         return 0;
 }
 
+int mac_smack_fix_container_fd(int fd, const char *path, const char *inside_path, LabelFixFlags flags) {
+        return 0;
+}
+
 int mac_smack_copy(const char *dest, const char *src) {
         return 0;
 }
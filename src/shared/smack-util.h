@@ -35,6 +35,7 @@ static inline int mac_smack_fix(const char *path, LabelFixFlags flags) {
 }
 
 int mac_smack_fix_at(int dirfd, const char *path, LabelFixFlags flags);
+int mac_smack_fix_container_fd(int fd, const char *path, const char *inside_path, LabelFixFlags flags);
 
 const char* smack_attr_to_string(SmackAttr i) _const_;
 SmackAttr smack_attr_from_string(const char *s) _pure_;
@@ -30,9 +30,12 @@ TSS2_RC (*sym_Esys_GetRandom)(ESYS_CONTEXT *esysContext, ESYS_TR shandle1, ESYS_
 TSS2_RC (*sym_Esys_Initialize)(ESYS_CONTEXT **esys_context,  TSS2_TCTI_CONTEXT *tcti, TSS2_ABI_VERSION *abiVersion) = NULL;
 TSS2_RC (*sym_Esys_Load)(ESYS_CONTEXT *esysContext, ESYS_TR parentHandle, ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3, const TPM2B_PRIVATE *inPrivate, const TPM2B_PUBLIC *inPublic, ESYS_TR *objectHandle) = NULL;
 TSS2_RC (*sym_Esys_PolicyGetDigest)(ESYS_CONTEXT *esysContext, ESYS_TR policySession, ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3, TPM2B_DIGEST **policyDigest) = NULL;
+TSS2_RC (*sym_Esys_ReadPublic)(ESYS_CONTEXT *esysContext, ESYS_TR objectHandle, ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3, TPM2B_PUBLIC **outPublic, TPM2B_NAME **name, TPM2B_NAME **qualifiedName) = NULL;
 TSS2_RC (*sym_Esys_PolicyPCR)(ESYS_CONTEXT *esysContext, ESYS_TR policySession, ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3, const TPM2B_DIGEST *pcrDigest, const TPML_PCR_SELECTION *pcrs) = NULL;
 TSS2_RC (*sym_Esys_StartAuthSession)(ESYS_CONTEXT *esysContext, ESYS_TR tpmKey, ESYS_TR bind, ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3, const TPM2B_NONCE *nonceCaller, TPM2_SE sessionType, const TPMT_SYM_DEF *symmetric, TPMI_ALG_HASH authHash, ESYS_TR *sessionHandle) = NULL;
 TSS2_RC (*sym_Esys_Startup)(ESYS_CONTEXT *esysContext, TPM2_SU startupType) = NULL;
+TSS2_RC (*sym_Esys_TR_Close)(ESYS_CONTEXT *esys_context, ESYS_TR *rsrc_handle) = NULL;
+TSS2_RC (*sym_Esys_TR_FromTPMPublic)(ESYS_CONTEXT *esysContext, TPM2_HANDLE tpm_handle, ESYS_TR optionalSession1, ESYS_TR optionalSession2, ESYS_TR optionalSession3, ESYS_TR *object) = NULL;
 TSS2_RC (*sym_Esys_Unseal)(ESYS_CONTEXT *esysContext, ESYS_TR itemHandle, ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3, TPM2B_SENSITIVE_DATA **outData) = NULL;
 
 const char* (*sym_Tss2_RC_Decode)(TSS2_RC rc) = NULL;
@@ -58,8 +61,11 @@ int dlopen_tpm2(void) {
                         DLSYM_ARG(Esys_Load),
                         DLSYM_ARG(Esys_PolicyGetDigest),
                         DLSYM_ARG(Esys_PolicyPCR),
+                        DLSYM_ARG(Esys_ReadPublic),
                         DLSYM_ARG(Esys_StartAuthSession),
                         DLSYM_ARG(Esys_Startup),
+                        DLSYM_ARG(Esys_TR_Close),
+                        DLSYM_ARG(Esys_TR_FromTPMPublic),
                         DLSYM_ARG(Esys_Unseal));
         if (r < 0)
                 return r;
@@ -255,37 +261,104 @@ static int tpm2_credit_random(ESYS_CONTEXT *c) {
         return 0;
 }
 
+static void log_tpm2_duration(const char *what, usec_t start) {
+        if (!DEBUG_LOGGING)
+                return;
+
+        log_debug("%s took %s.", what, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), start), 1));
+}
+
+static const TPM2B_PUBLIC primary_template = {
+        .size = sizeof(TPMT_PUBLIC),
+        .publicArea = {
+                .type = TPM2_ALG_ECC,
+                .nameAlg = TPM2_ALG_SHA256,
+                .objectAttributes = TPMA_OBJECT_RESTRICTED|TPMA_OBJECT_DECRYPT|TPMA_OBJECT_FIXEDTPM|TPMA_OBJECT_FIXEDPARENT|TPMA_OBJECT_SENSITIVEDATAORIGIN|TPMA_OBJECT_USERWITHAUTH,
+                .parameters = {
+                        .eccDetail = {
+                                .symmetric = {
+                                        .algorithm = TPM2_ALG_AES,
+                                        .keyBits.aes = 128,
+                                        .mode.aes = TPM2_ALG_CFB,
+                                },
+                                .scheme.scheme = TPM2_ALG_NULL,
+                                .curveID = TPM2_ECC_NIST_P256,
+                                .kdf.scheme = TPM2_ALG_NULL,
+                        },
+                },
+        },
+};
+
+/* The handle a storage root key is conventionally made persistent at */
+#define TPM2_SRK_HANDLE UINT32_C(0x81000001)
+
+static int tpm2_get_srk(
+                ESYS_CONTEXT *c,
+                ESYS_TR *ret_srk) {
+
+        _cleanup_(Esys_Freep) TPM2B_PUBLIC *public = NULL;
+        const TPMT_PUBLIC *a, *b = &primary_template.publicArea;
+        ESYS_TR srk = ESYS_TR_NONE;
+        TSS2_RC rc;
+
+        assert(c);
+        assert(ret_srk);
+
+        /* Creating the primary key is by far the slowest operation on many TPMs. If the key was made
+         * persistent already, with the very same template we use, then the TPM derives the very same key
+         * from the owner seed, and we can just use it. Returns 0 if there's no such key. */
+
+        rc = sym_Esys_TR_FromTPMPublic(c, TPM2_SRK_HANDLE, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, &srk);
+        if (rc != TSS2_RC_SUCCESS) {
+                log_debug("No persistent primary key found on TPM: %s", sym_Tss2_RC_Decode(rc));
+                return 0;
+        }
+
+        rc = sym_Esys_ReadPublic(c, srk, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE, &public, NULL, NULL);
+        if (rc != TSS2_RC_SUCCESS) {
+                log_debug("Failed to read public part of persistent primary key, ignoring: %s", sym_Tss2_RC_Decode(rc));
+                goto unsuitable;
+        }
+
+        a = &public->publicArea;
+        if (a->type != b->type ||
+            a->nameAlg != b->nameAlg ||
+            a->objectAttributes != b->objectAttributes ||
+            a->authPolicy.size != 0 ||
+            a->parameters.eccDetail.symmetric.algorithm != b->parameters.eccDetail.symmetric.algorithm ||
+            a->parameters.eccDetail.symmetric.keyBits.aes != b->parameters.eccDetail.symmetric.keyBits.aes ||
+            a->parameters.eccDetail.symmetric.mode.aes != b->parameters.eccDetail.symmetric.mode.aes ||
+            a->parameters.eccDetail.scheme.scheme != b->parameters.eccDetail.scheme.scheme ||
+            a->parameters.eccDetail.curveID != b->parameters.eccDetail.curveID ||
+            a->parameters.eccDetail.kdf.scheme != b->parameters.eccDetail.kdf.scheme) {
+                log_debug("Persistent primary key on TPM was not created from our template, not using it.");
+                goto unsuitable;
+        }
+
+        log_debug("Using persistent primary key on TPM.");
+
+        *ret_srk = srk;
+        return 1;
+
+unsuitable:
+        (void) sym_Esys_TR_Close(c, &srk);
+        return 0;
+}
+
 static int tpm2_make_primary(
                 ESYS_CONTEXT *c,
                 ESYS_TR *ret_primary) {
 
         static const TPM2B_SENSITIVE_CREATE primary_sensitive = {};
-        static const TPM2B_PUBLIC primary_template = {
-                .size = sizeof(TPMT_PUBLIC),
-                .publicArea = {
-                        .type = TPM2_ALG_ECC,
-                        .nameAlg = TPM2_ALG_SHA256,
-                        .objectAttributes = TPMA_OBJECT_RESTRICTED|TPMA_OBJECT_DECRYPT|TPMA_OBJECT_FIXEDTPM|TPMA_OBJECT_FIXEDPARENT|TPMA_OBJECT_SENSITIVEDATAORIGIN|TPMA_OBJECT_USERWITHAUTH,
-                        .parameters = {
-                                .eccDetail = {
-                                        .symmetric = {
-                                                .algorithm = TPM2_ALG_AES,
-                                                .keyBits.aes = 128,
-                                                .mode.aes = TPM2_ALG_CFB,
-                                        },
-                                        .scheme.scheme = TPM2_ALG_NULL,
-                                        .curveID = TPM2_ECC_NIST_P256,
-                                        .kdf.scheme = TPM2_ALG_NULL,
-                                },
-                        },
-                },
-        };
         static const TPML_PCR_SELECTION creation_pcr = {};
         ESYS_TR primary = ESYS_TR_NONE;
         TSS2_RC rc;
+        usec_t start;
 
         log_debug("Creating primary key on TPM.");
 
+        start = now(CLOCK_MONOTONIC);
+
         rc = sym_Esys_CreatePrimary(
                         c,
                         ESYS_TR_RH_OWNER,
@@ -306,7 +379,7 @@ static int tpm2_make_primary(
                 return log_error_errno(SYNTHETIC_ERRNO(ENOTRECOVERABLE),
                                        "Failed to generate primary key in TPM: %s", sym_Tss2_RC_Decode(rc));
 
-        log_debug("Successfully created primary key on TPM.");
+        log_tpm2_duration("Creating primary key on TPM", start);
 
         *ret_primary = primary;
         return 0;
@@ -420,6 +493,7 @@ static int tpm2_make_pcr_session(
         _cleanup_(Esys_Freep) TPM2B_DIGEST *policy_digest = NULL;
         ESYS_TR session = ESYS_TR_NONE;
         TSS2_RC rc;
+        usec_t start;
         int r;
 
         assert(c);
@@ -436,6 +510,8 @@ static int tpm2_make_pcr_session(
                         return r;
         }
 
+        start = now(CLOCK_MONOTONIC);
+
         rc = sym_Esys_StartAuthSession(
                         c,
                         ESYS_TR_NONE,
@@ -452,8 +528,12 @@ static int tpm2_make_pcr_session(
                 return log_error_errno(SYNTHETIC_ERRNO(ENOTRECOVERABLE),
                                        "Failed to open session in TPM: %s", sym_Tss2_RC_Decode(rc));
 
+        log_tpm2_duration("Starting authentication session", start);
+
         log_debug("Configuring PCR policy.");
 
+        start = now(CLOCK_MONOTONIC);
+
         rc = sym_Esys_PolicyPCR(
                         c,
                         session,
@@ -468,6 +548,8 @@ static int tpm2_make_pcr_session(
                 goto finish;
         }
 
+        log_tpm2_duration("Configuring PCR policy", start);
+
         if (DEBUG_LOGGING || ret_policy_digest) {
                 log_debug("Acquiring policy digest.");
 
@@ -721,7 +803,7 @@ int tpm2_unseal(
                 size_t *ret_secret_size) {
 
         _cleanup_(tpm2_context_destroy) struct tpm2_context c = {};
-        ESYS_TR primary = ESYS_TR_NONE, session = ESYS_TR_NONE, hmac_key = ESYS_TR_NONE;
+        ESYS_TR primary = ESYS_TR_NONE, srk = ESYS_TR_NONE, session = ESYS_TR_NONE, hmac_key = ESYS_TR_NONE;
         _cleanup_(Esys_Freep) TPM2B_SENSITIVE_DATA* unsealed = NULL;
         _cleanup_(Esys_Freep) TPM2B_DIGEST *policy_digest = NULL;
         _cleanup_(erase_and_freep) char *secret = NULL;
@@ -729,7 +811,7 @@ int tpm2_unseal(
         TPM2B_PUBLIC public = {};
         size_t offset = 0;
         TSS2_RC rc;
-        usec_t start;
+        usec_t start, step_start;
         int r;
 
         assert(blob);
@@ -783,29 +865,61 @@ int tpm2_unseal(
                 return log_error_errno(SYNTHETIC_ERRNO(EPERM),
                                        "Current policy digest does not match stored policy digest, cancelling TPM2 authentication attempt.");
 
-        r = tpm2_make_primary(c.esys_context, &primary);
-        if (r < 0)
-                return r;
-
         log_debug("Loading HMAC key into TPM.");
 
-        rc = sym_Esys_Load(
-                        c.esys_context,
-                        primary,
-                        ESYS_TR_PASSWORD,
-                        ESYS_TR_NONE,
-                        ESYS_TR_NONE,
-                        &private,
-                        &public,
-                        &hmac_key);
-        if (rc != TSS2_RC_SUCCESS) {
-                r = log_error_errno(SYNTHETIC_ERRNO(ENOTRECOVERABLE),
-                                    "Failed to load HMAC key in TPM: %s", sym_Tss2_RC_Decode(rc));
-                goto finish;
+        r = tpm2_get_srk(c.esys_context, &srk);
+        if (r > 0) {
+                step_start = now(CLOCK_MONOTONIC);
+
+                rc = sym_Esys_Load(
+                                c.esys_context,
+                                srk,
+                                ESYS_TR_PASSWORD,
+                                ESYS_TR_NONE,
+                                ESYS_TR_NONE,
+                                &private,
+                                &public,
+                                &hmac_key);
+                if (rc == TSS2_RC_SUCCESS)
+                        log_tpm2_duration("Loading HMAC key into TPM", step_start);
+                else {
+                        /* Maybe the persistent key is in a different hierarchy or was created with a
+                         * different unique field after all. Let's do it the slow way then. */
+                        log_debug("Failed to load HMAC key below persistent primary key, creating primary key: %s",
+                                  sym_Tss2_RC_Decode(rc));
+                        hmac_key = ESYS_TR_NONE;
+                }
+        }
+
+        if (hmac_key == ESYS_TR_NONE) {
+                r = tpm2_make_primary(c.esys_context, &primary);
+                if (r < 0)
+                        goto finish;
+
+                step_start = now(CLOCK_MONOTONIC);
+
+                rc = sym_Esys_Load(
+                                c.esys_context,
+                                primary,
+                                ESYS_TR_PASSWORD,
+                                ESYS_TR_NONE,
+                                ESYS_TR_NONE,
+                                &private,
+                                &public,
+                                &hmac_key);
+                if (rc != TSS2_RC_SUCCESS) {
+                        r = log_error_errno(SYNTHETIC_ERRNO(ENOTRECOVERABLE),
+                                            "Failed to load HMAC key in TPM: %s", sym_Tss2_RC_Decode(rc));
+                        goto finish;
+                }
+
+                log_tpm2_duration("Loading HMAC key into TPM", step_start);
         }
 
         log_debug("Unsealing HMAC key.");
 
+        step_start = now(CLOCK_MONOTONIC);
+
         rc = sym_Esys_Unseal(
                         c.esys_context,
                         hmac_key,
@@ -819,6 +933,8 @@ int tpm2_unseal(
                 goto finish;
         }
 
+        log_tpm2_duration("Unsealing HMAC key", step_start);
+
         secret = memdup(unsealed->buffer, unsealed->size);
         explicit_bzero_safe(unsealed->buffer, unsealed->size);
         if (!secret) {
@@ -838,6 +954,8 @@ finish:
         primary = flush_context_verbose(c.esys_context, primary);
         session = flush_context_verbose(c.esys_context, session);
         hmac_key = flush_context_verbose(c.esys_context, hmac_key);
+        if (srk != ESYS_TR_NONE)
+                (void) sym_Esys_TR_Close(c.esys_context, &srk); /* Persistent, hence don't flush it from the TPM */
         return r;
 }
 
@@ -2,6 +2,8 @@
 
 #include <malloc.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 
 #include "alloc-util.h"
 #include "errno-util.h"
@@ -12,6 +14,7 @@
 #include "process-util.h"
 #include "selinux-util.h"
 #include "set.h"
+#include "signal-util.h"
 #include "socket-util.h"
 #include "string-table.h"
 #include "string-util.h"
@@ -78,6 +81,18 @@ typedef enum VarlinkState {
                VARLINK_PENDING_METHOD,                  \
                VARLINK_PENDING_METHOD_MORE)
 
+typedef struct VarlinkCall VarlinkCall;
+
+struct VarlinkCall {
+        /* A method call issued with varlink_invoke() or varlink_observe() that didn't get its final reply
+         * yet. If no reply callback is set for it, the connection's reply callback is used. */
+        VarlinkReply reply_callback;
+        void *userdata;
+        bool more;
+
+        LIST_FIELDS(VarlinkCall, calls);
+};
+
 struct Varlink {
         unsigned n_ref;
 
@@ -111,6 +126,11 @@ struct Varlink {
                           * at most. */
         unsigned n_pending;
 
+        /* Method calls may be pipelined, i.e. issued before the replies to earlier ones arrived. Replies
+         * arrive in the order the calls were issued, hence keep them in a FIFO. */
+        LIST_HEAD(VarlinkCall, calls);
+        VarlinkCall *calls_tail;
+
         int fd;
 
         char *input_buffer; /* valid data starts at input_buffer_index, ends at input_buffer_index+input_buffer_size */
@@ -118,6 +138,11 @@ struct Varlink {
         size_t input_buffer_size;
         size_t input_buffer_unscanned;
 
+        /* Incoming messages are parsed as they trickle in, and the input consumed so far is released. This
+         * counts the bytes of the current message that were already consumed. */
+        JsonParser *input_parser;
+        size_t input_parsed;
+
         char *output_buffer; /* valid data starts at output_buffer_index, ends at output_buffer_index+output_buffer_size */
         size_t output_buffer_index;
         size_t output_buffer_size;
@@ -161,6 +186,26 @@ struct VarlinkServerSocket {
         LIST_FIELDS(VarlinkServerSocket, sockets);
 };
 
+typedef struct VarlinkWork VarlinkWork;
+
+struct VarlinkWork {
+        /* A method call that is executed in a worker thread. Only 'callback', 'parameters', 'flags' and
+         * 'userdata' are accessed from the worker, and it only fills in the results. Everything else is
+         * only ever touched from the event loop thread. */
+        Varlink *link;
+        char *method;
+        VarlinkWorkMethod callback;
+        JsonVariant *parameters;
+        VarlinkMethodFlags flags;
+        void *userdata;
+
+        int result;
+        JsonVariant *reply;
+        const char *error_id;
+
+        LIST_FIELDS(VarlinkWork, work);
+};
+
 struct VarlinkServer {
         unsigned n_ref;
         VarlinkServerFlags flags;
@@ -168,6 +213,7 @@ struct VarlinkServer {
         LIST_HEAD(VarlinkServerSocket, sockets);
 
         Hashmap *methods;
+        Hashmap *work_methods;
         VarlinkConnect connect_callback;
         VarlinkDisconnect disconnect_callback;
 
@@ -182,6 +228,23 @@ struct VarlinkServer {
 
         unsigned connections_max;
         unsigned connections_per_uid_max;
+
+        /* Worker threads for methods bound with varlink_server_bind_work_method(). All fields below
+         * 'work_mutex' are protected by it. */
+        unsigned workers_max;
+        pthread_t *workers;
+        size_t n_workers;
+        int work_fd;
+        sd_event_source *work_event_source;
+
+        pthread_mutex_t work_mutex;
+        pthread_cond_t work_cond;
+        LIST_HEAD(VarlinkWork, work_queue);
+        VarlinkWork *work_queue_tail;
+        LIST_HEAD(VarlinkWork, work_done);
+        size_t n_work_queued;
+        size_t n_workers_busy;
+        bool work_exit;
 };
 
 static const char* const varlink_state_table[_VARLINK_STATE_MAX] = {
@@ -343,6 +406,58 @@ int varlink_connect_fd(Varlink **ret, int fd) {
         return 0;
 }
 
+static int varlink_push_call(Varlink *v, VarlinkReply reply_callback, void *userdata, bool more) {
+        VarlinkCall *c;
+
+        assert(v);
+
+        c = new(VarlinkCall, 1);
+        if (!c)
+                return -ENOMEM;
+
+        *c = (VarlinkCall) {
+                .reply_callback = reply_callback,
+                .userdata = userdata,
+                .more = more,
+        };
+
+        LIST_INSERT_AFTER(calls, v->calls, v->calls_tail, c);
+        v->calls_tail = c;
+        v->n_pending++;
+
+        return 0;
+}
+
+static VarlinkCall *varlink_pop_call(Varlink *v) {
+        VarlinkCall *c;
+
+        assert(v);
+
+        c = v->calls;
+        if (!c)
+                return NULL;
+
+        LIST_REMOVE(calls, v->calls, c);
+        if (v->calls_tail == c)
+                v->calls_tail = NULL;
+
+        assert(v->n_pending > 0);
+        v->n_pending--;
+
+        return c;
+}
+
+static VarlinkState varlink_calls_state(Varlink *v) {
+        assert(v);
+
+        /* The client state after a call completed: determined by the oldest call still pending, if any */
+
+        if (!v->calls)
+                return VARLINK_IDLE_CLIENT;
+
+        return v->calls->more ? VARLINK_AWAITING_REPLY_MORE : VARLINK_AWAITING_REPLY;
+}
+
 static void varlink_detach_event_sources(Varlink *v) {
         assert(v);
 
@@ -360,11 +475,15 @@ static void varlink_clear(Varlink *v) {
         v->fd = safe_close(v->fd);
 
         v->input_buffer = mfree(v->input_buffer);
+        v->input_parser = json_parser_free(v->input_parser);
         v->output_buffer = mfree(v->output_buffer);
 
         v->current = json_variant_unref(v->current);
         v->reply = json_variant_unref(v->reply);
 
+        while (v->calls)
+                free(varlink_pop_call(v));
+
         v->event = sd_event_unref(v->event);
 }
 
@@ -500,25 +619,26 @@ static int varlink_read(Varlink *v) {
         if (v->read_disconnected)
                 return 0;
 
-        if (v->input_buffer_size >= VARLINK_BUFFER_MAX)
+        if (v->input_parsed + v->input_buffer_size >= VARLINK_BUFFER_MAX)
                 return -ENOBUFS;
 
         assert(v->fd >= 0);
 
-        if (MALLOC_SIZEOF_SAFE(v->input_buffer) <= v->input_buffer_index + v->input_buffer_size) {
+        /* Always keep one byte free after the data, so that we can NUL terminate it for parsing */
+        if (MALLOC_SIZEOF_SAFE(v->input_buffer) <= v->input_buffer_index + v->input_buffer_size + 1) {
                 size_t add;
 
-                add = MIN(VARLINK_BUFFER_MAX - v->input_buffer_size, VARLINK_READ_SIZE);
+                add = MIN(VARLINK_BUFFER_MAX - v->input_parsed - v->input_buffer_size, VARLINK_READ_SIZE);
 
                 if (v->input_buffer_index == 0) {
 
-                        if (!GREEDY_REALLOC(v->input_buffer, v->input_buffer_size + add))
+                        if (!GREEDY_REALLOC(v->input_buffer, v->input_buffer_size + add + 1))
                                 return -ENOMEM;
 
                 } else {
                         char *b;
 
-                        b = new(char, v->input_buffer_size + add);
+                        b = new(char, v->input_buffer_size + add + 1);
                         if (!b)
                                 return -ENOMEM;
 
@@ -529,7 +649,7 @@ static int varlink_read(Varlink *v) {
                 }
         }
 
-        rs = MALLOC_SIZEOF_SAFE(v->input_buffer) - (v->input_buffer_index + v->input_buffer_size);
+        rs = MALLOC_SIZEOF_SAFE(v->input_buffer) - (v->input_buffer_index + v->input_buffer_size) - 1;
 
         bool prefer_read = v->prefer_read_write;
         if (!prefer_read) {
@@ -562,7 +682,8 @@ static int varlink_read(Varlink *v) {
 }
 
 static int varlink_parse_message(Varlink *v) {
-        const char *e, *begin;
+        const char *e, *p;
+        char *begin;
         size_t sz;
         int r;
 
@@ -574,29 +695,54 @@ static int varlink_parse_message(Varlink *v) {
                 return 0;
 
         assert(v->input_buffer_unscanned <= v->input_buffer_size);
-        assert(v->input_buffer_index + v->input_buffer_size <= MALLOC_SIZEOF_SAFE(v->input_buffer));
+        assert(v->input_buffer_index + v->input_buffer_size < MALLOC_SIZEOF_SAFE(v->input_buffer));
 
         begin = v->input_buffer + v->input_buffer_index;
 
         e = memchr(begin + v->input_buffer_size - v->input_buffer_unscanned, 0, v->input_buffer_unscanned);
-        if (!e) {
-                v->input_buffer_unscanned = 0;
-                return 0;
-        }
 
-        sz = e - begin + 1;
+        if (!v->input_parser) {
+                r = json_parser_new(JSON_PARSE_ARENA, &v->input_parser);
+                if (r < 0)
+                        return r;
+        }
 
-        varlink_log(v, "New incoming message: %s", begin); /* FIXME: should we output the whole message here before validation?
-                                                            * This may produce a non-printable journal entry if the message
-                                                            * is invalid. We may also expose privileged information. */
+        /* Parse as much as we have already, even if the message is not complete yet, so that we can release
+         * the input consumed, and don't have to start from scratch once the rest arrived. */
+        if (!e)
+                begin[v->input_buffer_size] = 0; /* We reserved the space for this in varlink_read() */
 
-        r = json_parse(begin, 0, &v->current, NULL, NULL);
+        p = begin;
+        r = json_parser_feed(v->input_parser, &p, /* final= */ !!e, &v->current);
         if (r < 0) {
                 /* If we encounter a parse failure flush all data. We cannot possibly recover from this,
                  * hence drop all buffered data now. */
-                v->input_buffer_index = v->input_buffer_size = v->input_buffer_unscanned = 0;
+                v->input_buffer_index = v->input_buffer_size = v->input_buffer_unscanned = v->input_parsed = 0;
+                v->input_parser = json_parser_free(v->input_parser);
                 return varlink_log_errno(v, r, "Failed to parse JSON: %m");
         }
+        if (r == 0) {
+                assert(!e);
+
+                sz = p - begin;
+                v->input_parsed += sz;
+                v->input_buffer_size -= sz;
+                v->input_buffer_index = v->input_buffer_size == 0 ? 0 : v->input_buffer_index + sz;
+                v->input_buffer_unscanned = 0;
+                return 0;
+        }
+
+        sz = e - begin + 1;
+        v->input_parsed = 0;
+
+        if (DEBUG_LOGGING) {
+                _cleanup_free_ char *text = NULL;
+
+                /* FIXME: should we output the whole message here before validation? We may expose
+                 * privileged information. */
+                (void) json_variant_format(v->current, 0, &text);
+                varlink_log(v, "New incoming message: %s", strna(text));
+        }
 
         v->input_buffer_size -= sz;
 
@@ -631,6 +777,19 @@ static int varlink_dispatch_local_error(Varlink *v, const char *error) {
         assert(v);
         assert(error);
 
+        /* All calls still pending fail, oldest first. The connection's reply callback is notified once in
+         * any case, and thus covers all calls without a reply callback of their own. */
+        while (v->calls) {
+                _cleanup_free_ VarlinkCall *c = varlink_pop_call(v);
+
+                if (!c->reply_callback)
+                        continue;
+
+                r = c->reply_callback(v, NULL, error, VARLINK_REPLY_ERROR|VARLINK_REPLY_LOCAL, c->userdata);
+                if (r < 0)
+                        log_debug_errno(r, "Reply callback returned error, ignoring: %m");
+        }
+
         if (!v->reply_callback)
                 return 0;
 
@@ -744,27 +903,32 @@ static int varlink_dispatch_reply(Varlink *v) {
                 goto invalid;
 
         if (IN_SET(v->state, VARLINK_AWAITING_REPLY, VARLINK_AWAITING_REPLY_MORE)) {
+                _cleanup_free_ VarlinkCall *done = NULL;
+                VarlinkReply callback;
+                void *userdata;
+
+                /* The reply is for the oldest call still pending */
+                assert(v->calls);
+                callback = v->calls->reply_callback ?: v->reply_callback;
+                userdata = v->calls->reply_callback ? v->calls->userdata : v->userdata;
+
+                /* Unless more replies are to come the call is complete now. Take it off the queue before
+                 * calling the callback, so that the callback may issue further calls right away. */
+                if (!FLAGS_SET(flags, VARLINK_REPLY_CONTINUES))
+                        done = varlink_pop_call(v);
+
                 varlink_set_state(v, VARLINK_PROCESSING_REPLY);
 
-                if (v->reply_callback) {
-                        r = v->reply_callback(v, parameters, error, flags, v->userdata);
+                if (callback) {
+                        r = callback(v, parameters, error, flags, userdata);
                         if (r < 0)
                                 log_debug_errno(r, "Reply callback returned error, ignoring: %m");
                 }
 
                 v->current = json_variant_unref(v->current);
 
-                if (v->state == VARLINK_PROCESSING_REPLY) {
-
-                        assert(v->n_pending > 0);
-
-                        if (!FLAGS_SET(flags, VARLINK_REPLY_CONTINUES))
-                                v->n_pending--;
-
-                        varlink_set_state(v,
-                                          FLAGS_SET(flags, VARLINK_REPLY_CONTINUES) ? VARLINK_AWAITING_REPLY_MORE :
-                                          v->n_pending == 0 ? VARLINK_IDLE_CLIENT : VARLINK_AWAITING_REPLY);
-                }
+                if (v->state == VARLINK_PROCESSING_REPLY)
+                        varlink_set_state(v, varlink_calls_state(v));
         } else {
                 assert(v->state == VARLINK_CALLING);
                 varlink_set_state(v, VARLINK_CALLED);
@@ -780,12 +944,293 @@ invalid:
         return 1;
 }
 
+static VarlinkWork* varlink_work_free(VarlinkWork *w) {
+        if (!w)
+                return NULL;
+
+        varlink_unref(w->link);
+        free(w->method);
+        json_variant_unref(w->parameters);
+        json_variant_unref(w->reply);
+
+        return mfree(w);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(VarlinkWork*, varlink_work_free);
+
+static void varlink_work_run(VarlinkWork *w) {
+        assert(w);
+
+        w->result = w->callback(w->parameters, w->flags, w->userdata, &w->reply, &w->error_id);
+}
+
+static int varlink_work_complete(VarlinkWork *w) {
+        Varlink *v;
+        int r;
+
+        assert(w);
+
+        /* Sends out the results of the work, called from the event loop thread. If the work was done
+         * synchronously we are still in the varlink_dispatch_method() stack frame, otherwise the method call
+         * is pending. */
+
+        v = w->link;
+
+        if (FLAGS_SET(w->flags, VARLINK_METHOD_ONEWAY)) {
+                if (w->result < 0)
+                        log_debug_errno(w->result, "Worker for %s returned error: %m", w->method);
+
+                return 0;
+        }
+
+        if (!IN_SET(v->state,
+                    VARLINK_PROCESSING_METHOD, VARLINK_PROCESSING_METHOD_MORE,
+                    VARLINK_PENDING_METHOD, VARLINK_PENDING_METHOD_MORE)) {
+                /* The connection was closed in the meantime */
+                varlink_log(v, "Dropping results of %s, connection is gone.", w->method);
+                return 0;
+        }
+
+        if (w->result < 0) {
+                log_debug_errno(w->result, "Worker for %s returned error: %m", w->method);
+                r = varlink_error_errno(v, w->result);
+        } else if (w->error_id)
+                r = varlink_error(v, w->error_id, w->reply);
+        else
+                r = varlink_reply(v, w->reply);
+        if (r < 0)
+                return r;
+
+        /* Input may have been queued up while we weren't looking */
+        if (v->state == VARLINK_IDLE_SERVER && v->defer_event_source) {
+                r = sd_event_source_set_enabled(v->defer_event_source, SD_EVENT_ON);
+                if (r < 0)
+                        return varlink_log_errno(v, r, "Failed to enable deferred event source: %m");
+        }
+
+        return 0;
+}
+
+static void varlink_server_dispatch_done_work(VarlinkServer *s) {
+        VarlinkWork *done;
+
+        assert(s);
+
+        assert_se(pthread_mutex_lock(&s->work_mutex) == 0);
+        done = TAKE_PTR(s->work_done);
+        assert_se(pthread_mutex_unlock(&s->work_mutex) == 0);
+
+        while (done) {
+                _cleanup_(varlink_work_freep) VarlinkWork *w = done;
+                _unused_ _cleanup_(varlink_unrefp) Varlink *v = varlink_ref(w->link);
+                int r;
+
+                LIST_REMOVE(work, done, w);
+
+                r = varlink_work_complete(w);
+                if (r < 0) {
+                        varlink_log_errno(v, r, "Failed to send results of %s, closing connection: %m", w->method);
+                        varlink_close(v);
+                }
+        }
+}
+
+static void* varlink_server_worker(void *p) {
+        VarlinkServer *s = p;
+
+        assert_se(pthread_mutex_lock(&s->work_mutex) == 0);
+
+        for (;;) {
+                VarlinkWork *w;
+
+                /* When asked to exit we still finish all work that is queued */
+                while (!s->work_queue && !s->work_exit)
+                        assert_se(pthread_cond_wait(&s->work_cond, &s->work_mutex) == 0);
+
+                w = s->work_queue;
+                if (!w)
+                        break;
+
+                LIST_REMOVE(work, s->work_queue, w);
+                if (s->work_queue_tail == w)
+                        s->work_queue_tail = NULL;
+                s->n_work_queued--;
+                s->n_workers_busy++;
+
+                assert_se(pthread_mutex_unlock(&s->work_mutex) == 0);
+                varlink_work_run(w);
+                assert_se(pthread_mutex_lock(&s->work_mutex) == 0);
+
+                s->n_workers_busy--;
+                LIST_PREPEND(work, s->work_done, w);
+
+                /* Wake up the event loop, it'll collect the results */
+                (void) eventfd_write(s->work_fd, 1);
+        }
+
+        assert_se(pthread_mutex_unlock(&s->work_mutex) == 0);
+
+        return NULL;
+}
+
+static int work_callback(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        VarlinkServer *s = userdata;
+        eventfd_t value;
+
+        assert(source);
+        assert(s);
+
+        (void) eventfd_read(fd, &value);
+
+        varlink_server_dispatch_done_work(s);
+        return 0;
+}
+
+static int varlink_server_start_worker(VarlinkServer *s) {
+        sigset_t ss, saved_ss;
+        int r, k;
+
+        assert(s);
+
+        /* Called with the work mutex held */
+
+        if (s->work_fd < 0) {
+                s->work_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+                if (s->work_fd < 0)
+                        return log_debug_errno(errno, "Failed to allocate eventfd for worker threads: %m");
+        }
+
+        if (!s->work_event_source) {
+                r = sd_event_add_io(s->event, &s->work_event_source, s->work_fd, EPOLLIN, work_callback, s);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to add event source for worker threads: %m");
+
+                r = sd_event_source_set_priority(s->work_event_source, s->event_priority);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to set priority of event source for worker threads: %m");
+
+                (void) sd_event_source_set_description(s->work_event_source, "varlink-server-work");
+        }
+
+        if (!GREEDY_REALLOC(s->workers, s->n_workers + 1))
+                return log_oom_debug();
+
+        /* Block all signals before starting the thread, so that it is started with all signals blocked and
+         * doesn't affect signal handling of the event loop thread. */
+        assert_se(sigfillset(&ss) >= 0);
+
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return log_debug_errno(r, "Failed to block signals: %m");
+
+        r = pthread_create(s->workers + s->n_workers, NULL, varlink_server_worker, s);
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (r > 0)
+                return log_debug_errno(r, "Failed to start worker thread: %m");
+        if (k > 0)
+                log_debug_errno(k, "Failed to restore signal mask, ignoring: %m");
+
+        s->n_workers++;
+        return 0;
+}
+
+static void varlink_server_stop_workers(VarlinkServer *s) {
+        assert(s);
+
+        if (s->n_workers > 0) {
+                assert_se(pthread_mutex_lock(&s->work_mutex) == 0);
+                s->work_exit = true;
+                assert_se(pthread_cond_broadcast(&s->work_cond) == 0);
+                assert_se(pthread_mutex_unlock(&s->work_mutex) == 0);
+
+                for (size_t i = 0; i < s->n_workers; i++)
+                        assert_se(pthread_join(s->workers[i], NULL) == 0);
+
+                s->workers = mfree(s->workers);
+                s->n_workers = 0;
+                s->work_exit = false;
+        }
+
+        assert(!s->work_queue);
+
+        /* Send out whatever was left over */
+        varlink_server_dispatch_done_work(s);
+}
+
+static int varlink_dispatch_work(
+                Varlink *v,
+                const char *method,
+                VarlinkWorkMethod callback,
+                JsonVariant *parameters,
+                VarlinkMethodFlags flags) {
+
+        _cleanup_(varlink_work_freep) VarlinkWork *w = NULL;
+        VarlinkServer *s;
+        int r;
+
+        assert(v);
+        assert(v->server);
+        assert(method);
+        assert(callback);
+
+        s = v->server;
+
+        w = new(VarlinkWork, 1);
+        if (!w)
+                return log_oom_debug();
+
+        /* The parameters are referenced from here, so that they stay valid while the worker looks at them,
+         * even if the connection moves on (for oneway calls) or is closed in the meantime. */
+        *w = (VarlinkWork) {
+                .link = varlink_ref(v),
+                .callback = callback,
+                .parameters = json_variant_ref(parameters),
+                .flags = flags,
+                .userdata = v->userdata,
+        };
+
+        w->method = strdup(method);
+        if (!w->method)
+                return log_oom_debug();
+
+        if (s->workers_max > 0 && s->event) {
+                assert_se(pthread_mutex_lock(&s->work_mutex) == 0);
+
+                r = 0;
+                if (s->n_work_queued + s->n_workers_busy >= s->n_workers && s->n_workers < s->workers_max)
+                        r = varlink_server_start_worker(s);
+
+                /* If we couldn't start a worker but have some already, queue the work for them */
+                if (r >= 0 || s->n_workers > 0) {
+                        LIST_INSERT_AFTER(work, s->work_queue, s->work_queue_tail, w);
+                        s->work_queue_tail = w;
+                        s->n_work_queued++;
+                        assert_se(pthread_cond_signal(&s->work_cond) == 0);
+
+                        TAKE_PTR(w);
+                }
+
+                assert_se(pthread_mutex_unlock(&s->work_mutex) == 0);
+
+                if (!w) {
+                        varlink_log(v, "Dispatched %s to worker thread.", method);
+                        return 0;
+                }
+        }
+
+        /* No worker threads, hence do the work right away */
+        varlink_work_run(w);
+        return varlink_work_complete(w);
+}
+
 static int varlink_dispatch_method(Varlink *v) {
         _cleanup_(json_variant_unrefp) JsonVariant *parameters = NULL;
         VarlinkMethodFlags flags = 0;
         const char *method = NULL, *error;
         JsonVariant *e;
         VarlinkMethod callback;
+        VarlinkWorkMethod work_callback = NULL;
         const char *k;
         int r;
 
@@ -865,10 +1310,16 @@ static int varlink_dispatch_method(Varlink *v) {
                 error = VARLINK_ERROR_METHOD_NOT_FOUND;
         } else {
                 callback = hashmap_get(v->server->methods, method);
+                if (!callback)
+                        work_callback = hashmap_get(v->server->work_methods, method);
                 error = VARLINK_ERROR_METHOD_NOT_FOUND;
         }
 
-        if (callback) {
+        if (work_callback) {
+                r = varlink_dispatch_work(v, method, work_callback, parameters, flags);
+                if (r < 0)
+                        return r;
+        } else if (callback) {
                 r = callback(v, parameters, flags, v->userdata);
                 if (r < 0) {
                         log_debug_errno(r, "Callback for %s returned error: %m", method);
@@ -1334,7 +1785,14 @@ int varlink_sendb(Varlink *v, const char *method, ...) {
         return varlink_send(v, method, parameters);
 }
 
-int varlink_invoke(Varlink *v, const char *method, JsonVariant *parameters) {
+static int varlink_invoke_internal(
+                Varlink *v,
+                const char *method,
+                JsonVariant *parameters,
+                bool more,
+                VarlinkReply reply_callback,
+                void *userdata) {
+
         _cleanup_(json_variant_unrefp) JsonVariant *m = NULL;
         int r;
 
@@ -1344,8 +1802,8 @@ int varlink_invoke(Varlink *v, const char *method, JsonVariant *parameters) {
         if (v->state == VARLINK_DISCONNECTED)
                 return varlink_log_errno(v, SYNTHETIC_ERRNO(ENOTCONN), "Not connected.");
 
-        /* We allow enqueuing multiple method calls at once! */
-        if (!IN_SET(v->state, VARLINK_IDLE_CLIENT, VARLINK_AWAITING_REPLY))
+        /* We allow enqueuing multiple method calls at once, including from a reply callback! */
+        if (!IN_SET(v->state, VARLINK_IDLE_CLIENT, VARLINK_AWAITING_REPLY, VARLINK_AWAITING_REPLY_MORE, VARLINK_PROCESSING_REPLY))
                 return varlink_log_errno(v, SYNTHETIC_ERRNO(EBUSY), "Connection busy.");
 
         r = varlink_sanitize_parameters(&parameters);
@@ -1354,21 +1812,43 @@ int varlink_invoke(Varlink *v, const char *method, JsonVariant *parameters) {
 
         r = json_build(&m, JSON_BUILD_OBJECT(
                                        JSON_BUILD_PAIR("method", JSON_BUILD_STRING(method)),
-                                       JSON_BUILD_PAIR("parameters", JSON_BUILD_VARIANT(parameters))));
+                                       JSON_BUILD_PAIR("parameters", JSON_BUILD_VARIANT(parameters)),
+                                       JSON_BUILD_PAIR_CONDITION(more, "more", JSON_BUILD_BOOLEAN(true))));
         if (r < 0)
                 return varlink_log_errno(v, r, "Failed to build json message: %m");
 
-        r = varlink_enqueue_json(v, m);
+        r = varlink_push_call(v, reply_callback, userdata, more);
         if (r < 0)
+                return varlink_log_errno(v, r, "Failed to allocate method call: %m");
+
+        r = varlink_enqueue_json(v, m);
+        if (r < 0) {
+                /* Drop the call again, it's the most recent one */
+                VarlinkCall *c = v->calls_tail;
+
+                LIST_REMOVE(calls, v->calls, c);
+                v->calls_tail = c->calls_prev;
+                v->n_pending--;
+                free(c);
+
                 return varlink_log_errno(v, r, "Failed to enqueue json message: %m");
+        }
 
-        varlink_set_state(v, VARLINK_AWAITING_REPLY);
-        v->n_pending++;
+        if (v->state == VARLINK_IDLE_CLIENT)
+                varlink_set_state(v, varlink_calls_state(v));
         v->timestamp = now(CLOCK_MONOTONIC);
 
         return 0;
 }
 
+int varlink_invoke(Varlink *v, const char *method, JsonVariant *parameters) {
+        return varlink_invoke_internal(v, method, parameters, /* more= */ false, NULL, NULL);
+}
+
+int varlink_invoke_full(Varlink *v, const char *method, JsonVariant *parameters, VarlinkReply reply, void *userdata) {
+        return varlink_invoke_internal(v, method, parameters, /* more= */ false, reply, userdata);
+}
+
 int varlink_invokeb(Varlink *v, const char *method, ...) {
         _cleanup_(json_variant_unrefp) JsonVariant *parameters = NULL;
         va_list ap;
@@ -1387,40 +1867,11 @@ int varlink_invokeb(Varlink *v, const char *method, ...) {
 }
 
 int varlink_observe(Varlink *v, const char *method, JsonVariant *parameters) {
-        _cleanup_(json_variant_unrefp) JsonVariant *m = NULL;
-        int r;
-
-        assert_return(v, -EINVAL);
-        assert_return(method, -EINVAL);
-
-        if (v->state == VARLINK_DISCONNECTED)
-                return varlink_log_errno(v, SYNTHETIC_ERRNO(ENOTCONN), "Not connected.");
-
-        /* Note that we don't allow enqueuing multiple method calls when we are in more/continues mode! We
-         * thus insist on an idle client here. */
-        if (v->state != VARLINK_IDLE_CLIENT)
-                return varlink_log_errno(v, SYNTHETIC_ERRNO(EBUSY), "Connection busy.");
-
-        r = varlink_sanitize_parameters(&parameters);
-        if (r < 0)
-                return varlink_log_errno(v, r, "Failed to sanitize parameters: %m");
-
-        r = json_build(&m, JSON_BUILD_OBJECT(
-                                       JSON_BUILD_PAIR("method", JSON_BUILD_STRING(method)),
-                                       JSON_BUILD_PAIR("parameters", JSON_BUILD_VARIANT(parameters)),
-                                       JSON_BUILD_PAIR("more", JSON_BUILD_BOOLEAN(true))));
-        if (r < 0)
-                return varlink_log_errno(v, r, "Failed to build json message: %m");
-
-        r = varlink_enqueue_json(v, m);
-        if (r < 0)
-                return varlink_log_errno(v, r, "Failed to enqueue json message: %m");
-
-        varlink_set_state(v, VARLINK_AWAITING_REPLY_MORE);
-        v->n_pending++;
-        v->timestamp = now(CLOCK_MONOTONIC);
+        return varlink_invoke_internal(v, method, parameters, /* more= */ true, NULL, NULL);
+}
 
-        return 0;
+int varlink_observe_full(Varlink *v, const char *method, JsonVariant *parameters, VarlinkReply reply, void *userdata) {
+        return varlink_invoke_internal(v, method, parameters, /* more= */ true, reply, userdata);
 }
 
 int varlink_observeb(Varlink *v, const char *method, ...) {
@@ -2006,6 +2457,9 @@ int varlink_server_new(VarlinkServer **ret, VarlinkServerFlags flags) {
                 .flags = flags,
                 .connections_max = varlink_server_connections_max(NULL),
                 .connections_per_uid_max = varlink_server_connections_per_uid_max(NULL),
+                .work_fd = -1,
+                .work_mutex = PTHREAD_MUTEX_INITIALIZER,
+                .work_cond = PTHREAD_COND_INITIALIZER,
         };
 
         *ret = s;
@@ -2020,10 +2474,19 @@ static VarlinkServer* varlink_server_destroy(VarlinkServer *s) {
 
         varlink_server_shutdown(s);
 
+        varlink_server_stop_workers(s);
+        sd_event_source_disable_unref(s->work_event_source);
+        safe_close(s->work_fd);
+        assert_se(pthread_cond_destroy(&s->work_cond) == 0);
+        assert_se(pthread_mutex_destroy(&s->work_mutex) == 0);
+
         while ((m = hashmap_steal_first_key(s->methods)))
                 free(m);
+        while ((m = hashmap_steal_first_key(s->work_methods)))
+                free(m);
 
         hashmap_free(s->methods);
+        hashmap_free(s->work_methods);
         hashmap_free(s->by_uid);
 
         sd_event_unref(s->event);
@@ -2374,6 +2837,10 @@ int varlink_server_detach_event(VarlinkServer *s) {
                 ss->event_source = sd_event_source_unref(ss->event_source);
         }
 
+        /* Results of workers are collected via the event loop, hence finish all work now */
+        varlink_server_stop_workers(s);
+        s->work_event_source = sd_event_source_disable_unref(s->work_event_source);
+
         sd_event_unref(s->event);
         return 0;
 }
@@ -2394,6 +2861,8 @@ int varlink_server_bind_method(VarlinkServer *s, const char *method, VarlinkMeth
 
         if (startswith(method, "org.varlink.service."))
                 return log_debug_errno(SYNTHETIC_ERRNO(EEXIST), "Cannot bind server to '%s'.", method);
+        if (hashmap_contains(s->work_methods, method))
+                return log_debug_errno(SYNTHETIC_ERRNO(EEXIST), "Method '%s' is already bound to a worker.", method);
 
         m = strdup(method);
         if (!m)
@@ -2410,6 +2879,34 @@ int varlink_server_bind_method(VarlinkServer *s, const char *method, VarlinkMeth
         return 0;
 }
 
+int varlink_server_bind_work_method(VarlinkServer *s, const char *method, VarlinkWorkMethod callback) {
+        _cleanup_free_ char *m = NULL;
+        int r;
+
+        assert_return(s, -EINVAL);
+        assert_return(method, -EINVAL);
+        assert_return(callback, -EINVAL);
+
+        if (startswith(method, "org.varlink.service."))
+                return log_debug_errno(SYNTHETIC_ERRNO(EEXIST), "Cannot bind server to '%s'.", method);
+        if (hashmap_contains(s->methods, method))
+                return log_debug_errno(SYNTHETIC_ERRNO(EEXIST), "Method '%s' is already bound.", method);
+
+        m = strdup(method);
+        if (!m)
+                return log_oom_debug();
+
+        r = hashmap_ensure_put(&s->work_methods, &string_hash_ops, m, callback);
+        if (r == -ENOMEM)
+                return log_oom_debug();
+        if (r < 0)
+                return log_debug_errno(r, "Failed to register callback: %m");
+        if (r > 0)
+                TAKE_PTR(m);
+
+        return 0;
+}
+
 int varlink_server_bind_method_many_internal(VarlinkServer *s, ...) {
         va_list ap;
         int r = 0;
@@ -2503,6 +3000,14 @@ int varlink_server_set_connections_max(VarlinkServer *s, unsigned m) {
         return 0;
 }
 
+int varlink_server_set_workers_max(VarlinkServer *s, unsigned m) {
+        assert_return(s, -EINVAL);
+
+        /* Already running workers are kept around if the limit is lowered */
+        s->workers_max = m;
+        return 0;
+}
+
 unsigned varlink_server_current_connections(VarlinkServer *s) {
         assert_return(s, UINT_MAX);
 
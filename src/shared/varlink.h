@@ -50,6 +50,12 @@ typedef enum VarlinkServerFlags {
 } VarlinkServerFlags;
 
 typedef int (*VarlinkMethod)(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata);
+
+/* A method that may be executed in a worker thread, see varlink_server_bind_work_method(). It must not
+ * modify, ref or unref the parameters, and must only access userdata in a thread-safe way. The reply it
+ * returns is handed to the event loop thread. If an error id is returned (which must be a static string),
+ * an error reply is sent instead, with the reply as error parameters. */
+typedef int (*VarlinkWorkMethod)(JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata, JsonVariant **ret_reply, const char **ret_error_id);
 typedef int (*VarlinkReply)(Varlink *link, JsonVariant *parameters, const char *error_id, VarlinkReplyFlags flags, void *userdata);
 typedef int (*VarlinkConnect)(VarlinkServer *server, Varlink *link, void *userdata);
 typedef void (*VarlinkDisconnect)(VarlinkServer *server, Varlink *link, void *userdata);
@@ -85,7 +91,8 @@ int varlink_sendb(Varlink *v, const char *method, ...);
 int varlink_call(Varlink *v, const char *method, JsonVariant *parameters, JsonVariant **ret_parameters, const char **ret_error_id, VarlinkReplyFlags *ret_flags);
 int varlink_callb(Varlink *v, const char *method, JsonVariant **ret_parameters, const char **ret_error_id, VarlinkReplyFlags *ret_flags, ...);
 
-/* Enqueue method call, expect a reply, which is eventually delivered to the reply callback */
+/* Enqueue method call, expect a reply, which is eventually delivered to the reply callback. Further calls may
+ * be enqueued before the reply arrived, their replies are delivered in the order the calls were made. */
 int varlink_invoke(Varlink *v, const char *method, JsonVariant *parameters);
 int varlink_invokeb(Varlink *v, const char *method, ...);
 
@@ -93,6 +100,10 @@ int varlink_invokeb(Varlink *v, const char *method, ...);
 int varlink_observe(Varlink *v, const char *method, JsonVariant *parameters);
 int varlink_observeb(Varlink *v, const char *method, ...);
 
+/* Same as above, but deliver the replies to this call to the specified callback instead of the connection's */
+int varlink_invoke_full(Varlink *v, const char *method, JsonVariant *parameters, VarlinkReply reply, void *userdata);
+int varlink_observe_full(Varlink *v, const char *method, JsonVariant *parameters, VarlinkReply reply, void *userdata);
+
 /* Enqueue a final reply */
 int varlink_reply(Varlink *v, JsonVariant *parameters);
 int varlink_replyb(Varlink *v, ...);
@@ -136,6 +147,12 @@ int varlink_server_add_connection(VarlinkServer *s, int fd, Varlink **ret);
 int varlink_server_bind_method(VarlinkServer *s, const char *method, VarlinkMethod callback);
 int varlink_server_bind_method_many_internal(VarlinkServer *s, ...);
 #define varlink_server_bind_method_many(s, ...) varlink_server_bind_method_many_internal(s, __VA_ARGS__, NULL)
+
+/* Bind a method that is dispatched to a pool of up to 'workers_max' threads, so that slow calls don't hold
+ * up other connections. Replies are sent from the event loop thread. Without worker threads, or if the
+ * server is not attached to an event loop, the method is executed right away instead. */
+int varlink_server_bind_work_method(VarlinkServer *s, const char *method, VarlinkWorkMethod callback);
+int varlink_server_set_workers_max(VarlinkServer *s, unsigned m);
 int varlink_server_bind_connect(VarlinkServer *s, VarlinkConnect connect);
 int varlink_server_bind_disconnect(VarlinkServer *s, VarlinkDisconnect disconnect);
 
@@ -173,3 +190,4 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(VarlinkServer *, varlink_server_unref);
 #define VARLINK_ERROR_METHOD_NOT_IMPLEMENTED "org.varlink.service.MethodNotImplemented"
 #define VARLINK_ERROR_INVALID_PARAMETER "org.varlink.service.InvalidParameter"
 #define VARLINK_ERROR_SUBSCRIPTION_TAKEN "org.varlink.service.SubscriptionTaken"
+#define VARLINK_ERROR_EXPECTED_MORE "org.varlink.service.ExpectedMore"
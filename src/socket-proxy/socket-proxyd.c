@@ -29,10 +29,18 @@
 
 #define BUFFER_SIZE (256 * 1024)
 
+/* How many empty pipes of closed connections to keep around for new connections */
+#define PIPE_POOL_MAX 32U
+
 static unsigned arg_connections_max = 256;
 static const char *arg_remote_host = NULL;
 static usec_t arg_exit_idle_time = USEC_INFINITY;
 
+typedef struct Pipe {
+        int fds[2];
+        size_t size;
+} Pipe;
+
 typedef struct Context {
         sd_event *event;
         sd_resolve *resolve;
@@ -40,6 +48,9 @@ typedef struct Context {
 
         Set *listen;
         Set *connections;
+
+        Pipe pipe_pool[PIPE_POOL_MAX];
+        size_t n_pipe_pool;
 } Context;
 
 typedef struct Connection {
@@ -57,12 +68,37 @@ typedef struct Connection {
         sd_resolve_query *resolve_query;
 } Connection;
 
+static void context_recycle_pipe(Context *context, int buffer[static 2], size_t full, size_t size) {
+        assert(context);
+        assert(buffer);
+
+        /* Creating pipes and resizing them is not cheap, hence keep the pipes of closed connections around
+         * for reuse, but only if they are empty, i.e. all data has been passed on. */
+
+        if (buffer[0] < 0 || buffer[1] < 0 || full > 0)
+                return;
+
+        if (context->n_pipe_pool >= PIPE_POOL_MAX)
+                return;
+
+        context->pipe_pool[context->n_pipe_pool++] = (Pipe) {
+                .fds = { TAKE_FD(buffer[0]), TAKE_FD(buffer[1]) },
+                .size = size,
+        };
+}
+
 static void connection_free(Connection *c) {
         assert(c);
 
-        if (c->context)
+        if (c->context) {
                 set_remove(c->context->connections, c);
 
+                context_recycle_pipe(c->context, c->server_to_client_buffer,
+                                     c->server_to_client_buffer_full, c->server_to_client_buffer_size);
+                context_recycle_pipe(c->context, c->client_to_server_buffer,
+                                     c->client_to_server_buffer_full, c->client_to_server_buffer_size);
+        }
+
         sd_event_source_unref(c->server_event_source);
         sd_event_source_unref(c->client_event_source);
 
@@ -127,6 +163,10 @@ static void context_clear(Context *context) {
         set_free_with_destructor(context->listen, sd_event_source_unref);
         set_free_with_destructor(context->connections, connection_free);
 
+        for (size_t i = 0; i < context->n_pipe_pool; i++)
+                safe_close_pair(context->pipe_pool[i].fds);
+        context->n_pipe_pool = 0;
+
         sd_event_unref(context->event);
         sd_resolve_unref(context->resolve);
         sd_event_source_unref(context->idle_time);
@@ -142,6 +182,15 @@ static int connection_create_pipes(Connection *c, int buffer[static 2], size_t *
         if (buffer[0] >= 0)
                 return 0;
 
+        if (c->context->n_pipe_pool > 0) {
+                Pipe *p = c->context->pipe_pool + --c->context->n_pipe_pool;
+
+                buffer[0] = TAKE_FD(p->fds[0]);
+                buffer[1] = TAKE_FD(p->fds[1]);
+                *sz = p->size;
+                return 0;
+        }
+
         r = pipe2(buffer, O_CLOEXEC|O_NONBLOCK);
         if (r < 0)
                 return log_error_errno(errno, "Failed to allocate pipe buffer: %m");
@@ -439,10 +439,76 @@ static int validate_version(
                         img->extension_release);
 }
 
+static int image_compare_by_name(Image *const *a, Image *const *b) {
+        return strcmp((*a)->name, (*b)->name);
+}
+
+static int extensions_identity(Hashmap *images, char **merged, char **ret) {
+        _cleanup_free_ char *host_os_release_id = NULL, *host_os_release_version_id = NULL, *host_os_release_sysext_level = NULL,
+                *s = NULL;
+        _cleanup_free_ Image **sorted = NULL;
+        size_t n = 0;
+        Image *img;
+        char **l;
+        int r;
+
+        assert(ret);
+
+        /* Describes everything a merge depends on: the host OS version, the extension images with their
+         * extension-release data, and which hierarchies ended up merged. We store this in the metadata
+         * directory of the merged trees, so that a refresh can tell if it would just build the very same
+         * overlayfs mounts again. */
+
+        r = parse_os_release(
+                        arg_root,
+                        "ID", &host_os_release_id,
+                        "VERSION_ID", &host_os_release_version_id,
+                        "SYSEXT_LEVEL", &host_os_release_sysext_level);
+        if (r < 0)
+                return log_error_errno(r, "Failed to acquire 'os-release' data of OS tree '%s': %m", empty_to_root(arg_root));
+
+        r = strextendf(&s, "force=%s\nos-release=%s:%s:%s\n",
+                       yes_no(arg_force),
+                       strempty(host_os_release_id),
+                       strempty(host_os_release_version_id),
+                       strempty(host_os_release_sysext_level));
+        if (r < 0)
+                return log_oom();
+
+        sorted = new(Image*, hashmap_size(images));
+        if (!sorted)
+                return log_oom();
+
+        HASHMAP_FOREACH(img, images)
+                sorted[n++] = img;
+
+        typesafe_qsort(sorted, n, image_compare_by_name);
+
+        for (size_t i = 0; i < n; i++) {
+                img = sorted[i];
+
+                r = strextendf(&s, "image=%s:%s:%s:" USEC_FMT ":%" PRIu64 "\n",
+                               img->name, image_type_to_string(img->type), img->path, img->mtime, img->usage);
+                if (r < 0)
+                        return log_oom();
+
+                STRV_FOREACH(l, img->extension_release)
+                        if (!strextend(&s, "extension-release=", *l, "\n"))
+                                return log_oom();
+        }
+
+        STRV_FOREACH(l, merged)
+                if (!strextend(&s, "hierarchy=", *l, "\n"))
+                        return log_oom();
+
+        *ret = TAKE_PTR(s);
+        return 0;
+}
+
 static int merge_subprocess(Hashmap *images, const char *workspace) {
         _cleanup_free_ char *host_os_release_id = NULL, *host_os_release_version_id = NULL, *host_os_release_sysext_level = NULL,
                 *buf = NULL;
-        _cleanup_strv_free_ char **extensions = NULL, **paths = NULL;
+        _cleanup_strv_free_ char **extensions = NULL, **paths = NULL, **merged = NULL;
         size_t n_extensions = 0;
         unsigned n_ignored = 0;
         Image *img;
@@ -654,6 +720,34 @@ static int merge_subprocess(Hashmap *images, const char *workspace) {
                 r = merge_hierarchy(*h, extensions, paths, meta_path, overlay_path);
                 if (r < 0)
                         return r;
+                if (r == 0)
+                        continue;
+
+                r = strv_extend(&merged, *h);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        /* Record what the merged trees were built from, so that a later refresh can skip rebuilding them if
+         * nothing changed. */
+        if (!strv_isempty(merged)) {
+                _cleanup_free_ char *identity = NULL;
+
+                r = extensions_identity(images, merged, &identity);
+                if (r < 0)
+                        return r;
+
+                STRV_FOREACH(h, merged) {
+                        _cleanup_free_ char *f = NULL;
+
+                        f = path_join(workspace, "meta", *h, ".systemd-sysext/identity");
+                        if (!f)
+                                return log_oom();
+
+                        r = write_string_file(f, identity, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_AVOID_NEWLINE);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to write '%s': %m", f);
+                }
         }
 
         /* And move them all into place. This is where things appear in the host namespace */
@@ -779,6 +873,76 @@ static int verb_merge(int argc, char **argv, void *userdata) {
         return merge(images);
 }
 
+static int refresh_needed(Hashmap *images) {
+        _cleanup_strv_free_ char **merged = NULL, **stored = NULL;
+        _cleanup_free_ char *identity = NULL;
+        Image *img;
+        char **p;
+        int r;
+
+        /* Returns > 0 if the merged trees don't match the extension images anymore and hence have to be
+         * rebuilt, and 0 if they were built from exactly the same images, in which case a refresh would only
+         * unmount and dissect everything once more, to end up with the same result. */
+
+        if (arg_force)
+                return true;
+
+        HASHMAP_FOREACH(img, images)
+                if (IN_SET(img->type, IMAGE_DIRECTORY, IMAGE_SUBVOLUME)) {
+                        /* The contents of directories may change without their identity changing, e.g. by
+                         * "make install" into them, hence always remount them. */
+                        log_debug("Extension '%s' is a directory, refreshing unconditionally.", img->name);
+                        return true;
+                }
+
+        STRV_FOREACH(p, arg_hierarchies) {
+                _cleanup_free_ char *resolved = NULL, *f = NULL, *buf = NULL;
+
+                r = chase_symlinks(*p, arg_root, CHASE_PREFIX_ROOT, &resolved, NULL);
+                if (r == -ENOENT)
+                        continue;
+                if (r < 0)
+                        return log_error_errno(r, "Failed to resolve path to hierarchy '%s%s': %m", strempty(arg_root), *p);
+
+                r = is_our_mount_point(resolved);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        continue;
+
+                f = path_join(resolved, ".systemd-sysext/identity");
+                if (!f)
+                        return log_oom();
+
+                r = read_full_file(f, &buf, NULL);
+                if (r == -ENOENT) /* Merged by an older version that didn't record this */
+                        return true;
+                if (r < 0)
+                        return log_error_errno(r, "Failed to read '%s': %m", f);
+
+                r = strv_extend(&merged, *p);
+                if (r < 0)
+                        return log_oom();
+
+                r = strv_consume(&stored, TAKE_PTR(buf));
+                if (r < 0)
+                        return log_oom();
+        }
+
+        if (strv_isempty(merged))
+                return true;
+
+        r = extensions_identity(images, merged, &identity);
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(p, stored)
+                if (!streq(*p, identity))
+                        return true;
+
+        return false;
+}
+
 static int verb_refresh(int argc, char **argv, void *userdata) {
         _cleanup_(hashmap_freep) Hashmap *images = NULL;
         int r;
@@ -790,6 +954,14 @@ static int verb_refresh(int argc, char **argv, void *userdata) {
         if (r < 0)
                 return r;
 
+        r = refresh_needed(images);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                log_info("Extension images unchanged since they were merged, not refreshing.");
+                return 0;
+        }
+
         r = merge(images); /* Returns > 0 if it did something, i.e. a new overlayfs is mounted now. When it
                             * does so it implicitly unmounts any overlayfs placed there before. Returns == 0
                             * if it did nothing, i.e. no extension images found. In this case the old
@@ -9,6 +9,7 @@
 #include "proc-cmdline.h"
 #include "special.h"
 #include "string-util.h"
+#include "strv.h"
 #include "unit-file.h"
 #include "util.h"
 
@@ -58,9 +59,13 @@ static int run(const char *dest, const char *dest_early, const char *dest_late)
         assert_se(arg_dest = dest_early);
 
         r = generate_symlink();
-        if (r <= 0)
+        if (r < 0)
                 return r;
 
+        (void) generator_declare_inputs(STRV_MAKE("/system-update"));
+        if (r == 0)
+                return 0;
+
         /* We parse the command line only to emit warnings. */
         r = proc_cmdline_parse(parse_proc_cmdline_item, NULL, 0);
         if (r < 0)
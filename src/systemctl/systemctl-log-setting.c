@@ -2,6 +2,9 @@
 
 #include "bus-error.h"
 #include "bus-locator.h"
+#include "format-table.h"
+#include "pager.h"
+#include "parse-util.h"
 #include "pretty-print.h"
 #include "syslog-util.h"
 #include "systemctl-log-setting.h"
@@ -113,9 +116,22 @@ static int service_name_to_dbus(sd_bus *bus, const char *name, char **ret_dbus_n
         return 0;
 }
 
+static int service_to_dbus(sd_bus *bus, const char *verb, const char *name, char **ret_dbus_name) {
+        _cleanup_free_ char *unit = NULL;
+        int r;
+
+        r = unit_name_mangle_with_suffix(name, verb,
+                                         arg_quiet ? 0 : UNIT_NAME_MANGLE_WARN,
+                                         ".service", &unit);
+        if (r < 0)
+                return log_error_errno(r, "Failed to mangle unit name: %m");
+
+        return service_name_to_dbus(bus, unit, ret_dbus_name);
+}
+
 int service_log_setting(int argc, char *argv[], void *userdata) {
         sd_bus *bus;
-        _cleanup_free_ char *unit = NULL, *dbus_name = NULL;
+        _cleanup_free_ char *dbus_name = NULL;
         int r;
 
         assert(argc >= 2 && argc <= 3);
@@ -124,13 +140,134 @@ int service_log_setting(int argc, char *argv[], void *userdata) {
         if (r < 0)
                 return r;
 
-        r = unit_name_mangle_with_suffix(argv[1], argv[0],
-                                         arg_quiet ? 0 : UNIT_NAME_MANGLE_WARN,
-                                         ".service", &unit);
+        r = service_to_dbus(bus, argv[0], argv[1], &dbus_name);
         if (r < 0)
-                return log_error_errno(r, "Failed to mangle unit name: %m");
+                return r;
+
+        const BusLocator bloc = {
+                .destination = dbus_name,
+                .path = "/org/freedesktop/LogControl1",
+                .interface = "org.freedesktop.LogControl1",
+        };
+
+        return log_setting_internal(bus, &bloc, argv[0], argv[2]);
+}
+
+static int show_event_sources(sd_bus *bus, const BusLocator *bloc, const char *name) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(table_unrefp) Table *table = NULL;
+        int profiling, r;
+
+        assert(bus);
+        assert(bloc);
+        assert(name);
+
+        r = bus_get_property_trivial(bus, bloc, "EventSourceProfiling", &error, 'b', &profiling);
+        if (r < 0)
+                goto fail;
+
+        if (!profiling) {
+                log_notice("Event source profiling is not enabled for %s, use \"systemctl service-event-sources %s on\" to enable it.",
+                           name, name);
+                return 0;
+        }
 
-        r = service_name_to_dbus(bus, unit, &dbus_name);
+        r = bus_call_method(bus, bloc, "GetEventSourceStatistics", &error, &reply, NULL);
+        if (r < 0)
+                goto fail;
+
+        table = table_new("description", "type", "dispatched", "total", "max");
+        if (!table)
+                return log_oom();
+
+        table_set_header(table, arg_legend != 0);
+        if (arg_full)
+                table_set_width(table, 0);
+
+        (void) table_set_empty_string(table, "-");
+
+        r = sd_bus_message_enter_container(reply, 'a', "(sstttau)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        for (;;) {
+                const char *description, *type;
+                uint64_t n_dispatched;
+                usec_t total, max;
+
+                r = sd_bus_message_enter_container(reply, 'r', "sstttau");
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r == 0)
+                        break;
+
+                r = sd_bus_message_read(reply, "ssttt", &description, &type, &n_dispatched, &total, &max);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                /* The histogram is not shown in the table */
+                r = sd_bus_message_skip(reply, "au");
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = table_add_many(table,
+                                   TABLE_STRING, empty_to_null(description),
+                                   TABLE_STRING, type,
+                                   TABLE_UINT64, n_dispatched,
+                                   TABLE_TIMESPAN_MSEC, total,
+                                   TABLE_TIMESPAN, max);
+                if (r < 0)
+                        return table_log_add_error(r);
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        (void) pager_open(arg_pager_flags);
+
+        r = table_print(table, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to print the table: %m");
+
+        return 0;
+
+fail:
+        log_error_errno(r, "Failed to get event source statistics of %s: %s",
+                        bloc->destination, bus_error_message(&error, r));
+
+        if (sd_bus_error_has_names(&error, SD_BUS_ERROR_UNKNOWN_METHOD,
+                                           SD_BUS_ERROR_UNKNOWN_OBJECT,
+                                           SD_BUS_ERROR_UNKNOWN_INTERFACE,
+                                           SD_BUS_ERROR_UNKNOWN_PROPERTY))
+                give_log_control1_hint(bloc->destination);
+        return r;
+}
+
+int service_event_sources(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ char *dbus_name = NULL;
+        sd_bus *bus;
+        int b = -1, r;
+
+        assert(argc >= 2 && argc <= 3);
+
+        if (argc > 2) {
+                b = parse_boolean(argv[2]);
+                if (b < 0)
+                        return log_error_errno(b, "Failed to parse boolean argument: %s", argv[2]);
+        }
+
+        r = acquire_bus(BUS_FULL, &bus);
+        if (r < 0)
+                return r;
+
+        r = service_to_dbus(bus, argv[0], argv[1], &dbus_name);
         if (r < 0)
                 return r;
 
@@ -140,5 +277,20 @@ int service_log_setting(int argc, char *argv[], void *userdata) {
                 .interface = "org.freedesktop.LogControl1",
         };
 
-        return log_setting_internal(bus, &bloc, argv[0], argv[2]);
+        if (b < 0)
+                return show_event_sources(bus, &bloc, argv[1]);
+
+        r = bus_set_property(bus, &bloc, "EventSourceProfiling", &error, "b", b);
+        if (r < 0) {
+                log_error_errno(r, "Failed to %s event source profiling of %s: %s",
+                                b ? "enable" : "disable", dbus_name, bus_error_message(&error, r));
+
+                if (sd_bus_error_has_names(&error, SD_BUS_ERROR_UNKNOWN_OBJECT,
+                                                   SD_BUS_ERROR_UNKNOWN_INTERFACE,
+                                                   SD_BUS_ERROR_UNKNOWN_PROPERTY))
+                        give_log_control1_hint(dbus_name);
+                return r;
+        }
+
+        return 0;
 }
@@ -3,3 +3,4 @@
 
 int log_setting(int argc, char *argv[], void *userdata);
 int service_log_setting(int argc, char *argv[], void *userdata);
+int service_event_sources(int argc, char *argv[], void *userdata);
@@ -1746,6 +1746,7 @@ static int show_one(
                 sd_bus *bus,
                 const char *path,
                 const char *unit,
+                sd_bus_message *prefetched,
                 SystemctlShowMode show_mode,
                 bool *new_line,
                 bool *ellipsized) {
@@ -1870,15 +1871,30 @@ static int show_one(
 
         log_debug("Showing one %s", path);
 
-        r = bus_map_all_properties(
-                        bus,
-                        "org.freedesktop.systemd1",
-                        path,
-                        show_mode == SYSTEMCTL_SHOW_STATUS ? status_map : property_map,
-                        BUS_MAP_BOOLEAN_AS_BOOL,
-                        &error,
-                        &reply,
-                        &info);
+        if (prefetched) {
+                /* The GetAll() reply has been requested already, see show_prefetch() */
+                r = -sd_bus_message_get_errno(prefetched);
+                if (r < 0)
+                        (void) sd_bus_error_copy(&error, sd_bus_message_get_error(prefetched));
+                else
+                        r = bus_message_map_all_properties(
+                                        prefetched,
+                                        show_mode == SYSTEMCTL_SHOW_STATUS ? status_map : property_map,
+                                        BUS_MAP_BOOLEAN_AS_BOOL,
+                                        &error,
+                                        &info);
+                if (r >= 0)
+                        reply = sd_bus_message_ref(prefetched);
+        } else
+                r = bus_map_all_properties(
+                                bus,
+                                "org.freedesktop.systemd1",
+                                path,
+                                show_mode == SYSTEMCTL_SHOW_STATUS ? status_map : property_map,
+                                BUS_MAP_BOOLEAN_AS_BOOL,
+                                &error,
+                                &reply,
+                                &info);
         if (r < 0)
                 return log_error_errno(r, "Failed to get properties: %s", bus_error_message(&error, r));
 
@@ -1925,6 +1941,89 @@ static int show_one(
         return 0;
 }
 
+/* How many GetAll() calls to have in flight at most when showing multiple units. The bus brokers limit the
+ * number of pending replies per connection, so don't go overboard. */
+#define SHOW_PREFETCH_MAX 64U
+
+typedef struct ShowPrefetch {
+        char **paths;
+        size_t n_paths, n_requested;
+        sd_bus_slot **slots;
+        sd_bus_message **replies;
+} ShowPrefetch;
+
+static void show_prefetch_done(ShowPrefetch *p) {
+        assert(p);
+
+        for (size_t i = 0; i < p->n_requested; i++) {
+                sd_bus_slot_unref(p->slots[i]);
+                sd_bus_message_unref(p->replies[i]);
+        }
+
+        p->slots = mfree(p->slots);
+        p->replies = mfree(p->replies);
+        p->paths = strv_free(p->paths);
+}
+
+static int show_prefetch_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        sd_bus_message **reply = userdata;
+
+        assert(m);
+        assert(reply);
+
+        *reply = sd_bus_message_ref(m);
+        return 0;
+}
+
+static int show_prefetch(sd_bus *bus, ShowPrefetch *p, size_t i, sd_bus_message **ret) {
+        int r;
+
+        assert(bus);
+        assert(p);
+        assert(i < p->n_paths);
+        assert(ret);
+
+        /* Showing many units one by one means waiting for a full round trip to PID 1 for each of them,
+         * hence ask for the properties of the next units already while we are looking at the current one. */
+
+        if (!p->slots) {
+                p->slots = new0(sd_bus_slot*, p->n_paths);
+                p->replies = new0(sd_bus_message*, p->n_paths);
+                if (!p->slots || !p->replies)
+                        return log_oom();
+        }
+
+        for (; p->n_requested < MIN(i + SHOW_PREFETCH_MAX, p->n_paths); p->n_requested++) {
+                r = sd_bus_call_method_async(
+                                bus,
+                                &p->slots[p->n_requested],
+                                "org.freedesktop.systemd1",
+                                p->paths[p->n_requested],
+                                "org.freedesktop.DBus.Properties",
+                                "GetAll",
+                                show_prefetch_reply,
+                                &p->replies[p->n_requested],
+                                "s", "");
+                if (r < 0)
+                        return log_error_errno(r, "Failed to request properties: %m");
+        }
+
+        while (!p->replies[i]) {
+                r = sd_bus_process(bus, NULL);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to process bus: %m");
+                if (r > 0)
+                        continue;
+
+                r = sd_bus_wait(bus, UINT64_MAX);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to wait for bus: %m");
+        }
+
+        *ret = p->replies[i];
+        return 0;
+}
+
 static int get_unit_dbus_path_by_pid(
                 sd_bus *bus,
                 uint32_t pid,
@@ -1978,7 +2077,7 @@ static int show_all(
                 if (!p)
                         return log_oom();
 
-                r = show_one(bus, p, u->id, SYSTEMCTL_SHOW_STATUS, new_line, ellipsized);
+                r = show_one(bus, p, u->id, NULL, SYSTEMCTL_SHOW_STATUS, new_line, ellipsized);
                 if (r < 0)
                         return r;
                 else if (r > 0 && ret == 0)
@@ -2078,7 +2177,7 @@ int show(int argc, char *argv[], void *userdata) {
 
         /* If no argument is specified inspect the manager itself */
         if (show_mode == SYSTEMCTL_SHOW_PROPERTIES && argc <= 1)
-                return show_one(bus, "/org/freedesktop/systemd1", NULL, show_mode, &new_line, &ellipsized);
+                return show_one(bus, "/org/freedesktop/systemd1", NULL, NULL, show_mode, &new_line, &ellipsized);
 
         if (show_mode == SYSTEMCTL_SHOW_STATUS && argc <= 1) {
 
@@ -2118,7 +2217,7 @@ int show(int argc, char *argv[], void *userdata) {
                                         return log_oom();
                         }
 
-                        r = show_one(bus, path, unit, show_mode, &new_line, &ellipsized);
+                        r = show_one(bus, path, unit, NULL, show_mode, &new_line, &ellipsized);
                         if (r < 0)
                                 return r;
                         else if (r > 0 && ret == 0)
@@ -2126,6 +2225,7 @@ int show(int argc, char *argv[], void *userdata) {
                 }
 
                 if (!strv_isempty(patterns)) {
+                        _cleanup_(show_prefetch_done) ShowPrefetch prefetch = {};
                         _cleanup_strv_free_ char **names = NULL;
 
                         r = expand_unit_names(bus, patterns, NULL, &names, NULL);
@@ -2143,7 +2243,24 @@ int show(int argc, char *argv[], void *userdata) {
                                 if (!path)
                                         return log_oom();
 
-                                r = show_one(bus, path, *name, show_mode, &new_line, &ellipsized);
+                                r = strv_consume(&prefetch.paths, TAKE_PTR(path));
+                                if (r < 0)
+                                        return log_oom();
+                        }
+
+                        prefetch.n_paths = strv_length(prefetch.paths);
+
+                        for (size_t i = 0; i < prefetch.n_paths; i++) {
+                                sd_bus_message *reply = NULL;
+
+                                /* Only worth it if there's more than one unit to show */
+                                if (prefetch.n_paths > 1) {
+                                        r = show_prefetch(bus, &prefetch, i, &reply);
+                                        if (r < 0)
+                                                return r;
+                                }
+
+                                r = show_one(bus, prefetch.paths[i], names[i], reply, show_mode, &new_line, &ellipsized);
                                 if (r < 0)
                                         return r;
                                 if (r > 0 && ret == 0)
@@ -58,6 +58,7 @@ static int start_unit_one(
                 const char *name,
                 const char *mode,
                 sd_bus_error *error,
+                sd_bus_message *prefetched,
                 BusWaitForJobs *w,
                 BusWaitForUnits *wu) {
 
@@ -130,9 +131,20 @@ static int start_unit_one(
         }
 
         if (!done) {
-                r = bus_call_method(bus, bus_systemd_mgr, method, error, &reply, "ss", name, mode);
-                if (r < 0)
-                        goto fail;
+                if (prefetched) {
+                        /* The job has been requested already, see start_unit_batch() */
+                        r = -sd_bus_message_get_errno(prefetched);
+                        if (r < 0) {
+                                (void) sd_bus_error_copy(error, sd_bus_message_get_error(prefetched));
+                                goto fail;
+                        }
+
+                        reply = sd_bus_message_ref(prefetched);
+                } else {
+                        r = bus_call_method(bus, bus_systemd_mgr, method, error, &reply, "ss", name, mode);
+                        if (r < 0)
+                                goto fail;
+                }
 
                 r = sd_bus_message_read(reply, "o", &path);
                 if (r < 0)
@@ -176,6 +188,106 @@ fail:
         return r;
 }
 
+#define START_UNIT_BATCH_MAX 64U
+
+typedef struct StartUnitBatch {
+        BusWaitForJobs *w;
+        sd_bus_message **replies;
+        size_t n_replies;
+} StartUnitBatch;
+
+static void start_unit_batch_done(StartUnitBatch *b) {
+        assert(b);
+
+        for (size_t i = 0; i < b->n_replies; i++)
+                sd_bus_message_unref(b->replies[i]);
+
+        b->replies = mfree(b->replies);
+}
+
+static int start_unit_batch_reply(sd_bus_message *reply, size_t idx, void *userdata) {
+        StartUnitBatch *b = userdata;
+        const char *path;
+        int r;
+
+        assert(reply);
+        assert(b);
+        assert(idx < b->n_replies);
+
+        b->replies[idx] = sd_bus_message_ref(reply);
+
+        if (!b->w || sd_bus_message_is_method_error(reply, NULL))
+                return 0;
+
+        /* The job has to be watched before its JobRemoved signal is dispatched, which might happen before
+         * we get to look at the reply in start_unit_one(). Parse errors are reported there. */
+        if (sd_bus_message_read(reply, "o", &path) < 0)
+                return 0;
+
+        log_debug("Adding %s to the set", path);
+        r = bus_wait_for_jobs_add(b->w, path);
+        if (r < 0)
+                return log_error_errno(r, "Failed to watch job %s: %m", path);
+
+        r = sd_bus_message_rewind(reply, true);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        return 0;
+}
+
+static int start_unit_batch(
+                sd_bus *bus,
+                const char *method,
+                char **names,
+                const char *mode,
+                StartUnitBatch *b) {
+
+        sd_bus_message **calls;
+        size_t n;
+        int r = 0;
+
+        assert(bus);
+        assert(method);
+        assert(mode);
+        assert(b);
+
+        /* Enqueueing jobs for many units one by one means waiting for a full round trip to PID 1 for each of
+         * them, hence send the calls for all of them first, and look at the replies afterwards. */
+
+        n = strv_length(names);
+
+        b->replies = new0(sd_bus_message*, n);
+        if (!b->replies)
+                return log_oom();
+        b->n_replies = n;
+
+        calls = new0(sd_bus_message*, n);
+        if (!calls)
+                return log_oom();
+
+        for (size_t i = 0; i < n; i++) {
+                r = bus_message_new_method_call(bus, calls + i, bus_systemd_mgr, method);
+                if (r >= 0)
+                        r = sd_bus_message_append(calls[i], "ss", names[i], mode);
+                if (r < 0) {
+                        bus_log_create_error(r);
+                        goto finish;
+                }
+        }
+
+        r = bus_call_batch(bus, calls, n, START_UNIT_BATCH_MAX, start_unit_batch_reply, b);
+        if (r < 0)
+                log_error_errno(r, "Failed to enqueue jobs: %m");
+
+finish:
+        for (size_t i = 0; i < n; i++)
+                sd_bus_message_unref(calls[i]);
+        free(calls);
+
+        return r;
+}
+
 static int enqueue_marked_jobs(
                 sd_bus *bus,
                 BusWaitForJobs *w) {
@@ -364,11 +476,27 @@ int start_unit(int argc, char *argv[], void *userdata) {
         if (arg_marked)
                 ret = enqueue_marked_jobs(bus, w);
 
-        else
+        else {
+                _cleanup_(start_unit_batch_done) StartUnitBatch batch = {
+                        .w = w,
+                };
+                size_t i = 0;
+
+                /* Only worth it if there's more than one unit, and the transactions need not be shown */
+                if (!arg_dry_run && !arg_show_transaction && strv_length(names) > 1) {
+                        r = start_unit_batch(bus, method, names, mode, &batch);
+                        if (r < 0)
+                                return r;
+                }
+
                 STRV_FOREACH(name, names) {
                         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
 
-                        r = start_unit_one(bus, method, job_type, *name, mode, &error, w, wu);
+                        /* When batched, the jobs have been added to the set already */
+                        if (batch.replies)
+                                r = start_unit_one(bus, method, job_type, *name, mode, &error, batch.replies[i++], NULL, wu);
+                        else
+                                r = start_unit_one(bus, method, job_type, *name, mode, &error, NULL, w, wu);
                         if (ret == EXIT_SUCCESS && r < 0)
                                 ret = translate_bus_error_to_exit_status(r, &error);
 
@@ -378,6 +506,7 @@ int start_unit(int argc, char *argv[], void *userdata) {
                                         return log_oom();
                         }
                 }
+        }
 
         if (!arg_no_block) {
                 const char* extra_args[4];
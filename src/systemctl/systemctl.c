@@ -174,6 +174,9 @@ static int systemctl_help(void) {
                "                                      unit's namespace\n"
                "  service-log-level SERVICE [LEVEL]   Get/set logging threshold for service\n"
                "  service-log-target SERVICE [TARGET] Get/set logging target for service\n"
+               "  service-event-sources SERVICE [BOOL]\n"
+               "                                      Show hot event sources of service, or\n"
+               "                                      enable/disable event source profiling\n"
                "  reset-failed [PATTERN...]           Reset failed state for all, one, or more\n"
                "                                      units"
                "\n%3$sUnit File Commands:%4$s\n"
@@ -1055,6 +1058,7 @@ static int systemctl_main(int argc, char *argv[]) {
                 { "log-target",            VERB_ANY, 2,        VERB_ONLINE_ONLY, log_setting             },
                 { "service-log-level",     2,        3,        VERB_ONLINE_ONLY, service_log_setting     },
                 { "service-log-target",    2,        3,        VERB_ONLINE_ONLY, service_log_setting     },
+                { "service-event-sources", 2,        3,        VERB_ONLINE_ONLY, service_event_sources   },
                 { "service-watchdogs",     VERB_ANY, 2,        VERB_ONLINE_ONLY, service_watchdogs       },
                 { "show-environment",      VERB_ANY, 1,        VERB_ONLINE_ONLY, show_environment        },
                 { "set-environment",       2,        VERB_ANY, VERB_ONLINE_ONLY, set_environment         },
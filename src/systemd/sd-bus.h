@@ -170,6 +170,8 @@ int sd_bus_set_exit_on_disconnect(sd_bus *bus, int b);
 int sd_bus_get_exit_on_disconnect(sd_bus *bus);
 int sd_bus_set_close_on_exit(sd_bus *bus, int b);
 int sd_bus_get_close_on_exit(sd_bus *bus);
+int sd_bus_set_coalesce_properties_changed(sd_bus *bus, int b);
+int sd_bus_get_coalesce_properties_changed(sd_bus *bus);
 int sd_bus_set_watch_bind(sd_bus *bus, int b);
 int sd_bus_get_watch_bind(sd_bus *bus);
 int sd_bus_set_connected_signal(sd_bus *bus, int b);
@@ -247,6 +249,7 @@ void* sd_bus_slot_set_userdata(sd_bus_slot *slot, void *userdata);
 int sd_bus_slot_set_description(sd_bus_slot *slot, const char *description);
 int sd_bus_slot_get_description(sd_bus_slot *slot, const char **description);
 int sd_bus_slot_get_floating(sd_bus_slot *slot);
+int sd_bus_slot_get_match_hits(sd_bus_slot *slot, uint64_t *ret);
 int sd_bus_slot_set_floating(sd_bus_slot *slot, int b);
 int sd_bus_slot_set_destroy_callback(sd_bus_slot *s, sd_bus_destroy_t callback);
 int sd_bus_slot_get_destroy_callback(sd_bus_slot *s, sd_bus_destroy_t *callback);
@@ -0,0 +1,238 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/* Measures how fast some of the basic primitives everything else is built on are:
+ *
+ *     test-basic-benchmark [ITERATIONS [PATTERN]]
+ *
+ * Every benchmark runs a fixed number of operations (1000000 by default), so that the results of different
+ * builds and releases can be compared directly. PATTERN is a glob selecting the benchmarks to run by name.
+ * The results are written to stdout as one JSON object per line. */
+
+#include <fnmatch.h>
+
+#include "alloc-util.h"
+#include "extract-word.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "hashmap.h"
+#include "hexdecoct.h"
+#include "json.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "prioq.h"
+#include "siphash24.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+#include "utf8.h"
+
+/* Results are accumulated here, so that the compiler can't optimize the work away */
+static volatile uint64_t sink;
+
+static void bench_hashmap_trivial(unsigned n) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+
+        assert_se(h = hashmap_new(&trivial_hash_ops));
+
+        for (unsigned i = 0; i < n; i++)
+                assert_se(hashmap_put(h, UINT_TO_PTR(i + 1), UINT_TO_PTR(i + 1)) > 0);
+
+        for (unsigned i = 0; i < n; i++)
+                sink += PTR_TO_UINT(hashmap_get(h, UINT_TO_PTR(i + 1)));
+
+        for (unsigned i = 0; i < n; i++)
+                assert_se(hashmap_remove(h, UINT_TO_PTR(i + 1)));
+}
+
+static void bench_hashmap_string(unsigned n) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        _cleanup_strv_free_ char **keys = NULL;
+        size_t n_keys;
+
+        n_keys = MIN(n, 65536U);
+
+        for (size_t i = 0; i < n_keys; i++)
+                assert_se(strv_extendf(&keys, "some-unit-name-%zu.service", i) >= 0);
+
+        assert_se(h = hashmap_new(&string_hash_ops));
+
+        for (size_t i = 0; i < n_keys; i++)
+                assert_se(hashmap_put(h, keys[i], keys[i]) > 0);
+
+        for (unsigned i = 0; i < n; i++)
+                sink += !!hashmap_get(h, keys[i % n_keys]);
+}
+
+static void bench_prioq(unsigned n) {
+        _cleanup_(prioq_freep) Prioq *q = NULL;
+
+        assert_se(q = prioq_new(trivial_compare_func));
+
+        /* Insert in a scrambled order, so that the heap actually has to do some work */
+        for (unsigned i = 0; i < n; i++)
+                assert_se(prioq_put(q, UINT_TO_PTR(((i * 7919U) % n) + 1), NULL) >= 0);
+
+        for (unsigned i = 0; i < n; i++)
+                sink += PTR_TO_UINT(prioq_pop(q));
+}
+
+static void bench_strv(unsigned n) {
+        for (unsigned i = 0; i < n; i += 100) {
+                _cleanup_strv_free_ char **l = NULL;
+                _cleanup_free_ char *joined = NULL;
+
+                for (unsigned j = 0; j < 100; j++)
+                        assert_se(strv_extend(&l, "foobar") >= 0);
+
+                assert_se(joined = strv_join(l, " "));
+                sink += strlen(joined);
+        }
+}
+
+static void bench_path_simplify(unsigned n) {
+        static const char path[] = "//usr/./lib//systemd/../systemd/system///multi-user.target.wants/";
+        char buf[sizeof(path)];
+
+        for (unsigned i = 0; i < n; i++)
+                sink += strlen(path_simplify(strcpy(buf, path)));
+}
+
+static void bench_path_equal(unsigned n) {
+        for (unsigned i = 0; i < n; i++)
+                sink += path_equal("/usr/lib/systemd/system/getty@.service",
+                                   "//usr/lib//systemd/./system/getty@.service");
+}
+
+static void bench_extract_first_word(unsigned n) {
+        for (unsigned i = 0; i < n; i += 5) {
+                const char *p = "foo 'bar baz' \"quux\" waldo\\ piep xyz";
+
+                for (;;) {
+                        _cleanup_free_ char *word = NULL;
+                        int r;
+
+                        r = extract_first_word(&p, &word, NULL, EXTRACT_UNQUOTE|EXTRACT_CUNESCAPE);
+                        assert_se(r >= 0);
+                        if (r == 0)
+                                break;
+
+                        sink += strlen(word);
+                }
+        }
+}
+
+static void bench_read_line(unsigned n) {
+        _cleanup_free_ char *text = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t size = 0;
+
+        assert_se(f = open_memstream_unlocked(&text, &size));
+        for (unsigned i = 0; i < MIN(n, 10000U); i++)
+                fputs("ExecStart=/usr/lib/systemd/systemd-foobar --some-option=value\n", f);
+        assert_se(fflush_and_check(f) >= 0);
+        f = safe_fclose(f);
+
+        for (unsigned i = 0; i < n; i += MIN(n, 10000U)) {
+                assert_se(f = fmemopen(text, size, "r"));
+
+                for (;;) {
+                        _cleanup_free_ char *line = NULL;
+                        int r;
+
+                        r = read_line(f, LONG_LINE_MAX, &line);
+                        assert_se(r >= 0);
+                        if (r == 0)
+                                break;
+
+                        sink += strlen(line);
+                }
+
+                f = safe_fclose(f);
+        }
+}
+
+static void bench_siphash24(unsigned n) {
+        static const uint8_t key[16] = {
+                0x1d, 0x6c, 0x9e, 0x3a, 0x81, 0x22, 0x4f, 0x90,
+                0x5b, 0x07, 0xc3, 0xe8, 0x44, 0x13, 0xa6, 0xfd,
+        };
+        static const char data[] = "/sys/devices/pci0000:00/0000:00:1f.2/ata1/host0/target0:0:0";
+
+        for (unsigned i = 0; i < n; i++)
+                sink += siphash24(data, sizeof(data) - 1, key);
+}
+
+static void bench_utf8_is_valid(unsigned n) {
+        for (unsigned i = 0; i < n; i++)
+                sink += !!utf8_is_valid("Grüße aus Berlin — a mixed ASCII/UTF-8 string, ☺ included.");
+}
+
+static void bench_hexmem(unsigned n) {
+        static const uint8_t data[32] = {
+                0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+                0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5, 0x96, 0x87, 0x78, 0x69, 0x5a, 0x4b, 0x3c, 0x2d, 0x1e, 0x0f,
+        };
+
+        for (unsigned i = 0; i < n; i++) {
+                _cleanup_free_ char *hex = NULL;
+                _cleanup_free_ void *mem = NULL;
+                size_t size;
+
+                assert_se(hex = hexmem(data, sizeof(data)));
+                assert_se(unhexmem(hex, SIZE_MAX, &mem, &size) >= 0);
+                sink += size;
+        }
+}
+
+static const struct {
+        const char *name;
+        void (*func)(unsigned n);
+} benchmarks[] = {
+        { "hashmap-trivial",    bench_hashmap_trivial    },
+        { "hashmap-string",     bench_hashmap_string     },
+        { "prioq",              bench_prioq              },
+        { "strv",               bench_strv               },
+        { "path-simplify",      bench_path_simplify      },
+        { "path-equal",         bench_path_equal         },
+        { "extract-first-word", bench_extract_first_word },
+        { "read-line",          bench_read_line          },
+        { "siphash24",          bench_siphash24          },
+        { "utf8-is-valid",      bench_utf8_is_valid      },
+        { "hexmem",             bench_hexmem             },
+};
+
+int main(int argc, char *argv[]) {
+        unsigned iterations = 1000000;
+        const char *pattern = NULL;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &iterations) >= 0 && iterations > 0);
+        if (argc > 2)
+                pattern = argv[2];
+
+        for (size_t i = 0; i < ELEMENTSOF(benchmarks); i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+                usec_t begin_usec, elapsed_usec;
+
+                if (pattern && fnmatch(pattern, benchmarks[i].name, 0) != 0)
+                        continue;
+
+                begin_usec = now(CLOCK_MONOTONIC);
+                benchmarks[i].func(iterations);
+                elapsed_usec = usec_sub_unsigned(now(CLOCK_MONOTONIC), begin_usec);
+
+                assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR("name", JSON_BUILD_STRING(benchmarks[i].name)),
+                                             JSON_BUILD_PAIR("iterations", JSON_BUILD_UNSIGNED(iterations)),
+                                             JSON_BUILD_PAIR("usec", JSON_BUILD_UNSIGNED(elapsed_usec)),
+                                             JSON_BUILD_PAIR("nsecPerOperation",
+                                                             JSON_BUILD_REAL((double) elapsed_usec * NSEC_PER_USEC / iterations)))) >= 0);
+
+                json_variant_dump(v, JSON_FORMAT_NEWLINE, stdout, NULL);
+        }
+
+        return 0;
+}
@@ -286,6 +286,49 @@ static void test_copy_bytes_regular_file(const char *src, bool try_reflink, uint
         unlink(fn3);
 }
 
+static void test_copy_holes(void) {
+        char fn[] = "/var/tmp/test-copy-hole-fd-XXXXXX";
+        char fn_copy[] = "/var/tmp/test-copy-hole-fd-XXXXXX";
+        _cleanup_close_ int fd = -1, fd_copy = -1;
+        uint8_t data[4096], buf[4096];
+        struct stat st;
+        bool holes;
+
+        log_info("/* %s */", __func__);
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+
+        fd_copy = mkostemp_safe(fn_copy);
+        assert_se(fd_copy >= 0);
+
+        /* A hole at the beginning, some data, and a trailing hole */
+        memset(data, 'x', sizeof(data));
+        assert_se(pwrite(fd, data, sizeof(data), 1024 * 1024) == sizeof(data));
+        assert_se(ftruncate(fd, 3 * 1024 * 1024) >= 0);
+
+        /* Not all file systems support holes, only check for them if the source file has them */
+        holes = lseek(fd, 0, SEEK_DATA) == 1024 * 1024;
+
+        assert_se(lseek(fd, 0, SEEK_SET) == 0);
+        assert_se(copy_bytes(fd, fd_copy, UINT64_MAX, COPY_HOLES) >= 0);
+
+        assert_se(fstat(fd_copy, &st) >= 0);
+        assert_se(st.st_size == 3 * 1024 * 1024);
+
+        assert_se(pread(fd_copy, buf, sizeof(buf), 1024 * 1024) == sizeof(buf));
+        assert_se(memcmp(buf, data, sizeof(buf)) == 0);
+
+        if (holes) {
+                assert_se(lseek(fd_copy, 0, SEEK_DATA) == 1024 * 1024);
+                assert_se(lseek(fd_copy, 1024 * 1024, SEEK_HOLE) >= 1024 * 1024 + (off_t) sizeof(data));
+                assert_se(lseek(fd_copy, 1024 * 1024, SEEK_HOLE) < 3 * 1024 * 1024);
+        }
+
+        unlink(fn);
+        unlink(fn_copy);
+}
+
 static void test_copy_atomic(void) {
         _cleanup_(rm_rf_physical_and_freep) char *p = NULL;
         const char *q;
@@ -333,6 +376,7 @@ int main(int argc, char *argv[]) {
         test_copy_bytes_regular_file(argv[0], true, 1000);
         test_copy_bytes_regular_file(argv[0], false, 32000); /* larger than copy buffer size */
         test_copy_bytes_regular_file(argv[0], true, 32000);
+        test_copy_holes();
         test_copy_atomic();
         test_copy_proc();
 
@@ -75,7 +75,7 @@ int main(int argc, char *argv[]) {
         _cleanup_(sd_bus_error_free) sd_bus_error err = SD_BUS_ERROR_NULL;
         _cleanup_(manager_freep) Manager *m = NULL;
         Unit *a = NULL, *b = NULL, *c = NULL, *d = NULL, *e = NULL, *g = NULL,
-                *h = NULL, *i = NULL, *a_conj = NULL, *unit_with_multiple_dashes = NULL, *stub = NULL;
+                *h = NULL, *i = NULL, *a_conj = NULL, *unit_with_multiple_dashes = NULL, *stub = NULL, *other;
         Job *j;
         int r;
 
@@ -186,6 +186,7 @@ int main(int argc, char *argv[]) {
         assert_se(!hashmap_get(unit_get_dependencies(b, UNIT_RELOAD_PROPAGATED_FROM), a));
         assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
         assert_se(!hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
+        assert_se(!unit_has_dependency(a, UNIT_ATOM_PROPAGATES_RELOAD_TO, NULL));
 
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b, true, UNIT_DEPENDENCY_UDEV) == 0);
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c, true, UNIT_DEPENDENCY_PROC_SWAP) == 0);
@@ -195,19 +196,30 @@ int main(int argc, char *argv[]) {
         assert_se(hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
         assert_se(hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
 
+        /* The cached dependency arrays must follow changes of the dependencies */
+        assert_se(unit_has_dependency(a, UNIT_ATOM_PROPAGATES_RELOAD_TO, b));
+        assert_se(unit_has_dependency(a, UNIT_ATOM_PROPAGATES_RELOAD_TO, c));
+
         unit_remove_dependencies(a, UNIT_DEPENDENCY_UDEV);
 
         assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), b));
         assert_se(!hashmap_get(unit_get_dependencies(b, UNIT_RELOAD_PROPAGATED_FROM), a));
         assert_se(hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
         assert_se(hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
+        assert_se(!unit_has_dependency(a, UNIT_ATOM_PROPAGATES_RELOAD_TO, b));
+        assert_se(unit_has_dependency(a, UNIT_ATOM_PROPAGATES_RELOAD_TO, c));
 
-        unit_remove_dependencies(a, UNIT_DEPENDENCY_PROC_SWAP);
+        /* Dropping dependencies while iterating through them is fine */
+        UNIT_FOREACH_DEPENDENCY(other, a, UNIT_ATOM_PROPAGATES_RELOAD_TO) {
+                assert_se(other == c);
+                unit_remove_dependencies(a, UNIT_DEPENDENCY_PROC_SWAP);
+        }
 
         assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), b));
         assert_se(!hashmap_get(unit_get_dependencies(b, UNIT_RELOAD_PROPAGATED_FROM), a));
         assert_se(!hashmap_get(unit_get_dependencies(a, UNIT_PROPAGATES_RELOAD_TO), c));
         assert_se(!hashmap_get(unit_get_dependencies(c, UNIT_RELOAD_PROPAGATED_FROM), a));
+        assert_se(!unit_has_dependency(a, UNIT_ATOM_PROPAGATES_RELOAD_TO, NULL));
 
         assert_se(manager_load_unit(m, "unit-with-multiple-dashes.service", NULL, NULL, &unit_with_multiple_dashes) >= 0);
 
@@ -242,7 +254,6 @@ int main(int argc, char *argv[]) {
         assert_se(unit_has_name(a, "merged.service"));
 
         unsigned mm = 1;
-        Unit *other;
 
         UNIT_FOREACH_DEPENDENCY(other, a, UNIT_ATOM_AFTER) {
                 mm *= unit_has_name(other, SPECIAL_BASIC_TARGET) ? 3 : 1;
@@ -782,6 +782,54 @@ static void test_hashmap_many(void) {
         }
 }
 
+static unsigned n_compared = 0;
+
+static int counting_compare_func(const void *a, const void *b) {
+        n_compared++;
+        return trivial_compare_func(a, b);
+}
+
+static const struct hash_ops counting_hash_ops = {
+        .hash = trivial_hash_func,
+        .compare = counting_compare_func,
+};
+
+static void test_hashmap_compare_count(void) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        unsigned i, n = 20000;
+
+        log_info("/* %s */", __func__);
+
+        /* The hash tags should keep us from comparing keys that don't match, except for the occasional
+         * collision of tags */
+
+        assert_se(h = hashmap_new(&counting_hash_ops));
+
+        for (i = 1; i <= n; i++)
+                assert_se(hashmap_put(h, UINT_TO_PTR(i), UINT_TO_PTR(i)) == 1);
+
+        n_compared = 0;
+        for (i = 1; i <= n; i++)
+                assert_se(PTR_TO_UINT(hashmap_get(h, UINT_TO_PTR(i))) == i);
+        log_info("%u compares for %u successful lookups", n_compared, n);
+        assert_se(n_compared >= n && n_compared < n + n / 20);
+
+        n_compared = 0;
+        for (i = n + 1; i <= 2 * n; i++)
+                assert_se(!hashmap_contains(h, UINT_TO_PTR(i)));
+        log_info("%u compares for %u failed lookups", n_compared, n);
+        assert_se(n_compared < n / 20);
+
+        /* Removal shifts entries around, the tags need to move along */
+        for (i = 1; i <= n; i += 2)
+                assert_se(PTR_TO_UINT(hashmap_remove(h, UINT_TO_PTR(i))) == i);
+
+        n_compared = 0;
+        for (i = 1; i <= n; i++)
+                assert_se(hashmap_contains(h, UINT_TO_PTR(i)) == (i % 2 == 0));
+        assert_se(n_compared >= n / 2 && n_compared < n / 2 + n / 20);
+}
+
 extern unsigned custom_counter;
 extern const struct hash_ops boring_hash_ops, custom_hash_ops;
 
@@ -1087,6 +1135,7 @@ void test_hashmap_funcs(void) {
         test_hashmap_get2();
         test_hashmap_size();
         test_hashmap_many();
+        test_hashmap_compare_count();
         test_hashmap_free();
         test_hashmap_free_with_destructor();
         test_hashmap_first();
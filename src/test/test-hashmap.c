@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include "hashmap.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "util.h"
 
@@ -161,6 +162,38 @@ static void test_hashmap_put_strdup_null(void) {
         assert_se(s == NULL);
 }
 
+static void test_hashmap_add_stats(void) {
+        _cleanup_hashmap_free_ Hashmap *m = NULL;
+        _cleanup_ordered_hashmap_free_ OrderedHashmap *o = NULL;
+        HashmapStats stats = {};
+
+        log_info("/* %s */", __func__);
+
+        hashmap_add_stats(NULL, &stats);
+        assert_se(stats.n_maps == 0);
+        assert_se(stats.n_bytes == 0);
+
+        o = ordered_hashmap_new(&string_hash_ops);
+        assert_se(o);
+
+        for (unsigned i = 0; i < 100; i++) {
+                char k[DECIMAL_STR_MAX(unsigned) + 4];
+
+                xsprintf(k, "key %u", i);
+                assert_se(hashmap_put_strdup(&m, k, "value") == 1);
+                assert_se(ordered_hashmap_put(o, "key", NULL) >= 0);
+        }
+
+        hashmap_add_stats(m, &stats);
+        ordered_hashmap_add_stats(o, &stats);
+        assert_se(stats.n_maps == 2);
+        assert_se(stats.n_entries == 101);
+        assert_se(stats.n_buckets == hashmap_buckets(m) + ordered_hashmap_buckets(o));
+        assert_se(stats.n_buckets >= stats.n_entries);
+        assert_se(stats.sum_dib <= (uint64_t) stats.max_dib * stats.n_entries);
+        assert_se(stats.n_bytes > 0);
+}
+
 int main(int argc, const char *argv[]) {
         /* This file tests in test-hashmap-plain.c, and tests in test-hashmap-ordered.c, which is generated
          * from test-hashmap-plain.c. Hashmap tests should be added to test-hashmap-plain.c, and here only if
@@ -181,6 +214,7 @@ int main(int argc, const char *argv[]) {
         test_iterated_cache();
         test_hashmap_put_strdup();
         test_hashmap_put_strdup_null();
+        test_hashmap_add_stats();
 
         return 0;
 }
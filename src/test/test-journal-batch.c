@@ -0,0 +1,211 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "io-util.h"
+#include "journal-batch.h"
+#include "journal-importer.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+static const char *const fields[] = {
+        "MESSAGE=hello",
+        "PRIORITY=6",
+        "SYSLOG_IDENTIFIER=test",
+        "__DUNDER=ignored",
+        "lowercase=passed on literally, dropped by the receiver",
+};
+
+static void assert_iovec_entry(const struct iovec *iovec, const char *content) {
+        assert_se(strlen(content) == iovec->iov_len);
+        assert_se(memcmp(content, iovec->iov_base, iovec->iov_len) == 0);
+}
+
+static void encode_entries(JournalBatchEncoder *e, unsigned n, sd_id128_t boot_id) {
+        for (unsigned i = 0; i < n; i++) {
+                _cleanup_free_ char *counter = NULL;
+
+                assert_se(journal_batch_encoder_begin_entry(e, 1000000 + i, 1000 + i, boot_id) >= 0);
+
+                for (size_t k = 0; k < ELEMENTSOF(fields); k++)
+                        assert_se(journal_batch_encoder_add_field(e, fields[k], strlen(fields[k])) >= 0);
+
+                assert_se(asprintf(&counter, "COUNTER=%u", i) >= 0);
+                assert_se(journal_batch_encoder_add_field(e, counter, strlen(counter)) >= 0);
+
+                assert_se(journal_batch_encoder_end_entry(e) >= 0);
+        }
+}
+
+static void write_frame(int fd, JournalBatchEncoder *e) {
+        _cleanup_free_ void *frame = NULL;
+        size_t size;
+
+        assert_se(journal_batch_encoder_finish(e, &frame, &size) >= 0);
+        assert_se(size > JOURNAL_BATCH_FRAME_HEADER_SIZE);
+        assert_se(e->n_entries == 0);
+
+        assert_se(loop_write(fd, frame, size, false) >= 0);
+}
+
+static void test_roundtrip_one(bool compress) {
+        _cleanup_(journal_batch_encoder_done) JournalBatchEncoder e = JOURNAL_BATCH_ENCODER_INIT(compress);
+        _cleanup_(journal_importer_cleanup) JournalImporter imp = JOURNAL_IMPORTER_INIT(-1);
+        char fn[] = "/tmp/test-journal-batch.XXXXXX";
+        sd_id128_t boot_id1, boot_id2;
+        unsigned n = 0;
+        int fd, r;
+
+        log_info("/* %s(compress=%s) */", __func__, yes_no(compress));
+
+        assert_se(sd_id128_randomize(&boot_id1) >= 0);
+        assert_se(sd_id128_randomize(&boot_id2) >= 0);
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+
+        /* Two frames sharing the name table, with a boot ID change at the end of the second one */
+        encode_entries(&e, 100, boot_id1);
+        write_frame(fd, &e);
+        encode_entries(&e, 1, boot_id1);
+        encode_entries(&e, 1, boot_id2);
+        write_frame(fd, &e);
+
+        assert_se(lseek(fd, 0, SEEK_SET) == 0);
+
+        imp.fd = fd;
+        imp.batch = true;
+
+        for (;;) {
+                char expected[STRLEN("_BOOT_ID=") + SD_ID128_STRING_MAX];
+                _cleanup_free_ char *counter = NULL;
+                unsigned i;
+
+                do
+                        r = journal_importer_process_data(&imp);
+                while (r == 0 && !journal_importer_eof(&imp));
+                if (journal_importer_eof(&imp))
+                        break;
+                assert_se(r == 1);
+
+                i = n < 100 ? n : 0;
+                assert_se(imp.ts.realtime == 1000000 + i);
+                assert_se(imp.ts.monotonic == 1000 + i);
+                assert_se(sd_id128_equal(imp.boot_id, n == 101 ? boot_id2 : boot_id1));
+
+                /* The dunder and lowercase fields are dropped */
+                assert_se(imp.iovw.count == 5);
+                xsprintf(expected, "_BOOT_ID=" SD_ID128_FORMAT_STR, SD_ID128_FORMAT_VAL(imp.boot_id));
+                assert_iovec_entry(&imp.iovw.iovec[0], expected);
+                assert_iovec_entry(&imp.iovw.iovec[1], "MESSAGE=hello");
+                assert_iovec_entry(&imp.iovw.iovec[2], "PRIORITY=6");
+                assert_iovec_entry(&imp.iovw.iovec[3], "SYSLOG_IDENTIFIER=test");
+                assert_se(asprintf(&counter, "COUNTER=%u", i) >= 0);
+                assert_iovec_entry(&imp.iovw.iovec[4], counter);
+
+                journal_importer_drop_iovw(&imp);
+                n++;
+        }
+
+        assert_se(n == 102);
+        assert_se(journal_importer_bytes_remaining(&imp) == 0);
+
+        assert_se(unlink(fn) >= 0);
+}
+
+static void test_roundtrip(void) {
+        test_roundtrip_one(false);
+        test_roundtrip_one(true);
+}
+
+static void test_binary_field(void) {
+        _cleanup_(journal_batch_encoder_done) JournalBatchEncoder e = JOURNAL_BATCH_ENCODER_INIT(false);
+        _cleanup_(journal_batch_decoder_done) JournalBatchDecoder d = {};
+        struct iovec_wrapper iovw = {};
+        static const char binary[] = "BINARY=\001\002\n\003";
+        _cleanup_free_ void *frame = NULL;
+        uint64_t size, uncompressed_size;
+        uint32_t n_entries;
+        dual_timestamp ts;
+        sd_id128_t boot_id;
+        int compression;
+        size_t l;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(journal_batch_encoder_begin_entry(&e, 1, 1, SD_ID128_NULL) >= 0);
+        assert_se(journal_batch_encoder_add_field(&e, binary, sizeof(binary) - 1) >= 0);
+        assert_se(journal_batch_encoder_add_field(&e, "=no name", 8) == -EINVAL);
+        assert_se(journal_batch_encoder_end_entry(&e) >= 0);
+        assert_se(journal_batch_encoder_finish(&e, &frame, &l) >= 0);
+
+        assert_se(journal_batch_parse_frame_header(frame, &compression, &n_entries, &size, &uncompressed_size) >= 0);
+        assert_se(compression == 0);
+        assert_se(n_entries == 1);
+        assert_se(size == l - JOURNAL_BATCH_FRAME_HEADER_SIZE);
+
+        assert_se(journal_batch_decoder_load_frame(&d, compression, n_entries,
+                                                   (uint8_t*) frame + JOURNAL_BATCH_FRAME_HEADER_SIZE,
+                                                   size, uncompressed_size) >= 0);
+        assert_se(journal_batch_decoder_next(&d, &iovw, &ts, &boot_id) >= 0);
+        assert_se(journal_batch_decoder_frame_done(&d));
+
+        /* Without a boot ID no _BOOT_ID= field is generated */
+        assert_se(sd_id128_is_null(boot_id));
+        assert_se(iovw.count == 1);
+        assert_se(iovw.iovec[0].iov_len == sizeof(binary) - 1);
+        assert_se(memcmp(iovw.iovec[0].iov_base, binary, sizeof(binary) - 1) == 0);
+
+        iovw_free_contents(&iovw, false);
+}
+
+static void test_bad_input(void) {
+        _cleanup_(journal_batch_decoder_done) JournalBatchDecoder d = {};
+        struct iovec_wrapper iovw = {};
+        uint8_t header[JOURNAL_BATCH_FRAME_HEADER_SIZE] = {};
+        /* An entry referring to a name that was never defined */
+        static const uint8_t payload[] = { 0x01, 0x01, 0x00, 0x05, 0x01, 'x', 0x00 };
+        uint64_t size, uncompressed_size;
+        uint32_t n_entries;
+        dual_timestamp ts;
+        sd_id128_t boot_id;
+        int compression;
+
+        log_info("/* %s */", __func__);
+
+        /* No entries */
+        assert_se(journal_batch_parse_frame_header(header, &compression, &n_entries, &size, &uncompressed_size) == -EBADMSG);
+
+        /* Unknown compression */
+        header[0] = 0x80;
+        header[4] = 1;
+        header[8] = header[16] = sizeof(payload);
+        assert_se(journal_batch_parse_frame_header(header, &compression, &n_entries, &size, &uncompressed_size) == -EPROTONOSUPPORT);
+
+        /* Size mismatch for an uncompressed frame */
+        header[0] = 0;
+        header[16]++;
+        assert_se(journal_batch_parse_frame_header(header, &compression, &n_entries, &size, &uncompressed_size) == -EBADMSG);
+
+        header[16]--;
+        assert_se(journal_batch_parse_frame_header(header, &compression, &n_entries, &size, &uncompressed_size) >= 0);
+        assert_se(journal_batch_decoder_load_frame(&d, compression, n_entries, payload, size, uncompressed_size) >= 0);
+        assert_se(journal_batch_decoder_next(&d, &iovw, &ts, &boot_id) == -EBADMSG);
+
+        iovw_free_contents(&iovw, false);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_roundtrip();
+        test_binary_field();
+        test_bad_input();
+
+        return 0;
+}
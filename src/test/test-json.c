@@ -109,6 +109,16 @@ static void test_variant(const char *data, Test test) {
         assert_se(json_variant_has_type(w, json_variant_type(v)));
         assert_se(json_variant_equal(v, w));
 
+        w = json_variant_unref(w);
+
+        r = json_parse(data, JSON_PARSE_ARENA, &w, NULL, NULL);
+        assert_se(r == 0);
+        assert_se(w);
+        assert_se(json_variant_has_type(v, json_variant_type(w)));
+        assert_se(json_variant_equal(v, w));
+        if (test)
+                test(w);
+
         s = mfree(s);
         w = json_variant_unref(w);
 
@@ -521,6 +531,159 @@ static void test_bisect(void) {
         }
 }
 
+static void test_parser_feed_one(const char *data, size_t chunk) {
+        _cleanup_(json_variant_unrefp) JsonVariant *expected = NULL, *v = NULL;
+        _cleanup_(json_parser_freep) JsonParser *parser = NULL;
+        _cleanup_free_ char *buffer = NULL;
+        size_t n = strlen(data), fed = 0, consumed = 0;
+        int r;
+
+        assert_se(json_parse(data, 0, &expected, NULL, NULL) >= 0);
+
+        assert_se(json_parser_new(0, &parser) >= 0);
+        assert_se(buffer = new(char, n + 1));
+
+        /* Hand the document to the parser in pieces, keeping only what wasn't consumed yet around, like
+         * varlink does */
+        for (;;) {
+                const char *p;
+                bool final;
+
+                fed = MIN(fed + chunk, n);
+                final = fed == n;
+
+                memcpy(buffer + consumed, data + consumed, fed - consumed);
+                buffer[fed] = 0;
+
+                p = buffer + consumed;
+                r = json_parser_feed(parser, &p, final, &v);
+                assert_se(r >= 0);
+                assert_se(p >= buffer + consumed && p <= buffer + fed);
+                consumed = p - buffer;
+
+                if (r > 0)
+                        break;
+
+                assert_se(!final);
+
+                /* Everything that was consumed is gone for good */
+                memset(buffer, 'X', consumed);
+        }
+
+        assert_se(json_variant_equal(v, expected));
+
+        /* The parser may be reused for the next document */
+        v = json_variant_unref(v);
+        memcpy(buffer, data, n + 1);
+        const char *p = buffer;
+        assert_se(json_parser_feed(parser, &p, true, &v) > 0);
+        assert_se(json_variant_equal(v, expected));
+}
+
+static void test_parser_feed(void) {
+        _cleanup_(json_parser_freep) JsonParser *parser = NULL;
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        const char *p;
+
+        log_info("/* %s */", __func__);
+
+        static const char* const documents[] = {
+                "true",
+                "  12345  ",
+                "-1.5e10",
+                "\"foo\\nbar\\u0935\"",
+                "{\"k\": \"v\", \"foo\": [1, 2, 3], \"bar\": {\"zap\": null}}",
+                "{\"mutant\": [1, null, \"1\", {\"1\": [1, \"1\"]}], \"thisisaverylongproperty\": 1.27}",
+                "[ 0, -0, 0.0, -0.0, 0.000, -0.000, 0e0, -0e0, 0e+0, -0e-0, 0e-0, -0e000, 0e+000 ]",
+                "[[[[[[[[[[{\"a\":[false,true,null,\"waldowaldowaldowaldowaldowaldowaldowaldo\"]}]]]]]]]]]]",
+        };
+
+        for (size_t i = 0; i < ELEMENTSOF(documents); i++)
+                for (size_t chunk = 1; chunk <= strlen(documents[i]) + 1; chunk++)
+                        test_parser_feed_one(documents[i], chunk);
+
+        /* Garbage is refused, at the latest once the document is complete */
+        assert_se(json_parser_new(0, &parser) >= 0);
+        p = "{\"foo\": ]";
+        assert_se(json_parser_feed(parser, &p, true, &v) == -EINVAL);
+
+        parser = json_parser_free(parser);
+        assert_se(json_parser_new(0, &parser) >= 0);
+        p = "[1, 2";
+        assert_se(json_parser_feed(parser, &p, false, &v) == 0);
+        assert_se(streq(p, " 2"));
+        assert_se(json_parser_feed(parser, &p, true, &v) == -EINVAL);
+        assert_se(!v);
+}
+
+static void test_arena(void) {
+        static const char data[] =
+                "{\n"
+                "\"foo\" : \"bar\",\n"
+                "\"long\" : \"waldowaldowaldowaldowaldowaldowaldowaldo\",\n"
+                "\"numbers\" : [ 1, -2, 3.5, 0, false, null, [], {} ],\n"
+                "\"miep\" : { \"hallo\" : 1 }\n"
+                "}\n";
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *w = NULL, *copy = NULL, *large = NULL, *expected = NULL;
+        _cleanup_free_ char *s = NULL, *t = NULL, *formatted = NULL;
+        static const char* const list[] = { "a", "b", "c", NULL };
+        JsonVariant *miep, *hallo, *elements[5000];
+
+        log_info("/* %s */", __func__);
+
+        /* The arena doesn't change anything about the parsed tree, including locations */
+        assert_se(json_parse(data, 0, &v, NULL, NULL) >= 0);
+        assert_se(json_parse(data, JSON_PARSE_ARENA, &w, NULL, NULL) >= 0);
+        assert_se(json_variant_equal(v, w));
+        assert_se(json_variant_format(v, JSON_FORMAT_SOURCE, &s) >= 0);
+        assert_se(json_variant_format(w, JSON_FORMAT_SOURCE, &t) >= 0);
+        assert_se(streq(s, t));
+
+        /* Any part of the tree keeps all of it alive */
+        assert_se(miep = json_variant_by_key(w, "miep"));
+        json_variant_ref(miep);
+        v = json_variant_unref(v);
+        w = json_variant_unref(w);
+        assert_se(hallo = json_variant_by_key(miep, "hallo"));
+        assert_se(json_variant_unsigned(hallo) == 1);
+
+        /* Changes are made to copies, the original remains untouched */
+        copy = json_variant_ref(miep);
+        assert_se(json_variant_set_field_unsigned(&copy, "hallo", 2) >= 0);
+        assert_se(json_variant_set_field_string(&copy, "new", "waldowaldowaldowaldowaldo") >= 0);
+        assert_se(copy != miep);
+        assert_se(json_variant_unsigned(json_variant_by_key(miep, "hallo")) == 1);
+        assert_se(!json_variant_by_key(miep, "new"));
+        assert_se(json_variant_unsigned(json_variant_by_key(copy, "hallo")) == 2);
+        json_variant_unref(miep);
+        copy = json_variant_unref(copy);
+
+        assert_se(json_parse(data, JSON_PARSE_ARENA|JSON_PARSE_SENSITIVE, &w, NULL, NULL) >= 0);
+        assert_se(json_variant_is_sensitive(w));
+        assert_se(json_variant_is_sensitive(json_variant_by_key(w, "long")));
+        w = json_variant_unref(w);
+
+        /* Something large enough for a number of chunks, and a chunk of its own for the outer array */
+        for (unsigned i = 0; i < ELEMENTSOF(elements); i++)
+                assert_se(json_build(elements + i, JSON_BUILD_OBJECT(
+                                                     JSON_BUILD_PAIR("index", JSON_BUILD_UNSIGNED(i)),
+                                                     JSON_BUILD_PAIR("name", JSON_BUILD_STRING("waldowaldowaldowaldo")),
+                                                     JSON_BUILD_PAIR("list", JSON_BUILD_STRV((char**) list)))) >= 0);
+        assert_se(json_variant_new_array(&large, elements, ELEMENTSOF(elements)) >= 0);
+        json_variant_unref_many(elements, ELEMENTSOF(elements));
+        assert_se(json_variant_format(large, 0, &formatted) >= 0);
+        large = json_variant_unref(large);
+
+        assert_se(json_parse(formatted, 0, &expected, NULL, NULL) >= 0);
+        assert_se(json_parse(formatted, JSON_PARSE_ARENA, &large, NULL, NULL) >= 0);
+        assert_se(json_variant_equal(large, expected));
+        assert_se(json_variant_unsigned(json_variant_by_key(json_variant_by_index(large, 4711), "index")) == 4711);
+
+        /* Errors half-way don't leak anything */
+        assert_se(json_parse("{\"foo\" : [ 1, 2, { \"bar\" : \"waldowaldowaldowaldo\" }, ]", JSON_PARSE_ARENA, &v, NULL, NULL) == -EINVAL);
+        assert_se(!v);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -573,6 +736,8 @@ int main(int argc, char *argv[]) {
 
         test_normalize();
         test_bisect();
+        test_parser_feed();
+        test_arena();
 
         return 0;
 }
@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdio.h>
+
+#include "fd-util.h"
+#include "fdset.h"
+#include "fileio.h"
+#include "manager.h"
+#include "manager-serialize.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+#include "unit.h"
+
+static void test_serialize_units(unsigned n_units) {
+        _cleanup_(manager_freep) Manager *m = NULL, *n = NULL;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        usec_t t;
+
+        log_info("/* %s(%u) */", __func__, n_units);
+
+        assert_se(fds = fdset_new());
+
+        assert_se(manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &m) >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        for (unsigned i = 0; i < n_units; i++) {
+                char name[STRLEN("bench-.service") + DECIMAL_STR_MAX(unsigned)];
+                Unit *u;
+
+                xsprintf(name, "bench-%u.service", i);
+                assert_se(manager_load_unit_prepare(m, name, NULL, NULL, &u) >= 0);
+        }
+        manager_dispatch_load_queue(m);
+        log_info("Loaded %u units in %s.", n_units,
+                 format_timespan(buf, sizeof buf, usec_sub_unsigned(now(CLOCK_MONOTONIC), t), USEC_PER_MSEC));
+
+        assert_se(manager_open_serialization(m, &f) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(manager_serialize(m, f, fds, false) >= 0);
+        log_info("Serialized %u units in %s (%lli bytes).", n_units,
+                 format_timespan(buf, sizeof buf, usec_sub_unsigned(now(CLOCK_MONOTONIC), t), USEC_PER_MSEC),
+                 (long long) ftello(f));
+
+        m = manager_free(m);
+        assert_se(fseeko(f, 0, SEEK_SET) >= 0);
+
+        /* This is what happens after daemon-reexec */
+        assert_se(manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &n) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(manager_startup(n, f, fds) >= 0);
+        log_info("Started up with %u serialized units in %s.", n_units,
+                 format_timespan(buf, sizeof buf, usec_sub_unsigned(now(CLOCK_MONOTONIC), t), USEC_PER_MSEC));
+
+        for (unsigned i = 0; i < n_units; i++) {
+                char name[STRLEN("bench-.service") + DECIMAL_STR_MAX(unsigned)];
+                Unit *u;
+
+                xsprintf(name, "bench-%u.service", i);
+                assert_se(u = manager_get_unit(n, name));
+                assert_se(u->load_state == UNIT_LOADED);
+        }
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL, *unit_dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        unsigned max;
+        int r;
+
+        test_setup_logging(LOG_INFO);
+
+        r = enter_cgroup_subroot(NULL);
+        if (r == -ENOMEDIUM)
+                return log_tests_skipped("cgroupfs not available");
+
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+        assert_se(mkdtemp_malloc("/tmp/test-manager-serialize.XXXXXX", &unit_dir) >= 0);
+        assert_se(set_unit_path(unit_dir) >= 0);
+
+        /* Reexecution with tens of thousands of units used to take long, let's keep an eye on it. Only the
+         * slow tests go that far. */
+        max = slow_tests_enabled() ? 40000 : 1000;
+
+        for (unsigned i = 0; i < max; i++) {
+                char name[STRLEN("/bench-.service") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(name, "/bench-%u.service", i);
+                assert_se(write_string_file(strjoina(unit_dir, name),
+                                            "[Service]\n"
+                                            "ExecStart=/bin/true\n",
+                                            WRITE_STRING_FILE_CREATE) >= 0);
+        }
+
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &m);
+        if (manager_errno_skip_test(r))
+                return log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+        m = manager_free(m);
+
+        for (unsigned n = 10; n < max; n *= 10)
+                test_serialize_units(n);
+        test_serialize_units(max);
+
+        return 0;
+}
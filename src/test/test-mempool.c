@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <pthread.h>
+
+#include "mempool.h"
+#include "memory-util.h"
+#include "tests.h"
+
+const bool mempool_use_allowed = true;
+
+#define NUM 1000
+
+static void test_size_classes(void) {
+        log_info("/* %s */", __func__);
+
+        assert_se(mempool_enabled());
+
+        for (size_t size = 0; size <= MEMPOOL_TILE_MAX + 16; size += 7) {
+                uint8_t *a, *b;
+
+                assert_se(a = mempool_alloc0(size));
+                assert_se(b = mempool_alloc(size));
+                assert_se(a != b);
+
+                /* Tiles are aligned like malloc() memory and don't overlap */
+                assert_se(((uintptr_t) a & 15) == 0);
+                assert_se(((uintptr_t) b & 15) == 0);
+                for (size_t i = 0; i < size; i++)
+                        assert_se(a[i] == 0);
+                memset(b, 0xff, size);
+                for (size_t i = 0; i < size; i++)
+                        assert_se(a[i] == 0);
+
+                mempool_free(a, size);
+                mempool_free(b, size);
+        }
+}
+
+static void test_reuse(void) {
+        void *p, *q;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(p = mempool_alloc(24));
+        mempool_free(p, 24);
+
+        /* 24 and 32 bytes share a size class, and freed tiles are reused first */
+        assert_se(q = mempool_alloc(32));
+        assert_se(p == q);
+        mempool_free(q, 32);
+}
+
+static void* thread_alloc(void *userdata) {
+        void **tiles = userdata;
+
+        for (unsigned i = 0; i < NUM; i++)
+                assert_se(tiles[i] = mempool_alloc0(48));
+
+        return NULL;
+}
+
+static void* thread_free(void *userdata) {
+        void **tiles = userdata;
+
+        for (unsigned i = 0; i < NUM; i++)
+                mempool_free(tiles[i], 48);
+
+        return NULL;
+}
+
+static void test_threads(void) {
+        void *tiles[NUM];
+        pthread_t t;
+
+        log_info("/* %s */", __func__);
+
+        /* Allocate in one thread, and free in another one, which then exits and leaves its tiles to the
+         * depot, from where we may pick them up again */
+
+        assert_se(pthread_create(&t, NULL, thread_alloc, tiles) == 0);
+        assert_se(pthread_join(t, NULL) == 0);
+
+        assert_se(pthread_create(&t, NULL, thread_free, tiles) == 0);
+        assert_se(pthread_join(t, NULL) == 0);
+
+        thread_alloc(tiles);
+        thread_free(tiles);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_size_classes();
+        test_reuse();
+        test_threads();
+
+        return 0;
+}
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "metrics.h"
+#include "string-util.h"
+#include "tests.h"
+
+static void test_latency_histogram(void) {
+        LatencyHistogram h = {};
+
+        log_info("/* %s */", __func__);
+
+        assert_se(latency_histogram_percentile(&h, 50) == USEC_INFINITY);
+
+        for (unsigned i = 0; i < 90; i++)
+                latency_histogram_add(&h, 500);               /* bucket 0, i.e. < 1ms */
+        for (unsigned i = 0; i < 10; i++)
+                latency_histogram_add(&h, 3 * USEC_PER_MSEC); /* bucket 2, i.e. < 4ms */
+
+        assert_se(h.n == 100);
+        assert_se(h.buckets[0] == 90);
+        assert_se(h.buckets[2] == 10);
+        assert_se(h.sum == 90 * 500 + 10 * 3 * USEC_PER_MSEC);
+
+        assert_se(latency_histogram_percentile(&h, 50) == USEC_PER_MSEC);
+        assert_se(latency_histogram_percentile(&h, 90) == USEC_PER_MSEC);
+        assert_se(latency_histogram_percentile(&h, 99) == 4 * USEC_PER_MSEC);
+
+        /* Everything beyond the last limit ends up in the last bucket */
+        latency_histogram_add(&h, USEC_INFINITY - 1);
+        assert_se(h.buckets[LATENCY_HISTOGRAM_BUCKETS - 1] == 1);
+        assert_se(latency_histogram_percentile(&h, 100) == USEC_INFINITY);
+}
+
+static uint64_t get_answer(void *userdata) {
+        return 42;
+}
+
+static const LatencyHistogram* get_histogram(void *userdata) {
+        return userdata;
+}
+
+static void test_metrics_build_json(void) {
+        static const Metric metrics[] = {
+                { "test_answer_total", "The answer",  METRIC_COUNTER,   .get_value = get_answer        },
+                { "test_answer",       NULL,          METRIC_GAUGE,     .get_value = get_answer        },
+                { "test_latency",      "Some delays", METRIC_HISTOGRAM, .get_histogram = get_histogram },
+        };
+
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        LatencyHistogram h = {};
+        JsonVariant *array, *e;
+
+        log_info("/* %s */", __func__);
+
+        latency_histogram_add(&h, 5 * USEC_PER_MSEC);
+
+        assert_se(metrics_build_json(metrics, ELEMENTSOF(metrics), &h, &v) >= 0);
+        json_variant_dump(v, JSON_FORMAT_PRETTY_AUTO|JSON_FORMAT_COLOR_AUTO, NULL, NULL);
+
+        assert_se(array = json_variant_by_key(v, "metrics"));
+        assert_se(json_variant_elements(array) == ELEMENTSOF(metrics));
+
+        assert_se(e = json_variant_by_index(array, 0));
+        assert_se(streq(json_variant_string(json_variant_by_key(e, "name")), "test_answer_total"));
+        assert_se(streq(json_variant_string(json_variant_by_key(e, "type")), "counter"));
+        assert_se(streq(json_variant_string(json_variant_by_key(e, "description")), "The answer"));
+        assert_se(json_variant_unsigned(json_variant_by_key(e, "value")) == 42);
+
+        assert_se(e = json_variant_by_index(array, 1));
+        assert_se(streq(json_variant_string(json_variant_by_key(e, "type")), "gauge"));
+        assert_se(!json_variant_by_key(e, "description"));
+
+        assert_se(e = json_variant_by_index(array, 2));
+        assert_se(streq(json_variant_string(json_variant_by_key(e, "type")), "histogram"));
+        assert_se(json_variant_unsigned(json_variant_by_key(json_variant_by_key(e, "value"), "count")) == 1);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_latency_histogram();
+        test_metrics_build_json();
+
+        return 0;
+}
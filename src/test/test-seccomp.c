@@ -1153,6 +1153,62 @@ static void test_restrict_suid_sgid(void) {
         assert_se(wait_for_terminate_and_check("suidsgidseccomp", pid, WAIT_LOG) == EXIT_SUCCESS);
 }
 
+static void test_record_programs(void) {
+        _cleanup_(seccomp_programs_freep) SeccompPrograms *programs = NULL, *more = NULL;
+        pid_t pid;
+
+        log_info("/* %s */", __func__);
+
+        if (!is_seccomp_available()) {
+                log_notice("Seccomp not available, skipping %s", __func__);
+                return;
+        }
+        if (!have_seccomp_privs()) {
+                log_notice("Not privileged, skipping %s", __func__);
+                return;
+        }
+
+        /* in containers syslog() is likely missing anyway */
+        if (detect_container() > 0) {
+                log_notice("Testing in container, skipping %s", __func__);
+                return;
+        }
+
+        assert_se(programs = new0(SeccompPrograms, 1));
+        assert_se(more = new0(SeccompPrograms, 1));
+
+        seccomp_record_begin(programs);
+        assert_se(seccomp_protect_syslog() >= 0);
+        seccomp_record_switch(more);
+        assert_se(seccomp_protect_sysctl() >= 0);
+        assert_se(seccomp_record_end() >= 0);
+        assert_se(programs->n_programs > 0);
+        assert_se(more->n_programs > 0);
+
+        /* Recording must not have installed anything in this process */
+#if defined __NR_syslog && __NR_syslog >= 0
+        assert_se(syscall(__NR_syslog, -1, NULL, 0) < 0);
+        assert_se(errno == EINVAL);
+#endif
+
+        pid = fork();
+        assert_se(pid >= 0);
+
+        if (pid == 0) {
+                assert_se(seccomp_programs_load(programs) >= 0);
+                assert_se(seccomp_programs_load(more) >= 0);
+
+#if defined __NR_syslog && __NR_syslog >= 0
+                assert_se(syscall(__NR_syslog, 0, 0, 0) < 0);
+                assert_se(errno == EPERM);
+#endif
+
+                _exit(EXIT_SUCCESS);
+        }
+
+        assert_se(wait_for_terminate_and_check("recordseccomp", pid, WAIT_LOG) == EXIT_SUCCESS);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -1173,6 +1229,7 @@ int main(int argc, char *argv[]) {
         test_load_syscall_filter_set_raw();
         test_lock_personality();
         test_restrict_suid_sgid();
+        test_record_programs();
 
         return 0;
 }
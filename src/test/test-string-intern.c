@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "string-intern.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+
+static void test_string_intern(void) {
+        _cleanup_(string_intern_unrefp) const char *a = NULL, *b = NULL, *c = NULL;
+        char buf[] = "/usr/lib/systemd/system/getty@.service";
+
+        log_info("/* %s */", __func__);
+
+        assert_se(!string_intern(NULL));
+
+        assert_se(a = string_intern(buf));
+        assert_se(a != buf);
+        assert_se(streq(a, buf));
+
+        /* Equal strings are stored only once */
+        assert_se(b = string_intern(buf));
+        assert_se(string_intern_equal(a, b));
+
+        /* … and are independent of the original */
+        buf[0] = 'x';
+        assert_se(c = string_intern(buf));
+        assert_se(!string_intern_equal(a, c));
+        assert_se(streq(a, "/usr/lib/systemd/system/getty@.service"));
+
+        assert_se(string_intern_ref(a) == a);
+        assert_se(!string_intern_unref(a));
+        assert_se(!string_intern_unref(b));
+        b = NULL;
+        assert_se(streq(a, "/usr/lib/systemd/system/getty@.service"));
+}
+
+static void test_string_intern_replace(void) {
+        _cleanup_(string_intern_unrefp) const char *p = NULL;
+        const char *q;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(string_intern_replace(&p, "foo") == 1);
+        assert_se(streq(p, "foo"));
+        q = p;
+        assert_se(string_intern_replace(&p, "foo") == 0);
+        assert_se(p == q);
+        assert_se(string_intern_replace(&p, "bar") == 1);
+        assert_se(streq(p, "bar"));
+        assert_se(string_intern_replace(&p, NULL) == 1);
+        assert_se(!p);
+}
+
+static void test_strv_extend_interned(void) {
+        char **l = NULL;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(strv_extend_interned(&l, NULL) == 0);
+        assert_se(!l);
+
+        assert_se(strv_extend_interned(&l, STRV_MAKE("a.conf", "b.conf", "a.conf")) == 2);
+        assert_se(strv_equal(l, STRV_MAKE("a.conf", "b.conf")));
+        assert_se(strv_extend_interned(&l, STRV_MAKE("b.conf", "c.conf")) == 1);
+        assert_se(strv_equal(l, STRV_MAKE("a.conf", "b.conf", "c.conf")));
+
+        assert_se(!strv_free_interned(l));
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_string_intern();
+        test_string_intern_replace();
+        test_strv_extend_interned();
+
+        return 0;
+}
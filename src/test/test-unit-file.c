@@ -1,10 +1,16 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fileio.h"
 #include "path-lookup.h"
+#include "rm-rf.h"
 #include "set.h"
 #include "special.h"
 #include "strv.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 #include "unit-file.h"
 
 static void test_unit_validate_alias_symlink_and_warn(void) {
@@ -37,7 +43,7 @@ static void test_unit_file_build_name_map(char **ids) {
 
         assert_se(lookup_paths_init(&lp, UNIT_FILE_SYSTEM, 0, NULL) >= 0);
 
-        assert_se(unit_file_build_name_map(&lp, &mtime, &unit_ids, &unit_names, NULL) == 1);
+        assert_se(unit_file_build_name_map(&lp, &mtime, &unit_ids, &unit_names, NULL, NULL) == 1);
 
         HASHMAP_FOREACH_KEY(dst, k, unit_ids)
                 log_info("ids: %s → %s", k, dst);
@@ -50,7 +56,7 @@ static void test_unit_file_build_name_map(char **ids) {
         char buf[FORMAT_TIMESTAMP_MAX];
         log_debug("Last modification time: %s", format_timestamp(buf, sizeof buf, mtime));
 
-        r = unit_file_build_name_map(&lp, &mtime, &unit_ids, &unit_names, NULL);
+        r = unit_file_build_name_map(&lp, &mtime, &unit_ids, &unit_names, NULL, NULL);
         assert_se(IN_SET(r, 0, 1));
         if (r == 0)
                 log_debug("Cache rebuild skipped based on mtime.");
@@ -73,6 +79,66 @@ static void test_unit_file_build_name_map(char **ids) {
         }
 }
 
+static void test_unit_file_build_name_map_dir_cache(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *tmp = NULL;
+        _cleanup_hashmap_free_ Hashmap *unit_ids = NULL, *unit_names = NULL, *dir_cache = NULL;
+        _cleanup_(lookup_paths_free) LookupPaths lp = {};
+        const struct timespec ts[2] = { { .tv_sec = 1 }, { .tv_sec = 1 } };
+        const char *a, *b, *fragment;
+        uint64_t timestamp_hash = 0;
+        void *cached_a;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(mkdtemp_malloc("/tmp/test-unit-file.XXXXXX", &tmp) >= 0);
+        a = strjoina(tmp, "/a");
+        b = strjoina(tmp, "/b");
+        assert_se(mkdir(a, 0755) >= 0);
+        assert_se(mkdir(b, 0755) >= 0);
+        assert_se(lp.search_path = strv_new(a, b));
+
+        assert_se(write_string_file(strjoina(a, "/foo.service"), "[Service]", WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(symlink(strjoina(a, "/foo.service"), strjoina(b, "/bar.service")) >= 0);
+
+        assert_se(unit_file_build_name_map(&lp, &timestamp_hash, &unit_ids, &unit_names, NULL, &dir_cache) == 1);
+        assert_se(hashmap_size(dir_cache) == 2);
+        assert_se(cached_a = hashmap_get(dir_cache, a));
+
+        {
+                _cleanup_set_free_free_ Set *names = NULL;
+
+                assert_se(unit_file_find_fragment(unit_ids, unit_names, "bar.service", &fragment, &names) == 0);
+                assert_se(streq(fragment, strjoina(a, "/foo.service")));
+                assert_se(set_contains(names, "foo.service"));
+                assert_se(set_contains(names, "bar.service"));
+        }
+
+        /* Nothing changed */
+        assert_se(unit_file_build_name_map(&lp, &timestamp_hash, &unit_ids, &unit_names, NULL, &dir_cache) == 0);
+
+        /* Only the modified directory is read again. Set the modification time explicitly, the clock might
+         * not have advanced since the directory was read. */
+        assert_se(write_string_file(strjoina(b, "/baz.service"), "[Service]", WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(utimensat(AT_FDCWD, b, ts, 0) >= 0);
+
+        assert_se(unit_file_build_name_map(&lp, &timestamp_hash, &unit_ids, &unit_names, NULL, &dir_cache) == 1);
+        assert_se(hashmap_get(dir_cache, a) == cached_a);
+
+        {
+                _cleanup_set_free_free_ Set *names = NULL;
+
+                assert_se(unit_file_find_fragment(unit_ids, unit_names, "baz.service", &fragment, &names) == 0);
+                assert_se(streq(fragment, strjoina(b, "/baz.service")));
+        }
+
+        /* If the search path changes, all directories are read again */
+        assert_se(strv_extend(&lp.search_path, tmp) >= 0);
+        timestamp_hash = 0;
+        assert_se(unit_file_build_name_map(&lp, &timestamp_hash, &unit_ids, &unit_names, NULL, &dir_cache) == 1);
+        assert_se(hashmap_size(dir_cache) == 3);
+        assert_se(hashmap_contains(unit_ids, "bar.service"));
+}
+
 static void test_runlevel_to_target(void) {
         log_info("/* %s */", __func__);
 
@@ -97,6 +163,7 @@ int main(int argc, char **argv) {
 
         test_unit_validate_alias_symlink_and_warn();
         test_unit_file_build_name_map(strv_skip(argv, 1));
+        test_unit_file_build_name_map_dir_cache();
         test_runlevel_to_target();
 
         return 0;
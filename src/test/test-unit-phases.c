@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "process-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "unit-phases.h"
+
+static void test_unit_phases_record(void) {
+        _cleanup_free_ UnitPhaseRecord *records = NULL;
+        UnitPhases *p;
+        size_t n;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(unit_phases_new(&p) >= 0);
+
+        assert_se(unit_phases_get(p, &records, &n) >= 0);
+        assert_se(n == 0);
+
+        unit_phases_record(p, "foo.service", UNIT_PHASE_LOAD, 10, 20);
+        unit_phases_record(p, "foo.service", UNIT_PHASE_FORK, 30, 20); /* ends before it begins, ignored */
+        unit_phases_record(p, "bar.service", UNIT_PHASE_ACTIVATION, 20, 50);
+
+        assert_se(unit_phases_get(p, &records, &n) >= 0);
+        assert_se(n == 2);
+        assert_se(streq(records[0].unit, "foo.service"));
+        assert_se(records[0].phase == UNIT_PHASE_LOAD);
+        assert_se(records[0].begin == 10);
+        assert_se(records[0].end == 20);
+        assert_se(streq(records[1].unit, "bar.service"));
+        assert_se(records[1].phase == UNIT_PHASE_ACTIVATION);
+        records = mfree(records);
+
+        /* The ring wraps around, keeping the most recent records */
+        for (unsigned i = 0; i < 10000; i++)
+                unit_phases_record(p, "baz.service", UNIT_PHASE_JOB_WAIT, 1, i + 1);
+
+        assert_se(unit_phases_get(p, &records, &n) >= 0);
+        assert_se(n > 0 && n < 10000);
+        assert_se(records[n - 1].end == 10000);
+        for (size_t i = 1; i < n; i++)
+                assert_se(records[i].end == records[i - 1].end + 1);
+
+        unit_phases_free(p);
+}
+
+static void test_unit_phases_child(void) {
+        _cleanup_free_ UnitPhaseRecord *records = NULL;
+        UnitPhases *p;
+        size_t n;
+        int r;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(unit_phases_new(&p) >= 0);
+
+        /* Records from forked off children must end up in the ring buffer of the parent */
+        r = safe_fork("(test-unit-phases)", FORK_WAIT|FORK_LOG, NULL);
+        assert_se(r >= 0);
+        if (r == 0) {
+                unit_phases_record(p, "child.service", UNIT_PHASE_EXEC_SETUP, 1, 2);
+                _exit(EXIT_SUCCESS);
+        }
+
+        assert_se(unit_phases_get(p, &records, &n) >= 0);
+        assert_se(n == 1);
+        assert_se(streq(records[0].unit, "child.service"));
+        assert_se(records[0].phase == UNIT_PHASE_EXEC_SETUP);
+
+        unit_phases_free(p);
+}
+
+static void test_unit_phase_table(void) {
+        log_info("/* %s */", __func__);
+
+        for (UnitPhase i = 0; i < _UNIT_PHASE_MAX; i++)
+                assert_se(unit_phase_from_string(unit_phase_to_string(i)) == i);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_unit_phases_record();
+        test_unit_phases_child();
+        test_unit_phase_table();
+
+        return 0;
+}
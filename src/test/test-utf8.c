@@ -46,6 +46,55 @@ static void test_utf8_is_valid(void) {
         assert_se(!utf8_is_valid("\341\204"));
 }
 
+static void test_utf8_word_boundaries(void) {
+        log_info("/* %s */", __func__);
+
+        /* Longer strings are looked at a word at a time where possible, hence place the interesting bits
+         * at all kinds of offsets */
+
+        for (size_t i = 0; i < 40; i++) {
+                char buf[41];
+
+                memset(buf, 'a', sizeof(buf) - 1);
+                buf[sizeof(buf) - 1] = 0;
+                assert_se(utf8_is_valid(buf));
+                assert_se(utf8_is_valid_n(buf, sizeof(buf) - 1));
+                assert_se(utf8_is_printable(buf, sizeof(buf) - 1));
+
+                buf[i] = '\001';
+                assert_se(utf8_is_valid(buf));
+                assert_se(!utf8_is_printable(buf, sizeof(buf) - 1));
+                assert_se(utf8_is_printable(buf, i));
+
+                buf[i] = 0x7F;
+                assert_se(utf8_is_valid(buf));
+                assert_se(!utf8_is_printable(buf, sizeof(buf) - 1));
+
+                buf[i] = '\n';
+                assert_se(utf8_is_printable(buf, sizeof(buf) - 1));
+                assert_se(!utf8_is_printable_newline(buf, sizeof(buf) - 1, false));
+
+                buf[i] = 0;
+                assert_se(utf8_is_valid(buf));
+                assert_se(!utf8_is_valid_n(buf, sizeof(buf) - 1));
+                assert_se(utf8_is_valid_n(buf, i));
+
+                buf[i] = '\341';
+                assert_se(!utf8_is_valid(buf));
+                assert_se(!utf8_is_valid_n(buf, sizeof(buf) - 1));
+                assert_se(!utf8_is_printable(buf, sizeof(buf) - 1));
+                assert_se(utf8_is_valid_n(buf, i));
+
+                if (i + 2 < sizeof(buf) - 1) {
+                        memcpy(buf + i, "\342\204\242", 3);
+                        assert_se(utf8_is_valid(buf));
+                        assert_se(utf8_is_valid_n(buf, sizeof(buf) - 1));
+                        assert_se(utf8_is_printable(buf, sizeof(buf) - 1));
+                        assert_se(!utf8_is_valid_n(buf, i + 2));
+                }
+        }
+}
+
 static void test_ascii_is_valid(void) {
         log_info("/* %s */", __func__);
 
@@ -239,6 +288,7 @@ int main(int argc, char *argv[]) {
         test_utf8_n_is_valid();
         test_utf8_is_valid();
         test_utf8_is_printable();
+        test_utf8_word_boundaries();
         test_ascii_is_valid();
         test_ascii_is_valid_n();
         test_utf8_encoded_valid_unichar();
@@ -8,7 +8,10 @@
 
 #include "fd-util.h"
 #include "json.h"
+#include "missing_syscall.h"
+#include "process-util.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 #include "strv.h"
 #include "tmpfile-util.h"
 #include "user-util.h"
@@ -48,6 +51,82 @@ static int method_something(Varlink *link, JsonVariant *parameters, VarlinkMetho
         return varlink_reply(link, ret);
 }
 
+static int method_large(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *items = NULL;
+        JsonVariant **array = NULL;
+        JsonVariant *n;
+        size_t k = 0;
+        int r;
+
+        /* Returns a reply much larger than what is read at once, so that it's parsed piecemeal */
+
+        n = json_variant_by_key(parameters, "n");
+        if (!n || !json_variant_is_unsigned(n))
+                return varlink_error(link, "io.test.BadParameters", NULL);
+
+        array = new(JsonVariant*, json_variant_unsigned(n));
+        if (!array)
+                return -ENOMEM;
+
+        for (; k < json_variant_unsigned(n); k++) {
+                char s[DECIMAL_STR_MAX(size_t) + 32];
+
+                xsprintf(s, "item-%zu-waldowaldowaldowaldowaldo", k);
+
+                r = json_build(array + k, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("index", JSON_BUILD_UNSIGNED(k)),
+                                                            JSON_BUILD_PAIR("name", JSON_BUILD_STRING(s))));
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = json_variant_new_array(&items, array, k);
+
+finish:
+        json_variant_unref_many(array, k);
+        free(array);
+
+        if (r < 0)
+                return r;
+
+        return varlink_replyb(link, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("items", JSON_BUILD_VARIANT(items))));
+}
+
+static int method_count(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        JsonVariant *n;
+        int r;
+
+        /* Sends the numbers 0…n-1, each in a reply of its own if "more" was requested */
+
+        n = json_variant_by_key(parameters, "n");
+        if (!n || !json_variant_is_unsigned(n) || json_variant_unsigned(n) == 0)
+                return varlink_error(link, "io.test.BadParameters", NULL);
+
+        if (FLAGS_SET(flags, VARLINK_METHOD_MORE))
+                for (uintmax_t k = 0; k + 1 < json_variant_unsigned(n); k++) {
+                        r = varlink_notifyb(link, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("k", JSON_BUILD_UNSIGNED(k))));
+                        if (r < 0)
+                                return r;
+                }
+
+        return varlink_replyb(link, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("k", JSON_BUILD_UNSIGNED(json_variant_unsigned(n) - 1))));
+}
+
+static int method_multiply(JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata, JsonVariant **ret_reply, const char **ret_error_id) {
+        JsonVariant *a, *b;
+
+        /* Runs in a worker thread, not the one running the event loop */
+        assert_se(gettid() != getpid_cached());
+
+        a = json_variant_by_key(parameters, "a");
+        b = json_variant_by_key(parameters, "b");
+        if (!a || !b) {
+                *ret_error_id = "io.test.BadParameters";
+                return 0;
+        }
+
+        return json_build(ret_reply, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("product", JSON_BUILD_INTEGER(json_variant_integer(a) * json_variant_integer(b)))));
+}
+
 static int method_done(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
 
         if (++n_done == 2)
@@ -140,6 +219,95 @@ static void flood_test(const char *address) {
                 connections[k] = varlink_unref(connections[k]);
 }
 
+#define N_PIPELINED 8
+
+typedef struct PipelinedCall {
+        unsigned index;
+        unsigned n_replies;
+} PipelinedCall;
+
+static PipelinedCall pipelined[N_PIPELINED + 1];
+static unsigned n_pipelined_done = 0;
+
+static int pipelined_reply(Varlink *link, JsonVariant *parameters, const char *error_id, VarlinkReplyFlags flags, void *userdata) {
+        PipelinedCall *p = userdata;
+
+        assert_se(p);
+        assert_se(!error_id);
+
+        /* Replies arrive in the order the calls were made */
+        assert_se(p->index == n_pipelined_done);
+
+        if (p->index == 3) {
+                /* The observed call: replies count up */
+                assert_se(json_variant_unsigned(json_variant_by_key(parameters, "k")) == p->n_replies);
+                assert_se(FLAGS_SET(flags, VARLINK_REPLY_CONTINUES) == (p->n_replies < 4));
+        } else {
+                assert_se(json_variant_integer(json_variant_by_key(parameters, "sum")) == 2 * p->index);
+                assert_se(!FLAGS_SET(flags, VARLINK_REPLY_CONTINUES));
+        }
+
+        p->n_replies++;
+        if (FLAGS_SET(flags, VARLINK_REPLY_CONTINUES))
+                return 0;
+
+        n_pipelined_done++;
+
+        /* Further calls may be issued from the reply callback */
+        if (p->index == N_PIPELINED - 1) {
+                _cleanup_(json_variant_unrefp) JsonVariant *i = NULL;
+
+                assert_se(json_build(&i, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("a", JSON_BUILD_INTEGER(N_PIPELINED)),
+                                                           JSON_BUILD_PAIR("b", JSON_BUILD_INTEGER(N_PIPELINED)))) >= 0);
+                assert_se(varlink_invoke_full(link, "io.test.DoSomething", i, pipelined_reply, pipelined + N_PIPELINED) >= 0);
+        }
+
+        return 0;
+}
+
+static void pipeline_test(Varlink *c) {
+        JsonVariant *o = NULL;
+        const char *e;
+
+        for (unsigned k = 0; k <= N_PIPELINED; k++)
+                pipelined[k] = (PipelinedCall) { .index = k };
+
+        /* Issue all calls at once, without waiting for any reply in between */
+        for (unsigned k = 0; k < N_PIPELINED; k++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *i = NULL;
+
+                if (k == 3) {
+                        assert_se(json_build(&i, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("n", JSON_BUILD_UNSIGNED(5)))) >= 0);
+                        assert_se(varlink_observe_full(c, "io.test.Count", i, pipelined_reply, pipelined + k) >= 0);
+                } else {
+                        assert_se(json_build(&i, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("a", JSON_BUILD_INTEGER(k)),
+                                                                   JSON_BUILD_PAIR("b", JSON_BUILD_INTEGER(k)))) >= 0);
+                        assert_se(varlink_invoke_full(c, "io.test.DoSomething", i, pipelined_reply, pipelined + k) >= 0);
+                }
+        }
+
+        /* A synchronous call has to wait until all of them are complete */
+        assert_se(varlink_callb(c, "io.test.Count", &o, &e, NULL, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("n", JSON_BUILD_UNSIGNED(1)))) == -EBUSY);
+
+        while (n_pipelined_done <= N_PIPELINED) {
+                int r;
+
+                r = varlink_process(c);
+                assert_se(r >= 0);
+                if (r == 0)
+                        assert_se(varlink_wait(c, USEC_INFINITY) >= 0);
+        }
+
+        assert_se(pipelined[3].n_replies == 5);
+        for (unsigned k = 0; k <= N_PIPELINED; k++)
+                if (k != 3)
+                        assert_se(pipelined[k].n_replies == 1);
+
+        assert_se(varlink_callb(c, "io.test.Count", &o, &e, NULL, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("n", JSON_BUILD_UNSIGNED(1)))) >= 0);
+        assert_se(!e);
+        assert_se(json_variant_unsigned(json_variant_by_key(o, "k")) == 0);
+}
+
 static void *thread(void *arg) {
         _cleanup_(varlink_flush_close_unrefp) Varlink *c = NULL;
         _cleanup_(json_variant_unrefp) JsonVariant *i = NULL;
@@ -160,6 +328,22 @@ static void *thread(void *arg) {
         assert_se(streq_ptr(json_variant_string(json_variant_by_key(o, "method")), "io.test.IDontExist"));
         assert_se(streq(e, VARLINK_ERROR_METHOD_NOT_FOUND));
 
+        assert_se(varlink_callb(c, "io.test.Large", &o, &e, NULL, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("n", JSON_BUILD_UNSIGNED(20000)))) >= 0);
+        assert_se(!e);
+        assert_se(json_variant_elements(json_variant_by_key(o, "items")) == 20000);
+        assert_se(json_variant_unsigned(json_variant_by_key(json_variant_by_index(json_variant_by_key(o, "items"), 12345), "index")) == 12345);
+        assert_se(streq_ptr(json_variant_string(json_variant_by_key(json_variant_by_index(json_variant_by_key(o, "items"), 19999), "name")),
+                            "item-19999-waldowaldowaldowaldowaldo"));
+
+        pipeline_test(c);
+
+        assert_se(varlink_call(c, "io.test.Multiply", i, &o, &e, NULL) >= 0);
+        assert_se(json_variant_integer(json_variant_by_key(o, "product")) == 88 * 99);
+        assert_se(!e);
+
+        assert_se(varlink_callb(c, "io.test.Multiply", &o, &e, NULL, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("a", JSON_BUILD_INTEGER(5)))) >= 0);
+        assert_se(streq_ptr(e, "io.test.BadParameters"));
+
         flood_test(arg);
 
         assert_se(varlink_send(c, "io.test.Done", NULL) >= 0);
@@ -212,7 +396,12 @@ int main(int argc, char *argv[]) {
         assert_se(varlink_server_set_description(s, "our-server") >= 0);
 
         assert_se(varlink_server_bind_method(s, "io.test.DoSomething", method_something) >= 0);
+        assert_se(varlink_server_bind_method(s, "io.test.Large", method_large) >= 0);
+        assert_se(varlink_server_bind_method(s, "io.test.Count", method_count) >= 0);
         assert_se(varlink_server_bind_method(s, "io.test.Done", method_done) >= 0);
+        assert_se(varlink_server_bind_work_method(s, "io.test.Multiply", method_multiply) >= 0);
+        assert_se(varlink_server_bind_work_method(s, "io.test.Done", method_multiply) == -EEXIST);
+        assert_se(varlink_server_set_workers_max(s, 2) >= 0);
         assert_se(varlink_server_bind_connect(s, on_connect) >= 0);
         assert_se(varlink_server_listen_address(s, sp, 0600) >= 0);
         assert_se(varlink_server_attach_event(s, e, 0) >= 0);
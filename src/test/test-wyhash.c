@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "random-util.h"
+#include "tests.h"
+#include "wyhash.h"
+
+static void test_wyhash_lengths(void) {
+        uint8_t buf[256 + 8];
+        uint64_t h[257];
+
+        log_info("/* %s */", __func__);
+
+        random_bytes(buf, sizeof(buf));
+
+        /* Inputs of all sizes on both sides of the 4, 16 and 48 byte boundaries, and the result doesn't
+         * depend on the alignment of the input */
+        for (size_t n = 0; n <= 256; n++) {
+                h[n] = wyhash(buf, n, 4711);
+
+                for (size_t offset = 1; offset < 8; offset++) {
+                        memmove(buf + offset, buf, n);
+                        assert_se(wyhash(buf + offset, n, 4711) == h[n]);
+                        memmove(buf, buf + offset, n);
+                }
+
+                /* Prefixes of the same data hash differently */
+                for (size_t k = 0; k < n; k++)
+                        assert_se(h[k] != h[n]);
+        }
+}
+
+static void test_wyhash_bits(void) {
+        static const size_t sizes[] = { 3, 8, 16, 40, 100 };
+        uint8_t buf[100];
+
+        log_info("/* %s */", __func__);
+
+        random_bytes(buf, sizeof(buf));
+
+        /* Every bit of the input and every bit of the seed matters */
+        for (size_t j = 0; j < ELEMENTSOF(sizes); j++) {
+                size_t n = sizes[j];
+                uint64_t h = wyhash(buf, n, 0);
+
+                for (size_t i = 0; i < n * 8; i++) {
+                        buf[i / 8] ^= 1U << (i % 8);
+                        assert_se(wyhash(buf, n, 0) != h);
+                        buf[i / 8] ^= 1U << (i % 8);
+                }
+
+                for (unsigned i = 0; i < 64; i++)
+                        assert_se(wyhash(buf, n, UINT64_C(1) << i) != h);
+
+                assert_se(wyhash(buf, n, 0) == h);
+        }
+}
+
+static void test_wyhash_string(void) {
+        log_info("/* %s */", __func__);
+
+        assert_se(wyhash_string("", 0) == wyhash(NULL, 0, 0));
+        assert_se(wyhash_string("waldo.service", 1) == wyhash("waldo.service", 13, 1));
+        assert_se(wyhash_string("waldo.service", 1) != wyhash_string("waldo.socket", 1));
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_wyhash_lengths();
+        test_wyhash_bits();
+        test_wyhash_string();
+
+        return 0;
+}
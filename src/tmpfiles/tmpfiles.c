@@ -587,6 +587,23 @@ static bool needs_cleanup(
         return true;
 }
 
+static unsigned age_by_to_statx_mask(AgeBy age_by_file, AgeBy age_by_dir) {
+        AgeBy age_by = age_by_file | age_by_dir;
+        unsigned mask;
+
+        /* The access and modification times are always needed, since we restore them on directories we
+         * removed something from. The change and birth times are only queried if they are actually looked
+         * at, since they might be expensive to get on some file systems (e.g. network file systems, which
+         * may have to ask the server for attributes not in their cache). */
+        mask = STATX_TYPE|STATX_MODE|STATX_UID|STATX_ATIME|STATX_MTIME;
+        if (FLAGS_SET(age_by, AGE_BY_CTIME))
+                mask |= STATX_CTIME;
+        if (FLAGS_SET(age_by, AGE_BY_BTIME))
+                mask |= STATX_BTIME;
+
+        return mask;
+}
+
 static int dir_cleanup(
                 Item *i,
                 const char *p,
@@ -600,7 +617,8 @@ static int dir_cleanup(
                 int maxdepth,
                 bool keep_this_level,
                 AgeBy age_by_file,
-                AgeBy age_by_dir) {
+                AgeBy age_by_dir,
+                uint64_t *n_entries) {
 
         bool deleted = false;
         struct dirent *dent;
@@ -613,6 +631,8 @@ static int dir_cleanup(
                 if (dot_or_dot_dot(dent->d_name))
                         continue;
 
+                (*n_entries)++;
+
                 /* If statx() is supported, use it. It's preferable over fstatat() since it tells us
                  * explicitly where we are looking at a mount point, for free as side information. Determining
                  * the same information without statx() is hard, see the complexity of path_is_mount_point(),
@@ -629,7 +649,7 @@ static int dir_cleanup(
                 r = statx_fallback(
                                 dirfd(d), dent->d_name,
                                 AT_SYMLINK_NOFOLLOW|AT_NO_AUTOMOUNT,
-                                STATX_TYPE|STATX_MODE|STATX_UID|STATX_ATIME|STATX_MTIME|STATX_CTIME|STATX_BTIME,
+                                age_by_to_statx_mask(age_by_file, age_by_dir),
                                 &sx);
                 if (r == -ENOENT)
                         continue;
@@ -726,7 +746,7 @@ static int dir_cleanup(
                                                 atime_nsec, mtime_nsec, cutoff_nsec,
                                                 rootdev_major, rootdev_minor,
                                                 false, maxdepth-1, false,
-                                                age_by_file, age_by_dir);
+                                                age_by_file, age_by_dir, n_entries);
                                 if (q < 0)
                                         r = q;
                         }
@@ -962,7 +982,9 @@ static int fd_set_perms(Item *i, int fd, const char *path, const struct stat *st
         }
 
 shortcut:
-        return label_fix(path, 0);
+        /* We have the file pinned already, hence do not look it up by path again, which is noticeable when
+         * recursively fixing up large trees. */
+        return label_fix_fd(fd, path, 0);
 }
 
 static int path_open_parent_safe(const char *path) {
@@ -2500,8 +2522,9 @@ static char *age_by_to_string(AgeBy ab, bool is_dir) {
 static int clean_item_instance(Item *i, const char* instance) {
         _cleanup_closedir_ DIR *d = NULL;
         STRUCT_STATX_DEFINE(sx);
+        uint64_t n_entries = 0;
         int mountpoint, r;
-        usec_t cutoff, n;
+        usec_t cutoff, n, begin;
 
         assert(i);
 
@@ -2560,13 +2583,27 @@ static int clean_item_instance(Item *i, const char* instance) {
                           ab_f, ab_d);
         }
 
-        return dir_cleanup(i, instance, d,
-                           load_statx_timestamp_nsec(&sx.stx_atime),
-                           load_statx_timestamp_nsec(&sx.stx_mtime),
-                           cutoff * NSEC_PER_USEC,
-                           sx.stx_dev_major, sx.stx_dev_minor, mountpoint,
-                           MAX_DEPTH, i->keep_first_level,
-                           i->age_by_file, i->age_by_dir);
+        begin = now(CLOCK_MONOTONIC);
+
+        r = dir_cleanup(i, instance, d,
+                        load_statx_timestamp_nsec(&sx.stx_atime),
+                        load_statx_timestamp_nsec(&sx.stx_mtime),
+                        cutoff * NSEC_PER_USEC,
+                        sx.stx_dev_major, sx.stx_dev_minor, mountpoint,
+                        MAX_DEPTH, i->keep_first_level,
+                        i->age_by_file, i->age_by_dir,
+                        &n_entries);
+
+        if (DEBUG_LOGGING) {
+                usec_t elapsed = usec_sub_unsigned(now(CLOCK_MONOTONIC), begin);
+
+                log_debug("Examined %" PRIu64 " entries below \"%s\" in %s (%.0f entries/s).",
+                          n_entries, instance,
+                          FORMAT_TIMESPAN(elapsed, USEC_PER_MSEC),
+                          elapsed > 0 ? (double) n_entries * USEC_PER_SEC / elapsed : 0.0);
+        }
+
+        return r;
 }
 
 static int clean_item(Item *i) {
@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/* Measures how fast the udev rules are applied to events:
+ *
+ *     test-udev-rules-benchmark [EVENTS [ITERATIONS [RULES...]]]
+ *
+ * EVENTS is a file with recorded uevents, i.e. blocks of KEY=VALUE lines separated by empty lines, as
+ * printed by "udevadm monitor --kernel --property" or "udevadm info --export-db". Without it, a synthetic
+ * "add" event for the loopback network interface is used. The events are processed ITERATIONS times,
+ * with the specified rules files, or with the installed rules if none are specified.
+ *
+ * Note that the rules are really applied, i.e. programs and builtins are run, and attributes are
+ * written. Only the udev database and device nodes are not touched. */
+
+#include "device-private.h"
+#include "device-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "parse-util.h"
+#include "signal-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "udev-builtin.h"
+#include "udev-event.h"
+#include "udev-rules.h"
+
+static void event_complete(char ***properties, uint64_t seqnum) {
+        assert(properties);
+
+        /* device_new_from_strv() refuses events without those */
+        if (!strv_find_startswith(*properties, "ACTION="))
+                assert_se(strv_extend(properties, "ACTION=add") >= 0);
+
+        if (!strv_find_startswith(*properties, "SEQNUM="))
+                assert_se(strv_extendf(properties, "SEQNUM=%" PRIu64, seqnum) >= 0);
+}
+
+static size_t read_events(const char *path, char ****events) {
+        _cleanup_strv_free_ char **current = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t n = 0;
+        int r;
+
+        assert(path);
+        assert(events);
+
+        assert_se(f = fopen(path, "re"));
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+                const char *p;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                assert_se(r >= 0);
+
+                if (r == 0 || isempty(line)) {
+                        if (!strv_isempty(current)) {
+                                event_complete(&current, n + 1);
+
+                                assert_se(GREEDY_REALLOC(*events, n + 1));
+                                (*events)[n++] = TAKE_PTR(current);
+                        }
+
+                        if (r == 0)
+                                break;
+                        continue;
+                }
+
+                /* Skip everything but the properties, e.g. "P: …" lines or the headers of udevadm monitor */
+                p = startswith(line, "E: ") ?: line;
+                if (!strchr(p, '='))
+                        continue;
+
+                assert_se(strv_extend(&current, p) >= 0);
+        }
+
+        return n;
+}
+
+static size_t synthesize_events(char ****events) {
+        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+        _cleanup_strv_free_ char **properties = NULL;
+        const char *key, *value;
+
+        assert(events);
+
+        if (device_new_from_synthetic_event(&dev, "/sys/class/net/lo", "add") < 0)
+                return 0;
+
+        FOREACH_DEVICE_PROPERTY(dev, key, value)
+                assert_se(strv_extendf(&properties, "%s=%s", key, value) >= 0);
+
+        event_complete(&properties, 1);
+
+        assert_se(*events = new(char**, 1));
+        (*events)[0] = TAKE_PTR(properties);
+
+        return 1;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(udev_rules_freep) UdevRules *rules = NULL;
+        char ***events = NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        unsigned iterations = 100;
+        size_t n_events, n_processed = 0;
+        usec_t begin_usec, elapsed_usec;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                n_events = read_events(argv[1], &events);
+        else
+                n_events = synthesize_events(&events);
+        if (n_events == 0)
+                return log_tests_skipped("no events to process");
+
+        if (argc > 2)
+                assert_se(safe_atou(argv[2], &iterations) >= 0 && iterations > 0);
+
+        if (argc > 3) {
+                assert_se(rules = udev_rules_new(RESOLVE_NAME_EARLY));
+                for (int i = 3; i < argc; i++)
+                        assert_se(udev_rules_parse_file(rules, argv[i]) >= 0);
+        } else
+                assert_se(udev_rules_load(&rules, RESOLVE_NAME_EARLY) >= 0);
+
+        assert_se(sigprocmask_many(SIG_BLOCK, NULL, SIGCHLD, -1) >= 0);
+
+        udev_builtin_init();
+        udev_rules_set_profiling(rules, true);
+        udev_builtin_set_profiling(true);
+
+        begin_usec = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < iterations; i++)
+                for (size_t j = 0; j < n_events; j++) {
+                        _cleanup_(udev_event_freep) UdevEvent *event = NULL;
+                        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+
+                        if (device_new_from_strv(&dev, events[j]) < 0) {
+                                if (i == 0)
+                                        log_warning("Event %zu is incomplete, skipping.", j);
+                                continue;
+                        }
+
+                        assert_se(event = udev_event_new(dev, 0, NULL, log_get_max_level()));
+
+                        (void) udev_rules_apply_to_event(rules, event, 60 * USEC_PER_SEC, SIGKILL, NULL);
+                        n_processed++;
+                }
+
+        elapsed_usec = usec_sub_unsigned(now(CLOCK_MONOTONIC), begin_usec);
+
+        printf("\nProcessed %zu events in %s, %.1f events/s.\n\n",
+               n_processed,
+               format_timespan(buf, sizeof buf, elapsed_usec, USEC_PER_MSEC),
+               elapsed_usec > 0 ? (double) n_processed * USEC_PER_SEC / elapsed_usec : 0.0);
+
+        assert_se(udev_rules_dump_profile(rules, stdout, 25) >= 0);
+        printf("\n");
+        udev_builtin_dump_profile(stdout);
+
+        udev_builtin_exit();
+
+        for (size_t j = 0; j < n_events; j++)
+                strv_free(events[j]);
+        free(events);
+
+        return 0;
+}
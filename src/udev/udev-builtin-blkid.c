@@ -16,11 +16,13 @@
 
 #include "alloc-util.h"
 #include "blkid-util.h"
+#include "device-private.h"
 #include "device-util.h"
 #include "efi-loader.h"
 #include "errno-util.h"
 #include "fd-util.h"
 #include "gpt.h"
+#include "nulstr-util.h"
 #include "parse-util.h"
 #include "string-util.h"
 #include "strxcpyx.h"
@@ -233,10 +235,117 @@ static int probe_superblocks(blkid_probe pr) {
         return blkid_do_safeprobe(pr);
 }
 
+/* Properties derived from the probing results, see print_property() and find_gpt_root() */
+#define BLKID_PROPERTY_PREFIXES                 \
+        "ID_FS_\0"                              \
+        "ID_PART_TABLE_\0"                      \
+        "ID_PART_ENTRY_\0"                      \
+        "ID_PART_GPT_AUTO_ROOT\0"
+
+static int read_write_stats(sd_device *dev, uint64_t *ret_ios, uint64_t *ret_sectors) {
+        const char *stat;
+        int r;
+
+        assert(dev);
+        assert(ret_ios);
+        assert(ret_sectors);
+
+        r = sd_device_get_sysattr_value(dev, "stat", &stat);
+        if (r < 0)
+                return r;
+
+        /* The fifth and seventh fields are the number of write requests and of sectors written */
+        if (sscanf(stat, "%*u %*u %*u %*u %" SCNu64 " %*u %" SCNu64, ret_ios, ret_sectors) != 2)
+                return -EBADMSG;
+
+        return 0;
+}
+
+static int probe_stamp(sd_device *dev, char **ret) {
+        uint64_t ios, sectors, parent_ios = 0, parent_sectors = 0;
+        const char *diskseq = NULL, *size, *devtype;
+        sd_device *parent;
+        int r;
+
+        assert(dev);
+        assert(ret);
+
+        /* Builds a string that changes whenever the contents of the device may have changed through this
+         * host: on media change, resize, or whenever something was written to the device. For partitions,
+         * writes to the whole disk are taken into account as well. */
+
+        (void) sd_device_get_sysattr_value(dev, "diskseq", &diskseq);
+
+        r = sd_device_get_sysattr_value(dev, "size", &size);
+        if (r < 0)
+                return r;
+
+        r = read_write_stats(dev, &ios, &sectors);
+        if (r < 0)
+                return r;
+
+        if (sd_device_get_devtype(dev, &devtype) >= 0 && streq(devtype, "partition")) {
+                r = sd_device_get_parent(dev, &parent);
+                if (r < 0)
+                        return r;
+
+                r = read_write_stats(parent, &parent_ios, &parent_sectors);
+                if (r < 0)
+                        return r;
+        }
+
+        if (asprintf(ret, "%s:%s:%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%" PRIu64,
+                     strempty(diskseq), size, ios, sectors, parent_ios, parent_sectors) < 0)
+                return -ENOMEM;
+
+        return 0;
+}
+
+static int reuse_probe_results(sd_device *dev, const char *stamp, bool test) {
+        _cleanup_(sd_device_unrefp) sd_device *old = NULL;
+        const char *synth, *old_stamp, *key, *value;
+        sd_device_action_t action;
+        int r;
+
+        assert(dev);
+        assert(stamp);
+
+        /* Only kernel generated "change" events are considered, e.g. for path state changes of multipath
+         * devices or table reloads of device mapper devices. Events triggered from userspace, via
+         * "udevadm trigger" or by the inotify watch after the device was closed for writing, always result
+         * in the device being probed again, as it may have been modified elsewhere. */
+        if (sd_device_get_action(dev, &action) < 0 || action != SD_DEVICE_CHANGE)
+                return 0;
+
+        if (sd_device_get_property_value(dev, "SYNTH_UUID", &synth) >= 0)
+                return 0;
+
+        r = device_clone_with_db(dev, &old);
+        if (r < 0)
+                return r;
+
+        if (sd_device_get_property_value(old, "ID_BLKID_STAMP", &old_stamp) < 0 ||
+            !streq(old_stamp, stamp))
+                return 0;
+
+        FOREACH_DEVICE_PROPERTY(old, key, value) {
+                const char *prefix;
+
+                NULSTR_FOREACH(prefix, BLKID_PROPERTY_PREFIXES)
+                        if (startswith(key, prefix)) {
+                                udev_builtin_add_property(dev, test, key, value);
+                                break;
+                        }
+        }
+
+        return 1;
+}
+
 static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
         const char *devnode, *root_partition = NULL, *data, *name;
         _cleanup_(blkid_free_probep) blkid_probe pr = NULL;
-        bool noraid = false, is_gpt = false;
+        bool noraid = false, is_gpt = false, reuse = false;
+        _cleanup_free_ char *stamp = NULL;
         _cleanup_close_ int fd = -1;
         int64_t offset = 0;
         int r;
@@ -245,6 +354,7 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
                 { "offset", required_argument, NULL, 'o' },
                 { "hint",   required_argument, NULL, 'H' },
                 { "noraid", no_argument,       NULL, 'R' },
+                { "reuse",  no_argument,       NULL, 'r' },
                 {}
         };
 
@@ -256,7 +366,7 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
         for (;;) {
                 int option;
 
-                option = getopt_long(argc, argv, "o:H:R", options, NULL);
+                option = getopt_long(argc, argv, "o:H:Rr", options, NULL);
                 if (option == -1)
                         break;
 
@@ -287,6 +397,24 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
                 case 'R':
                         noraid = true;
                         break;
+                case 'r':
+                        reuse = true;
+                        break;
+                }
+        }
+
+        if (reuse) {
+                r = probe_stamp(dev, &stamp);
+                if (r < 0)
+                        log_device_debug_errno(dev, r, "Failed to determine whether the device changed, probing it: %m");
+                else {
+                        r = reuse_probe_results(dev, stamp, test);
+                        if (r < 0)
+                                log_device_debug_errno(dev, r, "Failed to read the results of the previous probe, probing again: %m");
+                        if (r > 0) {
+                                log_device_debug(dev, "Device did not change since it was probed last, reusing the results.");
+                                return udev_builtin_add_property(dev, test, "ID_BLKID_STAMP", stamp);
+                        }
                 }
         }
 
@@ -347,6 +475,9 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
         if (is_gpt)
                 find_gpt_root(dev, pr, test);
 
+        if (stamp)
+                udev_builtin_add_property(dev, test, "ID_BLKID_STAMP", stamp);
+
         return 0;
 }
 
@@ -10,6 +10,12 @@
 #include "udev-builtin.h"
 
 static bool initialized;
+static bool profiling;
+
+static struct {
+        usec_t usec;
+        unsigned count;
+} profile[_UDEV_BUILTIN_MAX];
 
 static const UdevBuiltin *const builtins[_UDEV_BUILTIN_MAX] = {
 #if HAVE_BLKID
@@ -124,7 +130,39 @@ int udev_builtin_run(sd_device *dev, UdevBuiltinCommand cmd, const char *command
 
         /* we need '0' here to reset the internal state */
         optind = 0;
-        return builtins[cmd]->cmd(dev, strv_length(argv), argv, test);
+
+        if (!profiling)
+                return builtins[cmd]->cmd(dev, strv_length(argv), argv, test);
+
+        usec_t begin_usec = now(CLOCK_MONOTONIC);
+        r = builtins[cmd]->cmd(dev, strv_length(argv), argv, test);
+        profile[cmd].usec += usec_sub_unsigned(now(CLOCK_MONOTONIC), begin_usec);
+        profile[cmd].count++;
+
+        return r;
+}
+
+void udev_builtin_set_profiling(bool b) {
+        profiling = b;
+}
+
+void udev_builtin_dump_profile(FILE *f) {
+        if (!f)
+                f = stdout;
+
+        fprintf(f, "%12s %10s %12s  %s\n", "TOTAL", "RUN", "AVERAGE", "BUILTIN");
+        for (UdevBuiltinCommand i = 0; i < _UDEV_BUILTIN_MAX; i++) {
+                char total[FORMAT_TIMESPAN_MAX], average[FORMAT_TIMESPAN_MAX];
+
+                if (!builtins[i] || profile[i].count == 0)
+                        continue;
+
+                fprintf(f, "%12s %10u %12s  %s\n",
+                        format_timespan(total, sizeof total, profile[i].usec, 1),
+                        profile[i].count,
+                        format_timespan(average, sizeof average, profile[i].usec / profile[i].count, 1),
+                        builtins[i]->name);
+        }
 }
 
 int udev_builtin_add_property(sd_device *dev, bool test, const char *key, const char *val) {
@@ -160,6 +160,25 @@ sd_event_source *udev_ctrl_get_event_source(struct udev_ctrl *uctrl) {
         return uctrl->event_source;
 }
 
+int udev_ctrl_take_connection(struct udev_ctrl *uctrl) {
+        int fd;
+
+        assert(uctrl);
+
+        /* Takes over the current connection from within the callback, e.g. to reply to the client later by
+         * closing it. No further messages are read from the connection, and new connections are accepted
+         * again. */
+
+        if (uctrl->sock_connect < 0)
+                return -ENOTCONN;
+
+        uctrl->event_source_connect = sd_event_source_unref(uctrl->event_source_connect);
+        fd = TAKE_FD(uctrl->sock_connect);
+
+        (void) sd_event_source_set_enabled(uctrl->event_source, SD_EVENT_ON);
+        return fd;
+}
+
 static void udev_ctrl_disconnect_and_listen_again(struct udev_ctrl *uctrl) {
         udev_ctrl_disconnect(uctrl);
         udev_ctrl_unref(uctrl);
@@ -18,6 +18,8 @@ enum udev_ctrl_msg_type {
         UDEV_CTRL_SET_CHILDREN_MAX,
         UDEV_CTRL_PING,
         UDEV_CTRL_EXIT,
+        UDEV_CTRL_WAIT_SUBSYSTEM,
+        UDEV_CTRL_WAIT_DEVICE,
 };
 
 union udev_ctrl_msg_value {
@@ -40,6 +42,7 @@ int udev_ctrl_cleanup(struct udev_ctrl *uctrl);
 int udev_ctrl_attach_event(struct udev_ctrl *uctrl, sd_event *event);
 int udev_ctrl_start(struct udev_ctrl *uctrl, udev_ctrl_handler_t callback, void *userdata);
 sd_event_source *udev_ctrl_get_event_source(struct udev_ctrl *uctrl);
+int udev_ctrl_take_connection(struct udev_ctrl *uctrl);
 
 int udev_ctrl_wait(struct udev_ctrl *uctrl, usec_t timeout);
 
@@ -76,4 +79,14 @@ static inline int udev_ctrl_send_exit(struct udev_ctrl *uctrl) {
         return udev_ctrl_send(uctrl, UDEV_CTRL_EXIT, 0, NULL);
 }
 
+/* The daemon closes the connection once no queued or running event matches the subsystem, or the devpath
+ * or any devpath below it, respectively. Use udev_ctrl_wait() to wait for that. */
+static inline int udev_ctrl_send_wait_subsystem(struct udev_ctrl *uctrl, const char *subsystem) {
+        return udev_ctrl_send(uctrl, UDEV_CTRL_WAIT_SUBSYSTEM, 0, subsystem);
+}
+
+static inline int udev_ctrl_send_wait_device(struct udev_ctrl *uctrl, const char *devpath) {
+        return udev_ctrl_send(uctrl, UDEV_CTRL_WAIT_DEVICE, 0, devpath);
+}
+
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct udev_ctrl*, udev_ctrl_unref);
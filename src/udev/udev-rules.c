@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: GPL-2.0-or-later */
 
 #include <ctype.h>
+#include <sys/mman.h>
 
 #include "alloc-util.h"
 #include "architecture.h"
@@ -22,16 +23,20 @@
 #include "parse-util.h"
 #include "path-util.h"
 #include "proc-cmdline.h"
+#include "siphash24.h"
+#include "sort-util.h"
 #include "stat-util.h"
 #include "strv.h"
 #include "strxcpyx.h"
 #include "sysctl-util.h"
 #include "syslog-util.h"
+#include "tmpfile-util.h"
 #include "udev-builtin.h"
 #include "udev-event.h"
 #include "udev-rules.h"
 #include "udev-util.h"
 #include "user-util.h"
+#include "version.h"
 #include "virt.h"
 
 #define RULES_DIRS (const char* const*) CONF_PATHS_STRV("udev/rules.d")
@@ -148,6 +153,7 @@ struct UdevRuleToken {
         UdevRuleMatchType match_type:8;
         UdevRuleSubstituteType attr_subst_type:7;
         bool attr_match_remove_trailing_whitespace:1;
+        bool value_has_alternatives:1;      /* value is a nulstr with more than one entry */
         const char *value;
         void *data;
         LIST_FIELDS(UdevRuleToken, tokens);
@@ -155,6 +161,7 @@ struct UdevRuleToken {
 
 struct UdevRuleLine {
         char *line;
+        size_t line_size;
         unsigned line_number;
         UdevRuleLineType type;
 
@@ -162,6 +169,17 @@ struct UdevRuleLine {
         const char *goto_label;
         UdevRuleLine *goto_line;
 
+        /* Conditions taken from the match tokens of the line that only depend on the event, so that lines
+         * can be skipped without evaluating any token, see rule_line_build_index(). */
+        const char *match_action;
+        const char *match_subsystem;
+        const char *match_kernel_prefix;
+        size_t match_kernel_prefix_len;
+
+        /* Only updated when profiling is enabled, see udev_rules_set_profiling() */
+        usec_t profile_usec;
+        unsigned profile_count;
+
         UdevRuleFile *rule_file;
         UdevRuleToken *current_token;
         LIST_HEAD(UdevRuleToken, tokens);
@@ -177,10 +195,17 @@ struct UdevRuleFile {
 
 struct UdevRules {
         usec_t dirs_ts_usec;
+        uint64_t cache_fingerprint;
         ResolveNameTiming resolve_name_timing;
         Hashmap *known_users;
         Hashmap *known_groups;
         UdevRuleFile *current_file;
+        /* The line and token being parsed or applied. These are kept here rather than in the file and line
+         * structures, so that applying the rules in a worker never writes to the rule structures, and the
+         * pages holding them stay shared with the main process after fork(). */
+        UdevRuleLine *current_line;
+        UdevRuleToken *current_token;
+        bool profiling;
         LIST_HEAD(UdevRuleFile, rule_files);
 };
 
@@ -190,7 +215,7 @@ struct UdevRules {
         ({                                                              \
                 UdevRules *_r = (rules);                                \
                 UdevRuleFile *_f = _r ? _r->current_file : NULL;        \
-                UdevRuleLine *_l = _f ? _f->current_line : NULL;        \
+                UdevRuleLine *_l = _r ? _r->current_line : NULL;        \
                 const char *_n = _f ? _f->filename : NULL;              \
                                                                         \
                 log_device_full_errno_zerook(                           \
@@ -275,6 +300,9 @@ static void udev_rule_line_clear_tokens(UdevRuleLine *rule_line) {
                 udev_rule_token_free(i);
 
         rule_line->tokens = NULL;
+
+        rule_line->match_action = rule_line->match_subsystem = rule_line->match_kernel_prefix = NULL;
+        rule_line->match_kernel_prefix_len = 0;
 }
 
 static UdevRuleLine* udev_rule_line_free(UdevRuleLine *rule_line) {
@@ -419,7 +447,7 @@ static int rule_line_add_token(UdevRuleLine *rule_line, UdevRuleTokenType type,
         UdevRuleToken *token;
         UdevRuleMatchType match_type = _MATCH_TYPE_INVALID;
         UdevRuleSubstituteType subst_type = _SUBST_TYPE_INVALID;
-        bool remove_trailing_whitespace = false;
+        bool remove_trailing_whitespace = false, alternatives = false;
         size_t len;
 
         assert(rule_line);
@@ -458,6 +486,7 @@ static int rule_line_add_token(UdevRuleLine *rule_line, UdevRuleTokenType type,
                                         else
                                                 *b++ = '\0';
                                         bar = true;
+                                        alternatives = true;
                                 }
                         }
                         *b = '\0';
@@ -501,6 +530,7 @@ static int rule_line_add_token(UdevRuleLine *rule_line, UdevRuleTokenType type,
                 .match_type = match_type,
                 .attr_subst_type = subst_type,
                 .attr_match_remove_trailing_whitespace = remove_trailing_whitespace,
+                .value_has_alternatives = alternatives,
         };
 
         rule_line_append_token(rule_line, token);
@@ -552,12 +582,11 @@ static int parse_token(UdevRules *rules, const char *key, char *attr, UdevRuleOp
         int r;
 
         assert(rules);
-        assert(rules->current_file);
-        assert(rules->current_file->current_line);
+        assert(rules->current_line);
         assert(key);
         assert(value);
 
-        rule_line = rules->current_file->current_line;
+        rule_line = rules->current_line;
 
         if (streq(key, "ACTION")) {
                 if (attr)
@@ -1060,6 +1089,51 @@ static int parse_line(char **line, char **ret_key, char **ret_attr, UdevRuleOper
         return 1;
 }
 
+static bool token_is_index_candidate(const UdevRuleToken *token) {
+        assert(token);
+
+        return token->op == OP_MATCH &&
+                IN_SET(token->match_type, MATCH_TYPE_PLAIN, MATCH_TYPE_GLOB) &&
+                !token->value_has_alternatives;
+}
+
+static void rule_line_build_index(UdevRuleLine *rule_line) {
+        UdevRuleToken *token;
+
+        assert(rule_line);
+
+        /* ACTION==, SUBSYSTEM== and KERNEL== compare properties of the event that never change while the
+         * rules are applied, and are cheap to compare. If such a match with a single value can't be
+         * satisfied by an event, the line would be skipped when its tokens are evaluated anyway. Hence,
+         * remember them here, so that we can skip the line right away. For globs, only the part before the
+         * first special character is taken into account. */
+
+        LIST_FOREACH(tokens, token, rule_line->tokens) {
+                if (!token_is_index_candidate(token))
+                        continue;
+
+                switch (token->type) {
+                case TK_M_ACTION:
+                        if (token->match_type == MATCH_TYPE_PLAIN && !rule_line->match_action)
+                                rule_line->match_action = token->value;
+                        break;
+                case TK_M_SUBSYSTEM:
+                        if (token->match_type == MATCH_TYPE_PLAIN && !rule_line->match_subsystem)
+                                rule_line->match_subsystem = token->value;
+                        break;
+                case TK_M_KERNEL:
+                        if (!rule_line->match_kernel_prefix) {
+                                rule_line->match_kernel_prefix = token->value;
+                                rule_line->match_kernel_prefix_len = token->match_type == MATCH_TYPE_GLOB ?
+                                        strcspn(token->value, "*?[\\") : strlen(token->value);
+                        }
+                        break;
+                default:
+                        break;
+                }
+        }
+}
+
 static void sort_tokens(UdevRuleLine *rule_line) {
         UdevRuleToken *head_old;
 
@@ -1108,6 +1182,7 @@ static int rule_add_line(UdevRules *rules, const char *line_str, unsigned line_n
 
         *rule_line = (UdevRuleLine) {
                 .line = TAKE_PTR(line),
+                .line_size = strlen(line_str) + 2,
                 .line_number = line_nr,
                 .rule_file = rule_file,
         };
@@ -1118,6 +1193,7 @@ static int rule_add_line(UdevRules *rules, const char *line_str, unsigned line_n
                 LIST_APPEND(rule_lines, rule_file->rule_lines, rule_line);
 
         rule_file->current_line = rule_line;
+        rules->current_line = rule_line;
 
         for (p = rule_line->line; !isempty(p); ) {
                 char *key, *attr, *value;
@@ -1140,6 +1216,7 @@ static int rule_add_line(UdevRules *rules, const char *line_str, unsigned line_n
         }
 
         sort_tokens(rule_line);
+        rule_line_build_index(rule_line);
         TAKE_PTR(rule_line);
         return 0;
 }
@@ -1271,8 +1348,11 @@ int udev_rules_parse_file(UdevRules *rules, const char *filename) {
 
                 if (ignore_line)
                         log_error("%s:%u: Line is too long, ignored", filename, line_nr);
-                else if (len > 0)
+                else if (len > 0) {
                         (void) rule_add_line(rules, line, line_nr);
+                        /* The line might have been dropped on failure */
+                        rules->current_line = NULL;
+                }
 
                 continuation = mfree(continuation);
                 ignore_line = false;
@@ -1296,9 +1376,479 @@ UdevRules* udev_rules_new(ResolveNameTiming resolve_name_timing) {
         return rules;
 }
 
-int udev_rules_load(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing) {
+/*** Compiled rules cache ***/
+
+/* The parsed rules may be written to a binary file, which is loaded instead of parsing the rules files again
+ * as long as none of the rules files changed. All strings referenced by the tokens of a line point into the
+ * (modified) line buffer, hence the cache stores the line buffers verbatim, and offsets into them. */
+
+#define RULES_CACHE_SIGNATURE { 'U', 'D', 'E', 'V', 'R', 'U', 'L', 'E' }
+
+typedef struct _packed_ RulesCacheHeader {
+        uint8_t signature[8];
+        uint32_t header_size;
+        uint32_t resolve_name_timing;
+        uint64_t fingerprint;
+        uint64_t n_files;
+} RulesCacheHeader;
+
+/* Followed by the NUL terminated file name */
+typedef struct _packed_ RulesCacheFile {
+        uint32_t filename_size;
+        uint32_t n_lines;
+} RulesCacheFile;
+
+/* Followed by the line buffer, then by n_tokens RulesCacheToken */
+typedef struct _packed_ RulesCacheLine {
+        uint32_t line_number;
+        uint32_t type;
+        uint32_t line_size;
+        uint32_t label;         /* offset into the line + 1, 0 if unset */
+        uint32_t goto_label;    /* ditto */
+        uint32_t goto_line;     /* number of lines to skip to reach the line to jump to, 0 if unset */
+        uint32_t n_tokens;
+} RulesCacheLine;
+
+typedef struct _packed_ RulesCacheToken {
+        int8_t type;
+        int8_t op;
+        int8_t match_type;
+        int8_t attr_subst_type;
+        uint8_t attr_match_remove_trailing_whitespace;
+        uint8_t value_has_alternatives;
+        uint32_t value;         /* offset into the line + 1, 0 if unset */
+        uint64_t data;          /* ditto for tokens whose data is a string, the plain value otherwise */
+} RulesCacheToken;
+
+static bool token_data_is_string(UdevRuleTokenType type) {
+        return IN_SET(type,
+                      TK_M_ENV, TK_M_CONST, TK_M_ATTR, TK_M_SYSCTL, TK_M_PARENTS_ATTR,
+                      TK_A_SECLABEL, TK_A_ENV, TK_A_ATTR, TK_A_SYSCTL);
+}
+
+static bool token_data_is_builtin(UdevRuleTokenType type) {
+        return IN_SET(type, TK_M_IMPORT_BUILTIN, TK_A_RUN_BUILTIN);
+}
+
+static void rules_cache_hash_file(const char *path, struct siphash *state) {
+        struct stat st;
+
+        assert(path);
+        assert(state);
+
+        siphash24_compress_string(path, state);
+
+        if (stat(path, &st) < 0) {
+                int error = errno;
+
+                siphash24_compress(&error, sizeof(error), state);
+                return;
+        }
+
+        siphash24_compress(&st.st_dev, sizeof(st.st_dev), state);
+        siphash24_compress(&st.st_ino, sizeof(st.st_ino), state);
+        siphash24_compress(&st.st_size, sizeof(st.st_size), state);
+        siphash24_compress(&st.st_mtim, sizeof(st.st_mtim), state);
+}
+
+static uint64_t rules_cache_fingerprint(char * const *files, ResolveNameTiming resolve_name_timing) {
+        /* The fingerprint is only ever compared with the one of the same rules, hence a fixed key is fine */
+        static const sd_id128_t key = SD_ID128_MAKE(8e,21,d4,5a,0b,6f,4c,37,92,e8,15,c3,7d,a0,64,f9);
+        struct siphash state;
+        char * const *f;
+
+        siphash24_init(&state, key.bytes);
+
+        /* The token types are stored as numbers, hence never reuse a cache written by another version */
+        siphash24_compress_string(GIT_VERSION, &state);
+        siphash24_compress(&(const int) { _TK_TYPE_MAX }, sizeof(int), &state);
+
+        STRV_FOREACH(f, files)
+                rules_cache_hash_file(*f, &state);
+
+        /* With early name resolution, user and group IDs are resolved while parsing */
+        if (resolve_name_timing == RESOLVE_NAME_EARLY) {
+                rules_cache_hash_file("/etc/passwd", &state);
+                rules_cache_hash_file("/etc/group", &state);
+        }
+
+        return siphash24_finalize(&state);
+}
+
+static uint32_t rules_cache_offset(const UdevRuleLine *line, const void *p) {
+        assert(line);
+
+        if (!p)
+                return 0;
+
+        assert((const char*) p >= line->line);
+        assert((size_t) ((const char*) p - line->line) < line->line_size);
+
+        return (uint32_t) ((const char*) p - line->line) + 1;
+}
+
+static void rules_cache_write_line(FILE *f, const UdevRuleLine *line) {
+        const UdevRuleToken *token;
+        RulesCacheLine l;
+        uint32_t n_tokens = 0, goto_line = 0;
+
+        assert(f);
+        assert(line);
+
+        LIST_FOREACH(tokens, token, line->tokens)
+                n_tokens++;
+
+        if (line->goto_line)
+                for (const UdevRuleLine *i = line; i != line->goto_line; i = i->rule_lines_next)
+                        goto_line++;
+
+        l = (RulesCacheLine) {
+                .line_number = line->line_number,
+                .type = line->type,
+                .line_size = line->line_size,
+                .label = rules_cache_offset(line, line->label),
+                .goto_label = rules_cache_offset(line, line->goto_label),
+                .goto_line = goto_line,
+                .n_tokens = n_tokens,
+        };
+
+        fwrite(&l, sizeof(l), 1, f);
+        fwrite(line->line, line->line_size, 1, f);
+
+        LIST_FOREACH(tokens, token, line->tokens) {
+                RulesCacheToken t = {
+                        .type = token->type,
+                        .op = token->op,
+                        .match_type = token->match_type,
+                        .attr_subst_type = token->attr_subst_type,
+                        .attr_match_remove_trailing_whitespace = token->attr_match_remove_trailing_whitespace,
+                        .value_has_alternatives = token->value_has_alternatives,
+                        .value = rules_cache_offset(line, token->value),
+                };
+
+                if (token_data_is_string(token->type))
+                        t.data = rules_cache_offset(line, token->data);
+                else if (!token_data_is_builtin(token->type)) /* Looked up again when loading */
+                        t.data = (uintptr_t) token->data;
+
+                fwrite(&t, sizeof(t), 1, f);
+        }
+}
+
+int udev_rules_write_cache(UdevRules *rules, const char *path) {
+        _cleanup_(unlink_and_freep) char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        const UdevRuleFile *file;
+        RulesCacheHeader h = {
+                .signature = RULES_CACHE_SIGNATURE,
+                .header_size = sizeof(RulesCacheHeader),
+        };
+        int r;
+
+        assert(rules);
+        assert(path);
+
+        if (rules->cache_fingerprint == 0)
+                return log_debug_errno(SYNTHETIC_ERRNO(ESTALE), "Rules were not loaded from rules files, refusing to write cache.");
+
+        h.resolve_name_timing = rules->resolve_name_timing;
+        h.fingerprint = rules->cache_fingerprint;
+        LIST_FOREACH(rule_files, file, rules->rule_files)
+                h.n_files++;
+
+        (void) mkdir_parents(path, 0755);
+
+        r = fopen_temporary(path, &f, &temp_path);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create temporary file for %s: %m", path);
+
+        fwrite(&h, sizeof(h), 1, f);
+
+        LIST_FOREACH(rule_files, file, rules->rule_files) {
+                const UdevRuleLine *line;
+                RulesCacheFile rf = {
+                        .filename_size = strlen(file->filename) + 1,
+                };
+
+                LIST_FOREACH(rule_lines, line, file->rule_lines)
+                        rf.n_lines++;
+
+                fwrite(&rf, sizeof(rf), 1, f);
+                fwrite(file->filename, rf.filename_size, 1, f);
+
+                LIST_FOREACH(rule_lines, line, file->rule_lines)
+                        rules_cache_write_line(f, line);
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to write %s: %m", temp_path);
+
+        if (fchmod(fileno(f), 0444) < 0)
+                return log_error_errno(errno, "Failed to set permissions of %s: %m", temp_path);
+
+        if (rename(temp_path, path) < 0)
+                return log_error_errno(errno, "Failed to rename %s to %s: %m", temp_path, path);
+
+        temp_path = mfree(temp_path);
+        return 0;
+}
+
+static int rules_cache_read(const uint8_t **p, const uint8_t *end, void *ret, size_t size) {
+        assert(p);
+        assert(*p <= end);
+
+        if ((size_t) (end - *p) < size)
+                return -EBADMSG;
+
+        memcpy(ret, *p, size);
+        *p += size;
+        return 0;
+}
+
+static void* rules_cache_pointer(UdevRuleLine *line, uint64_t offset) {
+        assert(line);
+
+        /* Offsets were validated against the line size already */
+        return offset > 0 ? line->line + offset - 1 : NULL;
+}
+
+static int rules_cache_load_line(const uint8_t **p, const uint8_t *end, UdevRuleLine **ret, uint32_t *ret_goto_line) {
+        _cleanup_(udev_rule_line_freep) UdevRuleLine *rule_line = NULL;
+        RulesCacheLine l;
+        int r;
+
+        assert(p);
+        assert(ret);
+        assert(ret_goto_line);
+
+        r = rules_cache_read(p, end, &l, sizeof(l));
+        if (r < 0)
+                return r;
+
+        if (l.line_size < 2 || l.label > l.line_size || l.goto_label > l.line_size)
+                return -EBADMSG;
+
+        rule_line = new(UdevRuleLine, 1);
+        if (!rule_line)
+                return -ENOMEM;
+
+        *rule_line = (UdevRuleLine) {
+                .line = new(char, l.line_size),
+                .line_size = l.line_size,
+                .line_number = l.line_number,
+                .type = l.type,
+        };
+        if (!rule_line->line)
+                return -ENOMEM;
+
+        r = rules_cache_read(p, end, rule_line->line, l.line_size);
+        if (r < 0)
+                return r;
+
+        /* Strings may end at the end of the line buffer, make sure they are terminated */
+        if (rule_line->line[l.line_size - 1] != '\0' || rule_line->line[l.line_size - 2] != '\0')
+                return -EBADMSG;
+
+        rule_line->label = rules_cache_pointer(rule_line, l.label);
+        rule_line->goto_label = rules_cache_pointer(rule_line, l.goto_label);
+
+        for (uint32_t i = 0; i < l.n_tokens; i++) {
+                UdevRuleToken *token;
+                RulesCacheToken t;
+                void *data = NULL;
+
+                r = rules_cache_read(p, end, &t, sizeof(t));
+                if (r < 0)
+                        return r;
+
+                if (t.type < 0 || t.type >= _TK_TYPE_MAX ||
+                    t.op < 0 || t.op >= _OP_TYPE_MAX ||
+                    t.match_type >= _MATCH_TYPE_MAX ||
+                    t.attr_subst_type >= _SUBST_TYPE_MAX ||
+                    t.value > l.line_size)
+                        return -EBADMSG;
+
+                if (token_data_is_string(t.type)) {
+                        if (t.data > l.line_size)
+                                return -EBADMSG;
+
+                        data = rules_cache_pointer(rule_line, t.data);
+                } else if (token_data_is_builtin(t.type)) {
+                        UdevBuiltinCommand cmd;
+
+                        if (t.value == 0)
+                                return -EBADMSG;
+
+                        /* The set of built-in commands depends on the build configuration */
+                        cmd = udev_builtin_lookup(rules_cache_pointer(rule_line, t.value));
+                        if (cmd < 0)
+                                return -EBADMSG;
+
+                        data = UDEV_BUILTIN_CMD_TO_PTR(cmd);
+                } else
+                        data = (void*) (uintptr_t) t.data;
+
+                token = new(UdevRuleToken, 1);
+                if (!token)
+                        return -ENOMEM;
+
+                *token = (UdevRuleToken) {
+                        .type = t.type,
+                        .op = t.op,
+                        .match_type = t.match_type,
+                        .attr_subst_type = t.attr_subst_type,
+                        .attr_match_remove_trailing_whitespace = t.attr_match_remove_trailing_whitespace,
+                        .value_has_alternatives = t.value_has_alternatives,
+                        .value = rules_cache_pointer(rule_line, t.value),
+                        .data = data,
+                };
+
+                rule_line_append_token(rule_line, token);
+        }
+
+        rule_line_build_index(rule_line);
+
+        *ret_goto_line = l.goto_line;
+        *ret = TAKE_PTR(rule_line);
+        return 0;
+}
+
+static int rules_cache_load_file(UdevRules *rules, const uint8_t **p, const uint8_t *end) {
+        _cleanup_free_ UdevRuleLine **lines = NULL;
+        _cleanup_free_ uint32_t *gotos = NULL;
+        UdevRuleFile *rule_file;
+        RulesCacheFile rf;
+        int r;
+
+        assert(rules);
+        assert(p);
+
+        r = rules_cache_read(p, end, &rf, sizeof(rf));
+        if (r < 0)
+                return r;
+
+        if (rf.filename_size == 0 || (size_t) (end - *p) < rf.filename_size || (*p)[rf.filename_size - 1] != '\0')
+                return -EBADMSG;
+
+        rule_file = new(UdevRuleFile, 1);
+        if (!rule_file)
+                return -ENOMEM;
+
+        *rule_file = (UdevRuleFile) {
+                .filename = strdup((const char*) *p),
+        };
+
+        /* Add the file right away, so that it is freed along with the rules on failure */
+        LIST_APPEND(rule_files, rules->rule_files, rule_file);
+
+        if (!rule_file->filename)
+                return -ENOMEM;
+
+        *p += rf.filename_size;
+
+        if (rf.n_lines == 0)
+                return 0;
+        if (rf.n_lines > (size_t) (end - *p) / sizeof(RulesCacheLine))
+                return -EBADMSG;
+
+        lines = new(UdevRuleLine*, rf.n_lines);
+        gotos = new(uint32_t, rf.n_lines);
+        if (!lines || !gotos)
+                return -ENOMEM;
+
+        for (uint32_t i = 0; i < rf.n_lines; i++) {
+                r = rules_cache_load_line(p, end, lines + i, gotos + i);
+                if (r < 0)
+                        return r;
+
+                lines[i]->rule_file = rule_file;
+                if (rule_file->current_line)
+                        LIST_APPEND(rule_lines, rule_file->current_line, lines[i]);
+                else
+                        LIST_APPEND(rule_lines, rule_file->rule_lines, lines[i]);
+
+                rule_file->current_line = lines[i];
+        }
+
+        for (uint32_t i = 0; i < rf.n_lines; i++) {
+                if (gotos[i] == 0)
+                        continue;
+
+                if (gotos[i] >= rf.n_lines - i)
+                        return -EBADMSG;
+
+                lines[i]->goto_line = lines[i + gotos[i]];
+        }
+
+        rule_file->current_line = NULL;
+        return 0;
+}
+
+static int rules_cache_load(UdevRules *rules, const char *path, uint64_t fingerprint) {
+        _cleanup_close_ int fd = -1;
+        const uint8_t *p, *end;
+        RulesCacheHeader h;
+        struct stat st;
+        void *map;
+        int r;
+
+        assert(rules);
+        assert(path);
+
+        fd = open(path, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        r = stat_verify_regular(&st);
+        if (r < 0)
+                return r;
+
+        if ((size_t) st.st_size < sizeof(RulesCacheHeader))
+                return -EBADMSG;
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+                return -errno;
+
+        p = map;
+        end = p + st.st_size;
+
+        r = rules_cache_read(&p, end, &h, sizeof(h));
+        if (r < 0)
+                goto finish;
+
+        if (memcmp(h.signature, (const uint8_t[]) RULES_CACHE_SIGNATURE, sizeof(h.signature)) != 0 ||
+            h.header_size != sizeof(RulesCacheHeader)) {
+                r = -EBADMSG;
+                goto finish;
+        }
+
+        if (h.fingerprint != fingerprint || h.resolve_name_timing != (uint32_t) rules->resolve_name_timing) {
+                r = -ESTALE;
+                goto finish;
+        }
+
+        for (uint64_t i = 0; i < h.n_files; i++) {
+                r = rules_cache_load_file(rules, &p, end);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = p == end ? 0 : -EBADMSG;
+
+finish:
+        assert_se(munmap(map, st.st_size) >= 0);
+        return r;
+}
+
+static int udev_rules_load_full(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing, bool use_cache) {
         _cleanup_(udev_rules_freep) UdevRules *rules = NULL;
         _cleanup_strv_free_ char **files = NULL;
+        uint64_t fingerprint;
         char **f;
         int r;
 
@@ -1312,16 +1862,58 @@ int udev_rules_load(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing
         if (r < 0)
                 return log_debug_errno(r, "Failed to enumerate rules files: %m");
 
+        fingerprint = rules_cache_fingerprint(files, resolve_name_timing);
+
+        if (use_cache) {
+                r = rules_cache_load(rules, UDEV_RULES_CACHE_PATH, fingerprint);
+                if (r >= 0) {
+                        log_debug("Loaded compiled rules from %s.", UDEV_RULES_CACHE_PATH);
+                        rules->cache_fingerprint = fingerprint;
+                        *ret_rules = TAKE_PTR(rules);
+                        return 0;
+                }
+                if (r != -ENOENT)
+                        log_debug_errno(r, "Failed to load compiled rules from %s, parsing rules files: %m",
+                                        UDEV_RULES_CACHE_PATH);
+
+                /* Start over, we might have loaded some of the rules already */
+                udev_rules_free(rules);
+                rules = udev_rules_new(resolve_name_timing);
+                if (!rules)
+                        return -ENOMEM;
+
+                (void) udev_rules_check_timestamp(rules);
+        }
+
         STRV_FOREACH(f, files) {
                 r = udev_rules_parse_file(rules, *f);
                 if (r < 0)
                         log_debug_errno(r, "Failed to read rules file %s, ignoring: %m", *f);
         }
 
+        rules->cache_fingerprint = fingerprint;
         *ret_rules = TAKE_PTR(rules);
         return 0;
 }
 
+int udev_rules_load(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing) {
+        return udev_rules_load_full(ret_rules, resolve_name_timing, true);
+}
+
+int udev_rules_update_cache(ResolveNameTiming resolve_name_timing, const char *path) {
+        _cleanup_(udev_rules_freep) UdevRules *rules = NULL;
+        int r;
+
+        assert(path);
+
+        /* Always parse the rules files here, so that any problems with them are logged */
+        r = udev_rules_load_full(&rules, resolve_name_timing, false);
+        if (r < 0)
+                return r;
+
+        return udev_rules_write_cache(rules, path);
+}
+
 bool udev_rules_check_timestamp(UdevRules *rules) {
         if (!rules)
                 return false;
@@ -1550,7 +2142,7 @@ static int udev_rule_apply_token_to_event(
          * 1 on the current token matches the event, and
          * negative errno on some critical errors. */
 
-        token = rules->current_file->current_line->current_token;
+        token = rules->current_token;
 
         switch (token->type) {
         case TK_M_ACTION: {
@@ -2252,12 +2844,12 @@ static int udev_rule_apply_parent_token_to_event(
         UdevRuleToken *head;
         int r;
 
-        line = rules->current_file->current_line;
-        head = rules->current_file->current_line->current_token;
+        line = rules->current_line;
+        head = rules->current_token;
         event->dev_parent = event->dev;
         for (;;) {
-                LIST_FOREACH(tokens, line->current_token, head) {
-                        if (!token_is_for_parents(line->current_token))
+                LIST_FOREACH(tokens, rules->current_token, head) {
+                        if (!token_is_for_parents(rules->current_token))
                                 return true; /* All parent tokens match. */
                         r = udev_rule_apply_token_to_event(rules, event->dev_parent, event, 0, timeout_signal, NULL);
                         if (r < 0)
@@ -2265,7 +2857,7 @@ static int udev_rule_apply_parent_token_to_event(
                         if (r == 0)
                                 break;
                 }
-                if (!line->current_token)
+                if (!rules->current_token)
                         /* All parent tokens match. But no assign tokens in the line. Hmm... */
                         return true;
 
@@ -2276,34 +2868,83 @@ static int udev_rule_apply_parent_token_to_event(
         }
 }
 
+typedef struct UdevRuleEventKeys {
+        UdevRuleLineType mask;
+        const char *action;
+        const char *subsystem;
+        const char *sysname;
+} UdevRuleEventKeys;
+
+static int udev_rule_event_keys_get(sd_device *dev, UdevRuleEventKeys *ret) {
+        UdevRuleEventKeys keys = {
+                .mask = LINE_HAS_GOTO | LINE_UPDATE_SOMETHING,
+        };
+        sd_device_action_t action;
+        int r;
+
+        assert(dev);
+        assert(ret);
+
+        r = sd_device_get_action(dev, &action);
+        if (r < 0)
+                return r;
+
+        if (action != SD_DEVICE_REMOVE) {
+                if (sd_device_get_devnum(dev, NULL) >= 0)
+                        keys.mask |= LINE_HAS_DEVLINK;
+
+                if (sd_device_get_ifindex(dev, NULL) >= 0)
+                        keys.mask |= LINE_HAS_NAME;
+        }
+
+        keys.action = device_action_to_string(action);
+
+        r = sd_device_get_subsystem(dev, &keys.subsystem);
+        if (r < 0 && r != -ENOENT)
+                return r;
+
+        /* If there is no sysname, let KERNEL== report the failure when it is evaluated */
+        (void) sd_device_get_sysname(dev, &keys.sysname);
+
+        *ret = keys;
+        return 0;
+}
+
+static bool udev_rule_line_may_match(const UdevRuleLine *line, const UdevRuleEventKeys *keys) {
+        assert(line);
+        assert(keys);
+
+        if ((line->type & keys->mask) == 0)
+                return false;
+
+        if (line->match_action && !streq(line->match_action, keys->action))
+                return false;
+
+        if (line->match_subsystem && !streq_ptr(line->match_subsystem, keys->subsystem))
+                return false;
+
+        if (line->match_kernel_prefix && keys->sysname &&
+            strncmp(line->match_kernel_prefix, keys->sysname, line->match_kernel_prefix_len) != 0)
+                return false;
+
+        return true;
+}
+
 static int udev_rule_apply_line_to_event(
                 UdevRules *rules,
                 UdevEvent *event,
+                const UdevRuleEventKeys *keys,
                 usec_t timeout_usec,
                 int timeout_signal,
                 Hashmap *properties_list,
                 UdevRuleLine **next_line) {
 
-        UdevRuleLine *line = rules->current_file->current_line;
-        UdevRuleLineType mask = LINE_HAS_GOTO | LINE_UPDATE_SOMETHING;
+        UdevRuleLine *line = rules->current_line;
         UdevRuleToken *token, *next_token;
         bool parents_done = false;
-        sd_device_action_t action;
         int r;
 
-        r = sd_device_get_action(event->dev, &action);
-        if (r < 0)
-                return r;
-
-        if (action != SD_DEVICE_REMOVE) {
-                if (sd_device_get_devnum(event->dev, NULL) >= 0)
-                        mask |= LINE_HAS_DEVLINK;
-
-                if (sd_device_get_ifindex(event->dev, NULL) >= 0)
-                        mask |= LINE_HAS_NAME;
-        }
-
-        if ((line->type & mask) == 0)
+        if (!udev_rule_line_may_match(line, keys))
                 return 0;
 
         event->esc = ESCAPE_UNSET;
@@ -2311,7 +2952,7 @@ static int udev_rule_apply_line_to_event(
         DEVICE_TRACE_POINT(rules_apply_line, event->dev, line->rule_file->filename, line->line_number);
 
         LIST_FOREACH_SAFE(tokens, token, next_token, line->tokens) {
-                line->current_token = token;
+                rules->current_token = token;
 
                 if (token_is_for_parents(token)) {
                         if (parents_done)
@@ -2343,6 +2984,7 @@ int udev_rules_apply_to_event(
                 int timeout_signal,
                 Hashmap *properties_list) {
 
+        UdevRuleEventKeys keys;
         UdevRuleFile *file;
         UdevRuleLine *next_line;
         int r;
@@ -2350,10 +2992,27 @@ int udev_rules_apply_to_event(
         assert(rules);
         assert(event);
 
+        /* These don't change while applying the rules, hence look them up only once */
+        r = udev_rule_event_keys_get(event->dev, &keys);
+        if (r < 0)
+                return r;
+
         LIST_FOREACH(rule_files, file, rules->rule_files) {
                 rules->current_file = file;
-                LIST_FOREACH_SAFE(rule_lines, file->current_line, next_line, file->rule_lines) {
-                        r = udev_rule_apply_line_to_event(rules, event, timeout_usec, timeout_signal, properties_list, &next_line);
+                LIST_FOREACH_SAFE(rule_lines, rules->current_line, next_line, file->rule_lines) {
+                        UdevRuleLine *line = rules->current_line;
+                        usec_t begin_usec = 0;
+
+                        if (rules->profiling)
+                                begin_usec = now(CLOCK_MONOTONIC);
+
+                        r = udev_rule_apply_line_to_event(rules, event, &keys, timeout_usec, timeout_signal, properties_list, &next_line);
+
+                        if (rules->profiling) {
+                                line->profile_usec += usec_sub_unsigned(now(CLOCK_MONOTONIC), begin_usec);
+                                line->profile_count++;
+                        }
+
                         if (r < 0)
                                 return r;
                 }
@@ -2362,6 +3021,55 @@ int udev_rules_apply_to_event(
         return 0;
 }
 
+void udev_rules_set_profiling(UdevRules *rules, bool b) {
+        assert(rules);
+
+        rules->profiling = b;
+}
+
+static int rule_line_profile_compare(UdevRuleLine * const *a, UdevRuleLine * const *b) {
+        return CMP((*b)->profile_usec, (*a)->profile_usec);
+}
+
+int udev_rules_dump_profile(UdevRules *rules, FILE *f, size_t n_max) {
+        _cleanup_free_ UdevRuleLine **lines = NULL;
+        UdevRuleFile *file;
+        UdevRuleLine *line;
+        size_t n = 0;
+
+        assert(rules);
+
+        if (!f)
+                f = stdout;
+
+        LIST_FOREACH(rule_files, file, rules->rule_files)
+                LIST_FOREACH(rule_lines, line, file->rule_lines) {
+                        if (line->profile_count == 0)
+                                continue;
+
+                        if (!GREEDY_REALLOC(lines, n + 1))
+                                return -ENOMEM;
+
+                        lines[n++] = line;
+                }
+
+        typesafe_qsort(lines, n, rule_line_profile_compare);
+
+        fprintf(f, "%12s %10s %12s  %s\n", "TOTAL", "APPLIED", "AVERAGE", "LINE");
+        for (size_t i = 0; i < MIN(n, n_max); i++) {
+                char total[FORMAT_TIMESPAN_MAX], average[FORMAT_TIMESPAN_MAX];
+
+                line = lines[i];
+                fprintf(f, "%12s %10u %12s  %s:%u\n",
+                        format_timespan(total, sizeof total, line->profile_usec, 1),
+                        line->profile_count,
+                        format_timespan(average, sizeof average, line->profile_usec / line->profile_count, 1),
+                        line->rule_file->filename, line->line_number);
+        }
+
+        return 0;
+}
+
 static int apply_static_dev_perms(const char *devnode, uid_t uid, gid_t gid, mode_t mode, char **tags) {
         char device_node[UDEV_PATH_SIZE], tags_dir[UDEV_PATH_SIZE], tag_symlink[UDEV_PATH_SIZE];
         _cleanup_free_ char *unescaped_filename = NULL;
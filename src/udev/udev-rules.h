@@ -1,6 +1,8 @@
 /* SPDX-License-Identifier: GPL-2.0-or-later */
 #pragma once
 
+#include <stdio.h>
+
 #include "hashmap.h"
 #include "time-util.h"
 #include "udev-util.h"
@@ -16,15 +18,25 @@ typedef enum {
         _ESCAPE_TYPE_INVALID = -EINVAL,
 } UdevRuleEscapeType;
 
+#define UDEV_RULES_CACHE_PATH "/etc/udev/rules.bin"
+
 int udev_rules_parse_file(UdevRules *rules, const char *filename);
 UdevRules* udev_rules_new(ResolveNameTiming resolve_name_timing);
 int udev_rules_load(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing);
 UdevRules *udev_rules_free(UdevRules *rules);
 DEFINE_TRIVIAL_CLEANUP_FUNC(UdevRules*, udev_rules_free);
 
+int udev_rules_write_cache(UdevRules *rules, const char *path);
+int udev_rules_update_cache(ResolveNameTiming resolve_name_timing, const char *path);
+
 bool udev_rules_check_timestamp(UdevRules *rules);
 int udev_rules_apply_to_event(UdevRules *rules, UdevEvent *event,
                               usec_t timeout_usec,
                               int timeout_signal,
                               Hashmap *properties_list);
 int udev_rules_apply_static_dev_perms(UdevRules *rules);
+
+/* When enabled, the time spent on each rule line is accounted, and can be shown with
+ * udev_rules_dump_profile(), which lists the n_max most expensive lines. */
+void udev_rules_set_profiling(UdevRules *rules, bool b);
+int udev_rules_dump_profile(UdevRules *rules, FILE *f, size_t n_max);
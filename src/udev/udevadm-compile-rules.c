@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "udev-rules.h"
+#include "udevadm.h"
+
+static ResolveNameTiming arg_resolve_name_timing = RESOLVE_NAME_EARLY;
+static bool arg_remove = false;
+
+static int help(void) {
+        printf("%s compile-rules [OPTIONS]\n\n"
+               "Compile the rules files into " UDEV_RULES_CACHE_PATH ".\n\n"
+               "  -h --help                            Show this help\n"
+               "  -V --version                         Show package version\n"
+               "  -N --resolve-names=early|late|never  When to resolve names\n"
+               "     --remove                          Remove the compiled rules\n",
+               program_invocation_short_name);
+
+        return 0;
+}
+
+static int parse_argv(int argc, char *argv[]) {
+        enum {
+                ARG_REMOVE = 0x100,
+        };
+
+        static const struct option options[] = {
+                { "resolve-names", required_argument, NULL, 'N'        },
+                { "remove",        no_argument,       NULL, ARG_REMOVE },
+                { "version",       no_argument,       NULL, 'V'        },
+                { "help",          no_argument,       NULL, 'h'        },
+                {}
+        };
+
+        int c;
+
+        while ((c = getopt_long(argc, argv, "N:Vh", options, NULL)) >= 0)
+                switch (c) {
+                case 'N':
+                        arg_resolve_name_timing = resolve_name_timing_from_string(optarg);
+                        if (arg_resolve_name_timing < 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "--resolve-names= must be early, late or never");
+                        break;
+                case ARG_REMOVE:
+                        arg_remove = true;
+                        break;
+                case 'V':
+                        return print_version();
+                case 'h':
+                        return help();
+                case '?':
+                        return -EINVAL;
+                default:
+                        assert_not_reached();
+                }
+
+        if (optind < argc)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "This command takes no arguments.");
+
+        return 1;
+}
+
+int compile_rules_main(int argc, char *argv[], void *userdata) {
+        int r;
+
+        r = parse_argv(argc, argv);
+        if (r <= 0)
+                return r;
+
+        if (arg_remove) {
+                if (unlink(UDEV_RULES_CACHE_PATH) < 0 && errno != ENOENT)
+                        return log_error_errno(errno, "Failed to remove %s: %m", UDEV_RULES_CACHE_PATH);
+
+                return 0;
+        }
+
+        /* udevd only uses the compiled rules if it resolves names at the same time */
+        return udev_rules_update_cache(arg_resolve_name_timing, UDEV_RULES_CACHE_PATH);
+}
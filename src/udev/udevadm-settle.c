@@ -17,20 +17,28 @@
 #include "sd-messages.h"
 
 #include "bus-util.h"
+#include "device-util.h"
 #include "fd-util.h"
 #include "io-util.h"
+#include "static-destruct.h"
 #include "string-util.h"
 #include "strv.h"
 #include "time-util.h"
 #include "udev-ctrl.h"
 #include "udev-util.h"
 #include "udevadm.h"
+#include "udevadm-util.h"
 #include "unit-def.h"
 #include "util.h"
 #include "virt.h"
 
 static usec_t arg_timeout = 120 * USEC_PER_SEC;
 static const char *arg_exists = NULL;
+static char **arg_subsystems = NULL;
+static char **arg_devices = NULL;
+
+STATIC_DESTRUCTOR_REGISTER(arg_subsystems, strv_freep);
+STATIC_DESTRUCTOR_REGISTER(arg_devices, strv_freep);
 
 static int help(void) {
         printf("%s settle [OPTIONS]\n\n"
@@ -38,16 +46,25 @@ static int help(void) {
                "  -h --help                 Show this help\n"
                "  -V --version              Show package version\n"
                "  -t --timeout=SEC          Maximum time to wait for events\n"
-               "  -E --exit-if-exists=FILE  Stop waiting if file exists\n",
+               "  -E --exit-if-exists=FILE  Stop waiting if file exists\n"
+               "     --subsystem=SUBSYSTEM  Only wait for events of devices of the subsystem\n"
+               "     --device=DEVICE        Only wait for events of the device and devices below it\n",
                program_invocation_short_name);
 
         return 0;
 }
 
 static int parse_argv(int argc, char *argv[]) {
+        enum {
+                ARG_SUBSYSTEM = 0x100,
+                ARG_DEVICE,
+        };
+
         static const struct option options[] = {
-                { "timeout",        required_argument, NULL, 't' },
-                { "exit-if-exists", required_argument, NULL, 'E' },
+                { "timeout",        required_argument, NULL, 't'           },
+                { "exit-if-exists", required_argument, NULL, 'E'           },
+                { "subsystem",      required_argument, NULL, ARG_SUBSYSTEM },
+                { "device",         required_argument, NULL, ARG_DEVICE    },
                 { "version",        no_argument,       NULL, 'V' },
                 { "help",           no_argument,       NULL, 'h' },
                 { "seq-start",      required_argument, NULL, 's' }, /* removed */
@@ -68,6 +85,16 @@ static int parse_argv(int argc, char *argv[]) {
                 case 'E':
                         arg_exists = optarg;
                         break;
+                case ARG_SUBSYSTEM:
+                        r = strv_extend(&arg_subsystems, optarg);
+                        if (r < 0)
+                                return log_oom();
+                        break;
+                case ARG_DEVICE:
+                        r = strv_extend(&arg_devices, optarg);
+                        if (r < 0)
+                                return log_oom();
+                        break;
                 case 'V':
                         return print_version();
                 case 'h':
@@ -158,6 +185,77 @@ static int emit_deprecation_warning(void) {
         return 0;
 }
 
+static int wait_for_events(enum udev_ctrl_msg_type type, const char *match, usec_t deadline) {
+        _cleanup_(udev_ctrl_unrefp) struct udev_ctrl *uctrl = NULL;
+        usec_t n;
+        int r;
+
+        assert(match);
+
+        if (strlen(match) >= sizeof_field(union udev_ctrl_msg_value, buf))
+                return log_error_errno(SYNTHETIC_ERRNO(ENAMETOOLONG), "'%s' is too long.", match);
+
+        r = udev_ctrl_new(&uctrl);
+        if (r < 0)
+                return log_error_errno(r, "Failed to initialize udev control: %m");
+
+        r = udev_ctrl_send(uctrl, type, 0, match);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to connect to udev daemon: %m");
+                return 0;
+        }
+
+        /* The daemon closes the connection once all events we are interested in are processed. Note that
+         * udev_ctrl_wait() does not wait at all with a zero timeout. */
+        n = now(CLOCK_MONOTONIC);
+        r = deadline > n ? udev_ctrl_wait(uctrl, deadline - n) : -ETIMEDOUT;
+        if (r == -ETIMEDOUT)
+                return log_error_errno(r, "Timed out waiting for events of '%s'.", match);
+        if (r < 0)
+                return log_error_errno(r, "Failed to wait for daemon to reply: %m");
+
+        return 0;
+}
+
+static int settle_selected(usec_t deadline) {
+        char **p;
+        int r;
+
+        /* Instead of watching the whole queue, let the daemon tell us when the events we care about are
+         * processed. Connecting to the control socket requires privileges. */
+        if (getuid() != 0)
+                return log_error_errno(SYNTHETIC_ERRNO(EPERM),
+                                       "Waiting for specific subsystems or devices requires root privileges.");
+
+        if (arg_exists && access(arg_exists, F_OK) >= 0)
+                return 0;
+
+        STRV_FOREACH(p, arg_subsystems) {
+                r = wait_for_events(UDEV_CTRL_WAIT_SUBSYSTEM, *p, deadline);
+                if (r < 0)
+                        return r;
+        }
+
+        STRV_FOREACH(p, arg_devices) {
+                _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+                const char *devpath;
+
+                r = find_device(*p, "/sys", &dev);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to open device '%s': %m", *p);
+
+                r = sd_device_get_devpath(dev, &devpath);
+                if (r < 0)
+                        return log_device_error_errno(dev, r, "Failed to get devpath: %m");
+
+                r = wait_for_events(UDEV_CTRL_WAIT_DEVICE, devpath, deadline);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 int settle_main(int argc, char *argv[], void *userdata) {
         _cleanup_close_ int fd = -1;
         usec_t deadline;
@@ -174,6 +272,9 @@ int settle_main(int argc, char *argv[], void *userdata) {
 
         deadline = now(CLOCK_MONOTONIC) + arg_timeout;
 
+        if (arg_subsystems || arg_devices)
+                return settle_selected(deadline);
+
         /* guarantee that the udev daemon isn't pre-processing */
         if (getuid() == 0) {
                 _cleanup_(udev_ctrl_unrefp) struct udev_ctrl *uctrl = NULL;
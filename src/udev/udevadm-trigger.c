@@ -2,6 +2,8 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include "sd-device.h"
 #include "sd-event.h"
@@ -11,9 +13,11 @@
 #include "device-util.h"
 #include "fd-util.h"
 #include "fileio.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "process-util.h"
 #include "set.h"
+#include "sort-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "udevadm.h"
@@ -25,6 +29,307 @@ static bool arg_verbose = false;
 static bool arg_dry_run = false;
 static bool arg_quiet = false;
 static bool arg_uuid = false;
+static unsigned arg_jobs = 1;
+
+#define TRIGGER_JOBS_MAX 64U
+
+typedef struct TriggerItem {
+        sd_device *device;
+        size_t group;           /* devices of the same subsystem are in the same group */
+        size_t index;           /* position in the enumeration */
+        char *path;             /* the uevent file of the device */
+        char *value;            /* the string to write into it */
+        bool fallback;          /* whether to retry without UUID if the kernel refuses it */
+        sd_id128_t id;
+        int error;
+} TriggerItem;
+
+typedef struct TriggerQueue {
+        TriggerItem *items;
+        size_t n_items;
+        size_t *groups;         /* start of each group in items, followed by n_items */
+        size_t n_groups;
+        size_t next_group;      /* the next group to process, shared between the threads */
+        const char *action;
+} TriggerQueue;
+
+static void trigger_queue_done(TriggerQueue *q) {
+        assert(q);
+
+        for (size_t i = 0; i < q->n_items; i++) {
+                sd_device_unref(q->items[i].device);
+                free(q->items[i].path);
+                free(q->items[i].value);
+        }
+
+        free(q->items);
+        free(q->groups);
+}
+
+static int trigger_result(
+                sd_device *d,
+                const char *syspath,
+                const char *action_str,
+                int error,
+                sd_id128_t id,
+                Hashmap *settle_hashmap,
+                int *ret) {
+
+        int r;
+
+        assert(d);
+        assert(syspath);
+        assert(ret);
+
+        if (error < 0) {
+                /* ENOENT may be returned when a device does not have /uevent or is already
+                 * removed. Hence, this is logged at debug level and ignored.
+                 *
+                 * ENODEV may be returned by some buggy device drivers e.g. /sys/devices/vio.
+                 * See,
+                 * https://github.com/systemd/systemd/issues/13652#issuecomment-535129791 and
+                 * https://bugs.launchpad.net/ubuntu/+source/linux/+bug/1845319.
+                 * So, this error is ignored, but logged at warning level to encourage people to
+                 * fix the driver.
+                 *
+                 * EROFS is returned when /sys is read only. In that case, all subsequent
+                 * writes will also fail, hence return immediately.
+                 *
+                 * EACCES or EPERM may be returned when this is invoked by non-priviledged user.
+                 * We do NOT return immediately, but continue operation and propagate the error.
+                 * Why? Some device can be owned by a user, e.g., network devices configured in
+                 * a network namespace. See, https://github.com/systemd/systemd/pull/18559 and
+                 * https://git.kernel.org/pub/scm/linux/kernel/git/torvalds/linux.git/commit/?id=ebb4a4bf76f164457184a3f43ebc1552416bc823
+                 *
+                 * All other errors are logged at error level, but let's continue the operation,
+                 * and propagate the error.
+                 */
+
+                bool ignore = IN_SET(error, -ENOENT, -ENODEV);
+                int level =
+                        arg_quiet ? LOG_DEBUG :
+                        error == -ENOENT ? LOG_DEBUG :
+                        error == -ENODEV ? LOG_WARNING : LOG_ERR;
+
+                log_device_full_errno(d, level, error,
+                                      "Failed to write '%s' to '%s/uevent'%s: %m",
+                                      action_str, syspath, ignore ? ", ignoring" : "");
+
+                if (error == -EROFS)
+                        return error;
+                if (*ret == 0 && !ignore)
+                        *ret = error;
+                return 0;
+        }
+
+        /* If the user asked for it, write event UUID to stdout */
+        if (arg_uuid)
+                printf(SD_ID128_UUID_FORMAT_STR "\n", SD_ID128_FORMAT_VAL(id));
+
+        if (settle_hashmap) {
+                _cleanup_free_ sd_id128_t *mid = NULL;
+                _cleanup_free_ char *sp = NULL;
+
+                sp = strdup(syspath);
+                if (!sp)
+                        return log_oom();
+
+                mid = newdup(sd_id128_t, &id, 1);
+                if (!mid)
+                        return log_oom();
+
+                r = hashmap_put(settle_hashmap, sp, mid);
+                if (r < 0)
+                        return log_oom();
+
+                TAKE_PTR(sp);
+                TAKE_PTR(mid);
+        }
+
+        return 0;
+}
+
+static void trigger_item(TriggerQueue *q, TriggerItem *item) {
+        int r;
+
+        assert(q);
+        assert(item);
+
+        /* Runs in the worker threads. sd_device objects are not thread-safe, hence only write the prepared
+         * string here, and leave everything else to the main thread. */
+
+        r = write_string_file(item->path, item->value, WRITE_STRING_FILE_DISABLE_BUFFER | WRITE_STRING_FILE_NOFOLLOW);
+        if (r == -EINVAL && item->fallback) {
+                /* See exec_list() */
+                r = write_string_file(item->path, q->action, WRITE_STRING_FILE_DISABLE_BUFFER | WRITE_STRING_FILE_NOFOLLOW);
+                if (r >= 0)
+                        item->id = SD_ID128_NULL;
+        }
+
+        item->error = r;
+}
+
+static void* trigger_thread(void *userdata) {
+        TriggerQueue *q = userdata;
+
+        assert(q);
+
+        for (;;) {
+                size_t g;
+
+                g = __sync_fetch_and_add(&q->next_group, 1);
+                if (g >= q->n_groups)
+                        break;
+
+                /* The devices of one subsystem are triggered in order, by the same thread */
+                for (size_t i = q->groups[g]; i < q->groups[g + 1]; i++)
+                        trigger_item(q, q->items + i);
+        }
+
+        return NULL;
+}
+
+static int trigger_item_compare(const TriggerItem *a, const TriggerItem *b) {
+        int r;
+
+        r = CMP(a->group, b->group);
+        if (r != 0)
+                return r;
+
+        return CMP(a->index, b->index);
+}
+
+static int exec_list_parallel(
+                sd_device_enumerator *e,
+                sd_device_action_t action,
+                Hashmap *settle_hashmap) {
+
+        _cleanup_(trigger_queue_done) TriggerQueue q = {};
+        _cleanup_hashmap_free_ Hashmap *subsystems = NULL;
+        pthread_t threads[TRIGGER_JOBS_MAX];
+        size_t n_threads = 0, n;
+        bool use_uuid = arg_uuid || settle_hashmap;
+        sigset_t ss, saved_ss;
+        sd_device *d;
+        int r, ret = 0;
+
+        q.action = device_action_to_string(action);
+
+        FOREACH_DEVICE_AND_SUBSYSTEM(e, d) {
+                const char *syspath, *subsystem;
+                TriggerItem *item;
+                void *v;
+
+                r = sd_device_get_syspath(d, &syspath);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to get syspath of enumerated devices, ignoring: %m");
+                        continue;
+                }
+
+                if (arg_verbose)
+                        printf("%s\n", syspath);
+
+                if (sd_device_get_subsystem(d, &subsystem) < 0)
+                        subsystem = "";
+
+                if (!GREEDY_REALLOC(q.items, q.n_items + 1))
+                        return log_oom();
+
+                item = q.items + q.n_items;
+                *item = (TriggerItem) {
+                        .index = q.n_items,
+                        .fallback = !arg_uuid && settle_hashmap,
+                };
+
+                v = hashmap_get(subsystems, subsystem);
+                if (v)
+                        item->group = PTR_TO_SIZE(v) - 1;
+                else {
+                        item->group = hashmap_size(subsystems);
+
+                        /* The key is owned by the device, which we keep a reference to */
+                        r = hashmap_ensure_put(&subsystems, &string_hash_ops, subsystem, SIZE_TO_PTR(item->group + 1));
+                        if (r < 0)
+                                return log_oom();
+                }
+
+                item->path = path_join(syspath, "uevent");
+                if (!item->path)
+                        return log_oom();
+
+                if (use_uuid) {
+                        r = sd_id128_randomize(&item->id);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to generate UUID: %m");
+
+                        if (asprintf(&item->value, "%s " SD_ID128_UUID_FORMAT_STR, q.action, SD_ID128_FORMAT_VAL(item->id)) < 0)
+                                return log_oom();
+                } else {
+                        item->value = strdup(q.action);
+                        if (!item->value)
+                                return log_oom();
+                }
+
+                item->device = sd_device_ref(d);
+                q.n_items++;
+        }
+
+        if (q.n_items == 0)
+                return 0;
+
+        typesafe_qsort(q.items, q.n_items, trigger_item_compare);
+
+        q.groups = new(size_t, hashmap_size(subsystems) + 1);
+        if (!q.groups)
+                return log_oom();
+
+        for (size_t i = 0; i < q.n_items; i++)
+                if (i == 0 || q.items[i].group != q.items[i - 1].group)
+                        q.groups[q.n_groups++] = i;
+        q.groups[q.n_groups] = q.n_items;
+
+        /* The main thread takes a share of the work, too */
+        n = MIN3((size_t) arg_jobs, q.n_groups, (size_t) TRIGGER_JOBS_MAX) - 1;
+
+        /* Start the threads with all signals blocked, so that they don't affect signal handling of the main
+         * thread. */
+        if (n > 0) {
+                assert_se(sigfillset(&ss) >= 0);
+                r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+                if (r > 0) {
+                        log_debug_errno(r, "Failed to block signals, triggering devices without additional threads: %m");
+                        n = 0;
+                }
+        }
+
+        for (; n_threads < n; n_threads++) {
+                r = pthread_create(threads + n_threads, NULL, trigger_thread, &q);
+                if (r > 0) {
+                        log_debug_errno(r, "Failed to start thread, continuing with %zu threads: %m", n_threads);
+                        break;
+                }
+        }
+
+        if (n > 0)
+                assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+
+        (void) trigger_thread(&q);
+
+        for (size_t i = 0; i < n_threads; i++)
+                assert_se(pthread_join(threads[i], NULL) == 0);
+
+        for (size_t i = 0; i < q.n_items; i++) {
+                const char *syspath;
+
+                assert_se(sd_device_get_syspath(q.items[i].device, &syspath) >= 0);
+
+                r = trigger_result(q.items[i].device, syspath, q.action, q.items[i].error, q.items[i].id, settle_hashmap, &ret);
+                if (r < 0)
+                        return r;
+        }
+
+        return ret;
+}
 
 static int exec_list(
                 sd_device_enumerator *e,
@@ -36,6 +341,9 @@ static int exec_list(
         sd_device *d;
         int r, ret = 0;
 
+        if (arg_jobs > 1 && !arg_dry_run)
+                return exec_list_parallel(e, action, settle_hashmap);
+
         action_str = device_action_to_string(action);
 
         FOREACH_DEVICE_AND_SUBSYSTEM(e, d) {
@@ -66,70 +374,10 @@ static int exec_list(
                                 skip_uuid_logic = true; /* dropping the uuid stuff changed the return code,
                                                          * hence don't bother next time */
                 }
-                if (r < 0) {
-                        /* ENOENT may be returned when a device does not have /uevent or is already
-                         * removed. Hence, this is logged at debug level and ignored.
-                         *
-                         * ENODEV may be returned by some buggy device drivers e.g. /sys/devices/vio.
-                         * See,
-                         * https://github.com/systemd/systemd/issues/13652#issuecomment-535129791 and
-                         * https://bugs.launchpad.net/ubuntu/+source/linux/+bug/1845319.
-                         * So, this error is ignored, but logged at warning level to encourage people to
-                         * fix the driver.
-                         *
-                         * EROFS is returned when /sys is read only. In that case, all subsequent
-                         * writes will also fail, hence return immediately.
-                         *
-                         * EACCES or EPERM may be returned when this is invoked by non-priviledged user.
-                         * We do NOT return immediately, but continue operation and propagate the error.
-                         * Why? Some device can be owned by a user, e.g., network devices configured in
-                         * a network namespace. See, https://github.com/systemd/systemd/pull/18559 and
-                         * https://git.kernel.org/pub/scm/linux/kernel/git/torvalds/linux.git/commit/?id=ebb4a4bf76f164457184a3f43ebc1552416bc823
-                         *
-                         * All other errors are logged at error level, but let's continue the operation,
-                         * and propagate the error.
-                         */
-
-                        bool ignore = IN_SET(r, -ENOENT, -ENODEV);
-                        int level =
-                                arg_quiet ? LOG_DEBUG :
-                                r == -ENOENT ? LOG_DEBUG :
-                                r == -ENODEV ? LOG_WARNING : LOG_ERR;
-
-                        log_device_full_errno(d, level, r,
-                                              "Failed to write '%s' to '%s/uevent'%s: %m",
-                                              action_str, syspath, ignore ? ", ignoring" : "");
-
-                        if (r == -EROFS)
-                                return r;
-                        if (ret == 0 && !ignore)
-                                ret = r;
-                        continue;
-                }
-
-                /* If the user asked for it, write event UUID to stdout */
-                if (arg_uuid)
-                        printf(SD_ID128_UUID_FORMAT_STR "\n", SD_ID128_FORMAT_VAL(id));
-
-                if (settle_hashmap) {
-                        _cleanup_free_ sd_id128_t *mid = NULL;
-                        _cleanup_free_ char *sp = NULL;
-
-                        sp = strdup(syspath);
-                        if (!sp)
-                                return log_oom();
-
-                        mid = newdup(sd_id128_t, &id, 1);
-                        if (!d)
-                                return log_oom();
 
-                        r = hashmap_put(settle_hashmap, sp, mid);
-                        if (r < 0)
-                                return log_oom();
-
-                        TAKE_PTR(sp);
-                        TAKE_PTR(mid);
-                }
+                r = trigger_result(d, syspath, action_str, r, id, settle_hashmap, &ret);
+                if (r < 0)
+                        return r;
         }
 
         return ret;
@@ -229,7 +477,9 @@ static int help(void) {
                "  -w --settle                       Wait for the triggered events to complete\n"
                "     --wait-daemon[=SECONDS]        Wait for udevd daemon to be initialized\n"
                "                                    before triggering uevents\n"
-               "     --uuid                         Print synthetic uevent UUID\n",
+               "     --uuid                         Print synthetic uevent UUID\n"
+               "     --jobs=N                       Trigger devices of different subsystems\n"
+               "                                    on up to N threads\n",
                program_invocation_short_name);
 
         return 0;
@@ -240,6 +490,7 @@ int trigger_main(int argc, char *argv[], void *userdata) {
                 ARG_NAME = 0x100,
                 ARG_PING,
                 ARG_UUID,
+                ARG_JOBS,
         };
 
         static const struct option options[] = {
@@ -262,6 +513,7 @@ int trigger_main(int argc, char *argv[], void *userdata) {
                 { "version",           no_argument,       NULL, 'V'      },
                 { "help",              no_argument,       NULL, 'h'      },
                 { "uuid",              no_argument,       NULL, ARG_UUID },
+                { "jobs",              required_argument, NULL, ARG_JOBS },
                 {}
         };
         enum {
@@ -409,6 +661,15 @@ int trigger_main(int argc, char *argv[], void *userdata) {
                         arg_uuid = true;
                         break;
 
+                case ARG_JOBS:
+                        r = safe_atou(optarg, &arg_jobs);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --jobs= value '%s': %m", optarg);
+                        if (arg_jobs == 0 || arg_jobs > TRIGGER_JOBS_MAX)
+                                return log_error_errno(SYNTHETIC_ERRNO(ERANGE),
+                                                       "--jobs= value must be between 1 and %u.", TRIGGER_JOBS_MAX);
+                        break;
+
                 case 'V':
                         return print_version();
                 case 'h':
@@ -19,13 +19,14 @@
 
 static int help(void) {
         static const char *const short_descriptions[][2] = {
-                { "info",         "Query sysfs or the udev database" },
-                { "trigger",      "Request events from the kernel"   },
-                { "settle",       "Wait for pending udev events"     },
-                { "control",      "Control the udev daemon"          },
-                { "monitor",      "Listen to kernel and udev events" },
-                { "test",         "Test an event run"                },
-                { "test-builtin", "Test a built-in command"          },
+                { "info",          "Query sysfs or the udev database" },
+                { "trigger",       "Request events from the kernel"   },
+                { "settle",        "Wait for pending udev events"     },
+                { "control",       "Control the udev daemon"          },
+                { "monitor",       "Listen to kernel and udev events" },
+                { "test",          "Test an event run"                },
+                { "test-builtin",  "Test a built-in command"          },
+                { "compile-rules", "Compile the rules files"          },
         };
 
         _cleanup_free_ char *link = NULL;
@@ -42,7 +43,7 @@ static int help(void) {
                program_invocation_short_name);
 
         for (i = 0; i < ELEMENTSOF(short_descriptions); i++)
-                printf("  %-12s  %s\n", short_descriptions[i][0], short_descriptions[i][1]);
+                printf("  %-13s  %s\n", short_descriptions[i][0], short_descriptions[i][1]);
 
         printf("\nSee the %s for details.\n", link);
         return 0;
@@ -93,16 +94,17 @@ static int help_main(int argc, char *argv[], void *userdata) {
 
 static int udevadm_main(int argc, char *argv[]) {
         static const Verb verbs[] = {
-                { "info",         VERB_ANY, VERB_ANY, 0, info_main    },
-                { "trigger",      VERB_ANY, VERB_ANY, 0, trigger_main },
-                { "settle",       VERB_ANY, VERB_ANY, 0, settle_main  },
-                { "control",      VERB_ANY, VERB_ANY, 0, control_main },
-                { "monitor",      VERB_ANY, VERB_ANY, 0, monitor_main },
-                { "hwdb",         VERB_ANY, VERB_ANY, 0, hwdb_main    },
-                { "test",         VERB_ANY, VERB_ANY, 0, test_main    },
-                { "test-builtin", VERB_ANY, VERB_ANY, 0, builtin_main },
-                { "version",      VERB_ANY, VERB_ANY, 0, version_main },
-                { "help",         VERB_ANY, VERB_ANY, 0, help_main    },
+                { "info",          VERB_ANY, VERB_ANY, 0, info_main          },
+                { "trigger",       VERB_ANY, VERB_ANY, 0, trigger_main       },
+                { "settle",        VERB_ANY, VERB_ANY, 0, settle_main        },
+                { "control",       VERB_ANY, VERB_ANY, 0, control_main       },
+                { "monitor",       VERB_ANY, VERB_ANY, 0, monitor_main       },
+                { "hwdb",          VERB_ANY, VERB_ANY, 0, hwdb_main          },
+                { "test",          VERB_ANY, VERB_ANY, 0, test_main          },
+                { "test-builtin",  VERB_ANY, VERB_ANY, 0, builtin_main       },
+                { "compile-rules", VERB_ANY, VERB_ANY, 0, compile_rules_main },
+                { "version",       VERB_ANY, VERB_ANY, 0, version_main       },
+                { "help",          VERB_ANY, VERB_ANY, 0, help_main          },
                 {}
         };
 
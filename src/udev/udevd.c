@@ -16,6 +16,7 @@
 #include <sys/file.h>
 #include <sys/inotify.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/mount.h>
 #include <sys/prctl.h>
 #include <sys/signalfd.h>
@@ -46,11 +47,14 @@
 #include "main-func.h"
 #include "mkdir.h"
 #include "netlink-util.h"
+#include "nulstr-util.h"
 #include "parse-util.h"
+#include "path-util.h"
 #include "pretty-print.h"
 #include "proc-cmdline.h"
 #include "process-util.h"
 #include "selinux-util.h"
+#include "siphash24.h"
 #include "signal-util.h"
 #include "socket-util.h"
 #include "string-util.h"
@@ -77,10 +81,25 @@ static usec_t arg_event_timeout_usec = 180 * USEC_PER_SEC;
 static int arg_timeout_signal = SIGKILL;
 static bool arg_blockdev_read_only = false;
 
+/* The devpaths of all queued events are announced to the workers through this ring buffer of hashes, which
+ * lives in memory shared between udevd and its workers. Workers keep the parent devices they looked up while
+ * processing an event for the next events, and drop them when an event for one of them has been queued in
+ * the meantime, see worker_update_device_cache(). */
+#define EVENT_RING_SIZE 1024U
+
+typedef struct EventRing {
+        uint64_t head; /* the number of hashes written so far */
+        uint64_t hashes[EVENT_RING_SIZE];
+} EventRing;
+
+/* The maximum number of parent devices a worker keeps between events */
+#define WORKER_DEVICE_CACHE_MAX 256U
+
 typedef struct Manager {
         sd_event *event;
         Hashmap *workers;
         LIST_HEAD(struct event, events);
+        LIST_HEAD(struct waiter, waiters);
         const char *cgroup;
         pid_t pid; /* the process that originally allocated the manager object */
         int log_level;
@@ -100,8 +119,17 @@ typedef struct Manager {
 
         sd_event_source *kill_workers_event;
 
+        EventRing *event_ring;
+
+        /* used by workers */
+        Hashmap *device_cache; /* syspath → parent sd_device */
+        uint64_t event_ring_tail; /* the position in event_ring the cache is up to date with */
+
         usec_t last_usec;
 
+        unsigned n_events_coalesced;
+        unsigned n_events_coalesced_notified;
+
         bool stop_exec_queue;
         bool exit;
 } Manager;
@@ -129,7 +157,20 @@ struct event {
         LIST_FIELDS(struct event, event);
 };
 
+/* A client waiting for all events of a subsystem or a device to be processed, see on_ctrl_msg(). We reply
+ * by closing the connection. */
+struct waiter {
+        Manager *manager;
+        enum udev_ctrl_msg_type type;
+        char *match; /* subsystem or devpath */
+        int fd;
+        sd_event_source *event_source;
+
+        LIST_FIELDS(struct waiter, waiters);
+};
+
 static void event_queue_cleanup(Manager *manager, enum event_state type);
+static void manager_release_waiters(Manager *manager);
 
 enum worker_state {
         WORKER_UNDEF,
@@ -168,14 +209,33 @@ static void event_free(struct event *event) {
                 event->worker->event = NULL;
 
         /* only clean up the queue from the process that created it */
-        if (LIST_IS_EMPTY(event->manager->events) &&
-            event->manager->pid == getpid_cached())
-                if (unlink("/run/udev/queue") < 0)
-                        log_warning_errno(errno, "Failed to unlink /run/udev/queue: %m");
+        if (event->manager->pid == getpid_cached()) {
+                if (LIST_IS_EMPTY(event->manager->events))
+                        if (unlink("/run/udev/queue") < 0)
+                                log_warning_errno(errno, "Failed to unlink /run/udev/queue: %m");
+
+                manager_release_waiters(event->manager);
+        }
 
         free(event);
 }
 
+static struct waiter* waiter_free(struct waiter *waiter) {
+        if (!waiter)
+                return NULL;
+
+        if (waiter->manager)
+                LIST_REMOVE(waiters, waiter->manager->waiters, waiter);
+
+        sd_event_source_unref(waiter->event_source);
+        safe_close(waiter->fd);
+        free(waiter->match);
+
+        return mfree(waiter);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct waiter*, waiter_free);
+
 static struct worker* worker_free(struct worker *worker) {
         if (!worker)
                 return NULL;
@@ -282,6 +342,9 @@ static void manager_clear_for_worker(Manager *manager) {
         manager->event = sd_event_unref(manager->event);
 
         manager->workers = hashmap_free(manager->workers);
+
+        while (manager->waiters)
+                waiter_free(manager->waiters);
         event_queue_cleanup(manager, EVENT_UNDEF);
 
         manager->monitor = sd_device_monitor_unref(manager->monitor);
@@ -290,6 +353,102 @@ static void manager_clear_for_worker(Manager *manager) {
         manager->worker_watch[READ_END] = safe_close(manager->worker_watch[READ_END]);
 }
 
+static uint64_t devpath_hash(const char *devpath) {
+        struct siphash state;
+
+        assert(devpath);
+
+        /* No need for a secret key here, collisions only result in cached devices being dropped. */
+        siphash24_init(&state, (const uint8_t[16]) {});
+        path_hash_func(devpath, &state);
+        return siphash24_finalize(&state);
+}
+
+static void event_ring_push(EventRing *ring, const char *devpath) {
+        uint64_t head;
+
+        assert(devpath);
+
+        if (!ring)
+                return;
+
+        /* Only udevd writes to the ring, hence no need to protect against concurrent writers. Publish the
+         * new head only after the hash is written. */
+        head = ring->head;
+        __atomic_store_n(ring->hashes + head % EVENT_RING_SIZE, devpath_hash(devpath), __ATOMIC_RELAXED);
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(device_cache_hash_ops, char, path_hash_func, path_compare,
+                                              sd_device, sd_device_unref);
+
+static void worker_flush_device_cache(Manager *manager) {
+        sd_device *d;
+
+        assert(manager);
+
+        /* Devices dropped from the cache might still be referenced by others, detach them from it */
+        HASHMAP_FOREACH(d, manager->device_cache)
+                device_set_parent_cache(d, NULL);
+
+        hashmap_clear(manager->device_cache);
+}
+
+static void worker_update_device_cache(Manager *manager) {
+        _cleanup_free_ uint64_t *cached = NULL;
+        bool flush = false;
+        uint64_t head;
+        size_t n = 0;
+        sd_device *d;
+
+        assert(manager);
+
+        if (!manager->event_ring || !manager->device_cache)
+                return;
+
+        head = __atomic_load_n(&manager->event_ring->head, __ATOMIC_ACQUIRE);
+
+        if (head - manager->event_ring_tail > EVENT_RING_SIZE ||
+            hashmap_size(manager->device_cache) >= WORKER_DEVICE_CACHE_MAX)
+                flush = true;
+        else if (!hashmap_isempty(manager->device_cache)) {
+                cached = new(uint64_t, hashmap_size(manager->device_cache));
+                if (!cached)
+                        flush = true;
+                else {
+                        HASHMAP_FOREACH(d, manager->device_cache) {
+                                const char *devpath;
+
+                                if (sd_device_get_devpath(d, &devpath) >= 0)
+                                        cached[n++] = devpath_hash(devpath);
+                        }
+
+                        /* If any of the cached devices got an event since, simply start from scratch */
+                        for (uint64_t i = manager->event_ring_tail; i < head && !flush; i++) {
+                                uint64_t h;
+
+                                h = __atomic_load_n(manager->event_ring->hashes + i % EVENT_RING_SIZE, __ATOMIC_RELAXED);
+                                for (size_t j = 0; j < n; j++)
+                                        if (cached[j] == h) {
+                                                flush = true;
+                                                break;
+                                        }
+                        }
+
+                        /* If udevd went around the ring while we were reading it, we might have missed some */
+                        if (__atomic_load_n(&manager->event_ring->head, __ATOMIC_ACQUIRE) - manager->event_ring_tail > EVENT_RING_SIZE)
+                                flush = true;
+                }
+        }
+
+        if (flush) {
+                log_debug("Dropping %u cached parent devices.", hashmap_size(manager->device_cache));
+                worker_flush_device_cache(manager);
+        }
+
+        manager->event_ring_tail = head;
+}
+
 static Manager* manager_free(Manager *manager) {
         if (!manager)
                 return NULL;
@@ -309,6 +468,12 @@ static Manager* manager_free(Manager *manager) {
         safe_close(manager->inotify_fd);
         safe_close_pair(manager->worker_watch);
 
+        worker_flush_device_cache(manager);
+        hashmap_free(manager->device_cache);
+
+        if (manager->event_ring)
+                (void) munmap(manager->event_ring, sizeof(EventRing));
+
         return mfree(manager);
 }
 
@@ -438,6 +603,12 @@ static int worker_process_device(Manager *manager, sd_device *dev) {
 
         log_device_uevent(dev, "Processing device");
 
+        /* The parents looked up while processing earlier events are reused, unless they got an event
+         * themselves in the meantime. */
+        worker_update_device_cache(manager);
+        if (manager->device_cache)
+                device_set_parent_cache(dev, manager->device_cache);
+
         udev_event = udev_event_new(dev, arg_exec_delay_usec, manager->rtnl, manager->log_level);
         if (!udev_event)
                 return -ENOMEM;
@@ -563,6 +734,14 @@ static int worker_main(Manager *_manager, sd_device_monitor *monitor, sd_device
         /* Clear unnecessary data in Manager object. */
         manager_clear_for_worker(manager);
 
+        if (manager->event_ring) {
+                manager->device_cache = hashmap_new(&device_cache_hash_ops);
+                if (!manager->device_cache)
+                        log_debug("Failed to allocate device cache, not caching parent devices.");
+
+                manager->event_ring_tail = __atomic_load_n(&manager->event_ring->head, __ATOMIC_ACQUIRE);
+        }
+
         r = sd_event_new(&manager->event);
         if (r < 0)
                 return log_error_errno(r, "Failed to allocate event loop: %m");
@@ -683,9 +862,82 @@ static void event_run(Manager *manager, struct event *event) {
         worker_spawn(manager, event);
 }
 
+static bool event_properties_equal(sd_device *a, sd_device *b) {
+        const char *key, *value, *v;
+        size_t n = 0;
+
+        assert(a);
+        assert(b);
+
+        /* Compares the properties the kernel sent with the two events, ignoring those that are different
+         * for every event anyway. */
+
+        FOREACH_DEVICE_PROPERTY(a, key, value) {
+                if (nulstr_contains("SEQNUM\0USEC_INITIALIZED\0", key))
+                        continue;
+
+                if (sd_device_get_property_value(b, key, &v) < 0 || !streq(v, value))
+                        return false;
+
+                n++;
+        }
+
+        FOREACH_DEVICE_PROPERTY(b, key, value) {
+                if (nulstr_contains("SEQNUM\0USEC_INITIALIZED\0", key))
+                        continue;
+
+                if (n == 0)
+                        return false;
+                n--;
+        }
+
+        return n == 0;
+}
+
+static struct event* event_queue_find_superseded(Manager *manager, sd_device *dev) {
+        struct event *event, *last = NULL;
+        sd_device_action_t action;
+        const char *devpath;
+
+        assert(manager);
+        assert(dev);
+
+        /* A burst of "change" events for the same device, e.g. from multipath or from a block device whose
+         * media is probed repeatedly, results in the same rules being run over and over again on the same
+         * device state. If the last event queued for the device is a "change" event that has not been
+         * started yet, and that carries exactly the same properties as the new one, then the new event
+         * supersedes it, and the old one can be dropped. Events with different properties, e.g. with
+         * different DM_COOKIE=, are never merged, as somebody might wait for each of them. */
+
+        if (sd_device_get_action(dev, &action) < 0 || action != SD_DEVICE_CHANGE)
+                return NULL;
+
+        if (sd_device_get_devpath(dev, &devpath) < 0)
+                return NULL;
+
+        LIST_FOREACH(event, event, manager->events) {
+                const char *p;
+
+                if (sd_device_get_devpath(event->dev, &p) >= 0 && streq(p, devpath))
+                        last = event;
+        }
+
+        if (!last || last->state != EVENT_QUEUED)
+                return NULL;
+
+        if (sd_device_get_action(last->dev, &action) < 0 || action != SD_DEVICE_CHANGE)
+                return NULL;
+
+        if (!event_properties_equal(last->dev_kernel, dev))
+                return NULL;
+
+        return last;
+}
+
 static int event_queue_insert(Manager *manager, sd_device *dev) {
         _cleanup_(sd_device_unrefp) sd_device *clone = NULL;
-        struct event *event;
+        struct event *event, *superseded;
+        const char *devpath;
         uint64_t seqnum;
         int r;
 
@@ -727,13 +979,46 @@ static int event_queue_insert(Manager *manager, sd_device *dev) {
                         log_warning_errno(r, "Failed to touch /run/udev/queue: %m");
         }
 
+        superseded = event_queue_find_superseded(manager, dev);
+
         LIST_APPEND(event, manager->events, event);
 
         log_device_uevent(dev, "Device is queued");
 
+        /* Tell the workers to drop the device, if they cached it */
+        if (sd_device_get_devpath(dev, &devpath) >= 0)
+                event_ring_push(manager->event_ring, devpath);
+        if (sd_device_get_property_value(dev, "DEVPATH_OLD", &devpath) >= 0)
+                event_ring_push(manager->event_ring, devpath);
+
+        if (superseded) {
+                log_device_debug(dev, "SEQNUM=%" PRIu64 " supersedes queued SEQNUM=%" PRIu64 ", dropping the latter.",
+                                 seqnum, superseded->seqnum);
+
+                /* Free this only after the new event is queued, so that the queue is never empty here */
+                event_free(superseded);
+                manager->n_events_coalesced++;
+        }
+
         return 0;
 }
 
+static void manager_notify_status(Manager *manager) {
+        assert(manager);
+
+        if (manager->n_events_coalesced > 0)
+                (void) sd_notifyf(false,
+                                  "READY=1\n"
+                                  "STATUS=Processing with %u children at max, %u change events coalesced",
+                                  arg_children_max, manager->n_events_coalesced);
+        else
+                (void) sd_notifyf(false,
+                                  "READY=1\n"
+                                  "STATUS=Processing with %u children at max", arg_children_max);
+
+        manager->n_events_coalesced_notified = manager->n_events_coalesced;
+}
+
 static void manager_kill_workers(Manager *manager, bool force) {
         struct worker *worker;
 
@@ -899,9 +1184,7 @@ static void manager_reload(Manager *manager) {
         manager->rules = udev_rules_free(manager->rules);
         udev_builtin_exit();
 
-        sd_notifyf(false,
-                   "READY=1\n"
-                   "STATUS=Processing with %u children at max", arg_children_max);
+        manager_notify_status(manager);
 }
 
 static int on_kill_workers_event(sd_event_source *s, uint64_t usec, void *userdata) {
@@ -1035,6 +1318,11 @@ static int on_worker(sd_event_source *s, int fd, uint32_t revents, void *userdat
                 event_free(worker->event);
         }
 
+        /* Update the counters once a burst of events has been processed, not for each event */
+        if (LIST_IS_EMPTY(manager->events) &&
+            manager->n_events_coalesced != manager->n_events_coalesced_notified)
+                manager_notify_status(manager);
+
         /* we have free workers, try to schedule events */
         event_queue_start(manager);
 
@@ -1063,6 +1351,103 @@ static int on_uevent(sd_device_monitor *monitor, sd_device *dev, void *userdata)
         return 1;
 }
 
+static bool event_matches_waiter(struct event *event, struct waiter *waiter) {
+        const char *s;
+
+        assert(event);
+        assert(waiter);
+
+        if (waiter->type == UDEV_CTRL_WAIT_SUBSYSTEM)
+                return sd_device_get_subsystem(event->dev, &s) >= 0 && streq(s, waiter->match);
+
+        /* Events for devices below the device count as well, e.g. for the partitions of a disk. */
+        if (sd_device_get_devpath(event->dev, &s) >= 0 && path_startswith(s, waiter->match))
+                return true;
+
+        return sd_device_get_property_value(event->dev, "DEVPATH_OLD", &s) >= 0 && path_startswith(s, waiter->match);
+}
+
+static void manager_release_waiters(Manager *manager) {
+        struct waiter *waiter, *tmp;
+
+        assert(manager);
+
+        LIST_FOREACH_SAFE(waiters, waiter, tmp, manager->waiters) {
+                struct event *event;
+                bool found = false;
+
+                LIST_FOREACH(event, event, manager->events)
+                        if (event_matches_waiter(event, waiter)) {
+                                found = true;
+                                break;
+                        }
+
+                if (found)
+                        continue;
+
+                log_debug("No more events for %s '%s', releasing waiting client.",
+                          waiter->type == UDEV_CTRL_WAIT_SUBSYSTEM ? "subsystem" : "device", waiter->match);
+                waiter_free(waiter);
+        }
+}
+
+static int on_waiter_hangup(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        struct waiter *waiter = userdata;
+
+        assert(waiter);
+
+        log_debug("Client waiting for '%s' disconnected.", waiter->match);
+        waiter_free(waiter);
+        return 0;
+}
+
+static int manager_add_waiter(Manager *manager, struct udev_ctrl *uctrl, enum udev_ctrl_msg_type type, const char *match) {
+        _cleanup_(waiter_freep) struct waiter *waiter = NULL;
+        int r;
+
+        assert(manager);
+        assert(uctrl);
+        assert(IN_SET(type, UDEV_CTRL_WAIT_SUBSYSTEM, UDEV_CTRL_WAIT_DEVICE));
+        assert(match);
+
+        if (isempty(match))
+                return -EINVAL;
+        if (type == UDEV_CTRL_WAIT_DEVICE && !path_is_absolute(match))
+                return -EINVAL;
+
+        waiter = new(struct waiter, 1);
+        if (!waiter)
+                return -ENOMEM;
+
+        *waiter = (struct waiter) {
+                .type = type,
+                .fd = -1,
+        };
+
+        waiter->match = strdup(match);
+        if (!waiter->match)
+                return -ENOMEM;
+
+        waiter->fd = udev_ctrl_take_connection(uctrl);
+        if (waiter->fd < 0)
+                return waiter->fd;
+
+        /* Only watch for the client giving up, everything it sends from now on is ignored. */
+        r = sd_event_add_io(manager->event, &waiter->event_source, waiter->fd, 0, on_waiter_hangup, waiter);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(waiter->event_source, "udev-ctrl-waiter");
+
+        waiter->manager = manager;
+        LIST_PREPEND(waiters, manager->waiters, waiter);
+        TAKE_PTR(waiter);
+
+        /* There may be nothing to wait for */
+        manager_release_waiters(manager);
+        return 0;
+}
+
 /* receive the udevd message from userspace */
 static int on_ctrl_msg(struct udev_ctrl *uctrl, enum udev_ctrl_msg_type type, const union udev_ctrl_msg_value *value, void *userdata) {
         Manager *manager = userdata;
@@ -1153,9 +1538,7 @@ static int on_ctrl_msg(struct udev_ctrl *uctrl, enum udev_ctrl_msg_type type, co
                 log_debug("Received udev control message (SET_MAX_CHILDREN), setting children_max=%i", value->intval);
                 arg_children_max = value->intval;
 
-                (void) sd_notifyf(false,
-                                  "READY=1\n"
-                                  "STATUS=Processing with %u children at max", arg_children_max);
+                manager_notify_status(manager);
                 break;
         case UDEV_CTRL_PING:
                 log_debug("Received udev control message (PING)");
@@ -1164,6 +1547,15 @@ static int on_ctrl_msg(struct udev_ctrl *uctrl, enum udev_ctrl_msg_type type, co
                 log_debug("Received udev control message (EXIT)");
                 manager_exit(manager);
                 break;
+        case UDEV_CTRL_WAIT_SUBSYSTEM:
+        case UDEV_CTRL_WAIT_DEVICE:
+                log_debug("Received udev control message (%s), waiting for events of '%s'",
+                          type == UDEV_CTRL_WAIT_SUBSYSTEM ? "WAIT_SUBSYSTEM" : "WAIT_DEVICE", value->buf);
+
+                r = manager_add_waiter(manager, uctrl, type, value->buf);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to wait for events of '%s', ignoring: %m", value->buf);
+                break;
         default:
                 log_debug("Received unknown udev control message, ignoring");
         }
@@ -1714,6 +2106,12 @@ static int manager_new(Manager **ret, int fd_ctrl, int fd_uevent, const char *cg
 
         manager->log_level = log_get_max_level();
 
+        manager->event_ring = mmap(NULL, sizeof(EventRing), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+        if (manager->event_ring == MAP_FAILED) {
+                log_warning_errno(errno, "Failed to allocate memory shared with workers, not caching devices in workers: %m");
+                manager->event_ring = NULL;
+        }
+
         *ret = TAKE_PTR(manager);
 
         return 0;
@@ -1816,9 +2214,7 @@ static int main_loop(Manager *manager) {
         if (r < 0)
                 log_error_errno(r, "Failed to apply permissions on static device nodes: %m");
 
-        (void) sd_notifyf(false,
-                          "READY=1\n"
-                          "STATUS=Processing with %u children at max", arg_children_max);
+        manager_notify_status(manager);
 
         r = sd_event_loop(manager->event);
         if (r < 0)
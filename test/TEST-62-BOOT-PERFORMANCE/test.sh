@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+set -e
+
+TEST_DESCRIPTION="Collect boot timings and check them for regressions"
+# Timings of a container "boot" say little about a real one
+TEST_NO_NSPAWN=1
+# testsuite-62.service ends the test itself, once the boot finished and the timings are collected
+KERNEL_APPEND="systemd.mask=end.service ${KERNEL_APPEND:-}"
+BOOT_PERF_ITERATIONS="${BOOT_PERF_ITERATIONS:-5}"
+
+# shellcheck source=test/test-functions
+. "${TEST_BASE_DIR:?}/test-functions"
+
+check_result_qemu() {
+    local ret
+
+    mount_initdir
+
+    # Boot 0 is the first boot of the image, which does a lot of one-time setup, hence it isn't counted
+    if [[ -d "${initdir:?}/boot-perf" ]] && ((BOOT_PERF_RUN > 0)); then
+        mkdir -p "${TESTDIR:?}/boot-perf"
+        rm -rf "$TESTDIR/boot-perf/boot-$BOOT_PERF_RUN"
+        cp -a "$initdir/boot-perf" "$TESTDIR/boot-perf/boot-$BOOT_PERF_RUN"
+    fi
+    rm -rf "$initdir/boot-perf"
+
+    check_result_common "${initdir:?}"
+    ret=$?
+
+    _umount_dir "${initdir:?}"
+
+    return $ret
+}
+
+test_run() {
+    local test_id="${1:?}"
+    local summary="${TESTDIR:?}/boot-perf/summary.json"
+    local args=()
+
+    rm -rf "$TESTDIR/boot-perf"
+
+    for ((BOOT_PERF_RUN = 0; BOOT_PERF_RUN <= BOOT_PERF_ITERATIONS; BOOT_PERF_RUN++)); do
+        mount_initdir
+        if ! run_qemu "$test_id"; then
+            dwarn "can't run QEMU, skipping"
+            return 0
+        fi
+        check_result_qemu || { echo "QEMU test failed"; return 1; }
+    done
+
+    if [[ -n "${BOOT_PERF_BASELINE:-}" ]]; then
+        args+=(--baseline="$BOOT_PERF_BASELINE")
+    fi
+
+    "$TEST_BASE_DIR/boot-perf.py" "${args[@]}" --output="$summary" "$TESTDIR"/boot-perf/boot-*/ || return 1
+
+    if [[ -d "${ARTIFACT_DIRECTORY:-}" ]]; then
+        cp "$summary" "$ARTIFACT_DIRECTORY/${testname:?}.json"
+    fi
+
+    return 0
+}
+
+do_test "$@"
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: LGPL-2.1-or-later
+
+"""Summarize the boot timings collected by TEST-62-BOOT-PERFORMANCE, and compare them with a baseline.
+
+Every BOOT directory contains the output of "systemctl show" for the manager (manager.txt) and for all
+units (units.txt), as written by test/units/testsuite-62.sh. The summary written to --output contains the
+timings of every boot, and can be passed as --baseline to a later run. A regression is reported, and the
+script exits with a non-zero status, if the mean of a timing is both noticeably and statistically
+significantly (according to Welch's t-test) higher than in the baseline.
+"""
+
+import argparse
+import json
+import math
+import pathlib
+import statistics
+import sys
+
+# The boot phases as "systemd-analyze time" shows them, and PID1's own startup phases. All of them are
+# derived from monotonic timestamps, i.e. relative to the start of the kernel.
+PHASES = {
+    'firmware':   lambda t: (t['FirmwareTimestampMonotonic'] - t['LoaderTimestampMonotonic']
+                             if t['FirmwareTimestampMonotonic'] else 0),
+    'loader':     lambda t: t['LoaderTimestampMonotonic'],
+    'kernel':     lambda t: t['InitRDTimestampMonotonic'] or t['UserspaceTimestampMonotonic'],
+    'initrd':     lambda t: (t['UserspaceTimestampMonotonic'] - t['InitRDTimestampMonotonic']
+                             if t['InitRDTimestampMonotonic'] else 0),
+    'userspace':  lambda t: t['FinishTimestampMonotonic'] - t['UserspaceTimestampMonotonic'],
+    'total':      lambda t: (t['FirmwareTimestampMonotonic'] or t['LoaderTimestampMonotonic']) +
+                            t['FinishTimestampMonotonic'],
+    'security':   lambda t: t['SecurityFinishTimestampMonotonic'] - t['SecurityStartTimestampMonotonic'],
+    'generators': lambda t: t['GeneratorsFinishTimestampMonotonic'] - t['GeneratorsStartTimestampMonotonic'],
+    'units-load': lambda t: t['UnitsLoadFinishTimestampMonotonic'] - t['UnitsLoadStartTimestampMonotonic'],
+}
+
+def argument_parser():
+    p = argparse.ArgumentParser(description=__doc__,
+                                formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument('boots', metavar='BOOT', nargs='+', type=pathlib.Path,
+                   help='directory with the timings collected during one boot')
+    p.add_argument('--output', type=pathlib.Path,
+                   help='write the summary to this file instead of stdout')
+    p.add_argument('--baseline', type=pathlib.Path,
+                   help='summary of an earlier run to compare with')
+    p.add_argument('--threshold', type=float, default=0.05,
+                   help='relative increase of a mean to consider (default: %(default)s)')
+    p.add_argument('--min-delta-usec', type=int, default=10000,
+                   help='absolute increase of a mean to consider (default: %(default)s)')
+    p.add_argument('--t-value', type=float, default=3.0,
+                   help="t statistic at which Welch's t-test counts a difference as significant "
+                        '(default: %(default)s)')
+    return p
+
+def parse_show(path):
+    """Parses "systemctl show" output into a list of dicts, one for each block"""
+    blocks = [{}]
+    for line in path.read_text().splitlines():
+        if not line:
+            if blocks[-1]:
+                blocks.append({})
+            continue
+        key, _, value = line.partition('=')
+        blocks[-1][key] = int(value) if value.isdigit() else value
+    return [b for b in blocks if b]
+
+def read_boot(path):
+    manager = parse_show(path / 'manager.txt')[0]
+    phases = {name: func(manager) for name, func in PHASES.items()}
+
+    # Just like "systemd-analyze blame", consider the time from leaving the inactive state to entering
+    # the active state as how long a unit took to activate.
+    units = {}
+    for unit in parse_show(path / 'units.txt'):
+        exit_ts = unit.get('InactiveExitTimestampMonotonic', 0)
+        enter_ts = unit.get('ActiveEnterTimestampMonotonic', 0)
+        if exit_ts and enter_ts > exit_ts:
+            units[unit['Id']] = enter_ts - exit_ts
+
+    return {'phases': phases, 'units': units}
+
+def samples(boots, kind):
+    result = {}
+    for boot in boots:
+        for name, usec in boot[kind].items():
+            result.setdefault(name, []).append(usec)
+    return result
+
+def welch_t(a, b):
+    va = statistics.variance(a) / len(a)
+    vb = statistics.variance(b) / len(b)
+    if va + vb == 0:
+        return math.inf if statistics.mean(b) != statistics.mean(a) else 0
+    return (statistics.mean(b) - statistics.mean(a)) / math.sqrt(va + vb)
+
+def compare(kind, baseline, current, args):
+    regressions = []
+    old = samples(baseline, kind)
+    new = samples(current, kind)
+
+    for name in sorted(old.keys() & new.keys()):
+        a, b = old[name], new[name]
+        if len(a) < 2 or len(b) < 2:
+            continue
+
+        mean_a, mean_b = statistics.mean(a), statistics.mean(b)
+        if mean_b - mean_a < max(args.min_delta_usec, mean_a * args.threshold):
+            continue
+
+        t = welch_t(a, b)
+        if t < args.t_value:
+            continue
+
+        regressions.append({
+            'kind': kind,
+            'name': name,
+            'baselineMeanUSec': round(mean_a),
+            'meanUSec': round(mean_b),
+            't': t if math.isfinite(t) else None,
+        })
+
+    return regressions
+
+def main():
+    args = argument_parser().parse_args()
+
+    boots = [read_boot(path) for path in args.boots]
+    summary = {
+        'boots': boots,
+        'phases': {name: {'meanUSec': round(statistics.mean(v)),
+                          'stdevUSec': round(statistics.stdev(v)) if len(v) > 1 else 0}
+                   for name, v in samples(boots, 'phases').items()},
+    }
+
+    ret = 0
+    if args.baseline:
+        baseline = json.loads(args.baseline.read_text())['boots']
+
+        regressions = compare('phases', baseline, boots, args) + compare('units', baseline, boots, args)
+        summary['regressions'] = regressions
+
+        for r in regressions:
+            print(f"Regression in {r['kind'][:-1]} {r['name']}: "
+                  f"{r['baselineMeanUSec']}µs → {r['meanUSec']}µs", file=sys.stderr)
+        if regressions:
+            ret = 1
+
+    text = json.dumps(summary, indent=2) + '\n'
+    if args.output:
+        args.output.write_text(text)
+    else:
+        sys.stdout.write(text)
+
+    return ret
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+set -eux
+set -o pipefail
+
+# Wait for the boot to finish, systemd-analyze refuses to report anything before that
+timeout 5m bash -c 'while [[ "$(systemctl show -P FinishTimestampMonotonic)" == 0 ]]; do sleep .5; done'
+
+mkdir /boot-perf
+
+systemd-analyze time >/boot-perf/time.txt
+systemd-analyze blame --no-pager >/boot-perf/blame.txt
+systemd-analyze critical-chain --no-pager >/boot-perf/critical-chain.txt
+
+# The raw timestamps of the boot phases, and of PID1's own startup phases. They are turned into JSON on
+# the host by test/boot-perf.py, which has more than shell at its disposal.
+systemctl show \
+    -p FirmwareTimestampMonotonic \
+    -p LoaderTimestampMonotonic \
+    -p InitRDTimestampMonotonic \
+    -p UserspaceTimestampMonotonic \
+    -p FinishTimestampMonotonic \
+    -p SecurityStartTimestampMonotonic \
+    -p SecurityFinishTimestampMonotonic \
+    -p GeneratorsStartTimestampMonotonic \
+    -p GeneratorsFinishTimestampMonotonic \
+    -p UnitsLoadStartTimestampMonotonic \
+    -p UnitsLoadFinishTimestampMonotonic \
+    >/boot-perf/manager.txt
+
+systemctl show \
+    -p Id \
+    -p InactiveExitTimestampMonotonic \
+    -p ActiveEnterTimestampMonotonic \
+    '*' >/boot-perf/units.txt
+
+touch /testok